@@ -17,26 +17,73 @@
 
 #include "omaha/base/apply_tag.h"
 
-#include <intsafe.h>
-#include <algorithm>
 #include <regex>
+#include <string>
 #include <vector>
 
-#include "omaha/base/utils.h"
-#include "omaha/base/extractor.h"
+#include "omaha/base/debug.h"
+#include "omaha/base/file.h"
+#include "omaha/base/scope_guard.h"
+#include "omaha/base/tag_template.h"
 
 namespace omaha {
 
-// TODO(omaha3): There is duplication between this code and the Extractor class.
-// Would be nice to eliminate or reduce the duplication.
-const char kMagicBytes[]    = "Gact2.0Omaha";
-const size_t kMagicBytesLen = arraysize(kMagicBytes) - 1;
+namespace {
 
-const uint32 kPEHeaderOffset = 60;
+class FileTagSource : public TagTemplate::Source {
+ public:
+  FileTagSource(File* file, uint32 size) : file_(file), size_(size) {}
 
-ApplyTag::ApplyTag()
-    : prev_tag_string_length_(0),
-      append_(0) {}
+  virtual uint64_t size() const { return size_; }
+
+  virtual bool ReadAt(uint64_t offset, uint8_t* buffer, size_t size) {
+    ASSERT1(buffer);
+
+    // File::ReadAt does not allow reading zero bytes.
+    if (!size) {
+      return true;
+    }
+    if (offset > size_ || size > size_ - offset) {
+      return false;
+    }
+
+    uint32 bytes_read = 0;
+    HRESULT hr = file_->ReadAt(static_cast<uint32>(offset),
+                               buffer,
+                               static_cast<uint32>(size),
+                               0,
+                               &bytes_read);
+    return SUCCEEDED(hr) && bytes_read == size;
+  }
+
+ private:
+  File* file_;
+  const uint32 size_;
+
+  DISALLOW_COPY_AND_ASSIGN(FileTagSource);
+};
+
+class FileTagWriter : public TagTemplate::Writer {
+ public:
+  explicit FileTagWriter(File* file) : file_(file) {}
+
+  virtual bool Write(const uint8_t* data, size_t size) {
+    ASSERT1(data);
+
+    uint32 bytes_written = 0;
+    HRESULT hr = file_->Write(data, static_cast<uint32>(size), &bytes_written);
+    return SUCCEEDED(hr) && bytes_written == size;
+  }
+
+ private:
+  File* file_;
+
+  DISALLOW_COPY_AND_ASSIGN(FileTagWriter);
+};
+
+}  // namespace
+
+ApplyTag::ApplyTag() : append_(false) {}
 
 bool ApplyTag::IsValidTagString(const char* tag_string) {
   ASSERT1(tag_string);
@@ -69,147 +116,76 @@ HRESULT ApplyTag::Init(const TCHAR* signed_exe_file,
 }
 
 HRESULT ApplyTag::EmbedTagString() {
-  std::vector<byte> input_file_buffer;
-  HRESULT hr = ReadEntireFileShareMode(signed_exe_file_,
-                                       0,
-                                       FILE_SHARE_READ,
-                                       &input_file_buffer);
+  ASSERT1(!tag_string_.empty());
+
+  File signed_exe;
+  HRESULT hr = signed_exe.OpenShareMode(signed_exe_file_,
+                                        false,
+                                        false,
+                                        FILE_SHARE_READ);
   if (FAILED(hr)) {
     return hr;
   }
+  ON_SCOPE_EXIT_OBJ(signed_exe, &File::Close);
 
-  ASSERT1(!input_file_buffer.empty());
-  VERIFY1(ReadExistingTag(&input_file_buffer));
-  if (!append_ && prev_tag_string_length_) {
-    // If there is a previous tag and the append flag is not set, then
-    // we should error out.
-    return APPLYTAG_E_ALREADY_TAGGED;
-  }
-
-  if (!CreateBufferToWrite()) {
-    return E_FAIL;
+  uint32 signed_exe_size = 0;
+  hr = signed_exe.GetLength(&signed_exe_size);
+  if (FAILED(hr)) {
+    return hr;
   }
 
-  buffer_data_.resize(input_file_buffer.size());
-
-  copy(input_file_buffer.begin(),
-       input_file_buffer.end(),
-       buffer_data_.begin());
-
   // Applying tags require the file be signed with Authenticode and have a
-  // padded certificate that contains kMagicBytes.
-  if (!ApplyTagToBuffer()) {
-    return APPLYTAG_E_NOT_SIGNED;
+  // padded certificate that contains the magic bytes.
+  FileTagSource source(&signed_exe, signed_exe_size);
+  TagTemplate tag_template;
+  TagTemplate::Overlay overlay;
+  TagTemplate::Result result = tag_template.Load(&source);
+  if (result == TagTemplate::kSuccess) {
+    result = tag_template.MakeOverlay(
+        std::string(&tag_string_.front(), tag_string_.size()),
+        append_,
+        &overlay);
   }
-
-  return WriteEntireFile(tagged_file_, buffer_data_);
-}
-
-uint32 ApplyTag::GetUint32(const void* p) {
-  ASSERT1(p);
-
-  const uint32* pu = reinterpret_cast<const uint32*>(p);
-  return *pu;
-}
-
-void ApplyTag::PutUint32(uint32 i, void* p) {
-  ASSERT1(p);
-
-  uint32* pu = reinterpret_cast<uint32*>(p);
-  *pu = i;
-}
-
-bool ApplyTag::ReadExistingTag(std::vector<byte>* binary) {
-  ASSERT1(binary);
-
-  int len = 0;
-  TagExtractor tag;
-  char* bin = reinterpret_cast<char*>(&binary->front());
-  ASSERT1(bin);
-  if (tag.ExtractTag(bin, binary->size(), NULL, &len)) {
-    prev_tag_string_.resize(len);
-    if (tag.ExtractTag(bin, binary->size(), &prev_tag_string_.front(), &len)) {
-      // The extractor returns the actual length
-      // of the string + 1 for the terminating null.
-      prev_tag_string_length_ = len - 1;
-    }
+  switch (result) {
+    case TagTemplate::kSuccess:
+      break;
+    case TagTemplate::kInvalidImage:
+    case TagTemplate::kNotSigned:
+      return APPLYTAG_E_NOT_SIGNED;
+    case TagTemplate::kAlreadyTagged:
+      // If there is a previous tag and the append flag is not set, then
+      // we should error out.
+      return APPLYTAG_E_ALREADY_TAGGED;
+    case TagTemplate::kInvalidTag:
+    case TagTemplate::kTagTooLong:
+      return E_INVALIDARG;
+    default:
+      return E_FAIL;
   }
 
-  return true;
-}
-
-bool ApplyTag::CreateBufferToWrite() {
-  ASSERT1(!append_ && !prev_tag_string_length_ || append_);
-  ASSERT1(!tag_string_.empty());
-  ASSERT1(!prev_tag_string_.size() ||
-          prev_tag_string_.size() ==
-          static_cast<size_t>(prev_tag_string_length_ + 1));
-
-  // Build the tag buffer.
-  // The format of the tag buffer is:
-  // 000000-00000B: 12-byte magic (big-endian)
-  // 00000C-00000D: unsigned 16-bit int string length (big-endian)
-  // 00000E-??????: ASCII string
-  size_t tag_string_len = tag_string_.size() + prev_tag_string_length_;
-  size_t tag_header_len = kMagicBytesLen + 2;
-  size_t tag_buffer_length = tag_string_len + tag_header_len;
-
-  tag_buffer_.clear();
-  tag_buffer_.resize(tag_buffer_length, 0);
-  memcpy(&tag_buffer_.front(), kMagicBytes, kMagicBytesLen);
-  tag_buffer_[kMagicBytesLen] =
-      static_cast<char>((tag_string_len & 0xff00) >> 8);
-  tag_buffer_[kMagicBytesLen+1] = static_cast<char>(tag_string_len & 0xff);
-
-  if (prev_tag_string_length_ > 0) {
-    copy(prev_tag_string_.begin(),
-         prev_tag_string_.end(),
-         tag_buffer_.begin() + tag_header_len);
+  // File::Write doesn't implement clear-on-open-for-write semantics, so
+  // delete the file if it exists instead of writing into it.
+  if (File::Exists(tagged_file_)) {
+    hr = File::Remove(tagged_file_);
+    if (FAILED(hr)) {
+      return hr;
+    }
   }
 
-  copy(tag_string_.begin(),
-       tag_string_.end(),
-       tag_buffer_.begin() + tag_header_len + prev_tag_string_length_);
-  ASSERT1(static_cast<int>(tag_buffer_.size()) == tag_buffer_length);
-
-  return true;
-}
-
-bool ApplyTag::ApplyTagToBuffer() {
-  uint32 peheader = GetUint32(&buffer_data_.front() + kPEHeaderOffset);
-  uint32 kCertDirAddressOffset = 152;
-  uint32 kCertDirInfoSize = 4 + 4;
-
-  ASSERT1(peheader + kCertDirAddressOffset + kCertDirInfoSize <=
-          buffer_data_.size());
-
-  // Read certificate directory info.
-  uint32 cert_dir_offset = GetUint32(&buffer_data_.front() + peheader +
-                                     kCertDirAddressOffset);
-  if (cert_dir_offset == 0) {
-    return false;
+  File tagged_exe;
+  hr = tagged_exe.Open(tagged_file_, true, false);
+  if (FAILED(hr)) {
+    return hr;
   }
 
-  uint32 cert_dir_len = GetUint32(&buffer_data_.front() + peheader +
-                                  kCertDirAddressOffset + 4);
-  ASSERT1(cert_dir_offset + cert_dir_len == buffer_data_.size());
-
-  // Find kMagicBytes and add the tag buffer there.
-  const byte* cert_dir_start = &buffer_data_.front() + cert_dir_offset;
-  const byte* cert_dir_end = cert_dir_start + cert_dir_len;
-  const byte* mc = std::search(cert_dir_start,
-                               cert_dir_end,
-                               kMagicBytes,
-                               kMagicBytes + kMagicBytesLen);
-  if (mc >= cert_dir_end) {
-    return false;
+  FileTagWriter writer(&tagged_exe);
+  result = tag_template.Write(overlay, &writer);
+  hr = tagged_exe.Close();
+  if (result != TagTemplate::kSuccess) {
+    VERIFY_SUCCEEDED(File::Remove(tagged_file_));
+    return E_FAIL;
   }
-
-  // Copy the tag buffer.
-  copy(tag_buffer_.begin(), tag_buffer_.end(),
-       buffer_data_.begin() + (mc - &buffer_data_.front()));
-
-  return true;
+  return hr;
 }
 
 }  // namespace omaha
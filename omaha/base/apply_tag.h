@@ -42,6 +42,8 @@ const char* const kValidTagStringRegEx = "^[-%{}/&=.,_a-zA-Z0-9_]*$";
 // <Signature>Gact.<tag_len><tag_string>
 // There are no restrictions on the tag_string, it is just treated
 // as a sequence of bytes.
+// The binary is not read into memory: only its headers are read, and the
+// tagged file is the binary with a few bytes replaced. See TagTemplate.
 class ApplyTag {
  public:
   ApplyTag();
@@ -53,22 +55,11 @@ class ApplyTag {
   HRESULT EmbedTagString();
 
  private:
-  static uint32 GetUint32(const void* p);
-  static void PutUint32(uint32 i, void* p);
-  bool ReadExistingTag(std::vector<byte>* binary);
-  bool CreateBufferToWrite();
-  bool ApplyTagToBuffer();
   bool IsValidTagString(const char* tag_string);
 
   // The string to be tagged into the binary.
   std::vector<char> tag_string_;
 
-  // Existing tag string inside the binary.
-  std::vector<char> prev_tag_string_;
-
-  // This is prev_tag_string_.size - 1, to exclude the terminating null.
-  int prev_tag_string_length_;
-
   // The input binary to be tagged.
   CString signed_exe_file_;
 
@@ -78,13 +69,6 @@ class ApplyTag {
   // Whether to append the tag string to the existing one.
   bool append_;
 
-  // Internal buffer to hold the appended string.
-  std::vector<char> tag_buffer_;
-
-  // The output buffer that contains the original binary
-  // data with the tagged information.
-  std::vector<byte> buffer_data_;
-
   DISALLOW_COPY_AND_ASSIGN(ApplyTag);
 };
 
@@ -0,0 +1,546 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/base/binary_patch.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "omaha/base/security/sha256.h"
+
+namespace omaha {
+
+namespace {
+
+// Create() indexes the old file by the first kKeySize bytes at each offset
+// and ignores the matches shorter than kMinMatchSize.
+const size_t kKeySize = 8;
+const size_t kMinMatchSize = 16;
+const size_t kMaxCandidates = 32;
+
+// An approximate match ends after this many bytes without a better match.
+const size_t kMaxApproximateGap = 256;
+
+// A diff literal ends at a run of at least this many zero bytes.
+const size_t kMinZeroRun = 4;
+
+const int kMaxVarintBytes = 10;
+
+void AppendUint64(uint64_t value, std::string* out) {
+  for (int i = 0; i != 8; ++i) {
+    out->push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+  }
+}
+
+uint64_t LoadUint64(const uint8_t* data) {
+  uint64_t value = 0;
+  for (int i = 0; i != 8; ++i) {
+    value |= static_cast<uint64_t>(data[i]) << (8 * i);
+  }
+  return value;
+}
+
+void AppendVarint(uint64_t value, std::string* out) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<char>((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+uint64_t ZigZagEncode(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^
+         static_cast<uint64_t>(value >> 63);
+}
+
+int64_t ZigZagDecode(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// Buffers the sequential reads of the patch.
+class PatchStream {
+ public:
+  explicit PatchStream(BinaryPatch::Reader* reader)
+      : reader_(reader),
+        buffer_(BinaryPatch::kBufferSize),
+        pos_(0),
+        end_(0),
+        has_read_error_(false) {}
+
+  // Reads exactly |size| bytes.
+  bool ReadBytes(uint8_t* out, size_t size) {
+    while (size) {
+      if (pos_ == end_ && !Fill()) {
+        return false;
+      }
+      const size_t count = std::min(size, end_ - pos_);
+      memcpy(out, &buffer_[pos_], count);
+      pos_ += count;
+      out += count;
+      size -= count;
+    }
+    return true;
+  }
+
+  bool ReadVarint(uint64_t* value) {
+    *value = 0;
+    for (int i = 0; i != kMaxVarintBytes; ++i) {
+      uint8_t byte = 0;
+      if (!ReadBytes(&byte, 1)) {
+        return false;
+      }
+      *value |= static_cast<uint64_t>(byte & 0x7F) << (7 * i);
+      if (!(byte & 0x80)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool AtEnd() {
+    return pos_ == end_ && !Fill() && !has_read_error_;
+  }
+
+  bool has_read_error() const { return has_read_error_; }
+
+ private:
+  bool Fill() {
+    const int64_t count = reader_->Read(&buffer_[0], buffer_.size());
+    if (count < 0) {
+      has_read_error_ = true;
+      return false;
+    }
+    pos_ = 0;
+    end_ = static_cast<size_t>(count);
+    return count > 0;
+  }
+
+  BinaryPatch::Reader* reader_;
+  std::vector<uint8_t> buffer_;
+  size_t pos_;
+  size_t end_;
+  bool has_read_error_;
+
+  DISALLOW_COPY_AND_ASSIGN(PatchStream);
+};
+
+// Writes the new file and hashes it.
+class OutputStream {
+ public:
+  explicit OutputStream(BinaryPatch::Writer* writer)
+      : writer_(writer), size_(0) {
+    SHA256_init(&hash_);
+  }
+
+  bool Write(const uint8_t* data, size_t size) {
+    SHA256_update(&hash_, data, size);
+    size_ += size;
+    return writer_->Write(data, size);
+  }
+
+  uint64_t size() const { return size_; }
+
+  bool HashMatches(const uint8_t* expected_hash) {
+    return memcmp(SHA256_final(&hash_), expected_hash,
+                  BinaryPatch::kHashSize) == 0;
+  }
+
+ private:
+  BinaryPatch::Writer* writer_;
+  LITE_SHA256_CTX hash_;
+  uint64_t size_;
+
+  DISALLOW_COPY_AND_ASSIGN(OutputStream);
+};
+
+BinaryPatch::Result HashSource(BinaryPatch::Source* source,
+                               std::vector<uint8_t>* buffer,
+                               uint8_t* hash) {
+  LITE_SHA256_CTX context;
+  SHA256_init(&context);
+  const uint64_t size = source->size();
+  for (uint64_t offset = 0; offset != size;) {
+    const size_t count = static_cast<size_t>(
+        std::min<uint64_t>(buffer->size(), size - offset));
+    if (!source->ReadAt(offset, &(*buffer)[0], count)) {
+      return BinaryPatch::kReadError;
+    }
+    SHA256_update(&context, &(*buffer)[0], count);
+    offset += count;
+  }
+  memcpy(hash, SHA256_final(&context), BinaryPatch::kHashSize);
+  return BinaryPatch::kSuccess;
+}
+
+// Applies |size| bytes of a diff at |old_offset|. The bytes to add are read
+// from |patch| unless |is_zero| is true.
+BinaryPatch::Result ApplyDiff(BinaryPatch::Source* source,
+                              uint64_t old_offset,
+                              uint64_t size,
+                              bool is_zero,
+                              PatchStream* patch,
+                              std::vector<uint8_t>* old_buffer,
+                              std::vector<uint8_t>* diff_buffer,
+                              OutputStream* output) {
+  while (size) {
+    const size_t count = static_cast<size_t>(
+        std::min<uint64_t>(old_buffer->size(), size));
+    uint8_t* old_bytes = &(*old_buffer)[0];
+    if (!source->ReadAt(old_offset, old_bytes, count)) {
+      return BinaryPatch::kReadError;
+    }
+    if (!is_zero) {
+      uint8_t* diff_bytes = &(*diff_buffer)[0];
+      if (!patch->ReadBytes(diff_bytes, count)) {
+        return patch->has_read_error() ? BinaryPatch::kReadError :
+                                         BinaryPatch::kCorruptPatch;
+      }
+      for (size_t i = 0; i != count; ++i) {
+        old_bytes[i] = static_cast<uint8_t>(old_bytes[i] + diff_bytes[i]);
+      }
+    }
+    if (!output->Write(old_bytes, count)) {
+      return BinaryPatch::kWriteError;
+    }
+    old_offset += count;
+    size -= count;
+  }
+  return BinaryPatch::kSuccess;
+}
+
+size_t MatchLength(const std::string& old_data, size_t old_pos,
+                   const std::string& new_data, size_t new_pos) {
+  size_t length = 0;
+  while (old_pos + length < old_data.size() &&
+         new_pos + length < new_data.size() &&
+         old_data[old_pos + length] == new_data[new_pos + length]) {
+    ++length;
+  }
+  return length;
+}
+
+// Extends a match over the following bytes as long as at least half of them
+// match, which covers code which moved along with the addresses it uses.
+size_t ApproximateMatchLength(const std::string& old_data, size_t old_pos,
+                              const std::string& new_data, size_t new_pos) {
+  int64_t num_matches = 0;
+  int64_t best_score = 0;
+  size_t best_length = 0;
+  for (size_t i = 0;
+       old_pos + i < old_data.size() && new_pos + i < new_data.size() &&
+       i - best_length <= kMaxApproximateGap;
+       ++i) {
+    if (old_data[old_pos + i] == new_data[new_pos + i]) {
+      ++num_matches;
+    }
+    const int64_t score = 2 * num_matches - static_cast<int64_t>(i + 1);
+    if (score > best_score) {
+      best_score = score;
+      best_length = i + 1;
+    }
+  }
+  return best_length;
+}
+
+// Encodes the difference between |size| bytes of the old and new files.
+void AppendDiff(const std::string& old_data, size_t old_pos,
+                const std::string& new_data, size_t new_pos,
+                size_t size, std::string* out) {
+  std::string diff(size, '\0');
+  for (size_t i = 0; i != size; ++i) {
+    diff[i] = static_cast<char>(new_data[new_pos + i] - old_data[old_pos + i]);
+  }
+
+  size_t i = 0;
+  while (i != size) {
+    const size_t zero_start = i;
+    while (i != size && !diff[i]) {
+      ++i;
+    }
+    const size_t literal_start = i;
+    size_t zero_run = 0;
+    while (i != size && zero_run < kMinZeroRun) {
+      zero_run = diff[i] ? 0 : zero_run + 1;
+      ++i;
+    }
+    if (zero_run == kMinZeroRun) {
+      i -= zero_run;
+    }
+    AppendVarint(literal_start - zero_start, out);
+    AppendVarint(i - literal_start, out);
+    out->append(diff, literal_start, i - literal_start);
+  }
+}
+
+}  // namespace
+
+const char BinaryPatch::kMagic[4] = {'O', 'B', 'P', '1'};
+
+bool BinaryPatch::ParseHeader(const std::string& data, Header* header) {
+  if (data.size() < kHeaderSize ||
+      memcmp(data.data(), kMagic, sizeof(kMagic)) != 0) {
+    return false;
+  }
+
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.data()) +
+                         sizeof(kMagic);
+  header->old_size = LoadUint64(bytes);
+  header->new_size = LoadUint64(bytes + 8);
+  memcpy(header->old_hash, bytes + 16, kHashSize);
+  memcpy(header->new_hash, bytes + 16 + kHashSize, kHashSize);
+  return true;
+}
+
+BinaryPatch::Result BinaryPatch::Apply(Source* source,
+                                       Reader* patch_reader,
+                                       Writer* writer) {
+  PatchStream patch(patch_reader);
+  std::vector<uint8_t> old_buffer(kBufferSize);
+  std::vector<uint8_t> diff_buffer(kBufferSize);
+
+  std::string header_bytes(kHeaderSize, '\0');
+  Header header;
+  if (!patch.ReadBytes(reinterpret_cast<uint8_t*>(&header_bytes[0]),
+                       kHeaderSize)) {
+    return patch.has_read_error() ? kReadError : kInvalidHeader;
+  }
+  if (!ParseHeader(header_bytes, &header)) {
+    return kInvalidHeader;
+  }
+
+  const uint64_t old_size = source->size();
+  if (old_size != header.old_size) {
+    return kBaseMismatch;
+  }
+  uint8_t old_hash[kHashSize] = {};
+  Result result = HashSource(source, &old_buffer, old_hash);
+  if (result != kSuccess) {
+    return result;
+  }
+  if (memcmp(old_hash, header.old_hash, kHashSize) != 0) {
+    return kBaseMismatch;
+  }
+
+  OutputStream output(writer);
+  uint64_t old_pos = 0;
+  while (output.size() != header.new_size) {
+    uint64_t diff_length = 0;
+    uint64_t extra_length = 0;
+    uint64_t seek = 0;
+    if (!patch.ReadVarint(&diff_length) ||
+        !patch.ReadVarint(&extra_length) ||
+        !patch.ReadVarint(&seek)) {
+      return patch.has_read_error() ? kReadError : kCorruptPatch;
+    }
+
+    const uint64_t remaining = header.new_size - output.size();
+    if (diff_length > remaining ||
+        extra_length > remaining - diff_length ||
+        diff_length > old_size - old_pos) {
+      return kCorruptPatch;
+    }
+
+    while (diff_length) {
+      uint64_t zero_length = 0;
+      uint64_t literal_length = 0;
+      if (!patch.ReadVarint(&zero_length) ||
+          !patch.ReadVarint(&literal_length)) {
+        return patch.has_read_error() ? kReadError : kCorruptPatch;
+      }
+      if ((!zero_length && !literal_length) ||
+          zero_length > diff_length ||
+          literal_length > diff_length - zero_length) {
+        return kCorruptPatch;
+      }
+
+      result = ApplyDiff(source, old_pos, zero_length, true, &patch,
+                         &old_buffer, &diff_buffer, &output);
+      if (result == kSuccess) {
+        result = ApplyDiff(source, old_pos + zero_length, literal_length,
+                           false, &patch, &old_buffer, &diff_buffer, &output);
+      }
+      if (result != kSuccess) {
+        return result;
+      }
+      old_pos += zero_length + literal_length;
+      diff_length -= zero_length + literal_length;
+    }
+
+    while (extra_length) {
+      const size_t count = static_cast<size_t>(
+          std::min<uint64_t>(diff_buffer.size(), extra_length));
+      if (!patch.ReadBytes(&diff_buffer[0], count)) {
+        return patch.has_read_error() ? kReadError : kCorruptPatch;
+      }
+      if (!output.Write(&diff_buffer[0], count)) {
+        return kWriteError;
+      }
+      extra_length -= count;
+    }
+
+    const int64_t offset = ZigZagDecode(seek);
+    if ((offset < 0 && static_cast<uint64_t>(-offset) > old_pos) ||
+        (offset > 0 && static_cast<uint64_t>(offset) > old_size - old_pos)) {
+      return kCorruptPatch;
+    }
+    old_pos += offset;
+  }
+
+  if (!patch.AtEnd()) {
+    return patch.has_read_error() ? kReadError : kCorruptPatch;
+  }
+  if (!output.HashMatches(header.new_hash)) {
+    return kOutputMismatch;
+  }
+  return kSuccess;
+}
+
+std::string BinaryPatch::Create(const std::string& old_data,
+                                const std::string& new_data) {
+  const uint8_t* old_bytes = reinterpret_cast<const uint8_t*>(old_data.data());
+  const uint8_t* new_bytes = reinterpret_cast<const uint8_t*>(new_data.data());
+
+  std::string patch(kMagic, sizeof(kMagic));
+  AppendUint64(old_data.size(), &patch);
+  AppendUint64(new_data.size(), &patch);
+  uint8_t hash[kHashSize] = {};
+  SHA256_hash(old_data.data(), old_data.size(), hash);
+  patch.append(reinterpret_cast<const char*>(hash), kHashSize);
+  SHA256_hash(new_data.data(), new_data.size(), hash);
+  patch.append(reinterpret_cast<const char*>(hash), kHashSize);
+
+  // Indexes every offset of the old file by the bytes which follow it.
+  std::vector<std::pair<uint64_t, size_t>> index;
+  if (old_data.size() >= kKeySize) {
+    index.reserve(old_data.size() - kKeySize + 1);
+    for (size_t i = 0; i + kKeySize <= old_data.size(); ++i) {
+      index.push_back(std::make_pair(LoadUint64(old_bytes + i), i));
+    }
+    std::sort(index.begin(), index.end());
+  }
+
+  // The regions of the new file copied from the old file with a diff.
+  struct Match {
+    size_t old_pos;
+    size_t new_pos;
+    size_t length;
+  };
+  std::vector<Match> matches;
+
+  size_t scan = 0;
+  size_t last_new_pos = 0;
+  while (scan + kKeySize <= new_data.size()) {
+    const uint64_t key = LoadUint64(new_bytes + scan);
+    auto it = std::lower_bound(index.begin(), index.end(),
+                               std::make_pair(key, static_cast<size_t>(0)));
+    size_t best_length = 0;
+    size_t best_old_pos = 0;
+    for (size_t i = 0;
+         it != index.end() && it->first == key && i != kMaxCandidates;
+         ++it, ++i) {
+      const size_t length = MatchLength(old_data, it->second, new_data, scan);
+      if (length > best_length) {
+        best_length = length;
+        best_old_pos = it->second;
+      }
+    }
+    if (best_length < kMinMatchSize) {
+      ++scan;
+      continue;
+    }
+
+    while (scan > last_new_pos && best_old_pos > 0 &&
+           new_data[scan - 1] == old_data[best_old_pos - 1]) {
+      --scan;
+      --best_old_pos;
+    }
+
+    Match match;
+    match.old_pos = best_old_pos;
+    match.new_pos = scan;
+    match.length = std::max(
+        best_length,
+        ApproximateMatchLength(old_data, best_old_pos, new_data, scan));
+    matches.push_back(match);
+
+    scan += match.length;
+    last_new_pos = scan;
+  }
+
+  // The first block only has the bytes before the first match, if any.
+  const size_t first_new_pos = matches.empty() ? new_data.size() :
+                                                 matches[0].new_pos;
+  if (first_new_pos) {
+    AppendVarint(0, &patch);
+    AppendVarint(first_new_pos, &patch);
+    AppendVarint(ZigZagEncode(matches.empty() ? 0 : matches[0].old_pos),
+                 &patch);
+    patch.append(new_data, 0, first_new_pos);
+  } else if (!matches.empty() && matches[0].old_pos) {
+    // Seeks to the first match with an empty block.
+    const Match& first = matches[0];
+    AppendVarint(0, &patch);
+    AppendVarint(0, &patch);
+    AppendVarint(ZigZagEncode(static_cast<int64_t>(first.old_pos)), &patch);
+  }
+
+  for (size_t i = 0; i != matches.size(); ++i) {
+    const Match& match = matches[i];
+    const size_t extra_start = match.new_pos + match.length;
+    const size_t extra_end = i + 1 != matches.size() ? matches[i + 1].new_pos :
+                                                       new_data.size();
+    const int64_t seek =
+        i + 1 != matches.size() ?
+        static_cast<int64_t>(matches[i + 1].old_pos) -
+            static_cast<int64_t>(match.old_pos + match.length) :
+        0;
+
+    std::string diff;
+    AppendDiff(old_data, match.old_pos, new_data, match.new_pos, match.length,
+               &diff);
+    AppendVarint(match.length, &patch);
+    AppendVarint(extra_end - extra_start, &patch);
+    AppendVarint(ZigZagEncode(seek), &patch);
+    patch.append(diff);
+    patch.append(new_data, extra_start, extra_end - extra_start);
+  }
+
+  return patch;
+}
+
+const char* BinaryPatch::ResultToString(Result result) {
+  switch (result) {
+    case kSuccess:
+      return "success";
+    case kInvalidHeader:
+      return "invalid header";
+    case kBaseMismatch:
+      return "base mismatch";
+    case kCorruptPatch:
+      return "corrupt patch";
+    case kReadError:
+      return "read error";
+    case kWriteError:
+      return "write error";
+    case kOutputMismatch:
+      return "output mismatch";
+  }
+  return "unknown";
+}
+
+}  // namespace omaha
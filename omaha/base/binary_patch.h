@@ -0,0 +1,130 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// BinaryPatch creates and applies bsdiff-style binary patches, which turn the
+// package of a version of an app into the package of the next version.
+//
+// A patch starts with a header:
+//   magic       4 bytes   kMagic.
+//   old size    8 bytes   Little-endian size of the old file.
+//   new size    8 bytes   Little-endian size of the new file.
+//   old hash   32 bytes   SHA-256 of the old file.
+//   new hash   32 bytes   SHA-256 of the new file.
+// followed by blocks, until the new file is complete:
+//   diff length    varint
+//   extra length   varint
+//   seek           zigzag varint
+//   diff           The bytes to add to the next |diff length| bytes of the
+//                  old file, encoded as a sequence of (number of zero bytes,
+//                  number of literal bytes, literal bytes) triples. Code
+//                  which moved in the old file mostly matches, so most of the
+//                  bytes to add are zero.
+//   extra          |extra length| bytes copied as they are.
+// The position in the old file starts at zero, moves forward by the diff
+// length, then by |seek|, which can be negative.
+//
+// Apply() streams the old file, the patch, and the new file through fixed-size
+// buffers, so the memory it uses does not depend on the size of the files. It
+// checks the old file against the header before writing anything, and checks
+// the new file against the header once it is written. The callers must still
+// verify the new file against the hash of the full package.
+//
+// This file has no platform dependencies.
+
+#ifndef OMAHA_BASE_BINARY_PATCH_H_
+#define OMAHA_BASE_BINARY_PATCH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "base/basictypes.h"
+
+namespace omaha {
+
+class BinaryPatch {
+ public:
+  // The old file, read at random offsets.
+  class Source {
+   public:
+    virtual ~Source() {}
+    virtual uint64_t size() const = 0;
+
+    // Reads exactly |size| bytes at |offset|.
+    virtual bool ReadAt(uint64_t offset, uint8_t* buffer, size_t size) = 0;
+  };
+
+  // The patch, read sequentially.
+  class Reader {
+   public:
+    virtual ~Reader() {}
+
+    // Reads up to |size| bytes. Returns the number of bytes read, which is
+    // zero at the end of the patch, or -1 if an error occurs.
+    virtual int64_t Read(uint8_t* buffer, size_t size) = 0;
+  };
+
+  // The new file, written sequentially.
+  class Writer {
+   public:
+    virtual ~Writer() {}
+    virtual bool Write(const uint8_t* data, size_t size) = 0;
+  };
+
+  enum Result {
+    kSuccess = 0,
+    kInvalidHeader,     // The patch does not start with a valid header.
+    kBaseMismatch,      // The old file is not the one the patch applies to.
+    kCorruptPatch,      // The patch is truncated or inconsistent.
+    kReadError,
+    kWriteError,
+    kOutputMismatch,    // The new file does not match the header.
+  };
+
+  static const char kMagic[4];
+  static const size_t kHashSize = 32;
+  static const size_t kHeaderSize = 4 + 8 + 8 + 2 * kHashSize;
+
+  // The size of the buffers used by Apply().
+  static const size_t kBufferSize = 64 * 1024;
+
+  struct Header {
+    uint64_t old_size = 0;
+    uint64_t new_size = 0;
+    uint8_t old_hash[kHashSize] = {};
+    uint8_t new_hash[kHashSize] = {};
+  };
+
+  // Reads the header of a patch.
+  static bool ParseHeader(const std::string& data, Header* header);
+
+  // Writes the new file obtained by applying |patch| to |source|.
+  static Result Apply(Source* source, Reader* patch, Writer* output);
+
+  // Creates a patch which turns |old_data| into |new_data|. This holds both
+  // files in memory and is meant for tools and tests.
+  static std::string Create(const std::string& old_data,
+                            const std::string& new_data);
+
+  static const char* ResultToString(Result result);
+
+ private:
+  DISALLOW_IMPLICIT_CONSTRUCTORS(BinaryPatch);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_BASE_BINARY_PATCH_H_
@@ -0,0 +1,259 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/base/binary_patch.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace omaha {
+
+namespace {
+
+class StringSource : public BinaryPatch::Source {
+ public:
+  explicit StringSource(const std::string& data) : data_(data) {}
+
+  uint64_t size() const override { return data_.size(); }
+
+  bool ReadAt(uint64_t offset, uint8_t* buffer, size_t size) override {
+    if (offset > data_.size() || size > data_.size() - offset) {
+      return false;
+    }
+    memcpy(buffer, data_.data() + offset, size);
+    return true;
+  }
+
+ private:
+  const std::string data_;
+
+  DISALLOW_COPY_AND_ASSIGN(StringSource);
+};
+
+// Returns at most |max_read_size| bytes per read to exercise the buffering.
+class StringReader : public BinaryPatch::Reader {
+ public:
+  StringReader(const std::string& data, size_t max_read_size)
+      : data_(data), pos_(0), max_read_size_(max_read_size) {}
+
+  int64_t Read(uint8_t* buffer, size_t size) override {
+    const size_t count = std::min(std::min(size, max_read_size_),
+                                  data_.size() - pos_);
+    memcpy(buffer, data_.data() + pos_, count);
+    pos_ += count;
+    return static_cast<int64_t>(count);
+  }
+
+ private:
+  const std::string data_;
+  size_t pos_;
+  const size_t max_read_size_;
+
+  DISALLOW_COPY_AND_ASSIGN(StringReader);
+};
+
+class StringWriter : public BinaryPatch::Writer {
+ public:
+  StringWriter() {}
+
+  bool Write(const uint8_t* data, size_t size) override {
+    data_.append(reinterpret_cast<const char*>(data), size);
+    return true;
+  }
+
+  const std::string& data() const { return data_; }
+
+ private:
+  std::string data_;
+
+  DISALLOW_COPY_AND_ASSIGN(StringWriter);
+};
+
+BinaryPatch::Result ApplyPatch(const std::string& old_data,
+                               const std::string& patch,
+                               std::string* new_data,
+                               size_t max_read_size = 4096) {
+  StringSource source(old_data);
+  StringReader reader(patch, max_read_size);
+  StringWriter writer;
+  const BinaryPatch::Result result =
+      BinaryPatch::Apply(&source, &reader, &writer);
+  *new_data = writer.data();
+  return result;
+}
+
+std::string RandomData(size_t size, unsigned int seed) {
+  std::mt19937 generator(seed);
+  std::string data(size, '\0');
+  for (size_t i = 0; i != size; ++i) {
+    data[i] = static_cast<char>(generator() & 0xFF);
+  }
+  return data;
+}
+
+void ExpectRoundTrip(const std::string& old_data,
+                     const std::string& new_data) {
+  const std::string patch = BinaryPatch::Create(old_data, new_data);
+  std::string result;
+  EXPECT_EQ(BinaryPatch::kSuccess, ApplyPatch(old_data, patch, &result));
+  EXPECT_TRUE(result == new_data);
+}
+
+}  // namespace
+
+TEST(BinaryPatchTest, RoundTrip) {
+  const std::string old_data = RandomData(100000, 1);
+
+  ExpectRoundTrip(old_data, old_data);
+  ExpectRoundTrip(std::string(), old_data);
+  ExpectRoundTrip(old_data, std::string());
+  ExpectRoundTrip(std::string(), std::string());
+  ExpectRoundTrip(old_data, RandomData(5000, 2));
+  ExpectRoundTrip("abc", "abd");
+
+  std::string edited = old_data;
+  edited[10] ^= 0x01;
+  edited[50000] ^= 0x80;
+  edited.insert(20000, "inserted bytes");
+  edited.erase(70000, 1000);
+  ExpectRoundTrip(old_data, edited);
+
+  // Moves a block from the end to the start.
+  ExpectRoundTrip(old_data, old_data.substr(90000) + old_data.substr(0, 90000));
+}
+
+TEST(BinaryPatchTest, Create_SmallerThanFile) {
+  const std::string old_data = RandomData(1000000, 3);
+  std::string new_data = old_data;
+
+  // Shifts the addresses in a range of the file, as relinking code does.
+  for (size_t i = 300000; i < 400000; i += 64) {
+    new_data[i] = static_cast<char>(new_data[i] + 1);
+  }
+  new_data.insert(600000, RandomData(2000, 4));
+
+  const std::string patch = BinaryPatch::Create(old_data, new_data);
+  EXPECT_LT(patch.size(), 10000u);
+
+  std::string result;
+  EXPECT_EQ(BinaryPatch::kSuccess, ApplyPatch(old_data, patch, &result, 1));
+  EXPECT_TRUE(result == new_data);
+}
+
+TEST(BinaryPatchTest, ParseHeader) {
+  const std::string old_data = RandomData(1000, 5);
+  const std::string new_data = RandomData(2000, 6);
+  const std::string patch = BinaryPatch::Create(old_data, new_data);
+
+  BinaryPatch::Header header;
+  EXPECT_TRUE(BinaryPatch::ParseHeader(patch, &header));
+  EXPECT_EQ(1000u, header.old_size);
+  EXPECT_EQ(2000u, header.new_size);
+
+  EXPECT_FALSE(BinaryPatch::ParseHeader(
+      patch.substr(0, BinaryPatch::kHeaderSize - 1), &header));
+  EXPECT_FALSE(BinaryPatch::ParseHeader("XXXX" + patch.substr(4), &header));
+}
+
+TEST(BinaryPatchTest, Apply_InvalidHeader) {
+  std::string result;
+  EXPECT_EQ(BinaryPatch::kInvalidHeader, ApplyPatch("old", "", &result));
+  EXPECT_EQ(BinaryPatch::kInvalidHeader,
+            ApplyPatch("old", std::string(200, 'x'), &result));
+  EXPECT_TRUE(result.empty());
+}
+
+TEST(BinaryPatchTest, Apply_BaseMismatch) {
+  const std::string old_data = RandomData(10000, 7);
+  std::string new_data = old_data;
+  new_data[5000] = 'x';
+  const std::string patch = BinaryPatch::Create(old_data, new_data);
+
+  std::string other_data = old_data;
+  other_data[0] ^= 0x01;
+  std::string result;
+  EXPECT_EQ(BinaryPatch::kBaseMismatch,
+            ApplyPatch(other_data, patch, &result));
+  EXPECT_EQ(BinaryPatch::kBaseMismatch,
+            ApplyPatch(old_data.substr(1), patch, &result));
+  EXPECT_TRUE(result.empty());
+}
+
+TEST(BinaryPatchTest, Apply_Truncated) {
+  const std::string old_data = RandomData(10000, 8);
+  std::string new_data = old_data;
+  new_data.insert(3000, RandomData(500, 9));
+  const std::string patch = BinaryPatch::Create(old_data, new_data);
+
+  for (size_t size = BinaryPatch::kHeaderSize; size < patch.size(); ++size) {
+    std::string result;
+    EXPECT_EQ(BinaryPatch::kCorruptPatch,
+              ApplyPatch(old_data, patch.substr(0, size), &result));
+  }
+}
+
+TEST(BinaryPatchTest, Apply_TrailingData) {
+  const std::string old_data = RandomData(10000, 10);
+  const std::string patch = BinaryPatch::Create(old_data, old_data);
+  std::string result;
+  EXPECT_EQ(BinaryPatch::kCorruptPatch,
+            ApplyPatch(old_data, patch + "x", &result));
+}
+
+TEST(BinaryPatchTest, Apply_Corrupt) {
+  const std::string old_data = RandomData(10000, 11);
+  std::string new_data = old_data;
+  new_data.insert(3000, RandomData(500, 12));
+  new_data[8000] ^= 0x10;
+  const std::string patch = BinaryPatch::Create(old_data, new_data);
+
+  // A change of the body of the patch either fails to apply or does not
+  // change the new file, as with the seek of the last block.
+  for (size_t i = BinaryPatch::kHeaderSize; i < patch.size(); ++i) {
+    std::string corrupt_patch = patch;
+    corrupt_patch[i] ^= 0x01;
+    std::string result;
+    const BinaryPatch::Result apply_result =
+        ApplyPatch(old_data, corrupt_patch, &result);
+    if (apply_result == BinaryPatch::kSuccess) {
+      EXPECT_TRUE(result == new_data);
+    } else {
+      EXPECT_TRUE(apply_result == BinaryPatch::kCorruptPatch ||
+                  apply_result == BinaryPatch::kOutputMismatch);
+    }
+  }
+}
+
+TEST(BinaryPatchTest, Apply_WriteError) {
+  class FailingWriter : public BinaryPatch::Writer {
+   public:
+    bool Write(const uint8_t*, size_t) override { return false; }
+  };
+
+  const std::string old_data = RandomData(1000, 13);
+  const std::string patch = BinaryPatch::Create(old_data, old_data);
+  StringSource source(old_data);
+  StringReader reader(patch, patch.size());
+  FailingWriter writer;
+  EXPECT_EQ(BinaryPatch::kWriteError,
+            BinaryPatch::Apply(&source, &reader, &writer));
+}
+
+}  // namespace omaha
@@ -106,6 +106,13 @@ const TCHAR* const kSilentDoNotKillJobObject =
 const TCHAR* const kInstallManagerSerializer =
     _T("{0A175FBE-AEEC-4fea-855A-2AA549A88846}");
 
+// Prefix of the lock held while an app is installed, from the pre-install
+// writes to its registration check, so that two bundles which install the
+// same app do not interleave these steps. The app ID is appended to this
+// string.
+const TCHAR* const kAppInstallSerializer =
+    _T("{2C4A9D1B-5E6F-4B8A-9C3D-7E1F0A2B4C6D}");
+
 // Serializes access to metrics stores, machine and user, respectively.
 const TCHAR* const kMetricsSerializer =
     _T("{C68009EA-1163-4498-8E93-D5C4E317D8CE}");
@@ -118,6 +125,15 @@ const TCHAR* const kRegistryAccessMutex =
 const TCHAR* const kOptUserIdLock =
     _T("{D19BAF17-7C87-467E-8D63-6C4B1C836373}");
 
+// Serializes access to the persisted pings journal, machine and user.
+const TCHAR* const kPersistedPingsLock =
+    _T("{4F2A2EF2-E0AD-45DB-BD38-64D9CF3447A5}");
+
+// Serializes the changes to the package cache, such as the writes to its
+// catalog, across the processes which share the cache, machine and user.
+const TCHAR* const kPackageCacheLock =
+    _T("{AD21A409-284A-42E3-8529-982E05083FDB}");
+
 // Prefix used for programs with external (in-process) updaters to signal to
 // Omaha that they are currently doing an update check, and that Omaha should
 // not attempt to update it at this time.  (Conversely, it's also used by Omaha
@@ -138,6 +154,13 @@ const TCHAR* const kOptUserIdLock =
 const TCHAR* const kExternalUpdaterActivityPrefix =
     _T("UpdaterRunning");
 
+// Prefix of the event which the COM server signals when the state of the apps
+// in a bundle changes. The session ID of the bundle is appended to this
+// string, and the standard prefixes for Omaha events are prepended. The client
+// which installs the bundle waits on the event instead of polling the server.
+const TCHAR* const kBundleStateChangeEventPrefix =
+    _T("BundleStateChange");
+
 // The name of the shared memory objects containing the serialized COM
 // interface pointers exposed by the machine core.
 // TODO(omaha): Rename these constants to remove "GoogleUpdate".
@@ -284,6 +284,8 @@ const TCHAR* const kRegValueMID                     = _T("mid");
 
 const TCHAR* const kRegValueDisablePayloadAuthenticodeVerification =
     _T("DisablePayloadAuthenticodeVerification");
+const TCHAR* const kRegValueDisableContentAddressedPackageCache =
+    _T("DisableContentAddressedPackageCache");
 
 // File extensions that can be verified with an Authenticode signature.
 const TCHAR* const kAuthenticodeVerifiableExtensions[] = {
@@ -197,6 +197,10 @@ const ULONG kFacilityOmaha = 67;
 #define GOOPDATEDOWNLOAD_E_AUTHENTICODE_VERIFICATION_FAILED \
     MAKE_OMAHA_HRESULT(SEVERITY_ERROR, 0x50E)
 
+// A differential package could not be applied to any cached package.
+#define GOOPDATEDOWNLOAD_E_PATCH_FAILED             \
+    MAKE_OMAHA_HRESULT(SEVERITY_ERROR, 0x50F)
+
 #define GOOPDATEDOWNLOAD_E_FAILED_MOVE              \
     MAKE_HRESULT(SEVERITY_ERROR, FACILITY_ITF, 0x5FF)
 
@@ -409,6 +413,11 @@ const ULONG kFacilityOmaha = 67;
 #define OMAHA_NET_E_EXCEEDED_MAX_RETRY_DELAY        \
     MAKE_HRESULT(SEVERITY_ERROR, FACILITY_ITF, 0x892)
 
+// The request was not sent, because the host failed repeatedly and its
+// circuit is open, or because the host asked to retry later.
+#define OMAHA_NET_E_HOST_UNAVAILABLE                \
+    MAKE_HRESULT(SEVERITY_ERROR, FACILITY_ITF, 0x893)
+
 // Install Manager custom error codes.
 #define GOOPDATEINSTALL_E_FILENAME_INVALID         \
     MAKE_HRESULT(SEVERITY_ERROR, FACILITY_ITF, 0x900)
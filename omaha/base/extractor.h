@@ -18,6 +18,7 @@
 #define OMAHA_BASE_EXTRACTOR_H_
 
 #include <windows.h>
+#include <stdint.h>
 
 namespace omaha {
 
@@ -51,8 +52,9 @@ class TagExtractor {
     *   - Find the signature, which should be stored in the PE "Certificates
     *     Directory" (dumpbin.exe /headers "Firefox Setup 1.0.7.exe") in a
     *     WIN_CERTIFICATE structure.
-    *   - Crudely parse the ASN.1 signature to determine its end.
-    *   - Read the signature starting from the first byte past the ASN.1.
+    *   - Find the tag in the padding at the end of the directory.
+    *
+    * Only the headers and the end of the directory are read. See TagReader.
     *
     * @param tag_buffer: a buffer that will be filled with the extracted tag as
     *   a null-terminated string, or NULL if the caller doesn't want the tag.
@@ -72,32 +74,9 @@ class TagExtractor {
                     char* tag_buffer,
                     int* tag_buffer_len);
 
-    int cert_dir_length() const { return cert_dir_length_; }
-    const void* cert_dir_base() const { return cert_dir_base_; }
-
  private:
   HANDLE file_handle_;
-  HANDLE file_mapping_;
-  LPVOID file_base_;
-  size_t file_length_;
-  int cert_dir_length_;
-  const void* cert_dir_base_;
-
-  bool ReadTag(const char* read_base,
-               char* tag_buffer,
-               int* tag_buffer_len) const;
-
-  const IMAGE_DATA_DIRECTORY* GetCertificateDirectory(const void* base) const;
-
-  const void* GetASN1SignaturePointer(const void* base) const;
-
-  int GetASN1SignatureLength(const void* base) const;
-
-  bool InternalExtractTag(const char* file_buffer,
-                          char* tag_buffer,
-                          int* tag_buffer_len);
-
-  bool InternalReadCertificate(const char* file_buffer);
+  uint64_t file_length_;
 };
 
 }  // namespace omaha
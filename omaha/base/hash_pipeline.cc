@@ -0,0 +1,128 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/base/hash_pipeline.h"
+
+#include <string.h>
+
+#include <thread>
+
+namespace omaha {
+
+HashPipeline::HashPipeline()
+    : storage_(kNumBlocks * kBlockSize + kBlockAlignment),
+      hash_index_(0),
+      num_read_(0),
+      is_read_done_(false),
+      has_failed_(false) {
+  const uintptr_t address = reinterpret_cast<uintptr_t>(storage_.data());
+  uint8_t* first_block = storage_.data() +
+      (kBlockAlignment - address % kBlockAlignment) % kBlockAlignment;
+  for (size_t i = 0; i != kNumBlocks; ++i) {
+    blocks_[i] = first_block + i * kBlockSize;
+    sizes_[i] = 0;
+  }
+}
+
+HashPipeline::~HashPipeline() {
+}
+
+bool HashPipeline::Hash(size_t num_sources,
+                        const Reader& reader,
+                        uint8_t digest[SHA256_DIGEST_SIZE]) {
+  hash_index_ = 0;
+  num_read_ = 0;
+  is_read_done_ = false;
+  has_failed_ = false;
+
+  LITE_SHA256_CTX hash;
+  SHA256_init(&hash);
+
+  std::thread reader_thread([this, num_sources, &reader]() {
+    ReadBlocks(num_sources, reader);
+  });
+
+  for (;;) {
+    size_t size = 0;
+    {
+      std::unique_lock<std::mutex> lock(lock_);
+      changed_.wait(lock, [this]() {
+        return num_read_ || is_read_done_;
+      });
+      if (has_failed_ || !num_read_) {
+        break;
+      }
+      size = sizes_[hash_index_];
+    }
+
+    // The block is not changed by the reader thread until it is hashed.
+    SHA256_update(&hash, blocks_[hash_index_], size);
+
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      hash_index_ = (hash_index_ + 1) % kNumBlocks;
+      --num_read_;
+    }
+    changed_.notify_all();
+  }
+
+  reader_thread.join();
+  if (has_failed_) {
+    return false;
+  }
+
+  memcpy(digest, SHA256_final(&hash), SHA256_DIGEST_SIZE);
+  return true;
+}
+
+void HashPipeline::ReadBlocks(size_t num_sources, const Reader& reader) {
+  size_t read_index = 0;
+  bool has_failed = false;
+  for (size_t i = 0; i != num_sources && !has_failed; ++i) {
+    size_t bytes_read = 0;
+    do {
+      {
+        std::unique_lock<std::mutex> lock(lock_);
+        changed_.wait(lock, [this]() { return num_read_ < kNumBlocks; });
+      }
+
+      bytes_read = 0;
+      if (!reader(i, blocks_[read_index], kBlockSize, &bytes_read)) {
+        has_failed = true;
+        break;
+      }
+      if (!bytes_read) {
+        break;
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(lock_);
+        sizes_[read_index] = bytes_read;
+        ++num_read_;
+      }
+      changed_.notify_all();
+      read_index = (read_index + 1) % kNumBlocks;
+    } while (bytes_read == kBlockSize);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    is_read_done_ = true;
+    has_failed_ = has_failed;
+  }
+  changed_.notify_all();
+}
+
+}  // namespace omaha
@@ -0,0 +1,94 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// HashPipeline overlaps reading a sequence of sources, such as files, with
+// hashing them with SHA-256. A reader thread reads the sources ahead, in order,
+// into a ring of large aligned blocks, while the calling thread hashes the
+// blocks already read. The reader moves on to the next source as soon as a
+// source ends, so the pipeline does not drain between the sources. The blocks
+// are allocated once, when the pipeline is created.
+//
+// This file has no platform dependencies.
+
+#ifndef OMAHA_BASE_HASH_PIPELINE_H_
+#define OMAHA_BASE_HASH_PIPELINE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "omaha/base/security/sha256.h"
+
+namespace omaha {
+
+class HashPipeline {
+ public:
+  // Reads up to |size| bytes of the source |index| into |buffer|, and returns
+  // the number of bytes read in |bytes_read|. Fewer than |size| bytes are read
+  // only at the end of the source. Returns false if the read fails, which
+  // stops the pipeline.
+  typedef std::function<bool(size_t index,
+                             uint8_t* buffer,
+                             size_t size,
+                             size_t* bytes_read)> Reader;
+
+  enum {
+    kBlockSize = 1024 * 1024,
+    kBlockAlignment = 4096,
+    kNumBlocks = 4,
+  };
+
+  HashPipeline();
+  ~HashPipeline();
+
+  // Hashes the bytes of |num_sources| sources read by |reader|, as if they
+  // were one stream, and stores the digest in |digest|. Returns false if a
+  // read failed.
+  bool Hash(size_t num_sources,
+            const Reader& reader,
+            uint8_t digest[SHA256_DIGEST_SIZE]);
+
+ private:
+  // Reads the sources into the blocks until they end or a read fails.
+  void ReadBlocks(size_t num_sources, const Reader& reader);
+
+  std::mutex lock_;
+  std::condition_variable changed_;
+
+  std::vector<uint8_t> storage_;
+  uint8_t* blocks_[kNumBlocks];
+
+  // The number of bytes read into each block.
+  size_t sizes_[kNumBlocks];
+
+  // The blocks read and not yet hashed start at |hash_index_|. The reader
+  // reads into the block which follows them.
+  size_t hash_index_;
+  size_t num_read_;
+
+  bool is_read_done_;
+  bool has_failed_;
+
+  DISALLOW_COPY_AND_ASSIGN(HashPipeline);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_BASE_HASH_PIPELINE_H_
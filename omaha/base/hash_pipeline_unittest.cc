@@ -0,0 +1,217 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/base/hash_pipeline.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace omaha {
+
+namespace {
+
+std::string Digest(const std::string& data) {
+  uint8_t digest[SHA256_DIGEST_SIZE] = {};
+  SHA256_hash(data.data(), data.size(), digest);
+  return std::string(reinterpret_cast<const char*>(digest), sizeof(digest));
+}
+
+std::string MakeData(size_t size, int seed) {
+  std::string data(size, '\0');
+  for (size_t i = 0; i != size; ++i) {
+    data[i] = static_cast<char>((i * 31 + seed) ^ (i >> 12));
+  }
+  return data;
+}
+
+// Reads in-memory sources, at most |max_read| bytes at a time, as a file
+// read would at its end.
+class MemoryReader {
+ public:
+  explicit MemoryReader(const std::vector<std::string>& sources)
+      : sources_(sources), offsets_(sources.size()), fail_at_(-1) {}
+
+  bool Read(size_t index, uint8_t* buffer, size_t size, size_t* bytes_read) {
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(buffer) %
+                  HashPipeline::kBlockAlignment);
+    if (static_cast<int>(index) == fail_at_) {
+      return false;
+    }
+    const std::string& source = sources_[index];
+    *bytes_read = std::min(size, source.size() - offsets_[index]);
+    memcpy(buffer, source.data() + offsets_[index], *bytes_read);
+    offsets_[index] += *bytes_read;
+    return true;
+  }
+
+  void set_fail_at(int index) { fail_at_ = index; }
+
+ private:
+  const std::vector<std::string>& sources_;
+  std::vector<size_t> offsets_;
+  int fail_at_;
+};
+
+std::string HashSources(HashPipeline* pipeline,
+                        MemoryReader* reader,
+                        size_t num_sources) {
+  uint8_t digest[SHA256_DIGEST_SIZE] = {};
+  if (!pipeline->Hash(num_sources,
+                      [reader](size_t index,
+                               uint8_t* buffer,
+                               size_t size,
+                               size_t* bytes_read) {
+                        return reader->Read(index, buffer, size, bytes_read);
+                      },
+                      digest)) {
+    return std::string();
+  }
+  return std::string(reinterpret_cast<const char*>(digest), sizeof(digest));
+}
+
+}  // namespace
+
+// The sources are hashed as one stream, whatever their sizes relative to the
+// blocks.
+TEST(HashPipelineTest, HashesSourcesInOrder) {
+  const size_t kBlockSize = HashPipeline::kBlockSize;
+  const std::vector<std::vector<size_t>> cases = {
+    {0},
+    {1},
+    {kBlockSize - 1, 0, 1},
+    {kBlockSize, kBlockSize},
+    {3 * kBlockSize + 17, 5, 0, 2 * kBlockSize},
+    {9 * kBlockSize + 1},
+  };
+
+  HashPipeline pipeline;
+  for (size_t i = 0; i != cases.size(); ++i) {
+    std::vector<std::string> sources;
+    std::string all;
+    for (size_t j = 0; j != cases[i].size(); ++j) {
+      sources.push_back(MakeData(cases[i][j], static_cast<int>(j)));
+      all += sources.back();
+    }
+
+    // The pipeline is reused.
+    MemoryReader reader(sources);
+    EXPECT_EQ(Digest(all), HashSources(&pipeline, &reader, sources.size()))
+        << i;
+  }
+}
+
+TEST(HashPipelineTest, ReadFails) {
+  const std::vector<std::string> sources = {
+    MakeData(5 * HashPipeline::kBlockSize, 1),
+    MakeData(5 * HashPipeline::kBlockSize, 2),
+  };
+
+  HashPipeline pipeline;
+  MemoryReader reader(sources);
+  reader.set_fail_at(1);
+  EXPECT_TRUE(HashSources(&pipeline, &reader, sources.size()).empty());
+
+  MemoryReader other_reader(sources);
+  EXPECT_EQ(Digest(sources[0] + sources[1]),
+            HashSources(&pipeline, &other_reader, sources.size()));
+}
+
+// Compares reading then hashing each block on one thread, as
+// VerifyFileHashSha256 did, with the pipeline.
+TEST(HashPipelineTest, VerifyBenchmark) {
+  const std::filesystem::path dir =
+      std::filesystem::temp_directory_path() / "hash_pipeline_benchmark";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+
+  const int kNumFiles = 4;
+  const size_t kFileSize = 32 * 1024 * 1024;
+  std::vector<std::string> filenames;
+  for (int i = 0; i != kNumFiles; ++i) {
+    filenames.push_back((dir / ("file" + std::to_string(i))).string());
+    const std::string data(MakeData(kFileSize, i));
+    FILE* file = fopen(filenames.back().c_str(), "wb");
+    ASSERT_TRUE(file);
+    ASSERT_EQ(data.size(), fwrite(data.data(), 1, data.size(), file));
+    fclose(file);
+  }
+  const double total_mb = kNumFiles * kFileSize / (1024.0 * 1024.0);
+
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  LITE_SHA256_CTX hash;
+  SHA256_init(&hash);
+  std::vector<uint8_t> buffer(HashPipeline::kBlockSize);
+  for (int i = 0; i != kNumFiles; ++i) {
+    FILE* file = fopen(filenames[i].c_str(), "rb");
+    ASSERT_TRUE(file);
+    size_t bytes_read = 0;
+    do {
+      bytes_read = fread(buffer.data(), 1, buffer.size(), file);
+      SHA256_update(&hash, buffer.data(), bytes_read);
+    } while (bytes_read == buffer.size());
+    fclose(file);
+  }
+  const std::string sequential_digest(
+      reinterpret_cast<const char*>(SHA256_final(&hash)), SHA256_DIGEST_SIZE);
+  const std::chrono::duration<double, std::milli> sequential_time =
+      std::chrono::steady_clock::now() - start;
+
+  start = std::chrono::steady_clock::now();
+  std::vector<FILE*> files;
+  for (int i = 0; i != kNumFiles; ++i) {
+    files.push_back(fopen(filenames[i].c_str(), "rb"));
+    ASSERT_TRUE(files.back());
+  }
+  HashPipeline pipeline;
+  uint8_t digest[SHA256_DIGEST_SIZE] = {};
+  ASSERT_TRUE(pipeline.Hash(
+      files.size(),
+      [&files](size_t index, uint8_t* buffer, size_t size, size_t* bytes_read) {
+        *bytes_read = fread(buffer, 1, size, files[index]);
+        return !ferror(files[index]);
+      },
+      digest));
+  for (size_t i = 0; i != files.size(); ++i) {
+    fclose(files[i]);
+  }
+  const std::chrono::duration<double, std::milli> pipeline_time =
+      std::chrono::steady_clock::now() - start;
+
+  EXPECT_EQ(sequential_digest,
+            std::string(reinterpret_cast<const char*>(digest),
+                        sizeof(digest)));
+
+  std::cout << kNumFiles << " files, " << total_mb << " MB: "
+            << "read then hash " << sequential_time.count() << " ms ("
+            << total_mb * 1000 / sequential_time.count() << " MB/s), "
+            << "pipeline " << pipeline_time.count() << " ms ("
+            << total_mb * 1000 / pipeline_time.count() << " MB/s)"
+            << std::endl;
+
+  std::filesystem::remove_all(dir);
+}
+
+}  // namespace omaha
@@ -0,0 +1,330 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/base/parallel_extractor.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <set>
+#include <system_error>
+#include <thread>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#elif defined(_WIN32)
+#include <io.h>
+#endif
+
+namespace omaha {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+// Returns |name| with '/' separators and without trailing separators.
+std::string NormalizeEntryName(const std::string& name) {
+  std::string normalized(name);
+  std::replace(normalized.begin(), normalized.end(), '\\', '/');
+  while (!normalized.empty() && normalized.back() == '/') {
+    normalized.pop_back();
+  }
+  return normalized;
+}
+
+fs::path EntryPath(const fs::path& dir, const std::string& name) {
+  return dir / fs::u8path(NormalizeEntryName(name));
+}
+
+// Creates a new directory under |to_dir| for the extracted entries.
+bool CreateStagingDir(const fs::path& to_dir, fs::path* staging_dir) {
+  const uint64_t seed = static_cast<uint64_t>(
+      std::chrono::steady_clock::now().time_since_epoch().count());
+  for (int attempt = 0; attempt != 100; ++attempt) {
+    const fs::path dir =
+        to_dir / (".extract." + std::to_string(seed + attempt));
+    std::error_code ec;
+    if (fs::create_directory(dir, ec)) {
+      *staging_dir = dir;
+      return true;
+    }
+    if (ec) {
+      return false;
+    }
+  }
+  return false;
+}
+
+// Reserves |size| bytes for |file|. The reservation is a hint: the file is
+// written whether or not it succeeds.
+void Preallocate(FILE* file, uint64_t size) {
+  if (!size) {
+    return;
+  }
+#if defined(__linux__)
+  posix_fallocate(fileno(file), 0, static_cast<off_t>(size));
+#elif defined(_WIN32)
+  _chsize_s(_fileno(file), static_cast<__int64>(size));
+#else
+  (void)file;
+#endif
+}
+
+FILE* OpenForWrite(const fs::path& path) {
+#if defined(_WIN32)
+  return _wfopen(path.c_str(), L"wb");
+#else
+  return fopen(path.c_str(), "wb");
+#endif
+}
+
+ParallelExtractor::Result ExtractEntry(ParallelExtractor::Reader* reader,
+                                       size_t index,
+                                       const ParallelExtractor::Entry& entry,
+                                       const fs::path& path,
+                                       std::vector<uint8_t>* buffer,
+                                       const std::atomic<bool>& cancel) {
+  if (!reader->Open(index)) {
+    return ParallelExtractor::kReadError;
+  }
+
+  FILE* file = OpenForWrite(path);
+  if (!file) {
+    return ParallelExtractor::kWriteError;
+  }
+  setvbuf(file, NULL, _IONBF, 0);
+  Preallocate(file, entry.size);
+
+  ParallelExtractor::Result result = ParallelExtractor::kSuccess;
+  uint64_t written = 0;
+  while (!cancel) {
+    const int64_t read = reader->Read(buffer->data(), buffer->size());
+    if (read < 0 || written + read > entry.size) {
+      result = ParallelExtractor::kReadError;
+      break;
+    }
+    if (!read) {
+      break;
+    }
+    if (fwrite(buffer->data(), 1, static_cast<size_t>(read), file) !=
+        static_cast<size_t>(read)) {
+      result = ParallelExtractor::kWriteError;
+      break;
+    }
+    written += read;
+  }
+
+  if (fclose(file) && result == ParallelExtractor::kSuccess) {
+    result = ParallelExtractor::kWriteError;
+  }
+  if (result == ParallelExtractor::kSuccess && !cancel &&
+      written != entry.size) {
+    result = ParallelExtractor::kReadError;
+  }
+  return result;
+}
+
+// Moves the staged entries into |to_dir|.
+bool Commit(const std::vector<ParallelExtractor::Entry>& entries,
+            const fs::path& staging_dir,
+            const fs::path& to_dir) {
+  for (size_t i = 0; i != entries.size(); ++i) {
+    const ParallelExtractor::Entry& entry = entries[i];
+    const fs::path target = EntryPath(to_dir, entry.name);
+    std::error_code ec;
+    if (entry.is_directory) {
+      fs::create_directories(target, ec);
+      if (ec) {
+        return false;
+      }
+      continue;
+    }
+
+    fs::create_directories(target.parent_path(), ec);
+    if (ec) {
+      return false;
+    }
+    if (fs::is_directory(target, ec)) {
+      return false;
+    }
+    fs::rename(EntryPath(staging_dir, entry.name), target, ec);
+    if (ec) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+bool ParallelExtractor::IsSafeEntryName(const std::string& name) {
+  if (name.empty() || name[0] == '/' || name[0] == '\\' ||
+      name.find(':') != std::string::npos) {
+    return false;
+  }
+
+  const std::string normalized = NormalizeEntryName(name);
+  if (normalized.empty()) {
+    return false;
+  }
+  size_t start = 0;
+  while (start <= normalized.size()) {
+    size_t end = normalized.find('/', start);
+    if (end == std::string::npos) {
+      end = normalized.size();
+    }
+    if (normalized.compare(start, end - start, "..") == 0) {
+      return false;
+    }
+    start = end + 1;
+  }
+  return true;
+}
+
+ParallelExtractor::Result ParallelExtractor::Extract(Archive* archive,
+                                                     const Verifier& verifier,
+                                                     const std::string& to_dir,
+                                                     size_t num_threads) {
+  const std::vector<Entry>& entries = archive->entries();
+
+  // Check every name before anything is written.
+  std::vector<size_t> files;
+  std::set<std::string> file_names;
+  for (size_t i = 0; i != entries.size(); ++i) {
+    if (!IsSafeEntryName(entries[i].name)) {
+      return kInvalidEntry;
+    }
+    if (entries[i].is_directory) {
+      continue;
+    }
+    if (!file_names.insert(NormalizeEntryName(entries[i].name)).second) {
+      return kInvalidEntry;
+    }
+    files.push_back(i);
+  }
+
+  const fs::path to_path = fs::u8path(to_dir);
+  std::error_code ec;
+  fs::create_directories(to_path, ec);
+  fs::path staging_dir;
+  if (ec || !CreateStagingDir(to_path, &staging_dir)) {
+    return kWriteError;
+  }
+
+  // Create the directories up front, so that the threads only create files.
+  Result result = kSuccess;
+  for (size_t i = 0; i != entries.size() && result == kSuccess; ++i) {
+    const fs::path path = EntryPath(staging_dir, entries[i].name);
+    fs::create_directories(entries[i].is_directory ? path : path.parent_path(),
+                           ec);
+    if (ec) {
+      result = kWriteError;
+    }
+  }
+
+  // The largest entries go first, so that no thread is left with a large
+  // entry at the end.
+  std::stable_sort(files.begin(), files.end(), [&entries](size_t a, size_t b) {
+    return entries[a].size > entries[b].size;
+  });
+
+  if (!num_threads) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  num_threads = std::min(num_threads, files.size());
+
+  std::atomic<size_t> next_file(0);
+  std::atomic<bool> cancel(result != kSuccess);
+  std::atomic<int> extract_result(kSuccess);
+  auto fail = [&extract_result, &cancel](Result error) {
+    int expected = kSuccess;
+    extract_result.compare_exchange_strong(expected, error);
+    cancel = true;
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads);
+  for (size_t i = 0; i != num_threads; ++i) {
+    threads.emplace_back([&]() {
+      std::unique_ptr<Reader> reader(archive->CreateReader());
+      if (!reader) {
+        fail(kReadError);
+        return;
+      }
+      std::vector<uint8_t> buffer(kBufferSize);
+      while (!cancel) {
+        const size_t next = next_file++;
+        if (next >= files.size()) {
+          break;
+        }
+        const size_t index = files[next];
+        const Result entry_result =
+            ExtractEntry(reader.get(),
+                         index,
+                         entries[index],
+                         EntryPath(staging_dir, entries[index].name),
+                         &buffer,
+                         cancel);
+        if (entry_result != kSuccess) {
+          fail(entry_result);
+        }
+      }
+    });
+  }
+
+  const bool verified = verifier();
+  if (!verified) {
+    cancel = true;
+  }
+  for (size_t i = 0; i != threads.size(); ++i) {
+    threads[i].join();
+  }
+
+  if (!verified) {
+    result = kVerificationFailed;
+  } else if (result == kSuccess) {
+    result = static_cast<Result>(extract_result.load());
+  }
+  if (result == kSuccess && !Commit(entries, staging_dir, to_path)) {
+    result = kCommitError;
+  }
+
+  fs::remove_all(staging_dir, ec);
+  return result;
+}
+
+const char* ParallelExtractor::ResultToString(Result result) {
+  switch (result) {
+    case kSuccess:
+      return "success";
+    case kInvalidEntry:
+      return "invalid entry";
+    case kReadError:
+      return "read error";
+    case kWriteError:
+      return "write error";
+    case kVerificationFailed:
+      return "verification failed";
+    case kCommitError:
+      return "commit error";
+    default:
+      return "unknown";
+  }
+}
+
+}  // namespace omaha
@@ -0,0 +1,115 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// ParallelExtractor extracts the entries of an archive on several threads
+// while the archive is verified on the calling thread, and commits the
+// extracted files only if the verification succeeds.
+//
+// The files are extracted into a staging directory under the output
+// directory. Each output file is preallocated to the size of its entry
+// before it is written, and the largest entries are extracted first. When
+// both the extraction and the verification succeed, the staged entries are
+// moved into the output directory. Otherwise the staging directory is
+// removed, and nothing is left in the output directory.
+//
+// Apart from the preallocation of files, this file has no platform
+// dependencies.
+
+#ifndef OMAHA_BASE_PARALLEL_EXTRACTOR_H_
+#define OMAHA_BASE_PARALLEL_EXTRACTOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+
+namespace omaha {
+
+class ParallelExtractor {
+ public:
+  struct Entry {
+    // The path of the entry relative to the output directory, separated by
+    // '/' or '\'. The names of directories may end with a separator.
+    std::string name;
+    uint64_t size = 0;
+    bool is_directory = false;
+  };
+
+  // Reads the entries of an archive. A reader is used by one thread at a
+  // time, and several readers of the same archive are used concurrently.
+  class Reader {
+   public:
+    virtual ~Reader() {}
+
+    // Starts reading the entry at |index|.
+    virtual bool Open(size_t index) = 0;
+
+    // Reads at most |size| bytes of the open entry. Returns the number of
+    // bytes read, 0 at the end of the entry, or -1 on error.
+    virtual int64_t Read(uint8_t* buffer, size_t size) = 0;
+  };
+
+  class Archive {
+   public:
+    virtual ~Archive() {}
+    virtual const std::vector<Entry>& entries() const = 0;
+
+    // Returns a new reader, or NULL on error. Called once by each thread.
+    virtual std::unique_ptr<Reader> CreateReader() = 0;
+  };
+
+  // Returns true if the archive is authentic. Runs on the calling thread
+  // while the entries are extracted.
+  typedef std::function<bool()> Verifier;
+
+  enum Result {
+    kSuccess = 0,
+    kInvalidEntry,        // An entry is empty, absolute, or contains "..".
+    kReadError,           // An entry cannot be read, or has the wrong size.
+    kWriteError,
+    kVerificationFailed,
+    kCommitError,         // The staged entries cannot be moved.
+  };
+
+  // The size of the buffer of each thread.
+  static const size_t kBufferSize = 64 * 1024;
+
+  // Extracts |archive| into |to_dir|, which is created if needed, on
+  // |num_threads| threads, or one per core if |num_threads| is 0. Entries
+  // already in |to_dir| are replaced. Returns kVerificationFailed if
+  // |verifier| fails, whether or not the extraction succeeds.
+  static Result Extract(Archive* archive,
+                        const Verifier& verifier,
+                        const std::string& to_dir,
+                        size_t num_threads);
+
+  // Returns true if |name| is a relative path that stays within the output
+  // directory.
+  static bool IsSafeEntryName(const std::string& name);
+
+  static const char* ResultToString(Result result);
+
+ private:
+  DISALLOW_IMPLICIT_CONSTRUCTORS(ParallelExtractor);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_BASE_PARALLEL_EXTRACTOR_H_
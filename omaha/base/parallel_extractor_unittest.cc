@@ -0,0 +1,424 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/base/parallel_extractor.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace omaha {
+
+namespace {
+
+// An archive held in memory. The contents of an entry are either given, or
+// generated from a seed, at roughly the speed at which zlib inflates.
+class TestArchive : public ParallelExtractor::Archive {
+ public:
+  TestArchive() : fail_index_(-1) {}
+
+  void AddDirectory(const std::string& name) {
+    ParallelExtractor::Entry entry;
+    entry.name = name;
+    entry.is_directory = true;
+    entries_.push_back(entry);
+    contents_.push_back(std::string());
+    seeds_.push_back(0);
+  }
+
+  void AddFile(const std::string& name, const std::string& contents) {
+    ParallelExtractor::Entry entry;
+    entry.name = name;
+    entry.size = contents.size();
+    entries_.push_back(entry);
+    contents_.push_back(contents);
+    seeds_.push_back(0);
+  }
+
+  void AddGeneratedFile(const std::string& name,
+                        uint64_t size,
+                        uint64_t seed) {
+    ParallelExtractor::Entry entry;
+    entry.name = name;
+    entry.size = size;
+    entries_.push_back(entry);
+    contents_.push_back(std::string());
+    seeds_.push_back(seed);
+  }
+
+  // Makes the entry at |index| fail to read.
+  void set_fail_index(int index) { fail_index_ = index; }
+
+  // Makes the entry at |index| declare a different size than its contents.
+  void set_declared_size(size_t index, uint64_t size) {
+    entries_[index].size = size;
+  }
+
+  const std::vector<ParallelExtractor::Entry>& entries() const override {
+    return entries_;
+  }
+
+  std::unique_ptr<ParallelExtractor::Reader> CreateReader() override {
+    return std::unique_ptr<ParallelExtractor::Reader>(new TestReader(this));
+  }
+
+  // Fills |buffer| with the generated contents which start at |offset|.
+  static void Generate(uint64_t seed,
+                       uint64_t offset,
+                       uint8_t* buffer,
+                       size_t size) {
+    for (size_t i = 0; i != size; ++i) {
+      uint64_t x = seed + offset + i;
+      for (int round = 0; round != 4; ++round) {
+        x ^= x >> 31;
+        x *= 0x9E3779B97F4A7C15ULL;
+      }
+      buffer[i] = static_cast<uint8_t>(x >> 56);
+    }
+  }
+
+ private:
+  class TestReader : public ParallelExtractor::Reader {
+   public:
+    explicit TestReader(TestArchive* archive)
+        : archive_(archive), index_(0), offset_(0) {}
+
+    bool Open(size_t index) override {
+      if (static_cast<int>(index) == archive_->fail_index_) {
+        return false;
+      }
+      index_ = index;
+      offset_ = 0;
+      return true;
+    }
+
+    int64_t Read(uint8_t* buffer, size_t size) override {
+      const uint64_t seed = archive_->seeds_[index_];
+      const std::string& contents = archive_->contents_[index_];
+      const uint64_t length =
+          seed ? archive_->entries_[index_].size : contents.size();
+      const size_t count =
+          static_cast<size_t>(std::min<uint64_t>(size, length - offset_));
+      if (seed) {
+        Generate(seed, offset_, buffer, count);
+      } else {
+        memcpy(buffer, contents.data() + offset_, count);
+      }
+      offset_ += count;
+      return static_cast<int64_t>(count);
+    }
+
+   private:
+    TestArchive* const archive_;
+    size_t index_;
+    uint64_t offset_;
+
+    DISALLOW_COPY_AND_ASSIGN(TestReader);
+  };
+
+  std::vector<ParallelExtractor::Entry> entries_;
+  std::vector<std::string> contents_;
+  std::vector<uint64_t> seeds_;
+  int fail_index_;
+
+  DISALLOW_COPY_AND_ASSIGN(TestArchive);
+};
+
+std::string ReadFile(const std::filesystem::path& path) {
+  std::ifstream file(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file),
+                     std::istreambuf_iterator<char>());
+}
+
+void WriteFile(const std::filesystem::path& path, const std::string& data) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write(data.data(), data.size());
+}
+
+std::filesystem::path MakeTempDir(const char* name) {
+  const std::filesystem::path dir =
+      std::filesystem::temp_directory_path() /
+      (std::string(name) + "_" +
+       std::to_string(reinterpret_cast<uintptr_t>(&dir)));
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  return dir;
+}
+
+size_t CountFiles(const std::filesystem::path& dir) {
+  return std::distance(std::filesystem::recursive_directory_iterator(dir),
+                       std::filesystem::recursive_directory_iterator());
+}
+
+bool Succeed() {
+  return true;
+}
+
+bool Fail() {
+  return false;
+}
+
+}  // namespace
+
+TEST(ParallelExtractorTest, IsSafeEntryName) {
+  EXPECT_TRUE(ParallelExtractor::IsSafeEntryName("file.exe"));
+  EXPECT_TRUE(ParallelExtractor::IsSafeEntryName("dir/"));
+  EXPECT_TRUE(ParallelExtractor::IsSafeEntryName("dir\\sub\\file.dll"));
+  EXPECT_TRUE(ParallelExtractor::IsSafeEntryName("dir/..file"));
+
+  EXPECT_FALSE(ParallelExtractor::IsSafeEntryName(""));
+  EXPECT_FALSE(ParallelExtractor::IsSafeEntryName("/"));
+  EXPECT_FALSE(ParallelExtractor::IsSafeEntryName("/etc/passwd"));
+  EXPECT_FALSE(ParallelExtractor::IsSafeEntryName("\\windows\\file"));
+  EXPECT_FALSE(ParallelExtractor::IsSafeEntryName("c:\\windows\\file"));
+  EXPECT_FALSE(ParallelExtractor::IsSafeEntryName("file:stream"));
+  EXPECT_FALSE(ParallelExtractor::IsSafeEntryName(".."));
+  EXPECT_FALSE(ParallelExtractor::IsSafeEntryName("../file"));
+  EXPECT_FALSE(ParallelExtractor::IsSafeEntryName("dir/../../file"));
+  EXPECT_FALSE(ParallelExtractor::IsSafeEntryName("dir\\..\\..\\file"));
+  EXPECT_FALSE(ParallelExtractor::IsSafeEntryName("dir/.."));
+}
+
+TEST(ParallelExtractorTest, Extract) {
+  const std::filesystem::path dir = MakeTempDir("parallel_extractor_unittest");
+  const std::filesystem::path to_dir = dir / "out";
+
+  std::string large(3 * ParallelExtractor::kBufferSize + 17, '\0');
+  for (size_t i = 0; i != large.size(); ++i) {
+    large[i] = static_cast<char>(i * 7);
+  }
+
+  TestArchive archive;
+  archive.AddDirectory("empty/");
+  archive.AddDirectory("dir/");
+  archive.AddFile("dir/small.txt", "small");
+  archive.AddFile("dir\\sub\\large.bin", large);
+  archive.AddFile("nodir/file.txt", "no directory entry");
+  archive.AddFile("zero", "");
+  archive.AddFile("GoogleUpdateSetup.exe", "MZ");
+
+  for (size_t num_threads = 0; num_threads != 4; ++num_threads) {
+    std::filesystem::remove_all(to_dir);
+    ASSERT_EQ(ParallelExtractor::kSuccess,
+              ParallelExtractor::Extract(&archive,
+                                         Succeed,
+                                         to_dir.string(),
+                                         num_threads));
+
+    EXPECT_TRUE(std::filesystem::is_directory(to_dir / "empty"));
+    EXPECT_EQ("small", ReadFile(to_dir / "dir" / "small.txt"));
+    EXPECT_TRUE(large == ReadFile(to_dir / "dir" / "sub" / "large.bin"));
+    EXPECT_EQ("no directory entry", ReadFile(to_dir / "nodir" / "file.txt"));
+    EXPECT_TRUE(std::filesystem::exists(to_dir / "zero"));
+    EXPECT_EQ(0u, std::filesystem::file_size(to_dir / "zero"));
+    EXPECT_EQ("MZ", ReadFile(to_dir / "GoogleUpdateSetup.exe"));
+
+    // The staging directory is removed.
+    EXPECT_EQ(9u, CountFiles(to_dir));
+  }
+
+  std::filesystem::remove_all(dir);
+}
+
+TEST(ParallelExtractorTest, Extract_ReplacesExistingFiles) {
+  const std::filesystem::path dir = MakeTempDir("parallel_extractor_unittest");
+  WriteFile(dir / "file.txt", "old contents which are longer");
+  WriteFile(dir / "other.txt", "other");
+
+  TestArchive archive;
+  archive.AddFile("file.txt", "new");
+  EXPECT_EQ(ParallelExtractor::kSuccess,
+            ParallelExtractor::Extract(&archive, Succeed, dir.string(), 2));
+
+  EXPECT_EQ("new", ReadFile(dir / "file.txt"));
+  EXPECT_EQ("other", ReadFile(dir / "other.txt"));
+  EXPECT_EQ(2u, CountFiles(dir));
+
+  std::filesystem::remove_all(dir);
+}
+
+TEST(ParallelExtractorTest, Extract_VerificationFailed) {
+  const std::filesystem::path dir = MakeTempDir("parallel_extractor_unittest");
+  WriteFile(dir / "file.txt", "old");
+
+  TestArchive archive;
+  archive.AddDirectory("dir/");
+  archive.AddFile("dir/file.txt", "new");
+  archive.AddFile("file.txt", "new");
+  archive.AddGeneratedFile("large.bin", 4 * 1024 * 1024, 1);
+
+  // The verification fails while the entries are extracted, or after.
+  EXPECT_EQ(ParallelExtractor::kVerificationFailed,
+            ParallelExtractor::Extract(&archive, Fail, dir.string(), 4));
+  EXPECT_EQ(ParallelExtractor::kVerificationFailed,
+            ParallelExtractor::Extract(&archive,
+                                       []() {
+                                         std::this_thread::sleep_for(
+                                             std::chrono::milliseconds(50));
+                                         return false;
+                                       },
+                                       dir.string(),
+                                       4));
+
+  // Nothing is committed.
+  EXPECT_EQ("old", ReadFile(dir / "file.txt"));
+  EXPECT_EQ(1u, CountFiles(dir));
+
+  std::filesystem::remove_all(dir);
+}
+
+TEST(ParallelExtractorTest, Extract_InvalidEntry) {
+  const std::filesystem::path dir = MakeTempDir("parallel_extractor_unittest");
+  const std::filesystem::path to_dir = dir / "out";
+
+  const char* const kUnsafeNames[] = {
+    "../escape.txt",
+    "dir/../../escape.txt",
+    "/tmp/escape.txt",
+    "c:\\escape.txt",
+  };
+  for (size_t i = 0; i != arraysize(kUnsafeNames); ++i) {
+    TestArchive archive;
+    archive.AddFile("first.txt", "first");
+    archive.AddFile(kUnsafeNames[i], "escape");
+    EXPECT_EQ(ParallelExtractor::kInvalidEntry,
+              ParallelExtractor::Extract(&archive,
+                                         Succeed,
+                                         to_dir.string(),
+                                         2)) << kUnsafeNames[i];
+  }
+
+  // Two entries cannot be written to the same file.
+  TestArchive archive;
+  archive.AddFile("dir/file.txt", "first");
+  archive.AddFile("dir\\file.txt", "second");
+  EXPECT_EQ(ParallelExtractor::kInvalidEntry,
+            ParallelExtractor::Extract(&archive,
+                                       Succeed,
+                                       to_dir.string(),
+                                       2));
+
+  // Nothing is written.
+  EXPECT_FALSE(std::filesystem::exists(to_dir));
+  EXPECT_FALSE(std::filesystem::exists(dir / "escape.txt"));
+
+  std::filesystem::remove_all(dir);
+}
+
+TEST(ParallelExtractorTest, Extract_ReadError) {
+  const std::filesystem::path dir = MakeTempDir("parallel_extractor_unittest");
+
+  TestArchive archive;
+  archive.AddFile("a.txt", "a");
+  archive.AddFile("b.txt", "b");
+  archive.AddFile("c.txt", "c");
+  archive.set_fail_index(1);
+  EXPECT_EQ(ParallelExtractor::kReadError,
+            ParallelExtractor::Extract(&archive, Succeed, dir.string(), 3));
+  EXPECT_EQ(0u, CountFiles(dir));
+
+  // An entry is shorter or longer than it declares.
+  archive.set_fail_index(-1);
+  archive.set_declared_size(1, 2);
+  EXPECT_EQ(ParallelExtractor::kReadError,
+            ParallelExtractor::Extract(&archive, Succeed, dir.string(), 1));
+  archive.set_declared_size(1, 0);
+  EXPECT_EQ(ParallelExtractor::kReadError,
+            ParallelExtractor::Extract(&archive, Succeed, dir.string(), 1));
+  EXPECT_EQ(0u, CountFiles(dir));
+
+  std::filesystem::remove_all(dir);
+}
+
+// Compares verifying then extracting in order on one thread, as
+// crx_file::Crx3Unzip did, with verifying while extracting in parallel. The
+// entries are generated as fast as zlib inflates, and the verification
+// reads the archive once more.
+TEST(ParallelExtractorTest, ExtractBenchmark) {
+  const std::filesystem::path dir = MakeTempDir("parallel_extractor_benchmark");
+
+  const int kNumFiles = 48;
+  TestArchive archive;
+  uint64_t total_size = 0;
+  for (int i = 0; i != kNumFiles; ++i) {
+    const uint64_t size = (i % 4 + 1) * 1024 * 1024;
+    archive.AddGeneratedFile("dir" + std::to_string(i % 3) + "/file" +
+                                 std::to_string(i) + ".dll",
+                             size,
+                             i + 1);
+    total_size += size;
+  }
+
+  uint64_t checksum = 0;
+  auto verifier = [&archive, &checksum]() {
+    std::vector<uint8_t> buffer(ParallelExtractor::kBufferSize);
+    uint64_t sum = 0;
+    const std::vector<ParallelExtractor::Entry>& entries = archive.entries();
+    for (size_t i = 0; i != entries.size(); ++i) {
+      for (uint64_t offset = 0; offset < entries[i].size;
+           offset += buffer.size()) {
+        const size_t size = static_cast<size_t>(
+            std::min<uint64_t>(buffer.size(), entries[i].size - offset));
+        TestArchive::Generate(i + 1, offset, buffer.data(), size);
+        sum += buffer[size - 1];
+      }
+    }
+    checksum = sum;
+    return true;
+  };
+
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  ASSERT_TRUE(verifier());
+  ASSERT_EQ(ParallelExtractor::kSuccess,
+            ParallelExtractor::Extract(&archive,
+                                       Succeed,
+                                       (dir / "sequential").string(),
+                                       1));
+  const std::chrono::duration<double, std::milli> sequential_time =
+      std::chrono::steady_clock::now() - start;
+
+  start = std::chrono::steady_clock::now();
+  ASSERT_EQ(ParallelExtractor::kSuccess,
+            ParallelExtractor::Extract(&archive,
+                                       verifier,
+                                       (dir / "parallel").string(),
+                                       0));
+  const std::chrono::duration<double, std::milli> parallel_time =
+      std::chrono::steady_clock::now() - start;
+
+  EXPECT_NE(0u, checksum);
+  EXPECT_TRUE(ReadFile(dir / "sequential" / "dir1" / "file7.dll") ==
+              ReadFile(dir / "parallel" / "dir1" / "file7.dll"));
+
+  std::cout << kNumFiles << " entries, " << total_size << " bytes, "
+            << std::thread::hardware_concurrency() << " cores: "
+            << "verify then extract " << sequential_time.count() << " ms, "
+            << "parallel " << parallel_time.count() << " ms" << std::endl;
+
+  std::filesystem::remove_all(dir);
+}
+
+}  // namespace omaha
@@ -0,0 +1,115 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/base/record_io.h"
+
+#include <string.h>
+
+#include "omaha/base/security/sha256.h"
+
+namespace omaha {
+
+void AppendUint(uint64_t value, size_t num_bytes, std::string* out) {
+  for (size_t i = 0; i != num_bytes; ++i) {
+    out->push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+  }
+}
+
+void AppendString(const std::string& value, std::string* out) {
+  AppendUint(value.size(), 2, out);
+  out->append(value);
+}
+
+std::string RecordChecksum(const char* data, size_t size) {
+  uint8_t digest[SHA256_DIGEST_SIZE] = {};
+  SHA256_hash(data, size, digest);
+  return std::string(reinterpret_cast<const char*>(digest),
+                     kRecordChecksumSize);
+}
+
+std::string MakeRecord(uint8_t type, const std::string& payload) {
+  std::string record;
+  record.reserve(RecordSize(payload.size()));
+  record.push_back(static_cast<char>(type));
+  AppendUint(payload.size(), 4, &record);
+  record.append(payload);
+  record.append(RecordChecksum(record.data(), record.size()));
+  return record;
+}
+
+bool ReadRecord(const char* data,
+                size_t size,
+                uint8_t* type,
+                const char** payload,
+                size_t* payload_size) {
+  RecordReader header(data, size);
+  uint64_t record_type = 0;
+  uint64_t length = 0;
+  if (!header.ReadUint(1, &record_type) ||
+      !header.ReadUint(4, &length) ||
+      header.remaining() < length + kRecordChecksumSize) {
+    return false;
+  }
+
+  const size_t checked_size = kRecordHeaderSize + static_cast<size_t>(length);
+  if (RecordChecksum(data, checked_size) !=
+      std::string(data + checked_size, kRecordChecksumSize)) {
+    return false;
+  }
+
+  *type = static_cast<uint8_t>(record_type);
+  *payload = data + kRecordHeaderSize;
+  *payload_size = static_cast<size_t>(length);
+  return true;
+}
+
+bool RecordReader::ReadUint(size_t num_bytes, uint64_t* value) {
+  if (size_ - pos_ < num_bytes) {
+    return false;
+  }
+  *value = 0;
+  for (size_t i = 0; i != num_bytes; ++i) {
+    *value |= static_cast<uint64_t>(static_cast<uint8_t>(data_[pos_ + i]))
+              << (8 * i);
+  }
+  pos_ += num_bytes;
+  return true;
+}
+
+bool RecordReader::ReadBytes(size_t length, void* value) {
+  if (size_ - pos_ < length) {
+    return false;
+  }
+  memcpy(value, data_ + pos_, length);
+  pos_ += length;
+  return true;
+}
+
+bool RecordReader::ReadBytes(size_t length, std::string* value) {
+  if (size_ - pos_ < length) {
+    return false;
+  }
+  value->assign(data_ + pos_, length);
+  pos_ += length;
+  return true;
+}
+
+bool RecordReader::ReadString(std::string* value) {
+  uint64_t length = 0;
+  return ReadUint(2, &length) &&
+         ReadBytes(static_cast<size_t>(length), value);
+}
+
+}  // namespace omaha
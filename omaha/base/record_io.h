@@ -0,0 +1,101 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Helpers to serialize the small binary files which Omaha keeps on disk, such
+// as the ping journal and the package cache catalog. Integers are written in
+// little-endian order and strings are prefixed by their 2-byte length.
+//
+// A record is a type byte, the 4-byte length of the payload, the payload, and
+// a checksum of the fields before it:
+//   type     1 byte
+//   length   4 bytes
+//   payload  |length|
+//   checksum 4 bytes     The first bytes of the SHA-256 of the fields above.
+//
+// This file has no platform dependencies.
+
+#ifndef OMAHA_BASE_RECORD_IO_H_
+#define OMAHA_BASE_RECORD_IO_H_
+
+#include <stdint.h>
+
+#include <string>
+
+#include "base/basictypes.h"
+
+namespace omaha {
+
+const size_t kRecordHeaderSize = 1 + 4;
+const size_t kRecordChecksumSize = 4;
+
+// The longest string AppendString() can write.
+const size_t kMaxRecordStringLength = 0xFFFF;
+
+// Appends the |num_bytes| low-order bytes of |value| to |out|.
+void AppendUint(uint64_t value, size_t num_bytes, std::string* out);
+
+// Appends the 2-byte length of |value| followed by |value|. |value| must not
+// be longer than kMaxRecordStringLength.
+void AppendString(const std::string& value, std::string* out);
+
+// Returns the first kRecordChecksumSize bytes of the SHA-256 of |data|.
+std::string RecordChecksum(const char* data, size_t size);
+
+// Returns the record of |type| which contains |payload|.
+std::string MakeRecord(uint8_t type, const std::string& payload);
+
+// Returns the size of a record which contains |payload_size| bytes.
+inline size_t RecordSize(size_t payload_size) {
+  return kRecordHeaderSize + payload_size + kRecordChecksumSize;
+}
+
+// Reads the record at the start of |data|. Returns false if the record is
+// truncated or fails its checksum. Otherwise, returns the type of the record,
+// where its payload starts in |data|, and the size of its payload.
+bool ReadRecord(const char* data,
+                size_t size,
+                uint8_t* type,
+                const char** payload,
+                size_t* payload_size);
+
+// Reads little-endian integers and strings from a buffer, failing instead of
+// reading past its end.
+class RecordReader {
+ public:
+  RecordReader(const char* data, size_t size)
+      : data_(data), size_(size), pos_(0) {}
+
+  bool ReadUint(size_t num_bytes, uint64_t* value);
+
+  // Reads |length| bytes into |value|.
+  bool ReadBytes(size_t length, void* value);
+  bool ReadBytes(size_t length, std::string* value);
+
+  // Reads a string written by AppendString().
+  bool ReadString(std::string* value);
+
+  size_t remaining() const { return size_ - pos_; }
+
+ private:
+  const char* data_;
+  size_t size_;
+  size_t pos_;
+
+  DISALLOW_COPY_AND_ASSIGN(RecordReader);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_BASE_RECORD_IO_H_
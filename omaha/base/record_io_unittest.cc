@@ -0,0 +1,93 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/base/record_io.h"
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace omaha {
+
+TEST(RecordIoTest, AppendAndRead) {
+  std::string data;
+  AppendUint(0x0102, 2, &data);
+  AppendUint(0x0102030405060708ULL, 8, &data);
+  AppendString("abc", &data);
+  AppendString("", &data);
+  data.append("xyz");
+  EXPECT_EQ(std::string("\x02\x01", 2), data.substr(0, 2));
+
+  RecordReader reader(data.data(), data.size());
+  uint64_t value = 0;
+  EXPECT_TRUE(reader.ReadUint(2, &value));
+  EXPECT_EQ(0x0102u, value);
+  EXPECT_TRUE(reader.ReadUint(8, &value));
+  EXPECT_EQ(0x0102030405060708ULL, value);
+  std::string text;
+  EXPECT_TRUE(reader.ReadString(&text));
+  EXPECT_EQ("abc", text);
+  EXPECT_TRUE(reader.ReadString(&text));
+  EXPECT_EQ("", text);
+  EXPECT_EQ(3u, reader.remaining());
+  char bytes[2] = {};
+  EXPECT_TRUE(reader.ReadBytes(sizeof(bytes), bytes));
+  EXPECT_EQ('x', bytes[0]);
+  EXPECT_EQ('y', bytes[1]);
+
+  // Reading past the end fails and leaves the reader where it was.
+  EXPECT_FALSE(reader.ReadUint(2, &value));
+  EXPECT_FALSE(reader.ReadBytes(2, &text));
+  EXPECT_FALSE(reader.ReadString(&text));
+  EXPECT_TRUE(reader.ReadBytes(1, &text));
+  EXPECT_EQ("z", text);
+  EXPECT_EQ(0u, reader.remaining());
+}
+
+TEST(RecordIoTest, Records) {
+  const std::string record(MakeRecord(7, "payload"));
+  EXPECT_EQ(RecordSize(7), record.size());
+
+  std::string data(record + MakeRecord(8, ""));
+  uint8_t type = 0;
+  const char* payload = NULL;
+  size_t payload_size = 0;
+  ASSERT_TRUE(ReadRecord(data.data(), data.size(),
+                         &type, &payload, &payload_size));
+  EXPECT_EQ(7, type);
+  EXPECT_EQ("payload", std::string(payload, payload_size));
+
+  ASSERT_TRUE(ReadRecord(data.data() + record.size(),
+                         data.size() - record.size(),
+                         &type, &payload, &payload_size));
+  EXPECT_EQ(8, type);
+  EXPECT_EQ(0u, payload_size);
+
+  // Truncated records.
+  for (size_t size = 0; size != record.size(); ++size) {
+    EXPECT_FALSE(ReadRecord(record.data(), size,
+                            &type, &payload, &payload_size));
+  }
+
+  // Damaged records.
+  for (size_t i = 0; i != record.size(); ++i) {
+    std::string damaged(record);
+    damaged[i] ^= 0x01;
+    EXPECT_FALSE(ReadRecord(damaged.data(), damaged.size(),
+                            &type, &payload, &payload_size));
+  }
+}
+
+}  // namespace omaha
@@ -26,6 +26,7 @@
 #include "omaha/base/const_utils.h"
 #include "omaha/base/debug.h"
 #include "omaha/base/error.h"
+#include "omaha/base/hash_pipeline.h"
 #include "omaha/base/logging.h"
 #include "omaha/base/string.h"
 #include "omaha/base/utils.h"
@@ -35,9 +36,6 @@ namespace omaha {
 // Maximum file size allowed for performing authentication.
 constexpr size_t kMaxFileSizeForAuthentication = 1024 * 1024 * 1024;  // 1GB.
 
-// Buffer size used to read files from disk.
-constexpr size_t kFileReadBufferSize = 1024 * 1024;  // 1MB.
-
 namespace CryptDetails {
 
 class SHA256Hash : public HashInterface {
@@ -133,28 +131,27 @@ HRESULT CryptoHash::ComputeOrValidate(const std::vector<CString>& filepaths,
   ASSERT1(hash_in && !hash_out || !hash_in && hash_out);
   UTIL_LOG(L1, (_T("[CryptoHash::ComputeOrValidate]")));
 
+  // The files are opened and their sizes checked before any is read, so that
+  // the reads of a file follow the reads of the previous file without a
+  // pause.
   uint64 curr_len = 0;
-  std::vector<byte> buf(kFileReadBufferSize);
-  static_assert(kFileReadBufferSize <= INT_MAX);
-
-  std::unique_ptr<CryptDetails::HashInterface> hasher(
-      CryptDetails::CreateHasher());
-
+  std::vector<scoped_hfile> file_handles(filepaths.size());
   for (size_t i = 0; i < filepaths.size(); ++i) {
-    scoped_hfile file_handle(::CreateFile(filepaths[i],
-                                          FILE_READ_DATA,
-                                          FILE_SHARE_READ,
-                                          NULL,
-                                          OPEN_EXISTING,
-                                          FILE_ATTRIBUTE_NORMAL,
-                                          NULL));
-    if (!file_handle) {
+    reset(file_handles[i], ::CreateFile(filepaths[i],
+                                        FILE_READ_DATA,
+                                        FILE_SHARE_READ,
+                                        NULL,
+                                        OPEN_EXISTING,
+                                        FILE_ATTRIBUTE_NORMAL |
+                                        FILE_FLAG_SEQUENTIAL_SCAN,
+                                        NULL));
+    if (!file_handles[i]) {
       return HRESULTFromLastError();
     }
 
     if (max_len) {
       LARGE_INTEGER file_size = {0};
-      if (!::GetFileSizeEx(get(file_handle), &file_size)) {
+      if (!::GetFileSizeEx(get(file_handles[i]), &file_size)) {
         return HRESULTFromLastError();
       }
       curr_len += file_size.QuadPart;
@@ -164,27 +161,40 @@ HRESULT CryptoHash::ComputeOrValidate(const std::vector<CString>& filepaths,
         return SIGS_E_FILE_SIZE_TOO_BIG;
       }
     }
+  }
 
-    DWORD bytes_read = 0;
-    do {
-      if (!::ReadFile(get(file_handle),
-                      &buf[0],
-                      static_cast<DWORD>(buf.size()),
-                      &bytes_read,
-                      NULL)) {
-        return HRESULTFromLastError();
-      }
-
-      if (bytes_read > 0) {
-        hasher->update(&buf[0], bytes_read);
-      }
-    } while (bytes_read == buf.size());
+  // The files are read on the thread of the pipeline while the blocks already
+  // read are hashed on this thread.
+  static_assert(HashPipeline::kBlockSize <= INT_MAX);
+  HRESULT read_hr = S_OK;
+  uint8_t digest[SHA256_DIGEST_SIZE] = {0};
+  HashPipeline pipeline;
+  if (!pipeline.Hash(file_handles.size(),
+                     [&file_handles, &read_hr](size_t index,
+                                               uint8_t* buffer,
+                                               size_t size,
+                                               size_t* bytes_read) {
+                       DWORD num_bytes = 0;
+                       if (!::ReadFile(get(file_handles[index]),
+                                       buffer,
+                                       static_cast<DWORD>(size),
+                                       &num_bytes,
+                                       NULL)) {
+                         read_hr = HRESULTFromLastError();
+                         return false;
+                       }
+                       *bytes_read = num_bytes;
+                       return true;
+                     },
+                     digest)) {
+    ASSERT1(FAILED(read_hr));
+    return read_hr;
   }
 
   DWORD digest_size = static_cast<DWORD>(hash_size());
   std::vector<char> digest_data(digest_size);
 
-  memcpy(&digest_data.front(), hasher->final(), digest_size);
+  memcpy(&digest_data.front(), digest, digest_size);
 
   if (hash_in) {
     int res = memcmp(&hash_in->front(), &digest_data.front(), digest_size);
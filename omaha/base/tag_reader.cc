@@ -0,0 +1,359 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/base/tag_reader.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#if defined(__linux__)
+#include <errno.h>
+#include <unistd.h>
+#endif
+
+namespace omaha {
+
+namespace {
+
+// The offsets in the PE headers, from the start of the file or of the
+// "PE\0\0" signature.
+const uint32_t kPeHeaderOffsetOffset = 60;
+const uint32_t kOptionalHeaderMagicOffset = 24;
+const uint16_t kPe32Magic = 0x10b;
+const uint16_t kPe32PlusMagic = 0x20b;
+const uint32_t kPe32NumberOfRvaAndSizesOffset = 24 + 92;
+const uint32_t kPe32PlusNumberOfRvaAndSizesOffset = 24 + 108;
+const uint32_t kPe32CertDirOffset = 152;
+const uint32_t kPe32PlusCertDirOffset = 168;
+const uint32_t kCertDirIndex = 4;
+
+bool ReadUint16(TagReader::Source* source, uint64_t offset, uint16_t* value) {
+  uint8_t data[2] = {};
+  if (offset > source->size() || sizeof(data) > source->size() - offset ||
+      !source->ReadAt(offset, data, sizeof(data))) {
+    return false;
+  }
+  *value = static_cast<uint16_t>(data[0] | (data[1] << 8));
+  return true;
+}
+
+bool ReadUint32(TagReader::Source* source, uint64_t offset, uint32_t* value) {
+  uint8_t data[4] = {};
+  if (offset > source->size() || sizeof(data) > source->size() - offset ||
+      !source->ReadAt(offset, data, sizeof(data))) {
+    return false;
+  }
+  *value = static_cast<uint32_t>(data[0]) |
+           (static_cast<uint32_t>(data[1]) << 8) |
+           (static_cast<uint32_t>(data[2]) << 16) |
+           (static_cast<uint32_t>(data[3]) << 24);
+  return true;
+}
+
+uint16_t LoadBigEndianUint16(const uint8_t* data) {
+  return static_cast<uint16_t>((data[0] << 8) | data[1]);
+}
+
+// Reads the last |max_size| bytes of the |size| bytes at |offset|.
+bool ReadTail(TagReader::Source* source,
+              uint64_t offset,
+              uint64_t size,
+              size_t max_size,
+              std::vector<uint8_t>* tail) {
+  const size_t tail_size = static_cast<size_t>(std::min<uint64_t>(size,
+                                                                  max_size));
+  tail->resize(tail_size);
+  return !tail_size ||
+         source->ReadAt(offset + size - tail_size, &tail->front(), tail_size);
+}
+
+}  // namespace
+
+const char TagReader::kMagic[12] = {
+  'G', 'a', 'c', 't', '2', '.', '0', 'O', 'm', 'a', 'h', 'a'
+};
+
+const char TagReader::kMsiMagic[4] = {'G', 'a', 'c', 't'};
+
+bool TagReader::FileSource::GetFileSize(FILE* file, uint64_t* size) {
+#if defined(_WIN32)
+  if (_fseeki64(file, 0, SEEK_END) != 0) {
+    return false;
+  }
+  const int64_t end = _ftelli64(file);
+#else
+  if (fseeko(file, 0, SEEK_END) != 0) {
+    return false;
+  }
+  const int64_t end = ftello(file);
+#endif
+  if (end < 0) {
+    return false;
+  }
+  *size = static_cast<uint64_t>(end);
+  return true;
+}
+
+bool TagReader::FileSource::ReadAt(uint64_t offset,
+                                   uint8_t* buffer,
+                                   size_t size) {
+  if (offset > size_ || size > size_ - offset) {
+    return false;
+  }
+#if defined(__linux__)
+  const int fd = fileno(file_);
+  while (size) {
+    const ssize_t count = pread(fd, buffer, size, static_cast<off_t>(offset));
+    if (count <= 0) {
+      if (count < 0 && errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    buffer += count;
+    offset += count;
+    size -= count;
+  }
+  return true;
+#elif defined(_WIN32)
+  return _fseeki64(file_, static_cast<int64_t>(offset), SEEK_SET) == 0 &&
+         fread(buffer, 1, size, file_) == size;
+#else
+  return fseeko(file_, static_cast<off_t>(offset), SEEK_SET) == 0 &&
+         fread(buffer, 1, size, file_) == size;
+#endif
+}
+
+TagReader::Result TagReader::ReadPeLayout(Source* source, PeLayout* layout) {
+  const uint64_t size = source->size();
+  uint8_t dos_magic[2] = {};
+  if (size < kPeHeaderOffsetOffset + 4) {
+    return kInvalidImage;
+  }
+  if (!source->ReadAt(0, dos_magic, sizeof(dos_magic))) {
+    return kReadError;
+  }
+  if (dos_magic[0] != 'M' || dos_magic[1] != 'Z') {
+    return kInvalidImage;
+  }
+
+  uint32_t pe_header = 0;
+  uint8_t pe_signature[4] = {};
+  uint16_t optional_header_magic = 0;
+  if (!ReadUint32(source, kPeHeaderOffsetOffset, &pe_header) ||
+      static_cast<uint64_t>(pe_header) + sizeof(pe_signature) > size ||
+      !source->ReadAt(pe_header, pe_signature, sizeof(pe_signature)) ||
+      memcmp(pe_signature, "PE\0\0", sizeof(pe_signature)) ||
+      !ReadUint16(source,
+                  static_cast<uint64_t>(pe_header) + kOptionalHeaderMagicOffset,
+                  &optional_header_magic)) {
+    return kInvalidImage;
+  }
+
+  // The data directories follow the optional header, whose size depends on
+  // the bitness of the image.
+  uint32_t number_of_rva_and_sizes_offset = 0;
+  uint32_t cert_dir_offset = 0;
+  if (optional_header_magic == kPe32Magic) {
+    number_of_rva_and_sizes_offset = kPe32NumberOfRvaAndSizesOffset;
+    cert_dir_offset = kPe32CertDirOffset;
+  } else if (optional_header_magic == kPe32PlusMagic) {
+    number_of_rva_and_sizes_offset = kPe32PlusNumberOfRvaAndSizesOffset;
+    cert_dir_offset = kPe32PlusCertDirOffset;
+  } else {
+    return kInvalidImage;
+  }
+
+  uint32_t number_of_rva_and_sizes = 0;
+  if (!ReadUint32(source,
+                  static_cast<uint64_t>(pe_header) +
+                      number_of_rva_and_sizes_offset,
+                  &number_of_rva_and_sizes)) {
+    return kInvalidImage;
+  }
+  if (number_of_rva_and_sizes <= kCertDirIndex) {
+    return kNotSigned;
+  }
+
+  const uint64_t cert_dir_entry_offset =
+      static_cast<uint64_t>(pe_header) + cert_dir_offset;
+  uint32_t cert_table_offset = 0;
+  uint32_t cert_table_size = 0;
+  if (!ReadUint32(source, cert_dir_entry_offset, &cert_table_offset) ||
+      !ReadUint32(source, cert_dir_entry_offset + 4, &cert_table_size)) {
+    return kInvalidImage;
+  }
+  if (!cert_table_offset || cert_table_size <= kWinCertificateHeaderSize) {
+    return kNotSigned;
+  }
+  if (cert_table_offset < cert_dir_entry_offset + 8 ||
+      static_cast<uint64_t>(cert_table_offset) + cert_table_size > size) {
+    return kInvalidImage;
+  }
+
+  layout->cert_dir_entry_offset = static_cast<uint32_t>(cert_dir_entry_offset);
+  layout->cert_table_offset = cert_table_offset;
+  layout->cert_table_size = cert_table_size;
+  return kSuccess;
+}
+
+TagReader::Result TagReader::ReadPeTag(Source* source, std::string* tag) {
+  tag->clear();
+
+  PeLayout layout;
+  Result result = ReadPeLayout(source, &layout);
+  if (result != kSuccess) {
+    return result;
+  }
+
+  std::vector<uint8_t> tail;
+  if (!ReadTail(source,
+                layout.cert_table_offset + kWinCertificateHeaderSize,
+                layout.cert_table_size - kWinCertificateHeaderSize,
+                kMaxCertTableTailSize,
+                &tail)) {
+    return kReadError;
+  }
+
+  const uint8_t* const tail_start = &tail.front();
+  const uint8_t* const tail_end = tail_start + tail.size();
+  const uint8_t* const magic =
+      std::search(tail_start, tail_end, kMagic, kMagic + kMagicSize);
+  if (tail_end - magic < static_cast<ptrdiff_t>(kTagHeaderSize)) {
+    return kNoTag;
+  }
+
+  const size_t tag_size = LoadBigEndianUint16(magic + kMagicSize);
+  if (static_cast<size_t>(tail_end - magic) < kTagHeaderSize + tag_size) {
+    return kInvalidImage;
+  }
+  if (!tag_size) {
+    return kNoTag;
+  }
+
+  tag->assign(reinterpret_cast<const char*>(magic) + kTagHeaderSize, tag_size);
+  return kSuccess;
+}
+
+TagReader::Result TagReader::ReadMsiTag(Source* source, std::string* tag) {
+  tag->clear();
+
+  std::vector<uint8_t> tail;
+  if (!ReadTail(source, 0, source->size(), kMaxMsiTailSize, &tail)) {
+    return kReadError;
+  }
+  if (tail.empty()) {
+    return kNoTag;
+  }
+
+  // The long form is anywhere in the tail and the last one is the tag.
+  const uint8_t* const tail_start = &tail.front();
+  const uint8_t* const tail_end = tail_start + tail.size();
+  const uint8_t* magic =
+      std::find_end(tail_start, tail_end, kMagic, kMagic + kMagicSize);
+  if (tail_end - magic >= static_cast<ptrdiff_t>(kTagHeaderSize)) {
+    const size_t tag_size = LoadBigEndianUint16(magic + kMagicSize);
+    if (static_cast<size_t>(tail_end - magic) < kTagHeaderSize + tag_size) {
+      return kInvalidImage;
+    }
+    if (!tag_size) {
+      return kNoTag;
+    }
+    tag->assign(reinterpret_cast<const char*>(magic) + kTagHeaderSize,
+                tag_size);
+    return kSuccess;
+  }
+
+  // The short form ends the file, so its length tells where it starts. The
+  // tag may itself contain the magic, so each occurrence is checked from the
+  // last one.
+  const size_t short_header_size = kMsiMagicSize + 2;
+  const uint8_t* search_end = tail_end;
+  for (;;) {
+    magic = std::find_end(tail_start, search_end,
+                          kMsiMagic, kMsiMagic + kMsiMagicSize);
+    if (magic == search_end) {
+      return kNoTag;
+    }
+    const size_t remaining = tail_end - magic;
+    if (remaining >= short_header_size &&
+        LoadBigEndianUint16(magic + kMsiMagicSize) ==
+            remaining - short_header_size) {
+      if (remaining == short_header_size) {
+        return kNoTag;
+      }
+      tag->assign(reinterpret_cast<const char*>(magic) + short_header_size,
+                  remaining - short_header_size);
+      return kSuccess;
+    }
+    search_end = magic + kMsiMagicSize - 1;
+  }
+}
+
+TagReader::Result TagReader::ReadTag(Source* source,
+                                     std::string* tag,
+                                     Format* format) {
+  uint8_t dos_magic[2] = {};
+  const bool is_pe = source->size() >= sizeof(dos_magic) &&
+                     source->ReadAt(0, dos_magic, sizeof(dos_magic)) &&
+                     dos_magic[0] == 'M' && dos_magic[1] == 'Z';
+  if (format) {
+    *format = is_pe ? kPeFormat : kMsiFormat;
+  }
+  return is_pe ? ReadPeTag(source, tag) : ReadMsiTag(source, tag);
+}
+
+TagReader::Result TagReader::ReadTagFromFile(const std::string& path,
+                                             std::string* tag,
+                                             Format* format) {
+  tag->clear();
+  if (format) {
+    *format = kUnknownFormat;
+  }
+
+  FILE* file = fopen(path.c_str(), "rb");
+  if (!file) {
+    return kReadError;
+  }
+
+  uint64_t size = 0;
+  Result result = kReadError;
+  if (FileSource::GetFileSize(file, &size)) {
+    FileSource source(file, size);
+    result = ReadTag(&source, tag, format);
+  }
+  fclose(file);
+  return result;
+}
+
+const char* TagReader::ResultToString(Result result) {
+  switch (result) {
+    case kSuccess:
+      return "success";
+    case kNoTag:
+      return "no tag";
+    case kInvalidImage:
+      return "invalid image";
+    case kNotSigned:
+      return "not signed";
+    case kReadError:
+      return "read error";
+  }
+  return "unknown";
+}
+
+}  // namespace omaha
@@ -0,0 +1,140 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// TagReader reads the tag of a tagged installer with a few positioned reads,
+// whatever the size of the installer.
+//
+// The tag of an executable is in the padding of its certificate table:
+//   magic        12 bytes   kMagic.
+//   tag length    2 bytes   Big-endian length of the tag.
+//   tag                     The tag, without a terminating null.
+// ReadPeTag() reads the DOS header, the PE signature, the optional header
+// magic, the security entry of the data directories, and then at most the
+// last kMaxCertTableTailSize bytes of the certificate table, where the
+// signing step leaves the magic.
+//
+// The tag of an MSI package follows the package. tools/MsiTagger appends the
+// short form, in which the magic is kMsiMagic and the tag ends the file, and
+// the certificate tagging tool appends the long form, as for executables.
+// ReadMsiTag() reads at most the last kMaxMsiTailSize bytes of the package.
+//
+// Apart from the reads of files, this file has no platform dependencies.
+
+#ifndef OMAHA_BASE_TAG_READER_H_
+#define OMAHA_BASE_TAG_READER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+
+#include "base/basictypes.h"
+
+namespace omaha {
+
+class TagReader {
+ public:
+  // The tagged file, read at random offsets.
+  class Source {
+   public:
+    virtual ~Source() {}
+    virtual uint64_t size() const = 0;
+
+    // Reads exactly |size| bytes at |offset|.
+    virtual bool ReadAt(uint64_t offset, uint8_t* buffer, size_t size) = 0;
+  };
+
+  // Reads an open file. The file is not closed.
+  class FileSource : public Source {
+   public:
+    FileSource(FILE* file, uint64_t size) : file_(file), size_(size) {}
+
+    // Returns the size of |file|.
+    static bool GetFileSize(FILE* file, uint64_t* size);
+
+    virtual uint64_t size() const { return size_; }
+    virtual bool ReadAt(uint64_t offset, uint8_t* buffer, size_t size);
+
+   private:
+    FILE* file_;
+    const uint64_t size_;
+
+    DISALLOW_COPY_AND_ASSIGN(FileSource);
+  };
+
+  enum Result {
+    kSuccess = 0,
+    kNoTag,             // The file has no tag, or an empty one.
+    kInvalidImage,      // The file is not a PE file, or its tag is truncated.
+    kNotSigned,         // The PE file has no certificate table.
+    kReadError,
+  };
+
+  enum Format {
+    kUnknownFormat = 0,
+    kPeFormat,
+    kMsiFormat,
+  };
+
+  // Where the certificate table of a PE file is.
+  struct PeLayout {
+    // The offset of the security entry of the data directories.
+    uint32_t cert_dir_entry_offset = 0;
+    uint32_t cert_table_offset = 0;
+    uint32_t cert_table_size = 0;
+  };
+
+  static const char kMagic[12];
+  static const size_t kMagicSize = sizeof(kMagic);
+  static const char kMsiMagic[4];
+  static const size_t kMsiMagicSize = sizeof(kMsiMagic);
+  static const size_t kTagHeaderSize = kMagicSize + 2;
+  static const size_t kMaxTagSize = 0xFFFF;
+
+  // The size of the WIN_CERTIFICATE header which starts the table.
+  static const uint32_t kWinCertificateHeaderSize = 8;
+
+  // The largest part of the certificate table or of the MSI package searched
+  // for the magic. The part of the table holds the longest tag followed by
+  // 64 KB of padding.
+  static const size_t kMaxCertTableTailSize = 128 * 1024;
+  static const size_t kMaxMsiTailSize = kTagHeaderSize + kMaxTagSize;
+
+  // Reads the headers of a PE file and returns where its certificate table
+  // is. The table is within the file and longer than a WIN_CERTIFICATE
+  // header.
+  static Result ReadPeLayout(Source* source, PeLayout* layout);
+
+  static Result ReadPeTag(Source* source, std::string* tag);
+  static Result ReadMsiTag(Source* source, std::string* tag);
+
+  // Reads the tag of a PE file if |source| starts as one, or else of an MSI
+  // package. |format| may be NULL.
+  static Result ReadTag(Source* source, std::string* tag, Format* format);
+
+  static Result ReadTagFromFile(const std::string& path,
+                                std::string* tag,
+                                Format* format);
+
+  static const char* ResultToString(Result result);
+
+ private:
+  DISALLOW_IMPLICIT_CONSTRUCTORS(TagReader);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_BASE_TAG_READER_H_
@@ -0,0 +1,408 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/base/tag_reader.h"
+
+#include <string.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace omaha {
+
+namespace {
+
+const uint32_t kPeHeader = 0x80;
+
+// Fails the test on reads out of the data, and counts the reads.
+class CheckedSource : public TagReader::Source {
+ public:
+  explicit CheckedSource(const std::string& data)
+      : data_(data), num_reads_(0), bytes_read_(0) {}
+
+  uint64_t size() const override { return data_.size(); }
+
+  bool ReadAt(uint64_t offset, uint8_t* buffer, size_t size) override {
+    EXPECT_LE(offset, data_.size());
+    EXPECT_LE(size, data_.size() - offset);
+    if (offset > data_.size() || size > data_.size() - offset) {
+      return false;
+    }
+    ++num_reads_;
+    bytes_read_ += size;
+    memcpy(buffer, data_.data() + offset, size);
+    return true;
+  }
+
+  int num_reads() const { return num_reads_; }
+  uint64_t bytes_read() const { return bytes_read_; }
+
+ private:
+  const std::string data_;
+  int num_reads_;
+  uint64_t bytes_read_;
+
+  DISALLOW_COPY_AND_ASSIGN(CheckedSource);
+};
+
+void PutUint16(uint16_t value, std::string* data, size_t offset) {
+  (*data)[offset] = static_cast<char>(value & 0xFF);
+  (*data)[offset + 1] = static_cast<char>(value >> 8);
+}
+
+void PutUint32(uint32_t value, std::string* data, size_t offset) {
+  for (int i = 0; i != 4; ++i) {
+    (*data)[offset + i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+  }
+}
+
+std::string TagBlock(const char* magic, size_t magic_size,
+                     const std::string& tag) {
+  std::string block(magic, magic_size);
+  block.push_back(static_cast<char>(tag.size() >> 8));
+  block.push_back(static_cast<char>(tag.size() & 0xFF));
+  return block + tag;
+}
+
+uint32_t CertDirEntryOffset(bool pe32_plus) {
+  return kPeHeader + (pe32_plus ? 168 : 152);
+}
+
+// Builds a signed PE file of |body_size| bytes before the certificate table,
+// with |signature_size| bytes of signature followed by |tag|.
+std::string MakePe(const std::string& tag,
+                   bool pe32_plus = false,
+                   size_t body_size = 0x2000,
+                   size_t signature_size = 0x100) {
+  std::mt19937 generator(static_cast<unsigned int>(body_size));
+  std::string image(body_size, '\0');
+  for (size_t i = 0x200; i != image.size(); ++i) {
+    image[i] = static_cast<char>(generator() & 0xFF);
+  }
+  image[0] = 'M';
+  image[1] = 'Z';
+  PutUint32(kPeHeader, &image, 60);
+  memcpy(&image[kPeHeader], "PE\0\0", 4);
+  PutUint16(pe32_plus ? 0x20b : 0x10b, &image, kPeHeader + 24);
+  PutUint32(16, &image, kPeHeader + (pe32_plus ? 132 : 116));
+
+  std::string table(8, '\0');
+  for (size_t i = 0; i != signature_size; ++i) {
+    table.push_back(static_cast<char>(generator() & 0xFF));
+  }
+  PutUint32(static_cast<uint32_t>(table.size()), &table, 0);
+  table.resize((table.size() + 7) & ~7);
+  table += TagBlock(TagReader::kMagic, TagReader::kMagicSize, tag);
+  table += std::string(64, '\0');
+  table.resize((table.size() + 7) & ~7);
+
+  PutUint32(static_cast<uint32_t>(image.size()), &image,
+            CertDirEntryOffset(pe32_plus));
+  PutUint32(static_cast<uint32_t>(table.size()), &image,
+            CertDirEntryOffset(pe32_plus) + 4);
+  return image + table;
+}
+
+std::string MakeMsi(size_t size) {
+  std::mt19937 generator(static_cast<unsigned int>(size));
+  std::string msi(size, '\0');
+  for (size_t i = 0; i != msi.size(); ++i) {
+    msi[i] = static_cast<char>(generator() & 0xFF);
+  }
+  memcpy(&msi[0], "\xD0\xCF\x11\xE0", 4);
+  return msi;
+}
+
+TagReader::Result ReadTag(const std::string& data,
+                          std::string* tag,
+                          TagReader::Format* format) {
+  CheckedSource source(data);
+  return TagReader::ReadTag(&source, tag, format);
+}
+
+}  // namespace
+
+TEST(TagReaderTest, ReadPeTag) {
+  for (int pe32_plus = 0; pe32_plus != 2; ++pe32_plus) {
+    CheckedSource source(MakePe("appguid={8A69D345}&lang=en", !!pe32_plus));
+    std::string tag;
+    EXPECT_EQ(TagReader::kSuccess, TagReader::ReadPeTag(&source, &tag));
+    EXPECT_EQ("appguid={8A69D345}&lang=en", tag);
+
+    TagReader::PeLayout layout;
+    EXPECT_EQ(TagReader::kSuccess, TagReader::ReadPeLayout(&source, &layout));
+    EXPECT_EQ(CertDirEntryOffset(!!pe32_plus), layout.cert_dir_entry_offset);
+    EXPECT_EQ(0x2000u, layout.cert_table_offset);
+  }
+}
+
+TEST(TagReaderTest, ReadPeTag_FewSmallReads) {
+  // A large body and a signature longer than the searched part of the table.
+  const std::string image =
+      MakePe("brand=GGLS", false, 8 * 1024 * 1024,
+             TagReader::kMaxCertTableTailSize + 1000);
+  CheckedSource source(image);
+  std::string tag;
+  EXPECT_EQ(TagReader::kSuccess, TagReader::ReadPeTag(&source, &tag));
+  EXPECT_EQ("brand=GGLS", tag);
+  EXPECT_LE(source.num_reads(), 8);
+  EXPECT_LE(source.bytes_read(), TagReader::kMaxCertTableTailSize + 64);
+}
+
+TEST(TagReaderTest, ReadPeTag_NoTag) {
+  std::string tag;
+  CheckedSource empty_tag_source(MakePe(""));
+  EXPECT_EQ(TagReader::kNoTag,
+            TagReader::ReadPeTag(&empty_tag_source, &tag));
+  EXPECT_TRUE(tag.empty());
+
+  std::string no_magic = MakePe("tag");
+  no_magic.replace(no_magic.find("Gact2.0Omaha"), 4, "Xact");
+  CheckedSource no_magic_source(no_magic);
+  EXPECT_EQ(TagReader::kNoTag, TagReader::ReadPeTag(&no_magic_source, &tag));
+
+  std::string not_signed = MakePe("tag").substr(0, 0x2000);
+  PutUint32(0, &not_signed, CertDirEntryOffset(false));
+  PutUint32(0, &not_signed, CertDirEntryOffset(false) + 4);
+  CheckedSource not_signed_source(not_signed);
+  EXPECT_EQ(TagReader::kNotSigned,
+            TagReader::ReadPeTag(&not_signed_source, &tag));
+}
+
+TEST(TagReaderTest, ReadPeTag_Invalid) {
+  std::string tag;
+  const std::string image = MakePe("tag");
+
+  CheckedSource truncated_source(image.substr(0, image.size() - 8));
+  EXPECT_EQ(TagReader::kInvalidImage,
+            TagReader::ReadPeTag(&truncated_source, &tag));
+
+  std::string long_tag = image;
+  long_tag[long_tag.find("Gact2.0Omaha") + 12] = '\x10';
+  CheckedSource long_tag_source(long_tag);
+  EXPECT_EQ(TagReader::kInvalidImage,
+            TagReader::ReadPeTag(&long_tag_source, &tag));
+
+  std::string bad_pe_header = image;
+  PutUint32(0xFFFFFFF0, &bad_pe_header, 60);
+  CheckedSource bad_pe_header_source(bad_pe_header);
+  EXPECT_EQ(TagReader::kInvalidImage,
+            TagReader::ReadPeTag(&bad_pe_header_source, &tag));
+
+  std::string bad_optional_header = image;
+  PutUint16(0x107, &bad_optional_header, kPeHeader + 24);
+  CheckedSource bad_optional_header_source(bad_optional_header);
+  EXPECT_EQ(TagReader::kInvalidImage,
+            TagReader::ReadPeTag(&bad_optional_header_source, &tag));
+}
+
+TEST(TagReaderTest, ReadMsiTag) {
+  const std::string msi = MakeMsi(200000);
+  std::string tag;
+  TagReader::Format format = TagReader::kUnknownFormat;
+
+  // The short form, as tools/MsiTagger writes it.
+  EXPECT_EQ(TagReader::kSuccess,
+            ReadTag(msi + TagBlock("Gact", 4, "brand=QAQA"), &tag, &format));
+  EXPECT_EQ("brand=QAQA", tag);
+  EXPECT_EQ(TagReader::kMsiFormat, format);
+
+  // A short tag which contains the magic.
+  EXPECT_EQ(TagReader::kSuccess,
+            ReadTag(msi + TagBlock("Gact", 4, "a=Gact&b=c"), &tag, &format));
+  EXPECT_EQ("a=Gact&b=c", tag);
+
+  // The long form.
+  EXPECT_EQ(TagReader::kSuccess,
+            ReadTag(msi + TagBlock(TagReader::kMagic, TagReader::kMagicSize,
+                                   "brand=QAQA&"),
+                    &tag, &format));
+  EXPECT_EQ("brand=QAQA&", tag);
+
+  const std::string long_tag(TagReader::kMaxTagSize, 'a');
+  EXPECT_EQ(TagReader::kSuccess,
+            ReadTag(msi + TagBlock("Gact", 4, long_tag), &tag, &format));
+  EXPECT_EQ(long_tag, tag);
+
+  EXPECT_EQ(TagReader::kNoTag, ReadTag(msi, &tag, &format));
+  EXPECT_EQ(TagReader::kNoTag,
+            ReadTag(msi + TagBlock("Gact", 4, ""), &tag, &format));
+  EXPECT_EQ(TagReader::kNoTag, ReadTag("", &tag, &format));
+
+  // A long form whose length goes past the end of the file.
+  std::string truncated =
+      msi + TagBlock(TagReader::kMagic, TagReader::kMagicSize, "brand=QAQA");
+  truncated.resize(truncated.size() - 1);
+  EXPECT_EQ(TagReader::kInvalidImage, ReadTag(truncated, &tag, &format));
+  EXPECT_TRUE(tag.empty());
+}
+
+TEST(TagReaderTest, ReadTag_Format) {
+  std::string tag;
+  TagReader::Format format = TagReader::kUnknownFormat;
+  EXPECT_EQ(TagReader::kSuccess, ReadTag(MakePe("a=b"), &tag, &format));
+  EXPECT_EQ(TagReader::kPeFormat, format);
+  EXPECT_EQ(TagReader::kSuccess,
+            ReadTag(MakeMsi(100) + TagBlock("Gact", 4, "a=b"), &tag, NULL));
+}
+
+TEST(TagReaderTest, ReadTagFromFile) {
+  const std::filesystem::path path =
+      std::filesystem::temp_directory_path() /
+      ("tag_reader_unittest_" +
+       std::to_string(reinterpret_cast<uintptr_t>(&path)));
+  {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    const std::string image = MakePe("brand=GGLS", true);
+    file.write(image.data(), image.size());
+  }
+
+  std::string tag;
+  TagReader::Format format = TagReader::kUnknownFormat;
+  EXPECT_EQ(TagReader::kSuccess,
+            TagReader::ReadTagFromFile(path.string(), &tag, &format));
+  EXPECT_EQ("brand=GGLS", tag);
+  EXPECT_EQ(TagReader::kPeFormat, format);
+
+  std::filesystem::remove(path);
+  EXPECT_EQ(TagReader::kReadError,
+            TagReader::ReadTagFromFile(path.string(), &tag, &format));
+  EXPECT_EQ(TagReader::kUnknownFormat, format);
+}
+
+// Reads the tags of mutations of valid files. CheckedSource fails the test on
+// any read out of the file.
+TEST(TagReaderTest, Fuzz) {
+  const std::string seeds[] = {
+    MakePe("appguid={8A69D345}&lang=en", false, 0x400, 0x40),
+    MakePe("brand=GGLS", true, 0x400, 0x40),
+    MakeMsi(0x200) + TagBlock("Gact", 4, "brand=QAQA"),
+    MakeMsi(0x200) + TagBlock(TagReader::kMagic, TagReader::kMagicSize,
+                              "brand=QAQA"),
+  };
+
+  std::mt19937 generator(1);
+  for (int i = 0; i != 20000; ++i) {
+    std::string data = seeds[generator() % arraysize(seeds)];
+    const int num_mutations = 1 + generator() % 4;
+    for (int j = 0; j != num_mutations; ++j) {
+      const size_t offset = generator() % data.size();
+      switch (generator() % 4) {
+        case 0:
+          data[offset] = static_cast<char>(generator() & 0xFF);
+          break;
+        case 1:
+          // The fields of the headers are mostly 32-bit offsets and sizes.
+          if (offset + 4 <= data.size()) {
+            PutUint32(static_cast<uint32_t>(generator()), &data, offset);
+          }
+          break;
+        case 2:
+          data.resize(offset);
+          break;
+        case 3:
+          data.insert(offset, std::string(generator() % 16, 'G'));
+          break;
+      }
+      if (data.empty()) {
+        break;
+      }
+    }
+
+    std::string tag;
+    const TagReader::Result result = ReadTag(data, &tag, NULL);
+    if (result == TagReader::kSuccess) {
+      EXPECT_FALSE(tag.empty());
+      EXPECT_LE(tag.size(), static_cast<size_t>(TagReader::kMaxTagSize));
+    } else {
+      EXPECT_TRUE(tag.empty());
+    }
+  }
+
+  // Random data.
+  for (int i = 0; i != 2000; ++i) {
+    std::string data(generator() % 512, '\0');
+    for (size_t j = 0; j != data.size(); ++j) {
+      data[j] = static_cast<char>(generator() & 0xFF);
+    }
+    if (i % 2 && data.size() >= 2) {
+      data[0] = 'M';
+      data[1] = 'Z';
+    }
+    std::string tag;
+    ReadTag(data, &tag, NULL);
+  }
+}
+
+// Compares reading the tag of a large file with TagReader and with reading
+// the whole file, as mapping the file for TagExtractor did.
+TEST(TagReaderTest, ReadTagBenchmark) {
+  const std::filesystem::path path =
+      std::filesystem::temp_directory_path() /
+      ("tag_reader_benchmark_" +
+       std::to_string(reinterpret_cast<uintptr_t>(&path)));
+  const size_t kBodySize = 256 * 1024 * 1024;
+  {
+    // The body is sparse, and only the headers and the table are written.
+    const std::string image = MakePe("brand=GGLS", false, 0x1000, 0x2000);
+    std::string headers = image.substr(0, 0x1000);
+    PutUint32(static_cast<uint32_t>(kBodySize), &headers,
+              CertDirEntryOffset(false));
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(headers.data(), headers.size());
+    file.seekp(kBodySize);
+    file.write(image.data() + 0x1000, image.size() - 0x1000);
+  }
+
+  const int kNumReads = 100;
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  for (int i = 0; i != kNumReads; ++i) {
+    std::string tag;
+    ASSERT_EQ(TagReader::kSuccess,
+              TagReader::ReadTagFromFile(path.string(), &tag, NULL));
+    ASSERT_EQ("brand=GGLS", tag);
+  }
+  const std::chrono::duration<double, std::milli> tag_reader_time =
+      (std::chrono::steady_clock::now() - start) / kNumReads;
+
+  start = std::chrono::steady_clock::now();
+  std::string data;
+  {
+    std::ifstream file(path, std::ios::binary);
+    data.assign(std::istreambuf_iterator<char>(file),
+                std::istreambuf_iterator<char>());
+  }
+  std::string tag;
+  EXPECT_EQ(TagReader::kSuccess, ReadTag(data, &tag, NULL));
+  const std::chrono::duration<double, std::milli> whole_file_time =
+      std::chrono::steady_clock::now() - start;
+
+  std::cout << "Tag of a " << data.size() << " byte file: "
+            << "TagReader " << tag_reader_time.count() << " ms, "
+            << "whole file " << whole_file_time.count() << " ms" << std::endl;
+
+  std::filesystem::remove(path);
+}
+
+}  // namespace omaha
@@ -0,0 +1,496 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/base/tag_template.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#if defined(__linux__)
+#include <errno.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
+#endif
+
+namespace omaha {
+
+namespace {
+
+// Windows aligns the certificate table to 8 bytes.
+const uint32_t kCertTableAlignment = 8;
+
+// The certificate tables of the installers are a few KB. A larger table is
+// not read into memory.
+const uint32_t kMaxCertTableSize = 1024 * 1024;
+
+uint32_t LoadUint32(const uint8_t* data) {
+  return static_cast<uint32_t>(data[0]) |
+         (static_cast<uint32_t>(data[1]) << 8) |
+         (static_cast<uint32_t>(data[2]) << 16) |
+         (static_cast<uint32_t>(data[3]) << 24);
+}
+
+std::string Uint32ToString(uint32_t value) {
+  std::string out(4, '\0');
+  for (int i = 0; i != 4; ++i) {
+    out[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+  }
+  return out;
+}
+
+void AddRange(uint64_t offset, uint64_t length,
+              TagTemplate::Overlay* overlay) {
+  if (!length) {
+    return;
+  }
+  TagTemplate::Segment segment;
+  segment.offset = offset;
+  segment.length = length;
+  overlay->push_back(segment);
+}
+
+void AddData(const std::string& data, TagTemplate::Overlay* overlay) {
+  TagTemplate::Segment segment;
+  segment.length = data.size();
+  segment.data = data;
+  overlay->push_back(segment);
+}
+
+}  // namespace
+
+TagTemplate::TagTemplate()
+    : source_(NULL),
+      size_(0),
+      cert_dir_entry_offset_(0),
+      cert_table_offset_(0),
+      cert_table_size_(0),
+      win_certificate_length_(0),
+      magic_offset_(0) {}
+
+TagTemplate::Result TagTemplate::Load(Source* source) {
+  Reset();
+
+  TagReader::PeLayout layout;
+  switch (TagReader::ReadPeLayout(source, &layout)) {
+    case TagReader::kSuccess:
+      break;
+    case TagReader::kNotSigned:
+      return kNotSigned;
+    case TagReader::kReadError:
+      return kReadError;
+    default:
+      return kInvalidImage;
+  }
+  const uint32_t cert_table_offset = layout.cert_table_offset;
+  const uint32_t cert_table_size = layout.cert_table_size;
+  if (cert_table_size > kMaxCertTableSize) {
+    return kInvalidImage;
+  }
+
+  std::vector<uint8_t> table(cert_table_size);
+  if (!source->ReadAt(cert_table_offset, &table.front(), table.size())) {
+    return kReadError;
+  }
+
+  const uint8_t* const table_start = &table.front();
+  const uint8_t* const table_end = table_start + table.size();
+  const uint8_t* magic =
+      std::search(table_start + TagReader::kWinCertificateHeaderSize,
+                  table_end,
+                  TagReader::kMagic,
+                  TagReader::kMagic + TagReader::kMagicSize);
+  if (table_end - magic < static_cast<ptrdiff_t>(TagReader::kTagHeaderSize)) {
+    return kNotSigned;
+  }
+
+  const size_t tag_size = (magic[TagReader::kMagicSize] << 8) |
+                          magic[TagReader::kMagicSize + 1];
+  if (static_cast<size_t>(table_end - magic) <
+      TagReader::kTagHeaderSize + tag_size) {
+    return kInvalidImage;
+  }
+
+  existing_tag_.assign(
+      reinterpret_cast<const char*>(magic) + TagReader::kTagHeaderSize,
+      tag_size);
+  size_ = source->size();
+  cert_dir_entry_offset_ = layout.cert_dir_entry_offset;
+  cert_table_offset_ = cert_table_offset;
+  cert_table_size_ = cert_table_size;
+  win_certificate_length_ = LoadUint32(table_start);
+  magic_offset_ =
+      cert_table_offset + static_cast<uint32_t>(magic - table_start);
+  source_ = source;
+  return kSuccess;
+}
+
+void TagTemplate::Reset() {
+  source_ = NULL;
+  size_ = 0;
+  cert_dir_entry_offset_ = 0;
+  cert_table_offset_ = 0;
+  cert_table_size_ = 0;
+  win_certificate_length_ = 0;
+  magic_offset_ = 0;
+  existing_tag_.clear();
+}
+
+TagTemplate::Result TagTemplate::MakeOverlay(const std::string& tag,
+                                             bool append,
+                                             Overlay* overlay) const {
+  overlay->clear();
+  if (!is_loaded()) {
+    return kNotLoaded;
+  }
+  if (tag.empty() || !IsValidTag(tag)) {
+    return kInvalidTag;
+  }
+  if (!existing_tag_.empty() && !append) {
+    return kAlreadyTagged;
+  }
+
+  const std::string full_tag = append ? existing_tag_ + tag : tag;
+  if (full_tag.size() > kMaxTagSize) {
+    return kTagTooLong;
+  }
+
+  std::string tag_buffer(TagReader::kMagic, TagReader::kMagicSize);
+  tag_buffer.push_back(static_cast<char>((full_tag.size() >> 8) & 0xFF));
+  tag_buffer.push_back(static_cast<char>(full_tag.size() & 0xFF));
+  tag_buffer += full_tag;
+
+  const uint64_t cert_table_end =
+      static_cast<uint64_t>(cert_table_offset_) + cert_table_size_;
+  if (magic_offset_ + tag_buffer.size() <= cert_table_end) {
+    AddRange(0, magic_offset_, overlay);
+    AddData(tag_buffer, overlay);
+    AddRange(magic_offset_ + tag_buffer.size(),
+             size_ - magic_offset_ - tag_buffer.size(),
+             overlay);
+    return kSuccess;
+  }
+
+  // The table grows, which is only possible at the end of the file.
+  if (cert_table_end != size_) {
+    return kNoSpace;
+  }
+
+  const uint32_t tag_buffer_offset = magic_offset_ - cert_table_offset_;
+  const uint32_t new_cert_table_size = static_cast<uint32_t>(
+      (tag_buffer_offset + tag_buffer.size() + kCertTableAlignment - 1) &
+      ~static_cast<uint64_t>(kCertTableAlignment - 1));
+  const uint32_t growth = new_cert_table_size - cert_table_size_;
+  tag_buffer.resize(new_cert_table_size - tag_buffer_offset, '\0');
+
+  AddRange(0, cert_dir_entry_offset_ + 4, overlay);
+  AddData(Uint32ToString(new_cert_table_size), overlay);
+  AddRange(cert_dir_entry_offset_ + 8,
+           cert_table_offset_ - cert_dir_entry_offset_ - 8,
+           overlay);
+  AddData(Uint32ToString(win_certificate_length_ + growth), overlay);
+  AddRange(cert_table_offset_ + 4, magic_offset_ - cert_table_offset_ - 4,
+           overlay);
+  AddData(tag_buffer, overlay);
+  return kSuccess;
+}
+
+TagTemplate::Result TagTemplate::Write(const Overlay& overlay,
+                                       Writer* output) const {
+  if (!is_loaded()) {
+    return kNotLoaded;
+  }
+
+  std::vector<uint8_t> buffer;
+  for (size_t i = 0; i != overlay.size(); ++i) {
+    const Segment& segment = overlay[i];
+    if (!segment.data.empty()) {
+      if (!output->Write(reinterpret_cast<const uint8_t*>(segment.data.data()),
+                         segment.data.size())) {
+        return kWriteError;
+      }
+      continue;
+    }
+
+    if (buffer.empty()) {
+      buffer.resize(kBufferSize);
+    }
+    uint64_t offset = segment.offset;
+    uint64_t remaining = segment.length;
+    while (remaining) {
+      const size_t count =
+          static_cast<size_t>(std::min<uint64_t>(remaining, buffer.size()));
+      if (!source_->ReadAt(offset, &buffer.front(), count)) {
+        return kReadError;
+      }
+      if (!output->Write(&buffer.front(), count)) {
+        return kWriteError;
+      }
+      offset += count;
+      remaining -= count;
+    }
+  }
+  return kSuccess;
+}
+
+bool TagTemplate::IsValidTag(const std::string& tag) {
+  static const char kAllowedPunctuation[] = "-%{}/&=.,_";
+  for (size_t i = 0; i != tag.size(); ++i) {
+    const char c = tag[i];
+    if (!(c >= 'a' && c <= 'z') && !(c >= 'A' && c <= 'Z') &&
+        !(c >= '0' && c <= '9') && !strchr(kAllowedPunctuation, c)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+const char* TagTemplate::ResultToString(Result result) {
+  switch (result) {
+    case kSuccess:
+      return "success";
+    case kNotLoaded:
+      return "not loaded";
+    case kInvalidImage:
+      return "invalid image";
+    case kNotSigned:
+      return "not signed";
+    case kAlreadyTagged:
+      return "already tagged";
+    case kInvalidTag:
+      return "invalid tag";
+    case kTagTooLong:
+      return "tag too long";
+    case kNoSpace:
+      return "no space";
+    case kReadError:
+      return "read error";
+    case kWriteError:
+      return "write error";
+  }
+  return "unknown";
+}
+
+namespace {
+
+#if defined(__linux__)
+
+bool WriteAll(int fd, const char* data, size_t size) {
+  while (size) {
+    const ssize_t count = write(fd, data, size);
+    if (count <= 0) {
+      if (count < 0 && errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += count;
+    size -= count;
+  }
+  return true;
+}
+
+// Copies a range of |in_fd| to the end of |out_fd| in the kernel. Returns
+// false without copying anything if neither copy_file_range() nor sendfile()
+// supports the files, in which case the caller copies the range itself.
+bool SpliceRange(int in_fd, uint64_t offset, uint64_t length, int out_fd,
+                 bool* failed) {
+  *failed = false;
+  loff_t in_offset = static_cast<loff_t>(offset);
+  bool use_sendfile = false;
+  uint64_t copied = 0;
+  while (copied != length) {
+    const size_t count = static_cast<size_t>(
+        std::min<uint64_t>(length - copied, 0x40000000));
+    ssize_t result = 0;
+    if (!use_sendfile) {
+      result = copy_file_range(in_fd, &in_offset, out_fd, NULL, count, 0);
+      if (result < 0 && copied == 0 &&
+          (errno == ENOSYS || errno == EXDEV || errno == EINVAL ||
+           errno == EOPNOTSUPP)) {
+        use_sendfile = true;
+        continue;
+      }
+    } else {
+      off_t sendfile_offset = static_cast<off_t>(in_offset);
+      result = sendfile(out_fd, in_fd, &sendfile_offset, count);
+      if (result < 0 && copied == 0 && (errno == ENOSYS || errno == EINVAL)) {
+        return false;
+      }
+      in_offset = sendfile_offset;
+    }
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+    if (result <= 0) {
+      *failed = true;
+      return false;
+    }
+    copied += result;
+  }
+  return true;
+}
+
+#else
+
+class FileWriter : public TagTemplate::Writer {
+ public:
+  explicit FileWriter(FILE* file) : file_(file) {}
+
+  virtual bool Write(const uint8_t* data, size_t size) {
+    return fwrite(data, 1, size, file_) == size;
+  }
+
+ private:
+  FILE* file_;
+
+  DISALLOW_COPY_AND_ASSIGN(FileWriter);
+};
+
+#endif  // defined(__linux__)
+
+}  // namespace
+
+TagTemplateFile::TagTemplateFile() : file_(NULL) {}
+
+TagTemplateFile::~TagTemplateFile() {
+  Close();
+}
+
+TagTemplate::Result TagTemplateFile::Open(const std::string& path) {
+  Close();
+
+  file_ = fopen(path.c_str(), "rb");
+  if (!file_) {
+    return TagTemplate::kReadError;
+  }
+  uint64_t size = 0;
+  if (!TagReader::FileSource::GetFileSize(file_, &size)) {
+    Close();
+    return TagTemplate::kReadError;
+  }
+
+  source_.reset(new TagReader::FileSource(file_, size));
+  const TagTemplate::Result result = template_.Load(source_.get());
+  if (result != TagTemplate::kSuccess) {
+    Close();
+  }
+  return result;
+}
+
+void TagTemplateFile::Close() {
+  // The layout refers to the source.
+  template_.Reset();
+  source_.reset();
+  if (file_) {
+    fclose(file_);
+    file_ = NULL;
+  }
+}
+
+TagTemplate::Result TagTemplateFile::TagToFile(const std::string& tag,
+                                               bool append,
+                                               const std::string& output_path) {
+  TagTemplate::Overlay overlay;
+  TagTemplate::Result result = template_.MakeOverlay(tag, append, &overlay);
+  if (result != TagTemplate::kSuccess) {
+    return result;
+  }
+
+  FILE* output = fopen(output_path.c_str(), "wb");
+  if (!output) {
+    return TagTemplate::kWriteError;
+  }
+  result = WriteOverlay(overlay, output);
+  if (fclose(output) != 0 && result == TagTemplate::kSuccess) {
+    result = TagTemplate::kWriteError;
+  }
+  if (result != TagTemplate::kSuccess) {
+    remove(output_path.c_str());
+  }
+  return result;
+}
+
+size_t TagTemplateFile::TagBatch(const std::vector<Request>& requests,
+                                 bool append,
+                                 std::vector<TagTemplate::Result>* results) {
+  results->clear();
+  results->reserve(requests.size());
+
+  size_t num_tagged = 0;
+  for (size_t i = 0; i != requests.size(); ++i) {
+    results->push_back(
+        TagToFile(requests[i].tag, append, requests[i].output_path));
+    if (results->back() == TagTemplate::kSuccess) {
+      ++num_tagged;
+    }
+  }
+  return num_tagged;
+}
+
+TagTemplate::Result TagTemplateFile::WriteOverlay(
+    const TagTemplate::Overlay& overlay,
+    FILE* output) {
+#if defined(__linux__)
+  // The output is written with its descriptor only, so the buffer of the
+  // stream stays empty.
+  const int in_fd = fileno(file_);
+  const int out_fd = fileno(output);
+  std::vector<uint8_t> buffer;
+  for (size_t i = 0; i != overlay.size(); ++i) {
+    const TagTemplate::Segment& segment = overlay[i];
+    if (!segment.data.empty()) {
+      if (!WriteAll(out_fd, segment.data.data(), segment.data.size())) {
+        return TagTemplate::kWriteError;
+      }
+      continue;
+    }
+
+    bool failed = false;
+    if (SpliceRange(in_fd, segment.offset, segment.length, out_fd, &failed)) {
+      continue;
+    }
+    if (failed) {
+      return TagTemplate::kWriteError;
+    }
+
+    if (buffer.empty()) {
+      buffer.resize(TagTemplate::kBufferSize);
+    }
+    uint64_t offset = segment.offset;
+    uint64_t remaining = segment.length;
+    while (remaining) {
+      const size_t count =
+          static_cast<size_t>(std::min<uint64_t>(remaining, buffer.size()));
+      if (!source_->ReadAt(offset, &buffer.front(), count)) {
+        return TagTemplate::kReadError;
+      }
+      if (!WriteAll(out_fd, reinterpret_cast<const char*>(&buffer.front()),
+                    count)) {
+        return TagTemplate::kWriteError;
+      }
+      offset += count;
+      remaining -= count;
+    }
+  }
+  return TagTemplate::kSuccess;
+#else
+  FileWriter writer(output);
+  return template_.Write(overlay, &writer);
+#endif
+}
+
+}  // namespace omaha
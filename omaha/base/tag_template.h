@@ -0,0 +1,185 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// TagTemplate tags copies of a signed installer without reading the installer
+// into memory.
+//
+// The tag is stored in the padding of the certificate table of the PE file,
+// after the magic bytes the signing step leaves there:
+//   magic        12 bytes   TagReader::kMagic.
+//   tag length    2 bytes   Big-endian length of the tag.
+//   tag                     The tag, without a terminating null.
+// Load() reads the headers of the template once, with TagReader, and records
+// where the certificate directory, the certificate table, and the magic are.
+// A tagged copy then differs from the template only by the few bytes
+// MakeOverlay() returns. When the tag does not fit in the padding, the
+// certificate table, which must end the file, grows and the overlay also
+// patches the sizes of the table in the certificate directory and in the
+// WIN_CERTIFICATE header.
+// Neither is covered by the Authenticode hash, so the signature remains valid.
+//
+// TagTemplateFile keeps the template open and writes each tagged copy by
+// splicing the overlay with ranges of the template. On Linux the ranges are
+// copied in the kernel with copy_file_range() or sendfile(), which clone the
+// extents on file systems which support it.
+//
+// Apart from the copy path on Linux, this file has no platform dependencies.
+
+#ifndef OMAHA_BASE_TAG_TEMPLATE_H_
+#define OMAHA_BASE_TAG_TEMPLATE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "omaha/base/tag_reader.h"
+
+namespace omaha {
+
+class TagTemplate {
+ public:
+  // The template, read at random offsets.
+  typedef TagReader::Source Source;
+
+  // The tagged copy, written sequentially.
+  class Writer {
+   public:
+    virtual ~Writer() {}
+    virtual bool Write(const uint8_t* data, size_t size) = 0;
+  };
+
+  enum Result {
+    kSuccess = 0,
+    kNotLoaded,
+    kInvalidImage,      // The template is not a PE file.
+    kNotSigned,         // There is no certificate table or no magic in it.
+    kAlreadyTagged,     // The template has a tag and the tag is not appended.
+    kInvalidTag,        // The tag is empty or has characters not allowed.
+    kTagTooLong,        // The tag does not fit in the tag length.
+    kNoSpace,           // The tag does not fit in the table, which cannot grow.
+    kReadError,
+    kWriteError,
+  };
+
+  // A piece of the tagged copy: either |length| bytes of the template at
+  // |offset|, or |data| if it is not empty.
+  struct Segment {
+    uint64_t offset = 0;
+    uint64_t length = 0;
+    std::string data;
+  };
+  typedef std::vector<Segment> Overlay;
+
+  static const size_t kMaxTagSize = TagReader::kMaxTagSize;
+
+  // The size of the buffer used by Write().
+  static const size_t kBufferSize = 64 * 1024;
+
+  TagTemplate();
+
+  // Reads and validates the headers of |source|, which must outlive this
+  // object.
+  Result Load(Source* source);
+
+  // Forgets the template.
+  void Reset();
+
+  // Returns the pieces of the copy of the template tagged with |tag|. If
+  // |append| is true, |tag| is appended to the tag of the template, if any.
+  Result MakeOverlay(const std::string& tag, bool append,
+                     Overlay* overlay) const;
+
+  // Writes the template with |overlay| applied.
+  Result Write(const Overlay& overlay, Writer* output) const;
+
+  // Returns true if |tag| only has the characters of kValidTagStringRegEx.
+  static bool IsValidTag(const std::string& tag);
+
+  static const char* ResultToString(Result result);
+
+  bool is_loaded() const { return source_ != NULL; }
+  uint64_t size() const { return size_; }
+  const std::string& existing_tag() const { return existing_tag_; }
+
+ private:
+  Source* source_;
+  uint64_t size_;
+
+  // The offset of the security entry of the data directories.
+  uint32_t cert_dir_entry_offset_;
+
+  // The certificate table, as the security entry describes it.
+  uint32_t cert_table_offset_;
+  uint32_t cert_table_size_;
+
+  // The length of the first WIN_CERTIFICATE of the table.
+  uint32_t win_certificate_length_;
+
+  // The offset of the magic in the file.
+  uint32_t magic_offset_;
+
+  std::string existing_tag_;
+
+  DISALLOW_COPY_AND_ASSIGN(TagTemplate);
+};
+
+// Tags copies of a template file. The template is opened once and held open
+// until the object is destroyed.
+class TagTemplateFile {
+ public:
+  struct Request {
+    std::string tag;
+    std::string output_path;
+  };
+
+  TagTemplateFile();
+  ~TagTemplateFile();
+
+  TagTemplate::Result Open(const std::string& path);
+  void Close();
+
+  // Writes a copy of the template tagged with |tag| to |output_path|. The
+  // output is deleted if the copy fails.
+  TagTemplate::Result TagToFile(const std::string& tag,
+                                bool append,
+                                const std::string& output_path);
+
+  // Tags a copy for each request, in order, and returns one result for each.
+  // Returns the number of copies written.
+  size_t TagBatch(const std::vector<Request>& requests,
+                  bool append,
+                  std::vector<TagTemplate::Result>* results);
+
+  const TagTemplate& tag_template() const { return template_; }
+
+ private:
+  TagTemplate::Result WriteOverlay(const TagTemplate::Overlay& overlay,
+                                   FILE* output);
+
+  FILE* file_;
+  std::unique_ptr<TagReader::FileSource> source_;
+  TagTemplate template_;
+
+  DISALLOW_COPY_AND_ASSIGN(TagTemplateFile);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_BASE_TAG_TEMPLATE_H_
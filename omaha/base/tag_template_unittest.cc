@@ -0,0 +1,460 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/base/tag_template.h"
+
+#include <string.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace omaha {
+
+namespace {
+
+const uint32_t kPeHeader = 0x80;
+const char kMagic[] = "Gact2.0Omaha";
+
+class StringSource : public TagTemplate::Source {
+ public:
+  explicit StringSource(const std::string& data) : data_(data) {}
+
+  uint64_t size() const override { return data_.size(); }
+
+  bool ReadAt(uint64_t offset, uint8_t* buffer, size_t size) override {
+    if (offset > data_.size() || size > data_.size() - offset) {
+      return false;
+    }
+    memcpy(buffer, data_.data() + offset, size);
+    return true;
+  }
+
+ private:
+  const std::string data_;
+
+  DISALLOW_COPY_AND_ASSIGN(StringSource);
+};
+
+class StringWriter : public TagTemplate::Writer {
+ public:
+  StringWriter() {}
+
+  bool Write(const uint8_t* data, size_t size) override {
+    data_.append(reinterpret_cast<const char*>(data), size);
+    return true;
+  }
+
+  const std::string& data() const { return data_; }
+
+ private:
+  std::string data_;
+
+  DISALLOW_COPY_AND_ASSIGN(StringWriter);
+};
+
+void PutUint16(uint16_t value, std::string* data, size_t offset) {
+  (*data)[offset] = static_cast<char>(value & 0xFF);
+  (*data)[offset + 1] = static_cast<char>(value >> 8);
+}
+
+void PutUint32(uint32_t value, std::string* data, size_t offset) {
+  for (int i = 0; i != 4; ++i) {
+    (*data)[offset + i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+  }
+}
+
+uint32_t GetUint32(const std::string& data, size_t offset) {
+  uint32_t value = 0;
+  for (int i = 0; i != 4; ++i) {
+    value |= static_cast<uint32_t>(static_cast<uint8_t>(data[offset + i]))
+             << (8 * i);
+  }
+  return value;
+}
+
+struct ImageOptions {
+  bool pe32_plus = false;
+  size_t body_size = 0x2000;
+  size_t padding = 64;
+  bool has_magic = true;
+  std::string trailing_data;
+};
+
+uint32_t CertDirEntryOffset(bool pe32_plus) {
+  return kPeHeader + (pe32_plus ? 168 : 152);
+}
+
+// Builds a PE file with a signature followed by the magic and an empty tag,
+// as the signing step leaves them.
+std::string MakeImage(const ImageOptions& options) {
+  std::mt19937 generator(static_cast<unsigned int>(options.body_size));
+  std::string image(options.body_size, '\0');
+  for (size_t i = 0x200; i != image.size(); ++i) {
+    image[i] = static_cast<char>(generator() & 0xFF);
+  }
+  image[0] = 'M';
+  image[1] = 'Z';
+  PutUint32(kPeHeader, &image, 60);
+  memcpy(&image[kPeHeader], "PE\0\0", 4);
+  PutUint16(options.pe32_plus ? 0x20b : 0x10b, &image, kPeHeader + 24);
+  PutUint32(16, &image, kPeHeader + (options.pe32_plus ? 132 : 116));
+
+  std::string table(8, '\0');
+  table += "\x30\x82\x01\x00";
+  for (int i = 0; i != 0x100; ++i) {
+    table.push_back(static_cast<char>(generator() & 0xFF));
+  }
+  PutUint32(static_cast<uint32_t>(table.size()), &table, 0);
+  PutUint16(0x0200, &table, 4);
+  PutUint16(0x0002, &table, 6);
+  table.resize((table.size() + 7) & ~7);
+  if (options.has_magic) {
+    table += kMagic;
+    table += std::string(2, '\0');
+  }
+  table += std::string(options.padding, '\0');
+  table.resize((table.size() + 7) & ~7);
+
+  PutUint32(static_cast<uint32_t>(image.size()), &image,
+            CertDirEntryOffset(options.pe32_plus));
+  PutUint32(static_cast<uint32_t>(table.size()), &image,
+            CertDirEntryOffset(options.pe32_plus) + 4);
+  return image + table + options.trailing_data;
+}
+
+// Tags |image| the way ApplyTag does, by writing over the padding.
+std::string TagInPlace(const std::string& image, const std::string& tag) {
+  std::string tagged = image;
+  const size_t magic = tagged.find(kMagic);
+  tagged[magic + 12] = static_cast<char>(tag.size() >> 8);
+  tagged[magic + 13] = static_cast<char>(tag.size() & 0xFF);
+  tagged.replace(magic + 14, tag.size(), tag);
+  return tagged;
+}
+
+TagTemplate::Result Tag(const std::string& image,
+                        const std::string& tag,
+                        bool append,
+                        std::string* tagged) {
+  StringSource source(image);
+  TagTemplate tag_template;
+  TagTemplate::Result result = tag_template.Load(&source);
+  if (result != TagTemplate::kSuccess) {
+    return result;
+  }
+  TagTemplate::Overlay overlay;
+  result = tag_template.MakeOverlay(tag, append, &overlay);
+  if (result != TagTemplate::kSuccess) {
+    return result;
+  }
+  StringWriter writer;
+  result = tag_template.Write(overlay, &writer);
+  *tagged = writer.data();
+  return result;
+}
+
+std::string ReadTag(const std::string& image) {
+  StringSource source(image);
+  TagTemplate tag_template;
+  EXPECT_EQ(TagTemplate::kSuccess, tag_template.Load(&source));
+  return tag_template.existing_tag();
+}
+
+std::string ReadFile(const std::filesystem::path& path) {
+  std::ifstream file(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file),
+                     std::istreambuf_iterator<char>());
+}
+
+void WriteFile(const std::filesystem::path& path, const std::string& data) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write(data.data(), data.size());
+}
+
+std::filesystem::path MakeTempDir(const char* name) {
+  const std::filesystem::path dir =
+      std::filesystem::temp_directory_path() /
+      (std::string(name) + "_" +
+       std::to_string(reinterpret_cast<uintptr_t>(&dir)));
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  return dir;
+}
+
+}  // namespace
+
+TEST(TagTemplateTest, Load) {
+  for (int pe32_plus = 0; pe32_plus != 2; ++pe32_plus) {
+    ImageOptions options;
+    options.pe32_plus = !!pe32_plus;
+    const std::string image = MakeImage(options);
+    StringSource source(image);
+    TagTemplate tag_template;
+    EXPECT_FALSE(tag_template.is_loaded());
+    EXPECT_EQ(TagTemplate::kSuccess, tag_template.Load(&source));
+    EXPECT_TRUE(tag_template.is_loaded());
+    EXPECT_EQ(image.size(), tag_template.size());
+    EXPECT_TRUE(tag_template.existing_tag().empty());
+
+    tag_template.Reset();
+    EXPECT_FALSE(tag_template.is_loaded());
+  }
+}
+
+TEST(TagTemplateTest, Load_Errors) {
+  ImageOptions options;
+  const std::string image = MakeImage(options);
+  TagTemplate tag_template;
+
+  std::string not_pe = image;
+  not_pe[0] = 'X';
+  StringSource not_pe_source(not_pe);
+  EXPECT_EQ(TagTemplate::kInvalidImage, tag_template.Load(&not_pe_source));
+
+  StringSource truncated_source(image.substr(0, kPeHeader + 10));
+  EXPECT_EQ(TagTemplate::kInvalidImage, tag_template.Load(&truncated_source));
+
+  std::string unsigned_image = image.substr(0, options.body_size);
+  PutUint32(0, &unsigned_image, CertDirEntryOffset(false));
+  PutUint32(0, &unsigned_image, CertDirEntryOffset(false) + 4);
+  StringSource unsigned_source(unsigned_image);
+  EXPECT_EQ(TagTemplate::kNotSigned, tag_template.Load(&unsigned_source));
+
+  std::string past_end = image;
+  PutUint32(static_cast<uint32_t>(image.size()), &past_end,
+            CertDirEntryOffset(false) + 4);
+  StringSource past_end_source(past_end);
+  EXPECT_EQ(TagTemplate::kInvalidImage, tag_template.Load(&past_end_source));
+
+  options.has_magic = false;
+  StringSource no_magic_source(MakeImage(options));
+  EXPECT_EQ(TagTemplate::kNotSigned, tag_template.Load(&no_magic_source));
+
+  // The tag length points past the table.
+  std::string bad_length = image;
+  bad_length[bad_length.find(kMagic) + 12] = '\x01';
+  StringSource bad_length_source(bad_length);
+  EXPECT_EQ(TagTemplate::kInvalidImage,
+            tag_template.Load(&bad_length_source));
+
+  EXPECT_FALSE(tag_template.is_loaded());
+}
+
+TEST(TagTemplateTest, TagInPlace) {
+  for (int pe32_plus = 0; pe32_plus != 2; ++pe32_plus) {
+    ImageOptions options;
+    options.pe32_plus = !!pe32_plus;
+    options.trailing_data = "trailing data";
+    const std::string image = MakeImage(options);
+
+    std::string tagged;
+    EXPECT_EQ(TagTemplate::kSuccess,
+              Tag(image, "appguid={8A69D345}&lang=en", false, &tagged));
+    EXPECT_TRUE(tagged == TagInPlace(image, "appguid={8A69D345}&lang=en"));
+    EXPECT_EQ("appguid={8A69D345}&lang=en", ReadTag(tagged));
+  }
+}
+
+TEST(TagTemplateTest, AlreadyTagged) {
+  const std::string image = MakeImage(ImageOptions());
+  std::string tagged;
+  ASSERT_EQ(TagTemplate::kSuccess, Tag(image, "first", false, &tagged));
+
+  std::string retagged;
+  EXPECT_EQ(TagTemplate::kAlreadyTagged,
+            Tag(tagged, "second", false, &retagged));
+
+  EXPECT_EQ(TagTemplate::kSuccess, Tag(tagged, "&second", true, &retagged));
+  EXPECT_EQ("first&second", ReadTag(retagged));
+  EXPECT_EQ(tagged.size(), retagged.size());
+}
+
+TEST(TagTemplateTest, GrowTable) {
+  for (int pe32_plus = 0; pe32_plus != 2; ++pe32_plus) {
+    ImageOptions options;
+    options.pe32_plus = !!pe32_plus;
+    options.padding = 2;
+    const std::string image = MakeImage(options);
+    const uint32_t entry = CertDirEntryOffset(options.pe32_plus);
+    const uint32_t table_offset = GetUint32(image, entry);
+    const uint32_t table_size = GetUint32(image, entry + 4);
+
+    const std::string tag(1001, 'a');
+    std::string tagged;
+    ASSERT_EQ(TagTemplate::kSuccess, Tag(image, tag, false, &tagged));
+    EXPECT_EQ(tag, ReadTag(tagged));
+
+    // The table grows to hold the tag and stays aligned.
+    const uint32_t new_table_size = GetUint32(tagged, entry + 4);
+    EXPECT_EQ(tagged.size(), table_offset + new_table_size);
+    EXPECT_EQ(0u, new_table_size % 8);
+    EXPECT_EQ(table_offset, GetUint32(tagged, entry));
+    EXPECT_EQ(GetUint32(image, table_offset) + new_table_size - table_size,
+              GetUint32(tagged, table_offset));
+
+    // Everything else up to the tag is unchanged.
+    const size_t magic = image.find(kMagic);
+    EXPECT_EQ(image.substr(0, entry + 4), tagged.substr(0, entry + 4));
+    EXPECT_EQ(image.substr(entry + 8, table_offset - entry - 8),
+              tagged.substr(entry + 8, table_offset - entry - 8));
+    EXPECT_EQ(image.substr(table_offset + 4, magic - table_offset - 4),
+              tagged.substr(table_offset + 4, magic - table_offset - 4));
+  }
+}
+
+TEST(TagTemplateTest, GrowTable_NotAtEnd) {
+  ImageOptions options;
+  options.padding = 2;
+  options.trailing_data = "trailing data";
+  std::string tagged;
+  EXPECT_EQ(TagTemplate::kNoSpace,
+            Tag(MakeImage(options), std::string(100, 'a'), false, &tagged));
+}
+
+TEST(TagTemplateTest, InvalidTag) {
+  const std::string image = MakeImage(ImageOptions());
+  std::string tagged;
+  EXPECT_EQ(TagTemplate::kInvalidTag, Tag(image, "", false, &tagged));
+  EXPECT_EQ(TagTemplate::kInvalidTag, Tag(image, "a b", false, &tagged));
+  EXPECT_EQ(TagTemplate::kInvalidTag, Tag(image, "a\"b", false, &tagged));
+  EXPECT_EQ(TagTemplate::kTagTooLong,
+            Tag(image, std::string(0x10000, 'a'), false, &tagged));
+
+  EXPECT_TRUE(TagTemplate::IsValidTag("appguid={8A69D345-D564}&lang=en-GB"));
+  EXPECT_TRUE(TagTemplate::IsValidTag("a%20b/c,d.e_f"));
+  EXPECT_FALSE(TagTemplate::IsValidTag("a+b"));
+}
+
+TEST(TagTemplateTest, NotLoaded) {
+  TagTemplate tag_template;
+  TagTemplate::Overlay overlay;
+  EXPECT_EQ(TagTemplate::kNotLoaded,
+            tag_template.MakeOverlay("tag", false, &overlay));
+  StringWriter writer;
+  EXPECT_EQ(TagTemplate::kNotLoaded, tag_template.Write(overlay, &writer));
+}
+
+TEST(TagTemplateFileTest, TagBatch) {
+  const std::filesystem::path dir = MakeTempDir("tag_template_unittest");
+  ImageOptions options;
+  options.body_size = 3 * TagTemplate::kBufferSize + 17;
+  options.padding = 100;
+  const std::string image = MakeImage(options);
+  WriteFile(dir / "template.exe", image);
+
+  TagTemplateFile tagger;
+  ASSERT_EQ(TagTemplate::kSuccess,
+            tagger.Open((dir / "template.exe").string()));
+
+  std::vector<TagTemplateFile::Request> requests(4);
+  requests[0].tag = "appguid=1";
+  requests[1].tag = std::string(500, 'b');
+  requests[2].tag = "not valid";
+  requests[3].tag = "appguid=4";
+  for (size_t i = 0; i != requests.size(); ++i) {
+    requests[i].output_path =
+        (dir / ("tagged" + std::to_string(i) + ".exe")).string();
+  }
+
+  std::vector<TagTemplate::Result> results;
+  EXPECT_EQ(3u, tagger.TagBatch(requests, false, &results));
+  ASSERT_EQ(4u, results.size());
+  EXPECT_EQ(TagTemplate::kSuccess, results[0]);
+  EXPECT_EQ(TagTemplate::kSuccess, results[1]);
+  EXPECT_EQ(TagTemplate::kInvalidTag, results[2]);
+  EXPECT_EQ(TagTemplate::kSuccess, results[3]);
+
+  EXPECT_TRUE(ReadFile(requests[0].output_path) ==
+              TagInPlace(image, "appguid=1"));
+  std::string expected;
+  EXPECT_EQ(TagTemplate::kSuccess,
+            Tag(image, requests[1].tag, false, &expected));
+  EXPECT_TRUE(ReadFile(requests[1].output_path) == expected);
+  EXPECT_FALSE(std::filesystem::exists(requests[2].output_path));
+  EXPECT_TRUE(ReadFile(requests[3].output_path) ==
+              TagInPlace(image, "appguid=4"));
+
+  // The tagged copies are templates too.
+  TagTemplateFile retagger;
+  ASSERT_EQ(TagTemplate::kSuccess, retagger.Open(requests[0].output_path));
+  EXPECT_EQ("appguid=1", retagger.tag_template().existing_tag());
+  const std::string appended_path = (dir / "appended.exe").string();
+  EXPECT_EQ(TagTemplate::kSuccess,
+            retagger.TagToFile("&lang=en", true, appended_path));
+  EXPECT_EQ("appguid=1&lang=en", ReadTag(ReadFile(appended_path)));
+
+  tagger.Close();
+  retagger.Close();
+  EXPECT_NE(TagTemplate::kSuccess,
+            tagger.Open((dir / "missing.exe").string()));
+  std::filesystem::remove_all(dir);
+}
+
+// Compares tagging copies of a template by reading and writing each whole
+// copy, as ApplyTag does, with tagging them from one loaded template.
+TEST(TagTemplateFileTest, TaggingBenchmark) {
+  const std::filesystem::path dir = MakeTempDir("tag_template_benchmark");
+  ImageOptions options;
+  options.body_size = 2 * 1024 * 1024;
+  const std::string image = MakeImage(options);
+  const std::string template_path = (dir / "template.exe").string();
+  WriteFile(template_path, image);
+
+  const int kNumCopies = 200;
+  std::vector<TagTemplateFile::Request> requests(kNumCopies);
+  for (int i = 0; i != kNumCopies; ++i) {
+    requests[i].tag = "appguid=" + std::to_string(i) + "&lang=en";
+    requests[i].output_path =
+        (dir / ("copy" + std::to_string(i) + ".exe")).string();
+  }
+
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  for (int i = 0; i != kNumCopies; ++i) {
+    const std::string data = ReadFile(template_path);
+    WriteFile(requests[i].output_path, TagInPlace(data, requests[i].tag));
+  }
+  const std::chrono::duration<double, std::milli> whole_file_time =
+      std::chrono::steady_clock::now() - start;
+
+  start = std::chrono::steady_clock::now();
+  TagTemplateFile tagger;
+  ASSERT_EQ(TagTemplate::kSuccess, tagger.Open(template_path));
+  std::vector<TagTemplate::Result> results;
+  EXPECT_EQ(static_cast<size_t>(kNumCopies),
+            tagger.TagBatch(requests, false, &results));
+  const std::chrono::duration<double, std::milli> template_time =
+      std::chrono::steady_clock::now() - start;
+
+  EXPECT_TRUE(ReadFile(requests[kNumCopies - 1].output_path) ==
+              TagInPlace(image, requests[kNumCopies - 1].tag));
+
+  std::cout << kNumCopies << " copies of " << image.size() << " bytes: "
+            << "whole file " << whole_file_time.count() << " ms, "
+            << "template " << template_time.count() << " ms" << std::endl;
+
+  tagger.Close();
+  std::filesystem::remove_all(dir);
+}
+
+}  // namespace omaha
@@ -24,6 +24,17 @@
 
 namespace omaha {
 
+namespace {
+
+// The maximum number of threads in the pool. The pool starts with one thread
+// and grows when work items are queued while all the threads are busy.
+const int kMaxThreads = 32;
+
+// The maximum number of queued work items for each priority.
+const size_t kMaxQueuedWorkItems = 1000;
+
+}  // namespace
+
 // Context keeps track the information necessary to execute a work item
 // inside a thread pool thread.
 class ThreadPool::Context {
@@ -40,6 +51,8 @@ class ThreadPool::Context {
   UserWorkItem* work_item() const { return work_item_.get(); }
   DWORD coinit_flags() const { return coinit_flags_; }
 
+  void reset_work_item() { work_item_.reset(); }
+
  private:
   ThreadPool*   pool_;
   std::unique_ptr<UserWorkItem> work_item_;
@@ -49,15 +62,6 @@ class ThreadPool::Context {
 };
 
 
-DWORD WINAPI ThreadPool::ThreadProc(void* param) {
-  UTIL_LOG(L4, (_T("[ThreadPool::ThreadProc]")));
-  ASSERT1(param);
-  std::unique_ptr<Context> context(static_cast<Context*>(param));
-  auto thread_pool = context->pool();
-  thread_pool->ProcessWorkItemInContext(std::move(context));
-  return 0;
-}
-
 ThreadPool::ThreadPool()
     : work_item_count_(0),
       is_stopped_(true),
@@ -83,7 +87,16 @@ HRESULT ThreadPool::Initialize(int shutdown_delay) {
   set_is_stopped(false);
   shutdown_delay_ = shutdown_delay;
   reset(shutdown_event_, ::CreateEvent(NULL, true, false, NULL));
-  return shutdown_event_ ? S_OK : HRESULTFromLastError();
+  if (!shutdown_event_) {
+    return HRESULTFromLastError();
+  }
+
+  WorkStealingExecutor::Options options;
+  options.min_threads = 1;
+  options.max_threads = kMaxThreads;
+  options.max_queued_tasks = kMaxQueuedWorkItems;
+  executor_ = std::make_unique<WorkStealingExecutor>(options);
+  return S_OK;
 }
 
 void ThreadPool::Stop() {
@@ -93,21 +106,36 @@ void ThreadPool::Stop() {
      return;
   }
 
-  DWORD baseline_tick_count = ::GetTickCount();
-  if (::SetEvent(get(shutdown_event_))) {
-    while (HasWorkItems()) {
-      ::Sleep(1);
-      if (TimeHasElapsed(baseline_tick_count, shutdown_delay_)) {
-        UTIL_LOG(LE, (_T("[ThreadPool::Stop][timeout elapsed]")));
-        break;
-      }
+  // The running work items watch the shutdown event. The queued work items
+  // keep running until the shutdown delay elapses, then the executor cancels
+  // the work items which are still queued.
+  if (::SetEvent(get(shutdown_event_)) && executor_) {
+    if (!executor_->Drain(std::chrono::milliseconds(shutdown_delay_))) {
+      UTIL_LOG(LE, (_T("[ThreadPool::Stop][timeout elapsed]")));
+    }
+    executor_->Shutdown(std::chrono::milliseconds(0));
+
+    const WorkStealingExecutor::Stats stats = executor_->GetStats();
+    for (int i = 0; i != WorkStealingExecutor::kNumPriorities; ++i) {
+      UTIL_LOG(L2, (_T("[ThreadPool::Stop][priority %d][executed %I64u]")
+                    _T("[max depth %Iu][max latency %I64u us]"),
+                    i, stats.num_executed[i], stats.max_queue_depth[i],
+                    stats.max_latency_us[i]));
     }
+    UTIL_LOG(L2, (_T("[ThreadPool::Stop][threads %d][stolen %I64u]")
+                  _T("[rejected %I64u][cancelled %I64u]"),
+                  stats.num_threads, stats.num_stolen, stats.num_rejected,
+                  stats.num_cancelled));
   }
 
   set_is_stopped(true);
 }
 
-void ThreadPool::ProcessWorkItemInContext(std::unique_ptr<Context> context) {
+WorkStealingExecutor::Stats ThreadPool::GetStats() const {
+  return executor_ ? executor_->GetStats() : WorkStealingExecutor::Stats();
+}
+
+void ThreadPool::ProcessWorkItemInContext(Context* context) {
   ASSERT1(context);
 
   {
@@ -115,33 +143,58 @@ void ThreadPool::ProcessWorkItemInContext(std::unique_ptr<Context> context) {
     ASSERT1(SUCCEEDED(init_com_apt.hresult()));
 
     context->work_item()->Process();
-    context.reset();
+    context->reset_work_item();
+  }
+
+  ::InterlockedDecrement(&work_item_count_);
+}
+
+void ThreadPool::CancelWorkItemInContext(Context* context) {
+  ASSERT1(context);
+  UTIL_LOG(L3, (_T("[ThreadPool::CancelWorkItemInContext]")));
+
+  {
+    // Work items expect to be destroyed in the apartment they run in.
+    scoped_co_init init_com_apt(context->coinit_flags());
+    context->reset_work_item();
   }
 
   ::InterlockedDecrement(&work_item_count_);
 }
 
 HRESULT ThreadPool::QueueUserWorkItem(std::unique_ptr<UserWorkItem> work_item,
-                                      DWORD coinit_flags,
-                                      uint32 flags) {
+                                      DWORD coinit_flags) {
   UTIL_LOG(L4, (_T("[ThreadPool::QueueUserWorkItem]")));
   ASSERT1(work_item);
 
-  if (is_stopped()) {
+  if (is_stopped() || !executor_) {
      return E_FAIL;
   }
 
   work_item->set_shutdown_event(get(shutdown_event_));
-  auto context = std::make_unique<Context>(this,
+  const WorkStealingExecutor::Priority priority = work_item->priority();
+  const uint64 affinity_key = work_item->affinity_key();
+
+  // The task and the cancel callback share the context. Only one of them runs.
+  auto context = std::make_shared<Context>(this,
                                            std::move(work_item),
                                            coinit_flags);
   ::InterlockedIncrement(&work_item_count_);
-  if (!::QueueUserWorkItem(&ThreadPool::ThreadProc, context.get(), flags)) {
+  if (!executor_->Submit(
+          [context]() {
+            context->pool()->ProcessWorkItemInContext(context.get());
+          },
+          priority,
+          affinity_key,
+          [context]() {
+            context->pool()->CancelWorkItemInContext(context.get());
+          })) {
     ::InterlockedDecrement(&work_item_count_);
-    return HRESULTFromLastError();
+    UTIL_LOG(LE, (_T("[ThreadPool::QueueUserWorkItem][queue full or stopped]")
+                  _T("[priority %d]"), priority));
+    return HRESULT_FROM_WIN32(ERROR_NOT_ENOUGH_QUOTA);
   }
 
-  context.release();
   return S_OK;
 }
 
@@ -22,13 +22,17 @@
 #include <memory>
 
 #include "base/basictypes.h"
+#include "omaha/base/work_stealing_executor.h"
 #include "omaha/third_party/smartany/scoped_any.h"
 
 namespace omaha {
 
 class UserWorkItem {
  public:
-  UserWorkItem() : shutdown_event_(NULL) {}
+  UserWorkItem()
+      : shutdown_event_(NULL),
+        priority_(WorkStealingExecutor::kPriorityForeground),
+        affinity_key_(0) {}
   virtual ~UserWorkItem() {}
 
   // Template method interface
@@ -39,6 +43,19 @@ class UserWorkItem {
     shutdown_event_ = shutdown_event;
   }
 
+  // Work items run ahead of the queued work items of a lower priority.
+  WorkStealingExecutor::Priority priority() const { return priority_; }
+  void set_priority(WorkStealingExecutor::Priority priority) {
+    priority_ = priority;
+  }
+
+  // Work items with the same non-zero affinity key, such as the work items
+  // for the same app bundle, preferably run on the same thread.
+  uint64 affinity_key() const { return affinity_key_; }
+  void set_affinity_key(uint64 affinity_key) {
+    affinity_key_ = affinity_key;
+  }
+
  private:
   // Executes the work item.
   virtual void DoProcess() = 0;
@@ -47,6 +64,10 @@ class UserWorkItem {
   // and shutdown correctly. This event is set when the thread pool is closing.
   // Do not close this event as is owned by the thread pool.
   HANDLE shutdown_event_;
+
+  WorkStealingExecutor::Priority priority_;
+  uint64 affinity_key_;
+
   DISALLOW_COPY_AND_ASSIGN(UserWorkItem);
 };
 
@@ -60,23 +81,28 @@ class ThreadPool {
   HRESULT Initialize(int shutdown_delay);
   void Stop();
 
-  // Adds a work item to the queue.
+  // Adds a work item to the queue of its priority. The pool grows when all
+  // its threads are busy, so long-running work items do not need a hint.
+  // The work items still queued when the shutdown delay elapses after the
+  // pool stops are destroyed without running.
   HRESULT QueueUserWorkItem(std::unique_ptr<UserWorkItem> work_item,
-                            DWORD coinit_flags,
-                            uint32 flags);
+                            DWORD coinit_flags);
 
   bool HasWorkItems() const {
     return work_item_count_ > 0;
   }
 
+  // Returns the queue depth and latency counters of the pool.
+  WorkStealingExecutor::Stats GetStats() const;
+
  private:
   class Context;
 
   // Calls UserWorkItem::Process() in the context of the worker thread.
-  void ProcessWorkItemInContext(std::unique_ptr<Context> context);
+  void ProcessWorkItemInContext(Context* context);
 
-  // This is the thread callback required by the underlying windows API.
-  static DWORD WINAPI ThreadProc(void* context);
+  // Destroys a work item which was queued when the pool stopped.
+  void CancelWorkItemInContext(Context* context);
 
   bool is_stopped() const {
     return !!is_stopped_;
@@ -101,6 +127,8 @@ class ThreadPool {
   // the thread pool is shutting down. The shutdown delay resolution is ~10ms.
   int shutdown_delay_;
 
+  std::unique_ptr<WorkStealingExecutor> executor_;
+
   DISALLOW_COPY_AND_ASSIGN(ThreadPool);
 };
 
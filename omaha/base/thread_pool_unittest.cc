@@ -81,8 +81,7 @@ class ReentrantJob2 : public UserWorkItem {
     EXPECT_TRUE(thread_pool_->HasWorkItems());
     thread_pool_->QueueUserWorkItem(
         std::make_unique<ReentrantJob3>(thread_pool_),
-        COINIT_MULTITHREADED,
-        WT_EXECUTEDEFAULT);
+        COINIT_MULTITHREADED);
     thread_pool_->Stop();
   }
   ThreadPool* thread_pool_ = nullptr;
@@ -98,8 +97,7 @@ class ReentrantJob1 : public UserWorkItem {
     EXPECT_TRUE(thread_pool_->HasWorkItems());
     thread_pool_->QueueUserWorkItem(
         std::make_unique<ReentrantJob2>(thread_pool_),
-        COINIT_MULTITHREADED,
-        WT_EXECUTEDEFAULT);
+        COINIT_MULTITHREADED);
   }
   ThreadPool* thread_pool_ = nullptr;
   DISALLOW_COPY_AND_ASSIGN(ReentrantJob1);
@@ -133,21 +131,18 @@ class UserWorkItemCoInitTest : public UserWorkItem {
 
 HRESULT QueueMyJob1(ThreadPool* thread_pool) {
   return thread_pool->QueueUserWorkItem(std::make_unique<MyJob1>(),
-                                        COINIT_MULTITHREADED,
-                                        WT_EXECUTEDEFAULT);
+                                        COINIT_MULTITHREADED);
 
 }
 
 HRESULT QueueMyJob2(ThreadPool* thread_pool) {
   return thread_pool->QueueUserWorkItem(std::make_unique<MyJob2>(),
-                                        COINIT_MULTITHREADED,
-                                        WT_EXECUTEDEFAULT);
+                                        COINIT_MULTITHREADED);
 }
 
 HRESULT QueueMyJob3(ThreadPool* thread_pool) {
   return thread_pool->QueueUserWorkItem(std::make_unique<MyJob3>(),
-                                        COINIT_MULTITHREADED,
-                                        WT_EXECUTEDEFAULT);
+                                        COINIT_MULTITHREADED);
 }
 
 HRESULT QueueUserWorkItemCoInitTest(ThreadPool* thread_pool,
@@ -157,8 +152,7 @@ HRESULT QueueUserWorkItemCoInitTest(ThreadPool* thread_pool,
   EXPECT_HRESULT_SUCCEEDED(
       thread_pool->QueueUserWorkItem(std::make_unique<UserWorkItemCoInitTest>(
           coinit_flags_workitem, coinit_expected_hresult),
-          coinit_flags_threadpool,
-          WT_EXECUTEDEFAULT));
+          coinit_flags_threadpool));
   return S_OK;
 }
 
@@ -228,6 +222,41 @@ TEST(ThreadPoolTest, UserWorkItemCoInitTest) {
   thread_pool.Stop();
 }
 
+// Queues work items with different priorities and checks they are counted
+// against their priority.
+TEST(ThreadPoolTest, Priorities) {
+  const int kShutdownDelayMs = 0;
+
+  ThreadPool thread_pool;
+  ASSERT_HRESULT_SUCCEEDED(thread_pool.Initialize(kShutdownDelayMs));
+
+  auto job1 = std::make_unique<MyJob1>();
+  job1->set_priority(WorkStealingExecutor::kPriorityIdle);
+  EXPECT_HRESULT_SUCCEEDED(thread_pool.QueueUserWorkItem(std::move(job1),
+                                                         COINIT_MULTITHREADED));
+  auto job2 = std::make_unique<MyJob2>();
+  job2->set_priority(WorkStealingExecutor::kPriorityBackground);
+  job2->set_affinity_key(1);
+  EXPECT_HRESULT_SUCCEEDED(thread_pool.QueueUserWorkItem(std::move(job2),
+                                                         COINIT_MULTITHREADED));
+  EXPECT_HRESULT_SUCCEEDED(QueueMyJob3(&thread_pool));
+
+  const int kMaxWaitForJobsMs = 2000;
+  LowResTimer t(true);
+  while (thread_pool.HasWorkItems() &&
+         t.GetMilliseconds() < kMaxWaitForJobsMs) {
+    ::Sleep(100);
+  }
+  thread_pool.Stop();
+
+  const WorkStealingExecutor::Stats stats = thread_pool.GetStats();
+  EXPECT_EQ(1, stats.num_executed[WorkStealingExecutor::kPriorityForeground]);
+  EXPECT_EQ(1, stats.num_executed[WorkStealingExecutor::kPriorityBackground]);
+  EXPECT_EQ(1, stats.num_executed[WorkStealingExecutor::kPriorityIdle]);
+  EXPECT_EQ(0, stats.num_cancelled);
+  EXPECT_FALSE(thread_pool.HasWorkItems());
+}
+
 // Creates a couple of reentrant work items. A work item schedules another,
 // then that work item stops the thread pool, then it schedules one more work
 // item. Expects the work items to complete while the thread pool is spinning
@@ -235,8 +264,7 @@ TEST(ThreadPoolTest, UserWorkItemCoInitTest) {
 TEST(ThreadPoolTest, Reentrant) {
   ThreadPool thread_pool;
   thread_pool.QueueUserWorkItem(std::make_unique<ReentrantJob1>(&thread_pool),
-                                COINIT_MULTITHREADED,
-                                WT_EXECUTEDEFAULT);
+                                COINIT_MULTITHREADED);
   thread_pool.Stop();
   EXPECT_FALSE(thread_pool.HasWorkItems());
 }
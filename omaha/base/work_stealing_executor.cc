@@ -0,0 +1,301 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/base/work_stealing_executor.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace omaha {
+
+namespace {
+
+// The executor the current thread belongs to, if any. Used by Shutdown() to
+// avoid waiting for the task that calls it.
+thread_local const WorkStealingExecutor* current_executor = nullptr;
+
+WorkStealingExecutor::Options NormalizeOptions(
+    const WorkStealingExecutor::Options& options) {
+  WorkStealingExecutor::Options normalized(options);
+  normalized.max_threads = std::max(normalized.max_threads, 1);
+  normalized.min_threads = std::min(std::max(normalized.min_threads, 1),
+                                    normalized.max_threads);
+  return normalized;
+}
+
+}  // namespace
+
+WorkStealingExecutor::WorkStealingExecutor(const Options& options)
+    : options_(NormalizeOptions(options)),
+      num_running_(0),
+      next_queue_(0),
+      num_threads_(0),
+      num_idle_threads_(0),
+      is_shutting_down_(false) {
+  for (auto& queued : queued_) {
+    queued = 0;
+  }
+  for (int i = 0; i != options_.max_threads; ++i) {
+    queues_.push_back(std::make_unique<WorkerQueue>());
+  }
+
+  std::lock_guard<std::mutex> lock(lock_);
+  for (int i = 0; i != options_.min_threads; ++i) {
+    StartThreadLocked();
+  }
+}
+
+WorkStealingExecutor::~WorkStealingExecutor() {
+  Shutdown(std::chrono::milliseconds(0));
+
+  std::vector<std::thread> threads;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    threads.swap(threads_);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+void WorkStealingExecutor::StartThreadLocked() {
+  const int index = num_threads_;
+  threads_.emplace_back(&WorkStealingExecutor::ThreadProc, this, index);
+  ++num_threads_;
+}
+
+bool WorkStealingExecutor::Submit(Task task,
+                                  Priority priority,
+                                  uint64_t affinity_key,
+                                  Task on_cancel) {
+  if (priority < 0 || priority >= kNumPriorities || !task) {
+    return false;
+  }
+
+  Item item;
+  item.task = std::move(task);
+  item.on_cancel = std::move(on_cancel);
+  item.queued_time = std::chrono::steady_clock::now();
+
+  size_t depth = 0;
+  {
+    // The task is queued with |lock_| held so that Shutdown() either rejects
+    // it or cancels it, and so that a thread checking for work before waiting
+    // does not miss the notification.
+    std::lock_guard<std::mutex> lock(lock_);
+    const bool is_full = options_.max_queued_tasks &&
+        queued_[priority] >= static_cast<int64_t>(options_.max_queued_tasks);
+    if (is_shutting_down_ || is_full) {
+      std::lock_guard<std::mutex> stats_lock(stats_lock_);
+      ++stats_.num_rejected;
+      return false;
+    }
+
+    const uint64_t key = affinity_key ? affinity_key : next_queue_++;
+    WorkerQueue* queue = queues_[key % num_threads_].get();
+    {
+      std::lock_guard<std::mutex> queue_lock(queue->lock);
+      queue->lanes[priority].push_back(std::move(item));
+    }
+    depth = static_cast<size_t>(++queued_[priority]);
+
+    // Grows the pool when there are more queued tasks than idle threads to
+    // pick them up.
+    if (NumQueued() > num_idle_threads_ &&
+        num_threads_ < options_.max_threads) {
+      StartThreadLocked();
+    }
+  }
+  work_available_.notify_one();
+
+  std::lock_guard<std::mutex> stats_lock(stats_lock_);
+  stats_.max_queue_depth[priority] =
+      std::max(stats_.max_queue_depth[priority], depth);
+  return true;
+}
+
+bool WorkStealingExecutor::TakeTask(int index, Item* item, Priority* priority) {
+  const int num_threads = num_threads_;
+  for (int p = 0; p != kNumPriorities; ++p) {
+    for (int i = 0; i != num_threads; ++i) {
+      const int victim = (index + i) % num_threads;
+      WorkerQueue* queue = queues_[victim].get();
+      std::lock_guard<std::mutex> queue_lock(queue->lock);
+      std::deque<Item>& lane = queue->lanes[p];
+      if (lane.empty()) {
+        continue;
+      }
+
+      // The owner takes from the front of its queue, in submission order.
+      // Thieves take from the back, which keeps them away from the owner.
+      if (victim == index) {
+        *item = std::move(lane.front());
+        lane.pop_front();
+      } else {
+        *item = std::move(lane.back());
+        lane.pop_back();
+        std::lock_guard<std::mutex> stats_lock(stats_lock_);
+        ++stats_.num_stolen;
+      }
+      *priority = static_cast<Priority>(p);
+      ++num_running_;
+      --queued_[p];
+      return true;
+    }
+  }
+  return false;
+}
+
+void WorkStealingExecutor::RecordStart(Priority priority, const Item& item) {
+  const uint64_t latency_us = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - item.queued_time).count());
+
+  std::lock_guard<std::mutex> stats_lock(stats_lock_);
+  ++stats_.num_executed[priority];
+  stats_.total_latency_us[priority] += latency_us;
+  stats_.max_latency_us[priority] =
+      std::max(stats_.max_latency_us[priority], latency_us);
+}
+
+void WorkStealingExecutor::ThreadProc(int index) {
+  current_executor = this;
+
+  for (;;) {
+    Item item;
+    Priority priority = kPriorityForeground;
+    if (TakeTask(index, &item, &priority)) {
+      if (is_shutting_down()) {
+        // Shutdown() is cancelling the queued tasks, and this one was taken
+        // right before it could.
+        if (item.on_cancel) {
+          item.on_cancel();
+        }
+        std::lock_guard<std::mutex> stats_lock(stats_lock_);
+        ++stats_.num_cancelled;
+      } else {
+        RecordStart(priority, item);
+        item.task();
+      }
+      item = Item();
+
+      // Notifies on each completion rather than on the last one, since
+      // Drain() and Shutdown() called from a task wait for |num_running_| to
+      // drop to one.
+      {
+        std::lock_guard<std::mutex> lock(lock_);
+        --num_running_;
+      }
+      all_done_.notify_all();
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(lock_);
+    ++num_idle_threads_;
+    work_available_.wait(lock, [this] {
+      if (is_shutting_down_) {
+        return true;
+      }
+      return NumQueued() > 0;
+    });
+    --num_idle_threads_;
+    if (is_shutting_down_) {
+      return;
+    }
+  }
+}
+
+bool WorkStealingExecutor::Drain(std::chrono::milliseconds timeout) {
+  // A queued task is counted as running before it leaves the queue, so the
+  // predicate never misses a task moving from one count to the other.
+  const int64_t self = current_executor == this ? 1 : 0;
+  std::unique_lock<std::mutex> lock(lock_);
+  return all_done_.wait_for(lock, timeout, [this, self] {
+    return num_running_ <= self && NumQueued() == 0;
+  });
+}
+
+bool WorkStealingExecutor::Shutdown(std::chrono::milliseconds timeout) {
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    is_shutting_down_ = true;
+  }
+  work_available_.notify_all();
+
+  std::vector<Item> cancelled;
+  for (auto& queue : queues_) {
+    std::lock_guard<std::mutex> queue_lock(queue->lock);
+    for (int p = 0; p != kNumPriorities; ++p) {
+      for (auto& item : queue->lanes[p]) {
+        cancelled.push_back(std::move(item));
+      }
+      queued_[p] -= static_cast<int64_t>(queue->lanes[p].size());
+      queue->lanes[p].clear();
+    }
+  }
+
+  // The cancel callbacks run without any lock held since they may release
+  // resources which call back into the executor.
+  for (auto& item : cancelled) {
+    if (item.on_cancel) {
+      item.on_cancel();
+    }
+    item = Item();
+  }
+  {
+    std::lock_guard<std::mutex> stats_lock(stats_lock_);
+    stats_.num_cancelled += cancelled.size();
+  }
+
+  const int64_t self = current_executor == this ? 1 : 0;
+  std::unique_lock<std::mutex> lock(lock_);
+  return all_done_.wait_for(lock, timeout, [this, self] {
+    return num_running_ <= self;
+  });
+}
+
+bool WorkStealingExecutor::is_shutting_down() const {
+  std::lock_guard<std::mutex> lock(lock_);
+  return is_shutting_down_;
+}
+
+int64_t WorkStealingExecutor::NumQueued() const {
+  int64_t total_queued = 0;
+  for (const auto& queued : queued_) {
+    total_queued += queued;
+  }
+  return total_queued;
+}
+
+size_t WorkStealingExecutor::num_pending() const {
+  const int64_t pending = num_running_ + NumQueued();
+  return pending > 0 ? static_cast<size_t>(pending) : 0;
+}
+
+WorkStealingExecutor::Stats WorkStealingExecutor::GetStats() const {
+  Stats stats;
+  {
+    std::lock_guard<std::mutex> stats_lock(stats_lock_);
+    stats = stats_;
+  }
+  for (int p = 0; p != kNumPriorities; ++p) {
+    const int64_t depth = queued_[p];
+    stats.queue_depth[p] = depth > 0 ? static_cast<size_t>(depth) : 0;
+  }
+  stats.num_threads = num_threads_;
+  return stats;
+}
+
+}  // namespace omaha
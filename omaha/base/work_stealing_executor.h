@@ -0,0 +1,167 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// WorkStealingExecutor runs tasks on a pool of threads. Each thread owns one
+// queue per priority. A thread runs the tasks from its own queues first and
+// steals from the queues of the other threads when its own queues are empty,
+// but a task of a higher priority always runs ahead of the tasks of a lower
+// priority, regardless of the queue it is in.
+//
+// Tasks submitted with the same non-zero affinity key are queued on the same
+// thread, for instance all the work items for one app bundle. The affinity is
+// a preference: idle threads still steal these tasks.
+//
+// The pool starts with |min_threads| threads and grows up to |max_threads|
+// when a task is submitted and all the threads are busy, so that long-running
+// tasks, such as installs, do not starve the other tasks.
+//
+// This file has no platform dependencies.
+
+#ifndef OMAHA_BASE_WORK_STEALING_EXECUTOR_H_
+#define OMAHA_BASE_WORK_STEALING_EXECUTOR_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "base/basictypes.h"
+
+namespace omaha {
+
+class WorkStealingExecutor {
+ public:
+  // Lower values run first.
+  enum Priority {
+    kPriorityForeground = 0,  // Interactive installs and downloads.
+    kPriorityBackground,      // Update checks.
+    kPriorityIdle,            // Pings and other fire-and-forget work.
+    kNumPriorities,
+  };
+
+  using Task = std::function<void()>;
+
+  struct Options {
+    int min_threads = 1;
+    int max_threads = 4;
+
+    // The maximum number of queued tasks for each priority, or 0 for no limit.
+    size_t max_queued_tasks = 0;
+  };
+
+  struct Stats {
+    // The number of tasks waiting to run, currently and at most.
+    size_t queue_depth[kNumPriorities] = {};
+    size_t max_queue_depth[kNumPriorities] = {};
+
+    // The number of tasks started, and the time they waited in the queue.
+    uint64_t num_executed[kNumPriorities] = {};
+    uint64_t total_latency_us[kNumPriorities] = {};
+    uint64_t max_latency_us[kNumPriorities] = {};
+
+    uint64_t num_stolen = 0;
+    uint64_t num_rejected = 0;
+    uint64_t num_cancelled = 0;
+    int num_threads = 0;
+  };
+
+  explicit WorkStealingExecutor(const Options& options);
+
+  // Shuts down the executor if needed, then waits for the threads to exit.
+  ~WorkStealingExecutor();
+
+  // Queues |task|. If the executor shuts down before the task starts,
+  // |on_cancel| is called instead, if it is provided. Returns false if the
+  // executor is shutting down or if the queue for |priority| is full.
+  bool Submit(Task task,
+              Priority priority,
+              uint64_t affinity_key,
+              Task on_cancel);
+
+  // Waits up to |timeout| for the queued and running tasks to complete, while
+  // still accepting new tasks. Returns true if no other task is queued or
+  // running when it returns. It can be called from a task.
+  bool Drain(std::chrono::milliseconds timeout);
+
+  // Stops accepting tasks, cancels the queued tasks, and waits up to |timeout|
+  // for the running tasks to complete. Returns true if no other task is
+  // running when it returns. It can be called from a task.
+  bool Shutdown(std::chrono::milliseconds timeout);
+
+  bool is_shutting_down() const;
+
+  // Returns the number of tasks queued or running.
+  size_t num_pending() const;
+
+  Stats GetStats() const;
+
+ private:
+  struct Item {
+    Task task;
+    Task on_cancel;
+    std::chrono::steady_clock::time_point queued_time;
+  };
+
+  struct WorkerQueue {
+    std::mutex lock;
+    std::deque<Item> lanes[kNumPriorities];
+  };
+
+  // Starts a new thread. Must be called with |lock_| held.
+  void StartThreadLocked();
+
+  void ThreadProc(int index);
+
+  // Takes the next task for the thread |index|, from its own queues first.
+  bool TakeTask(int index, Item* item, Priority* priority);
+
+  void RecordStart(Priority priority, const Item& item);
+
+  // Returns the number of tasks queued, for all the priorities.
+  int64_t NumQueued() const;
+
+  const Options options_;
+
+  // Allocated up front for |max_threads| so that threads can steal from the
+  // queues without locking the executor.
+  std::vector<std::unique_ptr<WorkerQueue>> queues_;
+  std::atomic<int64_t> queued_[kNumPriorities];
+  std::atomic<int64_t> num_running_;
+  std::atomic<uint64_t> next_queue_;
+
+  mutable std::mutex lock_;
+  std::condition_variable work_available_;
+  std::condition_variable all_done_;
+  std::vector<std::thread> threads_;
+  std::atomic<int> num_threads_;
+  int num_idle_threads_;
+  bool is_shutting_down_;
+
+  mutable std::mutex stats_lock_;
+  Stats stats_;
+
+  DISALLOW_COPY_AND_ASSIGN(WorkStealingExecutor);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_BASE_WORK_STEALING_EXECUTOR_H_
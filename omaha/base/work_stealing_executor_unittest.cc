@@ -0,0 +1,366 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/base/work_stealing_executor.h"
+
+#include <iostream>
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace omaha {
+
+namespace {
+
+// Blocks the tasks which call Wait() until Open() is called.
+class Gate {
+ public:
+  void Open() {
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      is_open_ = true;
+    }
+    cv_.notify_all();
+  }
+
+  void Wait() {
+    std::unique_lock<std::mutex> lock(lock_);
+    cv_.wait(lock, [this] { return is_open_; });
+  }
+
+ private:
+  std::mutex lock_;
+  std::condition_variable cv_;
+  bool is_open_ = false;
+};
+
+// Waits until |predicate| is true or a few seconds elapse.
+template <typename Predicate>
+bool WaitFor(Predicate predicate) {
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (!predicate()) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+WorkStealingExecutor::Options MakeOptions(int min_threads, int max_threads) {
+  WorkStealingExecutor::Options options;
+  options.min_threads = min_threads;
+  options.max_threads = max_threads;
+  return options;
+}
+
+}  // namespace
+
+TEST(WorkStealingExecutorTest, RunsAllTasks) {
+  const int kNumTasks = 1000;
+  std::atomic<int> count(0);
+  {
+    WorkStealingExecutor executor(MakeOptions(2, 4));
+    for (int i = 0; i != kNumTasks; ++i) {
+      const auto priority =
+          static_cast<WorkStealingExecutor::Priority>(
+              i % WorkStealingExecutor::kNumPriorities);
+      EXPECT_TRUE(executor.Submit([&count]() { ++count; }, priority, i % 7,
+                                  nullptr));
+    }
+    EXPECT_TRUE(WaitFor([&]() { return executor.num_pending() == 0; }));
+
+    const WorkStealingExecutor::Stats stats = executor.GetStats();
+    uint64_t num_executed = 0;
+    for (int p = 0; p != WorkStealingExecutor::kNumPriorities; ++p) {
+      num_executed += stats.num_executed[p];
+      EXPECT_EQ(0, stats.queue_depth[p]);
+      EXPECT_LE(stats.max_latency_us[p], stats.total_latency_us[p]);
+    }
+    EXPECT_EQ(kNumTasks, num_executed);
+    EXPECT_EQ(0, stats.num_cancelled);
+    EXPECT_EQ(0, stats.num_rejected);
+  }
+  EXPECT_EQ(kNumTasks, count);
+}
+
+// With a single thread busy, the queued tasks run by priority, and in
+// submission order within a priority.
+TEST(WorkStealingExecutorTest, HigherPriorityRunsFirst) {
+  WorkStealingExecutor executor(MakeOptions(1, 1));
+
+  Gate gate;
+  ASSERT_TRUE(executor.Submit([&gate]() { gate.Wait(); },
+                              WorkStealingExecutor::kPriorityForeground, 0,
+                              nullptr));
+
+  std::mutex lock;
+  std::string order;
+  auto append = [&lock, &order](char c) {
+    return [&lock, &order, c]() {
+      std::lock_guard<std::mutex> guard(lock);
+      order.push_back(c);
+    };
+  };
+  executor.Submit(append('i'), WorkStealingExecutor::kPriorityIdle, 0, nullptr);
+  executor.Submit(append('b'), WorkStealingExecutor::kPriorityBackground, 0,
+                  nullptr);
+  executor.Submit(append('F'), WorkStealingExecutor::kPriorityForeground, 0,
+                  nullptr);
+  executor.Submit(append('B'), WorkStealingExecutor::kPriorityBackground, 0,
+                  nullptr);
+  executor.Submit(append('f'), WorkStealingExecutor::kPriorityForeground, 0,
+                  nullptr);
+  executor.Submit(append('j'), WorkStealingExecutor::kPriorityIdle, 0, nullptr);
+
+  gate.Open();
+  EXPECT_TRUE(WaitFor([&]() { return executor.num_pending() == 0; }));
+  EXPECT_EQ("FfbBij", order);
+}
+
+// A thread blocked on a long task does not hold back the tasks queued with
+// its affinity: the other thread steals them.
+TEST(WorkStealingExecutorTest, IdleThreadsStealBlockedQueue) {
+  WorkStealingExecutor executor(MakeOptions(2, 2));
+  const uint64_t kBundle = 2;
+
+  Gate gate;
+  std::atomic<bool> is_blocked(false);
+  ASSERT_TRUE(executor.Submit([&]() { is_blocked = true; gate.Wait(); },
+                              WorkStealingExecutor::kPriorityForeground,
+                              kBundle, nullptr));
+  ASSERT_TRUE(WaitFor([&]() { return is_blocked.load(); }));
+
+  std::atomic<int> count(0);
+  for (int i = 0; i != 10; ++i) {
+    executor.Submit([&count]() { ++count; },
+                    WorkStealingExecutor::kPriorityBackground, kBundle,
+                    nullptr);
+  }
+  EXPECT_TRUE(WaitFor([&]() { return count == 10; }));
+  gate.Open();
+
+  EXPECT_TRUE(WaitFor([&]() { return executor.num_pending() == 0; }));
+  EXPECT_LE(1, executor.GetStats().num_stolen);
+}
+
+TEST(WorkStealingExecutorTest, GrowsUpToMaxThreads) {
+  const int kMaxThreads = 4;
+  WorkStealingExecutor executor(MakeOptions(1, kMaxThreads));
+  EXPECT_EQ(1, executor.GetStats().num_threads);
+
+  Gate gate;
+  std::atomic<int> num_started(0);
+  for (int i = 0; i != kMaxThreads + 2; ++i) {
+    executor.Submit([&]() { ++num_started; gate.Wait(); },
+                    WorkStealingExecutor::kPriorityForeground, 0, nullptr);
+  }
+  EXPECT_TRUE(WaitFor([&]() { return num_started == kMaxThreads; }));
+  EXPECT_EQ(kMaxThreads, executor.GetStats().num_threads);
+
+  gate.Open();
+  EXPECT_TRUE(WaitFor([&]() { return executor.num_pending() == 0; }));
+  EXPECT_EQ(kMaxThreads + 2, num_started);
+}
+
+TEST(WorkStealingExecutorTest, BoundedQueueRejects) {
+  WorkStealingExecutor::Options options(MakeOptions(1, 1));
+  options.max_queued_tasks = 2;
+  WorkStealingExecutor executor(options);
+
+  Gate gate;
+  std::atomic<bool> is_blocked(false);
+  ASSERT_TRUE(executor.Submit([&]() { is_blocked = true; gate.Wait(); },
+                              WorkStealingExecutor::kPriorityIdle, 0,
+                              nullptr));
+  ASSERT_TRUE(WaitFor([&]() { return is_blocked.load(); }));
+
+  auto noop = []() {};
+  EXPECT_TRUE(executor.Submit(noop, WorkStealingExecutor::kPriorityIdle, 0,
+                              nullptr));
+  EXPECT_TRUE(executor.Submit(noop, WorkStealingExecutor::kPriorityIdle, 0,
+                              nullptr));
+  EXPECT_FALSE(executor.Submit(noop, WorkStealingExecutor::kPriorityIdle, 0,
+                               nullptr));
+
+  // Each priority has its own bound.
+  EXPECT_TRUE(executor.Submit(noop, WorkStealingExecutor::kPriorityForeground,
+                              0, nullptr));
+
+  const WorkStealingExecutor::Stats stats = executor.GetStats();
+  EXPECT_EQ(1, stats.num_rejected);
+  EXPECT_EQ(2, stats.queue_depth[WorkStealingExecutor::kPriorityIdle]);
+  EXPECT_EQ(1, stats.queue_depth[WorkStealingExecutor::kPriorityForeground]);
+
+  gate.Open();
+  EXPECT_TRUE(WaitFor([&]() { return executor.num_pending() == 0; }));
+}
+
+TEST(WorkStealingExecutorTest, ShutdownCancelsQueuedTasks) {
+  WorkStealingExecutor executor(MakeOptions(1, 1));
+
+  Gate gate;
+  std::atomic<bool> is_blocked(false);
+  ASSERT_TRUE(executor.Submit([&]() { is_blocked = true; gate.Wait(); },
+                              WorkStealingExecutor::kPriorityForeground, 0,
+                              nullptr));
+  ASSERT_TRUE(WaitFor([&]() { return is_blocked.load(); }));
+
+  std::atomic<int> num_run(0);
+  std::atomic<int> num_cancelled(0);
+  for (int i = 0; i != 5; ++i) {
+    executor.Submit([&num_run]() { ++num_run; },
+                    WorkStealingExecutor::kPriorityBackground, 0,
+                    [&num_cancelled]() { ++num_cancelled; });
+  }
+
+  // The blocked task is still running when the timeout elapses.
+  EXPECT_FALSE(executor.Shutdown(std::chrono::milliseconds(10)));
+  EXPECT_TRUE(executor.is_shutting_down());
+  EXPECT_EQ(5, num_cancelled);
+  EXPECT_EQ(5, executor.GetStats().num_cancelled);
+  EXPECT_FALSE(executor.Submit([]() {},
+                               WorkStealingExecutor::kPriorityForeground, 0,
+                               nullptr));
+
+  gate.Open();
+  EXPECT_TRUE(executor.Shutdown(std::chrono::seconds(10)));
+  EXPECT_EQ(0, num_run);
+  EXPECT_EQ(0, executor.num_pending());
+}
+
+TEST(WorkStealingExecutorTest, DrainRunsQueuedTasks) {
+  WorkStealingExecutor executor(MakeOptions(1, 1));
+
+  Gate gate;
+  std::atomic<bool> is_blocked(false);
+  ASSERT_TRUE(executor.Submit([&]() { is_blocked = true; gate.Wait(); },
+                              WorkStealingExecutor::kPriorityForeground, 0,
+                              nullptr));
+  ASSERT_TRUE(WaitFor([&]() { return is_blocked.load(); }));
+
+  std::atomic<int> num_run(0);
+  std::atomic<int> num_cancelled(0);
+  for (int i = 0; i != 5; ++i) {
+    executor.Submit([&num_run]() { ++num_run; },
+                    WorkStealingExecutor::kPriorityBackground, 0,
+                    [&num_cancelled]() { ++num_cancelled; });
+  }
+
+  // The blocked task is still running when the timeout elapses. Draining
+  // does not stop the executor.
+  EXPECT_FALSE(executor.Drain(std::chrono::milliseconds(10)));
+  EXPECT_FALSE(executor.is_shutting_down());
+  EXPECT_EQ(6, executor.num_pending());
+
+  gate.Open();
+  EXPECT_TRUE(executor.Drain(std::chrono::seconds(10)));
+  EXPECT_EQ(5, num_run);
+  EXPECT_EQ(0, num_cancelled);
+  EXPECT_EQ(0, executor.num_pending());
+
+  EXPECT_TRUE(executor.Submit([&num_run]() { ++num_run; },
+                              WorkStealingExecutor::kPriorityForeground, 0,
+                              nullptr));
+  EXPECT_TRUE(executor.Drain(std::chrono::seconds(10)));
+  EXPECT_EQ(6, num_run);
+}
+
+TEST(WorkStealingExecutorTest, DrainFromTask) {
+  WorkStealingExecutor executor(MakeOptions(2, 2));
+
+  std::atomic<int> num_run(0);
+  std::atomic<bool> drain_result(false);
+  std::atomic<bool> is_done(false);
+  executor.Submit([&]() {
+                    for (int i = 0; i != 5; ++i) {
+                      executor.Submit([&num_run]() { ++num_run; },
+                                      WorkStealingExecutor::kPriorityIdle, 0,
+                                      nullptr);
+                    }
+                    drain_result = executor.Drain(std::chrono::seconds(10));
+                    is_done = true;
+                  },
+                  WorkStealingExecutor::kPriorityForeground, 0, nullptr);
+  EXPECT_TRUE(WaitFor([&]() { return is_done.load(); }));
+  EXPECT_TRUE(drain_result);
+  EXPECT_EQ(5, num_run);
+}
+
+TEST(WorkStealingExecutorTest, ShutdownFromTask) {
+  WorkStealingExecutor executor(MakeOptions(1, 2));
+
+  std::atomic<bool> shutdown_result(false);
+  std::atomic<bool> is_done(false);
+  executor.Submit([&]() {
+                    shutdown_result =
+                        executor.Shutdown(std::chrono::seconds(10));
+                    is_done = true;
+                  },
+                  WorkStealingExecutor::kPriorityForeground, 0, nullptr);
+  EXPECT_TRUE(WaitFor([&]() { return is_done.load(); }));
+  EXPECT_TRUE(shutdown_result);
+}
+
+// Measures how long tasks wait in the queue while the pool is saturated with
+// background work. Foreground tasks overtake the queued background tasks.
+TEST(WorkStealingExecutorTest, SchedulingLatencyBenchmark) {
+  const int kNumThreads = 4;
+  const int kNumBackgroundTasks = 2000;
+  const int kNumForegroundTasks = 100;
+
+  WorkStealingExecutor executor(MakeOptions(kNumThreads, kNumThreads));
+  auto spin = []() {
+    const auto end =
+        std::chrono::steady_clock::now() + std::chrono::microseconds(50);
+    while (std::chrono::steady_clock::now() < end) {
+    }
+  };
+
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i != kNumBackgroundTasks; ++i) {
+    executor.Submit(spin, WorkStealingExecutor::kPriorityBackground, i % 13,
+                    nullptr);
+  }
+  for (int i = 0; i != kNumForegroundTasks; ++i) {
+    executor.Submit(spin, WorkStealingExecutor::kPriorityForeground, i % 13,
+                    nullptr);
+  }
+  EXPECT_TRUE(WaitFor([&]() { return executor.num_pending() == 0; }));
+  const auto elapsed_ms = std::chrono::duration_cast<
+      std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+  const WorkStealingExecutor::Stats stats = executor.GetStats();
+  const int fg = WorkStealingExecutor::kPriorityForeground;
+  const int bg = WorkStealingExecutor::kPriorityBackground;
+  ASSERT_EQ(kNumForegroundTasks, stats.num_executed[fg]);
+  ASSERT_EQ(kNumBackgroundTasks, stats.num_executed[bg]);
+
+  const uint64_t fg_avg_us = stats.total_latency_us[fg] / kNumForegroundTasks;
+  const uint64_t bg_avg_us = stats.total_latency_us[bg] / kNumBackgroundTasks;
+  std::cout << "Ran " << kNumBackgroundTasks + kNumForegroundTasks
+            << " tasks in " << elapsed_ms.count() << " ms on "
+            << stats.num_threads << " threads." << std::endl
+            << "Foreground latency: avg " << fg_avg_us << " us, max "
+            << stats.max_latency_us[fg] << " us." << std::endl
+            << "Background latency: avg " << bg_avg_us << " us, max "
+            << stats.max_latency_us[bg] << " us." << std::endl
+            << "Stolen: " << stats.num_stolen << std::endl;
+
+  EXPECT_LT(fg_avg_us, bg_avg_us);
+}
+
+}  // namespace omaha
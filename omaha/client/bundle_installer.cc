@@ -24,6 +24,7 @@
 #include "omaha/client/help_url_builder.h"
 #include "omaha/client/resource.h"
 #include "omaha/client/shutdown_events.h"
+#include "omaha/client/state_change_events.h"
 #include "omaha/common/const_goopdate.h"
 #include "omaha/common/goopdate_utils.h"
 #include "omaha/common/update3_utils.h"
@@ -439,6 +440,8 @@ BundleInstaller::BundleInstaller(HelpUrlBuilder* help_url_builder,
       result_(E_UNEXPECTED),
       is_canceled_(false),
       is_handling_message_(false),
+      is_app_installing_(false),
+      is_progress_timer_set_(false),
       is_update_all_apps_(is_update_all_apps),
       is_update_check_only_(is_update_check_only),
       is_browser_type_supported_(is_browser_type_supported) {
@@ -459,43 +462,93 @@ LRESULT BundleInstaller::OnTimer(UINT msg,
   is_handling_message_ = true;
 
   VERIFY1(msg == WM_TIMER);
-  VERIFY1(wparam == kPollingTimerId);
+  VERIFY1(wparam == kProgressTimerId);
 
-  if (!PollServer()) {
-    CORE_LOG(L6, (_T("[BundleInstaller::OnTimer][Stopping polling timer]")));
+  PollServer();
+  UpdateProgressTimer();
 
-    // Ignore return value. KillTimer does not remove WM_TIMER messages already
-    // posted to the message queue.
-    KillTimer(kPollingTimerId);
+  is_handling_message_ = false;
+  handled = true;
+  return 0;
+}
+
+LRESULT BundleInstaller::OnStateChange(UINT msg,
+                                       WPARAM,
+                                       LPARAM,
+                                       BOOL& handled) {  // NOLINT
+  VERIFY1(msg == kStateChangeMessage);
+
+  if (is_handling_message_) {
+    ASSERT(false, (_T("[Reentrancy detected]")));
+
+    // The progress timer reads the states once the current message is
+    // handled, so that the change is not lost.
+    if (state_change_events_.get()) {
+      state_change_events_->OnStateChangeMessage();
+    }
+    if (SetTimer(kProgressTimerId, kProgressTimerPeriodMs)) {
+      is_progress_timer_set_ = true;
+    }
+    return 0;
+  }
+  is_handling_message_ = true;
+
+  // The changes signaled while the states are read post another message.
+  if (state_change_events_.get()) {
+    state_change_events_->OnStateChangeMessage();
   }
 
+  PollServer();
+  UpdateProgressTimer();
+
   is_handling_message_ = false;
   handled = true;
   return 0;
 }
 
+void BundleInstaller::UpdateProgressTimer() {
+  const bool is_timer_needed = state_ != kComplete &&
+      (!state_change_events_.get() || is_app_installing_);
+  if (is_timer_needed == is_progress_timer_set_) {
+    return;
+  }
+
+  if (is_timer_needed) {
+    CORE_LOG(L6, (_T("[BundleInstaller][Starting progress timer]")));
+    if (!SetTimer(kProgressTimerId, kProgressTimerPeriodMs)) {
+      CORE_LOG(LE, (_T("[SetTimer failed][%d]"), ::GetLastError()));
+      return;
+    }
+  } else {
+    CORE_LOG(L6, (_T("[BundleInstaller][Stopping progress timer]")));
+
+    // Ignore return value. KillTimer does not remove WM_TIMER messages already
+    // posted to the message queue.
+    KillTimer(kProgressTimerId);
+  }
+  is_progress_timer_set_ = is_timer_needed;
+}
+
 HRESULT BundleInstaller::Initialize() {
   CORE_LOG(L3, (_T("[BundleInstaller::Initialize]")));
 
-  // Create a message-only window for the timer. It is not visible,
-  // has no z-order, cannot be enumerated, and does not receive broadcast
-  // messages. The window simply dispatches messages.
+  // Create a message-only window for the state change messages and the
+  // timer. It is not visible, has no z-order, cannot be enumerated, and does
+  // not receive broadcast messages. The window simply dispatches messages.
   const TCHAR kWndName[] = _T("{139455DE-14E2-4d54-93B5-9E6ADDC04B4E}");
   if (!Create(HWND_MESSAGE, NULL, kWndName)) {
     return HRESULTFromLastError();
   }
 
-  if (!SetTimer(kPollingTimerId, kPollingTimerPeriodMs)) {
-    return HRESULTFromLastError();
-  }
-
   return S_OK;
 }
 
 void BundleInstaller::Uninitialize() {
+  state_change_events_.reset();
+
   if (IsWindow()) {
     // This may fail if it was already killed when the bundle completed.
-    KillTimer(kPollingTimerId);
+    KillTimer(kProgressTimerId);
 
     DestroyWindow();
   }
@@ -537,11 +590,30 @@ HRESULT BundleInstaller::InstallBundle(bool is_machine,
     ListenToShutdownEvent(is_machine);
   }
 
+  // The server signals the state changes of the bundle with the event named
+  // by its session ID. The installer polls if it cannot wait on the event.
+  CComBSTR session_id;
+  VERIFY_SUCCEEDED(app_bundle_->get_sessionId(&session_id));
+  auto state_change_events = std::make_unique<StateChangeEvents>(this);
+  HRESULT hr = state_change_events->Initialize(is_machine,
+                                               CString(session_id));
+  if (SUCCEEDED(hr)) {
+    state_change_events_.reset(state_change_events.release());
+  } else {
+    CORE_LOG(LW, (_T("[StateChangeEvents::Initialize failed][0x%08x]"), hr));
+  }
+
+  // Reads the initial states, which starts processing the bundle.
+  VERIFY1(PostMessage(kStateChangeMessage, 0, 0));
+  UpdateProgressTimer();
+
   _pAtlModule->Lock();
 
   message_loop_.Run();
   CORE_LOG(L2, (_T("[message_loop_.Run() returned]")));
 
+  state_change_events_.reset();
+
   if (listen_to_shutdown_event) {
     StopListenToShutdownEvent(is_machine);
   }
@@ -652,8 +724,8 @@ HRESULT BundleInstaller::result() {
 
 // Polls the server for the state of the job and updates the UI.
 // Not thread safe. There should only be one installation per process. Do we
-// need to worry about multiple WM_TIMER events at the same time or does the
-// message loop ensure this doesn't happen?
+// need to worry about multiple WM_TIMER or state change messages at the same
+// time or does the message loop ensure this doesn't happen?
 HRESULT BundleInstaller::DoPollServer() {
   CORE_LOG(L6, (_T("[BundleInstaller::DoPollServer][%u]"), state_));
 
@@ -772,6 +844,8 @@ HRESULT BundleInstaller::HandleProcessingState() {
   ASSERT1(observer_);
   ASSERT1(!apps_.empty());
 
+  is_app_installing_ = false;
+
   for (size_t i = 0; i < apps_.size(); ++i) {
     CurrentState current_state = STATE_INIT;
     CComPtr<ICurrentState> icurrent_state;
@@ -814,6 +888,7 @@ HRESULT BundleInstaller::HandleProcessingState() {
       case STATE_WAITING_TO_INSTALL:
         return NotifyWaitingToInstall(app);
       case STATE_INSTALLING:
+        is_app_installing_ = true;
         return NotifyInstallProgress(app, icurrent_state);
       case STATE_PAUSED:
         ASSERT(false, (_T("Unsupported")));
@@ -62,6 +62,7 @@ CString GetBundleCompletionMessage(
 
 class HelpUrlBuilder;
 class ShutdownCallback;
+class StateChangeEvents;
 
 class BundleInstaller
     : public CWindowImpl<BundleInstaller,
@@ -75,6 +76,10 @@ class BundleInstaller
                   bool is_browser_type_supported);
   ~BundleInstaller();
 
+  // Posted by StateChangeEvents when the server signals that the state of the
+  // apps in the bundle changed.
+  static const UINT kStateChangeMessage = WM_APP;
+
   HRESULT Initialize();
   void Uninitialize();
 
@@ -155,6 +160,10 @@ class BundleInstaller
   // Performs all subsequent calls to PollServer() until the state is complete.
   HRESULT HandleProcessingState();
 
+  // Sets the progress timer if the installer must poll for the progress which
+  // the server does not signal, and kills it otherwise.
+  void UpdateProgressTimer();
+
   // Makes installer listen to the shutdown event.
   HRESULT ListenToShutdownEvent(bool is_machine);
 
@@ -189,10 +198,15 @@ class BundleInstaller
   BEGIN_MSG_MAP(BundleInstaller)
     MESSAGE_HANDLER(WM_CLOSE, OnClose)
     MESSAGE_HANDLER(WM_TIMER, OnTimer)
+    MESSAGE_HANDLER(kStateChangeMessage, OnStateChange)
   END_MSG_MAP()
 
-  static const int kPollingTimerId = 1;
-  static const int kPollingTimerPeriodMs = 100;
+  // The installer reads the states of the apps when the server signals that
+  // they changed. It polls while an app installs, since installers report
+  // their progress only in the registry, and all along if it cannot wait on
+  // the signal of the server.
+  static const int kProgressTimerId = 1;
+  static const int kProgressTimerPeriodMs = 100;
 
   // The main use case for this OnClose() handler is the shutdown handler via a
   // PostMessage in the /UA scenario.
@@ -207,6 +221,12 @@ class BundleInstaller
                   LPARAM lparam,
                   BOOL& handled);  // NOLINT
 
+  // Calls BundleInstaller::PollServer() when the states of the apps changed.
+  LRESULT OnStateChange(UINT msg,
+                        WPARAM wparam,
+                        LPARAM lparam,
+                        BOOL& handled);  // NOLINT
+
   void ReleaseAppBundle();
 
   InstallProgressObserver* observer_;
@@ -224,6 +244,10 @@ class BundleInstaller
   // Shutdown event listener.
   std::unique_ptr<ShutdownCallback> shutdown_callback_;
 
+  // Listens to the state changes which the server signals. NULL if the
+  // installer polls instead.
+  std::unique_ptr<StateChangeEvents> state_change_events_;
+
   // The apps in app_bundle_. Allows easier and quicker access to the apps than
   // going through app_bundle_.
   typedef CComPtr<IApp> ComPtrIApp;
@@ -234,6 +258,8 @@ class BundleInstaller
   HRESULT result_;
   bool is_canceled_;
   bool is_handling_message_;
+  bool is_app_installing_;
+  bool is_progress_timer_set_;
 
   const bool is_update_all_apps_;
   const bool is_update_check_only_;  // Only used by legacy OnDemand.
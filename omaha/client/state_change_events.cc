@@ -0,0 +1,92 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/client/state_change_events.h"
+
+#include "omaha/base/const_object_names.h"
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/logging.h"
+#include "omaha/base/reactor.h"
+#include "omaha/base/utils.h"
+#include "omaha/client/bundle_installer.h"
+
+namespace omaha {
+
+StateChangeEvents::StateChangeEvents(BundleInstaller* installer)
+    : installer_(installer),
+      is_message_posted_(0) {
+  ASSERT1(installer);
+}
+
+// Unregistering the handle waits for the callback in progress, if any, so
+// HandleEvent() does not use the installer after this returns.
+StateChangeEvents::~StateChangeEvents() {
+  CORE_LOG(L2, (_T("[StateChangeEvents::~StateChangeEvents]")));
+  if (reactor_.get() && get(event_)) {
+    VERIFY_SUCCEEDED(reactor_->UnregisterHandle(get(event_)));
+  }
+}
+
+HRESULT StateChangeEvents::Initialize(bool is_machine,
+                                      const CString& session_id) {
+  CORE_LOG(L3, (_T("[StateChangeEvents::Initialize][%s]"), session_id));
+  ASSERT1(!reactor_.get());
+
+  if (session_id.IsEmpty()) {
+    return E_INVALIDARG;
+  }
+
+  CString event_name(kBundleStateChangeEventPrefix);
+  event_name += session_id;
+
+  NamedObjectAttributes attr;
+  GetNamedObjectAttributes(event_name, is_machine, &attr);
+  reset(event_, ::OpenEvent(SYNCHRONIZE, false, attr.name));
+  if (!event_) {
+    const HRESULT hr = HRESULTFromLastError();
+    CORE_LOG(LW, (_T("[OpenEvent failed][0x%08x][%s]"), hr, attr.name));
+    return hr;
+  }
+
+  reactor_.reset(new Reactor);
+  HRESULT hr = reactor_->RegisterHandle(get(event_), this, 0);
+  if (FAILED(hr)) {
+    reactor_.reset();
+    return hr;
+  }
+
+  return S_OK;
+}
+
+// HandleEvent() is called from a thread in the OS threadpool. The PostMessage
+// marshals the call over to the UI thread, which reads the states.
+void StateChangeEvents::HandleEvent(HANDLE handle) {
+  ASSERT1(handle == get(event_));
+  UNREFERENCED_PARAMETER(handle);
+
+  if (!::InterlockedExchange(&is_message_posted_, 1) &&
+      installer_->IsWindow()) {
+    installer_->PostMessage(BundleInstaller::kStateChangeMessage, 0, 0);
+  }
+
+  VERIFY_SUCCEEDED(reactor_->RegisterHandle(get(event_)));
+}
+
+void StateChangeEvents::OnStateChangeMessage() {
+  ::InterlockedExchange(&is_message_posted_, 0);
+}
+
+}  // namespace omaha
@@ -0,0 +1,65 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// StateChangeEvents wakes up the BundleInstaller when the COM server signals
+// that the state of the apps in the bundle changed, so that the installer
+// reads the states after they change instead of at a fixed rate.
+
+#ifndef OMAHA_CLIENT_STATE_CHANGE_EVENTS_H_
+#define OMAHA_CLIENT_STATE_CHANGE_EVENTS_H_
+
+#include <windows.h>
+#include <atlstr.h>
+#include <memory>
+
+#include "base/basictypes.h"
+#include "omaha/base/event_handler.h"
+#include "omaha/third_party/smartany/scoped_any.h"
+
+namespace omaha {
+
+class BundleInstaller;
+class Reactor;
+
+class StateChangeEvents : public EventHandler {
+ public:
+  explicit StateChangeEvents(BundleInstaller* installer);
+  virtual ~StateChangeEvents();
+
+  // Opens the event which the server created for the bundle of |session_id|.
+  // Fails if the server does not signal the state changes, such as an older
+  // server, or if the caller may not wait on the event.
+  HRESULT Initialize(bool is_machine, const CString& session_id);
+
+  // Posts BundleInstaller::kStateChangeMessage to the installer, unless the
+  // previous message is not handled yet.
+  virtual void HandleEvent(HANDLE handle);
+
+  // Called by the installer before it reads the states, so that the changes
+  // signaled from then on post another message.
+  void OnStateChangeMessage();
+
+ private:
+  BundleInstaller* installer_;
+  std::unique_ptr<Reactor> reactor_;
+  scoped_event event_;
+  volatile LONG is_message_posted_;
+
+  DISALLOW_IMPLICIT_CONSTRUCTORS(StateChangeEvents);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_CLIENT_STATE_CHANGE_EVENTS_H_
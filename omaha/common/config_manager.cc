@@ -359,6 +359,57 @@ HRESULT OmahaPolicyManager::GetPackageCacheExpirationTimeDays(
   return S_OK;
 }
 
+HRESULT OmahaPolicyManager::GetDownloadRateLimitKBytesPerSec(
+    bool is_background,
+    DWORD* rate_limit) {
+  const int64_t policy_rate_limit = is_background ?
+      policy_.background_download_rate_limit : policy_.download_rate_limit;
+  if (!policy_.is_initialized || policy_rate_limit == -1) {
+    return E_FAIL;
+  }
+
+  *rate_limit = static_cast<DWORD>(policy_rate_limit);
+  return S_OK;
+}
+
+HRESULT OmahaPolicyManager::GetPeerCacheUrls(CString* peer_cache_urls) {
+  if (!policy_.is_initialized || policy_.peer_cache_urls.IsEmpty()) {
+    return E_FAIL;
+  }
+
+  *peer_cache_urls = policy_.peer_cache_urls;
+  return S_OK;
+}
+
+HRESULT OmahaPolicyManager::GetPeerCacheServerPort(DWORD* port) {
+  if (!policy_.is_initialized || policy_.peer_cache_server_port == -1) {
+    return E_FAIL;
+  }
+
+  *port = static_cast<DWORD>(policy_.peer_cache_server_port);
+  return S_OK;
+}
+
+HRESULT OmahaPolicyManager::GetMaxConcurrentInstalls(
+    DWORD* max_concurrent_installs) {
+  if (!policy_.is_initialized || policy_.max_concurrent_installs == -1) {
+    return E_FAIL;
+  }
+
+  *max_concurrent_installs =
+      static_cast<DWORD>(policy_.max_concurrent_installs);
+  return S_OK;
+}
+
+HRESULT OmahaPolicyManager::GetUpdateCheckShardSize(DWORD* shard_size) {
+  if (!policy_.is_initialized || policy_.update_check_shard_size == -1) {
+    return E_FAIL;
+  }
+
+  *shard_size = static_cast<DWORD>(policy_.update_check_shard_size);
+  return S_OK;
+}
+
 HRESULT OmahaPolicyManager::GetProxyMode(CString* proxy_mode) {
   if (!policy_.is_initialized || policy_.proxy_mode.IsEmpty()) {
     return E_FAIL;
@@ -664,6 +715,18 @@ CString ConfigManager::GetTempDownloadDir() const {
 
 int ConfigManager::GetPackageCacheSizeLimitMBytes(
     IPolicyStatusValue** policy_status_value) const {
+  if (!policy_status_value) {
+    const auto snapshot = effective_policy();
+    if (snapshot) {
+      return snapshot->package_cache_size_limit_mbytes;
+    }
+  }
+
+  return MergePackageCacheSizeLimitMBytes(policy_status_value);
+}
+
+int ConfigManager::MergePackageCacheSizeLimitMBytes(
+    IPolicyStatusValue** policy_status_value) const {
   DWORD kDefaultCacheStorageLimit = 500;  // 500 MB
   DWORD kMaxCacheStorageLimit = 5000;     // 5 GB
 
@@ -692,6 +755,18 @@ int ConfigManager::GetPackageCacheSizeLimitMBytes(
 
 int ConfigManager::GetPackageCacheExpirationTimeDays(
     IPolicyStatusValue** policy_status_value) const {
+  if (!policy_status_value) {
+    const auto snapshot = effective_policy();
+    if (snapshot) {
+      return snapshot->package_cache_expiration_time_days;
+    }
+  }
+
+  return MergePackageCacheExpirationTimeDays(policy_status_value);
+}
+
+int ConfigManager::MergePackageCacheExpirationTimeDays(
+    IPolicyStatusValue** policy_status_value) const {
   DWORD kDefaultCacheLifeTimeInDays = 180;  // 180 days.
   DWORD kMaxCacheLifeTimeInDays = 1800;     // Roughly 5 years.
 
@@ -718,11 +793,224 @@ int ConfigManager::GetPackageCacheExpirationTimeDays(
   return v.value();
 }
 
+int ConfigManager::GetDownloadRateLimitKBytesPerSec(
+    bool is_background,
+    IPolicyStatusValue** policy_status_value) const {
+  if (!policy_status_value) {
+    const auto snapshot = effective_policy();
+    if (snapshot) {
+      return snapshot->download_rate_limit_kbytes_per_sec[is_background];
+    }
+  }
+
+  return MergeDownloadRateLimitKBytesPerSec(is_background, policy_status_value);
+}
+
+int ConfigManager::MergeDownloadRateLimitKBytesPerSec(
+    bool is_background,
+    IPolicyStatusValue** policy_status_value) const {
+  DWORD kDefaultRateLimit = 0;            // No limit.
+  DWORD kMaxRateLimit = 10 * 1024 * 1024;  // 10 GB per second.
+
+  PolicyValue<DWORD> v;
+
+  for (size_t i = 0; i != policies_.size(); ++i) {
+    DWORD rate_limit = 0;
+    HRESULT hr = policies_[i]->GetDownloadRateLimitKBytesPerSec(is_background,
+                                                                &rate_limit);
+
+    if (SUCCEEDED(hr)) {
+      if (rate_limit <= kMaxRateLimit) {
+        v.Update(policies_[i]->IsManaged(),
+                 policies_[i]->source(),
+                 rate_limit);
+      }
+    }
+  }
+
+  v.UpdateFinal(kDefaultRateLimit, policy_status_value);
+
+  OPT_LOG(L5, (_T("[GetDownloadRateLimitKBytesPerSec][%d][%s]"),
+               is_background, v.ToString()));
+
+  return v.value();
+}
+
+std::vector<CString> ConfigManager::GetPeerCacheUrls(
+    IPolicyStatusValue** policy_status_value) const {
+  if (!policy_status_value) {
+    const auto snapshot = effective_policy();
+    if (snapshot) {
+      return snapshot->peer_cache_urls;
+    }
+  }
+
+  return MergePeerCacheUrls(policy_status_value);
+}
+
+std::vector<CString> ConfigManager::MergePeerCacheUrls(
+    IPolicyStatusValue** policy_status_value) const {
+  PolicyValue<CString> v;
+
+  for (size_t i = 0; i != policies_.size(); ++i) {
+    CString peer_cache_urls;
+    HRESULT hr = policies_[i]->GetPeerCacheUrls(&peer_cache_urls);
+    if (SUCCEEDED(hr)) {
+      v.Update(policies_[i]->IsManaged(),
+               policies_[i]->source(),
+               peer_cache_urls);
+    }
+  }
+
+  v.UpdateFinal(CString(), policy_status_value);
+
+  OPT_LOG(L5, (_T("[GetPeerCacheUrls][%s]"), v.ToString()));
+
+  // Only plain http urls are accepted: the peers serve the packages over
+  // http, and the packages are verified against their expected hash.
+  std::vector<CString> urls;
+  const CString peer_cache_urls(v.value());
+  int pos = 0;
+  for (CString url = peer_cache_urls.Tokenize(_T(";"), pos);
+       !url.IsEmpty();
+       url = peer_cache_urls.Tokenize(_T(";"), pos)) {
+    url.Trim();
+    if (String_StartsWith(url, kHttpProto, true)) {
+      urls.push_back(url);
+    }
+  }
+  return urls;
+}
+
+int ConfigManager::GetPeerCacheServerPort(
+    IPolicyStatusValue** policy_status_value) const {
+  if (!policy_status_value) {
+    const auto snapshot = effective_policy();
+    if (snapshot) {
+      return snapshot->peer_cache_server_port;
+    }
+  }
+
+  return MergePeerCacheServerPort(policy_status_value);
+}
+
+int ConfigManager::MergePeerCacheServerPort(
+    IPolicyStatusValue** policy_status_value) const {
+  const DWORD kMaxPort = 65535;
+
+  PolicyValue<DWORD> v;
+
+  for (size_t i = 0; i != policies_.size(); ++i) {
+    DWORD port = 0;
+    HRESULT hr = policies_[i]->GetPeerCacheServerPort(&port);
+    if (SUCCEEDED(hr) && port <= kMaxPort) {
+      v.Update(policies_[i]->IsManaged(), policies_[i]->source(), port);
+    }
+  }
+
+  v.UpdateFinal(0, policy_status_value);
+
+  OPT_LOG(L5, (_T("[GetPeerCacheServerPort][%s]"), v.ToString()));
+
+  return v.value();
+}
+
+int ConfigManager::GetMaxConcurrentInstalls(
+    IPolicyStatusValue** policy_status_value) const {
+  if (!policy_status_value) {
+    const auto snapshot = effective_policy();
+    if (snapshot) {
+      return snapshot->max_concurrent_installs;
+    }
+  }
+
+  return MergeMaxConcurrentInstalls(policy_status_value);
+}
+
+int ConfigManager::MergeMaxConcurrentInstalls(
+    IPolicyStatusValue** policy_status_value) const {
+  // Installers run one at a time unless the policy allows more: an EXE
+  // installer may run msiexec, which fails if another MSI install is running.
+  const DWORD kDefaultMaxConcurrentInstalls = 1;
+  const DWORD kMaxMaxConcurrentInstalls = 16;
+
+  PolicyValue<DWORD> v;
+
+  for (size_t i = 0; i != policies_.size(); ++i) {
+    DWORD max_concurrent_installs = 0;
+    HRESULT hr = policies_[i]->GetMaxConcurrentInstalls(
+        &max_concurrent_installs);
+    if (SUCCEEDED(hr) &&
+        max_concurrent_installs >= 1 &&
+        max_concurrent_installs <= kMaxMaxConcurrentInstalls) {
+      v.Update(policies_[i]->IsManaged(),
+               policies_[i]->source(),
+               max_concurrent_installs);
+    }
+  }
+
+  v.UpdateFinal(kDefaultMaxConcurrentInstalls, policy_status_value);
+
+  OPT_LOG(L5, (_T("[GetMaxConcurrentInstalls][%s]"), v.ToString()));
+
+  return v.value();
+}
+
+int ConfigManager::GetUpdateCheckShardSize(
+    IPolicyStatusValue** policy_status_value) const {
+  if (!policy_status_value) {
+    const auto snapshot = effective_policy();
+    if (snapshot) {
+      return snapshot->update_check_shard_size;
+    }
+  }
+
+  return MergeUpdateCheckShardSize(policy_status_value);
+}
+
+int ConfigManager::MergeUpdateCheckShardSize(
+    IPolicyStatusValue** policy_status_value) const {
+  const DWORD kDefaultUpdateCheckShardSize = 0;
+  const DWORD kMaxUpdateCheckShardSize = 10000;
+
+  PolicyValue<DWORD> v;
+
+  for (size_t i = 0; i != policies_.size(); ++i) {
+    DWORD shard_size = 0;
+    HRESULT hr = policies_[i]->GetUpdateCheckShardSize(&shard_size);
+    if (SUCCEEDED(hr) && shard_size <= kMaxUpdateCheckShardSize) {
+      v.Update(policies_[i]->IsManaged(), policies_[i]->source(), shard_size);
+    }
+  }
+
+  v.UpdateFinal(kDefaultUpdateCheckShardSize, policy_status_value);
+
+  OPT_LOG(L5, (_T("[GetUpdateCheckShardSize][%s]"), v.ToString()));
+
+  return v.value();
+}
+
 HRESULT ConfigManager::GetProxyMode(
     CString* proxy_mode,
     IPolicyStatusValue** policy_status_value) const {
   ASSERT1(proxy_mode);
 
+  if (!policy_status_value) {
+    const auto snapshot = effective_policy();
+    if (snapshot) {
+      if (SUCCEEDED(snapshot->proxy_mode_hr)) {
+        *proxy_mode = snapshot->proxy_mode;
+      }
+      return snapshot->proxy_mode_hr;
+    }
+  }
+
+  return MergeProxyMode(proxy_mode, policy_status_value);
+}
+
+HRESULT ConfigManager::MergeProxyMode(
+    CString* proxy_mode,
+    IPolicyStatusValue** policy_status_value) const {
   PolicyValue<CString> v;
 
   for (size_t i = 0; i != policies_.size(); ++i) {
@@ -752,6 +1040,22 @@ HRESULT ConfigManager::GetProxyPacUrl(
     IPolicyStatusValue** policy_status_value) const {
   ASSERT1(proxy_pac_url);
 
+  if (!policy_status_value) {
+    const auto snapshot = effective_policy();
+    if (snapshot) {
+      if (SUCCEEDED(snapshot->proxy_pac_url_hr)) {
+        *proxy_pac_url = snapshot->proxy_pac_url;
+      }
+      return snapshot->proxy_pac_url_hr;
+    }
+  }
+
+  return MergeProxyPacUrl(proxy_pac_url, policy_status_value);
+}
+
+HRESULT ConfigManager::MergeProxyPacUrl(
+    CString* proxy_pac_url,
+    IPolicyStatusValue** policy_status_value) const {
   PolicyValue<CString> v;
 
   for (size_t i = 0; i != policies_.size(); ++i) {
@@ -781,6 +1085,22 @@ HRESULT ConfigManager::GetProxyServer(
     IPolicyStatusValue** policy_status_value) const {
   ASSERT1(proxy_server);
 
+  if (!policy_status_value) {
+    const auto snapshot = effective_policy();
+    if (snapshot) {
+      if (SUCCEEDED(snapshot->proxy_server_hr)) {
+        *proxy_server = snapshot->proxy_server;
+      }
+      return snapshot->proxy_server_hr;
+    }
+  }
+
+  return MergeProxyServer(proxy_server, policy_status_value);
+}
+
+HRESULT ConfigManager::MergeProxyServer(
+    CString* proxy_server,
+    IPolicyStatusValue** policy_status_value) const {
   PolicyValue<CString> v;
 
   for (size_t i = 0; i != policies_.size(); ++i) {
@@ -811,6 +1131,23 @@ HRESULT ConfigManager::GetForceInstallApps(
     IPolicyStatusValue** policy_status_value) const {
   ASSERT1(app_ids);
 
+  if (!policy_status_value) {
+    const auto snapshot = effective_policy();
+    if (snapshot) {
+      if (SUCCEEDED(snapshot->force_install_apps_hr[is_machine])) {
+        *app_ids = snapshot->force_install_apps[is_machine];
+      }
+      return snapshot->force_install_apps_hr[is_machine];
+    }
+  }
+
+  return MergeForceInstallApps(is_machine, app_ids, policy_status_value);
+}
+
+HRESULT ConfigManager::MergeForceInstallApps(
+    bool is_machine,
+    std::vector<CString>* app_ids,
+    IPolicyStatusValue** policy_status_value) const {
   PolicyValue<std::vector<CString>> v;
 
   for (size_t i = 0; i != policies_.size(); ++i) {
@@ -956,6 +1293,9 @@ CPath ConfigManager::GetPolicyResponsesDir() const {
 #endif  // defined(HAS_DEVICE_MANAGEMENT)
 
 HRESULT ConfigManager::LoadPolicies(bool should_acquire_critical_section) {
+  __mutexScope(policy_lock_);
+  ON_SCOPE_EXIT_OBJ(*this, &ConfigManager::UpdateEffectivePolicy);
+
   HRESULT hr = LoadGroupPolicies(should_acquire_critical_section);
   if (FAILED(hr)) {
     return hr;
@@ -1043,6 +1383,17 @@ HRESULT ConfigManager::LoadGroupPolicies(bool should_acquire_critical_section) {
   GetPolicyDword(kRegValueCacheSizeLimitMBytes,
                  &group_policies.cache_size_limit);
   GetPolicyDword(kRegValueCacheLifeLimitDays, &group_policies.cache_life_limit);
+  GetPolicyDword(kRegValueDownloadRateLimitKBytes,
+                 &group_policies.download_rate_limit);
+  GetPolicyDword(kRegValueBackgroundDownloadRateLimitKBytes,
+                 &group_policies.background_download_rate_limit);
+  GetPolicyString(kRegValuePeerCacheUrls, &group_policies.peer_cache_urls);
+  GetPolicyDword(kRegValuePeerCacheServerPort,
+                 &group_policies.peer_cache_server_port);
+  GetPolicyDword(kRegValueMaxConcurrentInstalls,
+                 &group_policies.max_concurrent_installs);
+  GetPolicyDword(kRegValueUpdateCheckShardSize,
+                 &group_policies.update_check_shard_size);
 
   GetPolicyDword(kRegValueUpdatesSuppressedStartHour,
                  &group_policies.updates_suppressed.start_hour);
@@ -1137,11 +1488,84 @@ HRESULT ConfigManager::LoadGroupPolicies(bool should_acquire_critical_section) {
 }
 
 void ConfigManager::SetOmahaDMPolicies(const CachedOmahaPolicy& dm_policy) {
+  __mutexScope(policy_lock_);
   dm_policy_manager_->set_policy(dm_policy);
+  UpdateEffectivePolicy();
   REPORT_LOG(L1, (_T("[ConfigManager::SetOmahaDMPolicies][%s]"),
                   dm_policy.ToString()));
 }
 
+void ConfigManager::UpdateEffectivePolicy() {
+  // Serializes the rebuilds, so that a rebuild started with older policies
+  // can't publish its snapshot after a rebuild started with newer ones. The
+  // snapshot is built with the Merge* functions, which never read the
+  // published snapshot, and readers keep using the previous snapshot until
+  // the new one replaces it.
+  __mutexScope(policy_lock_);
+
+  auto policy = std::make_shared<EffectivePolicy>();
+
+  policy->package_cache_size_limit_mbytes =
+      MergePackageCacheSizeLimitMBytes(NULL);
+  policy->package_cache_expiration_time_days =
+      MergePackageCacheExpirationTimeDays(NULL);
+  for (int is_background = 0; is_background != 2; ++is_background) {
+    policy->download_rate_limit_kbytes_per_sec[is_background] =
+        MergeDownloadRateLimitKBytesPerSec(!!is_background, NULL);
+  }
+  policy->peer_cache_urls = MergePeerCacheUrls(NULL);
+  policy->peer_cache_server_port = MergePeerCacheServerPort(NULL);
+  policy->max_concurrent_installs = MergeMaxConcurrentInstalls(NULL);
+  policy->update_check_shard_size = MergeUpdateCheckShardSize(NULL);
+
+  policy->proxy_mode_hr = MergeProxyMode(&policy->proxy_mode, NULL);
+  policy->proxy_pac_url_hr = MergeProxyPacUrl(&policy->proxy_pac_url, NULL);
+  policy->proxy_server_hr = MergeProxyServer(&policy->proxy_server, NULL);
+
+  for (int is_machine = 0; is_machine != 2; ++is_machine) {
+    policy->force_install_apps_hr[is_machine] =
+        MergeForceInstallApps(!!is_machine,
+                              &policy->force_install_apps[is_machine],
+                              NULL);
+  }
+
+  policy->download_preference = MergeDownloadPreferenceGroupPolicy(NULL);
+
+  auto merge_app_policy = [this](const GUID& app_guid) {
+    EffectivePolicy::AppPolicy app_policy;
+    app_policy.install_policy =
+        MergeEffectivePolicyForAppInstalls(app_guid, NULL);
+    app_policy.update_policy =
+        MergeEffectivePolicyForAppUpdates(app_guid, NULL);
+    app_policy.target_channel = MergeTargetChannel(app_guid, NULL);
+    app_policy.target_version_prefix = MergeTargetVersionPrefix(app_guid, NULL);
+    app_policy.is_rollback_to_target_version_allowed =
+        MergeRollbackToTargetVersionAllowed(app_guid, NULL);
+    return app_policy;
+  };
+
+  // No policy source has app-specific settings for GUID_NULL, therefore its
+  // merged values are the values for the apps without specific settings.
+  policy->default_app_policy = merge_app_policy(GUID_NULL);
+
+  for (const auto& policy_manager : {group_policy_manager_,
+                                     dm_policy_manager_}) {
+    const CachedOmahaPolicy source_policy = policy_manager->policy();
+    for (const auto& app_settings : source_policy.application_settings) {
+      const GUID& app_guid = app_settings.first;
+      if (!policy->app_policies.count(app_guid)) {
+        policy->app_policies[app_guid] = merge_app_policy(app_guid);
+      }
+    }
+  }
+
+  OPT_LOG(L5, (_T("[ConfigManager::UpdateEffectivePolicy][%u apps]"),
+               static_cast<uint32>(policy->app_policies.size())));
+
+  std::atomic_store(&effective_policy_,
+                    std::shared_ptr<const EffectivePolicy>(policy));
+}
+
 // Returns the override from the registry locations if present. Otherwise,
 // returns the default value.
 // Default value is different value for internal users to make update checks
@@ -1255,6 +1679,21 @@ bool ConfigManager::CanRetryNow(bool is_machine) const {
   return now >= retry_after || retry_after > now + kMaxRetryAfterSeconds;
 }
 
+CString ConfigManager::GetHostHealth(bool is_machine) const {
+  const TCHAR* reg_update_key = is_machine ? MACHINE_REG_UPDATE:
+                                             USER_REG_UPDATE;
+  CString host_health;
+  RegKey::GetValue(reg_update_key, kRegValueHostHealth, &host_health);
+  return host_health;
+}
+
+HRESULT ConfigManager::SetHostHealth(bool is_machine,
+                                     const CString& host_health) const {
+  const TCHAR* reg_update_key = is_machine ? MACHINE_REG_UPDATE:
+                                             USER_REG_UPDATE;
+  return RegKey::SetValue(reg_update_key, kRegValueHostHealth, host_health);
+}
+
 DEFINE_METRIC_integer(last_started_au);
 HRESULT ConfigManager::SetLastStartedAU(bool is_machine) const {
   const TCHAR* reg_update_key = is_machine ? MACHINE_REG_UPDATE:
@@ -1599,6 +2038,18 @@ bool ConfigManager::IsInternalUser() const {
 
 DWORD ConfigManager::GetEffectivePolicyForAppInstalls(
     const GUID& app_guid, IPolicyStatusValue** policy_status_value) const {
+  if (!policy_status_value) {
+    const auto snapshot = effective_policy();
+    if (snapshot) {
+      return snapshot->GetAppPolicy(app_guid).install_policy;
+    }
+  }
+
+  return MergeEffectivePolicyForAppInstalls(app_guid, policy_status_value);
+}
+
+DWORD ConfigManager::MergeEffectivePolicyForAppInstalls(
+    const GUID& app_guid, IPolicyStatusValue** policy_status_value) const {
   PolicyValue<DWORD> v;
 
   for (size_t i = 0; i != policies_.size(); ++i) {
@@ -1623,6 +2074,18 @@ DWORD ConfigManager::GetEffectivePolicyForAppInstalls(
 
 DWORD ConfigManager::GetEffectivePolicyForAppUpdates(
     const GUID& app_guid, IPolicyStatusValue** policy_status_value) const {
+  if (!policy_status_value) {
+    const auto snapshot = effective_policy();
+    if (snapshot) {
+      return snapshot->GetAppPolicy(app_guid).update_policy;
+    }
+  }
+
+  return MergeEffectivePolicyForAppUpdates(app_guid, policy_status_value);
+}
+
+DWORD ConfigManager::MergeEffectivePolicyForAppUpdates(
+    const GUID& app_guid, IPolicyStatusValue** policy_status_value) const {
   PolicyValue<DWORD> v;
 
   for (size_t i = 0; i != policies_.size(); ++i) {
@@ -1647,6 +2110,18 @@ DWORD ConfigManager::GetEffectivePolicyForAppUpdates(
 
 CString ConfigManager::GetTargetChannel(
     const GUID& app_guid, IPolicyStatusValue** policy_status_value) const {
+  if (!policy_status_value) {
+    const auto snapshot = effective_policy();
+    if (snapshot) {
+      return snapshot->GetAppPolicy(app_guid).target_channel;
+    }
+  }
+
+  return MergeTargetChannel(app_guid, policy_status_value);
+}
+
+CString ConfigManager::MergeTargetChannel(
+    const GUID& app_guid, IPolicyStatusValue** policy_status_value) const {
   PolicyValue<CString> v;
 
   for (size_t i = 0; i != policies_.size(); ++i) {
@@ -1668,6 +2143,18 @@ CString ConfigManager::GetTargetChannel(
 
 CString ConfigManager::GetTargetVersionPrefix(
     const GUID& app_guid, IPolicyStatusValue** policy_status_value) const {
+  if (!policy_status_value) {
+    const auto snapshot = effective_policy();
+    if (snapshot) {
+      return snapshot->GetAppPolicy(app_guid).target_version_prefix;
+    }
+  }
+
+  return MergeTargetVersionPrefix(app_guid, policy_status_value);
+}
+
+CString ConfigManager::MergeTargetVersionPrefix(
+    const GUID& app_guid, IPolicyStatusValue** policy_status_value) const {
   PolicyValue<CString> v;
 
   for (size_t i = 0; i != policies_.size(); ++i) {
@@ -1691,6 +2178,19 @@ CString ConfigManager::GetTargetVersionPrefix(
 
 bool ConfigManager::IsRollbackToTargetVersionAllowed(
     const GUID& app_guid, IPolicyStatusValue** policy_status_value) const {
+  if (!policy_status_value) {
+    const auto snapshot = effective_policy();
+    if (snapshot) {
+      return snapshot->GetAppPolicy(app_guid)
+          .is_rollback_to_target_version_allowed;
+    }
+  }
+
+  return MergeRollbackToTargetVersionAllowed(app_guid, policy_status_value);
+}
+
+bool ConfigManager::MergeRollbackToTargetVersionAllowed(
+    const GUID& app_guid, IPolicyStatusValue** policy_status_value) const {
   PolicyValue<bool> v;
 
   for (size_t i = 0; i != policies_.size(); ++i) {
@@ -1833,6 +2333,14 @@ bool ConfigManager::ShouldVerifyPayloadAuthenticodeSignature() const {
 #endif  // VERIFY_PAYLOAD_AUTHENTICODE_SIGNATURE
 }
 
+bool ConfigManager::ShouldStorePackagesByContent() const {
+  DWORD disabled_in_registry = 0;
+  RegKey::GetValue(MACHINE_REG_UPDATE_DEV,
+                   kRegValueDisableContentAddressedPackageCache,
+                   &disabled_in_registry);
+  return disabled_in_registry == 0;
+}
+
 int ConfigManager::MaxCrashUploadsPerDay() const {
   DWORD num_uploads = 0;
   if (FAILED(RegKey::GetValue(MACHINE_REG_UPDATE_DEV,
@@ -1850,6 +2358,18 @@ int ConfigManager::MaxCrashUploadsPerDay() const {
 
 CString ConfigManager::GetDownloadPreferenceGroupPolicy(
     IPolicyStatusValue** policy_status_value) const {
+  if (!policy_status_value) {
+    const auto snapshot = effective_policy();
+    if (snapshot) {
+      return snapshot->download_preference;
+    }
+  }
+
+  return MergeDownloadPreferenceGroupPolicy(policy_status_value);
+}
+
+CString ConfigManager::MergeDownloadPreferenceGroupPolicy(
+    IPolicyStatusValue** policy_status_value) const {
   PolicyValue<CString> v;
 
   for (size_t i = 0; i != policies_.size(); ++i) {
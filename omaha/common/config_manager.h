@@ -26,6 +26,7 @@
 #include <windows.h>
 #include <atlpath.h>
 #include <atlstr.h>
+#include <map>
 #include <memory>
 #include <vector>
 #include "base/basictypes.h"
@@ -58,6 +59,12 @@ class PolicyManagerInterface {
   virtual HRESULT GetPackageCacheSizeLimitMBytes(DWORD* cache_size_limit) = 0;
   virtual HRESULT GetPackageCacheExpirationTimeDays(
       DWORD* cache_life_limit) = 0;
+  virtual HRESULT GetDownloadRateLimitKBytesPerSec(bool is_background,
+                                                   DWORD* rate_limit) = 0;
+  virtual HRESULT GetPeerCacheUrls(CString* peer_cache_urls) = 0;
+  virtual HRESULT GetPeerCacheServerPort(DWORD* port) = 0;
+  virtual HRESULT GetMaxConcurrentInstalls(DWORD* max_concurrent_installs) = 0;
+  virtual HRESULT GetUpdateCheckShardSize(DWORD* shard_size) = 0;
   virtual HRESULT GetProxyMode(CString* proxy_mode) = 0;
   virtual HRESULT GetProxyPacUrl(CString* proxy_pac_url) = 0;
   virtual HRESULT GetProxyServer(CString* proxy_server) = 0;
@@ -90,6 +97,12 @@ class OmahaPolicyManager : public PolicyManagerInterface {
       CString* download_preference) override;
   HRESULT GetPackageCacheSizeLimitMBytes(DWORD* cache_size_limit) override;
   HRESULT GetPackageCacheExpirationTimeDays(DWORD* cache_life_limit) override;
+  HRESULT GetDownloadRateLimitKBytesPerSec(bool is_background,
+                                           DWORD* rate_limit) override;
+  HRESULT GetPeerCacheUrls(CString* peer_cache_urls) override;
+  HRESULT GetPeerCacheServerPort(DWORD* port) override;
+  HRESULT GetMaxConcurrentInstalls(DWORD* max_concurrent_installs) override;
+  HRESULT GetUpdateCheckShardSize(DWORD* shard_size) override;
   HRESULT GetProxyMode(CString* proxy_mode) override;
   HRESULT GetProxyPacUrl(CString* proxy_pac_url) override;
   HRESULT GetProxyServer(CString* proxy_server) override;
@@ -117,6 +130,54 @@ class OmahaPolicyManager : public PolicyManagerInterface {
   DISALLOW_COPY_AND_ASSIGN(OmahaPolicyManager);
 };
 
+// Holds the policy values merged across all the policy managers. An instance
+// is built by the ConfigManager each time a policy source changes, and it is
+// never modified after it is published. Therefore, readers can use it without
+// taking any locks.
+struct EffectivePolicy {
+  struct AppPolicy {
+    DWORD install_policy = 0;
+    DWORD update_policy = 0;
+    CString target_channel;
+    CString target_version_prefix;
+    bool is_rollback_to_target_version_allowed = false;
+  };
+
+  // Returns the policy for |app_guid|, or |default_app_policy| if none of the
+  // policy sources has settings specific to this app.
+  const AppPolicy& GetAppPolicy(const GUID& app_guid) const {
+    const auto it = app_policies.find(app_guid);
+    return it != app_policies.end() ? it->second : default_app_policy;
+  }
+
+  int package_cache_size_limit_mbytes = 0;
+  int package_cache_expiration_time_days = 0;
+
+  // Indexed by |is_background|.
+  int download_rate_limit_kbytes_per_sec[2] = {0, 0};
+
+  std::vector<CString> peer_cache_urls;
+  int peer_cache_server_port = 0;
+  int max_concurrent_installs = 0;
+  int update_check_shard_size = 0;
+
+  HRESULT proxy_mode_hr = E_FAIL;
+  CString proxy_mode;
+  HRESULT proxy_pac_url_hr = E_FAIL;
+  CString proxy_pac_url;
+  HRESULT proxy_server_hr = E_FAIL;
+  CString proxy_server;
+
+  // Indexed by |is_machine|.
+  HRESULT force_install_apps_hr[2] = {E_FAIL, E_FAIL};
+  std::vector<CString> force_install_apps[2];
+
+  CString download_preference;
+
+  AppPolicy default_app_policy;
+  std::map<GUID, AppPolicy, GUIDCompare> app_policies;
+};
+
 class ConfigManager {
  public:
   const TCHAR* user_registry_clients() const { return USER_REG_CLIENTS; }
@@ -184,6 +245,29 @@ class ConfigManager {
   int GetPackageCacheExpirationTimeDays(
       IPolicyStatusValue** policy_status_value) const;
 
+  // Gets the limit of the download rate of the foreground or the background
+  // requests in KB per second. Returns 0 if the rate is not limited.
+  int GetDownloadRateLimitKBytesPerSec(
+      bool is_background,
+      IPolicyStatusValue** policy_status_value) const;
+
+  // Gets the base urls of the caches of the peers on the local network, which
+  // the packages are downloaded from before the download base urls.
+  std::vector<CString> GetPeerCacheUrls(
+      IPolicyStatusValue** policy_status_value) const;
+
+  // Gets the port on which the machine serves the packages of its cache to
+  // its peers. Returns 0 if the machine does not serve them.
+  int GetPeerCacheServerPort(IPolicyStatusValue** policy_status_value) const;
+
+  // Gets the number of app installers which may run at the same time. Returns
+  // 1 if the policy is not set.
+  int GetMaxConcurrentInstalls(IPolicyStatusValue** policy_status_value) const;
+
+  // Gets the number of apps in each request of an update check. Returns 0 if
+  // the update check is sent as a single request.
+  int GetUpdateCheckShardSize(IPolicyStatusValue** policy_status_value) const;
+
   // Gets the proxy policy values.
   HRESULT GetProxyMode(CString* proxy_mode,
                        IPolicyStatusValue** policy_status_value) const;
@@ -314,6 +398,10 @@ class ConfigManager {
   HRESULT SetRetryAfterTime(bool is_machine, DWORD time) const;
   bool CanRetryNow(bool is_machine) const;
 
+  // Gets and sets the last snapshot of the health of the network hosts.
+  CString GetHostHealth(bool is_machine) const;
+  HRESULT SetHostHealth(bool is_machine, const CString& host_health) const;
+
   // Gets and sets the last time a successful server update check was made.
   DWORD GetLastCheckedTime(bool is_machine) const;
   HRESULT SetLastCheckedTime(bool is_machine, DWORD time) const;
@@ -438,6 +526,10 @@ class ConfigManager {
   // verified.
   bool ShouldVerifyPayloadAuthenticodeSignature() const;
 
+  // Returns whether the package cache stores packages once per digest of
+  // their contents.
+  bool ShouldStorePackagesByContent() const;
+
   // Returns the number of crashes to upload per day.
   int MaxCrashUploadsPerDay() const;
 
@@ -472,7 +564,62 @@ class ConfigManager {
   static ConfigManager* Instance();
   static void DeleteInstance();
 
+  // Returns the policies merged across all the policy managers. The returned
+  // snapshot remains valid and unchanged even if the policies are reloaded
+  // while the caller holds it. Returns NULL until the policies are loaded.
+  std::shared_ptr<const EffectivePolicy> effective_policy() const {
+    return std::atomic_load(&effective_policy_);
+  }
+
  private:
+  // Merges the policies from all the policy managers into a new
+  // EffectivePolicy and publishes it. Must be called every time a policy
+  // manager changes. The getters that are not asked for a policy status value
+  // read the published snapshot instead of merging the policies on each call.
+  void UpdateEffectivePolicy();
+
+  // Merge the values of a policy across all the policy managers. Unlike the
+  // public getters, they never read the published snapshot, so that
+  // UpdateEffectivePolicy() can build a new snapshot from them.
+  int MergePackageCacheSizeLimitMBytes(
+      IPolicyStatusValue** policy_status_value) const;
+  int MergePackageCacheExpirationTimeDays(
+      IPolicyStatusValue** policy_status_value) const;
+  int MergeDownloadRateLimitKBytesPerSec(
+      bool is_background,
+      IPolicyStatusValue** policy_status_value) const;
+  std::vector<CString> MergePeerCacheUrls(
+      IPolicyStatusValue** policy_status_value) const;
+  int MergePeerCacheServerPort(IPolicyStatusValue** policy_status_value) const;
+  int MergeMaxConcurrentInstalls(
+      IPolicyStatusValue** policy_status_value) const;
+  int MergeUpdateCheckShardSize(IPolicyStatusValue** policy_status_value) const;
+  HRESULT MergeProxyMode(
+      CString* proxy_mode,
+      IPolicyStatusValue** policy_status_value) const;
+  HRESULT MergeProxyPacUrl(
+      CString* proxy_pac_url,
+      IPolicyStatusValue** policy_status_value) const;
+  HRESULT MergeProxyServer(
+      CString* proxy_server,
+      IPolicyStatusValue** policy_status_value) const;
+  HRESULT MergeForceInstallApps(
+      bool is_machine,
+      std::vector<CString>* app_ids,
+      IPolicyStatusValue** policy_status_value) const;
+  DWORD MergeEffectivePolicyForAppInstalls(
+      const GUID& app_guid, IPolicyStatusValue** policy_status_value) const;
+  DWORD MergeEffectivePolicyForAppUpdates(
+      const GUID& app_guid, IPolicyStatusValue** policy_status_value) const;
+  CString MergeTargetChannel(
+      const GUID& app_guid, IPolicyStatusValue** policy_status_value) const;
+  CString MergeTargetVersionPrefix(
+      const GUID& app_guid, IPolicyStatusValue** policy_status_value) const;
+  bool MergeRollbackToTargetVersionAllowed(
+      const GUID& app_guid, IPolicyStatusValue** policy_status_value) const;
+  CString MergeDownloadPreferenceGroupPolicy(
+      IPolicyStatusValue** policy_status_value) const;
+
   // Loads the Group policies from the registry and sets it up on the
   // ConfigManager instance, which is used by the ConfigManager for subsequent
   // config queries.
@@ -489,6 +636,11 @@ class ConfigManager {
   std::shared_ptr<OmahaPolicyManager> group_policy_manager_;       // NOLINT
   std::shared_ptr<OmahaPolicyManager> dm_policy_manager_;          // NOLINT
   bool are_cloud_policies_preferred_;
+  std::shared_ptr<const EffectivePolicy> effective_policy_;
+
+  // Serializes the changes of the policy managers and the rebuilds of
+  // |effective_policy_|.
+  LLock policy_lock_;
 
   DISALLOW_COPY_AND_ASSIGN(ConfigManager);
 };
@@ -15,7 +15,9 @@
 
 #include <atltime.h>
 #include <limits.h>
+#include <iostream>
 #include <tuple>
+#include <vector>
 #include "omaha/base/app_util.h"
 #include "omaha/base/const_addresses.h"
 #include "omaha/base/constants.h"
@@ -24,6 +26,7 @@
 #include "omaha/base/string.h"
 #include "omaha/base/system_info.h"
 #include "omaha/base/time.h"
+#include "omaha/base/timer.h"
 #include "omaha/base/utils.h"
 #include "omaha/base/vistautil.h"
 #include "omaha/common/config_manager.h"
@@ -2236,6 +2239,88 @@ TEST_P(ConfigManagerTest, GetDownloadPreferenceGroupPolicy) {
                cm_->GetDownloadPreferenceGroupPolicy(NULL));
 }
 
+TEST_P(ConfigManagerTest, EffectivePolicy_TracksPolicyChanges) {
+  const GUID app_guid = StringToGuid(kAppGuid1);
+
+  auto snapshot = cm_->effective_policy();
+  ASSERT_TRUE(snapshot);
+  EXPECT_EQ(GetEffectivePolicyForAppInstalls(kAppGuid1),
+            snapshot->GetAppPolicy(app_guid).install_policy);
+
+  EXPECT_SUCCEEDED(SetPolicy(kInstallPolicyApp1, kPolicyDisabled));
+
+  // The snapshot held by the caller is not modified by the reload.
+  EXPECT_EQ(IsDM() ? kPolicyForceInstallMachine : kPolicyEnabled,
+            snapshot->GetAppPolicy(app_guid).install_policy);
+
+  auto new_snapshot = cm_->effective_policy();
+  ASSERT_TRUE(new_snapshot);
+  EXPECT_NE(snapshot, new_snapshot);
+  EXPECT_EQ(GetEffectivePolicyForAppInstalls(kAppGuid1),
+            new_snapshot->GetAppPolicy(app_guid).install_policy);
+  ExpectTrueOnlyIfDomain(new_snapshot->GetAppPolicy(app_guid).install_policy ==
+                         kPolicyDisabled);
+
+  // Apps without specific settings get the merged default values.
+  const GUID other_app_guid =
+      StringToGuid(_T("{5F46DE36-737D-4271-91C1-C062F9FE21D9}"));
+  EXPECT_EQ(new_snapshot->GetAppPolicy(GUID_NULL).install_policy,
+            new_snapshot->GetAppPolicy(other_app_guid).install_policy);
+}
+
+// Measures the per-app policy lookups for a large set of apps, as well as the
+// cost of rebuilding the snapshot when the DM policies change.
+TEST_P(ConfigManagerTest, EffectivePolicy_PerAppLookupBenchmark) {
+  if (!IsDM()) {
+    return;
+  }
+
+  const int kNumApps = 2000;
+  const int kNumIterations = 10;
+
+  CachedOmahaPolicy info;
+  info.is_managed = true;
+  info.is_initialized = true;
+  info.install_default = kPolicyDisabled;
+  info.update_default = kPolicyDisabled;
+
+  std::vector<GUID> app_guids;
+  for (int i = 0; i != kNumApps; ++i) {
+    GUID app_guid = {};
+    EXPECT_SUCCEEDED(::CoCreateGuid(&app_guid));
+    app_guids.push_back(app_guid);
+
+    ApplicationSettings app;
+    app.install = kPolicyEnabled;
+    app.update = (i % 2) ? kPolicyManualUpdatesOnly : kPolicyEnabled;
+    app.target_channel = _T("beta");
+    info.application_settings.insert(std::make_pair(app_guid, app));
+  }
+
+  Timer rebuild_timer(true);
+  cm_->SetOmahaDMPolicies(info);
+  rebuild_timer.Stop();
+
+  // The Group Policy in this test has no app settings, so the DM policy values
+  // are effective regardless of the precedence of the sources.
+  Timer lookup_timer(true);
+  for (int iteration = 0; iteration != kNumIterations; ++iteration) {
+    for (int i = 0; i != kNumApps; ++i) {
+      const GUID& app_guid = app_guids[i];
+      EXPECT_EQ(kPolicyEnabled,
+                cm_->GetEffectivePolicyForAppInstalls(app_guid, NULL));
+      EXPECT_EQ(!(i % 2), cm_->CanUpdateApp(app_guid, false));
+      EXPECT_STREQ(_T("beta"), cm_->GetTargetChannel(app_guid, NULL));
+    }
+  }
+  lookup_timer.Stop();
+
+  std::cout << "[EffectivePolicy][" << kNumApps << " apps]"
+            << "[rebuild " << rebuild_timer.GetMilliseconds() << " ms]"
+            << "[" << kNumApps * kNumIterations * 3 << " lookups "
+            << lookup_timer.GetMilliseconds() << " ms]" << std::endl;
+}
+
 #if defined(HAS_DEVICE_MANAGEMENT)
 
 TEST_P(ConfigManagerTest, GetCloudManagementEnrollmentToken) {
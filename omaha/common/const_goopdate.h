@@ -156,6 +156,11 @@ const TCHAR* const kRegValueWebAccessible      = _T("WebAccessible");
 // hook CLSID.
 const TCHAR* const kRegValueUpdateHookClsid  = _T("RegistrationUpdateHook");
 
+// Registry value in an app's Clients key that contains the ids of the apps,
+// separated by semicolons, whose installers must not run at the same time as
+// the installer of the app.
+const TCHAR* const kRegValueInstallConflicts = _T("InstallConflicts");
+
 // Registry values read from the Clients key and stored in the ClientState key.
 const TCHAR* const kRegValueLanguage         = _T("lang");
 const TCHAR* const kRegValueAppName          = _T("name");
@@ -254,6 +259,10 @@ const TCHAR* const kRegValueLastOSVersion         = _T("LastOSVersion");
 // for update checks. See the explanation of kHeaderXRetryAfter in constants.h.
 const TCHAR* const kRegValueRetryAfter            = _T("RetryAfter");
 
+// The counters of the network requests and the state of the hosts which are
+// not healthy, written by the worker so that goopdump can read them.
+const TCHAR* const kRegValueHostHealth            = _T("HostHealth");
+
 // UID registry entries.
 const TCHAR* const kRegValueUserId                = _T("uid");
 const TCHAR* const kRegValueOldUserId             = _T("old-uid");
@@ -70,6 +70,31 @@ const TCHAR* const kRegValueDownloadPreference = _T("DownloadPreference");
 // Specifies that urls that can be cached by proxies are preferred.
 const TCHAR* const kDownloadPreferenceCacheable = _T("cacheable");
 
+// The limits of the download rate of the foreground and the background
+// downloads in KB per second, 0 for no limit.
+const TCHAR* const kRegValueDownloadRateLimitKBytes =
+    _T("DownloadRateLimitKBytesPerSec");
+const TCHAR* const kRegValueBackgroundDownloadRateLimitKBytes =
+    _T("BackgroundDownloadRateLimitKBytesPerSec");
+
+// The base urls of the caches of the peers on the local network, separated
+// by semicolons, as in "http://cache1:8090/;http://cache2:8090/". Packages are
+// downloaded from these caches before the download base urls.
+const TCHAR* const kRegValuePeerCacheUrls = _T("PeerCacheUrls");
+
+// The port on which the machine serves the packages of its cache to its
+// peers, 0 for none.
+const TCHAR* const kRegValuePeerCacheServerPort = _T("PeerCacheServerPort");
+
+// The number of app installers which may run at the same time. The installers
+// of the same app, of conflicting apps, and MSI installers still run one at a
+// time.
+const TCHAR* const kRegValueMaxConcurrentInstalls = _T("MaxConcurrentInstalls");
+
+// The number of apps in each request of an update check. The update check of
+// more apps is sent as several concurrent requests. 0 sends a single request.
+const TCHAR* const kRegValueUpdateCheckShardSize = _T("UpdateCheckShardSize");
+
 #if defined(HAS_DEVICE_MANAGEMENT)
 
 // The name of the policy holding a token used to enroll in cloud-based
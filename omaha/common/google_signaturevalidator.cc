@@ -21,10 +21,24 @@
 
 #include "base/basictypes.h"
 #include "omaha/base/const_code_signing.h"
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
 #include "omaha/base/signaturevalidator.h"
 
 namespace omaha {
 
+namespace {
+
+std::vector<CString> GetSubjectNames() {
+  std::vector<CString> subject;
+  subject.push_back(kSha256CertificateSubjectName);
+  subject.push_back(kSha1CertificateSubjectName);
+  subject.push_back(kLegacyCertificateSubjectName);
+  return subject;
+}
+
+}  // namespace
+
 HRESULT VerifyGoogleAuthenticodeSignature(const CString& filename,
                                           bool allow_network_check) {
   HRESULT hr = VerifyAuthenticodeSignature(filename, allow_network_check);
@@ -37,14 +51,9 @@ HRESULT VerifyGoogleAuthenticodeSignature(const CString& filename,
     expected_hashes.push_back(kPublicKeyHashes[i]);
   }
 
-  std::vector<CString> subject;
-  subject.push_back(kSha256CertificateSubjectName);
-  subject.push_back(kSha1CertificateSubjectName);
-  subject.push_back(kLegacyCertificateSubjectName);
-
   const bool check_cert_is_valid_now = false;
   hr = VerifyCertificate(filename,
-                         subject,
+                         GetSubjectNames(),
                          check_cert_is_valid_now,
                          expected_hashes.empty() ? NULL : &expected_hashes);
   if (FAILED(hr)) {
@@ -54,5 +63,36 @@ HRESULT VerifyGoogleAuthenticodeSignature(const CString& filename,
   return S_OK;
 }
 
+HRESULT VerifyGoogleAuthenticodeSignature(const CString& filename,
+                                          bool allow_network_check,
+                                          CString* signer,
+                                          FILETIME* not_valid_after) {
+  ASSERT1(signer);
+  ASSERT1(not_valid_after);
+
+  HRESULT hr = VerifyGoogleAuthenticodeSignature(filename,
+                                                 allow_network_check);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  CertList cert_list;
+  ExtractAllCertificatesFromSignature(filename, NULL, &cert_list);
+  const CertInfo* cert = NULL;
+  const bool check_cert_is_valid_now = false;
+  cert_list.FindFirstCert(&cert,
+                          GetSubjectNames(),
+                          CString(),
+                          CString(),
+                          check_cert_is_valid_now);
+  if (!cert) {
+    return GOOPDATE_E_SIGNATURE_NOT_TRUSTED_SUBJECT;
+  }
+
+  *signer = cert->issuing_company_name_;
+  *not_valid_after = cert->not_valid_after_;
+  return S_OK;
+}
+
 }  // namespace omaha
 
@@ -32,6 +32,13 @@ namespace omaha {
 HRESULT VerifyGoogleAuthenticodeSignature(const CString& filename,
                                           bool allow_network_check);
 
+// Verifies the signature as above, and also returns the name of the signer and
+// the end of the validity period of the signing certificate.
+HRESULT VerifyGoogleAuthenticodeSignature(const CString& filename,
+                                          bool allow_network_check,
+                                          CString* signer,
+                                          FILETIME* not_valid_after);
+
 }  // namespace omaha
 
 #endif  // OMAHA_COMMON_GOOGLE_SIGNATUREVALIDATOR_H_
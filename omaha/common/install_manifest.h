@@ -30,7 +30,7 @@ namespace omaha {
 namespace xml {
 
 struct InstallPackage {
-  InstallPackage() : is_required(false), size(0) {}
+  InstallPackage() : is_required(false), size(0), size_diff(0) {}
 
   CString name;
   CString version;
@@ -38,6 +38,12 @@ struct InstallPackage {
   int size;
   CString hash_sha1;  // base64 encoded.
   CString hash_sha256;  // hex-digit encoded.
+
+  // Optional differential package, which turns the cached package of the
+  // current version into this package.
+  CString name_diff;
+  int size_diff;
+  CString hash_sha256_diff;  // hex-digit encoded.
 };
 
 struct InstallAction {
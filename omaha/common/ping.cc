@@ -15,13 +15,21 @@
 
 #include "omaha/common/ping.h"
 
+#include <algorithm>
+#include <filesystem>
+#include <map>
+#include <string>
+
+#include "omaha/base/const_object_names.h"
 #include "omaha/base/constants.h"
 #include "omaha/base/debug.h"
 #include "omaha/base/logging.h"
+#include "omaha/base/path.h"
 #include "omaha/base/safe_format.h"
 #include "omaha/base/scope_guard.h"
 #include "omaha/base/scoped_impersonation.h"
 #include "omaha/base/string.h"
+#include "omaha/base/synchronized.h"
 #include "omaha/base/utils.h"
 #include "omaha/base/vistautil.h"
 #include "omaha/base/vista_utils.h"
@@ -31,6 +39,7 @@
 #include "omaha/common/config_manager.h"
 #include "omaha/common/experiment_labels.h"
 #include "omaha/common/goopdate_utils.h"
+#include "omaha/common/ping_journal.h"
 #include "omaha/common/update_request.h"
 #include "omaha/common/update_response.h"
 #include "omaha/goopdate/app.h"
@@ -45,7 +54,11 @@ const TCHAR* const Ping::kRegKeyPersistedPings = _T("PersistedPings");
 const TCHAR* const Ping::kRegValuePersistedPingTime = _T("PersistedPingTime");
 const TCHAR* const Ping::kRegValuePersistedPingString =
     _T("PersistedPingString");
+const TCHAR* const Ping::kPersistedPingsJournalFileName =
+    _T("PersistedPings.dat");
 const time64 Ping::kPersistedPingExpiry100ns  = 10 * kDaysTo100ns;  // 10 days.
+const size_t Ping::kMaxPersistedPingsPerRequest = 50;
+const size_t Ping::kMaxPersistedPingsRequestBytes = 64 * 1024;
 
 // Minimum compatible Omaha version that understands the /ping command line.
 // 1.3.0.0.
@@ -344,18 +357,66 @@ CString Ping::GetPersistedPingsRegPath(bool is_machine) {
   return AppendRegKeyPath(persisted_pings_reg_path, kRegKeyPersistedPings);
 }
 
-HRESULT Ping::LoadPersistedPings(bool is_machine,
-                                 PingsVector* persisted_pings) {
-  ASSERT1(persisted_pings);
+CString Ping::GetPersistedPingsJournalPath(bool is_machine) {
+  const ConfigManager& config_manager = *ConfigManager::Instance();
+  const CString dir = is_machine ?
+      config_manager.GetMachineGoopdateInstallDir() :
+      config_manager.GetUserGoopdateInstallDir();
+  return ConcatenatePath(dir, kPersistedPingsJournalFileName);
+}
+
+HRESULT Ping::InitializePersistedPingsLock(bool is_machine, GLock* lock) {
+  ASSERT1(lock);
+
+  NamedObjectAttributes lock_attr;
+  GetNamedObjectAttributes(kPersistedPingsLock, is_machine, &lock_attr);
+  if (!lock->InitializeWithSecAttr(lock_attr.name, &lock_attr.sa) &&
+      !lock->InitializeWithSecAttr(lock_attr.name, NULL)) {
+    HRESULT hr = HRESULTFromLastError();
+    CORE_LOG(LE, (_T("[InitializePersistedPingsLock failed][%#x]"), hr));
+    return hr;
+  }
+
+  return S_OK;
+}
+
+// Must be called with the persisted pings lock held.
+HRESULT Ping::LoadPingJournal(bool is_machine,
+                              std::unique_ptr<PingJournal>* journal) {
+  ASSERT1(journal);
+
+  const CString path(GetPersistedPingsJournalPath(is_machine));
+  journal->reset(new PingJournal(std::make_unique<PingJournal::FileStorage>(
+      std::filesystem::path(path.GetString()))));
+  if (!(*journal)->Load()) {
+    CORE_LOG(LE, (_T("[Failed to load the ping journal][%s]"), path));
+    journal->reset();
+    return HRESULT_FROM_WIN32(ERROR_READ_FAULT);
+  }
+
+  if ((*journal)->dead_bytes()) {
+    CORE_LOG(L3, (_T("[Ping journal][%Iu bytes][%Iu dead bytes]"),
+                  (*journal)->size_bytes(), (*journal)->dead_bytes()));
+  }
+
+  return S_OK;
+}
+
+// Moves the pings persisted in the registry by older versions to the journal,
+// then deletes them from the registry. Must be called with the persisted pings
+// lock held.
+HRESULT Ping::MigrateLegacyPersistedPings(bool is_machine,
+                                          PingJournal* journal) {
+  ASSERT1(journal);
 
   RegKey persisted_pings_reg_key;
   CString persisted_pings_reg_path(GetPersistedPingsRegPath(is_machine));
   HRESULT hr = persisted_pings_reg_key.Open(persisted_pings_reg_path, KEY_READ);
   if (FAILED(hr)) {
-    CORE_LOG(LW, (_T("[Unable to open Persisted pings regkey][%#x]"), hr));
-    return hr;
+    return hr == HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND) ? S_OK : hr;
   }
 
+  std::vector<PingJournal::Entry> legacy_pings;
   int num_pings = persisted_pings_reg_key.GetSubkeyCount();
   for (int i = 0; i < num_pings; ++i) {
     CString persisted_subkey_name;
@@ -399,13 +460,66 @@ HRESULT Ping::LoadPersistedPings(bool is_machine,
       continue;
     }
 
+    PingJournal::Entry entry;
+    entry.id = WideToUtf8(persisted_subkey_name).GetString();
+    entry.time_100ns = persisted_time;
+    entry.request = WideToUtf8(persisted_ping_string).GetString();
+    legacy_pings.push_back(entry);
+  }
+
+  // The journal keeps the pings in the order in which they are added, and the
+  // oldest ping of a batch provides the attributes of the batch request.
+  std::stable_sort(legacy_pings.begin(), legacy_pings.end(),
+                   [](const PingJournal::Entry& a,
+                      const PingJournal::Entry& b) {
+                     return a.time_100ns < b.time_100ns;
+                   });
+
+  for (const auto& entry : legacy_pings) {
+    if (!journal->Add(entry)) {
+      CORE_LOG(LE, (_T("[Failed to migrate persisted ping][%S]"),
+                    entry.id.c_str()));
+      return HRESULT_FROM_WIN32(ERROR_WRITE_FAULT);
+    }
+  }
+
+  CORE_LOG(L3, (_T("[Migrated %Iu persisted pings]"), legacy_pings.size()));
+  VERIFY_SUCCEEDED(persisted_pings_reg_key.Close());
+  return RegKey::DeleteKey(persisted_pings_reg_path);
+}
+
+HRESULT Ping::LoadPersistedPings(bool is_machine,
+                                 PingsVector* persisted_pings) {
+  ASSERT1(persisted_pings);
+
+  GLock persisted_pings_lock;
+  HRESULT hr = InitializePersistedPingsLock(is_machine, &persisted_pings_lock);
+  if (FAILED(hr)) {
+    return hr;
+  }
+  __mutexScope(persisted_pings_lock);
+
+  // Migrating the legacy pings writes to HKLM and to the machine install
+  // directory, which needs admin.
+  scoped_revert_to_self revert_to_self;
+
+  std::unique_ptr<PingJournal> journal;
+  hr = LoadPingJournal(is_machine, &journal);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  VERIFY_SUCCEEDED(MigrateLegacyPersistedPings(is_machine, journal.get()));
+
+  for (const auto& entry : journal->entries()) {
+    const CString id(Utf8ToWideChar(entry.id.c_str(),
+                                    static_cast<uint32>(entry.id.size())));
+    const CString ping_string(Utf8ToWideChar(
+        entry.request.c_str(), static_cast<uint32>(entry.request.size())));
     persisted_pings->push_back(std::make_pair(
-        persisted_subkey_name,
-        std::make_pair(persisted_time, persisted_ping_string)));
-    CORE_LOG(L6, (_T("[Persisted ping][%s][%s][%s]"),
-                  persisted_subkey_name,
-                  persisted_time_string,
-                  persisted_ping_string));
+        id, std::make_pair(entry.time_100ns, ping_string)));
+    CORE_LOG(L6, (_T("[Persisted ping][%s][%I64u][%s]"),
+                  id, entry.time_100ns, ping_string));
   }
 
   return S_OK;
@@ -430,21 +544,37 @@ bool Ping::IsPingExpired(time64 persisted_time) {
 }
 
 HRESULT Ping::DeletePersistedPing(bool is_machine,
-                                  const CString& persisted_subkey_name) {
-  CORE_LOG(L3, (_T("[Ping::DeletePersistedPing][%s]"), persisted_subkey_name));
+                                  const CString& persisted_ping_id) {
+  CORE_LOG(L3, (_T("[Ping::DeletePersistedPing][%s]"), persisted_ping_id));
 
-  CString persisted_pings_reg_path(GetPersistedPingsRegPath(is_machine));
-  CString persisted_ping_reg_path = AppendRegKeyPath(persisted_pings_reg_path,
-                                                     persisted_subkey_name);
+  return DeletePersistedPings(
+      is_machine,
+      std::vector<std::string>(1, WideToUtf8(persisted_ping_id).GetString()));
+}
 
-  if (!RegKey::HasKey(persisted_ping_reg_path)) {
+HRESULT Ping::DeletePersistedPings(bool is_machine,
+                                   const std::vector<std::string>& ids) {
+  if (ids.empty()) {
     return S_OK;
   }
 
-  // Registry writes to HKLM need admin.
+  GLock persisted_pings_lock;
+  HRESULT hr = InitializePersistedPingsLock(is_machine, &persisted_pings_lock);
+  if (FAILED(hr)) {
+    return hr;
+  }
+  __mutexScope(persisted_pings_lock);
+
+  // File writes to the machine install directory need admin.
   scoped_revert_to_self revert_to_self;
 
-  return RegKey::DeleteKey(persisted_ping_reg_path);
+  std::unique_ptr<PingJournal> journal;
+  hr = LoadPingJournal(is_machine, &journal);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  return journal->Remove(ids) ? S_OK : HRESULT_FROM_WIN32(ERROR_WRITE_FAULT);
 }
 
 void Ping::DeletePersistedPingOnSuccess(const HRESULT& hr) {
@@ -453,10 +583,6 @@ void Ping::DeletePersistedPingOnSuccess(const HRESULT& hr) {
   }
 }
 
-CString Ping::GetPersistedPingRegPath() {
-  return AppendRegKeyPath(GetPersistedPingsRegPath(is_machine_), request_id_);
-}
-
 HRESULT Ping::PersistPing() {
   CString ping_string;
   HRESULT hr = BuildRequestString(&ping_string);
@@ -465,63 +591,123 @@ HRESULT Ping::PersistPing() {
     return hr;
   }
 
-  CString time_now_str;
-  SafeCStringFormat(&time_now_str, _T("%I64u"), GetCurrent100NSTime());
-  CORE_LOG(L3, (_T("[Ping::PersistPing][%s][%s][%s]"),
-                request_id_, time_now_str, ping_string));
+  PingJournal::Entry entry;
+  entry.id = WideToUtf8(request_id_).GetString();
+  entry.time_100ns = GetCurrent100NSTime();
+  entry.request = WideToUtf8(ping_string).GetString();
+  CORE_LOG(L3, (_T("[Ping::PersistPing][%s][%I64u][%s]"),
+                request_id_, entry.time_100ns, ping_string));
 
-  CString ping_reg_path(GetPersistedPingRegPath());
+  GLock persisted_pings_lock;
+  hr = InitializePersistedPingsLock(is_machine_, &persisted_pings_lock);
+  if (FAILED(hr)) {
+    return hr;
+  }
+  __mutexScope(persisted_pings_lock);
 
-  // Registry writes to HKLM need admin.
+  // File writes to the machine install directory need admin.
   scoped_revert_to_self revert_to_self;
   ASSERT1(!is_machine_ || vista_util::IsUserAdmin());
 
-  hr = RegKey::SetValue(ping_reg_path,
-                        kRegValuePersistedPingString,
-                        ping_string);
+  std::unique_ptr<PingJournal> journal;
+  hr = LoadPingJournal(is_machine_, &journal);
   if (FAILED(hr)) {
     return hr;
   }
 
-  return RegKey::SetValue(ping_reg_path,
-                          kRegValuePersistedPingTime,
-                          time_now_str);
+  return journal->Add(entry) ? S_OK : HRESULT_FROM_WIN32(ERROR_WRITE_FAULT);
 }
 
 HRESULT Ping::SendPersistedPings(bool is_machine) {
   PingsVector persisted_pings;
   HRESULT hr = LoadPersistedPings(is_machine, &persisted_pings);
-  if (FAILED(hr) && (hr != HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND))) {
+  if (FAILED(hr)) {
     return hr;
   }
+  if (persisted_pings.empty()) {
+    return S_OK;
+  }
 
+  // The pings are sent without holding the lock, so that other processes can
+  // persist pings in the meantime.
+  std::vector<PingJournal::Entry> pings;
+  std::map<std::string, time64> persisted_times;
   for (size_t i = 0; i != persisted_pings.size(); ++i) {
-    const CString& persisted_subkey_name(persisted_pings[i].first);
-    time64 persisted_time = persisted_pings[i].second.first;
+    PingJournal::Entry entry;
+    entry.id = WideToUtf8(persisted_pings[i].first).GetString();
+    entry.time_100ns = persisted_pings[i].second.first;
+    entry.request = WideToUtf8(persisted_pings[i].second.second).GetString();
+    persisted_times[entry.id] = entry.time_100ns;
+    pings.push_back(entry);
+  }
+
+  const std::vector<PingBatch> batches =
+      CoalescePings(pings, kMaxPersistedPingsPerRequest,
+                    kMaxPersistedPingsRequestBytes);
+  CORE_LOG(L3, (_T("[Resending persisted pings][%Iu pings][%Iu requests]"),
+                pings.size(), batches.size()));
+
+  // The pings are resent in a new session.
+  CString session_id;
+  VERIFY_SUCCEEDED(GetGuid(&session_id));
+
+  std::vector<std::string> sent_or_expired_ids;
+  for (const auto& batch : batches) {
     int32 request_age = Time64ToInt32(GetCurrent100NSTime()) -
-                        Time64ToInt32(persisted_time);
-    const CString& persisted_ping_string(persisted_pings[i].second.second);
+                        Time64ToInt32(batch.time_100ns);
+    CString request_string;
+    hr = BuildPersistedPingsRequestString(batch, session_id, &request_string);
+    if (FAILED(hr)) {
+      CORE_LOG(LE, (_T("[BuildPersistedPingsRequestString failed][%#x]"), hr));
+    }
 
-    CORE_LOG(L3, (_T("[Resending persisted ping][%s][%I64u][%d][%s]"),
-                  persisted_subkey_name,
-                  persisted_time,
+    CORE_LOG(L3, (_T("[Resending persisted pings][%Iu pings][%I64u][%d][%s]"),
+                  batch.ids.size(),
+                  batch.time_100ns,
                   request_age,
-                  persisted_ping_string));
+                  request_string));
 
     CString request_age_string;
     SafeCStringFormat(&request_age_string, _T("%d"), request_age);
     HeadersVector headers;
     headers.push_back(std::make_pair(kHeaderXRequestAge, request_age_string));
 
-    hr = SendString(is_machine, headers, persisted_ping_string);
+    if (SUCCEEDED(hr)) {
+      hr = SendString(is_machine, headers, request_string);
+    }
 
-    if (SUCCEEDED(hr) || IsPingExpired(persisted_time)) {
-      CORE_LOG(L3, (_T("[Deleting persisted ping][0x%x]"), hr));
-      VERIFY_SUCCEEDED(DeletePersistedPing(is_machine,
-                                            persisted_subkey_name));
+    // A ping which could not be sent is kept until it expires, regardless
+    // of the age of the other pings in its batch.
+    for (const auto& id : batch.ids) {
+      if (SUCCEEDED(hr) || IsPingExpired(persisted_times[id])) {
+        sent_or_expired_ids.push_back(id);
+      }
     }
   }
 
+  CORE_LOG(L3, (_T("[Deleting persisted pings][%Iu]"),
+                sent_or_expired_ids.size()));
+  VERIFY_SUCCEEDED(DeletePersistedPings(is_machine, sent_or_expired_ids));
+
+  return S_OK;
+}
+
+HRESULT Ping::BuildPersistedPingsRequestString(const PingBatch& batch,
+                                               const CString& session_id,
+                                               CString* request_string) {
+  ASSERT1(request_string);
+
+  CString request_id;
+  HRESULT hr = GetGuid(&request_id);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  const std::string request(batch.BuildRequest(
+      WideToUtf8(request_id).GetString(),
+      WideToUtf8(session_id).GetString()));
+  *request_string = Utf8ToWideChar(request.c_str(),
+                                   static_cast<uint32>(request.size()));
   return S_OK;
 }
 
@@ -64,6 +64,7 @@
 #include <atlstr.h>
 #include <utility>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "base/basictypes.h"
@@ -77,6 +78,9 @@ namespace omaha {
 
 struct CommandLineExtraArgs;
 class App;
+class GLock;
+class PingJournal;
+struct PingBatch;
 
 // Loads, builds, serializes, and sends pings. There are two ways to manipulate
 // ping instances. The simplest way is to have another entity, such as
@@ -152,10 +156,11 @@ class Ping {
   // mechanism.
   HRESULT Send(bool is_fire_and_forget);
 
-  // Persists the current Ping object to the registry.
+  // Persists the current Ping object to the persisted pings journal.
   HRESULT PersistPing();
 
-  // Sends all persisted pings. Deletes successful or expired pings.
+  // Sends all persisted pings, coalescing them in as few requests as
+  // possible. Deletes successful or expired pings.
   static HRESULT SendPersistedPings(bool is_machine);
 
   // Sends a ping string to the server, in-process. The ping_string must be web
@@ -177,6 +182,7 @@ class Ping {
   FRIEND_TEST(PingTest, PersistPing);
   FRIEND_TEST(PingTest, PersistPing_Load_Delete);
   FRIEND_TEST(PingTest, PersistAndSendPersistedPings);
+  FRIEND_TEST(PingTest, BuildPersistedPingsRequestString);
   FRIEND_TEST(PingTest, DISABLED_SendUsingGoogleUpdate);
   FRIEND_TEST(PersistedPingsTest, AddPingEvents);
 
@@ -186,7 +192,10 @@ class Ping {
   static const TCHAR* const kRegKeyPersistedPings;
   static const TCHAR* const kRegValuePersistedPingTime;
   static const TCHAR* const kRegValuePersistedPingString;
+  static const TCHAR* const kPersistedPingsJournalFileName;
   static const time64 kPersistedPingExpiry100ns;
+  static const size_t kMaxPersistedPingsPerRequest;
+  static const size_t kMaxPersistedPingsRequestBytes;
 
   void Initialize(bool is_machine,
                   const CString& session_id,
@@ -206,15 +215,32 @@ class Ping {
   xml::request::App BuildOmahaApp(const CString& version,
                                   const CString& next_version) const;
 
-  // Persistent Ping utility functions.
+  // Persistent Ping utility functions. The pings are persisted in a journal
+  // file. Older versions persisted each ping in a registry subkey, and these
+  // pings are moved to the journal the next time the pings are loaded.
   static CString GetPersistedPingsRegPath(bool is_machine);
+  static CString GetPersistedPingsJournalPath(bool is_machine);
+  static HRESULT InitializePersistedPingsLock(bool is_machine, GLock* lock);
+  static HRESULT LoadPingJournal(bool is_machine,
+                                 std::unique_ptr<PingJournal>* journal);
+  static HRESULT MigrateLegacyPersistedPings(bool is_machine,
+                                             PingJournal* journal);
   static HRESULT LoadPersistedPings(bool is_machine,
                                     PingsVector* persisted_pings);
   static bool IsPingExpired(time64 persisted_time);
   static HRESULT DeletePersistedPing(bool is_machine,
-                                     const CString& persisted_subkey_name);
+                                     const CString& persisted_ping_id);
+  static HRESULT DeletePersistedPings(bool is_machine,
+                                      const std::vector<std::string>& ids);
   void DeletePersistedPingOnSuccess(const HRESULT& hr);
-  CString GetPersistedPingRegPath();
+
+  // Builds the request which resends the persisted pings of |batch|. Merged
+  // pings are sent in a new request, with a new request id, |session_id|, and
+  // the other attributes they were persisted with. A single ping is sent as
+  // it was persisted.
+  static HRESULT BuildPersistedPingsRequestString(const PingBatch& batch,
+                                                  const CString& session_id,
+                                                  CString* request_string);
 
   // Sends a string to the server.
   static HRESULT SendString(bool is_machine,
@@ -224,7 +250,7 @@ class Ping {
   bool is_machine_;
 
   // The request id is the unique key that is sent out in Ping requests to the
-  // Omaha server. Persisted Pings are also stored in the registry under this
+  // Omaha server. Persisted Pings are also stored in the journal under this
   // unique key.
   CString request_id_;
 
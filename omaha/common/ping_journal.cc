@@ -0,0 +1,600 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/common/ping_journal.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <set>
+#include <system_error>
+#include <tuple>
+#include <utility>
+
+#include "omaha/base/record_io.h"
+
+namespace omaha {
+
+namespace {
+
+std::string MakeAddRecord(const PingJournal::Entry& entry) {
+  std::string payload;
+  AppendUint(entry.time_100ns, 8, &payload);
+  AppendString(entry.id, &payload);
+  payload.append(entry.request);
+  return MakeRecord(PingJournal::kRecordAdd, payload);
+}
+
+size_t AddRecordSize(const PingJournal::Entry& entry) {
+  return RecordSize(8 + 2 + entry.id.size() + entry.request.size());
+}
+
+std::string MakeRemoveRecord(const std::vector<std::string>& ids) {
+  std::string payload;
+  AppendUint(ids.size(), 4, &payload);
+  for (const auto& id : ids) {
+    AppendString(id, &payload);
+  }
+  return MakeRecord(PingJournal::kRecordRemove, payload);
+}
+
+}  // namespace
+
+const char PingJournal::kMagic[4] = {'O', 'P', 'J', '1'};
+
+PingJournal::FileStorage::FileStorage(const std::filesystem::path& path)
+    : path_(path) {
+}
+
+PingJournal::FileStorage::~FileStorage() {
+}
+
+bool PingJournal::FileStorage::Read(std::string* contents) {
+  contents->clear();
+
+  std::error_code error;
+  if (!std::filesystem::exists(path_, error)) {
+    return !error;
+  }
+
+  std::ifstream file(path_, std::ios::in | std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  contents->assign(std::istreambuf_iterator<char>(file),
+                   std::istreambuf_iterator<char>());
+  return !file.bad();
+}
+
+bool PingJournal::FileStorage::Append(const std::string& data) {
+  std::ofstream file(path_,
+                     std::ios::out | std::ios::binary | std::ios::app);
+  if (!file) {
+    return false;
+  }
+  file.write(data.data(), data.size());
+  file.flush();
+  return file.good();
+}
+
+bool PingJournal::FileStorage::Replace(const std::string& contents) {
+  std::error_code error;
+  if (contents.empty()) {
+    std::filesystem::remove(path_, error);
+    return !error;
+  }
+
+  std::filesystem::path temp_path(path_);
+  temp_path += ".tmp";
+  {
+    std::ofstream file(temp_path,
+                       std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file) {
+      return false;
+    }
+    file.write(contents.data(), contents.size());
+    file.flush();
+    if (!file.good()) {
+      file.close();
+      std::filesystem::remove(temp_path, error);
+      return false;
+    }
+  }
+
+  std::filesystem::rename(temp_path, path_, error);
+  if (error) {
+    std::filesystem::remove(temp_path, error);
+    return false;
+  }
+  return true;
+}
+
+PingJournal::PingJournal(std::unique_ptr<Storage> storage)
+    : storage_(std::move(storage)),
+      size_bytes_(0),
+      has_damaged_tail_(false) {
+}
+
+PingJournal::~PingJournal() {
+}
+
+bool PingJournal::Load() {
+  entries_.clear();
+  size_bytes_ = 0;
+  has_damaged_tail_ = false;
+
+  std::string contents;
+  if (!storage_->Read(&contents)) {
+    return false;
+  }
+
+  size_bytes_ = contents.size();
+  has_damaged_tail_ = !Replay(contents);
+  return true;
+}
+
+bool PingJournal::Replay(const std::string& contents) {
+  if (contents.empty()) {
+    return true;
+  }
+  if (contents.size() < sizeof(kMagic) ||
+      memcmp(contents.data(), kMagic, sizeof(kMagic)) != 0) {
+    return false;
+  }
+
+  size_t pos = sizeof(kMagic);
+  while (pos != contents.size()) {
+    uint8_t type = 0;
+    const char* payload_data = NULL;
+    size_t payload_size = 0;
+    if (!ReadRecord(contents.data() + pos, contents.size() - pos,
+                    &type, &payload_data, &payload_size)) {
+      return false;
+    }
+
+    RecordReader payload(payload_data, payload_size);
+    if (type == kRecordAdd) {
+      Entry entry;
+      if (!payload.ReadUint(8, &entry.time_100ns) ||
+          !payload.ReadString(&entry.id) || entry.id.empty() ||
+          !payload.ReadBytes(payload.remaining(), &entry.request)) {
+        return false;
+      }
+      RemoveEntries(std::vector<std::string>(1, entry.id));
+      entries_.push_back(std::move(entry));
+    } else if (type == kRecordRemove) {
+      uint64_t count = 0;
+      if (!payload.ReadUint(4, &count)) {
+        return false;
+      }
+      std::vector<std::string> ids;
+      for (uint64_t i = 0; i != count; ++i) {
+        std::string id;
+        if (!payload.ReadString(&id) || id.empty()) {
+          return false;
+        }
+        ids.push_back(std::move(id));
+      }
+      RemoveEntries(ids);
+    } else {
+      return false;
+    }
+
+    pos += RecordSize(payload_size);
+  }
+
+  return true;
+}
+
+bool PingJournal::Add(const Entry& entry) {
+  if (entry.id.empty() || entry.id.size() > kMaxIdLength) {
+    return false;
+  }
+
+  RemoveEntries(std::vector<std::string>(1, entry.id));
+  entries_.push_back(entry);
+  return AppendRecord(MakeAddRecord(entry));
+}
+
+bool PingJournal::Remove(const std::vector<std::string>& ids) {
+  if (!RemoveEntries(ids)) {
+    return true;
+  }
+
+  // Removing the last ping truncates the journal instead of growing it.
+  if (entries_.empty()) {
+    return Compact();
+  }
+  return AppendRecord(MakeRemoveRecord(ids));
+}
+
+bool PingJournal::AppendRecord(const std::string& record) {
+  if (has_damaged_tail_) {
+    return Compact();
+  }
+
+  std::string data;
+  if (!size_bytes_) {
+    data.assign(kMagic, sizeof(kMagic));
+  }
+  data.append(record);
+  if (!storage_->Append(data)) {
+    return false;
+  }
+  size_bytes_ += data.size();
+  return MaybeCompact();
+}
+
+bool PingJournal::Compact() {
+  std::string contents;
+  if (!entries_.empty()) {
+    contents.assign(kMagic, sizeof(kMagic));
+    for (const auto& entry : entries_) {
+      contents.append(MakeAddRecord(entry));
+    }
+  }
+
+  if (!storage_->Replace(contents)) {
+    return false;
+  }
+  size_bytes_ = contents.size();
+  has_damaged_tail_ = false;
+  return true;
+}
+
+bool PingJournal::MaybeCompact() {
+  const size_t dead = dead_bytes();
+  if (dead < kMinCompactionBytes || dead <= size_bytes_ - dead) {
+    return true;
+  }
+  return Compact();
+}
+
+size_t PingJournal::dead_bytes() const {
+  size_t live_bytes = entries_.empty() ? 0 : sizeof(kMagic);
+  for (const auto& entry : entries_) {
+    live_bytes += AddRecordSize(entry);
+  }
+  return size_bytes_ > live_bytes ? size_bytes_ - live_bytes : 0;
+}
+
+size_t PingJournal::RemoveEntries(const std::vector<std::string>& ids) {
+  if (ids.empty() || entries_.empty()) {
+    return 0;
+  }
+
+  const std::set<std::string> removed(ids.begin(), ids.end());
+  const size_t size = entries_.size();
+  entries_.erase(std::remove_if(entries_.begin(), entries_.end(),
+                                [&removed](const Entry& entry) {
+                                  return removed.count(entry.id) != 0;
+                                }),
+                 entries_.end());
+  return size - entries_.size();
+}
+
+namespace {
+
+const char kRequestStartTag[] = "<request";
+const char kRequestEndTag[] = "</request>";
+const char kAppStartTag[] = "<app";
+const char kAppEndTag[] = "</app>";
+const char kProtocolAttribute[] = "protocol";
+const char kRequestIdAttribute[] = "requestid";
+const char kSessionIdAttribute[] = "sessionid";
+const char kAppIdAttribute[] = "appid";
+
+// A persisted ping split in its key and its <app> elements.
+struct ParsedPing {
+  PingBatch::Key key;
+  std::vector<std::string> apps;
+  std::set<std::string> app_ids;
+
+  // The size of the request without its <app> elements.
+  size_t envelope_size = 0;
+};
+
+// Returns the position of the start tag |tag| at or after |pos|, or npos.
+size_t FindStartTag(const std::string& request, const char* tag, size_t pos) {
+  const size_t tag_length = strlen(tag);
+  for (;;) {
+    pos = request.find(tag, pos);
+    if (pos == std::string::npos) {
+      return pos;
+    }
+    const size_t next = pos + tag_length;
+    if (next < request.size() &&
+        (request[next] == ' ' || request[next] == '>' ||
+         request[next] == '/')) {
+      return pos;
+    }
+    ++pos;
+  }
+}
+
+// Replaces the predefined XML entities of |value| by their characters.
+std::string UnescapeXml(const std::string& value) {
+  static const struct {
+    const char* entity;
+    char character;
+  } kEntities[] = {
+    {"&amp;", '&'},
+    {"&lt;", '<'},
+    {"&gt;", '>'},
+    {"&quot;", '"'},
+    {"&apos;", '\''},
+  };
+
+  std::string unescaped;
+  for (size_t pos = 0; pos < value.size(); ++pos) {
+    bool is_entity = false;
+    if (value[pos] == '&') {
+      for (const auto& entity : kEntities) {
+        if (value.compare(pos, strlen(entity.entity), entity.entity) == 0) {
+          unescaped.push_back(entity.character);
+          pos += strlen(entity.entity) - 1;
+          is_entity = true;
+          break;
+        }
+      }
+    }
+    if (!is_entity) {
+      unescaped.push_back(value[pos]);
+    }
+  }
+  return unescaped;
+}
+
+// Reads the attribute |name| of the start tag in |request| between |tag_start|
+// and |tag_end|. A missing attribute is read as an empty string.
+bool ReadAttribute(const std::string& request,
+                   size_t tag_start,
+                   size_t tag_end,
+                   const char* name,
+                   std::string* value) {
+  const std::string pattern = std::string(" ") + name + "=\"";
+  const size_t attribute = request.find(pattern, tag_start);
+  if (attribute == std::string::npos || attribute > tag_end) {
+    value->clear();
+    return true;
+  }
+  const size_t value_start = attribute + pattern.size();
+  const size_t value_end = request.find('"', value_start);
+  if (value_end == std::string::npos || value_end > tag_end) {
+    return false;
+  }
+  *value = UnescapeXml(request.substr(value_start, value_end - value_start));
+  return true;
+}
+
+// Reads the attributes of the start tag in |request| between |tag_start| and
+// |tag_end|, which is the position of its closing '>', without unescaping
+// their values.
+bool ReadAttributes(const std::string& request,
+                    size_t tag_start,
+                    size_t tag_end,
+                    std::map<std::string, std::string>* attributes) {
+  const char kWhitespace[] = " \t\r\n";
+  size_t pos = request.find_first_of(kWhitespace, tag_start);
+  for (;;) {
+    pos = request.find_first_not_of(kWhitespace, pos);
+    if (pos == std::string::npos || pos >= tag_end) {
+      return true;
+    }
+    const size_t equals = request.find('=', pos);
+    if (equals == std::string::npos || equals >= tag_end ||
+        request[equals + 1] != '"') {
+      return false;
+    }
+    const size_t value_start = equals + 2;
+    const size_t value_end = request.find('"', value_start);
+    if (value_end == std::string::npos || value_end >= tag_end) {
+      return false;
+    }
+    const std::string name(request.substr(pos, equals - pos));
+    if (name.find_first_of(kWhitespace) != std::string::npos ||
+        !attributes->insert(std::make_pair(
+            name,
+            request.substr(value_start, value_end - value_start))).second) {
+      return false;
+    }
+    pos = value_end + 1;
+  }
+}
+
+bool ParsePing(const std::string& request, ParsedPing* parsed) {
+  const size_t request_start = FindStartTag(request, kRequestStartTag, 0);
+  const size_t request_end = request.rfind(kRequestEndTag);
+  if (request_start == std::string::npos ||
+      request_end == std::string::npos ||
+      request_end < request_start ||
+      request.find_first_not_of(" \t\r\n",
+                                request_end + strlen(kRequestEndTag)) !=
+          std::string::npos) {
+    return false;
+  }
+
+  const size_t request_tag_end = request.find('>', request_start);
+  const size_t first_app = FindStartTag(request, kAppStartTag, request_start);
+  if (request_tag_end == std::string::npos ||
+      first_app == std::string::npos ||
+      request_tag_end > first_app ||
+      first_app > request_end) {
+    return false;
+  }
+
+  PingBatch::Key& key = parsed->key;
+  if (!ReadAttributes(request, request_start, request_tag_end,
+                      &key.attributes) ||
+      key.attributes[kProtocolAttribute].empty()) {
+    return false;
+  }
+  key.attributes.erase(kRequestIdAttribute);
+  key.attributes.erase(kSessionIdAttribute);
+  key.prolog = request.substr(0, request_start);
+  key.elements = request.substr(request_tag_end + 1,
+                                first_app - request_tag_end - 1);
+
+  // The <app> elements must follow each other up to the end of the request.
+  size_t apps_size = 0;
+  size_t pos = first_app;
+  while (pos != request_end) {
+    if (FindStartTag(request, kAppStartTag, pos) != pos) {
+      return false;
+    }
+    const size_t tag_end = request.find('>', pos);
+    if (tag_end == std::string::npos || tag_end > request_end) {
+      return false;
+    }
+
+    std::string app_id;
+    if (!ReadAttribute(request, pos, tag_end, kAppIdAttribute, &app_id) ||
+        app_id.empty()) {
+      return false;
+    }
+
+    size_t app_end = tag_end + 1;
+    if (request[tag_end - 1] != '/') {
+      const size_t end_tag = request.find(kAppEndTag, tag_end);
+      if (end_tag == std::string::npos || end_tag > request_end) {
+        return false;
+      }
+      app_end = end_tag + strlen(kAppEndTag);
+    }
+
+    parsed->apps.push_back(request.substr(pos, app_end - pos));
+    parsed->app_ids.insert(app_id);
+    apps_size += app_end - pos;
+
+    pos = request.find_first_not_of(" \t\r\n", app_end);
+    if (pos == std::string::npos) {
+      return false;
+    }
+  }
+
+  parsed->envelope_size = request.size() - apps_size;
+  return true;
+}
+
+struct PendingBatch {
+  PingBatch batch;
+  std::set<std::string> app_ids;
+  size_t size_bytes = 0;
+};
+
+}  // namespace
+
+bool PingBatch::Key::operator<(const Key& other) const {
+  return std::tie(prolog, attributes, elements) <
+         std::tie(other.prolog, other.attributes, other.elements);
+}
+
+std::string PingBatch::BuildRequest(const std::string& request_id,
+                                    const std::string& session_id) const {
+  if (!is_merged) {
+    return request;
+  }
+
+  std::string merged(key.prolog);
+  merged.append(kRequestStartTag);
+  std::map<std::string, std::string> attributes(key.attributes);
+  attributes[kRequestIdAttribute] = request_id;
+  attributes[kSessionIdAttribute] = session_id;
+  for (const auto& attribute : attributes) {
+    merged.append(" " + attribute.first + "=\"" + attribute.second + "\"");
+  }
+  merged.push_back('>');
+  merged.append(key.elements);
+  for (const auto& app : apps) {
+    merged.append(app);
+  }
+  merged.append(kRequestEndTag);
+  return merged;
+}
+
+std::vector<PingBatch> CoalescePings(
+    const std::vector<PingJournal::Entry>& pings,
+    size_t max_pings,
+    size_t max_bytes) {
+  std::vector<PendingBatch> pending;
+
+  // The open batch for each key, as an index in |pending|.
+  std::map<PingBatch::Key, size_t> open_batches;
+
+  for (const auto& ping : pings) {
+    ParsedPing parsed;
+    if (!ParsePing(ping.request, &parsed)) {
+      PendingBatch single;
+      single.batch.ids.push_back(ping.id);
+      single.batch.time_100ns = ping.time_100ns;
+      single.batch.request = ping.request;
+      pending.push_back(std::move(single));
+      continue;
+    }
+
+    const size_t apps_size = ping.request.size() - parsed.envelope_size;
+    const auto open = open_batches.find(parsed.key);
+    if (open != open_batches.end()) {
+      PendingBatch& batch = pending[open->second];
+      const bool has_common_app =
+          std::find_first_of(batch.app_ids.begin(), batch.app_ids.end(),
+                             parsed.app_ids.begin(), parsed.app_ids.end()) !=
+          batch.app_ids.end();
+      if (batch.batch.ids.size() < max_pings &&
+          batch.size_bytes + apps_size <= max_bytes &&
+          !has_common_app) {
+        batch.batch.ids.push_back(ping.id);
+        batch.batch.is_merged = true;
+        batch.batch.time_100ns = std::min(batch.batch.time_100ns,
+                                          ping.time_100ns);
+        batch.batch.apps.insert(batch.batch.apps.end(),
+                                parsed.apps.begin(), parsed.apps.end());
+        batch.app_ids.insert(parsed.app_ids.begin(), parsed.app_ids.end());
+        batch.size_bytes += apps_size;
+        continue;
+      }
+    }
+
+    PendingBatch batch;
+    batch.batch.ids.push_back(ping.id);
+    batch.batch.time_100ns = ping.time_100ns;
+    batch.batch.request = ping.request;
+    batch.batch.key = parsed.key;
+    batch.batch.apps = std::move(parsed.apps);
+    batch.app_ids = std::move(parsed.app_ids);
+    batch.size_bytes = ping.request.size();
+    open_batches[parsed.key] = pending.size();
+    pending.push_back(std::move(batch));
+  }
+
+  std::vector<PingBatch> batches;
+  batches.reserve(pending.size());
+  for (auto& batch : pending) {
+    // A single ping is sent as it was persisted.
+    if (batch.batch.is_merged) {
+      batch.batch.request.clear();
+    } else {
+      batch.batch.key = PingBatch::Key();
+      batch.batch.apps.clear();
+    }
+    batches.push_back(std::move(batch.batch));
+  }
+  return batches;
+}
+
+}  // namespace omaha
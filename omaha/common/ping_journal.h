@@ -0,0 +1,217 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// PingJournal stores the persisted pings in a single append-only file, so
+// that persisting a ping is one write and deleting any number of pings after
+// they are sent is one write too.
+//
+// The file starts with a magic number followed by a sequence of records:
+//   type     1 byte      kRecordAdd or kRecordRemove.
+//   length   4 bytes     Little-endian size of the payload.
+//   payload  |length|    See below.
+//   checksum 4 bytes     The first bytes of the SHA-256 of the fields above.
+// An add record contains the time of the ping in 100ns units as 8 bytes, the
+// id of the ping as a 2-byte length followed by the id, then the ping request.
+// A remove record contains a 4-byte count followed by the ids of the removed
+// pings, each of them prefixed by its 2-byte length.
+//
+// Reading the journal replays the records in order and stops at the first
+// record which is truncated or fails its checksum, for instance if the process
+// was terminated in the middle of a write. The next write rewrites the journal
+// without the damaged tail. The journal is also rewritten when the removed
+// pings take more space than the live ones, and it is truncated when no ping
+// is left.
+//
+// The journal does not lock the file; the callers serialize the access.
+//
+// This file has no platform dependencies.
+
+#ifndef OMAHA_COMMON_PING_JOURNAL_H_
+#define OMAHA_COMMON_PING_JOURNAL_H_
+
+#include <stdint.h>
+
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+
+namespace omaha {
+
+class PingJournal {
+ public:
+  // A persisted ping. The strings are UTF-8.
+  struct Entry {
+    std::string id;
+    uint64_t time_100ns = 0;
+    std::string request;
+  };
+
+  // The backing store of the journal.
+  class Storage {
+   public:
+    virtual ~Storage() {}
+
+    // Reads the whole journal. A journal which does not exist is empty.
+    virtual bool Read(std::string* contents) = 0;
+
+    // Appends |data| to the journal.
+    virtual bool Append(const std::string& data) = 0;
+
+    // Replaces the contents of the journal with |contents|. The replacement
+    // is atomic if the underlying storage supports it.
+    virtual bool Replace(const std::string& contents) = 0;
+  };
+
+  // Stores the journal in a file. Replace() writes a temporary file next to
+  // the journal, then renames it over the journal.
+  class FileStorage : public Storage {
+   public:
+    explicit FileStorage(const std::filesystem::path& path);
+    ~FileStorage() override;
+
+    bool Read(std::string* contents) override;
+    bool Append(const std::string& data) override;
+    bool Replace(const std::string& contents) override;
+
+   private:
+    const std::filesystem::path path_;
+
+    DISALLOW_COPY_AND_ASSIGN(FileStorage);
+  };
+
+  static const char kMagic[4];
+  static const uint8_t kRecordAdd = 1;
+  static const uint8_t kRecordRemove = 2;
+
+  // The maximum length of an id. Longer ids are rejected.
+  static const size_t kMaxIdLength = 0xFFFF;
+
+  // The journal is not compacted until it holds at least this many bytes of
+  // removed pings.
+  static const size_t kMinCompactionBytes = 16 * 1024;
+
+  explicit PingJournal(std::unique_ptr<Storage> storage);
+  ~PingJournal();
+
+  // Reads the journal. Must be called before the other methods, and again
+  // after another process may have written the journal.
+  bool Load();
+
+  // Appends a ping. A ping with the same id as an existing ping replaces it.
+  bool Add(const Entry& entry);
+
+  // Removes the pings in |ids| with a single write. Unknown ids are ignored.
+  bool Remove(const std::vector<std::string>& ids);
+
+  // Rewrites the journal with the live pings only.
+  bool Compact();
+
+  // Returns the live pings, in the order in which they were added.
+  const std::vector<Entry>& entries() const { return entries_; }
+
+  // Returns the number of bytes of the journal taken by removed pings and by
+  // a damaged tail, if any.
+  size_t dead_bytes() const;
+
+  size_t size_bytes() const { return size_bytes_; }
+
+ private:
+  // Appends |record|, or rewrites the journal if it has a damaged tail.
+  bool AppendRecord(const std::string& record);
+
+  // Replays the records of |contents|. Returns false at the first damaged
+  // record.
+  bool Replay(const std::string& contents);
+
+  // Compacts the journal if the removed pings take too much space.
+  bool MaybeCompact();
+
+  // Removes the pings in |ids| from |entries_|. Returns the number of pings
+  // removed.
+  size_t RemoveEntries(const std::vector<std::string>& ids);
+
+  std::unique_ptr<Storage> storage_;
+  std::vector<Entry> entries_;
+  size_t size_bytes_;
+  bool has_damaged_tail_;
+
+  DISALLOW_COPY_AND_ASSIGN(PingJournal);
+};
+
+// A request which carries one or more persisted pings.
+struct PingBatch {
+  // What the pings of a batch have in common: their whole request except the
+  // request and session ids and the <app> elements. The strings are UTF-8 and
+  // as they appear in the requests, escaped.
+  struct Key {
+    // The text before the <request> element, such as the XML declaration.
+    std::string prolog;
+
+    // The attributes of the <request> element by name, except "requestid" and
+    // "sessionid".
+    std::map<std::string, std::string> attributes;
+
+    // The elements of the request before its first <app> element, such as
+    // <hw> and <os>.
+    std::string elements;
+
+    bool operator<(const Key& other) const;
+  };
+
+  // Returns the request which carries the pings of the batch. A merged batch
+  // is sent with |request_id| and |session_id|, which must not need escaping,
+  // and the other attributes of the pings. Otherwise, the single ping of the
+  // batch is sent as it was persisted.
+  std::string BuildRequest(const std::string& request_id,
+                           const std::string& session_id) const;
+
+  // The ids of the pings in the batch.
+  std::vector<std::string> ids;
+
+  // The time of the oldest ping in the batch, used for the request age.
+  uint64_t time_100ns = 0;
+
+  // True if the batch merges several pings. The request is then built from
+  // |key| and |apps|. Otherwise, the batch has a single ping, which is sent
+  // as it was persisted in |request|.
+  bool is_merged = false;
+  Key key;
+
+  // The serialized <app> elements of the pings.
+  std::vector<std::string> apps;
+
+  std::string request;
+};
+
+// Merges the persisted pings into as few requests as possible. Pings are
+// merged when they have the same key, regardless of the session and request
+// ids they were sent with. A batch never has two <app> elements for the same
+// app, and never exceeds |max_pings| pings or |max_bytes| bytes, counting the
+// size of its first ping without its <app> elements plus the size of all the
+// <app> elements, unless it has a single ping. Pings which are not well-formed
+// requests, and pings which are not merged with other pings, are sent as they
+// were persisted.
+std::vector<PingBatch> CoalescePings(
+    const std::vector<PingJournal::Entry>& pings,
+    size_t max_pings,
+    size_t max_bytes);
+
+}  // namespace omaha
+
+#endif  // OMAHA_COMMON_PING_JOURNAL_H_
@@ -0,0 +1,460 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/common/ping_journal.h"
+
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace omaha {
+
+namespace {
+
+// Keeps the journal in memory and counts the writes.
+class MemoryStorage : public PingJournal::Storage {
+ public:
+  explicit MemoryStorage(std::string* contents)
+      : contents_(contents), num_appends_(0), num_replaces_(0) {}
+
+  bool Read(std::string* contents) override {
+    *contents = *contents_;
+    return true;
+  }
+
+  bool Append(const std::string& data) override {
+    ++num_appends_;
+    contents_->append(data);
+    return true;
+  }
+
+  bool Replace(const std::string& contents) override {
+    ++num_replaces_;
+    *contents_ = contents;
+    return true;
+  }
+
+  int num_appends() const { return num_appends_; }
+  int num_replaces() const { return num_replaces_; }
+
+ private:
+  std::string* contents_;
+  int num_appends_;
+  int num_replaces_;
+
+  DISALLOW_COPY_AND_ASSIGN(MemoryStorage);
+};
+
+PingJournal::Entry MakeEntry(const std::string& id,
+                             uint64_t time_100ns,
+                             const std::string& request) {
+  PingJournal::Entry entry;
+  entry.id = id;
+  entry.time_100ns = time_100ns;
+  entry.request = request;
+  return entry;
+}
+
+std::string MakeRequest(const std::string& request_id,
+                        const std::string& session_id,
+                        const std::string& app_id,
+                        int event_type,
+                        const std::string& os_version = "10.0.19045.0",
+                        const std::string& updater_version = "1.3.36.1") {
+  return "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+         "<request protocol=\"3.0\" updaterversion=\"" + updater_version +
+         "\" ismachine=\"1\" sessionid=\"" + session_id +
+         "\" requestid=\"" + request_id + "\">"
+         "<os platform=\"win\" version=\"" + os_version + "\" sp=\"\" "
+         "arch=\"x64\"/>"
+         "<app appid=\"" + app_id + "\" version=\"1.0\">"
+         "<event eventtype=\"" + std::to_string(event_type) + "\"/></app>"
+         "</request>";
+}
+
+std::string MakeApp(const std::string& app_id, int event_type) {
+  return "<app appid=\"" + app_id + "\" version=\"1.0\">"
+         "<event eventtype=\"" + std::to_string(event_type) + "\"/></app>";
+}
+
+}  // namespace
+
+class PingJournalTest : public testing::Test {
+ protected:
+  PingJournalTest() : storage_(nullptr) {}
+
+  virtual void SetUp() {
+    Reopen();
+  }
+
+  // Creates a new journal over the same contents, as another process would.
+  void Reopen() {
+    storage_ = new MemoryStorage(&contents_);
+    journal_.reset(new PingJournal(std::unique_ptr<MemoryStorage>(storage_)));
+    ASSERT_TRUE(journal_->Load());
+  }
+
+  std::string contents_;
+  MemoryStorage* storage_;
+  std::unique_ptr<PingJournal> journal_;
+};
+
+TEST_F(PingJournalTest, Empty) {
+  EXPECT_TRUE(journal_->entries().empty());
+  EXPECT_EQ(0, journal_->size_bytes());
+  EXPECT_EQ(0, journal_->dead_bytes());
+}
+
+TEST_F(PingJournalTest, AddAndReplay) {
+  EXPECT_TRUE(journal_->Add(MakeEntry("id1", 10, "ping 1")));
+  EXPECT_TRUE(journal_->Add(MakeEntry("id2", 20, std::string("ping\0 2", 7))));
+  EXPECT_EQ(2, storage_->num_appends());
+  EXPECT_EQ(0, journal_->dead_bytes());
+
+  Reopen();
+  ASSERT_EQ(2, journal_->entries().size());
+  EXPECT_EQ("id1", journal_->entries()[0].id);
+  EXPECT_EQ(10, journal_->entries()[0].time_100ns);
+  EXPECT_EQ("ping 1", journal_->entries()[0].request);
+  EXPECT_EQ("id2", journal_->entries()[1].id);
+  EXPECT_EQ(20, journal_->entries()[1].time_100ns);
+  EXPECT_EQ(std::string("ping\0 2", 7), journal_->entries()[1].request);
+}
+
+TEST_F(PingJournalTest, AddReplacesSameId) {
+  EXPECT_TRUE(journal_->Add(MakeEntry("id1", 10, "old")));
+  EXPECT_TRUE(journal_->Add(MakeEntry("id1", 20, "new")));
+
+  Reopen();
+  ASSERT_EQ(1, journal_->entries().size());
+  EXPECT_EQ("new", journal_->entries()[0].request);
+  EXPECT_LT(0, journal_->dead_bytes());
+}
+
+TEST_F(PingJournalTest, AddInvalidId) {
+  EXPECT_FALSE(journal_->Add(MakeEntry("", 10, "ping")));
+  EXPECT_FALSE(journal_->Add(
+      MakeEntry(std::string(PingJournal::kMaxIdLength + 1, 'a'), 10, "ping")));
+  EXPECT_TRUE(contents_.empty());
+}
+
+TEST_F(PingJournalTest, RemoveIsOneWrite) {
+  for (int i = 0; i != 100; ++i) {
+    EXPECT_TRUE(journal_->Add(MakeEntry(std::to_string(i), i, "ping")));
+  }
+
+  std::vector<std::string> ids;
+  for (int i = 0; i != 100; i += 2) {
+    ids.push_back(std::to_string(i));
+  }
+  ids.push_back("unknown");
+  const int num_appends = storage_->num_appends();
+  EXPECT_TRUE(journal_->Remove(ids));
+  EXPECT_EQ(num_appends + 1, storage_->num_appends());
+  EXPECT_EQ(0, storage_->num_replaces());
+
+  Reopen();
+  ASSERT_EQ(50, journal_->entries().size());
+  for (int i = 0; i != 50; ++i) {
+    EXPECT_EQ(std::to_string(2 * i + 1), journal_->entries()[i].id);
+  }
+}
+
+TEST_F(PingJournalTest, RemoveUnknownDoesNotWrite) {
+  EXPECT_TRUE(journal_->Add(MakeEntry("id1", 10, "ping")));
+  const std::string contents(contents_);
+  EXPECT_TRUE(journal_->Remove(std::vector<std::string>(1, "id2")));
+  EXPECT_EQ(contents, contents_);
+}
+
+TEST_F(PingJournalTest, RemoveAllTruncates) {
+  EXPECT_TRUE(journal_->Add(MakeEntry("id1", 10, "ping 1")));
+  EXPECT_TRUE(journal_->Add(MakeEntry("id2", 20, "ping 2")));
+  EXPECT_TRUE(journal_->Remove({"id1", "id2"}));
+  EXPECT_TRUE(contents_.empty());
+  EXPECT_EQ(0, journal_->size_bytes());
+
+  // The magic number is written again with the next ping.
+  EXPECT_TRUE(journal_->Add(MakeEntry("id3", 30, "ping 3")));
+  Reopen();
+  ASSERT_EQ(1, journal_->entries().size());
+  EXPECT_EQ("id3", journal_->entries()[0].id);
+}
+
+TEST_F(PingJournalTest, CompactsWhenMostlyDead) {
+  const std::string request(1024, 'x');
+  for (int i = 0; i != 40; ++i) {
+    EXPECT_TRUE(journal_->Add(MakeEntry(std::to_string(i), i, request)));
+  }
+  EXPECT_TRUE(journal_->Remove({"0", "1", "2", "3", "4", "5", "6", "7"}));
+  EXPECT_EQ(0, storage_->num_replaces());
+
+  std::vector<std::string> ids;
+  for (int i = 8; i != 30; ++i) {
+    ids.push_back(std::to_string(i));
+  }
+  EXPECT_TRUE(journal_->Remove(ids));
+  EXPECT_EQ(1, storage_->num_replaces());
+  EXPECT_EQ(0, journal_->dead_bytes());
+  EXPECT_EQ(contents_.size(), journal_->size_bytes());
+
+  Reopen();
+  ASSERT_EQ(10, journal_->entries().size());
+  EXPECT_EQ("30", journal_->entries()[0].id);
+  EXPECT_EQ(0, journal_->dead_bytes());
+}
+
+TEST_F(PingJournalTest, TornTailIsDropped) {
+  EXPECT_TRUE(journal_->Add(MakeEntry("id1", 10, "ping 1")));
+  const size_t good_size = contents_.size();
+  EXPECT_TRUE(journal_->Add(MakeEntry("id2", 20, "ping 2")));
+
+  // Every truncation of the last record loses that record only.
+  const std::string full(contents_);
+  for (size_t size = good_size; size != full.size(); ++size) {
+    contents_ = full.substr(0, size);
+    Reopen();
+    ASSERT_EQ(1, journal_->entries().size());
+    EXPECT_EQ("id1", journal_->entries()[0].id);
+    EXPECT_EQ(size - good_size, journal_->dead_bytes());
+  }
+
+  // The next write drops the damaged tail.
+  EXPECT_TRUE(journal_->Add(MakeEntry("id3", 30, "ping 3")));
+  EXPECT_EQ(1, storage_->num_replaces());
+  Reopen();
+  ASSERT_EQ(2, journal_->entries().size());
+  EXPECT_EQ("id1", journal_->entries()[0].id);
+  EXPECT_EQ("id3", journal_->entries()[1].id);
+}
+
+TEST_F(PingJournalTest, CorruptRecordStopsReplay) {
+  EXPECT_TRUE(journal_->Add(MakeEntry("id1", 10, "ping 1")));
+  const size_t good_size = contents_.size();
+  EXPECT_TRUE(journal_->Add(MakeEntry("id2", 20, "ping 2")));
+  EXPECT_TRUE(journal_->Add(MakeEntry("id3", 30, "ping 3")));
+
+  // Flips a byte of the request of the second ping.
+  contents_[good_size + 20] ^= 0x01;
+  Reopen();
+  ASSERT_EQ(1, journal_->entries().size());
+  EXPECT_EQ("id1", journal_->entries()[0].id);
+}
+
+TEST_F(PingJournalTest, BadMagic) {
+  contents_ = "garbage";
+  Reopen();
+  EXPECT_TRUE(journal_->entries().empty());
+  EXPECT_EQ(contents_.size(), journal_->dead_bytes());
+
+  EXPECT_TRUE(journal_->Add(MakeEntry("id1", 10, "ping 1")));
+  Reopen();
+  ASSERT_EQ(1, journal_->entries().size());
+  EXPECT_EQ(0, journal_->dead_bytes());
+}
+
+TEST(PingJournalFileStorageTest, ReadAppendReplace) {
+  const std::filesystem::path path =
+      std::filesystem::temp_directory_path() /
+      ("ping_journal_unittest_" +
+       std::to_string(reinterpret_cast<uintptr_t>(&path)));
+  std::filesystem::remove(path);
+
+  {
+    PingJournal journal(std::make_unique<PingJournal::FileStorage>(path));
+    ASSERT_TRUE(journal.Load());
+    EXPECT_TRUE(journal.entries().empty());
+    EXPECT_TRUE(journal.Add(MakeEntry("id1", 10, "ping 1")));
+    EXPECT_TRUE(journal.Add(MakeEntry("id2", 20, "ping 2")));
+    EXPECT_EQ(journal.size_bytes(), std::filesystem::file_size(path));
+  }
+
+  {
+    PingJournal journal(std::make_unique<PingJournal::FileStorage>(path));
+    ASSERT_TRUE(journal.Load());
+    ASSERT_EQ(2, journal.entries().size());
+    EXPECT_TRUE(journal.Remove({"id1"}));
+    EXPECT_TRUE(journal.Compact());
+    EXPECT_EQ(journal.size_bytes(), std::filesystem::file_size(path));
+  }
+
+  {
+    PingJournal journal(std::make_unique<PingJournal::FileStorage>(path));
+    ASSERT_TRUE(journal.Load());
+    ASSERT_EQ(1, journal.entries().size());
+    EXPECT_EQ("id2", journal.entries()[0].id);
+    EXPECT_TRUE(journal.Remove({"id2"}));
+  }
+
+  EXPECT_FALSE(std::filesystem::exists(path));
+}
+
+TEST(CoalescePingsTest, MergesPingsOfDifferentSessions) {
+  std::vector<PingJournal::Entry> pings;
+  pings.push_back(MakeEntry("r1", 30, MakeRequest("r1", "s1", "{A}", 2)));
+  pings.push_back(MakeEntry("r2", 10, MakeRequest("r2", "s2", "{B}", 3)));
+  pings.push_back(MakeEntry("r3", 20, MakeRequest("r3", "s1", "{A}", 2)));
+
+  const std::vector<PingBatch> batches = CoalescePings(pings, 10, 100000);
+  ASSERT_EQ(2, batches.size());
+
+  EXPECT_EQ(std::vector<std::string>({"r1", "r2"}), batches[0].ids);
+  EXPECT_EQ(10, batches[0].time_100ns);
+  EXPECT_TRUE(batches[0].is_merged);
+  EXPECT_EQ("<?xml version=\"1.0\" encoding=\"UTF-8\"?>",
+            batches[0].key.prolog);
+  EXPECT_EQ((std::map<std::string, std::string>({{"ismachine", "1"},
+                                                 {"protocol", "3.0"},
+                                                 {"updaterversion",
+                                                  "1.3.36.1"}})),
+            batches[0].key.attributes);
+  EXPECT_EQ("<os platform=\"win\" version=\"10.0.19045.0\" sp=\"\" "
+            "arch=\"x64\"/>",
+            batches[0].key.elements);
+  EXPECT_EQ(std::vector<std::string>({MakeApp("{A}", 2), MakeApp("{B}", 3)}),
+            batches[0].apps);
+  EXPECT_EQ("<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+            "<request ismachine=\"1\" protocol=\"3.0\" requestid=\"r9\" "
+            "sessionid=\"s9\" updaterversion=\"1.3.36.1\">"
+            "<os platform=\"win\" version=\"10.0.19045.0\" sp=\"\" "
+            "arch=\"x64\"/>" + MakeApp("{A}", 2) + MakeApp("{B}", 3) +
+            "</request>",
+            batches[0].BuildRequest("r9", "s9"));
+
+  // A ping which is not merged is sent with its own request and session ids.
+  EXPECT_EQ(std::vector<std::string>({"r3"}), batches[1].ids);
+  EXPECT_EQ(20, batches[1].time_100ns);
+  EXPECT_FALSE(batches[1].is_merged);
+  EXPECT_EQ(pings[2].request, batches[1].request);
+  EXPECT_EQ(pings[2].request, batches[1].BuildRequest("r9", "s9"));
+}
+
+TEST(CoalescePingsTest, DoesNotMergeDifferentKeys) {
+  std::vector<PingJournal::Entry> pings;
+  pings.push_back(MakeEntry("r1", 10, MakeRequest("r1", "s1", "{A}", 2)));
+  pings.push_back(
+      MakeEntry("r2", 20, MakeRequest("r2", "s1", "{B}", 2, "6.1.7601.0")));
+  pings.push_back(MakeEntry("r3", 30, MakeRequest("r3", "s2", "{C}", 2)));
+  pings.push_back(MakeEntry("r4", 40, MakeRequest("r4", "s2", "{D}", 2,
+                                                  "10.0.19045.0",
+                                                  "1.3.37.0")));
+
+  const std::vector<PingBatch> batches = CoalescePings(pings, 10, 100000);
+  ASSERT_EQ(3, batches.size());
+  EXPECT_EQ(std::vector<std::string>({"r1", "r3"}), batches[0].ids);
+  EXPECT_EQ(std::vector<std::string>({"r2"}), batches[1].ids);
+  EXPECT_EQ(pings[1].request, batches[1].request);
+  EXPECT_EQ(std::vector<std::string>({"r4"}), batches[2].ids);
+  EXPECT_EQ(pings[3].request, batches[2].request);
+}
+
+TEST(CoalescePingsTest, DoesNotMergeTheSameApp) {
+  std::vector<PingJournal::Entry> pings;
+  pings.push_back(MakeEntry("r1", 10, MakeRequest("r1", "s1", "{A}", 2)));
+  pings.push_back(MakeEntry("r2", 20, MakeRequest("r2", "s1", "{A}", 3)));
+  pings.push_back(MakeEntry("r3", 30, MakeRequest("r3", "s1", "{B}", 3)));
+
+  const std::vector<PingBatch> batches = CoalescePings(pings, 10, 100000);
+  ASSERT_EQ(2, batches.size());
+  EXPECT_EQ(std::vector<std::string>({"r1"}), batches[0].ids);
+  EXPECT_EQ(std::vector<std::string>({"r2", "r3"}), batches[1].ids);
+}
+
+TEST(CoalescePingsTest, Limits) {
+  std::vector<PingJournal::Entry> pings;
+  for (int i = 0; i != 5; ++i) {
+    const std::string id("r" + std::to_string(i));
+    const std::string app_id("{" + std::to_string(i) + "}");
+    pings.push_back(MakeEntry(id, i, MakeRequest(id, "s1", app_id, 2)));
+  }
+
+  std::vector<PingBatch> batches = CoalescePings(pings, 2, 100000);
+  ASSERT_EQ(3, batches.size());
+  EXPECT_EQ(2, batches[0].ids.size());
+  EXPECT_EQ(2, batches[1].ids.size());
+  EXPECT_EQ(1, batches[2].ids.size());
+
+  // A ping larger than the limit is sent on its own.
+  batches = CoalescePings(pings, 10, 10);
+  ASSERT_EQ(5, batches.size());
+  for (size_t i = 0; i != batches.size(); ++i) {
+    EXPECT_EQ(std::vector<std::string>(1, pings[i].id), batches[i].ids);
+  }
+
+  const size_t two_pings_size =
+      pings[0].request.size() + MakeApp("{1}", 2).size();
+  batches = CoalescePings(pings, 10, two_pings_size);
+  ASSERT_EQ(3, batches.size());
+  EXPECT_EQ(2, batches[0].ids.size());
+  batches = CoalescePings(pings, 10, two_pings_size - 1);
+  ASSERT_EQ(5, batches.size());
+}
+
+TEST(CoalescePingsTest, AttributesAreKeptEscaped) {
+  std::vector<PingJournal::Entry> pings;
+  pings.push_back(MakeEntry("r1", 10,
+                            MakeRequest("r1", "s1", "{A}", 2, "1&amp;2&lt;")));
+  pings.push_back(MakeEntry("r2", 20,
+                            MakeRequest("r2", "s1", "{B}", 2, "1&amp;2&lt;",
+                                        "1&amp;2")));
+  pings.push_back(MakeEntry("r3", 30,
+                            MakeRequest("r3", "s1", "{C}", 2, "1&amp;2&lt;",
+                                        "1&amp;2")));
+
+  const std::vector<PingBatch> batches = CoalescePings(pings, 10, 100000);
+  ASSERT_EQ(2, batches.size());
+  EXPECT_EQ(std::vector<std::string>({"r2", "r3"}), batches[1].ids);
+  EXPECT_EQ("1&amp;2", batches[1].key.attributes.at("updaterversion"));
+  const std::string request(batches[1].BuildRequest("r9", "s9"));
+  EXPECT_NE(std::string::npos, request.find(" updaterversion=\"1&amp;2\""));
+  EXPECT_NE(std::string::npos, request.find(" version=\"1&amp;2&lt;\""));
+}
+
+TEST(CoalescePingsTest, MalformedPingsAreSentAsIs) {
+  const char kOs[] = "<os platform=\"win\"/>";
+  std::vector<PingJournal::Entry> pings;
+  pings.push_back(MakeEntry("r1", 10, "not a request"));
+  pings.push_back(MakeEntry("r2", 20, "<request protocol=\"3.0\">" +
+                                      std::string(kOs) + "</request>"));
+  pings.push_back(MakeEntry("r3", 30, "<request protocol=\"3.0\">" +
+                                      std::string(kOs) +
+                                      "<app/></request>"));
+  pings.push_back(MakeEntry("r4", 40, "<request protocol=\"3.0\">" +
+                                      std::string(kOs) +
+                                      "<app appid=\"{A}\"></app>"));
+  pings.push_back(MakeEntry("r5", 50, "<request>" + std::string(kOs) +
+                                      "<app appid=\"{A}\"/></request>"));
+  pings.push_back(MakeEntry("r6", 60, "<request protocol=\"3.0\" "
+                                      "protocol=\"3.0\">" +
+                                      std::string(kOs) +
+                                      "<app appid=\"{A}\"/></request>"));
+  pings.push_back(MakeEntry("r7", 70, "<request protocol=\"3.0\">" +
+                                      std::string(kOs) +
+                                      "<app appid=\"{A}\"/>text</request>"));
+
+  const std::vector<PingBatch> batches = CoalescePings(pings, 10, 100000);
+  ASSERT_EQ(pings.size(), batches.size());
+  for (size_t i = 0; i != batches.size(); ++i) {
+    EXPECT_EQ(std::vector<std::string>(1, pings[i].id), batches[i].ids);
+    EXPECT_FALSE(batches[i].is_merged);
+    EXPECT_EQ(pings[i].request, batches[i].request);
+  }
+}
+
+}  // namespace omaha
@@ -18,25 +18,38 @@
 #include "omaha/base/file.h"
 #include "omaha/base/logging.h"
 #include "omaha/base/omaha_version.h"
+#include "omaha/base/path.h"
 #include "omaha/base/string.h"
 #include "omaha/base/utils.h"
 #include "omaha/common/command_line.h"
 #include "omaha/common/config_manager.h"
 #include "omaha/common/goopdate_utils.h"
 #include "omaha/common/ping.h"
+#include "omaha/common/ping_journal.h"
 #include "omaha/goopdate/app_unittest_base.h"
 #include "omaha/testing/unit_test.h"
 
 namespace omaha {
 
+namespace {
+
+void DeletePersistedPings() {
+  RegKey::DeleteKey(USER_REG_UPDATE _T("\\PersistedPings"));
+  ::DeleteFile(ConcatenatePath(
+      ConfigManager::Instance()->GetUserGoopdateInstallDir(),
+      _T("PersistedPings.dat")));
+}
+
+}  // namespace
+
 class PingTest : public testing::Test {
  protected:
   virtual void SetUp() {
-    RegKey::DeleteKey(USER_REG_UPDATE _T("\\PersistedPings"));
+    DeletePersistedPings();
   }
 
   virtual void TearDown() {
-    RegKey::DeleteKey(USER_REG_UPDATE _T("\\PersistedPings"));
+    DeletePersistedPings();
   }
 };
 
@@ -50,7 +63,7 @@ class PersistedPingsTest : public AppTestBase {
   virtual void SetUp() {
     AppTestBase::SetUp();
 
-    RegKey::DeleteKey(USER_REG_UPDATE _T("\\PersistedPings"));
+    DeletePersistedPings();
 
     const TCHAR* const kAppId1 = _T("{DDE97E2B-A82C-4790-A630-FCA02F64E8BE}");
     EXPECT_SUCCEEDED(
@@ -275,11 +288,11 @@ TEST_F(PingTest, IsPingExpired_FutureTime) {
 
 TEST_F(PingTest, LoadPersistedPings_NoPersistedPings) {
   Ping::PingsVector persisted_pings;
-  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND),
-            Ping::LoadPersistedPings(false, &persisted_pings));
+  EXPECT_HRESULT_SUCCEEDED(Ping::LoadPersistedPings(false, &persisted_pings));
   EXPECT_EQ(0, persisted_pings.size());
 }
 
+// Pings persisted in the registry by older versions are moved to the journal.
 TEST_F(PingTest, LoadAndDeletePersistedPings) {
   CString pings_reg_path(Ping::GetPersistedPingsRegPath(false));
 
@@ -299,9 +312,11 @@ TEST_F(PingTest, LoadAndDeletePersistedPings) {
   Ping::PingsVector persisted_pings;
   EXPECT_HRESULT_SUCCEEDED(Ping::LoadPersistedPings(false, &persisted_pings));
   EXPECT_EQ(3, persisted_pings.size());
+  EXPECT_FALSE(RegKey::HasKey(pings_reg_path));
 
   for (size_t i = 0; i < persisted_pings.size(); ++i) {
     CString i_str(String_DigitToChar(i + 1));
+    EXPECT_STREQ(_T("Test Key ") + i_str, persisted_pings[i].first);
     EXPECT_EQ(i + 1, persisted_pings[i].second.first);
     EXPECT_STREQ(_T("Test Ping ") + i_str, persisted_pings[i].second.second);
 
@@ -309,9 +324,9 @@ TEST_F(PingTest, LoadAndDeletePersistedPings) {
         Ping::DeletePersistedPing(false, _T("Test Key ") + i_str));
   }
 
-  RegKey pings_reg_key;
-  pings_reg_key.Open(pings_reg_path, KEY_READ);
-  EXPECT_EQ(0, pings_reg_key.GetSubkeyCount());
+  persisted_pings.clear();
+  EXPECT_HRESULT_SUCCEEDED(Ping::LoadPersistedPings(false, &persisted_pings));
+  EXPECT_EQ(0, persisted_pings.size());
 }
 
 TEST_F(PingTest, PersistAndSendPersistedPings) {
@@ -336,31 +351,101 @@ TEST_F(PingTest, PersistAndSendPersistedPings) {
   time64 past(GetCurrent100NSTime());
   EXPECT_HRESULT_SUCCEEDED(install_ping.PersistPing());
 
-  CString reg_path(Ping::GetPersistedPingsRegPath(false));
-  CString ping_subkey_path(AppendRegKeyPath(reg_path,
-                                            install_ping.request_id_));
-  EXPECT_TRUE(RegKey::HasKey(ping_subkey_path));
+  EXPECT_TRUE(File::Exists(Ping::GetPersistedPingsJournalPath(false)));
 
-  CString persisted_time_string;
-  EXPECT_HRESULT_SUCCEEDED(RegKey::GetValue(ping_subkey_path,
-                                            Ping::kRegValuePersistedPingTime,
-                                            &persisted_time_string));
-  time64 persisted_time = _tcstoui64(persisted_time_string, NULL, 10);
+  Ping::PingsVector persisted_pings;
+  EXPECT_HRESULT_SUCCEEDED(Ping::LoadPersistedPings(false, &persisted_pings));
+  ASSERT_EQ(1, persisted_pings.size());
+  EXPECT_STREQ(install_ping.request_id_, persisted_pings[0].first);
+
+  time64 persisted_time = persisted_pings[0].second.first;
   EXPECT_LE(past, persisted_time);
   EXPECT_GE(GetCurrent100NSTime(), persisted_time);
 
-  CString persisted_ping;
-  EXPECT_HRESULT_SUCCEEDED(RegKey::GetValue(ping_subkey_path,
-                                            Ping::kRegValuePersistedPingString,
-                                            &persisted_ping));
+  const CString persisted_ping(persisted_pings[0].second.second);
   EXPECT_NE(-1, persisted_ping.Find(_T("sessionid=\"unittest\"")));
   EXPECT_NE(-1, persisted_ping.Find(_T("<app appid=\"{430FD4D0-B729-4F61-AA34-91526481799D}\" version=\"1.0.0.0\" nextversion=\"2.0.0.0\" lang=\"en\" brand=\"GGLS\" client=\"a client id\" iid=\"{DE06587E-E5AB-4364-A46B-F3AC733007B3}\"><event eventtype=\"2\" eventresult=\"1\" errorcode=\"0\" extracode1=\"0\"/></app>")));  // NOLINT
 
   EXPECT_HRESULT_SUCCEEDED(Ping::SendPersistedPings(false));
 
-  RegKey pings_reg_key;
-  pings_reg_key.Open(reg_path, KEY_READ);
-  EXPECT_EQ(0, pings_reg_key.GetSubkeyCount());
+  // The journal is truncated once the last ping is sent.
+  persisted_pings.clear();
+  EXPECT_HRESULT_SUCCEEDED(Ping::LoadPersistedPings(false, &persisted_pings));
+  EXPECT_EQ(0, persisted_pings.size());
+  EXPECT_FALSE(File::Exists(Ping::GetPersistedPingsJournalPath(false)));
+}
+
+TEST_F(PingTest, BuildPersistedPingsRequestString) {
+  PingEventPtr ping_event(
+      new PingEvent(PingEvent::EVENT_INSTALL_COMPLETE,
+                    PingEvent::EVENT_RESULT_SUCCESS,
+                    S_OK,
+                    0));
+
+  // Two pings of different sessions, for Omaha and for another app.
+  CommandLineExtraArgs command_line_extra_args;
+  command_line_extra_args.language = _T("en");
+  CommandLineAppArgs app_args;
+  StringToGuidSafe(_T("{C5CC8E21-E6D1-4D49-8D5E-8D4F4E2A34A5}"),
+                   &app_args.app_guid);
+  command_line_extra_args.apps.push_back(app_args);
+
+  Ping omaha_ping(false, _T("session1"), _T("taggedmi"));
+  omaha_ping.LoadAppDataFromExtraArgs(command_line_extra_args);
+  omaha_ping.BuildOmahaPing(_T("1.0.0.0"), _T("2.0.0.0"), ping_event);
+  Ping apps_ping(false, _T("session2"), _T("taggedmi"));
+  apps_ping.LoadAppDataFromExtraArgs(command_line_extra_args);
+  apps_ping.BuildAppsPing(ping_event);
+
+  std::vector<PingJournal::Entry> pings;
+  for (const Ping* ping : {&omaha_ping, &apps_ping}) {
+    CString request_string;
+    EXPECT_HRESULT_SUCCEEDED(ping->BuildRequestString(&request_string));
+    // The pings were persisted by another version of Omaha.
+    const CString updater_version(_T("updaterversion=\"") +
+                                  GetVersionString() + _T("\""));
+    EXPECT_EQ(1, request_string.Replace(updater_version,
+                                        _T("updaterversion=\"0.0.0.1\"")));
+    PingJournal::Entry entry;
+    entry.id = WideToUtf8(ping->request_id_).GetString();
+    entry.request = WideToUtf8(request_string).GetString();
+    pings.push_back(entry);
+  }
+
+  // A single ping is sent as it was persisted.
+  std::vector<PingBatch> batches =
+      CoalescePings(std::vector<PingJournal::Entry>(1, pings[0]), 10, 100000);
+  ASSERT_EQ(1, batches.size());
+  CString request_string;
+  EXPECT_HRESULT_SUCCEEDED(Ping::BuildPersistedPingsRequestString(
+      batches[0], _T("resend session"), &request_string));
+  EXPECT_STREQ(Utf8ToWideChar(pings[0].request.c_str(),
+                              static_cast<uint32>(pings[0].request.size())),
+               request_string);
+
+  batches = CoalescePings(pings, 10, 100000);
+  ASSERT_EQ(1, batches.size());
+
+  EXPECT_HRESULT_SUCCEEDED(Ping::BuildPersistedPingsRequestString(
+      batches[0], _T("resend session"), &request_string));
+
+  EXPECT_NE(-1, request_string.Find(_T("sessionid=\"resend session\"")));
+  EXPECT_NE(-1, request_string.Find(_T("updaterversion=\"0.0.0.1\"")));
+  EXPECT_NE(-1, request_string.Find(_T("installsource=\"taggedmi\"")));
+  EXPECT_EQ(-1, request_string.Find(_T("session1")));
+  EXPECT_EQ(-1, request_string.Find(omaha_ping.request_id_));
+  EXPECT_EQ(-1, request_string.Find(apps_ping.request_id_));
+  EXPECT_NE(-1, request_string.Find(_T("requestid=\"{")));
+  EXPECT_NE(-1, request_string.Find(_T("<app appid=\"{430FD4D0-B729-4F61-AA34-91526481799D}\" version=\"1.0.0.0\" nextversion=\"2.0.0.0\"")));  // NOLINT
+  EXPECT_NE(-1, request_string.Find(_T("<event eventtype=\"2\" eventresult=\"1\" errorcode=\"0\" extracode1=\"0\"/></app>")));  // NOLINT
+  EXPECT_NE(-1, request_string.Find(_T("<app appid=\"{C5CC8E21-E6D1-4D49-8D5E-8D4F4E2A34A5}\"")));  // NOLINT
+
+  // A ping which is not a well-formed request is sent as it was persisted.
+  PingBatch batch;
+  batch.request = "not a request";
+  EXPECT_HRESULT_SUCCEEDED(Ping::BuildPersistedPingsRequestString(
+      batch, _T("resend session"), &request_string));
+  EXPECT_STREQ(_T("not a request"), request_string);
 }
 
 // The tests below rely on the out-of-process mechanism to send install pings.
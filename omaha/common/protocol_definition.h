@@ -149,6 +149,11 @@ struct App {
   // Optional update check.
   UpdateCheck update_check;
 
+  // Optional names of the packages of the current version which are in the
+  // package cache. The server may answer with differential packages against
+  // them.
+  std::vector<CString> cached_packages;
+
   // Optional data.
   std::vector<Data> data;
 
@@ -0,0 +1,91 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/common/shard_runner.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace omaha {
+
+std::vector<ShardRunner::Shard> ShardRunner::Partition(size_t num_items,
+                                                       size_t max_shard_size) {
+  std::vector<Shard> shards;
+  if (!num_items) {
+    return shards;
+  }
+
+  max_shard_size = std::max<size_t>(max_shard_size, 1);
+  const size_t num_shards = (num_items + max_shard_size - 1) / max_shard_size;
+
+  // The first |num_items % num_shards| shards take one more item.
+  size_t first = 0;
+  for (size_t i = 0; i != num_shards; ++i) {
+    Shard shard;
+    shard.first = first;
+    shard.size = num_items / num_shards + (i < num_items % num_shards ? 1 : 0);
+    shards.push_back(shard);
+    first += shard.size;
+  }
+  return shards;
+}
+
+ShardRunner::ShardRunner(size_t max_concurrent_shards,
+                         int max_retries_per_shard)
+    : max_concurrent_shards_(std::max<size_t>(max_concurrent_shards, 1)),
+      max_retries_per_shard_(std::max(max_retries_per_shard, 0)),
+      is_cancelled_(false) {
+}
+
+ShardRunner::~ShardRunner() {
+}
+
+std::vector<bool> ShardRunner::Run(size_t num_shards,
+                                   const SendFunction& send) {
+  // std::vector<bool> packs its elements, so the threads write to a vector
+  // of chars instead.
+  std::vector<char> succeeded(num_shards, false);
+  std::atomic<size_t> next_shard(0);
+
+  auto send_shards = [&]() {
+    for (size_t i = next_shard++; i < num_shards; i = next_shard++) {
+      for (int attempt = 0;
+           attempt <= max_retries_per_shard_ && !is_cancelled_;
+           ++attempt) {
+        if (send(i, attempt)) {
+          succeeded[i] = true;
+          break;
+        }
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  const size_t num_threads = std::min(num_shards, max_concurrent_shards_);
+  for (size_t i = 0; i != num_threads; ++i) {
+    threads.emplace_back(send_shards);
+  }
+  for (size_t i = 0; i != threads.size(); ++i) {
+    threads[i].join();
+  }
+
+  return std::vector<bool>(succeeded.begin(), succeeded.end());
+}
+
+void ShardRunner::Cancel() {
+  is_cancelled_ = true;
+}
+
+}  // namespace omaha
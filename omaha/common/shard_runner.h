@@ -0,0 +1,72 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// ShardRunner sends the shards of a large request concurrently. Each shard
+// which fails is retried, up to a budget of retries per shard, so that a
+// failure costs the retry of one shard instead of the whole request.
+//
+// This file has no platform dependencies.
+
+#ifndef OMAHA_COMMON_SHARD_RUNNER_H_
+#define OMAHA_COMMON_SHARD_RUNNER_H_
+
+#include <stddef.h>
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#include "base/basictypes.h"
+
+namespace omaha {
+
+class ShardRunner {
+ public:
+  // The items [first, first + size) of the request.
+  struct Shard {
+    size_t first;
+    size_t size;
+  };
+
+  // Sends the shard at |shard_index|. |attempt| is 0 for the first attempt.
+  // Returns true if the shard succeeded.
+  using SendFunction = std::function<bool(size_t shard_index, int attempt)>;
+
+  // Splits |num_items| items into the fewest shards of at most
+  // |max_shard_size| items, and spreads the items evenly among them.
+  static std::vector<Shard> Partition(size_t num_items, size_t max_shard_size);
+
+  ShardRunner(size_t max_concurrent_shards, int max_retries_per_shard);
+  ~ShardRunner();
+
+  // Sends the shards 0 to |num_shards| - 1 on threads of the runner, at most
+  // max_concurrent_shards at a time. Returns whether each of them succeeded.
+  std::vector<bool> Run(size_t num_shards, const SendFunction& send);
+
+  // Stops retrying, and starting the shards which have not started. May be
+  // called from any thread.
+  void Cancel();
+
+ private:
+  const size_t max_concurrent_shards_;
+  const int max_retries_per_shard_;
+  std::atomic<bool> is_cancelled_;
+
+  DISALLOW_COPY_AND_ASSIGN(ShardRunner);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_COMMON_SHARD_RUNNER_H_
@@ -0,0 +1,295 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/common/shard_runner.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace omaha {
+
+namespace {
+
+// Stands in for the update server. A request takes a round trip, plus a time
+// proportional to the number of apps it contains to upload, process, and
+// download. The server fails the first attempt of every |fail_every|-th
+// shard, if |fail_every| is not 0, so that the failures do not depend on the
+// order in which the shards arrive.
+class ProtocolStandIn {
+ public:
+  ProtocolStandIn(std::chrono::microseconds round_trip,
+                  std::chrono::microseconds per_app,
+                  int fail_every)
+      : round_trip_(round_trip),
+        per_app_(per_app),
+        fail_every_(fail_every),
+        num_requests_(0) {
+  }
+
+  // Returns false if the request fails. Otherwise, returns the response in
+  // |response|, with an "app" element for each "app" element of |request|.
+  bool Send(const std::string& request,
+            size_t shard_index,
+            int attempt,
+            std::string* response) {
+    ++num_requests_;
+
+    std::vector<std::string> app_ids;
+    const std::string kAppPrefix("<app appid=\"");
+    for (size_t pos = request.find(kAppPrefix);
+         pos != std::string::npos;
+         pos = request.find(kAppPrefix, pos)) {
+      pos += kAppPrefix.size();
+      app_ids.push_back(request.substr(pos, request.find('"', pos) - pos));
+    }
+
+    std::this_thread::sleep_for(round_trip_ + per_app_ * app_ids.size());
+
+    if (fail_every_ && !attempt && (shard_index + 1) % fail_every_ == 0) {
+      return false;
+    }
+
+    response->assign("<response>");
+    for (size_t i = 0; i != app_ids.size(); ++i) {
+      response->append("<app appid=\"" + app_ids[i] + "\" status=\"ok\"/>");
+    }
+    response->append("</response>");
+    return true;
+  }
+
+  int num_requests() const { return num_requests_; }
+
+ private:
+  const std::chrono::microseconds round_trip_;
+  const std::chrono::microseconds per_app_;
+  const int fail_every_;
+  std::atomic<int> num_requests_;
+
+  DISALLOW_COPY_AND_ASSIGN(ProtocolStandIn);
+};
+
+std::vector<std::string> MakeAppIds(size_t num_apps) {
+  std::vector<std::string> app_ids;
+  for (size_t i = 0; i != num_apps; ++i) {
+    app_ids.push_back("{app-" + std::to_string(i) + "}");
+  }
+  return app_ids;
+}
+
+std::string MakeRequest(const std::vector<std::string>& app_ids,
+                        const ShardRunner::Shard& shard) {
+  std::string request("<request>");
+  for (size_t i = shard.first; i != shard.first + shard.size; ++i) {
+    request.append("<app appid=\"" + app_ids[i] + "\"/>");
+  }
+  request.append("</request>");
+  return request;
+}
+
+// Checks the apps of a request, split in shards of at most |max_shard_size|
+// apps, against |server|, and merges the responses. Returns the number of
+// apps in the merged response, or 0 if a shard failed.
+size_t CheckForUpdates(ProtocolStandIn* server,
+                       const std::vector<std::string>& app_ids,
+                       size_t max_shard_size,
+                       size_t max_concurrent_shards,
+                       int max_retries_per_shard) {
+  const std::vector<ShardRunner::Shard> shards(
+      ShardRunner::Partition(app_ids.size(), max_shard_size));
+  std::vector<std::string> responses(shards.size());
+
+  ShardRunner runner(max_concurrent_shards, max_retries_per_shard);
+  const std::vector<bool> succeeded = runner.Run(
+      shards.size(),
+      [&](size_t i, int attempt) {
+        return server->Send(MakeRequest(app_ids, shards[i]),
+                            i,
+                            attempt,
+                            &responses[i]);
+      });
+
+  std::string merged;
+  for (size_t i = 0; i != shards.size(); ++i) {
+    if (!succeeded[i]) {
+      return 0;
+    }
+    merged.append(responses[i]);
+  }
+
+  size_t num_apps = 0;
+  for (size_t pos = merged.find("<app "); pos != std::string::npos;
+       pos = merged.find("<app ", pos + 1)) {
+    ++num_apps;
+  }
+  return num_apps;
+}
+
+double Seconds(std::chrono::steady_clock::duration duration) {
+  return std::chrono::duration<double>(duration).count();
+}
+
+}  // namespace
+
+TEST(ShardRunnerTest, Partition) {
+  EXPECT_TRUE(ShardRunner::Partition(0, 10).empty());
+
+  std::vector<ShardRunner::Shard> shards(ShardRunner::Partition(5, 10));
+  ASSERT_EQ(1, shards.size());
+  EXPECT_EQ(0, shards[0].first);
+  EXPECT_EQ(5, shards[0].size);
+
+  // 23 items in shards of at most 10 take three shards of 8, 8 and 7 items.
+  shards = ShardRunner::Partition(23, 10);
+  ASSERT_EQ(3, shards.size());
+  EXPECT_EQ(0, shards[0].first);
+  EXPECT_EQ(8, shards[0].size);
+  EXPECT_EQ(8, shards[1].first);
+  EXPECT_EQ(8, shards[1].size);
+  EXPECT_EQ(16, shards[2].first);
+  EXPECT_EQ(7, shards[2].size);
+
+  shards = ShardRunner::Partition(3, 0);
+  EXPECT_EQ(3, shards.size());
+}
+
+TEST(ShardRunnerTest, SendsEachShardOnce) {
+  std::mutex lock;
+  std::multiset<size_t> sent;
+  ShardRunner runner(3, 2);
+  const std::vector<bool> succeeded = runner.Run(7, [&](size_t i, int) {
+    std::lock_guard<std::mutex> guard(lock);
+    sent.insert(i);
+    return true;
+  });
+
+  ASSERT_EQ(7, succeeded.size());
+  EXPECT_EQ(7, std::count(succeeded.begin(), succeeded.end(), true));
+  EXPECT_EQ(7, sent.size());
+  for (size_t i = 0; i != 7; ++i) {
+    EXPECT_EQ(1, sent.count(i));
+  }
+}
+
+TEST(ShardRunnerTest, RespectsTheConcurrencyLimit) {
+  std::atomic<int> num_running(0);
+  std::atomic<int> max_running(0);
+  ShardRunner runner(2, 0);
+  runner.Run(6, [&](size_t, int) {
+    const int running = ++num_running;
+    int max = max_running;
+    while (running > max && !max_running.compare_exchange_weak(max, running)) {
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    --num_running;
+    return true;
+  });
+  EXPECT_EQ(2, max_running);
+}
+
+TEST(ShardRunnerTest, RetriesWithinTheBudget) {
+  std::mutex lock;
+  std::vector<int> num_attempts(3, 0);
+  ShardRunner runner(3, 2);
+  const std::vector<bool> succeeded = runner.Run(3, [&](size_t i, int attempt) {
+    std::lock_guard<std::mutex> guard(lock);
+    ++num_attempts[i];
+    // Shard 0 succeeds at once, shard 1 at the last retry, and shard 2 never.
+    return (i == 0) || (i == 1 && attempt == 2);
+  });
+
+  EXPECT_TRUE(succeeded[0]);
+  EXPECT_TRUE(succeeded[1]);
+  EXPECT_FALSE(succeeded[2]);
+  EXPECT_EQ(1, num_attempts[0]);
+  EXPECT_EQ(3, num_attempts[1]);
+  EXPECT_EQ(3, num_attempts[2]);
+}
+
+TEST(ShardRunnerTest, Cancel) {
+  std::atomic<int> num_attempts(0);
+  ShardRunner runner(1, 5);
+  const std::vector<bool> succeeded = runner.Run(4, [&](size_t, int) {
+    ++num_attempts;
+    runner.Cancel();
+    return false;
+  });
+
+  EXPECT_EQ(1, num_attempts);
+  EXPECT_EQ(0, std::count(succeeded.begin(), succeeded.end(), true));
+}
+
+// Checks 400 apps against a local stand-in for the update server, in a
+// single request and in shards of 50 apps, 4 at a time. Then again when the
+// server fails the first attempt of the single request, and of one shard in
+// four: the single request is retried as a whole, the shards alone.
+TEST(ShardRunnerTest, Benchmark) {
+  const size_t kNumApps = 400;
+  const std::chrono::microseconds kRoundTrip(20000);
+  const std::chrono::microseconds kPerApp(250);
+  const std::vector<std::string> app_ids(MakeAppIds(kNumApps));
+
+  auto start = std::chrono::steady_clock::now();
+  {
+    ProtocolStandIn server(kRoundTrip, kPerApp, 0);
+    EXPECT_EQ(kNumApps, CheckForUpdates(&server, app_ids, kNumApps, 1, 2));
+  }
+  const double single_seconds =
+      Seconds(std::chrono::steady_clock::now() - start);
+
+  start = std::chrono::steady_clock::now();
+  {
+    ProtocolStandIn server(kRoundTrip, kPerApp, 0);
+    EXPECT_EQ(kNumApps, CheckForUpdates(&server, app_ids, 50, 4, 2));
+    EXPECT_EQ(8, server.num_requests());
+  }
+  const double sharded_seconds =
+      Seconds(std::chrono::steady_clock::now() - start);
+
+  start = std::chrono::steady_clock::now();
+  {
+    ProtocolStandIn server(kRoundTrip, kPerApp, 1);
+    EXPECT_EQ(kNumApps, CheckForUpdates(&server, app_ids, kNumApps, 1, 2));
+    EXPECT_EQ(2, server.num_requests());
+  }
+  const double single_retry_seconds =
+      Seconds(std::chrono::steady_clock::now() - start);
+
+  start = std::chrono::steady_clock::now();
+  {
+    ProtocolStandIn server(kRoundTrip, kPerApp, 4);
+    EXPECT_EQ(kNumApps, CheckForUpdates(&server, app_ids, 50, 4, 2));
+    EXPECT_EQ(10, server.num_requests());
+  }
+  const double sharded_retry_seconds =
+      Seconds(std::chrono::steady_clock::now() - start);
+
+  std::cout << "single request: " << single_seconds << " s, "
+            << "4 concurrent shards: " << sharded_seconds << " s, "
+            << "with failures: " << single_retry_seconds << " s and "
+            << sharded_retry_seconds << " s" << std::endl;
+  EXPECT_LT(sharded_seconds, 0.75 * single_seconds);
+  EXPECT_LT(sharded_retry_seconds, 0.75 * single_retry_seconds);
+}
+
+}  // namespace omaha
@@ -0,0 +1,360 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/common/sharded_web_services_client.h"
+
+#include <atlsecurity.h>
+#include <algorithm>
+
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/logging.h"
+#include "omaha/base/safe_format.h"
+#include "omaha/base/scoped_impersonation.h"
+#include "omaha/common/shard_runner.h"
+#include "omaha/common/update_request.h"
+#include "omaha/common/update_response.h"
+#include "omaha/third_party/smartany/scoped_any.h"
+
+namespace omaha {
+
+ShardedWebServicesClient::ShardedWebServicesClient(bool is_machine)
+    : is_machine_(is_machine),
+      use_cup_(false),
+      max_apps_per_shard_(0),
+      runner_(NULL),
+      is_cancelled_(false) {
+}
+
+ShardedWebServicesClient::~ShardedWebServicesClient() {
+  CORE_LOG(L3, (_T("[ShardedWebServicesClient::~ShardedWebServicesClient]")));
+  ASSERT1(!runner_);
+}
+
+HRESULT ShardedWebServicesClient::Initialize(const CString& url,
+                                             const HeadersVector& headers,
+                                             bool use_cup,
+                                             size_t max_apps_per_shard) {
+  CORE_LOG(L3, (_T("[ShardedWebServicesClient::Initialize][%s][%d][%Iu]"),
+                url, use_cup, max_apps_per_shard));
+  ASSERT1(max_apps_per_shard > 0);
+
+  __mutexScope(lock_);
+
+  url_ = url;
+  headers_ = headers;
+  use_cup_ = use_cup;
+  max_apps_per_shard_ = max_apps_per_shard;
+
+  return CreateClients(1);
+}
+
+HRESULT ShardedWebServicesClient::CreateClients(size_t num_clients) {
+  __mutexScope(lock_);
+
+  clients_.clear();
+  results_.assign(num_clients, S_OK);
+
+  for (size_t i = 0; i != num_clients; ++i) {
+    auto client = std::make_unique<WebServicesClient>(is_machine_);
+    HRESULT hr = client->Initialize(url_, headers_, use_cup_);
+    if (FAILED(hr)) {
+      clients_.clear();
+      return hr;
+    }
+    client->set_proxy_auth_config(proxy_auth_config_);
+    clients_.push_back(std::move(client));
+  }
+
+  return S_OK;
+}
+
+HRESULT ShardedWebServicesClient::Send(bool is_foreground,
+                                       const xml::UpdateRequest* update_request,
+                                       xml::UpdateResponse* update_response) {
+  CORE_LOG(L3, (_T("[ShardedWebServicesClient::Send]")));
+  ASSERT1(update_request);
+  ASSERT1(update_response);
+
+  const size_t num_apps = update_request->request().apps.size();
+  if (num_apps <= max_apps_per_shard_) {
+    return SendSingle(is_foreground, update_request, update_response);
+  }
+
+  const std::vector<ShardRunner::Shard> shards(
+      ShardRunner::Partition(num_apps, max_apps_per_shard_));
+  const size_t num_shards = shards.size();
+
+  std::vector<std::unique_ptr<xml::UpdateRequest>> requests;
+  std::vector<std::unique_ptr<xml::UpdateResponse>> responses;
+  for (size_t i = 0; i != num_shards; ++i) {
+    requests.emplace_back(
+        update_request->CreateShard(shards[i].first, shards[i].size));
+    responses.emplace_back(xml::UpdateResponse::Create());
+  }
+
+  // The threads of the runner impersonate the user this thread impersonates,
+  // if any, so that they use the network configuration of the user.
+  CAccessToken impersonation_token;
+  if (!impersonation_token.GetThreadToken(
+          TOKEN_QUERY | TOKEN_IMPERSONATE | TOKEN_DUPLICATE)) {
+    const HRESULT hr = HRESULTFromLastError();
+    if (hr != HRESULT_FROM_WIN32(ERROR_NO_TOKEN)) {
+      CORE_LOG(LE, (_T("[GetThreadToken failed][0x%08x]"), hr));
+      return hr;
+    }
+  }
+
+  ShardRunner runner(kMaxConcurrentShards, kMaxRetriesPerShard);
+  __mutexBlock(lock_) {
+    if (is_cancelled_) {
+      return GOOPDATE_E_CANCELLED;
+    }
+
+    HRESULT hr = CreateClients(num_shards);
+    if (FAILED(hr)) {
+      CORE_LOG(LE, (_T("[CreateClients failed][0x%08x]"), hr));
+      return hr;
+    }
+
+    // The runner does not send the shards which have not started when the
+    // request is cancelled.
+    results_.assign(num_shards, GOOPDATE_E_CANCELLED);
+    runner_ = &runner;
+  }
+
+  CORE_LOG(L3, (_T("[Sending %Iu apps in %Iu shards]"), num_apps, num_shards));
+
+  const HANDLE token = impersonation_token.GetHandle();
+  const std::vector<bool> succeeded = runner.Run(
+      num_shards,
+      [&](size_t i, int attempt) {
+        scoped_co_init init_com_apt(COINIT_MULTITHREADED);
+        VERIFY_SUCCEEDED(init_com_apt.hresult());
+
+        scoped_impersonation impersonate_user(token);
+        if (FAILED(impersonate_user.result())) {
+          results_[i] = impersonate_user.result();
+          return false;
+        }
+
+        results_[i] = clients_[i]->Send(is_foreground,
+                                        requests[i].get(),
+                                        responses[i].get());
+        CORE_LOG(L3, (_T("[Shard %Iu][attempt %d][0x%08x]"),
+                      i, attempt, results_[i]));
+        return SUCCEEDED(results_[i]);
+      });
+
+  bool is_cancelled = false;
+  __mutexBlock(lock_) {
+    runner_ = NULL;
+    is_cancelled = is_cancelled_;
+  }
+
+  const HRESULT hr = GetShardedResult(succeeded, results_, is_cancelled);
+  if (FAILED(hr)) {
+    CORE_LOG(LE, (_T("[Sharded request failed][0x%08x]"), hr));
+    return hr;
+  }
+
+  // The apps of the shards which failed are not in the response, and fail
+  // their update check as if the server did not respond for them.
+  for (size_t i = 0; i != num_shards; ++i) {
+    if (succeeded[i]) {
+      update_response->MergeShard(*responses[i]);
+    } else {
+      CORE_LOG(LW, (_T("[Shard %Iu failed][0x%08x]"), i, results_[i]));
+    }
+  }
+
+  return hr;
+}
+
+HRESULT ShardedWebServicesClient::GetShardedResult(
+    const std::vector<bool>& succeeded,
+    const std::vector<HRESULT>& results,
+    bool is_cancelled) {
+  ASSERT1(succeeded.size() == results.size());
+
+  if (is_cancelled) {
+    return GOOPDATE_E_CANCELLED;
+  }
+
+  // The request succeeds if any shard succeeds. It returns S_FALSE if some
+  // shards failed, so that the caller does not count it as a complete update
+  // check.
+  if (std::find(succeeded.begin(), succeeded.end(), true) != succeeded.end()) {
+    return std::find(succeeded.begin(), succeeded.end(), false) ==
+           succeeded.end() ? S_OK : S_FALSE;
+  }
+
+  // All the shards failed. The request fails with the error of the first one.
+  for (size_t i = 0; i != results.size(); ++i) {
+    if (FAILED(results[i])) {
+      return results[i];
+    }
+  }
+  return E_FAIL;
+}
+
+HRESULT ShardedWebServicesClient::SendSingle(
+    bool is_foreground,
+    const xml::UpdateRequest* update_request,
+    xml::UpdateResponse* update_response) {
+  __mutexBlock(lock_) {
+    if (is_cancelled_) {
+      return GOOPDATE_E_CANCELLED;
+    }
+
+    HRESULT hr = CreateClients(1);
+    if (FAILED(hr)) {
+      return hr;
+    }
+  }
+
+  results_[0] = clients_[0]->Send(is_foreground,
+                                  update_request,
+                                  update_response);
+  return results_[0];
+}
+
+HRESULT ShardedWebServicesClient::SendString(
+    bool is_foreground,
+    const CString* request_string,
+    xml::UpdateResponse* update_response) {
+  __mutexBlock(lock_) {
+    if (is_cancelled_) {
+      return GOOPDATE_E_CANCELLED;
+    }
+
+    HRESULT hr = CreateClients(1);
+    if (FAILED(hr)) {
+      return hr;
+    }
+  }
+
+  results_[0] = clients_[0]->SendString(is_foreground,
+                                        request_string,
+                                        update_response);
+  return results_[0];
+}
+
+void ShardedWebServicesClient::Cancel() {
+  CORE_LOG(L3, (_T("[ShardedWebServicesClient::Cancel]")));
+
+  __mutexScope(lock_);
+
+  is_cancelled_ = true;
+  if (runner_) {
+    runner_->Cancel();
+  }
+  for (size_t i = 0; i != clients_.size(); ++i) {
+    clients_[i]->Cancel();
+  }
+}
+
+void ShardedWebServicesClient::set_proxy_auth_config(
+    const ProxyAuthConfig& proxy_auth_config) {
+  __mutexScope(lock_);
+
+  proxy_auth_config_ = proxy_auth_config;
+  for (size_t i = 0; i != clients_.size(); ++i) {
+    clients_[i]->set_proxy_auth_config(proxy_auth_config);
+  }
+}
+
+WebServicesClient* ShardedWebServicesClient::result_client() const {
+  __mutexScope(lock_);
+  ASSERT1(!clients_.empty());
+
+  // The first shard which succeeded when the request succeeded, otherwise the
+  // first shard.
+  for (size_t i = 0; i != clients_.size(); ++i) {
+    if (SUCCEEDED(results_[i])) {
+      return clients_[i].get();
+    }
+  }
+  return clients_[0].get();
+}
+
+bool ShardedWebServicesClient::is_http_success() const {
+  return result_client()->is_http_success();
+}
+
+int ShardedWebServicesClient::http_status_code() const {
+  return result_client()->http_status_code();
+}
+
+CString ShardedWebServicesClient::http_trace() const {
+  __mutexScope(lock_);
+
+  if (clients_.size() == 1) {
+    return clients_[0]->http_trace();
+  }
+
+  CString trace;
+  for (size_t i = 0; i != clients_.size(); ++i) {
+    SafeCStringAppendFormat(&trace, _T("[Shard %Iu]\r\n%s"),
+                            i, clients_[i]->http_trace());
+  }
+  return trace;
+}
+
+bool ShardedWebServicesClient::http_used_ssl() const {
+  return result_client()->http_used_ssl();
+}
+
+HRESULT ShardedWebServicesClient::http_ssl_result() const {
+  return result_client()->http_ssl_result();
+}
+
+int ShardedWebServicesClient::http_xdaystart_header_value() const {
+  __mutexScope(lock_);
+
+  for (size_t i = 0; i != clients_.size(); ++i) {
+    const int value = clients_[i]->http_xdaystart_header_value();
+    if (value != -1) {
+      return value;
+    }
+  }
+  return -1;
+}
+
+int ShardedWebServicesClient::http_xdaynum_header_value() const {
+  __mutexScope(lock_);
+
+  for (size_t i = 0; i != clients_.size(); ++i) {
+    const int value = clients_[i]->http_xdaynum_header_value();
+    if (value != -1) {
+      return value;
+    }
+  }
+  return -1;
+}
+
+// The server may ask to wait in the response to any shard. Waits for the
+// longest of them.
+int ShardedWebServicesClient::retry_after_sec() const {
+  __mutexScope(lock_);
+
+  int retry_after_sec = -1;
+  for (size_t i = 0; i != clients_.size(); ++i) {
+    retry_after_sec = std::max(retry_after_sec, clients_[i]->retry_after_sec());
+  }
+  return retry_after_sec;
+}
+
+}  // namespace omaha
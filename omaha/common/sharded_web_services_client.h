@@ -0,0 +1,129 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// ShardedWebServicesClient sends the update check of a large number of apps
+// as several concurrent requests, each one signed with CUP by its own
+// WebServicesClient, and merges their responses. A shard which fails is
+// retried alone. The apps of a shard which still fails are missing from the
+// merged response, and their update check fails, unless all the shards fail,
+// in which case the whole update check fails. Send() returns S_FALSE when
+// only some of the shards fail.
+
+#ifndef OMAHA_COMMON_SHARDED_WEB_SERVICES_CLIENT_H_
+#define OMAHA_COMMON_SHARDED_WEB_SERVICES_CLIENT_H_
+
+#include <windows.h>
+#include <atlstr.h>
+#include <memory>
+#include <vector>
+#include "base/basictypes.h"
+#include "omaha/base/synchronized.h"
+#include "omaha/common/web_services_client.h"
+
+namespace omaha {
+
+class ShardRunner;
+
+class ShardedWebServicesClient : public WebServicesClientInterface {
+ public:
+  explicit ShardedWebServicesClient(bool is_machine);
+  virtual ~ShardedWebServicesClient();
+
+  // Requests of more than |max_apps_per_shard| apps are sharded.
+  HRESULT Initialize(const CString& url,
+                     const HeadersVector& headers,
+                     bool use_cup,
+                     size_t max_apps_per_shard);
+
+  virtual HRESULT Send(bool is_foreground,
+                       const xml::UpdateRequest* update_request,
+                       xml::UpdateResponse* update_response);
+  virtual HRESULT SendString(bool is_foreground,
+                             const CString* request_string,
+                             xml::UpdateResponse* update_response);
+
+  virtual void Cancel();
+
+  virtual void set_proxy_auth_config(const ProxyAuthConfig& proxy_auth_config);
+
+  virtual bool is_http_success() const;
+
+  virtual int http_status_code() const;
+
+  virtual CString http_trace() const;
+
+  virtual bool http_used_ssl() const;
+
+  virtual HRESULT http_ssl_result() const;
+
+  virtual int http_xdaystart_header_value() const;
+
+  virtual int http_xdaynum_header_value() const;
+
+  virtual int retry_after_sec() const;
+
+ private:
+  enum {
+    kMaxConcurrentShards = 4,
+    kMaxRetriesPerShard = 2,
+  };
+
+  // Creates and initializes |num_clients| clients, replacing the clients of
+  // the previous request.
+  HRESULT CreateClients(size_t num_clients);
+
+  // Sends the request as a single request, with the first client.
+  HRESULT SendSingle(bool is_foreground,
+                     const xml::UpdateRequest* update_request,
+                     xml::UpdateResponse* update_response);
+
+  // Returns the result of a sharded request from whether each shard
+  // succeeded, and the result of its last attempt: S_OK if all the shards
+  // succeeded, S_FALSE if some of them failed. The request fails with
+  // GOOPDATE_E_CANCELLED if it was cancelled, even if some shards succeeded
+  // before the cancellation.
+  static HRESULT GetShardedResult(const std::vector<bool>& succeeded,
+                                  const std::vector<HRESULT>& results,
+                                  bool is_cancelled);
+
+  // Returns the client which determined the result of the last request: the
+  // client of the first shard which failed, or the first client.
+  WebServicesClient* result_client() const;
+
+  LLock lock_;
+
+  const bool is_machine_;
+  CString url_;
+  HeadersVector headers_;
+  bool use_cup_;
+  size_t max_apps_per_shard_;
+  ProxyAuthConfig proxy_auth_config_;
+
+  // The clients of the shards of the last request, and their results. The
+  // result of a shard which is not sent is GOOPDATE_E_CANCELLED.
+  std::vector<std::unique_ptr<WebServicesClient>> clients_;
+  std::vector<HRESULT> results_;
+
+  // The runner of the request being sent, if it is sharded.
+  ShardRunner* runner_;
+  bool is_cancelled_;
+
+  friend class ShardedWebServicesClientTest;
+  DISALLOW_COPY_AND_ASSIGN(ShardedWebServicesClient);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_COMMON_SHARDED_WEB_SERVICES_CLIENT_H_
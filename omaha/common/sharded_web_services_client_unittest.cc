@@ -0,0 +1,67 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/common/sharded_web_services_client.h"
+
+#include <vector>
+
+#include "omaha/base/error.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+class ShardedWebServicesClientTest : public testing::Test {
+ protected:
+  static HRESULT GetShardedResult(const std::vector<bool>& succeeded,
+                                  const std::vector<HRESULT>& results,
+                                  bool is_cancelled) {
+    return ShardedWebServicesClient::GetShardedResult(succeeded,
+                                                      results,
+                                                      is_cancelled);
+  }
+};
+
+TEST_F(ShardedWebServicesClientTest, GetShardedResult) {
+  const HRESULT kNetworkError = HRESULT_FROM_WIN32(ERROR_TIMEOUT);
+
+  EXPECT_EQ(S_OK, GetShardedResult({true, true}, {S_OK, S_OK}, false));
+
+  // The request succeeds if any shard succeeds, but is incomplete.
+  EXPECT_EQ(S_FALSE,
+            GetShardedResult({false, true}, {kNetworkError, S_OK}, false));
+
+  // The request fails with the error of the first shard when all fail.
+  EXPECT_EQ(kNetworkError,
+            GetShardedResult({false, false}, {kNetworkError, E_FAIL}, false));
+}
+
+// A request cancelled before its shards are sent fails, instead of returning
+// an empty response.
+TEST_F(ShardedWebServicesClientTest, GetShardedResult_Cancelled) {
+  EXPECT_EQ(GOOPDATE_E_CANCELLED,
+            GetShardedResult({false, false, false},
+                             {GOOPDATE_E_CANCELLED,
+                              GOOPDATE_E_CANCELLED,
+                              GOOPDATE_E_CANCELLED},
+                             true));
+
+  // A request cancelled after some shards succeeded fails as well.
+  EXPECT_EQ(GOOPDATE_E_CANCELLED,
+            GetShardedResult({true, false},
+                             {S_OK, GOOPDATE_E_CANCELLED},
+                             true));
+}
+
+}  // namespace omaha
@@ -121,10 +121,35 @@ UpdateRequest* UpdateRequest::Create(bool is_machine,
   return Create(is_machine, session_id, install_source, origin_url, request_id);
 }
 
+UpdateRequest* UpdateRequest::CreateShard(size_t first_app,
+                                          size_t num_apps) const {
+  ASSERT1(first_app + num_apps <= request_.apps.size());
+
+  std::unique_ptr<UpdateRequest> shard(new UpdateRequest);
+  shard->request_ = request_;
+  shard->request_.apps.assign(
+      request_.apps.begin() + first_app,
+      request_.apps.begin() + first_app + num_apps);
+  VERIFY_SUCCEEDED(GetGuid(&shard->request_.request_id));
+  return shard.release();
+}
+
 void UpdateRequest::AddApp(const request::App& app) {
   request_.apps.push_back(app);
 }
 
+void UpdateRequest::SetCachedPackages(
+    const CString& app_id,
+    const std::vector<CString>& package_names) {
+  for (size_t i = 0; i != request_.apps.size(); ++i) {
+    request::App& app(request_.apps[i]);
+    if (app.app_id.CompareNoCase(app_id) == 0) {
+      app.cached_packages = package_names;
+      return;
+    }
+  }
+}
+
 bool UpdateRequest::has_tt_token() const {
   for (size_t i = 0; i != request_.apps.size(); ++i) {
     const request::App& app(request_.apps[i]);
@@ -20,6 +20,7 @@
 #define OMAHA_COMMON_UPDATE_REQUEST_H_
 
 #include <windows.h>
+#include <vector>
 #include "base/basictypes.h"
 #include "omaha/common/protocol_definition.h"
 
@@ -42,9 +43,19 @@ class UpdateRequest {
                                const CString& install_source,
                                const CString& origin_url);
 
+  // Creates a request for the |num_apps| apps of this request starting at
+  // |first_app|, with the same attributes and a new request id. Caller takes
+  // ownership.
+  UpdateRequest* CreateShard(size_t first_app, size_t num_apps) const;
+
   // Adds an 'app' element to the request.
   void AddApp(const request::App& app);
 
+  // Sets the cached packages of the current version of the app. Does nothing
+  // if the app is not in the request.
+  void SetCachedPackages(const CString& app_id,
+                         const std::vector<CString>& package_names);
+
   // Returns true if the requests does not contain applications.
   bool IsEmpty() const;
 
@@ -18,6 +18,7 @@
 #include <memory>
 
 #include "omaha/base/reg_key.h"
+#include "omaha/base/safe_format.h"
 #include "omaha/base/system_info.h"
 #include "omaha/common/const_group_policy.h"
 #include "omaha/testing/unit_test.h"
@@ -84,6 +85,29 @@ TEST_F(UpdateRequestTest, HardwarePlatformAttributes) {
   EXPECT_LE(1U, request.hw.physmemory);
 }
 
+TEST_F(UpdateRequestTest, CreateShard) {
+  std::unique_ptr<UpdateRequest> update_request(
+      UpdateRequest::Create(true, _T("unittest"), _T("unittest"), CString()));
+  ASSERT_TRUE(update_request.get());
+  for (int i = 0; i != 5; ++i) {
+    request::App app;
+    SafeCStringFormat(&app.app_id, _T("{app-%d}"), i);
+    update_request->AddApp(app);
+  }
+
+  std::unique_ptr<UpdateRequest> shard(update_request->CreateShard(1, 3));
+  ASSERT_TRUE(shard.get());
+  EXPECT_STREQ(_T("{app-1},{app-2},{app-3}"), shard->app_ids());
+  EXPECT_TRUE(shard->request().is_machine);
+  EXPECT_STREQ(update_request->request().session_id,
+               shard->request().session_id);
+  EXPECT_STRNE(update_request->request().request_id,
+               shard->request().request_id);
+
+  // The original request is unchanged.
+  EXPECT_EQ(5, update_request->request().apps.size());
+}
+
 TEST_P(UpdateRequestTest, DlPref) {
   EXPECT_SUCCEEDED(RegKey::SetValue(MACHINE_REG_UPDATE_DEV,
                                     kRegValueIsEnrolledToDomain,
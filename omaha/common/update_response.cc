@@ -46,6 +46,18 @@ HRESULT UpdateResponse::DeserializeFromFile(const CString& filename) {
   return Deserialize(buffer);
 }
 
+void UpdateResponse::MergeShard(const UpdateResponse& shard) {
+  if (response_.protocol.IsEmpty()) {
+    response_.protocol = shard.response_.protocol;
+    response_.day_start = shard.response_.day_start;
+    response_.sys_req = shard.response_.sys_req;
+  }
+
+  response_.apps.insert(response_.apps.end(),
+                        shard.response_.apps.begin(),
+                        shard.response_.apps.end());
+}
+
 int UpdateResponse::GetElapsedSecondsSinceDayStart() const {
   return response_.day_start.elapsed_seconds;
 }
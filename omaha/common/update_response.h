@@ -42,6 +42,10 @@ class UpdateResponse {
   // Initializes an update response from a xml document in a file.
   HRESULT DeserializeFromFile(const CString& filename);
 
+  // Adds the apps of |shard|, the response to a shard of the request, to this
+  // response. The other elements are taken from the first shard merged.
+  void MergeShard(const UpdateResponse& shard);
+
   int GetElapsedSecondsSinceDayStart() const;
 
   int GetElapsedDaysSinceDatum() const;
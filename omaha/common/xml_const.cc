@@ -93,6 +93,7 @@ const TCHAR* const kExperiments = _T("experiments");
 const TCHAR* const kExtraCode1 = _T("extracode1");
 const TCHAR* const kHash = _T("hash");
 const TCHAR* const kHashSha256 = _T("hash_sha256");
+const TCHAR* const kHashSha256Diff = _T("hashdiff_sha256");
 const TCHAR* const kIndex = _T("index");
 const TCHAR* const kInstallationId = _T("iid");
 const TCHAR* const kInstallDate = _T("installdate");
@@ -104,6 +105,7 @@ const TCHAR* const kIsMachine = _T("ismachine");
 const TCHAR* const kLang = _T("lang");
 const TCHAR* const kMinOSVersion = _T("min_os_version");
 const TCHAR* const kName = _T("name");
+const TCHAR* const kNameDiff = _T("namediff");
 const TCHAR* const kNextVersion = _T("nextversion");
 const TCHAR* const kOriginURL = _T("originurl");
 const TCHAR* const kParameter = _T("parameter");
@@ -121,6 +123,7 @@ const TCHAR* const kSessionId = _T("sessionid");
 const TCHAR* const kShellVersion = _T("shell_version");
 const TCHAR* const kSignature = _T("signature");
 const TCHAR* const kSize = _T("size");
+const TCHAR* const kSizeDiff = _T("sizediff");
 const TCHAR* const kSourceUrlIndex = _T("source_url_index");
 const TCHAR* const kSse = _T("sse");
 const TCHAR* const kSse2 = _T("sse2");
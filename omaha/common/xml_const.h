@@ -93,6 +93,7 @@ extern const TCHAR* const kExperiments;
 extern const TCHAR* const kExtraCode1;
 extern const TCHAR* const kHash;
 extern const TCHAR* const kHashSha256;
+extern const TCHAR* const kHashSha256Diff;
 extern const TCHAR* const kIndex;
 extern const TCHAR* const kInstallationId;
 extern const TCHAR* const kInstallDate;
@@ -104,6 +105,7 @@ extern const TCHAR* const kIsMachine;
 extern const TCHAR* const kLang;
 extern const TCHAR* const kMinOSVersion;
 extern const TCHAR* const kName;
+extern const TCHAR* const kNameDiff;
 extern const TCHAR* const kNextVersion;
 extern const TCHAR* const kOriginURL;
 extern const TCHAR* const kParameter;
@@ -121,6 +123,7 @@ extern const TCHAR* const kSessionId;
 extern const TCHAR* const kShellVersion;
 extern const TCHAR* const kSignature;
 extern const TCHAR* const kSize;
+extern const TCHAR* const kSizeDiff;
 extern const TCHAR* const kSourceUrlIndex;
 extern const TCHAR* const kSse;
 extern const TCHAR* const kSse2;
@@ -421,6 +421,29 @@ class PackageElementHandler : public ElementHandler {
       return hr;
     }
 
+    // The differential package is optional. It is ignored unless all its
+    // attributes are present.
+    if (HasAttribute(node, xml::attribute::kNameDiff) &&
+        HasAttribute(node, xml::attribute::kSizeDiff) &&
+        HasAttribute(node, xml::attribute::kHashSha256Diff)) {
+      hr = ReadStringAttribute(node,
+                               xml::attribute::kNameDiff,
+                               &install_package.name_diff);
+      if (SUCCEEDED(hr)) {
+        hr = ReadIntAttribute(node,
+                              xml::attribute::kSizeDiff,
+                              &install_package.size_diff);
+      }
+      if (SUCCEEDED(hr)) {
+        hr = ReadStringAttribute(node,
+                                 xml::attribute::kHashSha256Diff,
+                                 &install_package.hash_sha256_diff);
+      }
+      if (FAILED(hr)) {
+        return hr;
+      }
+    }
+
     InstallManifest& install_manifest =
         response->apps.back().update_check.install_manifest;
     install_manifest.packages.push_back(install_package);
@@ -1344,6 +1367,11 @@ HRESULT XmlParser::BuildAppElement(IXMLDOMNode* parent_node) {
       return hr;
     }
 
+    hr = BuildPackagesElement(app, element);
+    if (FAILED(hr)) {
+      return hr;
+    }
+
     hr = BuildPingRequestElement(app, element);
     if (FAILED(hr)) {
       return hr;
@@ -1502,6 +1530,51 @@ HRESULT XmlParser::BuildUpdateCheckElement(const request::App& app,
   return S_OK;
 }
 
+HRESULT XmlParser::BuildPackagesElement(const request::App& app,
+                                        IXMLDOMNode* parent_node) {
+  CORE_LOG(L3, (_T("[XmlParser::BuildPackagesElement]")));
+  ASSERT1(parent_node);
+
+  // Create a DOM element only if there are cached packages.
+  if (!app.update_check.is_valid || app.cached_packages.empty()) {
+    return S_OK;
+  }
+
+  CComPtr<IXMLDOMNode> element;
+  HRESULT hr = CreateElementNode(xml::element::kPackages, _T(""), &element);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  for (size_t i = 0; i != app.cached_packages.size(); ++i) {
+    CComPtr<IXMLDOMNode> package_element;
+    hr = CreateElementNode(xml::element::kPackage, _T(""), &package_element);
+    if (FAILED(hr)) {
+      return hr;
+    }
+
+    hr = AddXMLAttributeNode(package_element,
+                             kXmlNamespace,
+                             xml::attribute::kName,
+                             app.cached_packages[i]);
+    if (FAILED(hr)) {
+      return hr;
+    }
+
+    hr = element->appendChild(package_element, NULL);
+    if (FAILED(hr)) {
+      return hr;
+    }
+  }
+
+  hr = parent_node->appendChild(element, NULL);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  return S_OK;
+}
+
 // Ping elements are called "event" elements for legacy reasons.
 HRESULT XmlParser::BuildPingRequestElement(const request::App& app,
                                            IXMLDOMNode* parent_node) {
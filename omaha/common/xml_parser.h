@@ -92,6 +92,11 @@ class XmlParser {
   HRESULT BuildUpdateCheckElement(const request::App& app,
                                   IXMLDOMNode* parent_node);
 
+  // Creates the 'packages' element, which lists the cached packages of the
+  // current version of an application.
+  HRESULT BuildPackagesElement(const request::App& app,
+                               IXMLDOMNode* parent_node);
+
   // Creates Ping aka 'event' elements for an application.
   HRESULT BuildPingRequestElement(const request::App& app,
                                   IXMLDOMNode* parent_node);
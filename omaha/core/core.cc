@@ -32,6 +32,7 @@
 
 #include "omaha/base/app_util.h"
 #include "omaha/base/const_object_names.h"
+#include "omaha/base/constants.h"
 #include "omaha/base/debug.h"
 #include "omaha/base/error.h"
 #include "omaha/base/logging.h"
@@ -58,6 +59,8 @@
 #include "omaha/core/system_monitor.h"
 #include "omaha/goopdate/app_command.h"
 #include "omaha/goopdate/app_command_configuration.h"
+#include "omaha/goopdate/package_cache.h"
+#include "omaha/goopdate/peer_cache_server.h"
 #include "omaha/goopdate/resource_manager.h"
 #include "omaha/goopdate/worker.h"
 #include "omaha/net/network_config.h"
@@ -65,6 +68,19 @@
 
 namespace omaha {
 
+namespace {
+
+// The periodic work items of the core which are due within the coalescing
+// window of each other run on the same wakeup.
+// The intervals of the work items are randomized so that the clients do not
+// contact the servers in lockstep.
+const int64 kSchedulerTickMs = kMsPerSec;
+const int64 kSchedulerCoalescingWindowMs = 5 * 60 * kMsPerSec;
+const int64 kSchedulerMissedDeadlineToleranceMs = 60 * kMsPerSec;
+const int kSchedulerJitterPercent = 10;
+
+}  // namespace
+
 Core::Core()
     : is_system_(false),
       is_crash_handler_enabled_(false),
@@ -247,7 +263,14 @@ HRESULT Core::DoMain(bool is_system, bool is_crash_handler_enabled) {
     return hr;
   }
 
-  auto scheduler = std::make_unique<Scheduler>();
+  TimerWheel::Options wheel_options;
+  wheel_options.tick_ms = kSchedulerTickMs;
+  wheel_options.coalescing_window_ms = kSchedulerCoalescingWindowMs;
+  wheel_options.missed_deadline_tolerance_ms =
+      kSchedulerMissedDeadlineToleranceMs;
+  wheel_options.random_seed = ::GetTickCount();
+  auto scheduler = std::make_unique<Scheduler>(wheel_options,
+                                               kSchedulerJitterPercent);
   hr = InitializeScheduler(scheduler.get());
   if (FAILED(hr)) {
     return hr;
@@ -257,6 +280,21 @@ HRESULT Core::DoMain(bool is_system, bool is_crash_handler_enabled) {
   VERIFY_SUCCEEDED(system_monitor->Initialize(true));
   system_monitor->set_observer(this);
 
+  // Serves the packages of the machine cache to the peers on the local
+  // network, when a policy enables it. The server stops when the core exits.
+  std::unique_ptr<PeerCacheServer> peer_cache_server;
+  const int peer_cache_server_port = cm.GetPeerCacheServerPort(NULL);
+  if (is_system_ && peer_cache_server_port) {
+    peer_cache_server.reset(new PeerCacheServer(PackageCache::GetContentDir(
+        cm.GetMachineSecureDownloadStorageDir())));
+    hr = peer_cache_server->Start(peer_cache_server_port, false);
+    if (FAILED(hr)) {
+      OPT_LOG(LW, (_T("[failed to start the peer cache server][0x%08x]"),
+                   hr));
+      peer_cache_server.reset();
+    }
+  }
+
   // Start processing messages and events from the system.
   return DoRun();
 }
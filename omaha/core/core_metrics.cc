@@ -36,6 +36,10 @@ DEFINE_METRIC_count(core_cr_succeeded);
 DEFINE_METRIC_integer(core_cr_expected_timer_interval_ms);
 DEFINE_METRIC_integer(core_cr_actual_timer_interval_ms);
 
+DEFINE_METRIC_integer(core_scheduler_wakeups);
+DEFINE_METRIC_integer(core_scheduler_missed_deadlines);
+DEFINE_METRIC_integer(core_scheduler_max_lateness_ms);
+
 DEFINE_METRIC_count(core_osupgrade_started);
 DEFINE_METRIC_count(core_osupgrade_failed_to_enumerate);
 DEFINE_METRIC_count(core_osupgrade_failed_to_load_command);
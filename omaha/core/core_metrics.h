@@ -48,6 +48,12 @@ DECLARE_METRIC_count(core_cr_succeeded);
 DECLARE_METRIC_integer(core_cr_expected_timer_interval_ms);
 DECLARE_METRIC_integer(core_cr_actual_timer_interval_ms);
 
+// How many times the scheduler woke up, how many work items ran later than
+// their deadline allows, and the maximum lateness.
+DECLARE_METRIC_integer(core_scheduler_wakeups);
+DECLARE_METRIC_integer(core_scheduler_missed_deadlines);
+DECLARE_METRIC_integer(core_scheduler_max_lateness_ms);
+
 // OS upgrade detection metrics.
 DECLARE_METRIC_count(core_osupgrade_started);
 DECLARE_METRIC_count(core_osupgrade_failed_to_enumerate);
@@ -15,112 +15,109 @@
 
 #include "omaha/core/scheduler.h"
 
+#include <algorithm>
+#include <utility>
+
 #include "omaha/base/debug.h"
 #include "omaha/base/error.h"
 #include "omaha/base/logging.h"
+#include "omaha/core/core_metrics.h"
 
 namespace omaha {
 
-Scheduler::SchedulerItem::SchedulerItem(HANDLE timer_queue,
-                                        int start_delay_ms,
-                                        int interval_ms,
-                                        bool has_debug_timer,
-                                        ScheduledWorkWithTimer work)
-    : start_delay_ms_(start_delay_ms), interval_ms_(interval_ms), work_(work) {
-  if (has_debug_timer) {
-    debug_timer_.reset(new HighresTimer());
-  }
-
-  if (timer_queue) {
-    timer_.reset(
-        new QueueTimer(timer_queue, &SchedulerItem::TimerCallback, this));
-    VERIFY_SUCCEEDED(
-        ScheduleNext(timer_.get(), debug_timer_.get(), start_delay_ms));
-  }
+Scheduler::Scheduler() : Scheduler(TimerWheel::Options(), 0) {
 }
 
-Scheduler::SchedulerItem::~SchedulerItem() {
-  // QueueTimer dtor may block for pending callbacks.
-  if (timer_) {
-    timer_.reset();
-  }
+Scheduler::Scheduler(const TimerWheel::Options& wheel_options,
+                     int jitter_percent)
+    : origin_(std::chrono::steady_clock::now()),
+      jitter_percent_(jitter_percent),
+      is_stopping_(false),
+      is_thread_started_(false) {
+  CORE_LOG(L1, (L"[Scheduler::Scheduler]"));
+  wheel_ = std::make_unique<TimerWheel>(wheel_options, 0);
 
-  if (debug_timer_) {
-    debug_timer_.reset();
+  reset(wake_event_, ::CreateEvent(NULL, false, false, NULL));
+  if (!wake_event_) {
+    CORE_LOG(LE, (L"[Failed to create wake event][%d]", ::GetLastError()));
+    return;
   }
-}
 
-// static
-HRESULT Scheduler::SchedulerItem::ScheduleNext(QueueTimer* timer,
-                                               HighresTimer* debug_timer,
-                                               int start_after_ms) {
-  if (!timer) {
-    return E_FAIL;
+  is_thread_started_ = thread_.Start(this);
+  if (!is_thread_started_) {
+    CORE_LOG(LE, (L"[Failed to start scheduler thread][%d]",
+                  ::GetLastError()));
   }
+}
 
-  if (debug_timer) {
-    debug_timer->Start();
-  }
+Scheduler::~Scheduler() {
+  CORE_LOG(L1, (L"[Scheduler::~Scheduler]"));
 
-  const HRESULT hr = timer->Start(start_after_ms, 0, WT_EXECUTEONLYONCE);
+  if (is_thread_started_) {
+    ::InterlockedExchange(&is_stopping_, true);
+    VERIFY1(::SetEvent(get(wake_event_)));
 
-  if (FAILED(hr)) {
-    CORE_LOG(LE, (L"[can't start queue timer][0x%08x]", hr));
+    // Waits for the work item in progress to complete.
+    VERIFY1(thread_.WaitTillExit(INFINITE));
   }
 
-  return hr;
+  const TimerWheel::Stats stats = wheel_->stats();
+  CORE_LOG(L1, (L"[Scheduler stats][wakeups %I64u][empty %I64u]"
+                L"[expired %I64u][missed %I64u][max lateness %I64d ms]",
+                stats.num_wakeups, stats.num_empty_wakeups, stats.num_expired,
+                stats.num_missed_deadlines, stats.max_lateness_ms));
 }
 
-// static
-void Scheduler::SchedulerItem::TimerCallback(QueueTimer* timer) {
-  ASSERT1(timer);
-  if (!timer) {
-    return;
-  }
+int64 Scheduler::NowMs() const {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - origin_).count();
+}
 
-  SchedulerItem* item = reinterpret_cast<SchedulerItem*>(timer->ctx());
-  ASSERT1(item);
+void Scheduler::Run() {
+  CORE_LOG(L1, (L"[Scheduler::Run]"));
 
-  if (!item) {
-    CORE_LOG(LE, (L"[Expected timer context to contain SchedulerItem]"));
-    return;
-  }
-
-  // This may be long running, |item| may be deleted in the meantime,
-  // however the dtor should block on deleting the |timer| and allow
-  // pending callbacks to run.
-  if (item && item->work_) {
-    item->work_(item->debug_timer());
-  }
+  while (!is_stopping_) {
+    DWORD wait_ms = INFINITE;
+    const int64 wakeup_ms = wheel_->NextWakeupMs();
+    if (wakeup_ms >= 0) {
+      wait_ms = static_cast<DWORD>(
+          std::min<int64>(std::max<int64>(wakeup_ms - NowMs(), 0),
+                          INFINITE - 1));
+    }
 
-  if (item) {
-    const HRESULT hr = SchedulerItem::ScheduleNext(timer,
-                                                   item->debug_timer(),
-                                                   item->interval_ms());
-    if (FAILED(hr)) {
-      CORE_LOG(L1, (L"[Scheduling next timer callback failed][0x%08x]", hr));
+    const DWORD result = ::WaitForSingleObject(get(wake_event_), wait_ms);
+    if (is_stopping_) {
+      break;
+    }
+    if (result == WAIT_OBJECT_0) {
+      // A work item was added. Computes the next wakeup again.
+      continue;
+    }
+    if (result != WAIT_TIMEOUT) {
+      CORE_LOG(LE, (L"[Scheduler wait failed][%d]", ::GetLastError()));
+      break;
     }
-  }
-}
 
-Scheduler::Scheduler() {
-  CORE_LOG(L1, (L"[Scheduler::Scheduler]"));
-  timer_queue_ = ::CreateTimerQueue();
-  if (!timer_queue_) {
-    CORE_LOG(LE, (L"[Failed to create Timer Queue][%d]", ::GetLastError()));
-  }
-}
+    const int64 now_ms = NowMs();
+    if (now_ms < wakeup_ms) {
+      continue;
+    }
 
-Scheduler::~Scheduler() {
-  CORE_LOG(L1, (L"[Scheduler::~Scheduler]"));
+    for (auto& expired : wheel_->Advance(now_ms)) {
+      if (is_stopping_) {
+        break;
+      }
+      expired.callback();
 
-  timers_.clear();
+      // As with the timer queue the scheduler used before, the interval of a
+      // work item starts when the work item completes.
+      wheel_->Rearm(expired.id, NowMs());
+    }
 
-  if (timer_queue_) {
-    // The destructor blocks on deleting the timer queue and it waits for
-    // all timer callbacks to complete.
-    ::DeleteTimerQueueEx(timer_queue_, INVALID_HANDLE_VALUE);
-    timer_queue_ = NULL;
+    const TimerWheel::Stats stats = wheel_->stats();
+    metric_core_scheduler_wakeups = stats.num_wakeups;
+    metric_core_scheduler_missed_deadlines = stats.num_missed_deadlines;
+    metric_core_scheduler_max_lateness_ms = stats.max_lateness_ms;
   }
 }
 
@@ -143,15 +140,33 @@ HRESULT Scheduler::DoStart(int start_delay,
                            int interval,
                            ScheduledWorkWithTimer work_fn,
                            bool has_debug_timer) const {
-  CORE_LOG(L1, (L"[Scheduler::Start]"));
+  CORE_LOG(L1, (L"[Scheduler::Start][%d][%d]", start_delay, interval));
 
-  if (!timer_queue_) {
-    return HRESULTFromLastError();
+  if (!is_thread_started_) {
+    return E_UNEXPECTED;
+  }
+
+  // Measures the actual time interval between events for debugging
+  // purposes. The timer is started when the work item is scheduled and
+  // restarted when the work item completes.
+  std::shared_ptr<HighresTimer> debug_timer;
+  if (has_debug_timer) {
+    debug_timer = std::make_shared<HighresTimer>();
+    debug_timer->Start();
   }
 
-  timers_.emplace_back(timer_queue_, start_delay, interval, has_debug_timer,
-                       work_fn);
-  return S_OK;
+  wheel_->Schedule(NowMs(),
+                   start_delay,
+                   interval,
+                   jitter_percent_,
+                   [work_fn, debug_timer]() {
+                     work_fn(debug_timer.get());
+                     if (debug_timer) {
+                       debug_timer->Start();
+                     }
+                   });
+
+  return ::SetEvent(get(wake_event_)) ? S_OK : HRESULTFromLastError();
 }
 
 }  // namespace omaha
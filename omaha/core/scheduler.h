@@ -13,30 +13,45 @@
 // limitations under the License.
 // ========================================================================
 
-// TODO(omaha): consider using a waitable timer registered with the reactor. It
-// seems a lot less code than using the QueueTimer class.
+// The scheduler runs all its work items from a single thread driven by a
+// TimerWheel, so that the process wakes up once for all the work items which
+// are due at about the same time, instead of once per work item.
+//
+// The work items run one at a time, so a work item which is due while
+// another one runs is delayed until that one completes. The work items are
+// expected to be short, for instance to start a process. The interval of a
+// work item is measured from the completion of its previous run.
 
 #ifndef OMAHA_CORE_SCHEDULER_H__
 #define OMAHA_CORE_SCHEDULER_H__
 
 #include <windows.h>
+#include <chrono>
 #include <functional>
-#include <list>
 #include <memory>
 
 #include "base/basictypes.h"
 #include "omaha/base/highres_timer-win32.h"
-#include "omaha/base/queue_timer.h"
+#include "omaha/base/thread.h"
+#include "omaha/core/timer_wheel.h"
+#include "omaha/third_party/smartany/scoped_any.h"
 
 namespace omaha {
 
 using ScheduledWork = std::function<void()>;
 using ScheduledWorkWithTimer = std::function<void(HighresTimer*)>;
 
-class Scheduler {
+class Scheduler : public Runnable {
  public:
-  explicit Scheduler();
-  ~Scheduler();
+  // Runs the work items on time, with the resolution of a millisecond.
+  Scheduler();
+
+  // Runs the work items with the resolution and the coalescing window of
+  // |wheel_options|. The intervals are randomized by up to |jitter_percent|.
+  Scheduler(const TimerWheel::Options& wheel_options, int jitter_percent);
+
+  // Blocks until the work item in progress, if any, completes.
+  ~Scheduler() override;
 
   // Starts the scheduler that executes |work| with regular |interval| (ms).
   HRESULT Start(int interval, ScheduledWork work) const;
@@ -49,53 +64,30 @@ class Scheduler {
   // a timer which starts after the previous item finishes execution.
   HRESULT StartWithDebugTimer(int interval, ScheduledWorkWithTimer work) const;
 
- private:
-  class SchedulerItem {
-   public:
-    SchedulerItem(HANDLE timer_queue,
-                  int start_delay,
-                  int interval,
-                  bool has_debug_timer,
-                  ScheduledWorkWithTimer work_fn);
-
-    ~SchedulerItem();
-
-    HighresTimer* debug_timer() const {
-      return debug_timer_ ? debug_timer_.get() : nullptr;
-    }
-
-    int interval_ms() const { return interval_ms_; }
+  // Returns the wakeup and missed-deadline statistics of the scheduler.
+  TimerWheel::Stats stats() const { return wheel_->stats(); }
 
-   private:
-    int start_delay_ms_;
-    int interval_ms_;
-
-    std::unique_ptr<QueueTimer> timer_;
-
-    // Measures the actual time interval between events for debugging
-    // purposes. The timer is started when an alarm is set and then,
-    // the value of the timer is read when the alarm goes off.
-    std::unique_ptr<HighresTimer> debug_timer_;
-
-    ScheduledWorkWithTimer work_;
-
-    static HRESULT ScheduleNext(QueueTimer* timer,
-                                HighresTimer* debug_timer,
-                                int interval_ms);
-    static void TimerCallback(QueueTimer* timer);
-
-    DISALLOW_COPY_AND_ASSIGN(SchedulerItem);
-  };
+ private:
+  // Runs the work items as they become due, until the scheduler is destroyed.
+  void Run() override;
 
   HRESULT DoStart(int start_delay,
                   int interval,
                   ScheduledWorkWithTimer work,
                   bool has_debug_timer = false) const;
 
-  // Timer queue handle for all QueueTimer objects.
-  HANDLE timer_queue_;
+  int64 NowMs() const;
+
+  const std::chrono::steady_clock::time_point origin_;
+  const int jitter_percent_;
+  std::unique_ptr<TimerWheel> wheel_;
+
+  // Signaled when a work item is added or when the scheduler is destroyed.
+  scoped_event wake_event_;
+  volatile LONG is_stopping_;
 
-  mutable std::list<SchedulerItem> timers_;
+  Thread thread_;
+  bool is_thread_started_;
 
   DISALLOW_COPY_AND_ASSIGN(Scheduler);
 };
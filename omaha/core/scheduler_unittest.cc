@@ -181,4 +181,30 @@ TEST_F(SchedulerTest, LongCallbackBlocks) {
   EXPECT_GE(timer.GetElapsedMs(), kCallbackDelay);
 }
 
+// Work items which are due within the coalescing window of each other run on
+// the same wakeup.
+TEST_F(SchedulerTest, CoalescesWorkItems) {
+  std::vector<scoped_handle> event_handles(2);
+  for (auto& handle : event_handles) {
+    reset(handle, ::CreateEvent(NULL, true, false, NULL));
+  }
+
+  TimerWheel::Options options;
+  options.tick_ms = 10;
+  options.coalescing_window_ms = 200;
+  Scheduler scheduler(options, 0);
+  ASSERT_SUCCEEDED(scheduler.StartWithDelay(100, 10000, [&event_handles]() {
+    ::SetEvent(get(event_handles[0]));
+  }));
+  ASSERT_SUCCEEDED(scheduler.StartWithDelay(200, 10000, [&event_handles]() {
+    ::SetEvent(get(event_handles[1]));
+  }));
+  AssertAllSignalledBefore(event_handles, 1000);
+
+  const TimerWheel::Stats stats = scheduler.stats();
+  EXPECT_EQ(2, stats.num_expired);
+  EXPECT_EQ(1, stats.num_wakeups);
+  EXPECT_EQ(0, stats.num_missed_deadlines);
+}
+
 }  // namespace omaha
@@ -0,0 +1,265 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/core/timer_wheel.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+namespace omaha {
+
+namespace {
+
+// The number of ticks covered by the wheel. Timers due later than that are
+// kept in the last slots of the top level until they come within range.
+const int64_t kMaxTicks =
+    (static_cast<int64_t>(1) <<
+         (TimerWheel::kBitsPerLevel * TimerWheel::kNumLevels)) - 1;
+
+int64_t SlotIndex(int64_t tick, int level) {
+  return (tick >> (TimerWheel::kBitsPerLevel * level)) &
+         (TimerWheel::kSlotsPerLevel - 1);
+}
+
+TimerWheel::Options NormalizeOptions(const TimerWheel::Options& options) {
+  TimerWheel::Options normalized(options);
+  normalized.tick_ms = std::max<int64_t>(normalized.tick_ms, 1);
+  normalized.coalescing_window_ms =
+      std::max<int64_t>(normalized.coalescing_window_ms, 0);
+  return normalized;
+}
+
+}  // namespace
+
+TimerWheel::TimerWheel(const Options& options, int64_t now_ms)
+    : options_(NormalizeOptions(options)),
+      current_tick_(now_ms / options_.tick_ms),
+      next_id_(1),
+      random_(options.random_seed) {
+}
+
+TimerWheel::~TimerWheel() {
+}
+
+int64_t TimerWheel::ToTick(int64_t time_ms) const {
+  // Rounds up so that a timer never expires before its deadline.
+  return (time_ms + options_.tick_ms - 1) / options_.tick_ms;
+}
+
+void TimerWheel::PlaceFrontLocked(Slot* from) {
+  const Timer& timer = from->front();
+  int64_t expires = ToTick(timer.deadline_ms);
+  const int64_t delta = expires - current_tick_;
+
+  int level = 0;
+  if (delta < 0) {
+    expires = current_tick_;
+  } else if (delta > kMaxTicks) {
+    expires = current_tick_ + kMaxTicks;
+    level = kNumLevels - 1;
+  } else {
+    while ((delta >> (kBitsPerLevel * (level + 1))) != 0) {
+      ++level;
+    }
+  }
+
+  const int slot = static_cast<int>(SlotIndex(expires, level));
+  Slot* to = &slots_[level][slot];
+  to->splice(to->end(), *from, from->begin());
+
+  Location& location = locations_[to->back().id];
+  location.level = level;
+  location.slot = slot;
+  location.it = std::prev(to->end());
+}
+
+void TimerWheel::CascadeLocked(int level, int slot) {
+  Slot* from = &slots_[level][slot];
+  while (!from->empty()) {
+    PlaceFrontLocked(from);
+  }
+}
+
+int64_t TimerWheel::NextDeadlineLocked(const Timer& timer, int64_t now_ms) {
+  int64_t next = now_ms + timer.interval_ms;
+  const int64_t jitter = timer.interval_ms * timer.jitter_percent / 100;
+  if (jitter > 0) {
+    std::uniform_int_distribution<int64_t> distribution(-jitter, jitter);
+    next += distribution(random_);
+  }
+  return std::max(next, now_ms + 1);
+}
+
+int TimerWheel::Schedule(int64_t now_ms,
+                         int64_t delay_ms,
+                         int64_t interval_ms,
+                         int jitter_percent,
+                         Callback callback) {
+  std::lock_guard<std::mutex> lock(lock_);
+
+  Slot pending;
+  pending.emplace_back();
+  Timer& timer = pending.back();
+  timer.id = next_id_++;
+  timer.deadline_ms = now_ms + std::max<int64_t>(delay_ms, 0);
+  timer.interval_ms = std::max<int64_t>(interval_ms, 0);
+  timer.jitter_percent = std::min(std::max(jitter_percent, 0), 100);
+  timer.callback = std::move(callback);
+
+  const int id = timer.id;
+  PlaceFrontLocked(&pending);
+  return id;
+}
+
+bool TimerWheel::Cancel(int id) {
+  std::lock_guard<std::mutex> lock(lock_);
+
+  if (running_.erase(id)) {
+    return true;
+  }
+  const auto it = locations_.find(id);
+  if (it == locations_.end()) {
+    return false;
+  }
+  slots_[it->second.level][it->second.slot].erase(it->second.it);
+  locations_.erase(it);
+  return true;
+}
+
+void TimerWheel::Rearm(int id, int64_t now_ms) {
+  std::lock_guard<std::mutex> lock(lock_);
+
+  const auto it = running_.find(id);
+  if (it == running_.end()) {
+    return;
+  }
+  Slot pending;
+  pending.push_back(std::move(it->second));
+  running_.erase(it);
+  pending.front().deadline_ms = NextDeadlineLocked(pending.front(), now_ms);
+  PlaceFrontLocked(&pending);
+}
+
+int64_t TimerWheel::NextWakeupMs() const {
+  std::lock_guard<std::mutex> lock(lock_);
+
+  if (locations_.empty()) {
+    return -1;
+  }
+
+  std::vector<int64_t> ticks;
+  ticks.reserve(locations_.size());
+  for (int level = 0; level != kNumLevels; ++level) {
+    for (int slot = 0; slot != kSlotsPerLevel; ++slot) {
+      for (const auto& timer : slots_[level][slot]) {
+        ticks.push_back(std::max(ToTick(timer.deadline_ms), current_tick_));
+      }
+    }
+  }
+
+  // Wakes up at the earliest deadline, unless other deadlines follow it
+  // within the coalescing window, in which case the wakeup is delayed to the
+  // last of them.
+  const int64_t earliest_tick = *std::min_element(ticks.begin(), ticks.end());
+  const int64_t last_tick =
+      earliest_tick + options_.coalescing_window_ms / options_.tick_ms;
+  int64_t next_tick = earliest_tick;
+  for (const int64_t tick : ticks) {
+    if (tick <= last_tick) {
+      next_tick = std::max(next_tick, tick);
+    }
+  }
+  return next_tick * options_.tick_ms;
+}
+
+std::vector<TimerWheel::Expired> TimerWheel::Advance(int64_t now_ms) {
+  std::lock_guard<std::mutex> lock(lock_);
+
+  std::vector<Expired> expired;
+
+  const int64_t target_tick = now_ms / options_.tick_ms;
+  if (locations_.empty() && current_tick_ <= target_tick) {
+    current_tick_ = target_tick + 1;
+  }
+
+  for (; current_tick_ <= target_tick; ++current_tick_) {
+    const int index = static_cast<int>(SlotIndex(current_tick_, 0));
+    if (index == 0) {
+      for (int level = 1; level != kNumLevels; ++level) {
+        const int slot = static_cast<int>(SlotIndex(current_tick_, level));
+        CascadeLocked(level, slot);
+        if (slot) {
+          break;
+        }
+      }
+    }
+
+    Slot* due = &slots_[0][index];
+    while (!due->empty()) {
+      Timer& timer = due->front();
+      locations_.erase(timer.id);
+
+      Expired item;
+      item.id = timer.id;
+      item.deadline_ms = timer.deadline_ms;
+      item.lateness_ms = now_ms - timer.deadline_ms;
+      if (timer.interval_ms > 0) {
+        item.callback = timer.callback;
+        running_[timer.id] = std::move(timer);
+      } else {
+        item.callback = std::move(timer.callback);
+      }
+      due->pop_front();
+      expired.push_back(std::move(item));
+    }
+
+    if (locations_.empty()) {
+      current_tick_ = target_tick + 1;
+      break;
+    }
+  }
+
+  ++stats_.num_wakeups;
+  if (expired.empty()) {
+    ++stats_.num_empty_wakeups;
+  }
+  const int64_t missed_threshold_ms = options_.tick_ms +
+                                      options_.coalescing_window_ms +
+                                      options_.missed_deadline_tolerance_ms;
+  for (const auto& item : expired) {
+    ++stats_.num_expired;
+    stats_.total_lateness_ms += item.lateness_ms;
+    stats_.max_lateness_ms = std::max(stats_.max_lateness_ms,
+                                      item.lateness_ms);
+    if (item.lateness_ms > missed_threshold_ms) {
+      ++stats_.num_missed_deadlines;
+    }
+  }
+
+  return expired;
+}
+
+size_t TimerWheel::num_timers() const {
+  std::lock_guard<std::mutex> lock(lock_);
+  return locations_.size() + running_.size();
+}
+
+TimerWheel::Stats TimerWheel::stats() const {
+  std::lock_guard<std::mutex> lock(lock_);
+  return stats_;
+}
+
+}  // namespace omaha
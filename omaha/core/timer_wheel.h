@@ -0,0 +1,189 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// TimerWheel is a hierarchical timing wheel which keeps all the periodic
+// timers of a process behind a single wakeup.
+//
+// Time is divided in ticks of |tick_ms|. The wheel has kNumLevels levels of
+// kSlotsPerLevel slots each. A slot of level 0 holds the timers due in one
+// tick, and a slot of level N holds the timers due in kSlotsPerLevel^N ticks.
+// Timers move down one level each time the wheel turns past their slot of
+// the upper level, so scheduling, cancelling, and expiring a timer take
+// constant time regardless of the number of timers.
+//
+// The wheel does not own a thread or a clock. The caller passes the current
+// time to each method, sleeps until NextWakeupMs(), then calls Advance() to
+// collect the timers which are due. This makes the wheel testable with a fake
+// clock. A periodic timer returned by Advance() is out of the wheel until the
+// caller calls Rearm() after running its callback, so that the interval is
+// measured from the completion of the callback.
+//
+// Two features reduce the number of wakeups:
+// - jitter: each period of a timer is randomly shortened or lengthened by up
+//   to |jitter_percent| of its interval, which spreads the load of the timers
+//   of many clients on the servers.
+// - coalescing: NextWakeupMs() is delayed from the earliest deadline to the
+//   latest deadline which falls within |coalescing_window_ms| after it, so
+//   that these timers expire on the same wakeup. A timer with no other
+//   deadline in its window expires on time. Timers never expire before their
+//   deadline.
+//
+// This file has no platform dependencies.
+
+#ifndef OMAHA_CORE_TIMER_WHEEL_H_
+#define OMAHA_CORE_TIMER_WHEEL_H_
+
+#include <stdint.h>
+
+#include <functional>
+#include <list>
+#include <map>
+#include <mutex>
+#include <random>
+#include <vector>
+
+#include "base/basictypes.h"
+
+namespace omaha {
+
+class TimerWheel {
+ public:
+  using Callback = std::function<void()>;
+
+  static const int kNumLevels = 4;
+  static const int kBitsPerLevel = 6;
+  static const int kSlotsPerLevel = 1 << kBitsPerLevel;
+
+  struct Options {
+    // The resolution of the wheel. Deadlines are rounded up to a tick.
+    int64_t tick_ms = 1;
+
+    // How long the wakeup for a deadline can be delayed so that it handles
+    // the deadlines which follow it. The wakeup is only delayed to a deadline
+    // which is within the window.
+    int64_t coalescing_window_ms = 0;
+
+    // A timer which expires later than its deadline plus one tick, the
+    // coalescing window, and this tolerance is counted as a missed deadline.
+    int64_t missed_deadline_tolerance_ms = 1000;
+
+    uint32_t random_seed = 0;
+  };
+
+  struct Stats {
+    uint64_t num_wakeups = 0;
+    uint64_t num_empty_wakeups = 0;
+    uint64_t num_expired = 0;
+    uint64_t num_missed_deadlines = 0;
+    int64_t max_lateness_ms = 0;
+    int64_t total_lateness_ms = 0;
+  };
+
+  // A timer due to run, returned by Advance().
+  struct Expired {
+    int id = 0;
+    int64_t deadline_ms = 0;
+    int64_t lateness_ms = 0;
+    Callback callback;
+  };
+
+  TimerWheel(const Options& options, int64_t now_ms);
+  ~TimerWheel();
+
+  // Schedules |callback| to run after |delay_ms|, then every |interval_ms| if
+  // |interval_ms| is positive. |jitter_percent| applies to the interval only.
+  // Returns the id of the timer.
+  int Schedule(int64_t now_ms,
+               int64_t delay_ms,
+               int64_t interval_ms,
+               int jitter_percent,
+               Callback callback);
+
+  // Cancels a timer. Returns false if the timer does not exist, for instance
+  // if it was a one-shot timer which already expired. A periodic timer can be
+  // cancelled while its callback runs, in which case Rearm() does nothing.
+  bool Cancel(int id);
+
+  // Schedules the next period of the periodic timer |id| returned by
+  // Advance(), |interval_ms| after |now_ms|. The caller calls it once the
+  // callback of the timer completes. Does nothing for one-shot timers and
+  // cancelled timers.
+  void Rearm(int id, int64_t now_ms);
+
+  // Returns the time at which the caller should call Advance(), or -1 if no
+  // timer is scheduled. The time is never earlier than the wheel's current
+  // tick.
+  int64_t NextWakeupMs() const;
+
+  // Expires the timers due at |now_ms|. The callbacks are returned instead of
+  // being run so that the caller runs them without holding any lock; they may
+  // call back into the wheel. The periodic timers wait for Rearm().
+  std::vector<Expired> Advance(int64_t now_ms);
+
+  size_t num_timers() const;
+  Stats stats() const;
+
+ private:
+  struct Timer {
+    int id = 0;
+    int64_t deadline_ms = 0;
+    int64_t interval_ms = 0;
+    int jitter_percent = 0;
+    Callback callback;
+  };
+
+  using Slot = std::list<Timer>;
+
+  struct Location {
+    int level = 0;
+    int slot = 0;
+    Slot::iterator it;
+  };
+
+  int64_t ToTick(int64_t time_ms) const;
+
+  // Moves the timer at the front of |from| to the slot matching its deadline.
+  void PlaceFrontLocked(Slot* from);
+
+  // Moves the timers of the slot of |level| down to the lower levels.
+  void CascadeLocked(int level, int slot);
+
+  // Returns the next deadline of a periodic timer whose callback completed at
+  // |now_ms|.
+  int64_t NextDeadlineLocked(const Timer& timer, int64_t now_ms);
+
+  const Options options_;
+
+  mutable std::mutex lock_;
+
+  // The next tick to process.
+  int64_t current_tick_;
+
+  Slot slots_[kNumLevels][kSlotsPerLevel];
+  std::map<int, Location> locations_;
+
+  // The periodic timers which expired and wait for Rearm().
+  std::map<int, Timer> running_;
+
+  int next_id_;
+  std::mt19937 random_;
+  Stats stats_;
+
+  DISALLOW_COPY_AND_ASSIGN(TimerWheel);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_CORE_TIMER_WHEEL_H_
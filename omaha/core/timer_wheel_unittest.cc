@@ -0,0 +1,330 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/core/timer_wheel.h"
+
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace omaha {
+
+namespace {
+
+const int64_t kSecondMs = 1000;
+const int64_t kMinuteMs = 60 * kSecondMs;
+const int64_t kHourMs = 60 * kMinuteMs;
+const int64_t kDayMs = 24 * kHourMs;
+
+TimerWheel::Options MakeOptions(int64_t tick_ms, int64_t coalescing_window_ms) {
+  TimerWheel::Options options;
+  options.tick_ms = tick_ms;
+  options.coalescing_window_ms = coalescing_window_ms;
+  return options;
+}
+
+// Drives the wheel with a fake clock: sleeps until the next wakeup and runs
+// the expired timers, until |end_ms|.
+void RunUntil(TimerWheel* wheel, int64_t end_ms, int64_t* now_ms) {
+  for (;;) {
+    const int64_t wakeup_ms = wheel->NextWakeupMs();
+    if (wakeup_ms < 0 || wakeup_ms > end_ms) {
+      break;
+    }
+    *now_ms = std::max(*now_ms, wakeup_ms);
+    for (auto& expired : wheel->Advance(*now_ms)) {
+      expired.callback();
+      wheel->Rearm(expired.id, *now_ms);
+    }
+  }
+  *now_ms = end_ms;
+}
+
+}  // namespace
+
+TEST(TimerWheelTest, OneShotExpiresAtDeadline) {
+  int64_t now_ms = 5;
+  TimerWheel wheel(MakeOptions(1, 0), now_ms);
+  EXPECT_EQ(-1, wheel.NextWakeupMs());
+
+  int count = 0;
+  const int id = wheel.Schedule(now_ms, 100, 0, 0, [&count]() { ++count; });
+  EXPECT_EQ(1, wheel.num_timers());
+  EXPECT_EQ(105, wheel.NextWakeupMs());
+
+  EXPECT_TRUE(wheel.Advance(104).empty());
+  std::vector<TimerWheel::Expired> expired = wheel.Advance(105);
+  ASSERT_EQ(1, expired.size());
+  EXPECT_EQ(id, expired[0].id);
+  EXPECT_EQ(105, expired[0].deadline_ms);
+  EXPECT_EQ(0, expired[0].lateness_ms);
+  expired[0].callback();
+  EXPECT_EQ(1, count);
+
+  EXPECT_EQ(0, wheel.num_timers());
+  EXPECT_EQ(-1, wheel.NextWakeupMs());
+  EXPECT_FALSE(wheel.Cancel(id));
+}
+
+TEST(TimerWheelTest, PeriodicTimer) {
+  int64_t now_ms = 0;
+  TimerWheel wheel(MakeOptions(1, 0), now_ms);
+
+  std::vector<int64_t> times;
+  wheel.Schedule(now_ms, 10, 50, 0, [&]() { times.push_back(now_ms); });
+  RunUntil(&wheel, 1000, &now_ms);
+
+  ASSERT_EQ(20, times.size());
+  for (size_t i = 0; i != times.size(); ++i) {
+    EXPECT_EQ(10 + 50 * static_cast<int64_t>(i), times[i]);
+  }
+  EXPECT_EQ(20, wheel.stats().num_wakeups);
+  EXPECT_EQ(0, wheel.stats().num_missed_deadlines);
+}
+
+TEST(TimerWheelTest, CancelPeriodicTimer) {
+  int64_t now_ms = 0;
+  TimerWheel wheel(MakeOptions(1, 0), now_ms);
+
+  int count = 0;
+  const int id = wheel.Schedule(now_ms, 10, 10, 0, [&count]() { ++count; });
+  RunUntil(&wheel, 35, &now_ms);
+  EXPECT_EQ(3, count);
+
+  EXPECT_TRUE(wheel.Cancel(id));
+  EXPECT_FALSE(wheel.Cancel(id));
+  RunUntil(&wheel, 100, &now_ms);
+  EXPECT_EQ(3, count);
+  EXPECT_EQ(-1, wheel.NextWakeupMs());
+}
+
+// Timers scheduled across all the levels of the wheel, and beyond its range,
+// expire in order, never before their deadline, and at most one tick late.
+TEST(TimerWheelTest, RandomDeadlinesAcrossLevels) {
+  const int64_t kTickMs = 10;
+  const int kNumTimers = 2000;
+
+  int64_t now_ms = 12345;
+  TimerWheel wheel(MakeOptions(kTickMs, 0), now_ms);
+
+  std::mt19937 random(7);
+  std::uniform_int_distribution<int> exponent(0, 30);
+  int num_expired = 0;
+  int64_t last_deadline_ms = 0;
+  for (int i = 0; i != kNumTimers; ++i) {
+    const int64_t max_delay = static_cast<int64_t>(1) << exponent(random);
+    const int64_t delay_ms =
+        std::uniform_int_distribution<int64_t>(0, max_delay)(random);
+    const int64_t deadline_ms = now_ms + delay_ms;
+    wheel.Schedule(now_ms, delay_ms, 0, 0, [&, deadline_ms]() {
+      EXPECT_GE(now_ms, deadline_ms);
+      EXPECT_LT(now_ms - deadline_ms, kTickMs);
+      EXPECT_LE(last_deadline_ms / kTickMs, deadline_ms / kTickMs + 1);
+      last_deadline_ms = std::max(last_deadline_ms, deadline_ms);
+      ++num_expired;
+    });
+  }
+
+  RunUntil(&wheel, now_ms + (static_cast<int64_t>(1) << 31), &now_ms);
+  EXPECT_EQ(kNumTimers, num_expired);
+  EXPECT_EQ(0, wheel.num_timers());
+  EXPECT_EQ(0, wheel.stats().num_missed_deadlines);
+}
+
+TEST(TimerWheelTest, CoalescesNearbyDeadlines) {
+  int64_t now_ms = 0;
+  TimerWheel wheel(MakeOptions(kSecondMs, kMinuteMs), now_ms);
+
+  std::vector<int64_t> times;
+  auto record = [&]() { times.push_back(now_ms); };
+  wheel.Schedule(now_ms, 10 * kSecondMs, 0, 0, record);
+  wheel.Schedule(now_ms, 30 * kSecondMs, 0, 0, record);
+  wheel.Schedule(now_ms, 50 * kSecondMs, 0, 0, record);
+  wheel.Schedule(now_ms, 200 * kSecondMs, 0, 0, record);
+
+  // The first three timers share the wakeup at the last deadline within the
+  // window of the first one. The last timer is alone in its window.
+  EXPECT_EQ(50 * kSecondMs, wheel.NextWakeupMs());
+  RunUntil(&wheel, kHourMs, &now_ms);
+
+  const std::vector<int64_t> expected = {
+      50 * kSecondMs, 50 * kSecondMs, 50 * kSecondMs, 200 * kSecondMs};
+  EXPECT_EQ(expected, times);
+
+  const TimerWheel::Stats stats = wheel.stats();
+  EXPECT_EQ(2, stats.num_wakeups);
+  EXPECT_EQ(4, stats.num_expired);
+  EXPECT_EQ(40 * kSecondMs, stats.max_lateness_ms);
+  EXPECT_EQ(0, stats.num_missed_deadlines);
+}
+
+// A large coalescing window does not delay a timer which has no other
+// deadline in its window.
+TEST(TimerWheelTest, LoneTimerExpiresOnTime) {
+  int64_t now_ms = 0;
+  TimerWheel wheel(MakeOptions(kSecondMs, 5 * kMinuteMs), now_ms);
+
+  std::vector<int64_t> times;
+  wheel.Schedule(now_ms, 10 * kSecondMs, kHourMs, 0, [&]() {
+    times.push_back(now_ms);
+  });
+  EXPECT_EQ(10 * kSecondMs, wheel.NextWakeupMs());
+  RunUntil(&wheel, 3 * kHourMs, &now_ms);
+
+  const std::vector<int64_t> expected = {
+      10 * kSecondMs, kHourMs + 10 * kSecondMs, 2 * kHourMs + 10 * kSecondMs};
+  EXPECT_EQ(expected, times);
+  EXPECT_EQ(0, wheel.stats().max_lateness_ms);
+}
+
+// The interval of a periodic timer starts when its callback completes, and
+// the timer does not expire again while its callback runs.
+TEST(TimerWheelTest, IntervalStartsWhenCallbackCompletes) {
+  int64_t now_ms = 0;
+  TimerWheel wheel(MakeOptions(1, 0), now_ms);
+
+  std::vector<int64_t> times;
+  const int id = wheel.Schedule(now_ms, 10, 100, 0, [&]() {
+    times.push_back(now_ms);
+  });
+
+  std::vector<TimerWheel::Expired> expired = wheel.Advance(10);
+  ASSERT_EQ(1, expired.size());
+  now_ms = 10;
+  expired[0].callback();
+  EXPECT_EQ(1, wheel.num_timers());
+  EXPECT_EQ(-1, wheel.NextWakeupMs());
+  EXPECT_TRUE(wheel.Advance(500).empty());
+
+  // The callback took 490 ms.
+  now_ms = 500;
+  wheel.Rearm(id, now_ms);
+  EXPECT_EQ(600, wheel.NextWakeupMs());
+  RunUntil(&wheel, 800, &now_ms);
+
+  const std::vector<int64_t> expected = {10, 600, 700, 800};
+  EXPECT_EQ(expected, times);
+
+  // A timer cancelled while its callback runs is not rearmed.
+  expired = wheel.Advance(900);
+  ASSERT_EQ(1, expired.size());
+  EXPECT_TRUE(wheel.Cancel(id));
+  wheel.Rearm(id, 900);
+  EXPECT_EQ(0, wheel.num_timers());
+  EXPECT_EQ(-1, wheel.NextWakeupMs());
+}
+
+TEST(TimerWheelTest, JitteredInterval) {
+  const int64_t kIntervalMs = kHourMs;
+
+  int64_t now_ms = 0;
+  TimerWheel::Options options(MakeOptions(kSecondMs, 0));
+  options.random_seed = 42;
+  TimerWheel wheel(options, now_ms);
+
+  std::vector<int64_t> times;
+  wheel.Schedule(now_ms, 0, kIntervalMs, 10, [&]() {
+    times.push_back(now_ms);
+  });
+  RunUntil(&wheel, 100 * kIntervalMs, &now_ms);
+
+  ASSERT_LE(90, times.size());
+  bool has_different_intervals = false;
+  for (size_t i = 1; i != times.size(); ++i) {
+    const int64_t interval_ms = times[i] - times[i - 1];
+    EXPECT_GE(interval_ms, kIntervalMs * 9 / 10);
+    EXPECT_LE(interval_ms, kIntervalMs * 11 / 10 + kSecondMs);
+    if (interval_ms != times[1] - times[0]) {
+      has_different_intervals = true;
+    }
+  }
+  EXPECT_TRUE(has_different_intervals);
+}
+
+TEST(TimerWheelTest, MissedDeadlines) {
+  int64_t now_ms = 0;
+  TimerWheel wheel(MakeOptions(kSecondMs, 0), now_ms);
+
+  int count = 0;
+  wheel.Schedule(now_ms, kMinuteMs, kMinuteMs, 0, [&count]() { ++count; });
+
+  // The machine sleeps for an hour. The timer expires once, late, instead of
+  // once for each missed period.
+  now_ms = kHourMs;
+  for (auto& expired : wheel.Advance(now_ms)) {
+    EXPECT_EQ(kHourMs - kMinuteMs, expired.lateness_ms);
+    expired.callback();
+    wheel.Rearm(expired.id, now_ms);
+  }
+  EXPECT_EQ(1, count);
+  EXPECT_EQ(kHourMs + kMinuteMs, wheel.NextWakeupMs());
+
+  const TimerWheel::Stats stats = wheel.stats();
+  EXPECT_EQ(1, stats.num_missed_deadlines);
+  EXPECT_EQ(kHourMs - kMinuteMs, stats.max_lateness_ms);
+}
+
+// A timer scheduled from a callback is handled by the same wheel.
+TEST(TimerWheelTest, ScheduleFromCallback) {
+  int64_t now_ms = 0;
+  TimerWheel wheel(MakeOptions(1, 0), now_ms);
+
+  std::vector<int64_t> times;
+  wheel.Schedule(now_ms, 10, 0, 0, [&]() {
+    times.push_back(now_ms);
+    wheel.Schedule(now_ms, 5, 0, 0, [&]() { times.push_back(now_ms); });
+  });
+  RunUntil(&wheel, 100, &now_ms);
+
+  const std::vector<int64_t> expected = {10, 15};
+  EXPECT_EQ(expected, times);
+}
+
+// Simulates a day of the periodic work of the core process and compares the
+// number of wakeups with and without coalescing.
+TEST(TimerWheelTest, CoreWakeupsPerDay) {
+  struct {
+    int64_t delay_ms;
+    int64_t interval_ms;
+  } const kTimers[] = {
+    {kHourMs, 5 * kHourMs},    // Update worker.
+    {kDayMs, kDayMs},          // Code red.
+    {kHourMs, kHourMs},        // Metrics aggregation.
+    {10 * kMinuteMs, 5 * kHourMs},  // Metrics collection.
+  };
+
+  uint64_t num_wakeups[2] = {};
+  for (int coalesce = 0; coalesce != 2; ++coalesce) {
+    int64_t now_ms = 0;
+    TimerWheel::Options options(
+        MakeOptions(kSecondMs, coalesce ? 5 * kMinuteMs : 0));
+    options.random_seed = 1;
+    TimerWheel wheel(options, now_ms);
+    for (const auto& timer : kTimers) {
+      wheel.Schedule(now_ms, timer.delay_ms, timer.interval_ms, 10, []() {});
+    }
+    RunUntil(&wheel, 7 * kDayMs, &now_ms);
+    num_wakeups[coalesce] = wheel.stats().num_wakeups;
+    EXPECT_EQ(0, wheel.stats().num_missed_deadlines);
+  }
+
+  std::cout << "Wakeups per day without coalescing: " << num_wakeups[0] / 7
+            << ", with coalescing: " << num_wakeups[1] / 7 << std::endl;
+  EXPECT_LT(num_wakeups[1], num_wakeups[0]);
+}
+
+}  // namespace omaha
@@ -19,11 +19,13 @@
 #include "omaha/base/debug.h"
 #include "omaha/base/logging.h"
 #include "omaha/base/safe_format.h"
+#include "omaha/base/string.h"
 #include "omaha/base/synchronized.h"
 #include "omaha/base/time.h"
 #include "omaha/common/config_manager.h"
 #include "omaha/common/const_group_policy.h"
 #include "omaha/common/experiment_labels.h"
+#include "omaha/goopdate/app_bundle.h"
 #include "omaha/goopdate/app_command_model.h"
 #include "omaha/goopdate/app_manager.h"
 #include "omaha/goopdate/app_state.h"
@@ -1098,6 +1100,11 @@ void App::Downloading() {
   app_state_->Downloading(this);
 }
 
+void App::ApplyingDifferentialPatch() {
+  __mutexScope(model()->lock());
+  app_state_->ApplyingDifferentialPatch(this);
+}
+
 void App::DownloadComplete() {
   __mutexScope(model()->lock());
   app_state_->DownloadComplete(this);
@@ -1154,6 +1161,45 @@ void App::ChangeState(fsm::AppState* app_state) {
   if (ping_event.get()) {
     AddPingEvent(ping_event);
   }
+  PublishStateChange();
+}
+
+// Unlike get_currentState(), this does not read the installer progress from
+// the registry, since this is called on every state transition and download
+// progress notification.
+void App::PublishStateChange() {
+  ASSERT1(model()->IsLockedByCaller());
+
+  AppStateInfo info;
+  info.state = state();
+  info.error_code = error_context_.error_code;
+  info.is_canceled = is_canceled_;
+
+  switch (info.state) {
+    case STATE_WAITING_TO_DOWNLOAD:
+    case STATE_RETRYING_DOWNLOAD:
+    case STATE_DOWNLOADING:
+    case STATE_DOWNLOAD_COMPLETE:
+    case STATE_EXTRACTING:
+    case STATE_APPLYING_DIFFERENTIAL_PATCH:
+    case STATE_READY_TO_INSTALL: {
+      LONG download_time_remaining_ms = kCurrentStateProgressUnknown;
+      uint64 next_download_retry_time = 0;
+      VERIFY_SUCCEEDED(GetDownloadProgress(&info.bytes_downloaded,
+                                           &info.total_bytes_to_download,
+                                           &download_time_remaining_ms,
+                                           &next_download_retry_time));
+      break;
+    }
+    case STATE_INSTALL_COMPLETE:
+      info.install_progress_percentage = 100;
+      break;
+    default:
+      break;
+  }
+
+  app_bundle_->state_change_channel()->Publish(
+      std::string(WideToUtf8(app_guid_string())), info);
 }
 
 void App::SetError(const ErrorContext& error_context, const CString& message) {
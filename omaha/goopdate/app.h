@@ -292,6 +292,10 @@ class App : public ModelObject {
   // Reports that the download is in progress. May be called multiple times.
   void Downloading();
 
+  // Reports that a differential package is being applied. The app reports
+  // Downloading() when the patch is done.
+  void ApplyingDifferentialPatch();
+
   // Reports that all packages have been downloaded.
   void DownloadComplete();
 
@@ -387,6 +391,10 @@ class App : public ModelObject {
   // Deletes "InstallerProgress" under Google\\Update\\ClientState\\{AppID}.
   HRESULT ResetInstallProgress();
 
+  // Publishes the current state and download progress of the app to the
+  // state change channel of the bundle. The caller must hold the model lock.
+  void PublishStateChange();
+
  private:
   // TODO(omaha): accessing directly the data members bypasses locking. Review
   // the places where members are accessed by friends and check the caller locks
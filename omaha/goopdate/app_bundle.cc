@@ -17,6 +17,7 @@
 
 #include <atlsafe.h>
 #include <intsafe.h>
+#include <utility>
 
 #include "omaha/base/error.h"
 #include "omaha/base/logging.h"
@@ -34,6 +35,7 @@
 #include "omaha/goopdate/app_manager.h"
 #include "omaha/goopdate/goopdate.h"
 #include "omaha/goopdate/model.h"
+#include "omaha/goopdate/state_change_event.h"
 #include "omaha/goopdate/update_request_utils.h"
 
 namespace omaha {
@@ -267,14 +269,15 @@ HRESULT AppBundle::SendPingEventsAsync() {
 
   using Callback =
     StaticThreadPoolCallBack1<internal::SendPingEventsParameters>;
-  HRESULT hr = Goopdate::Instance().QueueUserWorkItem(
-      std::make_unique<Callback>(
-            &AppBundle::SendPingEvents,
-            internal::SendPingEventsParameters(
-                ping.get(),
-                token.GetHandle())),
-            COINIT_MULTITHREADED,
-            WT_EXECUTELONGFUNCTION);
+  auto callback = std::make_unique<Callback>(
+      &AppBundle::SendPingEvents,
+      internal::SendPingEventsParameters(ping.get(), token.GetHandle()));
+
+  // Pings are not time-sensitive and run behind the installs and the update
+  // checks.
+  callback->set_priority(WorkStealingExecutor::kPriorityIdle);
+  HRESULT hr = Goopdate::Instance().QueueUserWorkItem(std::move(callback),
+                                                      COINIT_MULTITHREADED);
   if (FAILED(hr)) {
     CORE_LOG(LE, (_T("[QueueUserWorkItem failed][0x%x]"), hr));
     return hr;
@@ -759,6 +762,12 @@ void AppBundle::CompleteAsyncCall() {
   VERIFY_SUCCEEDED(app_bundle_state_->CompleteAsyncCall(this));
 
   user_work_item_ = NULL;
+
+  // The bundle is no longer busy, which the client may be waiting for after
+  // the last app changed its state.
+  if (state_change_event_.get()) {
+    state_change_event_->Signal();
+  }
 }
 
 bool AppBundle::IsBusy() const {
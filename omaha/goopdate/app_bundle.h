@@ -34,6 +34,7 @@
 #include "omaha/common/ping.h"
 #include "omaha/goopdate/com_wrapper_creator.h"
 #include "omaha/goopdate/model_object.h"
+#include "omaha/goopdate/state_change_channel.h"
 #include "omaha/net/proxy_auth.h"
 #include "omaha/third_party/smartany/scoped_any.h"
 
@@ -45,6 +46,7 @@ namespace omaha {
 
 class App;
 class Model;
+class StateChangeEvent;
 class WebServicesClientInterface;
 class UserWorkItem;
 
@@ -179,6 +181,10 @@ class AppBundle
   // in the registry.
   HRESULT BuildAndPersistPing();
 
+  // Returns the channel that pushes the state changes of the apps in the
+  // bundle to subscribers.
+  StateChangeChannel* state_change_channel() { return &state_change_channel_; }
+
  private:
   // Sets the state for unit testing.
   friend void SetAppBundleStateForUnitTest(AppBundle* app_bundle,
@@ -267,6 +273,12 @@ class AppBundle
   // COM caller's display language.
   CString display_language_;
 
+  StateChangeChannel state_change_channel_;
+
+  // Wakes up the client, which waits on the event named by |session_id_|,
+  // when the state of the apps changes. Created by initialize().
+  std::unique_ptr<StateChangeEvent> state_change_event_;
+
   friend class fsm::AppBundleState;
   friend class fsm::AppBundleStateInit;
 
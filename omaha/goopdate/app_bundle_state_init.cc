@@ -20,9 +20,11 @@
 #include "omaha/base/user_rights.h"
 #include "omaha/base/utils.h"
 #include "omaha/common/config_manager.h"
+#include "omaha/common/sharded_web_services_client.h"
 #include "omaha/common/web_services_client.h"
 #include "omaha/goopdate/app_bundle_state_initialized.h"
 #include "omaha/goopdate/model.h"
+#include "omaha/goopdate/state_change_event.h"
 
 namespace omaha {
 
@@ -106,7 +108,20 @@ HRESULT AppBundleStateInit::Initialize(AppBundle* app_bundle) {
     GetGuid(&app_bundle->session_id_);
   }
 
-  HRESULT hr = app_bundle->CaptureCallerImpersonationToken();
+  // The client waits on the event named by the session ID instead of polling
+  // the states of the apps. The client polls if the event cannot be created.
+  auto state_change_event = std::make_unique<StateChangeEvent>();
+  HRESULT hr = state_change_event->Initialize(
+      app_bundle->is_machine(),
+      app_bundle->session_id_,
+      app_bundle->state_change_channel());
+  if (SUCCEEDED(hr)) {
+    app_bundle->state_change_event_.reset(state_change_event.release());
+  } else {
+    CORE_LOG(LW, (_T("[StateChangeEvent::Initialize failed][0x%08x]"), hr));
+  }
+
+  hr = app_bundle->CaptureCallerImpersonationToken();
   if (FAILED(hr)) {
     return hr;
   }
@@ -115,14 +130,35 @@ HRESULT AppBundleStateInit::Initialize(AppBundle* app_bundle) {
   CString update_check_url;
   VERIFY_SUCCEEDED(
       ConfigManager::Instance()->GetUpdateCheckUrl(&update_check_url));
-  auto web_service_client = std::make_unique<WebServicesClient>(
-      app_bundle->is_machine());
-  hr = web_service_client->Initialize(update_check_url, HeadersVector(), true);
-  if (FAILED(hr)) {
-    CORE_LOG(LE, (_T("[Update check client init failed][0x%08x]"), hr));
-    return hr;
+
+  // Large update checks are sent as several concurrent requests, if the
+  // UpdateCheckShardSize policy is set.
+  const int shard_size =
+      ConfigManager::Instance()->GetUpdateCheckShardSize(NULL);
+  if (shard_size > 0) {
+    auto web_service_client = std::make_unique<ShardedWebServicesClient>(
+        app_bundle->is_machine());
+    hr = web_service_client->Initialize(update_check_url,
+                                        HeadersVector(),
+                                        true,
+                                        shard_size);
+    if (FAILED(hr)) {
+      CORE_LOG(LE, (_T("[Update check client init failed][0x%08x]"), hr));
+      return hr;
+    }
+    app_bundle->update_check_client_.reset(web_service_client.release());
+  } else {
+    auto web_service_client = std::make_unique<WebServicesClient>(
+        app_bundle->is_machine());
+    hr = web_service_client->Initialize(update_check_url,
+                                        HeadersVector(),
+                                        true);
+    if (FAILED(hr)) {
+      CORE_LOG(LE, (_T("[Update check client init failed][0x%08x]"), hr));
+      return hr;
+    }
+    app_bundle->update_check_client_.reset(web_service_client.release());
   }
-  app_bundle->update_check_client_.reset(web_service_client.release());
 
   ChangeState(app_bundle, new AppBundleStateInitialized);
   return S_OK;
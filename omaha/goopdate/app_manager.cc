@@ -141,6 +141,62 @@ AppManager::AppManager(bool is_machine)
   CORE_LOG(L3, (_T("[AppManager::AppManager][is_machine=%d]"), is_machine));
 }
 
+AppManager::RegistryStableStateLock::RegistryStableStateLock()
+    : num_installs_(0) {
+  VERIFY1(no_installs_.Open());
+}
+
+AppManager::RegistryStableStateLock::~RegistryStableStateLock() {
+  ASSERT1(!num_installs_);
+}
+
+// A thread which already holds the lock, for instance to install an app,
+// acquires it again without waiting for the installs to finish.
+bool AppManager::RegistryStableStateLock::Lock() const {
+  if (lock_.GetOwner() == ::GetCurrentThreadId()) {
+    return lock_.Lock();
+  }
+
+  for (;;) {
+    if (!no_installs_.Wait(INFINITE) || !lock_.Lock()) {
+      return false;
+    }
+    if (!num_installs_) {
+      return true;
+    }
+
+    // An install began between the wait and the lock.
+    VERIFY1(lock_.Unlock());
+  }
+}
+
+bool AppManager::RegistryStableStateLock::Unlock() const {
+  return lock_.Unlock();
+}
+
+void AppManager::RegistryStableStateLock::BeginInstall() {
+  ASSERT1(lock_.GetOwner() == ::GetCurrentThreadId());
+  if (!num_installs_++) {
+    VERIFY1(no_installs_.Close());
+  }
+}
+
+void AppManager::RegistryStableStateLock::EndInstall() {
+  ASSERT1(lock_.GetOwner() == ::GetCurrentThreadId());
+  ASSERT1(num_installs_ > 0);
+  if (!--num_installs_) {
+    VERIFY1(no_installs_.Open());
+  }
+}
+
+void AppManager::BeginInstall() {
+  registry_stable_state_lock_.BeginInstall();
+}
+
+void AppManager::EndInstall() {
+  registry_stable_state_lock_.EndInstall();
+}
+
 // App installers should use similar code to create a lock to acquire while
 // modifying Omaha registry.
 bool AppManager::InitializeRegistryLock() {
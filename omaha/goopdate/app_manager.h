@@ -192,10 +192,22 @@ class AppManager {
   // state (i.e. no app is being installed). Acquire this lock before calling
   // read functions if you require a consistent/stable snapshot of the system
   // (for example, to determine whether Omaha should install). Because this
-  // lock is held throughout app install, the Lock() call could block for
-  // seconds or more.
+  // lock is not granted while any app is being installed, the Lock() call
+  // could block for seconds or more.
   Lockable& GetRegistryStableStateLock() { return registry_stable_state_lock_; }
 
+  // Returns a reference to the lock held while an app is being installed,
+  // except while its installer runs. Unlike GetRegistryStableStateLock(), it
+  // is granted while the installers of other apps run. The write functions
+  // accept either lock.
+  Lockable& GetInstallLock() { return registry_stable_state_lock_.lock(); }
+
+  // Mark the start and the end of the install of an app. The registry is not
+  // in a stable state in between, even while GetInstallLock() is released for
+  // the installer to run. Both must be called with GetInstallLock() held.
+  void BeginInstall();
+  void EndInstall();
+
   // Gets the time since InstallTime was written. Returns 0 if InstallTime
   // could not be read. This could occur if the app is not already installed or
   // there is no valid install time in the registry, which can occur for apps
@@ -275,7 +287,8 @@ class AppManager {
                                      int elpased_days_since_datum) const;
 
   bool IsRegistryStableStateLockedByCaller() const {
-    return ::GetCurrentThreadId() == registry_stable_state_lock_.GetOwner();
+    return ::GetCurrentThreadId() ==
+           registry_stable_state_lock_.lock().GetOwner();
   }
 
   CString GetCurrentStateKeyName(const CString& app_guid) const;
@@ -296,7 +309,31 @@ class AppManager {
   // installed and no installer is running that might be modifying the
   // registry.) Uninstalls are still an issue unless the app uninstaller informs
   // Omaha that it is uninstalling the app.
-  LLock registry_stable_state_lock_;
+  // Lock() waits until no app is being installed, then acquires the
+  // underlying lock(), which the installs hold while they write the registry.
+  class RegistryStableStateLock : public Lockable {
+   public:
+    RegistryStableStateLock();
+    virtual ~RegistryStableStateLock();
+    virtual bool Lock() const;
+    virtual bool Unlock() const;
+
+    LLock& lock() { return lock_; }
+    const LLock& lock() const { return lock_; }
+
+    // Must be called with lock() held.
+    void BeginInstall();
+    void EndInstall();
+
+   private:
+    LLock lock_;
+    int num_installs_;           // Protected by lock_.
+    mutable Gate no_installs_;   // Open while num_installs_ is 0.
+
+    DISALLOW_COPY_AND_ASSIGN(RegistryStableStateLock);
+  };
+
+  RegistryStableStateLock registry_stable_state_lock_;
 
   static AppManager* instance_;
 
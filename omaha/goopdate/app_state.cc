@@ -71,6 +71,10 @@ void AppState::Downloading(App* app) {
   HandleInvalidStateTransition(app, _T(__FUNCTION__));
 }
 
+void AppState::ApplyingDifferentialPatch(App* app) {
+  HandleInvalidStateTransition(app, _T(__FUNCTION__));
+}
+
 void AppState::DownloadComplete(App* app) {
   HandleInvalidStateTransition(app, _T(__FUNCTION__));
 }
@@ -75,6 +75,8 @@ class AppState {
 
   virtual void Downloading(App* app);
 
+  virtual void ApplyingDifferentialPatch(App* app);
+
   virtual void DownloadComplete(App* app);
 
   virtual void MarkReadyToInstall(App* app);
@@ -16,6 +16,7 @@
 #include "omaha/goopdate/app_state_downloading.h"
 #include "omaha/base/debug.h"
 #include "omaha/base/logging.h"
+#include "omaha/goopdate/app_state_applying_differential_patch.h"
 #include "omaha/goopdate/app_state_download_complete.h"
 #include "omaha/goopdate/model.h"
 
@@ -31,7 +32,11 @@ const PingEvent* AppStateDownloading::CreatePingEvent(
     App* app,
     CurrentState previous_state) const {
   ASSERT1(app);
-  UNREFERENCED_PARAMETER(previous_state);
+
+  // The download started before the differential patch was applied.
+  if (previous_state == STATE_APPLYING_DIFFERENTIAL_PATCH) {
+    return NULL;
+  }
 
   const PingEvent::Types event_type(app->is_update() ?
       PingEvent::EVENT_UPDATE_DOWNLOAD_START :
@@ -43,6 +48,13 @@ const PingEvent* AppStateDownloading::CreatePingEvent(
   return new PingEvent(event_type, GetCompletionResult(*app), error_code, 0);
 }
 
+void AppStateDownloading::ApplyingDifferentialPatch(App* app) {
+  CORE_LOG(L3, (_T("[AppStateDownloading::ApplyingDifferentialPatch][%p]"),
+                app));
+  ASSERT1(app);
+  ChangeState(app, new AppStateApplyingDifferentialPatch);
+}
+
 void AppStateDownloading::DownloadComplete(App* app) {
   CORE_LOG(L3, (_T("[AppStateDownloading::DownloadComplete][%p]"), app));
   ASSERT1(app);
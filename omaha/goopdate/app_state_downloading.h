@@ -31,6 +31,7 @@ class AppStateDownloading : public AppState {
   virtual const PingEvent* CreatePingEvent(App* app,
                                            CurrentState previous_state) const;
 
+  virtual void ApplyingDifferentialPatch(App* app);
   virtual void DownloadComplete(App* app);
 
  private:
@@ -107,6 +107,16 @@ const PingEvent* AppStateError::CreatePingEvent(
                        app->GetInstallTimeMs());
 }
 
+void AppStateError::Downloading(App* app) {
+  CORE_LOG(L3, (_T("[AppStateError::Downloading][0x%p]"), app));
+  UNREFERENCED_PARAMETER(app);
+}
+
+void AppStateError::ApplyingDifferentialPatch(App* app) {
+  CORE_LOG(L3, (_T("[AppStateError::ApplyingDifferentialPatch][0x%p]"), app));
+  UNREFERENCED_PARAMETER(app);
+}
+
 void AppStateError::DownloadComplete(App* app) {
   CORE_LOG(L3, (_T("[AppStateError::DownloadComplete][0x%p]"), app));
   UNREFERENCED_PARAMETER(app);
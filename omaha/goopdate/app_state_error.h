@@ -45,6 +45,8 @@ class AppStateError : public AppState {
   // have succeeded or failed due to the cancellation. The race condition is
   // resolved when the transition call reaches this object and the call is
   // ignored.
+  virtual void Downloading(App* app);
+  virtual void ApplyingDifferentialPatch(App* app);
   virtual void DownloadComplete(App* app);
   virtual void MarkReadyToInstall(App* app);
 
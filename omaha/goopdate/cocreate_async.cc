@@ -88,8 +88,7 @@ HRESULT CoCreateAsyncStatus::CreateOmahaMachineServerAsync(
                                  &CoCreateAsyncStatus::CreateOmahaMachineServer,
                                  origin_url,
                                  create_elevated),
-      COINIT_MULTITHREADED,
-      WT_EXECUTELONGFUNCTION);
+      COINIT_MULTITHREADED);
   if (FAILED(hr)) {
     CORE_LOG(LE, (_T("[QueueUserWorkItem failed][0x%x]"), hr));
     return hr;
@@ -484,6 +484,9 @@ class MockHttpRequest : public HttpRequestInterface {
   MOCK_METHOD1(set_filename, void(const CString& filename));
   MOCK_METHOD1(set_low_priority, void(bool low_priority));
   MOCK_METHOD1(set_callback, void(NetworkRequestCallback* callback));
+  MOCK_METHOD1(set_response_observer, void(ResponseObserver* observer));
+  MOCK_METHOD3(set_resumable,
+               void(bool is_resumable, int content_length, int offset));
   MOCK_METHOD1(set_additional_headers, void(const CString& additional_headers));
   MOCK_CONST_METHOD0(user_agent, CString());
   MOCK_METHOD1(set_user_agent, void(const CString& user_agent));
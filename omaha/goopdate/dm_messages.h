@@ -178,6 +178,12 @@ struct CachedOmahaPolicy {
   CString download_preference;
   int64_t cache_size_limit = -1;
   int64_t cache_life_limit = -1;
+  int64_t download_rate_limit = -1;
+  int64_t background_download_rate_limit = -1;
+  CString peer_cache_urls;
+  int64_t peer_cache_server_port = -1;
+  int64_t max_concurrent_installs = -1;
+  int64_t update_check_shard_size = -1;
   UpdatesSuppressed updates_suppressed;
   CString proxy_mode;
   CString proxy_server;
@@ -201,6 +207,23 @@ struct CachedOmahaPolicy {
                             cache_size_limit);
     SafeCStringAppendFormat(&result, _T("[cache_life_limit][%" _T(PRId64) "]"),
                             cache_life_limit);
+    SafeCStringAppendFormat(&result,
+                            _T("[download_rate_limit][%" _T(PRId64) "]"),
+                            download_rate_limit);
+    SafeCStringAppendFormat(
+        &result, _T("[background_download_rate_limit][%" _T(PRId64) "]"),
+        background_download_rate_limit);
+    SafeCStringAppendFormat(&result, _T("[peer_cache_urls][%s]"),
+                            peer_cache_urls);
+    SafeCStringAppendFormat(
+        &result, _T("[peer_cache_server_port][%" _T(PRId64) "]"),
+        peer_cache_server_port);
+    SafeCStringAppendFormat(
+        &result, _T("[max_concurrent_installs][%" _T(PRId64) "]"),
+        max_concurrent_installs);
+    SafeCStringAppendFormat(
+        &result, _T("[update_check_shard_size][%" _T(PRId64) "]"),
+        update_check_shard_size);
     SafeCStringAppendFormat(
         &result,
         _T("[updates_suppressed]") _T(
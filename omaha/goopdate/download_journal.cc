@@ -0,0 +1,195 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/download_journal.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+
+#include "omaha/base/record_io.h"
+
+namespace omaha {
+
+namespace {
+
+std::string ToLower(const std::string& value) {
+  std::string lower(value);
+  std::transform(lower.begin(), lower.end(), lower.begin(),
+                 [](char c) { return static_cast<char>(::tolower(c)); });
+  return lower;
+}
+
+}  // namespace
+
+const char DownloadJournal::kMagic[4] = {'O', 'D', 'J', '1'};
+
+DownloadJournal::DownloadJournal() : size_(0), bytes_written_(0) {
+  SHA256_init(&hash_);
+}
+
+DownloadJournal::~DownloadJournal() {
+}
+
+void DownloadJournal::Start(const std::string& url,
+                            const std::string& expected_hash,
+                            uint64_t size) {
+  url_ = url;
+  expected_hash_ = ToLower(expected_hash);
+  size_ = size;
+  Rewind();
+}
+
+bool DownloadJournal::IsFor(const std::string& expected_hash,
+                            uint64_t size) const {
+  return !expected_hash_.empty() &&
+         expected_hash_ == ToLower(expected_hash) &&
+         size_ == size;
+}
+
+void DownloadJournal::Append(const void* data, size_t size) {
+  SHA256_update(&hash_, data, size);
+  bytes_written_ += size;
+}
+
+void DownloadJournal::Rewind() {
+  bytes_written_ = 0;
+  SHA256_init(&hash_);
+}
+
+std::string DownloadJournal::GetHash() const {
+  // Finishing the hash changes its context, so a copy is finished.
+  LITE_SHA256_CTX hash = hash_;
+  const uint8_t* digest = SHA256_final(&hash);
+
+  static const char kHexDigits[] = "0123456789abcdef";
+  std::string hex;
+  for (size_t i = 0; i != SHA256_DIGEST_SIZE; ++i) {
+    hex.push_back(kHexDigits[digest[i] >> 4]);
+    hex.push_back(kHexDigits[digest[i] & 0xF]);
+  }
+  return hex;
+}
+
+std::string DownloadJournal::Serialize() const {
+  std::string contents(kMagic, sizeof(kMagic));
+  AppendString(url_.substr(0, kMaxRecordStringLength), &contents);
+  AppendString(expected_hash_.substr(0, kMaxRecordStringLength), &contents);
+  AppendUint(size_, 8, &contents);
+  AppendUint(bytes_written_, 8, &contents);
+  AppendUint(hash_.count, 8, &contents);
+  contents.append(reinterpret_cast<const char*>(hash_.buf),
+                  sizeof(hash_.buf));
+  for (size_t i = 0; i != arraysize(hash_.state); ++i) {
+    AppendUint(hash_.state[i], sizeof(hash_.state[i]), &contents);
+  }
+  contents.append(RecordChecksum(contents.data(), contents.size()));
+  return contents;
+}
+
+bool DownloadJournal::Parse(const std::string& contents) {
+  if (contents.size() < sizeof(kMagic) + kRecordChecksumSize ||
+      memcmp(contents.data(), kMagic, sizeof(kMagic)) != 0) {
+    return false;
+  }
+
+  const size_t checked_size = contents.size() - kRecordChecksumSize;
+  if (RecordChecksum(contents.data(), checked_size) !=
+      contents.substr(checked_size)) {
+    return false;
+  }
+
+  RecordReader reader(contents.data() + sizeof(kMagic),
+                      checked_size - sizeof(kMagic));
+  std::string url;
+  std::string expected_hash;
+  uint64_t size = 0;
+  uint64_t bytes_written = 0;
+  LITE_SHA256_CTX hash;
+  SHA256_init(&hash);
+  if (!reader.ReadString(&url) ||
+      !reader.ReadString(&expected_hash) ||
+      !reader.ReadUint(8, &size) ||
+      !reader.ReadUint(8, &bytes_written) ||
+      !reader.ReadUint(8, &hash.count) ||
+      !reader.ReadBytes(sizeof(hash.buf), hash.buf)) {
+    return false;
+  }
+  for (size_t i = 0; i != arraysize(hash.state); ++i) {
+    uint64_t word = 0;
+    if (!reader.ReadUint(sizeof(hash.state[i]), &word)) {
+      return false;
+    }
+    hash.state[i] = static_cast<uint32_t>(word);
+  }
+
+  // The hash covers exactly the bytes written.
+  if (reader.remaining() || hash.count != bytes_written ||
+      bytes_written > size) {
+    return false;
+  }
+
+  url_ = url;
+  expected_hash_ = expected_hash;
+  size_ = size;
+  bytes_written_ = bytes_written;
+  hash_ = hash;
+  return true;
+}
+
+bool DownloadJournal::Load(const std::filesystem::path& path) {
+  std::ifstream file(path, std::ios::in | std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  const std::string contents((std::istreambuf_iterator<char>(file)),
+                             std::istreambuf_iterator<char>());
+  return !file.bad() && Parse(contents);
+}
+
+bool DownloadJournal::Save(const std::filesystem::path& path) const {
+  const std::string contents(Serialize());
+
+  std::error_code error;
+  std::filesystem::path temp_path(path);
+  temp_path += ".tmp";
+  {
+    std::ofstream file(temp_path,
+                       std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file) {
+      return false;
+    }
+    file.write(contents.data(), contents.size());
+    file.flush();
+    if (!file.good()) {
+      file.close();
+      std::filesystem::remove(temp_path, error);
+      return false;
+    }
+  }
+
+  std::filesystem::rename(temp_path, path, error);
+  if (error) {
+    std::filesystem::remove(temp_path, error);
+    return false;
+  }
+  return true;
+}
+
+}  // namespace omaha
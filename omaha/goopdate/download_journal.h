@@ -0,0 +1,115 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// DownloadJournal records the progress of the download of a package to a
+// partial file, so that a download stopped by the exit of the process, for
+// instance at shutdown or after a crash, resumes in a later process instead
+// of starting again.
+//
+// The journal holds the url and the expected hash of the package, its size,
+// the number of bytes written to the partial file, and the state of the
+// SHA-256 of these bytes. The hash continues with the bytes received after a
+// resume, so that a resumed package which does not match its expected hash is
+// detected as soon as its download completes.
+//
+// The journal file contains:
+//   magic      4 bytes     kMagic.
+//   url        2-byte little-endian length followed by the UTF-8 url.
+//   hash       2-byte little-endian length followed by the expected hash.
+//   size       8 bytes     Little-endian size of the package.
+//   written    8 bytes     Little-endian number of bytes written.
+//   context    The SHA-256 context: the 8-byte count of bytes hashed, the
+//              pending block, and the little-endian 4-byte state words.
+//   checksum   4 bytes     The first bytes of the SHA-256 of the fields above.
+// Save() writes a temporary file next to the journal, then renames it over
+// the journal. A journal which does not parse is discarded, and the download
+// starts again.
+//
+// This file has no platform dependencies.
+
+#ifndef OMAHA_GOOPDATE_DOWNLOAD_JOURNAL_H_
+#define OMAHA_GOOPDATE_DOWNLOAD_JOURNAL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <filesystem>
+#include <string>
+
+#include "base/basictypes.h"
+#include "omaha/base/security/sha256.h"
+
+namespace omaha {
+
+class DownloadJournal {
+ public:
+  static const char kMagic[4];
+
+  DownloadJournal();
+  ~DownloadJournal();
+
+  // Starts the journal of a download of |size| bytes, with no byte written.
+  void Start(const std::string& url,
+             const std::string& expected_hash,
+             uint64_t size);
+
+  // Returns true if the journal is for a package of |size| bytes with
+  // |expected_hash|. The url is not compared, since all the urls of a package
+  // serve the same bytes.
+  bool IsFor(const std::string& expected_hash, uint64_t size) const;
+
+  // Hashes |size| bytes written after the bytes already written.
+  void Append(const void* data, size_t size);
+
+  // Forgets the bytes written, when the download starts again from the
+  // beginning of the package.
+  void Rewind();
+
+  // Returns the hex-encoded SHA-256 of the bytes written.
+  std::string GetHash() const;
+
+  std::string Serialize() const;
+
+  // Returns false and leaves the journal unchanged if |contents| is not a
+  // valid journal.
+  bool Parse(const std::string& contents);
+
+  // Reads the journal at |path|. Returns false if the file does not exist or
+  // is not a valid journal.
+  bool Load(const std::filesystem::path& path);
+
+  // Atomically replaces the journal at |path|.
+  bool Save(const std::filesystem::path& path) const;
+
+  const std::string& url() const { return url_; }
+  void set_url(const std::string& url) { url_ = url; }
+
+  const std::string& expected_hash() const { return expected_hash_; }
+  uint64_t size() const { return size_; }
+  uint64_t bytes_written() const { return bytes_written_; }
+
+ private:
+  std::string url_;
+  std::string expected_hash_;
+  uint64_t size_;
+  uint64_t bytes_written_;
+  LITE_SHA256_CTX hash_;
+
+  DISALLOW_COPY_AND_ASSIGN(DownloadJournal);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_GOOPDATE_DOWNLOAD_JOURNAL_H_
@@ -0,0 +1,140 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/download_journal.h"
+
+#include <filesystem>
+#include <string>
+#include <system_error>
+
+#include "gtest/gtest.h"
+
+namespace omaha {
+
+namespace {
+
+// The SHA-256 of "abc".
+const char kAbcHash[] =
+    "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad";
+
+}  // namespace
+
+TEST(DownloadJournalTest, Hash) {
+  DownloadJournal journal;
+  journal.Start("https://dl.google.com/a.exe", "ABC", 3);
+  EXPECT_EQ("abc", journal.expected_hash());
+  EXPECT_EQ(0, journal.bytes_written());
+
+  journal.Append("a", 1);
+  journal.Append("bc", 2);
+  EXPECT_EQ(3, journal.bytes_written());
+  EXPECT_EQ(kAbcHash, journal.GetHash());
+
+  // Getting the hash does not finish it.
+  EXPECT_EQ(kAbcHash, journal.GetHash());
+
+  journal.Rewind();
+  EXPECT_EQ(0, journal.bytes_written());
+  journal.Append("abc", 3);
+  EXPECT_EQ(kAbcHash, journal.GetHash());
+}
+
+TEST(DownloadJournalTest, IsFor) {
+  DownloadJournal journal;
+  EXPECT_FALSE(journal.IsFor("", 0));
+
+  journal.Start("https://dl.google.com/a.exe", kAbcHash, 3);
+  EXPECT_TRUE(journal.IsFor(kAbcHash, 3));
+  EXPECT_TRUE(journal.IsFor(
+      "BA7816BF8F01CFEA414140DE5DAE2223B00361A396177A9CB410FF61F20015AD", 3));
+  EXPECT_FALSE(journal.IsFor(kAbcHash, 4));
+  EXPECT_FALSE(journal.IsFor("00", 3));
+}
+
+// A download resumed from a journal has the hash of the whole package.
+TEST(DownloadJournalTest, SerializeAndResume) {
+  std::string package;
+  for (int i = 0; i != 1000; ++i) {
+    package.push_back(static_cast<char>(i * 7));
+  }
+  DownloadJournal whole;
+  whole.Append(package.data(), package.size());
+
+  for (size_t written : {0, 1, 63, 64, 65, 999, 1000}) {
+    DownloadJournal journal;
+    journal.Start("https://dl.google.com/a.exe", "00ff", package.size());
+    journal.Append(package.data(), written);
+
+    DownloadJournal resumed;
+    ASSERT_TRUE(resumed.Parse(journal.Serialize()));
+    EXPECT_EQ("https://dl.google.com/a.exe", resumed.url());
+    EXPECT_EQ("00ff", resumed.expected_hash());
+    EXPECT_EQ(package.size(), resumed.size());
+    EXPECT_EQ(written, resumed.bytes_written());
+
+    resumed.Append(package.data() + written, package.size() - written);
+    EXPECT_EQ(whole.GetHash(), resumed.GetHash());
+  }
+}
+
+TEST(DownloadJournalTest, DamagedJournal) {
+  DownloadJournal journal;
+  journal.Start("https://dl.google.com/a.exe", kAbcHash, 3);
+  journal.Append("ab", 2);
+  const std::string contents(journal.Serialize());
+
+  DownloadJournal parsed;
+  EXPECT_FALSE(parsed.Parse(""));
+  EXPECT_FALSE(parsed.Parse(contents.substr(0, contents.size() - 1)));
+  EXPECT_FALSE(parsed.Parse(contents + "x"));
+  for (size_t i = 0; i < contents.size(); i += 13) {
+    std::string damaged(contents);
+    damaged[i] ^= 0x01;
+    EXPECT_FALSE(parsed.Parse(damaged)) << i;
+  }
+
+  // A journal which fails to parse is unchanged.
+  EXPECT_EQ(0, parsed.bytes_written());
+  EXPECT_TRUE(parsed.url().empty());
+}
+
+TEST(DownloadJournalTest, SaveAndLoad) {
+  const std::filesystem::path path(
+      std::filesystem::temp_directory_path() /
+      "download_journal_unittest.journal");
+  std::error_code error;
+  std::filesystem::remove(path, error);
+
+  DownloadJournal loaded;
+  EXPECT_FALSE(loaded.Load(path));
+
+  DownloadJournal journal;
+  journal.Start("https://dl.google.com/a.exe", kAbcHash, 3);
+  journal.Append("ab", 2);
+  ASSERT_TRUE(journal.Save(path));
+
+  // Saving again replaces the journal.
+  journal.Append("c", 1);
+  ASSERT_TRUE(journal.Save(path));
+  EXPECT_FALSE(std::filesystem::exists(path.string() + ".tmp"));
+
+  ASSERT_TRUE(loaded.Load(path));
+  EXPECT_EQ(3, loaded.bytes_written());
+  EXPECT_EQ(kAbcHash, loaded.GetHash());
+
+  EXPECT_TRUE(std::filesystem::remove(path, error));
+}
+
+}  // namespace omaha
@@ -26,38 +26,85 @@
 #include <shlwapi.h>
 
 #include <algorithm>
+#include <filesystem>
+#include <string>
 #include <vector>
 
 #include "omaha/base/debug.h"
+#include "omaha/base/encrypt.h"
 #include "omaha/base/error.h"
 #include "omaha/base/file.h"
 #include "omaha/base/logging.h"
 #include "omaha/base/path.h"
 #include "omaha/base/scoped_impersonation.h"
 #include "omaha/base/safe_format.h"
+#include "omaha/base/signatures.h"
 #include "omaha/base/string.h"
 #include "omaha/base/synchronized.h"
+#include "omaha/base/time.h"
 #include "omaha/base/user_rights.h"
 #include "omaha/base/utils.h"
 #include "omaha/common/config_manager.h"
 #include "omaha/common/const_goopdate.h"
 #include "omaha/common/google_signaturevalidator.h"
+#include "omaha/goopdate/download_journal.h"
 #include "omaha/goopdate/model.h"
 #include "omaha/goopdate/package_cache.h"
+#include "omaha/goopdate/peer_cache_protocol.h"
 #include "omaha/goopdate/server_resource.h"
 #include "omaha/goopdate/string_formatter.h"
+#include "omaha/goopdate/verification_cache.h"
 #include "omaha/goopdate/worker_metrics.h"
 #include "omaha/goopdate/worker_utils.h"
 #include "omaha/net/bits_request.h"
 #include "omaha/net/http_client.h"
+#include "omaha/net/http_request.h"
 #include "omaha/net/network_request.h"
 #include "omaha/net/net_utils.h"
 #include "omaha/net/simple_request.h"
+#include "omaha/third_party/smartany/scoped_any.h"
 
 namespace omaha {
 
 namespace {
 
+// How long a preconnected connection is expected to stay open while idle.
+// Servers commonly close idle connections after a minute.
+const int64 kPreconnectIdleTimeoutMs = 60 * 1000;
+
+// The journal of a resumable download, and the file which locks its partial
+// file, are named after the partial file.
+const TCHAR kJournalExtension[] = _T(".download-journal");
+const TCHAR kLockExtension[] = _T(".lock");
+
+// The verification cache, and its HMAC key encrypted with the credentials of
+// the user, are stored in the root of the package cache.
+const TCHAR kVerificationCacheName[] = _T("_verification");
+const TCHAR kVerificationKeyName[] = _T("_verification.key");
+
+// Increment when the rules of VerifyGoogleAuthenticodeSignature change, for
+// instance when the pinned public keys change, so that the packages verified
+// with the previous rules are verified again.
+const uint32 kVerificationPolicyVersion = 1;
+
+// The journal is saved each time this many bytes are received, which bounds
+// the bytes downloaded again after a restart.
+const uint64 kJournalSaveIntervalBytes = 4 * 1024 * 1024;
+
+// The partial files of the downloads which are not resumed for this long are
+// deleted.
+const int kResumableDownloadMaxAgeDays = 7;
+
+// Returns true if the downloads try BITS first. BITS transfers files only
+// when the job owner is logged on. If the process "Run As" another user, an
+// empty BITS job gets created in suspended state but there is no way to
+// manipulate the job, nor cancel it.
+bool IsBitsUsedForDownloads() {
+  bool is_logged_on = false;
+  HRESULT hr = UserRights::UserIsLoggedOnInteractively(&is_logged_on);
+  return SUCCEEDED(hr) && is_logged_on;
+}
+
 // Creates and initializes an instance of the NetworkRequest for the
 // DownloadManager to use. Defines the fallback chain: BITS, WinHttp.
 HRESULT CreateNetworkRequest(NetworkRequest** network_request_ptr) {
@@ -73,12 +120,7 @@ HRESULT CreateNetworkRequest(NetworkRequest** network_request_ptr) {
   // TODO(omaha): provide a mechanism for different timeout values in
   // silent and interactive downloads.
 
-  // BITS transfers files only when the job owner is logged on. If the process
-  // "Run As" another user, an empty BITS job gets created in suspended state
-  // but there is no way to manipulate the job, nor cancel it.
-  bool is_logged_on = false;
-  hr = UserRights::UserIsLoggedOnInteractively(&is_logged_on);
-  if (SUCCEEDED(hr) && is_logged_on) {
+  if (IsBitsUsedForDownloads()) {
     BitsRequest* bits_request(new BitsRequest);
     bits_request->set_minimum_retry_delay(kSecPerMin);
     bits_request->set_no_progress_timeout(5 * kSecPerMin);
@@ -94,6 +136,80 @@ HRESULT CreateNetworkRequest(NetworkRequest** network_request_ptr) {
   return S_OK;
 }
 
+// Truncates the file to |size| bytes.
+HRESULT TruncateFile(const CString& filename, uint64 size) {
+  scoped_hfile file(::CreateFile(filename,
+                                 GENERIC_WRITE,
+                                 0,
+                                 NULL,
+                                 OPEN_EXISTING,
+                                 FILE_ATTRIBUTE_NORMAL,
+                                 NULL));
+  if (!file) {
+    return HRESULTFromLastError();
+  }
+
+  LARGE_INTEGER end_pos = {0};
+  end_pos.QuadPart = static_cast<LONGLONG>(size);
+  if (!::SetFilePointerEx(get(file), end_pos, NULL, FILE_BEGIN) ||
+      !::SetEndOfFile(get(file))) {
+    return HRESULTFromLastError();
+  }
+  return S_OK;
+}
+
+// Returns true if |name| has the format of the partial files of the
+// resumable downloads and of their journals: 16 lowercase hex digits of the
+// hash of the package, a dash, then the name of the package.
+bool IsResumableFileName(const CString& name) {
+  const int kHashPrefixLength = 16;
+  if (name.GetLength() <= kHashPrefixLength + 1 ||
+      name[kHashPrefixLength] != _T('-')) {
+    return false;
+  }
+  for (int i = 0; i != kHashPrefixLength; ++i) {
+    if (!_istdigit(name[i]) && (name[i] < _T('a') || name[i] > _T('f'))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Deletes the partial files of the resumable downloads in |dir| which have
+// not been written to for kResumableDownloadMaxAgeDays, with their journal,
+// and the journals as old as that, whether or not their partial file still
+// exists. The partial files and the journals of the downloads in progress
+// are open, and are not deleted.
+void DeleteStaleResumableDownloads(const CString& dir) {
+  WIN32_FIND_DATA find_data = {0};
+  scoped_hfind hfind(::FindFirstFile(ConcatenatePath(dir, _T("*-*")),
+                                     &find_data));
+  if (!hfind) {
+    return;
+  }
+
+  const time64 max_age =
+      static_cast<time64>(kResumableDownloadMaxAgeDays) * kSecondsPerDay *
+      kSecsTo100ns;
+  const time64 now = GetCurrent100NSTime();
+  do {
+    const CString name(find_data.cFileName);
+    if ((find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ||
+        !IsResumableFileName(name) ||
+        String_EndsWith(name, kLockExtension, true) ||
+        now - FileTimeToTime64(find_data.ftLastWriteTime) < max_age) {
+      continue;
+    }
+
+    const CString filename(ConcatenatePath(dir, name));
+    CORE_LOG(L3, (_T("[deleting stale resumable download][%s]"), filename));
+    ::DeleteFile(filename);
+    if (!String_EndsWith(name, kJournalExtension, true)) {
+      ::DeleteFile(filename + kJournalExtension);
+    }
+  } while (::FindNextFile(get(hfind), &find_data));
+}
+
 // TODO(omaha): Unit test this method.
 HRESULT ValidateSize(File* source_file, uint64 expected_size) {
   CORE_LOG(L3, (_T("[ValidateSize][%lld]"), expected_size));
@@ -138,10 +254,192 @@ void AddDownloadMetricsPingEvents(
   }
 }
 
+// Reports the progress of a download to its package, and to the apps which
+// wait for the same package.
+class SharedProgressCallback : public NetworkRequestCallback {
+ public:
+  SharedProgressCallback(Package* package,
+                         const SingleFlight::Progress& followers)
+      : package_(package), followers_(followers) {
+    ASSERT1(package);
+  }
+
+  virtual void OnRequestBegin() {
+    package_->OnRequestBegin();
+  }
+
+  virtual void OnProgress(int bytes, int bytes_total,
+                          int status, const TCHAR* status_text) {
+    package_->OnProgress(bytes, bytes_total, status, status_text);
+    followers_(bytes, bytes_total);
+  }
+
+  virtual void OnRequestRetryScheduled(time64 next_retry_time) {
+    package_->OnRequestRetryScheduled(next_retry_time);
+  }
+
+ private:
+  Package* package_;
+  const SingleFlight::Progress& followers_;
+
+  DISALLOW_COPY_AND_ASSIGN(SharedProgressCallback);
+};
+
 }  // namespace
 
+// Records the bytes received by a download in the journal of its partial
+// file. The partial file is locked while the download runs, so that the
+// processes which download the same package do not share it.
+class DownloadManager::ResumableDownload : public ResponseObserver {
+ public:
+  ResumableDownload() : bytes_since_save_(0), is_valid_(false) {}
+  virtual ~ResumableDownload() {}
+
+  // Locks the partial file of |package| and loads its journal. The download
+  // resumes if the journal is for the same package and the partial file
+  // holds the bytes it records. Returns false if the download of |package|
+  // is not resumable, or another process holds the partial file.
+  bool Open(const Package& package) {
+    const CString expected_hash(package.expected_hash());
+    const uint64 expected_size(package.expected_size());
+    if (expected_hash.IsEmpty() ||
+        expected_size == 0 ||
+        expected_size > INT_MAX) {
+      return false;
+    }
+
+    if (FAILED(BuildResumableFileName(package.filename(),
+                                      expected_hash,
+                                      &filename_))) {
+      return false;
+    }
+    journal_filename_ = filename_ + kJournalExtension;
+
+    reset(lock_file_, ::CreateFile(filename_ + kLockExtension,
+                                   GENERIC_WRITE,
+                                   0,
+                                   NULL,
+                                   OPEN_ALWAYS,
+                                   FILE_ATTRIBUTE_NORMAL |
+                                   FILE_FLAG_DELETE_ON_CLOSE,
+                                   NULL));
+    if (!lock_file_) {
+      CORE_LOG(LW, (_T("[failed to lock the partial file][%s][0x%08x]"),
+                    filename_, HRESULTFromLastError()));
+      return false;
+    }
+
+    const std::string hash(CT2A(expected_hash));
+    const bool has_journal = journal_.Load(JournalPath());
+    uint32 file_size = 0;
+    if (has_journal &&
+        journal_.IsFor(hash, expected_size) &&
+        SUCCEEDED(File::GetFileSizeUnopen(filename_, &file_size)) &&
+        file_size >= journal_.bytes_written() &&
+        SUCCEEDED(TruncateFile(filename_, journal_.bytes_written()))) {
+      if (journal_.bytes_written()) {
+        ++metric_worker_download_resumed;
+        OPT_LOG(L2, (_T("[resuming download][%s][%llu of %llu bytes]"),
+                     filename_, journal_.bytes_written(), expected_size));
+      }
+    } else {
+      if (has_journal) {
+        ++metric_worker_download_resume_discarded;
+      }
+      journal_.Start(std::string(), hash, expected_size);
+      ::DeleteFile(filename_);
+    }
+
+    is_valid_ = true;
+    return true;
+  }
+
+  // Forgets the bytes of the partial file, which the next download receives
+  // again.
+  void Discard() {
+    ::DeleteFile(filename_);
+    journal_.Rewind();
+    is_valid_ = true;
+    Save();
+  }
+
+  // Saves the progress of the download. The journal and the partial file are
+  // deleted if the bytes received no longer match the journal, since a
+  // partial file without a journal is never resumed.
+  void Save() {
+    bytes_since_save_ = 0;
+    if (!is_valid_ || !journal_.Save(JournalPath())) {
+      ::DeleteFile(journal_filename_);
+      ::DeleteFile(filename_);
+    }
+  }
+
+  // Deletes the partial file and the journal, once the package is cached or
+  // the partial file is known to be corrupt.
+  void Delete() {
+    DeleteBeforeOrAfterReboot(filename_);
+    ::DeleteFile(journal_filename_);
+    journal_.Rewind();
+    is_valid_ = true;
+  }
+
+  // Returns true if the journal records all the bytes of the package, and
+  // their hash differs from the expected hash.
+  bool IsCorrupt() const {
+    return is_valid_ &&
+           journal_.bytes_written() == journal_.size() &&
+           journal_.GetHash() != journal_.expected_hash();
+  }
+
+  void set_url(const CString& url) {
+    journal_.set_url(std::string(CT2A(url)));
+  }
+
+  const CString& filename() const { return filename_; }
+  int offset() const { return static_cast<int>(journal_.bytes_written()); }
+
+  // ResponseObserver interface.
+  virtual void OnResponseStart(uint64 offset) {
+    if (!offset) {
+      journal_.Rewind();
+      is_valid_ = true;
+    } else if (offset != journal_.bytes_written()) {
+      is_valid_ = false;
+    }
+  }
+
+  virtual void OnResponseData(const uint8* data, size_t size) {
+    if (!is_valid_) {
+      return;
+    }
+    journal_.Append(data, size);
+    bytes_since_save_ += size;
+    if (bytes_since_save_ >= kJournalSaveIntervalBytes) {
+      Save();
+    }
+  }
+
+ private:
+  std::filesystem::path JournalPath() const {
+    return std::filesystem::path(journal_filename_.GetString());
+  }
+
+  CString filename_;
+  CString journal_filename_;
+  scoped_hfile lock_file_;
+  DownloadJournal journal_;
+  uint64 bytes_since_save_;
+
+  // False once the bytes received do not follow the bytes in the journal.
+  bool is_valid_;
+
+  DISALLOW_COPY_AND_ASSIGN(ResumableDownload);
+};
+
 DownloadManager::DownloadManager(bool is_machine)
-    : lock_(NULL), is_machine_(false) {
+    : lock_(NULL),
+      is_machine_(false),
+      preconnect_tracker_(kPreconnectIdleTimeoutMs) {
   CORE_LOG(L3, (_T("[DownloadManager::DownloadManager]")));
 
   omaha::interlocked_exchange_pointer(&lock_,
@@ -194,7 +492,8 @@ const PackageCache* DownloadManager::package_cache() const {
 }
 
 HRESULT DownloadManager::Initialize() {
-  HRESULT hr = package_cache()->Initialize(package_cache_root());
+  HRESULT hr = package_cache()->Initialize(is_machine_,
+                                           package_cache_root());
   if (FAILED(hr)) {
     CORE_LOG(LE, (_T("[failed to initialize the package cache]0x%08x]"), hr));
     return hr;
@@ -205,9 +504,71 @@ HRESULT DownloadManager::Initialize() {
     CORE_LOG(LW, (_T("[PurgeOldPackagesIfNecessary failed][0x%08x]"), hr));
   }
 
+  DeleteStaleResumableDownloadsOnce(
+      ConfigManager::Instance()->GetTempDownloadDir());
+
+  InitializeVerificationCache();
+
   return S_OK;
 }
 
+void DownloadManager::DeleteStaleResumableDownloadsOnce(
+    const CString& temp_dir) {
+  if (temp_dir.IsEmpty()) {
+    return;
+  }
+
+  {
+    __mutexScope(lock());
+    CString key(temp_dir);
+    key.MakeLower();
+    if (!swept_temp_dirs_.insert(key).second) {
+      return;
+    }
+  }
+
+  DeleteStaleResumableDownloads(temp_dir);
+}
+
+void DownloadManager::InitializeVerificationCache() {
+  const CString key_path(ConcatenatePath(package_cache_root(),
+                                         kVerificationKeyName));
+  std::vector<byte> encrypted_key;
+  std::vector<uint8> key;
+  if (FAILED(ReadEntireFile(key_path, 0, &encrypted_key)) ||
+      FAILED(encrypt::DecryptData(NULL, 0,
+                                  encrypted_key.data(), encrypted_key.size(),
+                                  &key)) ||
+      key.size() != VerificationCache::kKeySize) {
+    const std::string new_key(VerificationCache::GenerateKey());
+    key.assign(new_key.begin(), new_key.end());
+    HRESULT hr = encrypt::EncryptData(NULL, 0, key.data(), key.size(),
+                                      &encrypted_key);
+    if (SUCCEEDED(hr)) {
+      hr = WriteEntireFile(key_path, encrypted_key);
+    }
+    if (FAILED(hr)) {
+      CORE_LOG(LW, (_T("[failed to create the verification key][0x%08x]"),
+                    hr));
+      return;
+    }
+  }
+
+  VerificationCache::Options options;
+  options.policy_version = kVerificationPolicyVersion;
+  verification_cache_.reset(new VerificationCache(
+      std::string(key.begin(), key.end()),
+      options,
+      []() { return static_cast<int64_t>(GetCurrent100NSTime()); }));
+
+  // The cache starts empty if the file is missing or has been tampered with.
+  const std::filesystem::path cache_path(static_cast<const TCHAR*>(
+      ConcatenatePath(package_cache_root(), kVerificationCacheName)));
+  if (!verification_cache_->Load(cache_path)) {
+    CORE_LOG(L3, (_T("[the verification cache was not loaded]")));
+  }
+}
+
 CString DownloadManager::GetMessageForError(const ErrorContext& error_context,
                                             const CString& language) {
   CString message;
@@ -328,6 +689,13 @@ bool DownloadManager::IsPackageAvailable(const Package* package) const {
   return package_cache()->IsCached(key, package->expected_hash());
 }
 
+HRESULT DownloadManager::GetCachedPackageNames(
+    const CString& app_id,
+    const CString& version,
+    std::vector<CString>* package_names) const {
+  return package_cache()->GetPackageNames(app_id, version, package_names);
+}
+
 // Attempts a package download by trying the fallback urls. It does not
 // retry the download if the file validation fails.
 // Assumes the packages are not created or destroyed while method is running.
@@ -374,74 +742,360 @@ HRESULT DownloadManager::DoDownloadPackage(Package* package, State* state) {
       return GOOPDATE_E_CANNOT_USE_NETWORK;
     }
 
-    CString unique_filename_path;
-    HRESULT hr = BuildUniqueFileName(package_name, &unique_filename_path);
+    HRESULT hr = DoDownloadPackageOnce(package, state);
     if (FAILED(hr)) {
-      CORE_LOG(LE, (_T("[BuildUniqueFileName failed][0x%08x]"), hr));
       return hr;
     }
+  } else {
+    OPT_LOG(L3, (_T("[package is cached]")));
 
-    NetworkRequest* network_request = state->network_request();
-
-    network_request->set_callback(package);
+    // TODO(omaha3): We probably need to update the download stats that
+    // Package::OnProgress would set. It may be misleading to set
+    // bytes_downloaded to anything other than zero, but App uses this to
+    // calculate progress. I suppose we could add an is_complete field instead.
+    // There is a related issue with the callback not being called with the
+    // final size. See the TODO in the unit tests.
+  }
 
-    const std::vector<CString> download_base_urls(
-        package->app_version()->download_base_urls());
+  ASSERT1(package_cache()->IsCached(key, package->expected_hash()));
+  return S_OK;
+}
 
-    hr = E_FAIL;
-    app->SetCurrentTimeAs(App::TIME_DOWNLOAD_START);
-    for (size_t i = 0; i != download_base_urls.size(); ++i) {
-      CString url;
-      DWORD url_length(INTERNET_MAX_URL_LENGTH);
-      hr = ::UrlCombine(download_base_urls[i],
-                        package_name,
-                        CStrBuf(url, INTERNET_MAX_URL_LENGTH),
-                        &url_length,
-                        0);
-      if (FAILED(hr)) {
-        continue;
-      }
+HRESULT DownloadManager::DoDownloadPackageOnce(Package* package,
+                                               State* state) {
+  ASSERT1(package);
+  ASSERT1(state);
 
-      ASSERT1(static_cast<DWORD>(url.GetLength()) == url_length);
+  const CString app_id(package->app_version()->app()->app_guid_string());
+  const CString version(package->app_version()->version());
+  PackageCache::Key key(app_id, version, package->filename());
+
+  // The key includes the expected hash, so that the apps only share the
+  // download of the same bytes.
+  CString flight_key;
+  SafeCStringFormat(&flight_key, _T("%s|%s"),
+                    key.ToString(), package->expected_hash());
+
+  HRESULT hr = E_FAIL;
+  for (int attempt = 0; attempt != 2; ++attempt) {
+    SingleFlight::Role role = SingleFlight::ROLE_LEADER;
+    hr = single_flight_.Do(
+        std::string(CT2A(flight_key)),
+        [this, package, state](const SingleFlight::Progress& progress) {
+          SharedProgressCallback callback(package, progress);
+          return static_cast<int>(
+              DoDownloadPackageFromNetwork(package, state, &callback));
+        },
+        [package](int bytes, int bytes_total) {
+          package->OnProgress(bytes,
+                              bytes_total,
+                              WINHTTP_CALLBACK_STATUS_READ_COMPLETE,
+                              NULL);
+        },
+        [state]() { return state->is_canceled(); },
+        &role);
+
+    if (role == SingleFlight::ROLE_LEADER) {
+      return hr;
+    }
+    if (role == SingleFlight::ROLE_CANCELLED) {
+      return GOOPDATE_E_CANCELLED;
+    }
 
-      hr = DoDownloadPackageFromUrl(url, unique_filename_path, package, state);
-      AddDownloadMetricsPingEvents(network_request->download_metrics(), app);
-      if (SUCCEEDED(hr)) {
-        app->set_source_url_index(static_cast<int>(i));
-        break;
-      }
+    ++metric_worker_download_coalesced;
+    OPT_LOG(L3, (_T("[shared the download of another app][0x%08x]"), hr));
+    if (SUCCEEDED(hr) &&
+        package_cache()->IsCached(key, package->expected_hash())) {
+      return S_OK;
     }
 
-    VERIFY_SUCCEEDED(network_request->Close());
-    DeleteBeforeOrAfterReboot(unique_filename_path);
-    app->SetCurrentTimeAs(App::TIME_DOWNLOAD_COMPLETE);
+    // The download failed for the other app, maybe because its bundle was
+    // canceled. Downloads the package again, or shares a newer download.
+    hr = FAILED(hr) ? hr : GOOPDATEDOWNLOAD_E_CACHING_FAILED;
+  }
+
+  return hr;
+}
+
+HRESULT DownloadManager::DoDownloadPackageFromNetwork(
+    Package* package,
+    State* state,
+    NetworkRequestCallback* callback) {
+  ASSERT1(package);
+  ASSERT1(state);
+  ASSERT1(callback);
+
+  App* app = package->app_version()->app();
+  const CString app_id(app->app_guid_string());
+  const CString version(package->app_version()->version());
+  const CString package_name(package->filename());
+  PackageCache::Key key(app_id, version, package_name);
+
+  HRESULT hr = DoDownloadDiffPackage(package, state, callback);
+  if (hr == S_OK) {
+    ASSERT1(package_cache()->IsCached(key, package->expected_hash()));
+    return S_OK;
+  }
+  if (FAILED(hr)) {
+    OPT_LOG(LW, (_T("[differential update failed][0x%08x]"), hr));
+  }
+
+  CString unique_filename_path;
+  hr = BuildUniqueFileName(package_name, &unique_filename_path);
+  if (FAILED(hr)) {
+    CORE_LOG(LE, (_T("[BuildUniqueFileName failed][0x%08x]"), hr));
+    return hr;
+  }
+
+  NetworkRequest* network_request = state->network_request();
+
+  network_request->set_callback(callback);
+
+  const std::vector<CString> download_base_urls(
+      package->app_version()->download_base_urls());
+
+  hr = E_FAIL;
+  app->SetCurrentTimeAs(App::TIME_DOWNLOAD_START);
+
+  // The caches of the peers on the local network are tried first. Whatever
+  // its source, the package is verified against its expected hash. The
+  // metrics of these downloads are not pinged, so that the names of the
+  // local hosts are not sent.
+  const std::vector<CString> peer_cache_urls(
+      BuildPeerCacheUrls(package->expected_hash()));
+  for (size_t i = 0; i != peer_cache_urls.size(); ++i) {
+    hr = DoDownloadPackageFromUrl(peer_cache_urls[i],
+                                  unique_filename_path,
+                                  package,
+                                  state,
+                                  NULL);
+    if (SUCCEEDED(hr)) {
+      ++metric_worker_download_peer_cache_succeeded;
+      break;
+    }
+    ++metric_worker_download_peer_cache_failed;
+    OPT_LOG(LW, (_T("[peer cache download failed][%s][0x%08x]"),
+                 peer_cache_urls[i], hr));
+  }
 
+  // The downloads from the servers resume the partial file of an earlier
+  // download of the package, unless another process is downloading it.
+  // This runs impersonating the user, whose temp directory holds the partial
+  // files.
+  if (FAILED(hr)) {
+    DeleteStaleResumableDownloadsOnce(
+        ConfigManager::Instance()->GetTempDownloadDir());
+  }
+  ResumableDownload resumable_download;
+  const bool is_resumable = FAILED(hr) && resumable_download.Open(*package);
+
+  for (size_t i = 0; FAILED(hr) && i != download_base_urls.size(); ++i) {
+    CString url;
+    DWORD url_length(INTERNET_MAX_URL_LENGTH);
+    hr = ::UrlCombine(download_base_urls[i],
+                      package_name,
+                      CStrBuf(url, INTERNET_MAX_URL_LENGTH),
+                      &url_length,
+                      0);
     if (FAILED(hr)) {
-      CORE_LOG(LE, (_T("[download failed from all urls][0x%08x]"), hr));
-      return hr;
+      continue;
     }
 
-    // Assumes that downloaded bytes equal to the expected package size.
-    app->UpdateNumBytesDownloaded(package->expected_size());
-  } else {
-    OPT_LOG(L3, (_T("[package is cached]")));
+    ASSERT1(static_cast<DWORD>(url.GetLength()) == url_length);
+
+    hr = is_resumable ?
+         DoDownloadPackageFromUrl(url,
+                                  resumable_download.filename(),
+                                  package,
+                                  state,
+                                  &resumable_download) :
+         DoDownloadPackageFromUrl(url,
+                                  unique_filename_path,
+                                  package,
+                                  state,
+                                  NULL);
+    AddDownloadMetricsPingEvents(network_request->download_metrics(), app);
+    if (SUCCEEDED(hr)) {
+      app->set_source_url_index(static_cast<int>(i));
+      break;
+    }
+  }
 
-    // TODO(omaha3): We probably need to update the download stats that
-    // Package::OnProgress would set. It may be misleading to set
-    // bytes_downloaded to anything other than zero, but App uses this to
-    // calculate progress. I suppose we could add an is_complete field instead.
-    // There is a related issue with the callback not being called with the
-    // final size. See the TODO in the unit tests.
+  VERIFY_SUCCEEDED(network_request->Close());
+  DeleteBeforeOrAfterReboot(unique_filename_path);
+  app->SetCurrentTimeAs(App::TIME_DOWNLOAD_COMPLETE);
+
+  if (FAILED(hr)) {
+    CORE_LOG(LE, (_T("[download failed from all urls][0x%08x]"), hr));
+    return hr;
   }
 
+  // Assumes that downloaded bytes equal to the expected package size.
+  app->UpdateNumBytesDownloaded(package->expected_size());
+
   ASSERT1(package_cache()->IsCached(key, package->expected_hash()));
   return S_OK;
 }
 
-HRESULT DownloadManager::DoDownloadPackageFromUrl(const CString& url,
-                                                  const CString& filename,
-                                                  Package* package,
-                                                  State* state) {
+HRESULT DownloadManager::DoDownloadDiffPackage(
+    Package* package,
+    State* state,
+    NetworkRequestCallback* callback) {
+  ASSERT1(package);
+  ASSERT1(state);
+  ASSERT1(callback);
+
+  App* app = package->app_version()->app();
+  const CString diff_name(package->diff_filename());
+  const CString base_version(app->current_version()->version());
+  if (diff_name.IsEmpty() || base_version.IsEmpty()) {
+    return S_FALSE;
+  }
+
+  OPT_LOG(L3, (_T("[DownloadManager::DoDownloadDiffPackage][%s][base %s]"),
+               diff_name, base_version));
+
+  CString unique_filename_path;
+  HRESULT hr = BuildUniqueFileName(diff_name, &unique_filename_path);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  NetworkRequest* network_request = state->network_request();
+  network_request->set_callback(callback);
+
+  const std::vector<CString> download_base_urls(
+      package->app_version()->download_base_urls());
+
+  hr = E_FAIL;
+  app->SetCurrentTimeAs(App::TIME_DOWNLOAD_START);
+  for (size_t i = 0; i != download_base_urls.size(); ++i) {
+    CString url;
+    DWORD url_length(INTERNET_MAX_URL_LENGTH);
+    hr = ::UrlCombine(download_base_urls[i],
+                      diff_name,
+                      CStrBuf(url, INTERNET_MAX_URL_LENGTH),
+                      &url_length,
+                      0);
+    if (FAILED(hr)) {
+      continue;
+    }
+
+    OPT_LOG(L3, (_T("[starting diff download][from '%s']"), url));
+    hr = network_request->DownloadFile(url, unique_filename_path);
+    AddDownloadMetricsPingEvents(network_request->download_metrics(), app);
+    if (SUCCEEDED(hr)) {
+      app->set_source_url_index(static_cast<int>(i));
+      break;
+    }
+  }
+  VERIFY_SUCCEEDED(network_request->Close());
+
+  if (SUCCEEDED(hr)) {
+    hr = PackageCache::VerifyHash(unique_filename_path,
+                                  package->diff_expected_hash());
+  }
+
+  if (SUCCEEDED(hr)) {
+    // As in DoDownloadPackageFromUrl, the downloaded file is opened as the
+    // impersonated user and written to the cache unimpersonated.
+    File patch_file;
+    hr = patch_file.OpenShareMode(unique_filename_path,
+                                  false,
+                                  false,
+                                  FILE_SHARE_READ);
+    if (SUCCEEDED(hr)) {
+      app->ApplyingDifferentialPatch();
+      hr = CallAsSelfAndImpersonate3(this,
+                                     &DownloadManager::CachePackageFromPatch,
+                                     static_cast<const Package*>(package),
+                                     &patch_file,
+                                     &base_version);
+      app->Downloading();
+    }
+  }
+
+  DeleteBeforeOrAfterReboot(unique_filename_path);
+  app->SetCurrentTimeAs(App::TIME_DOWNLOAD_COMPLETE);
+
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  app->UpdateNumBytesDownloaded(package->diff_expected_size());
+  return S_OK;
+}
+
+HRESULT DownloadManager::CachePackageFromPatch(const Package* package,
+                                               File* patch_file,
+                                               const CString* base_version) {
+  ASSERT1(package);
+  ASSERT1(patch_file);
+  ASSERT1(base_version);
+
+  const CString app_id(package->app_version()->app()->app_guid_string());
+  const CString version(package->app_version()->version());
+  const CString package_name(package->filename());
+  PackageCache::Key key(app_id, version, package_name);
+
+  // The patched package is checked like a downloaded one before the cache
+  // commits it.
+  PackageCache::Verifier verifier;
+  if (ConfigManager::Instance()->ShouldVerifyPayloadAuthenticodeSignature()) {
+    verifier = [this, package](File* package_file,
+                               const CString& package_path) {
+      return EnsureSignatureIsValid(package_file,
+                                    package_path,
+                                    package->expected_hash());
+    };
+  }
+
+  HRESULT hr = package_cache()->PutFromPatch(key,
+                                             *base_version,
+                                             patch_file,
+                                             package->expected_hash(),
+                                             verifier);
+  if (FAILED(hr)) {
+    OPT_LOG(LE, (_T("[PackageCache::PutFromPatch failed][%#x]"), hr));
+  }
+  return hr;
+}
+
+std::vector<CString> DownloadManager::BuildPeerCacheUrls(
+    const CString& hash) {
+  std::vector<CString> urls;
+
+  // The path is relative, so that it is combined with the path of the base
+  // url of the cache.
+  const std::string path(PeerCacheProtocol::BuildPath(
+      std::string(CT2A(hash))));
+  if (path.empty()) {
+    return urls;
+  }
+  const CString relative_path(path.substr(1).c_str());
+
+  const std::vector<CString> peer_cache_urls(
+      ConfigManager::Instance()->GetPeerCacheUrls(NULL));
+  for (size_t i = 0; i != peer_cache_urls.size(); ++i) {
+    CString url;
+    DWORD url_length(INTERNET_MAX_URL_LENGTH);
+    if (SUCCEEDED(::UrlCombine(peer_cache_urls[i],
+                               relative_path,
+                               CStrBuf(url, INTERNET_MAX_URL_LENGTH),
+                               &url_length,
+                               0))) {
+      urls.push_back(url);
+    }
+  }
+  return urls;
+}
+
+HRESULT DownloadManager::DoDownloadPackageFromUrl(
+    const CString& url,
+    const CString& filename,
+    Package* package,
+    State* state,
+    ResumableDownload* resumable_download) {
   OPT_LOG(L3, (_T("[starting download][from '%s'][to '%s']"), url, filename));
 
   // Downloading a file is a blocking call. It assumes the model is not
@@ -451,7 +1105,49 @@ HRESULT DownloadManager::DoDownloadPackageFromUrl(const CString& url,
 
   NetworkRequest* network_request = state->network_request();
 
+  const int content_length = static_cast<int>(package->expected_size());
+  if (resumable_download) {
+    resumable_download->set_url(url);
+    network_request->set_response_observer(resumable_download);
+    network_request->set_resumable(true,
+                                   content_length,
+                                   resumable_download->offset());
+  }
+
+  const uint64 download_begin_ms = GetCurrentMsTime();
   HRESULT hr = network_request->DownloadFile(url, filename);
+
+  // A server which does not have the bytes after the partial file fails the
+  // range request. The download starts again from the beginning.
+  if (resumable_download &&
+      resumable_download->offset() &&
+      network_request->http_status_code() ==
+          HTTP_STATUS_RANGE_NOT_SATISFIABLE) {
+    OPT_LOG(LW, (_T("[range not satisfiable, restarting the download]")));
+    ++metric_worker_download_resume_discarded;
+    resumable_download->Discard();
+    network_request->set_resumable(true, content_length, 0);
+    hr = network_request->DownloadFile(url, filename);
+  }
+
+  if (resumable_download) {
+    network_request->set_response_observer(NULL);
+    network_request->set_resumable(false, 0, 0);
+    resumable_download->Save();
+  }
+
+  // Only the downloads which use WinHttp reuse the preconnected connections.
+  const std::vector<DownloadMetrics> download_metrics(
+      network_request->download_metrics());
+  if (!download_metrics.empty() &&
+      download_metrics.back().downloader == DownloadMetrics::kWinHttp) {
+    const int64 time_saved_ms = preconnect_tracker_.TakeTimeSaved(
+        std::string(CT2A(url)), download_begin_ms);
+    if (time_saved_ms) {
+      metric_worker_download_preconnect_saved_ms.AddSample(time_saved_ms);
+    }
+  }
+
   if (FAILED(hr)) {
     OPT_LOG(LE, (_T("[DownloadFile failed][%#x]"), hr));
     worker_utils::AddHttpRequestDataToEventLog(
@@ -466,6 +1162,15 @@ HRESULT DownloadManager::DoDownloadPackageFromUrl(const CString& url,
   // A file has been successfully downloaded from current url. Validate the file
   // and cache it.
 
+  // The hash of a resumed download is known as soon as it completes. A
+  // corrupt partial file is not resumed again.
+  if (resumable_download && resumable_download->IsCorrupt()) {
+    OPT_LOG(LE, (_T("[resumed download does not match its hash]")));
+    ++metric_worker_download_resume_discarded;
+    resumable_download->Delete();
+    return SIGS_E_INVALID_SIGNATURE;
+  }
+
   // We open the downloaded file as the current (impersonated) user. This
   // ensures that we are not reading any privileged files that are otherwise
   // inaccessible to the impersonated user.
@@ -486,10 +1191,79 @@ HRESULT DownloadManager::DoDownloadPackageFromUrl(const CString& url,
     OPT_LOG(LE, (_T("[DownloadManager::CachePackage failed][%#x]"), hr));
   }
 
+  // The partial file is done with once the package is cached, or once the
+  // package cache rejects it.
+  if (resumable_download) {
+    source_file.Close();
+    resumable_download->Delete();
+  }
+
   return hr;
 }
 
 
+void DownloadManager::Preconnect(const std::vector<CString>& urls) {
+  // BITS makes its own connections, which do not reuse the connections of
+  // the WinHttp session.
+  if (IsBitsUsedForDownloads()) {
+    CORE_LOG(L3, (_T("[Preconnect][skipped][the downloads use BITS]")));
+    return;
+  }
+
+  std::vector<std::string> url_strings;
+  for (size_t i = 0; i != urls.size(); ++i) {
+    url_strings.push_back(std::string(CT2A(urls[i])));
+  }
+
+  const std::vector<std::string> origins(
+      preconnect_tracker_.BeginPreconnect(url_strings, GetCurrentMsTime()));
+  if (origins.empty()) {
+    return;
+  }
+
+  NetworkConfig* network_config = NULL;
+  HRESULT hr = NetworkConfigManager::Instance().GetUserNetworkConfig(
+      &network_config);
+
+  for (size_t i = 0; i != origins.size(); ++i) {
+    const CString origin(CA2T(origins[i].c_str()));
+    bool is_connected = false;
+    uint64 connect_ms = 0;
+
+    if (SUCCEEDED(hr)) {
+      // A HEAD request on the session of the downloads leaves a connection to
+      // the origin, or to its proxy, in the connection pool of the session.
+      NetworkRequest network_request(network_config->session());
+      SimpleRequest* head_request(new SimpleRequest);
+      head_request->set_is_head_request(true);
+      network_request.AddHttpRequest(head_request);
+      network_request.set_num_retries(0);
+
+      const uint64 begin_ms = GetCurrentMsTime();
+      std::vector<uint8> response;
+      HRESULT hr_head = network_request.Get(origin + _T("/"), &response);
+      connect_ms = GetCurrentMsTime() - begin_ms;
+
+      // Any response means that the connection has been made.
+      is_connected = network_request.http_status_code() != 0;
+      CORE_LOG(L3, (_T("[Preconnect][%s][0x%08x][%d][%llu ms]"),
+                    origin, hr_head, network_request.http_status_code(),
+                    connect_ms));
+    }
+
+    if (is_connected) {
+      ++metric_worker_download_preconnect_succeeded;
+      metric_worker_download_preconnect_ms.AddSample(connect_ms);
+    } else {
+      ++metric_worker_download_preconnect_failed;
+    }
+    preconnect_tracker_.EndPreconnect(origins[i],
+                                      is_connected,
+                                      connect_ms,
+                                      GetCurrentMsTime());
+  }
+}
+
 void DownloadManager::Cancel(App* app) {
   CORE_LOG(L3, (_T("[DownloadManager::Cancel][0x%p]"), app));
   ASSERT1(app);
@@ -501,6 +1275,8 @@ void DownloadManager::Cancel(App* app) {
       VERIFY_SUCCEEDED(download_state_[i]->CancelNetworkRequest());
     }
   }
+
+  single_flight_.WakeUpWaiters();
 }
 
 void DownloadManager::CancelAll() {
@@ -511,6 +1287,8 @@ void DownloadManager::CancelAll() {
   for (size_t i = 0; i != download_state_.size(); ++i) {
     VERIFY_SUCCEEDED(download_state_[i]->CancelNetworkRequest());
   }
+
+  single_flight_.WakeUpWaiters();
 }
 
 bool DownloadManager::IsBusy() const {
@@ -528,25 +1306,38 @@ HRESULT DownloadManager::CachePackage(const Package* package,
                                       const CString* source_file_path) {
   ASSERT1(package);
   ASSERT1(source_file);
+  // The signature is checked on the copy of the package in the cache.
+  UNREFERENCED_PARAMETER(source_file_path);
 
   const CString app_id(package->app_version()->app()->app_guid_string());
   const CString version(package->app_version()->version());
   const CString package_name(package->filename());
   PackageCache::Key key(app_id, version, package_name);
 
-  HRESULT hr = E_UNEXPECTED;
-
+  // The package is checked once its copy in the cache matches the expected
+  // hash, so that the verification cache only records packages which have
+  // the contents of the hash.
+  PackageCache::Verifier verifier;
   if (ConfigManager::Instance()->ShouldVerifyPayloadAuthenticodeSignature()) {
-    hr = EnsureSignatureIsValid(*source_file_path);
-    if (FAILED(hr)) {
-      CORE_LOG(LE, (_T("[EnsureSignatureIsValid failed][%s][0x%08x]"),
-                    package->filename(), hr));
-      return GOOPDATEDOWNLOAD_E_AUTHENTICODE_VERIFICATION_FAILED;
-    }
+    verifier = [this, package](File* package_file,
+                               const CString& package_path) {
+      HRESULT hr = EnsureSignatureIsValid(package_file,
+                                          package_path,
+                                          package->expected_hash());
+      if (FAILED(hr)) {
+        CORE_LOG(LE, (_T("[EnsureSignatureIsValid failed][%s][0x%08x]"),
+                      package->filename(), hr));
+        return GOOPDATEDOWNLOAD_E_AUTHENTICODE_VERIFICATION_FAILED;
+      }
+      return S_OK;
+    };
   }
 
-  hr = package_cache()->Put(
-      key, source_file, package->expected_hash());
+  HRESULT hr = package_cache()->Put(
+      key, source_file, package->expected_hash(), verifier);
+  if (hr == GOOPDATEDOWNLOAD_E_AUTHENTICODE_VERIFICATION_FAILED) {
+    return hr;
+  }
   if (hr != SIGS_E_INVALID_SIGNATURE) {
     if (FAILED(hr)) {
       set_error_extra_code1(static_cast<int>(hr));
@@ -567,18 +1358,81 @@ HRESULT DownloadManager::CachePackage(const Package* package,
   return hr;
 }
 
-HRESULT DownloadManager::EnsureSignatureIsValid(const CString& file_path) {
+HRESULT DownloadManager::EnsureSignatureIsValid(File* file,
+                                                const CString& file_path,
+                                                const CString& expected_hash) {
+  ASSERT1(file);
+
   const TCHAR* ext = ::PathFindExtension(file_path);
   ASSERT1(ext);
-  if (*ext != _T('\0')) {
-    ext++;  // Skip the dot.
-    for (size_t i = 0; i < arraysize(kAuthenticodeVerifiableExtensions); ++i) {
-      if (CString(kAuthenticodeVerifiableExtensions[i]).CompareNoCase(ext)
-          == 0) {
-        return VerifyGoogleAuthenticodeSignature(file_path, true);
-      }
+  if (*ext == _T('\0')) {
+    return S_OK;
+  }
+  ext++;  // Skip the dot.
+  bool is_verifiable = false;
+  for (size_t i = 0; i < arraysize(kAuthenticodeVerifiableExtensions); ++i) {
+    if (CString(kAuthenticodeVerifiableExtensions[i]).CompareNoCase(ext) == 0) {
+      is_verifiable = true;
+      break;
     }
   }
+  if (!is_verifiable) {
+    return S_OK;
+  }
+
+  // The cache is keyed on the expected hash instead of a hash of the file,
+  // which would read the whole file once more. The package cache only runs
+  // this check once the file matches the expected hash, and the file cannot
+  // change in between since it is open without write sharing.
+  uint32 size = 0;
+  if (!verification_cache_.get() ||
+      expected_hash.IsEmpty() ||
+      FAILED(file->GetLength(&size))) {
+    return VerifyGoogleAuthenticodeSignature(file_path, true);
+  }
+
+  CString digest(expected_hash);
+  digest.MakeLower();
+
+  bool is_verified = false;
+  HRESULT verify_hr = S_OK;
+  const bool is_valid = verification_cache_->Verify(
+      std::string(CT2A(digest)),
+      size,
+      [&file_path, &is_verified, &verify_hr](std::string* signer,
+                                             int64_t* not_after_100ns) {
+        is_verified = true;
+        CString signer_name;
+        FILETIME not_valid_after = {0};
+        verify_hr = VerifyGoogleAuthenticodeSignature(file_path,
+                                                      true,
+                                                      &signer_name,
+                                                      &not_valid_after);
+        if (FAILED(verify_hr)) {
+          return false;
+        }
+        *signer = CT2A(signer_name, CP_UTF8);
+        *not_after_100ns = FileTimeToTime64(not_valid_after);
+        return true;
+      },
+      NULL);
+  if (!is_valid) {
+    ASSERT1(FAILED(verify_hr));
+    return verify_hr;
+  }
+
+  if (!is_verified) {
+    ++metric_worker_verification_cache_hits;
+    return S_OK;
+  }
+
+  ++metric_worker_verification_cache_misses;
+  const std::filesystem::path cache_path(static_cast<const TCHAR*>(
+      ConcatenatePath(package_cache_root(), kVerificationCacheName)));
+  __mutexScope(lock());
+  if (!verification_cache_->Save(cache_path)) {
+    CORE_LOG(LW, (_T("[failed to save the verification cache]")));
+  }
   return S_OK;
 }
 
@@ -609,6 +1463,30 @@ HRESULT DownloadManager::BuildUniqueFileName(const CString& filename,
          GOOPDATEDOWNLOAD_E_UNIQUE_FILE_PATH_EMPTY : S_OK;
 }
 
+// The partial file is named after the expected hash of the package, so that
+// every process finds the partial file of the same package.
+HRESULT DownloadManager::BuildResumableFileName(const CString& filename,
+                                                const CString& expected_hash,
+                                                CString* resumable_filename) {
+  ASSERT1(resumable_filename);
+
+  const CString temp_dir(ConfigManager::Instance()->GetTempDownloadDir());
+  if (temp_dir.IsEmpty() || expected_hash.IsEmpty()) {
+    return E_UNEXPECTED;
+  }
+
+  // Format of the resumable file name is:
+  // <temp_download_dir>/<16 hex digits of the hash>-<filename>.
+  CString hash_prefix(expected_hash.Left(16));
+  hash_prefix.MakeLower();
+  CString temp_filename;
+  SafeCStringFormat(&temp_filename, _T("%s-%s"), hash_prefix, filename);
+  *resumable_filename = ConcatenatePath(temp_dir, temp_filename);
+
+  return resumable_filename->IsEmpty() ?
+         GOOPDATEDOWNLOAD_E_UNIQUE_FILE_PATH_EMPTY : S_OK;
+}
+
 HRESULT DownloadManager::CreateStateForApp(App* app, State** state) {
   ASSERT1(app);
   ASSERT1(state);
@@ -660,7 +1538,7 @@ HRESULT DownloadManager::DeleteStateForApp(App* app) {
 }
 
 DownloadManager::State::State(App* app, NetworkRequest* network_request)
-    : app_(app), network_request_(network_request) {
+    : app_(app), network_request_(network_request), is_canceled_(false) {
   ASSERT1(app);
   ASSERT1(network_request);
 }
@@ -676,7 +1554,12 @@ NetworkRequest* DownloadManager::State::network_request() const {
 }
 
 HRESULT DownloadManager::State::CancelNetworkRequest() {
+  ::InterlockedExchange(&is_canceled_, true);
   return network_request_->Cancel();
 }
 
+bool DownloadManager::State::is_canceled() const {
+  return !!is_canceled_;
+}
+
 }  // namespace omaha
@@ -19,9 +19,12 @@
 #include <windows.h>
 #include <atlstr.h>
 #include <memory>
+#include <set>
 #include <vector>
 
 #include "base/basictypes.h"
+#include "omaha/goopdate/single_flight.h"
+#include "omaha/net/preconnect_tracker.h"
 
 namespace omaha {
 
@@ -31,8 +34,10 @@ class File;
 class HttpClient;
 struct Lockable;        // TODO(omaha): make Lockable a class.
 class NetworkRequest;
+class NetworkRequestCallback;
 class Package;
 class PackageCache;
+class VerificationCache;
 
 // Public interface for the DownloadManager.
 class DownloadManagerInterface {
@@ -48,9 +53,14 @@ class DownloadManagerInterface {
   virtual HRESULT GetPackage(const Package* package,
                              const CString& dir) const = 0;
   virtual bool IsPackageAvailable(const Package* package) const = 0;
+  virtual HRESULT GetCachedPackageNames(
+      const CString& app_id,
+      const CString& version,
+      std::vector<CString>* package_names) const = 0;
   virtual void Cancel(App* app) = 0;
   virtual void CancelAll() = 0;
   virtual bool IsBusy() const = 0;
+  virtual void Preconnect(const std::vector<CString>& urls) = 0;
 };
 
 class DownloadManager : public DownloadManagerInterface {
@@ -81,6 +91,14 @@ class DownloadManager : public DownloadManagerInterface {
   // Returns true if the specified package is in the package cache.
   virtual bool IsPackageAvailable(const Package* package) const;
 
+  // Returns the names of the cached packages of a version of an app, which
+  // the update check sends so that the server can offer differential
+  // packages.
+  virtual HRESULT GetCachedPackageNames(
+      const CString& app_id,
+      const CString& version,
+      std::vector<CString>* package_names) const;
+
   // Cancels the download of specified app and makes DownloadApp return to the
   // caller at some point in the future. Cancel can be called multiple times
   // until the DownloadApp returns.
@@ -92,6 +110,13 @@ class DownloadManager : public DownloadManagerInterface {
   // Returns true if applications are downloading.
   virtual bool IsBusy() const;
 
+  // Connects to the hosts of |urls| ahead of their downloads, so that the
+  // downloads which use WinHttp reuse the connections of the session instead
+  // of resolving, connecting, and negotiating TLS again. Does nothing when
+  // the downloads try BITS first. This is a blocking call, which is made on a
+  // thread of the thread pool while the update check response is processed.
+  virtual void Preconnect(const std::vector<CString>& urls);
+
   // Returns a formatted message for the specified error in given language.
   static CString GetMessageForError(const ErrorContext& error_context,
                                     const CString& language);
@@ -109,15 +134,24 @@ class DownloadManager : public DownloadManagerInterface {
 
     HRESULT CancelNetworkRequest();
 
+    // Returns true once the network request is canceled.
+    bool is_canceled() const;
+
    private:
     // Not owned by this object.
     App* app_;
 
     std::unique_ptr<NetworkRequest> network_request_;
 
+    volatile LONG is_canceled_;
+
     DISALLOW_COPY_AND_ASSIGN(State);
   };
 
+  // The download of a package to a partial file which outlives the process,
+  // so that a later download resumes after the bytes it holds.
+  class ResumableDownload;
+
   // Creates a download state corresponding to the app. The state object is
   // owned by the download manager. A pointer to the state object is returned
   // to the caller.
@@ -126,12 +160,61 @@ class DownloadManager : public DownloadManagerInterface {
   HRESULT DeleteStateForApp(App* app);
 
   HRESULT DoDownloadPackage(Package* package, State* state);
+
+  // Downloads |package| from the network and stores it in the package cache,
+  // unless the same package is already being downloaded for another app, in
+  // which case waits for that download and shares its progress.
+  HRESULT DoDownloadPackageOnce(Package* package, State* state);
+
+  // Downloads |package| from the network and stores it in the package cache.
+  // The progress of the download is reported to |callback|.
+  HRESULT DoDownloadPackageFromNetwork(Package* package,
+                                       State* state,
+                                       NetworkRequestCallback* callback);
+
+  // Downloads the differential package of |package| and applies it to the
+  // cached package of the current version of the app. Returns S_FALSE if the
+  // server did not offer a differential package. The caller downloads the
+  // full package if this method does not return S_OK.
+  HRESULT DoDownloadDiffPackage(Package* package,
+                                State* state,
+                                NetworkRequestCallback* callback);
+
+  // Applies the differential package to the package cache. Called
+  // unimpersonated, like CachePackage.
+  HRESULT CachePackageFromPatch(const Package* package,
+                                File* patch_file,
+                                const CString* base_version);
+
+  // Returns the urls of the package of |hash| in the caches of the peers.
+  static std::vector<CString> BuildPeerCacheUrls(const CString& hash);
+
+  // Downloads |package| from |url| to |filename| and stores it in the package
+  // cache. If |resumable_download| is not NULL, |filename| is its partial
+  // file, and the download resumes after the bytes the file holds.
   HRESULT DoDownloadPackageFromUrl(const CString& url,
                                    const CString& filename,
                                    Package* package,
-                                   State* state);
-
-  HRESULT EnsureSignatureIsValid(const CString& file_path);
+                                   State* state,
+                                   ResumableDownload* resumable_download);
+
+  // Verifies the Authenticode signature of |file|, which is open at
+  // |file_path| and cannot be written to while it is open, unless a file of
+  // the same size and |expected_hash| was verified recently. The file must
+  // already match |expected_hash|, since a passing result is recorded for
+  // that hash.
+  HRESULT EnsureSignatureIsValid(File* file,
+                                 const CString& file_path,
+                                 const CString& expected_hash);
+
+  // Loads the verification cache from the package cache root, or creates an
+  // empty one.
+  void InitializeVerificationCache();
+
+  // Deletes the stale partial files of the resumable downloads in |temp_dir|
+  // the first time the process downloads to it. Each impersonated user has a
+  // temp directory of their own.
+  void DeleteStaleResumableDownloadsOnce(const CString& temp_dir);
 
   bool is_machine() const;
 
@@ -146,6 +229,12 @@ class DownloadManager : public DownloadManagerInterface {
   static HRESULT BuildUniqueFileName(const CString& filename,
                                      CString* unique_filename);
 
+  // Returns the full path to the partial file of the resumable download of
+  // the package of |expected_hash|, which is the same in every process.
+  static HRESULT BuildResumableFileName(const CString& filename,
+                                        const CString& expected_hash,
+                                        CString* resumable_filename);
+
   // Locks shared instance state for concurrent downloads. This lock is
   // owned by this class.
   mutable Lockable* volatile lock_;
@@ -157,8 +246,22 @@ class DownloadManager : public DownloadManagerInterface {
 
   std::vector<State*> download_state_;
 
+  // The temp directories swept for stale resumable downloads.
+  std::set<CString> swept_temp_dirs_;
+
+  // Coalesces the concurrent downloads of the same package by the apps of
+  // different bundles.
+  SingleFlight single_flight_;
+
+  // Accounts for the connections made by Preconnect.
+  PreconnectTracker preconnect_tracker_;
+
   std::unique_ptr<PackageCache> package_cache_;
 
+  // Remembers the packages whose signature was verified. NULL if the key of
+  // the cache could not be created.
+  std::unique_ptr<VerificationCache> verification_cache_;
+
   friend class DownloadManagerTest;
   DISALLOW_COPY_AND_ASSIGN(DownloadManager);
 };
@@ -25,6 +25,7 @@
 #include "omaha/base/path.h"
 #include "omaha/base/safe_format.h"
 #include "omaha/base/signatures.h"
+#include "omaha/base/string.h"
 #include "omaha/base/thread_pool.h"
 #include "omaha/base/timer.h"
 #include "omaha/base/utils.h"
@@ -80,6 +81,14 @@ class DownloadManagerTest : public AppTestBase {
                                                 unique_filename);
   }
 
+  static HRESULT BuildResumableFileName(const CString& filename,
+                                        const CString& expected_hash,
+                                        CString* resumable_filename) {
+    return DownloadManager::BuildResumableFileName(filename,
+                                                   expected_hash,
+                                                   resumable_filename);
+  }
+
  protected:
   explicit DownloadManagerTest(bool is_machine)
       : AppTestBase(is_machine, true) {}
@@ -164,6 +173,10 @@ class DownloadManagerTest : public AppTestBase {
     SetAppStateForUnitTest(app, new fsm::AppStateWaitingToDownload);
   }
 
+  void DeleteStaleResumableDownloadsOnce(const CString& temp_dir) {
+    download_manager_->DeleteStaleResumableDownloadsOnce(temp_dir);
+  }
+
   const CString cache_path_;
   std::unique_ptr<DownloadManager> download_manager_;
   DWORD disable_payload_authenticode_verification_ = 0; // Saved from registry
@@ -437,12 +450,10 @@ TEST_F(DownloadManagerUserTest, DownloadApp_Concurrent) {
     app = app_bundle_->GetApp(i);
     SetAppStateWaitingToDownload(app);
 
-    // WT_EXECUTELONGFUNCTION causes the thread pool to use multiple threads.
     ASSERT_HRESULT_SUCCEEDED(thread_pool.QueueUserWorkItem(
                                  std::make_unique<DownloadAppWorkItem>(
                                     download_manager_.get(), app),
-                                 COINIT_MULTITHREADED,
-                                 WT_EXECUTELONGFUNCTION));
+                                 COINIT_MULTITHREADED));
   }
 
   // Poll the state of the download manager and wait up to 1 minute for the
@@ -574,8 +585,7 @@ TEST_F(DownloadManagerUserTest, DISABLED_DownloadApp_Cancel) {
     ASSERT_HRESULT_SUCCEEDED(thread_pool.QueueUserWorkItem(
                                  std::make_unique<DownloadAppWorkItem>(
                                       download_manager_.get(), app),
-                                 COINIT_MULTITHREADED,
-                                 WT_EXECUTELONGFUNCTION));
+                                 COINIT_MULTITHREADED));
   }
 
   for (int i = 0; i != kNumApps; ++i) {
@@ -1256,6 +1266,52 @@ TEST_F(DownloadManagerUserTest, CachePackage) {
 #endif // VERIFY_PAYLOAD_AUTHENTICODE_SIGNATURE
 }
 
+TEST_F(DownloadManagerUserTest, DeleteStaleResumableDownloads) {
+  const CString dir(GetUniqueTempDirectoryName());
+  ASSERT_SUCCEEDED(CreateDir(dir, NULL));
+
+  const CString stale_partial(ConcatenatePath(dir,
+                                              _T("0123456789abcdef-a.exe")));
+  const CString stale_journal(stale_partial + _T(".download-journal"));
+  const CString orphan_journal(ConcatenatePath(
+      dir, _T("fedcba9876543210-b.exe.download-journal")));
+  const CString recent_partial(ConcatenatePath(dir,
+                                               _T("0123456789abcdef-c.exe")));
+  const CString other_file(ConcatenatePath(dir, _T("0123456789ABCDEF-d.exe")));
+  const CString files[] = {stale_partial, stale_journal, orphan_journal,
+                           recent_partial, other_file};
+
+  FILETIME eight_days_ago = {0};
+  Time64ToFileTime(GetCurrent100NSTime() - 8 * kDaysTo100ns, &eight_days_ago);
+  for (size_t i = 0; i != arraysize(files); ++i) {
+    File file;
+    ASSERT_SUCCEEDED(file.Open(files[i], true, false));
+    ASSERT_SUCCEEDED(file.Close());
+    if (files[i] != recent_partial) {
+      ASSERT_SUCCEEDED(File::SetFileTime(files[i], NULL, NULL,
+                                         &eight_days_ago));
+    }
+  }
+
+  // A partial file is deleted by its own age, with its journal, and a journal
+  // whose partial file is gone is deleted too. The files which do not have
+  // the format of a partial file are left alone.
+  DeleteStaleResumableDownloadsOnce(dir);
+  EXPECT_FALSE(File::Exists(stale_partial));
+  EXPECT_FALSE(File::Exists(stale_journal));
+  EXPECT_FALSE(File::Exists(orphan_journal));
+  EXPECT_TRUE(File::Exists(recent_partial));
+  EXPECT_TRUE(File::Exists(other_file));
+
+  // Each directory is swept once.
+  ASSERT_SUCCEEDED(File::SetFileTime(recent_partial, NULL, NULL,
+                                     &eight_days_ago));
+  DeleteStaleResumableDownloadsOnce(dir);
+  EXPECT_TRUE(File::Exists(recent_partial));
+
+  EXPECT_SUCCEEDED(DeleteDirectory(dir));
+}
+
 TEST_F(DownloadManagerUserTest, GetPackage_NotPresent) {
   App* app = NULL;
   ASSERT_SUCCEEDED(app_bundle_->createApp(CComBSTR(kAppGuid1), &app));
@@ -1309,6 +1365,25 @@ TEST(DownloadManagerTest, BuildUniqueFileName) {
   EXPECT_STRNE(file1, file2);
 }
 
+TEST(DownloadManagerTest, BuildResumableFileName) {
+  const TCHAR kHash[] =
+      _T("BA7816BF8F01CFEA414140DE5DAE2223B00361A396177A9CB410FF61F20015AD");
+  CString file1, file2, file3;
+  EXPECT_SUCCEEDED(DownloadManagerTest::BuildResumableFileName(
+      _T("a.exe"), kHash, &file1));
+  EXPECT_SUCCEEDED(DownloadManagerTest::BuildResumableFileName(
+      _T("a.exe"), kHash, &file2));
+  EXPECT_STREQ(file1, file2);
+  EXPECT_TRUE(String_EndsWith(file1, _T("\\ba7816bf8f01cfea-a.exe"), false));
+
+  EXPECT_SUCCEEDED(DownloadManagerTest::BuildResumableFileName(
+      _T("a.exe"), _T("00"), &file3));
+  EXPECT_STRNE(file1, file3);
+
+  EXPECT_EQ(E_UNEXPECTED, DownloadManagerTest::BuildResumableFileName(
+      _T("a.exe"), _T(""), &file3));
+}
+
 TEST(DownloadManagerTest, GetMessageForError) {
   const TCHAR* kEnglish = _T("en");
   EXPECT_SUCCEEDED(ResourceManager::Create(
@@ -207,8 +207,7 @@ class GoopdateImpl {
   HRESULT Main(HINSTANCE instance, const TCHAR* cmd_line, int cmd_show);
 
   HRESULT QueueUserWorkItem(std::unique_ptr<UserWorkItem> work_item,
-                            DWORD coinit_flags,
-                            uint32 flags);
+                            DWORD coinit_flags);
 
   void Stop();
 
@@ -414,14 +413,11 @@ GoopdateImpl::~GoopdateImpl() {
 }
 
 HRESULT GoopdateImpl::QueueUserWorkItem(std::unique_ptr<UserWorkItem> work_item,
-                                        DWORD coinit_flags,
-                                        uint32 flags) {
+                                        DWORD coinit_flags) {
   CORE_LOG(L3, (_T("[GoopdateImpl::QueueUserWorkItem]")));
   ASSERT1(work_item);
   ASSERT1(thread_pool_.get());
-  return thread_pool_->QueueUserWorkItem(std::move(work_item),
-                                         coinit_flags,
-                                         flags);
+  return thread_pool_->QueueUserWorkItem(std::move(work_item), coinit_flags);
 }
 
 void GoopdateImpl::Stop() {
@@ -1921,9 +1917,8 @@ HRESULT Goopdate::Main(HINSTANCE instance,
 }
 
 HRESULT Goopdate::QueueUserWorkItem(std::unique_ptr<UserWorkItem> work_item,
-                                    DWORD coinit_flags,
-                                    uint32 flags) {
-  return impl_->QueueUserWorkItem(std::move(work_item), coinit_flags, flags);
+                                    DWORD coinit_flags) {
+  return impl_->QueueUserWorkItem(std::move(work_item), coinit_flags);
 }
 
 void Goopdate::Stop() {
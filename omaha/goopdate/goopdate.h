@@ -48,8 +48,7 @@ class Goopdate {
   HRESULT Main(HINSTANCE instance, const TCHAR* cmd_line, int cmd_show);
 
   HRESULT QueueUserWorkItem(std::unique_ptr<UserWorkItem> work_item,
-                            DWORD coinit_flags,
-                            uint32 flags);
+                            DWORD coinit_flags);
 
   void Stop();
 
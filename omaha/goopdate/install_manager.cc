@@ -15,6 +15,7 @@
 
 #include "omaha/goopdate/install_manager.h"
 #include <vector>
+#include "omaha/base/const_object_names.h"
 #include "omaha/base/debug.h"
 #include "omaha/base/error.h"
 #include "omaha/base/logging.h"
@@ -58,6 +59,21 @@ bool GetInstallActionForEvent(
   return false;
 }
 
+// Initializes the lock held while the app is installed, which is shared by
+// the processes which install apps for the user or for the machine.
+bool InitializeAppInstallLock(bool is_machine,
+                              const GUID& app_guid,
+                              GLock* lock) {
+  ASSERT1(lock);
+
+  NamedObjectAttributes lock_attr;
+  GetNamedObjectAttributes(CString(kAppInstallSerializer) +
+                               GuidToString(app_guid),
+                           is_machine,
+                           &lock_attr);
+  return lock->InitializeWithSecAttr(lock_attr.name, &lock_attr.sa);
+}
+
 }  // namespace
 
 InstallManager::InstallManager(const Lockable* model_lock, bool is_machine)
@@ -141,7 +157,6 @@ HRESULT InstallManager::InstallApp(bool is_machine,
                                    InstallerWrapper* installer_wrapper,
                                    App* app,
                                    const CString& dir) {
-  UNREFERENCED_PARAMETER(is_machine);
   ASSERT1(installer_wrapper);
   ASSERT1(app);
 
@@ -156,8 +171,29 @@ HRESULT InstallManager::InstallApp(bool is_machine,
   CString installer_data;
   CString expected_version;
 
+  // The app lock is held from the pre-install writes to the registration
+  // check, including while the installer runs, so that another bundle which
+  // installs the same app does not interleave these steps. It is taken before
+  // install_lock and without the model lock, which are both released while
+  // the installer runs.
+  GLock app_install_lock;
+  if (!InitializeAppInstallLock(is_machine, app->app_guid(),
+                                &app_install_lock)) {
+    OPT_LOG(LE, (_T("[Could not init the app install lock]")));
+    const HRESULT hr = GOOPDATEINSTALL_E_FAILED_INIT_INSTALLER_LOCK;
+    __mutexScope(model_lock);
+    const CString message = InstallerWrapper::GetMessageForError(
+        hr, CString(), app->app_bundle()->display_language());
+    app->Error(ErrorContext(hr), message);
+    return hr;
+  }
+  __mutexScope(app_install_lock);
+
   AppManager& app_manager = *AppManager::Instance();
-  __mutexScope(app_manager.GetRegistryStableStateLock());
+  Lockable& install_lock = app_manager.GetInstallLock();
+  __mutexScope(install_lock);
+  app_manager.BeginInstall();
+  ON_SCOPE_EXIT_OBJ(app_manager, &AppManager::EndInstall);
 
   // TODO(omaha): If this does not get much simpler, extract method.
   AppVersion& next_version = *(app->next_version());
@@ -209,18 +245,10 @@ HRESULT InstallManager::InstallApp(bool is_machine,
 
     expected_version = next_version.install_manifest()->version;
 
-    // TODO(omaha3): All app key registry writes and reads must be protected by
-    // some lock to prevent race conditions caused by multiple bundles
-    // installing the same app. This includes while writing the pre-install
-    // data, while the installer is running, and while checking application
-    // registration (basically the rest of this method). An app-specific lock
-    // similar to the app install lock in Omaha 2 seems to be appropriate.
-    // (Omaha 2 only took that during install - not updates - though.)
-    // Some app installers may also check the state of other apps (i.e. to check
-    // for version compatibility). Should we protect this case as well?
-    // Is it safest to use the installer lock for this? What is the performance
-    // impact. If we do use the installer lock, it would need to be acquired
-    // here instead of in the InstallerWrapper::InstallApp path.
+    // The pre-install data and the registration checks below are written
+    // and read with install_lock held. The installers themselves run without
+    // it, and the InstallerWrapper keeps the installers of conflicting apps
+    // from running at the same time.
     if (!is_update) {
       HRESULT hr = app_manager.WritePreInstallData(*app);
       if (FAILED(hr)) {
@@ -249,6 +277,12 @@ HRESULT InstallManager::InstallApp(bool is_machine,
   InstallerResultInfo result_info;
 
   app->SetCurrentTimeAs(App::TIME_INSTALL_START);
+
+  // Release install_lock while the installer runs so that the installers of
+  // other apps can run at the same time. The callers of
+  // GetRegistryStableStateLock() keep waiting until EndInstall(), and the
+  // other installs of this app keep waiting for app_install_lock.
+  VERIFY1(install_lock.Unlock());
   HRESULT hr = installer_wrapper->InstallApp(user_token,
                                              app_guid,
                                              installer_path,
@@ -258,6 +292,7 @@ HRESULT InstallManager::InstallApp(bool is_machine,
                                              app->untrusted_data(),
                                              install_priority,
                                              &result_info);
+  VERIFY1(install_lock.Lock());
   app->SetCurrentTimeAs(App::TIME_INSTALL_COMPLETE);
 
   OPT_LOG(L1, (_T("[InstallApp returned][0x%x][%s][type:%d][code: %d][%s][%s]"),
@@ -0,0 +1,93 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/install_pipeline.h"
+
+#include <chrono>
+#include <thread>
+
+namespace omaha {
+
+namespace {
+
+int64_t ElapsedMs(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+}  // namespace
+
+InstallPipeline::InstallPipeline(const Stage& download, const Stage& install)
+    : download_(download),
+      install_(install),
+      num_downloaded_(0),
+      download_ms_(0),
+      install_ms_(0),
+      total_ms_(0) {
+}
+
+InstallPipeline::~InstallPipeline() {
+}
+
+void InstallPipeline::Run(size_t num_apps) {
+  const auto start = std::chrono::steady_clock::now();
+
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    num_downloaded_ = 0;
+  }
+  download_ms_ = 0;
+  install_ms_ = 0;
+
+  std::thread install_stage;
+  if (num_apps) {
+    install_stage = std::thread(&InstallPipeline::RunInstallStage,
+                                this,
+                                num_apps);
+  }
+
+  for (size_t i = 0; i != num_apps; ++i) {
+    const auto download_start = std::chrono::steady_clock::now();
+    download_(i);
+    download_ms_ += ElapsedMs(download_start);
+
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      ++num_downloaded_;
+    }
+    downloaded_.notify_one();
+  }
+
+  if (install_stage.joinable()) {
+    install_stage.join();
+  }
+
+  total_ms_ = ElapsedMs(start);
+}
+
+void InstallPipeline::RunInstallStage(size_t num_apps) {
+  for (size_t i = 0; i != num_apps; ++i) {
+    {
+      std::unique_lock<std::mutex> lock(lock_);
+      downloaded_.wait(lock, [this, i]() { return num_downloaded_ > i; });
+    }
+
+    const auto install_start = std::chrono::steady_clock::now();
+    install_(i);
+    install_ms_ += ElapsedMs(install_start);
+  }
+}
+
+}  // namespace omaha
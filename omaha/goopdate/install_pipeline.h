@@ -0,0 +1,76 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// InstallPipeline downloads and installs the apps of a bundle in two stages.
+// The apps are downloaded one after the other on the calling thread, and
+// installed one after the other, in the same order, on a thread of the
+// pipeline. An app is installed as soon as it is downloaded and the apps
+// before it are installed, so that the installers run while the next apps
+// download, and the bundle takes about as long as the longer of the two
+// stages instead of as long as both.
+//
+// This file has no platform dependencies.
+
+#ifndef OMAHA_GOOPDATE_INSTALL_PIPELINE_H_
+#define OMAHA_GOOPDATE_INSTALL_PIPELINE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
+#include "base/basictypes.h"
+
+namespace omaha {
+
+class InstallPipeline {
+ public:
+  // Called with the index of the app in the bundle.
+  using Stage = std::function<void(size_t)>;
+
+  InstallPipeline(const Stage& download, const Stage& install);
+  ~InstallPipeline();
+
+  // Downloads and installs the apps 0 to |num_apps| - 1. Returns when all of
+  // them are installed.
+  void Run(size_t num_apps);
+
+  // The time spent in each stage and in Run(), in milliseconds.
+  int64_t download_ms() const { return download_ms_; }
+  int64_t install_ms() const { return install_ms_; }
+  int64_t total_ms() const { return total_ms_; }
+
+ private:
+  void RunInstallStage(size_t num_apps);
+
+  const Stage download_;
+  const Stage install_;
+
+  std::mutex lock_;
+  std::condition_variable downloaded_;
+  size_t num_downloaded_;  // Protected by lock_.
+
+  int64_t download_ms_;
+  int64_t install_ms_;
+  int64_t total_ms_;
+
+  DISALLOW_COPY_AND_ASSIGN(InstallPipeline);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_GOOPDATE_INSTALL_PIPELINE_H_
@@ -0,0 +1,142 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/install_pipeline.h"
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace omaha {
+
+namespace {
+
+// Records the events of the stages in the order they happen.
+class EventRecorder {
+ public:
+  EventRecorder() {}
+
+  void Record(const std::string& event) {
+    std::lock_guard<std::mutex> lock(lock_);
+    events_.push_back(event);
+  }
+
+  std::vector<std::string> events() {
+    std::lock_guard<std::mutex> lock(lock_);
+    return events_;
+  }
+
+  // Returns the position of |event|, or -1 if it was not recorded.
+  int Position(const std::string& event) {
+    std::lock_guard<std::mutex> lock(lock_);
+    for (size_t i = 0; i != events_.size(); ++i) {
+      if (events_[i] == event) {
+        return static_cast<int>(i);
+      }
+    }
+    return -1;
+  }
+
+ private:
+  std::mutex lock_;
+  std::vector<std::string> events_;
+
+  DISALLOW_COPY_AND_ASSIGN(EventRecorder);
+};
+
+InstallPipeline::Stage MakeStage(EventRecorder* recorder,
+                                 const std::string& name,
+                                 std::chrono::milliseconds duration) {
+  return [=](size_t index) {
+    const std::string app(1, static_cast<char>('a' + index));
+    recorder->Record(name + " " + app + " start");
+    std::this_thread::sleep_for(duration);
+    recorder->Record(name + " " + app + " end");
+  };
+}
+
+const std::chrono::milliseconds kStageDuration(50);
+
+}  // namespace
+
+TEST(InstallPipelineTest, NoApps) {
+  int num_calls = 0;
+  InstallPipeline pipeline([&num_calls](size_t) { ++num_calls; },
+                           [&num_calls](size_t) { ++num_calls; });
+  pipeline.Run(0);
+  EXPECT_EQ(0, num_calls);
+  EXPECT_EQ(0, pipeline.download_ms());
+  EXPECT_EQ(0, pipeline.install_ms());
+}
+
+TEST(InstallPipelineTest, InstallsInOrderAfterDownload) {
+  EventRecorder recorder;
+  InstallPipeline pipeline(
+      MakeStage(&recorder, "download", kStageDuration),
+      MakeStage(&recorder, "install", std::chrono::milliseconds(5)));
+  pipeline.Run(4);
+
+  EXPECT_EQ(16, recorder.events().size());
+  for (char app = 'a'; app != 'e'; ++app) {
+    const std::string suffix(1, app);
+
+    // An app is installed after it is downloaded.
+    EXPECT_LT(recorder.Position("download " + suffix + " end"),
+              recorder.Position("install " + suffix + " start"));
+
+    // And after the apps before it are installed.
+    if (app != 'a') {
+      const std::string previous(1, static_cast<char>(app - 1));
+      EXPECT_LT(recorder.Position("install " + previous + " end"),
+                recorder.Position("install " + suffix + " start"));
+    }
+  }
+}
+
+TEST(InstallPipelineTest, InstallsWhileTheNextAppsDownload) {
+  EventRecorder recorder;
+  InstallPipeline pipeline(MakeStage(&recorder, "download", kStageDuration),
+                           MakeStage(&recorder, "install", kStageDuration));
+  pipeline.Run(2);
+
+  // The first app installs while the second one downloads.
+  EXPECT_LT(recorder.Position("install a start"),
+            recorder.Position("download b end"));
+}
+
+// With stages of the same length, the bundle takes about the time of one
+// stage plus the time to install the last app, instead of the sum of both
+// stages.
+TEST(InstallPipelineTest, Timings) {
+  const size_t kNumApps = 4;
+  EventRecorder recorder;
+  InstallPipeline pipeline(MakeStage(&recorder, "download", kStageDuration),
+                           MakeStage(&recorder, "install", kStageDuration));
+  pipeline.Run(kNumApps);
+
+  const int64_t stage_ms = kNumApps * kStageDuration.count();
+  EXPECT_GE(pipeline.download_ms(), stage_ms);
+  EXPECT_GE(pipeline.install_ms(), stage_ms);
+  EXPECT_GE(pipeline.total_ms(), stage_ms + kStageDuration.count());
+  EXPECT_LT(pipeline.total_ms(),
+            pipeline.download_ms() + pipeline.install_ms() -
+                kStageDuration.count());
+}
+
+}  // namespace omaha
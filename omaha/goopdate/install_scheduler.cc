@@ -0,0 +1,126 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/install_scheduler.h"
+
+#include <ctype.h>
+
+#include <algorithm>
+
+namespace omaha {
+
+namespace {
+
+bool IsSameApp(const std::string& a, const std::string& b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i != a.size(); ++i) {
+    if (tolower(static_cast<unsigned char>(a[i])) !=
+        tolower(static_cast<unsigned char>(b[i]))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Returns true if |a| declares a conflict with |b|.
+bool DeclaresConflict(const InstallScheduler::Installer& a,
+                      const InstallScheduler::Installer& b) {
+  for (size_t i = 0; i != a.conflicting_app_ids.size(); ++i) {
+    if (IsSameApp(a.conflicting_app_ids[i], b.app_id)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+InstallScheduler::InstallScheduler(size_t max_concurrent_installs)
+    : max_concurrent_installs_(std::max<size_t>(max_concurrent_installs, 1)) {
+}
+
+InstallScheduler::~InstallScheduler() {
+}
+
+void InstallScheduler::Run(const Installer& installer,
+                           const std::function<void()>& install) {
+  {
+    std::unique_lock<std::mutex> lock(lock_);
+    const std::list<const Installer*>::iterator position =
+        waiting_.insert(waiting_.end(), &installer);
+    changed_.wait(lock, [this, position]() { return CanStart(position); });
+    waiting_.erase(position);
+    running_.push_back(&installer);
+  }
+
+  install();
+
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    running_.remove(&installer);
+  }
+  changed_.notify_all();
+}
+
+bool InstallScheduler::IsConflict(const Installer& a, const Installer& b) {
+  return IsSameApp(a.app_id, b.app_id) ||
+         (a.is_msi && b.is_msi) ||
+         DeclaresConflict(a, b) ||
+         DeclaresConflict(b, a);
+}
+
+bool InstallScheduler::CanStart(
+    std::list<const Installer*>::const_iterator position) const {
+  if (IsBlocked(position)) {
+    return false;
+  }
+
+  // The earlier installers which are not blocked take the free slots first.
+  size_t num_slots_taken = running_.size();
+  for (std::list<const Installer*>::const_iterator it = waiting_.begin();
+       it != position;
+       ++it) {
+    if (!IsBlocked(it)) {
+      ++num_slots_taken;
+    }
+  }
+  return num_slots_taken < max_concurrent_installs_;
+}
+
+bool InstallScheduler::IsBlocked(
+    std::list<const Installer*>::const_iterator position) const {
+  const Installer& installer = **position;
+  for (std::list<const Installer*>::const_iterator it = running_.begin();
+       it != running_.end();
+       ++it) {
+    if (IsConflict(installer, **it)) {
+      return true;
+    }
+  }
+
+  // The installers which conflict run in the order they arrive.
+  for (std::list<const Installer*>::const_iterator it = waiting_.begin();
+       it != position;
+       ++it) {
+    if (IsConflict(installer, **it)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace omaha
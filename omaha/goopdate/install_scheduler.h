@@ -0,0 +1,88 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// InstallScheduler decides when the installers of the process run. The
+// installers of independent apps run concurrently, up to a limit. Two
+// installers of the same app never run at the same time, and neither do the
+// installers of two apps when one of them declares a conflict with the other.
+// MSI installers run one at a time, since Windows Installer runs a single
+// installation at a time anyway.
+//
+// The installers waiting to run start in the order they arrive, except that
+// an installer may start before the earlier installers which wait for a
+// conflicting installer to finish.
+//
+// This file has no platform dependencies.
+
+#ifndef OMAHA_GOOPDATE_INSTALL_SCHEDULER_H_
+#define OMAHA_GOOPDATE_INSTALL_SCHEDULER_H_
+
+#include <stddef.h>
+
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+
+namespace omaha {
+
+class InstallScheduler {
+ public:
+  struct Installer {
+    // The ids of the apps are compared without regard to case.
+    std::string app_id;
+    std::vector<std::string> conflicting_app_ids;
+    bool is_msi = false;
+  };
+
+  // Runs at most |max_concurrent_installs| installers at the same time. A
+  // limit of 0 is treated as 1.
+  explicit InstallScheduler(size_t max_concurrent_installs);
+  ~InstallScheduler();
+
+  // Waits until |installer| may run, then calls |install| on the calling
+  // thread.
+  void Run(const Installer& installer, const std::function<void()>& install);
+
+  size_t max_concurrent_installs() const { return max_concurrent_installs_; }
+
+  // Returns true if the installers may not run at the same time.
+  static bool IsConflict(const Installer& a, const Installer& b);
+
+ private:
+  // Returns true if the installer which waits at |position| may start.
+  bool CanStart(std::list<const Installer*>::const_iterator position) const;
+
+  // Returns true if the installer which waits at |position| conflicts with a
+  // running installer, or with an installer which waits before it.
+  bool IsBlocked(std::list<const Installer*>::const_iterator position) const;
+
+  const size_t max_concurrent_installs_;
+
+  std::mutex lock_;
+  std::condition_variable changed_;
+  std::list<const Installer*> waiting_;
+  std::list<const Installer*> running_;
+
+  DISALLOW_COPY_AND_ASSIGN(InstallScheduler);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_GOOPDATE_INSTALL_SCHEDULER_H_
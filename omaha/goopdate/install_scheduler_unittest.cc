@@ -0,0 +1,239 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/install_scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace omaha {
+
+namespace {
+
+InstallScheduler::Installer MakeInstaller(const std::string& app_id) {
+  InstallScheduler::Installer installer;
+  installer.app_id = app_id;
+  return installer;
+}
+
+// Stands in for the installer processes. Records which installers run at the
+// same time, and the order in which they start.
+class FakeProcessLauncher {
+ public:
+  FakeProcessLauncher() {}
+
+  // Runs the installer of |app_id| for |duration|.
+  void Launch(const std::string& app_id,
+              std::chrono::milliseconds duration) {
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      for (size_t i = 0; i != running_.size(); ++i) {
+        overlaps_.push_back(std::min(app_id, running_[i]) + "+" +
+                            std::max(app_id, running_[i]));
+      }
+      running_.push_back(app_id);
+      max_running_ = std::max(max_running_, running_.size());
+      started_.push_back(app_id);
+    }
+    std::this_thread::sleep_for(duration);
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      running_.erase(std::find(running_.begin(), running_.end(), app_id));
+    }
+  }
+
+  bool Overlapped(const std::string& a, const std::string& b) {
+    std::lock_guard<std::mutex> lock(lock_);
+    const std::string pair(std::min(a, b) + "+" + std::max(a, b));
+    return std::find(overlaps_.begin(), overlaps_.end(), pair) !=
+           overlaps_.end();
+  }
+
+  size_t max_running() {
+    std::lock_guard<std::mutex> lock(lock_);
+    return max_running_;
+  }
+
+  std::vector<std::string> started() {
+    std::lock_guard<std::mutex> lock(lock_);
+    return started_;
+  }
+
+ private:
+  std::mutex lock_;
+  std::vector<std::string> running_;
+  std::vector<std::string> overlaps_;
+  std::vector<std::string> started_;
+  size_t max_running_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(FakeProcessLauncher);
+};
+
+// Runs |installers| through |scheduler| on a thread each. The installers
+// arrive |arrival_interval| apart, and each of them runs for |duration|.
+void RunInstallers(InstallScheduler* scheduler,
+                   FakeProcessLauncher* launcher,
+                   const std::vector<InstallScheduler::Installer>& installers,
+                   std::chrono::milliseconds arrival_interval,
+                   std::chrono::milliseconds duration) {
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i != installers.size(); ++i) {
+    const InstallScheduler::Installer* installer = &installers[i];
+    threads.emplace_back([=]() {
+      scheduler->Run(*installer, [=]() {
+        launcher->Launch(installer->app_id, duration);
+      });
+    });
+    std::this_thread::sleep_for(arrival_interval);
+  }
+  for (size_t i = 0; i != threads.size(); ++i) {
+    threads[i].join();
+  }
+}
+
+const std::chrono::milliseconds kArrivalInterval(10);
+const std::chrono::milliseconds kInstallDuration(100);
+
+}  // namespace
+
+TEST(InstallSchedulerTest, IsConflict) {
+  InstallScheduler::Installer a(MakeInstaller("{APP-A}"));
+  InstallScheduler::Installer b(MakeInstaller("{app-b}"));
+  EXPECT_FALSE(InstallScheduler::IsConflict(a, b));
+
+  // The same app conflicts with itself, whatever the case of its id.
+  EXPECT_TRUE(InstallScheduler::IsConflict(a, MakeInstaller("{app-a}")));
+
+  // A declared conflict goes both ways.
+  a.conflicting_app_ids.push_back("{APP-B}");
+  EXPECT_TRUE(InstallScheduler::IsConflict(a, b));
+  EXPECT_TRUE(InstallScheduler::IsConflict(b, a));
+  a.conflicting_app_ids.clear();
+
+  // MSI installers conflict with each other only.
+  a.is_msi = true;
+  EXPECT_FALSE(InstallScheduler::IsConflict(a, b));
+  b.is_msi = true;
+  EXPECT_TRUE(InstallScheduler::IsConflict(a, b));
+}
+
+TEST(InstallSchedulerTest, ZeroLimitRunsOneInstaller) {
+  EXPECT_EQ(1, InstallScheduler(0).max_concurrent_installs());
+}
+
+TEST(InstallSchedulerTest, RunsIndependentAppsConcurrently) {
+  InstallScheduler scheduler(3);
+  FakeProcessLauncher launcher;
+  std::vector<InstallScheduler::Installer> installers;
+  installers.push_back(MakeInstaller("a"));
+  installers.push_back(MakeInstaller("b"));
+  installers.push_back(MakeInstaller("c"));
+
+  const auto start = std::chrono::steady_clock::now();
+  RunInstallers(&scheduler, &launcher, installers,
+                kArrivalInterval, kInstallDuration);
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+
+  EXPECT_EQ(3, launcher.max_running());
+  EXPECT_TRUE(launcher.Overlapped("a", "b"));
+  EXPECT_TRUE(launcher.Overlapped("b", "c"));
+  EXPECT_LT(elapsed, 2 * kInstallDuration);
+}
+
+TEST(InstallSchedulerTest, RespectsTheLimit) {
+  InstallScheduler scheduler(2);
+  FakeProcessLauncher launcher;
+  std::vector<InstallScheduler::Installer> installers;
+  for (char app_id = 'a'; app_id != 'g'; ++app_id) {
+    installers.push_back(MakeInstaller(std::string(1, app_id)));
+  }
+
+  RunInstallers(&scheduler, &launcher, installers,
+                kArrivalInterval, kInstallDuration);
+
+  EXPECT_EQ(2, launcher.max_running());
+
+  // Installers which wait for a free slot start in the order they arrive.
+  const std::vector<std::string> started(launcher.started());
+  ASSERT_EQ(6, started.size());
+  for (size_t i = 0; i != started.size(); ++i) {
+    EXPECT_EQ(installers[i].app_id, started[i]);
+  }
+}
+
+TEST(InstallSchedulerTest, SerializesConflictingApps) {
+  InstallScheduler scheduler(4);
+  FakeProcessLauncher launcher;
+  std::vector<InstallScheduler::Installer> installers;
+  installers.push_back(MakeInstaller("a"));
+  installers.push_back(MakeInstaller("b"));
+  installers.back().conflicting_app_ids.push_back("a");
+  installers.push_back(MakeInstaller("c"));
+
+  RunInstallers(&scheduler, &launcher, installers,
+                kArrivalInterval, kInstallDuration);
+
+  EXPECT_FALSE(launcher.Overlapped("a", "b"));
+  EXPECT_TRUE(launcher.Overlapped("a", "c"));
+
+  // The installer which does not conflict starts before the installer which
+  // waits for a conflicting one.
+  const std::vector<std::string> started(launcher.started());
+  ASSERT_EQ(3, started.size());
+  EXPECT_EQ("a", started[0]);
+  EXPECT_EQ("c", started[1]);
+  EXPECT_EQ("b", started[2]);
+}
+
+TEST(InstallSchedulerTest, SerializesTheSameApp) {
+  InstallScheduler scheduler(4);
+  FakeProcessLauncher launcher;
+  std::vector<InstallScheduler::Installer> installers;
+  installers.push_back(MakeInstaller("a"));
+  installers.push_back(MakeInstaller("A"));
+
+  RunInstallers(&scheduler, &launcher, installers,
+                kArrivalInterval, kInstallDuration);
+
+  EXPECT_EQ(1, launcher.max_running());
+}
+
+TEST(InstallSchedulerTest, SerializesMsiInstallers) {
+  InstallScheduler scheduler(4);
+  FakeProcessLauncher launcher;
+  std::vector<InstallScheduler::Installer> installers;
+  installers.push_back(MakeInstaller("msi1"));
+  installers.back().is_msi = true;
+  installers.push_back(MakeInstaller("msi2"));
+  installers.back().is_msi = true;
+  installers.push_back(MakeInstaller("exe"));
+
+  RunInstallers(&scheduler, &launcher, installers,
+                kArrivalInterval, kInstallDuration);
+
+  EXPECT_FALSE(launcher.Overlapped("msi1", "msi2"));
+  EXPECT_TRUE(launcher.Overlapped("msi1", "exe"));
+}
+
+}  // namespace omaha
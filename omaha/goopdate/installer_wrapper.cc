@@ -13,6 +13,8 @@
 // limitations under the License.
 // ========================================================================
 
+#include <set>
+#include <string>
 #include <vector>
 #include "goopdate/omaha3_idl.h"
 #include "omaha/goopdate/installer_wrapper.h"
@@ -24,16 +26,20 @@
 #include "omaha/base/logging.h"
 #include "omaha/base/path.h"
 #include "omaha/base/process.h"
+#include "omaha/base/reg_key.h"
 #include "omaha/base/safe_format.h"
 #include "omaha/base/scope_guard.h"
 #include "omaha/base/string.h"
 #include "omaha/base/synchronized.h"
 #include "omaha/base/system_info.h"
 #include "omaha/base/utils.h"
+#include "omaha/common/app_registry_utils.h"
+#include "omaha/common/config_manager.h"
 #include "omaha/common/const_cmd_line.h"
 #include "omaha/common/const_goopdate.h"
 #include "omaha/common/goopdate_utils.h"
 #include "omaha/goopdate/app_manager.h"
+#include "omaha/goopdate/install_scheduler.h"
 #include "omaha/goopdate/server_resource.h"
 #include "omaha/goopdate/string_formatter.h"
 #include "omaha/goopdate/worker_metrics.h"
@@ -125,6 +131,80 @@ void GetSystemErrorString(uint32 error_code,
   ASSERT1(!error_string->IsEmpty());
 }
 
+// Returns the ids of the apps which the app declares conflicts with in its
+// Clients key.
+std::vector<std::string> ReadInstallConflicts(bool is_machine,
+                                              const GUID& app_guid) {
+  std::vector<std::string> app_ids;
+
+  CString install_conflicts;
+  if (FAILED(RegKey::GetValue(
+          app_registry_utils::GetAppClientsKey(is_machine,
+                                               GuidToString(app_guid)),
+          kRegValueInstallConflicts,
+          &install_conflicts))) {
+    return app_ids;
+  }
+
+  int pos = 0;
+  for (CString app_id = install_conflicts.Tokenize(_T(";"), pos);
+       !app_id.IsEmpty();
+       app_id = install_conflicts.Tokenize(_T(";"), pos)) {
+    app_id.Trim();
+    if (!app_id.IsEmpty()) {
+      app_ids.push_back(CStringA(app_id).GetString());
+    }
+  }
+  return app_ids;
+}
+
+// Holds the named locks of the app being installed and of the apps it
+// conflicts with, so that conflicting installers do not run at the same time
+// across instances. The locks are acquired in the order of the app ids to
+// avoid deadlocks.
+class AppInstallLocks {
+ public:
+  explicit AppInstallLocks(bool is_machine) : is_machine_(is_machine) {}
+
+  ~AppInstallLocks() {
+    for (size_t i = locks_.size(); i != 0; --i) {
+      VERIFY1(locks_[i - 1]->Unlock());
+    }
+  }
+
+  HRESULT Acquire(const InstallScheduler::Installer& installer) {
+    std::set<CString> app_ids;
+    app_ids.insert(CString(installer.app_id.c_str()).MakeUpper());
+    for (size_t i = 0; i != installer.conflicting_app_ids.size(); ++i) {
+      app_ids.insert(
+          CString(installer.conflicting_app_ids[i].c_str()).MakeUpper());
+    }
+
+    for (std::set<CString>::const_iterator it = app_ids.begin();
+         it != app_ids.end();
+         ++it) {
+      NamedObjectAttributes lock_attr;
+      GetNamedObjectAttributes(CString(kInstallManagerSerializer) + *it,
+                               is_machine_,
+                               &lock_attr);
+      std::unique_ptr<GLock> lock(new GLock);
+      if (!lock->InitializeWithSecAttr(lock_attr.name, &lock_attr.sa) ||
+          !lock->Lock()) {
+        OPT_LOG(LE, (_T("[Could not acquire the app install lock][%s]"), *it));
+        return GOOPDATEINSTALL_E_FAILED_INIT_INSTALLER_LOCK;
+      }
+      locks_.push_back(std::move(lock));
+    }
+    return S_OK;
+  }
+
+ private:
+  const bool is_machine_;
+  std::vector<std::unique_ptr<GLock>> locks_;
+
+  DISALLOW_COPY_AND_ASSIGN(AppInstallLocks);
+};
+
 }  // namespace
 
 InstallerWrapper::InstallerWrapper(bool is_machine)
@@ -146,6 +226,9 @@ HRESULT InstallerWrapper::Initialize() {
     return GOOPDATEINSTALL_E_FAILED_INIT_INSTALLER_LOCK;
   }
 
+  install_scheduler_.reset(new InstallScheduler(
+      ConfigManager::Instance()->GetMaxConcurrentInstalls(NULL)));
+
   return S_OK;
 }
 
@@ -430,7 +513,10 @@ HRESULT InstallerWrapper::DoExecuteAndWaitForInstaller(
                executable_path, command_line, GuidToString(app_guid)));
   ASSERT1(result_info);
 
-  AppManager::Instance()->ClearInstallerResultApiValues(app_guid);
+  AppManager& app_manager = *AppManager::Instance();
+  __mutexBlock(app_manager.GetInstallLock()) {
+    app_manager.ClearInstallerResultApiValues(app_guid);
+  }
 
   // Create modified environment block to pass untrusted data.
   std::vector<TCHAR> env_block;
@@ -697,7 +783,7 @@ HRESULT InstallerWrapper::CheckApplicationRegistration(
   return S_OK;
 }
 
-// Assumes installer_lock_ has been initialized.
+// Assumes installer_lock_ and install_scheduler_ have been initialized.
 HRESULT InstallerWrapper::DoInstallApp(HANDLE user_token,
                                        const GUID& app_guid,
                                        const CString& installer_path,
@@ -736,9 +822,26 @@ HRESULT InstallerWrapper::DoInstallApp(HANDLE user_token,
     return hr;
   }
 
-  // Acquire the global lock here. This will ensure that we are the only
-  // installer running of the multiple goopdates.
-  __mutexBlock(installer_lock_) {
+  InstallScheduler::Installer installer;
+  installer.app_id = CStringA(GuidToString(app_guid)).GetString();
+  installer.conflicting_app_ids = ReadInstallConflicts(is_machine_, app_guid);
+  installer.is_msi = installer_type == MSI_INSTALLER;
+
+  install_scheduler_->Run(installer, [&]() {
+    AppInstallLocks app_locks(is_machine_);
+    hr = app_locks.Acquire(installer);
+    if (FAILED(hr)) {
+      return;
+    }
+
+    // MSI installers, and all the installers when they may not run
+    // concurrently, also acquire the global lock. This ensures that we are the
+    // only such installer running of the multiple goopdates.
+    const bool is_serialized =
+        installer.is_msi || install_scheduler_->max_concurrent_installs() == 1;
+    if (is_serialized) {
+      VERIFY1(installer_lock_.Lock());
+    }
     hr = ExecuteAndWaitForInstaller(user_token,
                                     app_guid,
                                     executable_path,
@@ -748,7 +851,10 @@ HRESULT InstallerWrapper::DoInstallApp(HANDLE user_token,
                                     untrusted_data,
                                     install_priority,
                                     result_info);
-  }
+    if (is_serialized) {
+      VERIFY1(installer_lock_.Unlock());
+    }
+  });
 
   if (FAILED(hr)) {
     CORE_LOG(LE, (_T("[ExecuteAndWaitForInstaller failed][0x%08x][%s]"),
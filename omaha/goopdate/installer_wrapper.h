@@ -13,14 +13,25 @@
 // limitations under the License.
 // ========================================================================
 //
-// InstallerWrapper supports installing one app at a time. Installs from
-// multiple instances are serialized by a mutex.
+// InstallerWrapper runs the installers of independent apps concurrently, up
+// to the MaxConcurrentInstalls policy. The installers of the same app or of
+// conflicting apps, and MSI installers, run one at a time, also across
+// multiple instances. The policy defaults to 1, because EXE installers which
+// run msiexec internally are not known to be MSI installers, and fail with
+// ERROR_INSTALL_ALREADY_RUNNING if they run concurrently with another MSI
+// install.
+//
+// The conflicting apps are read from the InstallConflicts value of the Clients
+// key of the app, which is written by the installer of the app. Therefore, the
+// first install of an app does not know its conflicts, and only excludes the
+// installers of the same app and the apps which declare a conflict with it.
 
 #ifndef OMAHA_GOOPDATE_INSTALLER_WRAPPER_H_
 #define OMAHA_GOOPDATE_INSTALLER_WRAPPER_H_
 
 #include <windows.h>
 #include <atlstr.h>
+#include <memory>
 #include <queue>
 #include <utility>
 
@@ -34,6 +45,7 @@
 namespace omaha {
 
 class AppVersion;
+class InstallScheduler;
 class Process;
 
 
@@ -160,12 +172,16 @@ class InstallerWrapper {
   // Interval to wait for installer completion.
   static const int kInstallerCompleteIntervalMs = 30 * 60 * 1000;
 
-  // Ensures that a single installer is run by us at a time.
+  // Ensures that a single MSI installer is run by us at a time, or a single
+  // installer when they may not run concurrently.
   // Not sure if we can run installers in different sessions without
   // interference. In that case we can use a local lock instead of a
   // global lock.
   GLock installer_lock_;
 
+  // Decides when the installers of this instance run.
+  std::unique_ptr<InstallScheduler> install_scheduler_;
+
   friend class InstallerWrapperTest;
 
   DISALLOW_COPY_AND_ASSIGN(InstallerWrapper);
@@ -190,8 +190,7 @@ class ATL_NO_VTABLE OnDemand
                 session_id_,
                 dup_impersonation_token.GetHandle(),
                 dup_primary_token.GetHandle())),
-        COINIT_APARTMENTTHREADED,
-        WT_EXECUTELONGFUNCTION);
+        COINIT_APARTMENTTHREADED);
     if (FAILED(hr)) {
       CORE_LOG(LE, (_T("[QueueUserWorkItem failed][0x%x]"), hr));
       return hr;
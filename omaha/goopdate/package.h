@@ -68,6 +68,18 @@ class Package
   // Returns expected file hashes.
   CString expected_hash() const;
 
+  // Sets the differential package, which turns the cached package of the
+  // current version of the app into this package.
+  void SetDiffFileInfo(const CString& filename,
+                       uint64 size,
+                       const CString& hash);
+
+  // Returns the name of the differential package, or an empty string if the
+  // server did not offer one.
+  CString diff_filename() const;
+  uint64 diff_expected_size() const;
+  CString diff_expected_hash() const;
+
   uint64 bytes_downloaded() const;
 
   time64 next_download_retry_time() const;
@@ -86,6 +98,11 @@ class Package
   uint64 expected_size_;
   CString expected_hash_;
 
+  // The differential package, if any.
+  CString diff_filename_;
+  uint64 diff_expected_size_;
+  CString diff_expected_hash_;
+
   int bytes_downloaded_;
   int bytes_total_;
   time64 next_download_retry_time_;
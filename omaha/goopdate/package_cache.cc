@@ -16,9 +16,13 @@
 #include "omaha/goopdate/package_cache.h"
 
 #include <shlwapi.h>
+#include <winioctl.h>
 #include <algorithm>
+#include <map>
+#include <string>
 #include <vector>
 
+#include "omaha/base/const_object_names.h"
 #include "omaha/base/debug.h"
 #include "omaha/base/error.h"
 #include "omaha/base/file.h"
@@ -27,13 +31,41 @@
 #include "omaha/base/string.h"
 #include "omaha/base/signatures.h"
 #include "omaha/base/signaturevalidator.h"
+#include "omaha/base/time.h"
 #include "omaha/base/utils.h"
 #include "omaha/common/config_manager.h"
 #include "omaha/goopdate/package_cache_internal.h"
 #include "omaha/goopdate/worker_metrics.h"
 
+// Block cloning is declared by the Windows 10 SDK.
+#ifndef FSCTL_DUPLICATE_EXTENTS_TO_FILE
+#define FSCTL_DUPLICATE_EXTENTS_TO_FILE \
+    CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 209, METHOD_BUFFERED, FILE_WRITE_DATA)
+
+typedef struct _DUPLICATE_EXTENTS_DATA {
+  HANDLE FileHandle;
+  LARGE_INTEGER SourceFileOffset;
+  LARGE_INTEGER TargetFileOffset;
+  LARGE_INTEGER ByteCount;
+} DUPLICATE_EXTENTS_DATA;
+#endif
+
 namespace omaha {
 
+namespace {
+
+// The directory under the cache root which stores the contents of the
+// packages by digest, in content-addressed mode.
+const TCHAR* const kContentDirName = _T("_content");
+
+// The file under the cache root which stores the catalog of the packages.
+const TCHAR* const kCatalogFileName = _T("_catalog");
+
+// A single block cloning request must be smaller than 4 GB.
+const uint64 kMaxCloneSize = 0xFFFFFFFFULL - 64 * 1024;
+
+}  // namespace
+
 namespace internal {
 
 bool PackageSortByTimePredicate(const PackageInfo& package1,
@@ -181,6 +213,202 @@ HRESULT FileCopy(File* source_file, const CString& destination) {
   return S_OK;
 }
 
+HRESULT GetFileInformation(const CString& file_name,
+                           BY_HANDLE_FILE_INFORMATION* file_info) {
+  ASSERT1(file_info);
+
+  scoped_hfile file(::CreateFile(file_name,
+                                 FILE_READ_ATTRIBUTES,
+                                 FILE_SHARE_READ | FILE_SHARE_WRITE |
+                                     FILE_SHARE_DELETE,
+                                 NULL,
+                                 OPEN_EXISTING,
+                                 FILE_ATTRIBUTE_NORMAL,
+                                 NULL));
+  if (!file) {
+    return HRESULTFromLastError();
+  }
+
+  if (!::GetFileInformationByHandle(get(file), file_info)) {
+    return HRESULTFromLastError();
+  }
+
+  return S_OK;
+}
+
+HRESULT GetFileId(const CString& file_name, uint64* file_id) {
+  ASSERT1(file_id);
+
+  BY_HANDLE_FILE_INFORMATION file_info = {0};
+  HRESULT hr = GetFileInformation(file_name, &file_info);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  *file_id = (static_cast<uint64>(file_info.nFileIndexHigh) << 32) |
+             file_info.nFileIndexLow;
+  return S_OK;
+}
+
+HRESULT GetFileLinkCount(const CString& file_name, uint32* link_count) {
+  ASSERT1(link_count);
+
+  BY_HANDLE_FILE_INFORMATION file_info = {0};
+  HRESULT hr = GetFileInformation(file_name, &file_info);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  *link_count = file_info.nNumberOfLinks;
+  return S_OK;
+}
+
+HRESULT CloneFile(const CString& source, const CString& destination) {
+  scoped_hfile source_file(::CreateFile(source,
+                                        GENERIC_READ,
+                                        FILE_SHARE_READ,
+                                        NULL,
+                                        OPEN_EXISTING,
+                                        FILE_ATTRIBUTE_NORMAL,
+                                        NULL));
+  if (!source_file) {
+    return HRESULTFromLastError();
+  }
+
+  LARGE_INTEGER size = {0};
+  if (!::GetFileSizeEx(get(source_file), &size)) {
+    return HRESULTFromLastError();
+  }
+  if (!size.QuadPart || static_cast<uint64>(size.QuadPart) > kMaxCloneSize) {
+    return E_NOTIMPL;
+  }
+
+  // The cloned range must be a whole number of clusters.
+  TCHAR volume[MAX_PATH] = {0};
+  DWORD sectors_per_cluster = 0;
+  DWORD bytes_per_sector = 0;
+  DWORD free_clusters = 0;
+  DWORD total_clusters = 0;
+  if (!::GetVolumePathName(source, volume, arraysize(volume)) ||
+      !::GetDiskFreeSpace(volume,
+                          &sectors_per_cluster,
+                          &bytes_per_sector,
+                          &free_clusters,
+                          &total_clusters)) {
+    return HRESULTFromLastError();
+  }
+  const uint64 cluster_size =
+      static_cast<uint64>(sectors_per_cluster) * bytes_per_sector;
+  if (!cluster_size) {
+    return E_UNEXPECTED;
+  }
+
+  scoped_hfile destination_file(::CreateFile(destination,
+                                             GENERIC_READ | GENERIC_WRITE,
+                                             0,
+                                             NULL,
+                                             CREATE_ALWAYS,
+                                             FILE_ATTRIBUTE_NORMAL,
+                                             NULL));
+  if (!destination_file) {
+    return HRESULTFromLastError();
+  }
+
+  FILE_END_OF_FILE_INFO end_of_file = {0};
+  end_of_file.EndOfFile = size;
+
+  DUPLICATE_EXTENTS_DATA extents = {0};
+  extents.FileHandle = get(source_file);
+  extents.ByteCount.QuadPart =
+      (size.QuadPart + cluster_size - 1) / cluster_size * cluster_size;
+
+  DWORD bytes_returned = 0;
+  if (!::SetFileInformationByHandle(get(destination_file),
+                                    FileEndOfFileInfo,
+                                    &end_of_file,
+                                    sizeof(end_of_file)) ||
+      !::DeviceIoControl(get(destination_file),
+                         FSCTL_DUPLICATE_EXTENTS_TO_FILE,
+                         &extents,
+                         sizeof(extents),
+                         NULL,
+                         0,
+                         &bytes_returned,
+                         NULL)) {
+    const HRESULT hr = HRESULTFromLastError();
+    reset(destination_file);
+    ::DeleteFile(destination);
+    return hr;
+  }
+
+  return S_OK;
+}
+
+bool FilePatchSource::ReadAt(uint64_t offset, uint8_t* buffer, size_t size) {
+  ASSERT1(buffer);
+
+  // File::ReadAt does not allow reading zero bytes.
+  if (!size) {
+    return true;
+  }
+  if (offset > size_ || size > size_ - offset) {
+    return false;
+  }
+
+  uint32 bytes_read = 0;
+  HRESULT hr = file_->ReadAt(static_cast<uint32>(offset),
+                             buffer,
+                             static_cast<uint32>(size),
+                             0,
+                             &bytes_read);
+  return SUCCEEDED(hr) && bytes_read == size;
+}
+
+int64_t FilePatchReader::Read(uint8_t* buffer, size_t size) {
+  ASSERT1(buffer);
+
+  uint32 bytes_read = 0;
+  HRESULT hr = file_->Read(static_cast<uint32>(size), buffer, &bytes_read);
+  return SUCCEEDED(hr) ? static_cast<int64_t>(bytes_read) : -1;
+}
+
+bool FilePatchWriter::Write(const uint8_t* data, size_t size) {
+  ASSERT1(data);
+
+  uint32 bytes_written = 0;
+  HRESULT hr = file_->Write(data, static_cast<uint32>(size), &bytes_written);
+  return SUCCEEDED(hr) && bytes_written == size;
+}
+
+BinaryPatch::Result FilePatch(File* base_file,
+                              File* patch_file,
+                              const CString& destination) {
+  ASSERT1(base_file);
+  ASSERT1(patch_file);
+
+  uint32 base_size = 0;
+  if (FAILED(base_file->GetLength(&base_size)) ||
+      FAILED(patch_file->SeekToBegin())) {
+    return BinaryPatch::kReadError;
+  }
+
+  File destination_file;
+  if (FAILED(destination_file.Open(destination, true, false))) {
+    return BinaryPatch::kWriteError;
+  }
+
+  FilePatchSource source(base_file, base_size);
+  FilePatchReader reader(patch_file);
+  FilePatchWriter writer(&destination_file);
+  const BinaryPatch::Result result =
+      BinaryPatch::Apply(&source, &reader, &writer);
+
+  if (FAILED(destination_file.Close()) && result == BinaryPatch::kSuccess) {
+    return BinaryPatch::kWriteError;
+  }
+  return result;
+}
+
 }  // namespace internal
 
 PackageCache::PackageCache() {
@@ -189,13 +417,17 @@ PackageCache::PackageCache() {
 
   cache_size_limit_bytes_ = 1024 * 1024 * static_cast<uint64>(
     ConfigManager::Instance()->GetPackageCacheSizeLimitMBytes(NULL));
+
+  content_addressed_ =
+    ConfigManager::Instance()->ShouldStorePackagesByContent();
 }
 
 PackageCache::~PackageCache() {
 }
 
-HRESULT PackageCache::Initialize(const CString& cache_root) {
-  CORE_LOG(L3, (_T("[PackageCache::Initialize][%s]"), cache_root));
+HRESULT PackageCache::Initialize(bool is_machine, const CString& cache_root) {
+  CORE_LOG(L3, (_T("[PackageCache::Initialize][%d][%s]"),
+                is_machine, cache_root));
 
   __mutexScope(cache_lock_);
 
@@ -203,6 +435,16 @@ HRESULT PackageCache::Initialize(const CString& cache_root) {
     return E_INVALIDARG;
   }
 
+  NamedObjectAttributes lock_attr;
+  GetNamedObjectAttributes(kPackageCacheLock, is_machine, &lock_attr);
+  if (!shared_lock_.InitializeWithSecAttr(lock_attr.name, &lock_attr.sa) &&
+      !shared_lock_.InitializeWithSecAttr(lock_attr.name, NULL)) {
+    const HRESULT hr = HRESULTFromLastError();
+    CORE_LOG(LE, (_T("[failed to initialize the cache lock][0x%x]"), hr));
+    return hr;
+  }
+  __mutexScope(shared_lock_);
+
   HRESULT hr = CreateDir(cache_root, NULL);
   if (FAILED(hr)) {
     CORE_LOG(LE, (_T("[CreateDir failed][0x%x][%s]"), hr, cache_root));
@@ -211,6 +453,23 @@ HRESULT PackageCache::Initialize(const CString& cache_root) {
 
   cache_root_ = cache_root;
 
+  const CString content_dir(GetContentDir(cache_root_));
+  if (content_addressed_) {
+    hr = LoadContentIndex();
+    if (FAILED(hr)) {
+      CORE_LOG(LW, (_T("[LoadContentIndex failed][0x%x]"), hr));
+    }
+  } else if (File::Exists(content_dir)) {
+    // Nothing would delete the stored contents. The package files which are
+    // linked to them keep their contents.
+    hr = DeleteBeforeOrAfterReboot(content_dir);
+    CORE_LOG(L3, (_T("[deleted stored contents][0x%x]"), hr));
+
+    // The catalog counts the contents once per digest.
+    ::DeleteFile(ConcatenatePath(cache_root_, kCatalogFileName));
+  }
+
+  LoadCatalog();
   return S_OK;
 }
 
@@ -232,6 +491,13 @@ bool PackageCache::IsCached(const Key& key, const CString& hash) const {
 HRESULT PackageCache::Put(const Key& key,
                           File* source_file,
                           const CString& hash) {
+  return Put(key, source_file, hash, Verifier());
+}
+
+HRESULT PackageCache::Put(const Key& key,
+                          File* source_file,
+                          const CString& hash,
+                          const Verifier& verifier) {
   ASSERT1(source_file);
 
   ++metric_worker_package_cache_put_total;
@@ -239,6 +505,8 @@ HRESULT PackageCache::Put(const Key& key,
                 key.ToString(), hash));
 
   __mutexScope(cache_lock_);
+  __mutexScope(shared_lock_);
+  ReloadCatalog();
 
   if (key.app_id().IsEmpty() || key.version().IsEmpty() ||
       key.package_name().IsEmpty() ) {
@@ -259,8 +527,36 @@ HRESULT PackageCache::Put(const Key& key,
     return hr;
   }
 
-  // TODO(omaha): consider not overwriting the file if the file is
-  // in the cache and it is valid.
+  // The contents of the package are not copied nor hashed again if they are
+  // already stored for another key.
+  const std::string digest(content_addressed_ ?
+      PackageCacheIndex::NormalizeDigest(std::string(CT2A(hash))) :
+      std::string());
+  if (!digest.empty() && File::Exists(BuildContentFileName(digest))) {
+    hr = LinkContent(key, digest, destination_file);
+    if (SUCCEEDED(hr)) {
+      hr = VerifyPackage(destination_file, NULL, verifier);
+      if (FAILED(hr)) {
+        CORE_LOG(LE, (_T("[failed to verify package][0x%08x][%s]"),
+                      hr, destination_file));
+        VERIFY_SUCCEEDED(RemovePackageFile(key, destination_file));
+        return hr;
+      }
+      UpdateCatalog(key, destination_file);
+      ++metric_worker_package_cache_put_deduplicated;
+      ++metric_worker_package_cache_put_succeeded;
+      return S_OK;
+    }
+    CORE_LOG(LW, (_T("[failed to link stored contents][0x%08x][%s]"),
+                  hr, destination_file));
+  }
+
+  // The file may be a hard link to stored contents, which must not be
+  // overwritten.
+  hr = RemovePackageFile(key, destination_file);
+  if (FAILED(hr)) {
+    return hr;
+  }
 
   hr = internal::FileCopy(source_file, destination_file);
   if (FAILED(hr)) {
@@ -269,19 +565,145 @@ HRESULT PackageCache::Put(const Key& key,
     return hr;
   }
 
-  hr = VerifyHash(destination_file, hash);
+  hr = VerifyPackage(destination_file, &hash, verifier);
   if (FAILED(hr)) {
-    CORE_LOG(LE,
-        (_T("[failed to verify hash for file '%s'][expected hash %s]"),
-        destination_file, hash));
+    CORE_LOG(LE, (_T("[failed to verify package '%s'][expected hash %s]")
+                  _T("[0x%08x]"), destination_file, hash, hr));
     VERIFY1(::DeleteFile(destination_file));
     return hr;
   }
 
+  if (!digest.empty()) {
+    // The package stays cached as a copy if its contents cannot be stored.
+    hr = StoreContent(key, digest, destination_file);
+    if (FAILED(hr)) {
+      CORE_LOG(LW, (_T("[failed to store contents][0x%08x][%s]"),
+                    hr, destination_file));
+    }
+  }
+
+  UpdateCatalog(key, destination_file);
   ++metric_worker_package_cache_put_succeeded;
   return S_OK;
 }
 
+HRESULT PackageCache::PutFromPatch(const Key& key,
+                                   const CString& base_version,
+                                   File* patch_file,
+                                   const CString& hash,
+                                   const Verifier& verifier) {
+  ASSERT1(patch_file);
+
+  CORE_LOG(L3, (_T("[PackageCache::PutFromPatch][key '%s'][base %s][hash %s]"),
+                key.ToString(), base_version, hash));
+
+  __mutexScope(cache_lock_);
+  __mutexScope(shared_lock_);
+  ReloadCatalog();
+
+  if (key.app_id().IsEmpty() || key.version().IsEmpty() ||
+      key.package_name().IsEmpty() || base_version.IsEmpty() ||
+      base_version == key.version()) {
+    return E_INVALIDARG;
+  }
+
+  CString base_dir;
+  HRESULT hr = BuildCacheFileName(key.app_id(),
+                                  base_version,
+                                  CString(),
+                                  &base_dir);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  std::vector<internal::PackageInfo> base_packages;
+  hr = internal::FindVersionPackagesInfo(base_dir, &base_packages);
+  if (FAILED(hr)) {
+    CORE_LOG(LW, (_T("[no base packages][0x%08x][%s]"), hr, base_dir));
+    return GOOPDATEDOWNLOAD_E_PATCH_FAILED;
+  }
+
+  // The patch is most likely against the package with the same name.
+  std::vector<CString> base_files;
+  for (size_t i = 0; i != base_packages.size(); ++i) {
+    const CString& file_name(base_packages[i].file_name);
+    if (GetFileFromPath(file_name).CompareNoCase(key.package_name()) == 0) {
+      base_files.insert(base_files.begin(), file_name);
+    } else {
+      base_files.push_back(file_name);
+    }
+  }
+
+  CString destination_file;
+  hr = BuildCacheFileNameForKey(key, &destination_file);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  hr = CreateDir(GetDirectoryFromPath(destination_file), NULL);
+  if (FAILED(hr)) {
+    CORE_LOG(LE, (_T("[failed to create cache directory][0x%08x][%s]"),
+                  hr, destination_file));
+    return hr;
+  }
+
+  hr = RemovePackageFile(key, destination_file);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  for (size_t i = 0; i != base_files.size(); ++i) {
+    File base_file;
+    if (FAILED(base_file.Open(base_files[i], false, false))) {
+      continue;
+    }
+
+    // The patch is checked against the base file before anything is written.
+    const BinaryPatch::Result result =
+        internal::FilePatch(&base_file, patch_file, destination_file);
+    if (result == BinaryPatch::kBaseMismatch) {
+      ::DeleteFile(destination_file);
+      continue;
+    }
+
+    if (result != BinaryPatch::kSuccess) {
+      CORE_LOG(LE, (_T("[failed to apply patch][%S][%s]"),
+                    BinaryPatch::ResultToString(result), base_files[i]));
+      ::DeleteFile(destination_file);
+      return GOOPDATEDOWNLOAD_E_PATCH_FAILED;
+    }
+
+    hr = VerifyPackage(destination_file, &hash, verifier);
+    if (FAILED(hr)) {
+      CORE_LOG(LE, (_T("[failed to verify patched package '%s']")
+                    _T("[expected hash %s][0x%08x]"),
+                    destination_file, hash, hr));
+      VERIFY1(::DeleteFile(destination_file));
+      return hr;
+    }
+
+    CORE_LOG(L3, (_T("[patched '%s' into '%s']"),
+                  base_files[i], destination_file));
+
+    const std::string digest(content_addressed_ ?
+        PackageCacheIndex::NormalizeDigest(std::string(CT2A(hash))) :
+        std::string());
+    if (!digest.empty()) {
+      hr = StoreContent(key, digest, destination_file);
+      if (FAILED(hr)) {
+        CORE_LOG(LW, (_T("[failed to store contents][0x%08x][%s]"),
+                      hr, destination_file));
+      }
+    }
+
+    UpdateCatalog(key, destination_file);
+    return S_OK;
+  }
+
+  CORE_LOG(LW, (_T("[no base package matches the patch]")));
+  return GOOPDATEDOWNLOAD_E_PATCH_FAILED;
+}
+
 HRESULT PackageCache::Get(const Key& key,
                           const CString& destination_file,
                           const CString& hash) const {
@@ -289,6 +711,8 @@ HRESULT PackageCache::Get(const Key& key,
       key.ToString(), destination_file, hash));
 
   __mutexScope(cache_lock_);
+  __mutexScope(shared_lock_);
+  ReloadCatalog();
 
   if (key.app_id().IsEmpty() || key.version().IsEmpty() ||
       key.package_name().IsEmpty() ) {
@@ -313,13 +737,62 @@ HRESULT PackageCache::Get(const Key& key,
     return hr;
   }
 
-  return File::Copy(source_file, destination_file, true);
+  hr = internal::CloneFile(source_file, destination_file);
+  if (FAILED(hr)) {
+    CORE_LOG(L4, (_T("[CloneFile failed][0x%08x]"), hr));
+    hr = File::Copy(source_file, destination_file, true);
+    if (FAILED(hr)) {
+      return hr;
+    }
+  }
+
+  if (catalog_.get()) {
+    catalog_->Touch(
+        BuildIndexKey(key.app_id(), key.version(), key.package_name()),
+        GetCurrent100NSTime());
+  }
+  return S_OK;
+}
+
+HRESULT PackageCache::GetPackageNames(
+    const CString& app_id,
+    const CString& version,
+    std::vector<CString>* package_names) const {
+  ASSERT1(package_names);
+
+  __mutexScope(cache_lock_);
+
+  package_names->clear();
+
+  if (app_id.IsEmpty() || version.IsEmpty()) {
+    return E_INVALIDARG;
+  }
+
+  CString version_dir;
+  HRESULT hr = BuildCacheFileName(app_id, version, CString(), &version_dir);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  std::vector<internal::PackageInfo> packages_info;
+  hr = internal::FindVersionPackagesInfo(version_dir, &packages_info);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  for (size_t i = 0; i != packages_info.size(); ++i) {
+    package_names->push_back(GetFileFromPath(packages_info[i].file_name));
+  }
+
+  return S_OK;
 }
 
 HRESULT PackageCache::Purge(const Key& key) {
   CORE_LOG(L3, (_T("[PackageCache::Purge][key '%s']"), key.ToString()));
 
   __mutexScope(cache_lock_);
+  __mutexScope(shared_lock_);
+  ReloadCatalog();
 
   return Delete(key.app_id(), key.version(), key.package_name());
 }
@@ -330,6 +803,8 @@ HRESULT PackageCache::PurgeVersion(const CString& app_id,
                 app_id, version));
 
   __mutexScope(cache_lock_);
+  __mutexScope(shared_lock_);
+  ReloadCatalog();
 
   return Delete(app_id, version, _T(""));
 }
@@ -338,6 +813,8 @@ HRESULT PackageCache::PurgeApp(const CString& app_id) {
   CORE_LOG(L3, (_T("[PackageCache::PurgeApp][app_id '%s']"), app_id));
 
   __mutexScope(cache_lock_);
+  __mutexScope(shared_lock_);
+  ReloadCatalog();
 
   return Delete(app_id, _T(""), _T(""));
 }
@@ -348,6 +825,8 @@ HRESULT PackageCache::PurgeAppLowerVersions(const CString& app_id,
                 app_id, version));
 
   __mutexScope(cache_lock_);
+  __mutexScope(shared_lock_);
+  ReloadCatalog();
 
   ULONGLONG my_version = VersionFromString(version);
   if (!my_version) {
@@ -384,8 +863,16 @@ HRESULT PackageCache::PurgeAppLowerVersions(const CString& app_id,
     CString version_dir = ConcatenatePath(app_id_path, find_data.cFileName);
     hr = DeleteBeforeOrAfterReboot(version_dir);
     CORE_LOG(L3, (_T("[Purge version][%s][0x%x]"), version_dir, hr));
+
+    const std::string index_key(
+        BuildIndexKey(app_id, find_data.cFileName, CString()));
+    content_index_.RemovePrefix(index_key, NULL);
+    if (catalog_.get()) {
+      catalog_->RemovePrefix(index_key);
+    }
   } while (::FindNextFile(get(hfind), &find_data));
 
+  DeleteUnreferencedContent();
   return S_OK;
 }
 
@@ -393,6 +880,8 @@ HRESULT PackageCache::PurgeAll() {
   CORE_LOG(L3, (_T("[PackageCache::PurgeAll]")));
 
   __mutexScope(cache_lock_);
+  __mutexScope(shared_lock_);
+  ReloadCatalog();
 
   // Deletes the cache root including all the cache entries.
   HRESULT hr = Delete(_T(""), _T(""), _T(""));
@@ -407,6 +896,10 @@ HRESULT PackageCache::PurgeAll() {
     return hr;
   }
 
+  if (catalog_.get()) {
+    catalog_->Reset(std::vector<PackageCacheCatalog::Entry>());
+  }
+
   return hr;
 }
 
@@ -427,36 +920,51 @@ FILETIME PackageCache::GetCacheExpirationTime() const {
   return expiration_time;
 }
 
-HRESULT PackageCache::PurgeOldPackagesIfNecessary() const {
+HRESULT PackageCache::SetPinned(const Key& key, bool pinned) {
+  CORE_LOG(L3, (_T("[PackageCache::SetPinned][key '%s'][%d]"),
+                key.ToString(), pinned));
+
   __mutexScope(cache_lock_);
+  __mutexScope(shared_lock_);
+  ReloadCatalog();
 
-  std::vector<internal::PackageInfo> packages_info;
-  HRESULT hr = internal::FindAllPackagesInfo(cache_root_, &packages_info);
+  if (!catalog_.get()) {
+    return E_UNEXPECTED;
+  }
 
-  if (FAILED(hr)) {
-    CORE_LOG(LE, (_T("[internal::FindAllPackagesInfo failed][0x%x]"), hr));
-    return hr;
+  const std::string index_key(
+      BuildIndexKey(key.app_id(), key.version(), key.package_name()));
+  if (!catalog_->Find(index_key)) {
+    return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
   }
-  internal::SortPackageInfoByTime(&packages_info);
+  return catalog_->SetPinned(index_key, pinned) ? S_OK : E_FAIL;
+}
 
-  FILETIME expiration_time = GetCacheExpirationTime();
+HRESULT PackageCache::PurgeOldPackagesIfNecessary() {
+  __mutexScope(cache_lock_);
+  __mutexScope(shared_lock_);
+  ReloadCatalog();
 
-  // Delete cached package based on the package info.
-  std::vector<internal::PackageInfo>::const_iterator it;
-  uint64 total_cache_size = 0;
-  for (it = packages_info.begin(); it != packages_info.end(); ++it) {
-    total_cache_size += it->file_size.QuadPart;
-    if (total_cache_size > cache_size_limit_bytes_) {
-      break;  // Remaining packages should be deleted as size limit is reached.
-    }
-    if (::CompareFileTime(&it->file_time, &expiration_time) < 0) {
-      break;  // Remaining packages should be deleted as they are expired.
-    }
+  if (!catalog_.get()) {
+    return E_UNEXPECTED;
+  }
+
+  const std::vector<std::string> evicted_keys(catalog_->SelectEvictions(
+      cache_size_limit_bytes_,
+      FileTimeToTime64(GetCacheExpirationTime())));
+  if (evicted_keys.empty()) {
+    return S_OK;
   }
 
-  for (; it != packages_info.end(); ++it) {
-    hr = DeleteBeforeOrAfterReboot(it->file_name);
+  HRESULT hr = S_OK;
+  for (size_t i = 0; i != evicted_keys.size(); ++i) {
+    const CString filename(BuildFileNameFromIndexKey(evicted_keys[i]));
+    hr = DeleteBeforeOrAfterReboot(filename);
+    CORE_LOG(L3, (_T("[Purge package][%s][0x%x]"), filename, hr));
+    content_index_.Remove(evicted_keys[i], NULL);
   }
+  DeleteUnreferencedContent();
+  catalog_->Remove(evicted_keys);
 
   return hr;
 }
@@ -471,7 +979,32 @@ HRESULT PackageCache::Delete(const CString& app_id,
     return hr;
   }
 
-  return DeleteBeforeOrAfterReboot(filename);
+  hr = DeleteBeforeOrAfterReboot(filename);
+
+  // Deleting the cache root deletes the stored contents and the catalog as
+  // well. PurgeAll writes the catalog again.
+  if (app_id.IsEmpty()) {
+    content_index_.Clear();
+    return hr;
+  }
+
+  const std::string index_key(BuildIndexKey(app_id, version, package_name));
+  if (package_name.IsEmpty()) {
+    content_index_.RemovePrefix(index_key, NULL);
+  } else {
+    content_index_.Remove(index_key, NULL);
+  }
+  DeleteUnreferencedContent();
+
+  if (catalog_.get()) {
+    if (package_name.IsEmpty()) {
+      catalog_->RemovePrefix(index_key);
+    } else {
+      catalog_->Remove(std::vector<std::string>(1, index_key));
+    }
+  }
+
+  return hr;
 }
 
 CString PackageCache::cache_root() const {
@@ -483,9 +1016,16 @@ CString PackageCache::cache_root() const {
   return cache_root_;
 }
 
+bool PackageCache::is_content_addressed() const {
+  __mutexScope(cache_lock_);
+  return content_addressed_;
+}
+
 uint64 PackageCache::Size() const {
-  uint64 result(0);
-  return SUCCEEDED(GetDirectorySize(cache_root_, &result)) ? result : 0;
+  __mutexScope(cache_lock_);
+  __mutexScope(shared_lock_);
+  ReloadCatalog();
+  return catalog_.get() ? catalog_->total_bytes() : 0;
 }
 
 HRESULT PackageCache::BuildCacheFileNameForKey(const Key& key,
@@ -519,6 +1059,314 @@ HRESULT PackageCache::BuildCacheFileName(const CString& app_id,
   return S_OK;
 }
 
+CString PackageCache::BuildContentFileName(const std::string& digest) const {
+  ASSERT1(!digest.empty());
+
+  return ConcatenatePath(GetContentDir(cache_root_), CString(digest.c_str()));
+}
+
+CString PackageCache::GetContentDir(const CString& cache_root) {
+  return ConcatenatePath(cache_root, kContentDirName);
+}
+
+std::string PackageCache::BuildIndexKey(const CString& app_id,
+                                        const CString& version,
+                                        const CString& package_name) const {
+  CString key(app_id + _T("/"));
+  if (!version.IsEmpty()) {
+    key += version + _T("/");
+    key += package_name;
+  }
+
+  key.Replace(_T('\\'), _T('/'));
+  key.MakeLower();
+  return std::string(WideToUtf8(key));
+}
+
+std::string PackageCache::BuildIndexKeyFromFileName(
+    const CString& filename) const {
+  CString root(cache_root_);
+  if (!String_EndsWith(root, _T("\\"), false)) {
+    root += _T("\\");
+  }
+  if (filename.GetLength() <= root.GetLength() ||
+      String_StrNCmp(filename, root, root.GetLength(), true)) {
+    return std::string();
+  }
+
+  CString key(filename.Mid(root.GetLength()));
+  key.Replace(_T('\\'), _T('/'));
+  key.MakeLower();
+  return std::string(WideToUtf8(key));
+}
+
+CString PackageCache::BuildFileNameFromIndexKey(
+    const std::string& index_key) const {
+  CString relative_path(Utf8ToWideChar(index_key.c_str(),
+                                       static_cast<uint32>(index_key.size())));
+  relative_path.Replace(_T('/'), _T('\\'));
+  return ConcatenatePath(cache_root_, relative_path);
+}
+
+void PackageCache::LoadCatalog() {
+  const CString catalog_file(ConcatenatePath(cache_root_, kCatalogFileName));
+  catalog_.reset(new PackageCacheCatalog(
+      std::make_unique<PackageCacheCatalog::FileStorage>(
+          catalog_file.GetString())));
+  ReloadCatalog();
+}
+
+void PackageCache::ReloadCatalog() const {
+  if (!catalog_.get()) {
+    return;
+  }
+
+  if (catalog_->Load()) {
+    CORE_LOG(L4, (_T("[loaded catalog][%d packages][%I64u bytes]"),
+                  catalog_->entry_count(), catalog_->total_bytes()));
+    return;
+  }
+
+  const HRESULT hr = RebuildCatalog();
+  CORE_LOG(L3, (_T("[rebuilt catalog][0x%x][%d packages]"),
+                hr, catalog_->entry_count()));
+}
+
+HRESULT PackageCache::RebuildCatalog() const {
+  ASSERT1(catalog_.get());
+
+  std::vector<internal::PackageInfo> packages_info;
+  HRESULT hr = internal::FindAllPackagesInfo(cache_root_, &packages_info);
+  if (FAILED(hr) && hr != HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND)) {
+    return hr;
+  }
+
+  std::vector<PackageCacheCatalog::Entry> entries;
+  for (size_t i = 0; i != packages_info.size(); ++i) {
+    PackageCacheCatalog::Entry entry;
+    entry.key = BuildIndexKeyFromFileName(packages_info[i].file_name);
+    if (entry.key.empty()) {
+      continue;
+    }
+    content_index_.GetDigest(entry.key, &entry.digest);
+    entry.size = packages_info[i].file_size.QuadPart;
+    entry.last_access_100ns = FileTimeToTime64(packages_info[i].file_time);
+    entries.push_back(entry);
+  }
+
+  return catalog_->Reset(entries) ? S_OK : E_FAIL;
+}
+
+void PackageCache::UpdateCatalog(const Key& key, const CString& filename) {
+  if (!catalog_.get()) {
+    return;
+  }
+
+  PackageCacheCatalog::Entry entry;
+  entry.key = BuildIndexKey(key.app_id(), key.version(), key.package_name());
+  content_index_.GetDigest(entry.key, &entry.digest);
+
+  WIN32_FILE_ATTRIBUTE_DATA attributes = {0};
+  if (!::GetFileAttributesEx(filename, GetFileExInfoStandard, &attributes)) {
+    CORE_LOG(LW, (_T("[GetFileAttributesEx failed][0x%x][%s]"),
+                  HRESULTFromLastError(), filename));
+    return;
+  }
+  ULARGE_INTEGER file_size = {0};
+  file_size.LowPart = attributes.nFileSizeLow;
+  file_size.HighPart = attributes.nFileSizeHigh;
+  entry.size = file_size.QuadPart;
+  entry.last_access_100ns = GetCurrent100NSTime();
+
+  // A pinned package stays pinned when it is replaced.
+  const PackageCacheCatalog::Entry* previous_entry = catalog_->Find(entry.key);
+  entry.pinned = previous_entry && previous_entry->pinned;
+
+  if (!catalog_->Put(entry)) {
+    CORE_LOG(LW, (_T("[failed to write catalog][%s]"), filename));
+  }
+}
+
+HRESULT PackageCache::RemovePackageFile(const Key& key,
+                                        const CString& filename) {
+  if (File::Exists(filename) && !::DeleteFile(filename)) {
+    const HRESULT hr = HRESULTFromLastError();
+    CORE_LOG(LE, (_T("[failed to delete package file][0x%08x][%s]"),
+                  hr, filename));
+    return hr;
+  }
+
+  content_index_.Remove(
+      BuildIndexKey(key.app_id(), key.version(), key.package_name()), NULL);
+  DeleteUnreferencedContent();
+  return S_OK;
+}
+
+HRESULT PackageCache::LinkContent(const Key& key,
+                                  const std::string& digest,
+                                  const CString& filename) {
+  // The unreferenced contents are deleted only after the link is made, so
+  // that the contents are kept when the package file was their last link.
+  if (File::Exists(filename) && !::DeleteFile(filename)) {
+    return HRESULTFromLastError();
+  }
+
+  const CString content_file(BuildContentFileName(digest));
+  if (!::CreateHardLink(filename, content_file, NULL)) {
+    return HRESULTFromLastError();
+  }
+
+  // The links share the times of the contents. The contents count as added
+  // now, so that they expire after the most recent package.
+  FILETIME now = {0};
+  ::GetSystemTimeAsFileTime(&now);
+  VERIFY_SUCCEEDED(File::SetFileTime(content_file, &now, NULL, NULL));
+
+  content_index_.Add(
+      BuildIndexKey(key.app_id(), key.version(), key.package_name()),
+      digest,
+      NULL);
+  DeleteUnreferencedContent();
+
+  CORE_LOG(L3, (_T("[linked '%s' to stored contents][%d keys]"),
+                filename, GetContentRefCount(digest)));
+  return S_OK;
+}
+
+HRESULT PackageCache::StoreContent(const Key& key,
+                                   const std::string& digest,
+                                   const CString& filename) {
+  const CString content_file(BuildContentFileName(digest));
+  HRESULT hr = CreateDir(GetDirectoryFromPath(content_file), NULL);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  // The contents could not be linked before, so the package stays a copy.
+  if (File::Exists(content_file)) {
+    return S_FALSE;
+  }
+
+  if (!::CreateHardLink(content_file, filename, NULL)) {
+    return HRESULTFromLastError();
+  }
+
+  content_index_.Add(
+      BuildIndexKey(key.app_id(), key.version(), key.package_name()),
+      digest,
+      NULL);
+  DeleteUnreferencedContent();
+  return S_OK;
+}
+
+int PackageCache::GetContentRefCount(const std::string& digest) const {
+  uint32 link_count = 0;
+  if (FAILED(internal::GetFileLinkCount(BuildContentFileName(digest),
+                                        &link_count)) ||
+      !link_count) {
+    return 0;
+  }
+
+  // The stored contents are a link to themselves.
+  return static_cast<int>(link_count - 1);
+}
+
+void PackageCache::DeleteUnreferencedContent() {
+  if (!content_addressed_) {
+    return;
+  }
+
+  std::vector<internal::PackageInfo> contents_info;
+  if (FAILED(internal::FindVersionPackagesInfo(
+          GetContentDir(cache_root_), &contents_info))) {
+    return;
+  }
+
+  for (size_t i = 0; i != contents_info.size(); ++i) {
+    const CString& content_file(contents_info[i].file_name);
+    uint32 link_count = 0;
+    if (FAILED(internal::GetFileLinkCount(content_file, &link_count)) ||
+        link_count > 1) {
+      continue;
+    }
+
+    const HRESULT hr = DeleteBeforeOrAfterReboot(content_file);
+    CORE_LOG(L3, (_T("[deleted stored contents][%s][0x%x]"),
+                  content_file, hr));
+  }
+}
+
+HRESULT PackageCache::LoadContentIndex() {
+  content_index_.Clear();
+
+  std::vector<internal::PackageInfo> contents_info;
+  if (FAILED(internal::FindVersionPackagesInfo(
+          GetContentDir(cache_root_), &contents_info))) {
+    return S_OK;
+  }
+
+  std::map<uint64, std::string> digests;
+  for (size_t i = 0; i != contents_info.size(); ++i) {
+    const CString& content_file(contents_info[i].file_name);
+    const std::string digest(PackageCacheIndex::NormalizeDigest(
+        std::string(CT2A(GetFileFromPath(content_file)))));
+    uint64 file_id = 0;
+    if (digest.empty() || FAILED(internal::GetFileId(content_file, &file_id))) {
+      DeleteBeforeOrAfterReboot(content_file);
+      continue;
+    }
+    digests[file_id] = digest;
+  }
+
+  std::vector<internal::PackageInfo> packages_info;
+  HRESULT hr = internal::FindAllPackagesInfo(cache_root_, &packages_info);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  for (size_t i = 0; i != packages_info.size(); ++i) {
+    uint64 file_id = 0;
+    if (FAILED(internal::GetFileId(packages_info[i].file_name, &file_id))) {
+      continue;
+    }
+    std::map<uint64, std::string>::const_iterator it = digests.find(file_id);
+    if (it != digests.end()) {
+      content_index_.Add(BuildIndexKeyFromFileName(packages_info[i].file_name),
+                         it->second,
+                         NULL);
+    }
+  }
+
+  // Deletes the contents left behind when the cache was interrupted.
+  DeleteUnreferencedContent();
+
+  CORE_LOG(L3, (_T("[LoadContentIndex][%d keys][%d contents]"),
+                content_index_.key_count(), content_index_.digest_count()));
+  return S_OK;
+}
+
+HRESULT PackageCache::VerifyPackage(const CString& filename,
+                                    const CString* hash,
+                                    const Verifier& verifier) {
+  File package_file;
+  HRESULT hr = package_file.OpenShareMode(filename,
+                                          false,
+                                          false,
+                                          FILE_SHARE_READ);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  if (hash) {
+    hr = VerifyHash(filename, *hash);
+  }
+  if (SUCCEEDED(hr) && verifier) {
+    hr = verifier(&package_file, filename);
+  }
+  VERIFY_SUCCEEDED(package_file.Close());
+  return hr;
+}
+
 HRESULT PackageCache::VerifyHash(const CString& filename,
                                  const CString& expected_hash) {
   CORE_LOG(L3, (_T("[PackageCache::VerifyHash][%s][%s]"),
@@ -529,8 +1377,15 @@ HRESULT PackageCache::VerifyHash(const CString& filename,
   files.push_back(filename);
 
   HRESULT hr = VerifyFileHashSha256(files, expected_hash);
-  CORE_LOG(L3, (_T("[PackageCache::VerifyHash completed][0x%08x][%d ms]"),
-                hr, verification_timer.GetElapsedMs()));
+  const uint64 elapsed_ms = verification_timer.GetElapsedMs();
+
+  uint32 file_size = 0;
+  File::GetFileSizeUnopen(filename, &file_size);
+  const double mb_per_sec = elapsed_ms ?
+      file_size / (1024.0 * 1024.0) * 1000 / elapsed_ms : 0;
+  CORE_LOG(L3, (_T("[PackageCache::VerifyHash completed][0x%08x][%d ms]")
+                _T("[%.1f MB/s]"),
+                hr, static_cast<int>(elapsed_ms), mb_per_sec));
   return hr;
 }
 
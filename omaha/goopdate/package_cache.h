@@ -18,15 +18,37 @@
 
 #include <windows.h>
 #include <atlstr.h>
+#include <functional>
+#include <memory>
+#include <string>
 #include <vector>
 #include "base/basictypes.h"
 #include "base/synchronized.h"
 #include "omaha/base/safe_format.h"
+#include "omaha/goopdate/package_cache_catalog.h"
+#include "omaha/goopdate/package_cache_index.h"
 
 namespace omaha {
 
 class File;
 
+// The cache stores packages under "app_id\version\package_name". Unless it
+// is disabled in the registry, the cache is content-addressed: the contents
+// of each package are also stored once under the SHA-256 digest of the
+// package, and the key of the package is a hard link to the contents. A
+// package shipped by several apps, channels, or versions is then copied and
+// hashed once, and its contents are deleted only when its last key is purged.
+// Where hard links are not supported, the packages are copied as before.
+//
+// The size, the last access time, and the pin state of the packages are
+// recorded in a catalog under the cache root, so that the size of the cache
+// and the packages to evict are known without walking the cache. The catalog
+// is rebuilt from the cache directories when it is missing or damaged.
+//
+// Several processes share the machine cache, or the cache of a user. They
+// serialize their changes to the cache with a named lock, and reload the
+// catalog under the lock before they change or evict packages, so that they
+// do not act on a catalog which another process has changed since.
 class PackageCache {
  public:
   // Defines the key that uniquely identifies the packages in the cache.
@@ -63,18 +85,54 @@ class PackageCache {
   PackageCache();
   ~PackageCache();
 
-  HRESULT Initialize(const CString& cache_root);
+  HRESULT Initialize(bool is_machine, const CString& cache_root);
 
+  // Checks a package before it is committed to the cache, once the contents
+  // of the package are known to match the expected hash. The package is open
+  // without write sharing while the verifier runs.
+  typedef std::function<HRESULT(File* package_file,
+                                const CString& package_path)> Verifier;
+
+  // Copies |source_file| into the cache, then verifies the copy against
+  // |hash| and with |verifier|, unless it is empty. The copy is removed if
+  // either check fails, and the error of the verifier is returned. If the
+  // cache is content-addressed and already stores the contents of |hash|,
+  // links |key| to them instead, and only runs |verifier|.
+  HRESULT Put(const Key& key,
+              File* source_file,
+              const CString& hash,
+              const Verifier& verifier);
   HRESULT Put(const Key& key,
               File* source_file,
               const CString& hash);
 
+  // Creates the package for |key| by applying |patch_file| to the cached
+  // package of |base_version| of the same app which the patch was built
+  // against, then verifies the package against |hash| and with |verifier|,
+  // unless it is empty. The package is removed if either check fails, and
+  // the error of the verifier is returned. Returns
+  // GOOPDATEDOWNLOAD_E_PATCH_FAILED if no cached package matches the patch or
+  // the patch is corrupt.
+  HRESULT PutFromPatch(const Key& key,
+                       const CString& base_version,
+                       File* patch_file,
+                       const CString& hash,
+                       const Verifier& verifier);
+
+  // Verifies the cached package against |hash| and clones it into
+  // |destination_file|, or copies it where the file system cannot clone
+  // files.
   HRESULT Get(const Key& key,
               const CString& destination_file,
               const CString& hash) const;
 
   bool IsCached(const Key& key, const CString& hash) const;
 
+  // Returns the names of the cached packages of a version of an app.
+  HRESULT GetPackageNames(const CString& app_id,
+                          const CString& version,
+                          std::vector<CString>* package_names) const;
+
   HRESULT Purge(const Key& key);
 
   HRESULT PurgeVersion(const CString& app_id, const CString& version);
@@ -87,16 +145,28 @@ class PackageCache {
 
   HRESULT PurgeAll();
 
+  // Pins or unpins a cached package. Pinned packages are not purged by
+  // PurgeOldPackagesIfNecessary.
+  HRESULT SetPinned(const Key& key, bool pinned);
+
   // Purges expired packages and keeps total cache size below the limit by
-  // purging oldest ones.
-  HRESULT PurgeOldPackagesIfNecessary() const;
+  // purging the least recently used ones. Stored contents are deleted when no
+  // key refers to them any more.
+  HRESULT PurgeOldPackagesIfNecessary();
 
-  // Returns the total size of all files in the cache. Returns 0 if the size
-  // cannot be determined or the cache is empty.
+  // Returns the total size of all files in the cache, counting contents
+  // shared by several keys once. Returns 0 if the size cannot be determined
+  // or the cache is empty.
   uint64 Size() const;
 
   CString cache_root() const;
 
+  bool is_content_addressed() const;
+
+  // Returns the directory which stores the contents of the packages by
+  // digest, when the cache under |cache_root| is content-addressed.
+  static CString GetContentDir(const CString& cache_root);
+
   static HRESULT VerifyHash(const CString& filename,
                             const CString& expected_hash);
 
@@ -120,6 +190,74 @@ class PackageCache {
   // are considered as expired and should be purged.
   FILETIME GetCacheExpirationTime() const;
 
+  // Returns the file which stores the contents of |digest|.
+  CString BuildContentFileName(const std::string& digest) const;
+
+  // Returns the key of a package in |content_index_|, or the prefix of the
+  // keys of a version or of an app if |package_name| or |version| are empty.
+  std::string BuildIndexKey(const CString& app_id,
+                            const CString& version,
+                            const CString& package_name) const;
+
+  // Returns the key in |content_index_| of a file under the cache root.
+  std::string BuildIndexKeyFromFileName(const CString& filename) const;
+
+  // Verifies the package file |filename| against |hash|, unless |hash| is
+  // NULL, then runs |verifier| on it, unless it is empty. The file is open
+  // without write sharing during both checks, so that the verifier checks
+  // the contents which match the hash.
+  static HRESULT VerifyPackage(const CString& filename,
+                               const CString* hash,
+                               const Verifier& verifier);
+
+  // Deletes the package file of |key| before it is written, so that stored
+  // contents linked to it are not overwritten.
+  HRESULT RemovePackageFile(const Key& key, const CString& filename);
+
+  // Replaces the package file of |key| with a hard link to the stored
+  // contents of |digest|.
+  HRESULT LinkContent(const Key& key,
+                      const std::string& digest,
+                      const CString& filename);
+
+  // Stores the verified package file of |key| as the contents of |digest|.
+  HRESULT StoreContent(const Key& key,
+                       const std::string& digest,
+                       const CString& filename);
+
+  // Returns the number of package files linked to the stored contents of
+  // |digest|. The links are counted on disk, so that the packages other
+  // processes linked are counted as well.
+  int GetContentRefCount(const std::string& digest) const;
+
+  // Deletes the stored contents which no package file is linked to. Must be
+  // called with |shared_lock_| held.
+  void DeleteUnreferencedContent();
+
+  // Returns the file of a key of |content_index_| or |catalog_|.
+  CString BuildFileNameFromIndexKey(const std::string& index_key) const;
+
+  // Creates |catalog_| and loads it.
+  void LoadCatalog();
+
+  // Reads |catalog_| again, since another process may have changed it, or
+  // rebuilds it if it is missing or damaged. Must be called with
+  // |shared_lock_| held.
+  void ReloadCatalog() const;
+
+  // Rebuilds |catalog_| from the package files, which are considered last
+  // accessed when they were created.
+  HRESULT RebuildCatalog() const;
+
+  // Records the size and the contents of the package file of |key| in
+  // |catalog_|, as accessed now.
+  void UpdateCatalog(const Key& key, const CString& filename);
+
+  // Rebuilds |content_index_| by matching the package files with the stored
+  // contents they are linked to, and deletes the contents no package file is
+  // linked to.
+  HRESULT LoadContentIndex();
+
   // The cache duration, specified as a count of days.  (This is converted to
   // an absolute time by GetCacheExpirationTime().)
   int cache_time_limit_days_;
@@ -130,8 +268,24 @@ class PackageCache {
 
   CString cache_root_;
 
+  // True if the packages are stored by the digest of their contents.
+  bool content_addressed_;
+
+  // Maps the keys of the packages linked to stored contents to the digests
+  // of the contents, which the catalog records. The index only knows the
+  // links this instance made, so the stored contents are deleted by their
+  // link counts on disk instead of by its reference counts.
+  PackageCacheIndex content_index_;
+
+  // Created by Initialize. Get() updates the last access times.
+  std::unique_ptr<PackageCacheCatalog> catalog_;
+
   LLock cache_lock_;
 
+  // Serializes the changes to the files under the cache root with the other
+  // processes which share the cache. Taken after |cache_lock_|.
+  GLock shared_lock_;
+
   DISALLOW_COPY_AND_ASSIGN(PackageCache);
 };
 
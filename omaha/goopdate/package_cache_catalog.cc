@@ -0,0 +1,417 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/package_cache_catalog.h"
+
+#include <string.h>
+
+#include <fstream>
+#include <iterator>
+#include <system_error>
+
+#include "omaha/base/record_io.h"
+
+namespace omaha {
+
+namespace {
+
+std::string MakePutRecord(const PackageCacheCatalog::Entry& entry) {
+  std::string payload;
+  AppendUint(entry.size, 8, &payload);
+  AppendUint(entry.last_access_100ns, 8, &payload);
+  payload.push_back(entry.pinned ? 1 : 0);
+  AppendString(entry.key, &payload);
+  AppendString(entry.digest, &payload);
+  return MakeRecord(PackageCacheCatalog::kRecordPut, payload);
+}
+
+size_t PutRecordSize(const PackageCacheCatalog::Entry& entry) {
+  return RecordSize(8 + 8 + 1 + 2 + entry.key.size() + 2 +
+                    entry.digest.size());
+}
+
+std::string MakeRemoveRecord(const std::vector<std::string>& keys) {
+  std::string payload;
+  AppendUint(keys.size(), 4, &payload);
+  for (const auto& key : keys) {
+    AppendString(key, &payload);
+  }
+  return MakeRecord(PackageCacheCatalog::kRecordRemove, payload);
+}
+
+bool IsValidEntry(const PackageCacheCatalog::Entry& entry) {
+  return !entry.key.empty() &&
+         entry.key.size() <= PackageCacheCatalog::kMaxKeyLength &&
+         entry.digest.size() <= PackageCacheCatalog::kMaxKeyLength;
+}
+
+}  // namespace
+
+const char PackageCacheCatalog::kMagic[4] = {'O', 'P', 'C', '1'};
+
+PackageCacheCatalog::FileStorage::FileStorage(
+    const std::filesystem::path& path)
+    : path_(path) {
+}
+
+PackageCacheCatalog::FileStorage::~FileStorage() {
+}
+
+bool PackageCacheCatalog::FileStorage::Read(std::string* contents) {
+  contents->clear();
+
+  std::error_code error;
+  if (!std::filesystem::exists(path_, error)) {
+    return !error;
+  }
+
+  std::ifstream file(path_, std::ios::in | std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  contents->assign(std::istreambuf_iterator<char>(file),
+                   std::istreambuf_iterator<char>());
+  return !file.bad();
+}
+
+bool PackageCacheCatalog::FileStorage::Append(const std::string& data) {
+  std::ofstream file(path_,
+                     std::ios::out | std::ios::binary | std::ios::app);
+  if (!file) {
+    return false;
+  }
+  file.write(data.data(), data.size());
+  file.flush();
+  return file.good();
+}
+
+bool PackageCacheCatalog::FileStorage::Replace(const std::string& contents) {
+  std::error_code error;
+  if (contents.empty()) {
+    std::filesystem::remove(path_, error);
+    return !error;
+  }
+
+  std::filesystem::path temp_path(path_);
+  temp_path += ".tmp";
+  {
+    std::ofstream file(temp_path,
+                       std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file) {
+      return false;
+    }
+    file.write(contents.data(), contents.size());
+    file.flush();
+    if (!file.good()) {
+      file.close();
+      std::filesystem::remove(temp_path, error);
+      return false;
+    }
+  }
+
+  std::filesystem::rename(temp_path, path_, error);
+  if (error) {
+    std::filesystem::remove(temp_path, error);
+    return false;
+  }
+  return true;
+}
+
+PackageCacheCatalog::PackageCacheCatalog(std::unique_ptr<Storage> storage)
+    : storage_(std::move(storage)),
+      total_bytes_(0),
+      size_bytes_(0),
+      needs_rewrite_(false) {
+}
+
+PackageCacheCatalog::~PackageCacheCatalog() {
+}
+
+bool PackageCacheCatalog::Load() {
+  entries_.clear();
+  lru_.clear();
+  digests_.clear();
+  total_bytes_ = 0;
+  size_bytes_ = 0;
+  needs_rewrite_ = true;
+
+  std::string contents;
+  if (!storage_->Read(&contents) || contents.empty()) {
+    return false;
+  }
+
+  size_bytes_ = contents.size();
+  needs_rewrite_ = !Replay(contents);
+  return !needs_rewrite_;
+}
+
+bool PackageCacheCatalog::Replay(const std::string& contents) {
+  if (contents.size() < sizeof(kMagic) ||
+      memcmp(contents.data(), kMagic, sizeof(kMagic)) != 0) {
+    return false;
+  }
+
+  size_t pos = sizeof(kMagic);
+  while (pos != contents.size()) {
+    uint8_t type = 0;
+    const char* payload_data = NULL;
+    size_t payload_size = 0;
+    if (!ReadRecord(contents.data() + pos, contents.size() - pos,
+                    &type, &payload_data, &payload_size)) {
+      return false;
+    }
+
+    RecordReader payload(payload_data, payload_size);
+    if (type == kRecordPut) {
+      Entry entry;
+      uint64_t pinned = 0;
+      if (!payload.ReadUint(8, &entry.size) ||
+          !payload.ReadUint(8, &entry.last_access_100ns) ||
+          !payload.ReadUint(1, &pinned) ||
+          !payload.ReadString(&entry.key) ||
+          !payload.ReadString(&entry.digest) ||
+          entry.key.empty()) {
+        return false;
+      }
+      entry.pinned = pinned != 0;
+      Insert(entry);
+    } else if (type == kRecordRemove) {
+      uint64_t count = 0;
+      if (!payload.ReadUint(4, &count)) {
+        return false;
+      }
+      for (uint64_t i = 0; i != count; ++i) {
+        std::string key;
+        if (!payload.ReadString(&key)) {
+          return false;
+        }
+        Erase(key);
+      }
+    } else {
+      return false;
+    }
+
+    pos += RecordSize(payload_size);
+  }
+
+  return true;
+}
+
+bool PackageCacheCatalog::Reset(const std::vector<Entry>& entries) {
+  entries_.clear();
+  lru_.clear();
+  digests_.clear();
+  total_bytes_ = 0;
+  for (const auto& entry : entries) {
+    if (IsValidEntry(entry)) {
+      Insert(entry);
+    }
+  }
+  return Compact();
+}
+
+bool PackageCacheCatalog::Put(const Entry& entry) {
+  if (!IsValidEntry(entry)) {
+    return false;
+  }
+
+  Insert(entry);
+  return AppendRecord(MakePutRecord(entry));
+}
+
+bool PackageCacheCatalog::Touch(const std::string& key, uint64_t time_100ns) {
+  std::map<std::string, Entry>::const_iterator it = entries_.find(key);
+  if (it == entries_.end()) {
+    return false;
+  }
+
+  Entry entry(it->second);
+  entry.last_access_100ns = time_100ns;
+  return Put(entry);
+}
+
+bool PackageCacheCatalog::SetPinned(const std::string& key, bool pinned) {
+  std::map<std::string, Entry>::const_iterator it = entries_.find(key);
+  if (it == entries_.end()) {
+    return false;
+  }
+  if (it->second.pinned == pinned) {
+    return true;
+  }
+
+  Entry entry(it->second);
+  entry.pinned = pinned;
+  return Put(entry);
+}
+
+bool PackageCacheCatalog::Remove(const std::vector<std::string>& keys) {
+  std::vector<std::string> removed_keys;
+  for (const auto& key : keys) {
+    if (entries_.count(key)) {
+      Erase(key);
+      removed_keys.push_back(key);
+    }
+  }
+  if (removed_keys.empty()) {
+    return true;
+  }
+
+  return AppendRecord(MakeRemoveRecord(removed_keys));
+}
+
+bool PackageCacheCatalog::RemovePrefix(const std::string& prefix) {
+  std::vector<std::string> keys;
+  for (std::map<std::string, Entry>::const_iterator it =
+           entries_.lower_bound(prefix);
+       it != entries_.end() && it->first.compare(0, prefix.size(), prefix) == 0;
+       ++it) {
+    keys.push_back(it->first);
+  }
+  return Remove(keys);
+}
+
+bool PackageCacheCatalog::Compact() {
+  std::string contents(kMagic, sizeof(kMagic));
+  for (const auto& key_and_entry : entries_) {
+    contents.append(MakePutRecord(key_and_entry.second));
+  }
+
+  if (!storage_->Replace(contents)) {
+    OnWriteFailed();
+    return false;
+  }
+  size_bytes_ = contents.size();
+  needs_rewrite_ = false;
+  return true;
+}
+
+const PackageCacheCatalog::Entry* PackageCacheCatalog::Find(
+    const std::string& key) const {
+  std::map<std::string, Entry>::const_iterator it = entries_.find(key);
+  return it == entries_.end() ? NULL : &it->second;
+}
+
+std::vector<std::string> PackageCacheCatalog::SelectEvictions(
+    uint64_t max_bytes,
+    uint64_t expiration_100ns) const {
+  std::vector<std::string> keys;
+  uint64_t remaining_bytes = total_bytes_;
+
+  // The shared contents are freed when their last key is evicted.
+  std::map<std::string, int> remaining_refs;
+
+  for (const auto& time_and_key : lru_) {
+    if (remaining_bytes <= max_bytes &&
+        time_and_key.first >= expiration_100ns) {
+      break;
+    }
+
+    const Entry& entry = entries_.find(time_and_key.second)->second;
+    if (entry.pinned) {
+      continue;
+    }
+
+    keys.push_back(entry.key);
+    if (entry.digest.empty()) {
+      remaining_bytes -= entry.size;
+      continue;
+    }
+
+    const std::pair<int, uint64_t>& shared =
+        digests_.find(entry.digest)->second;
+    std::map<std::string, int>::iterator refs =
+        remaining_refs.insert(std::make_pair(entry.digest, shared.first)).first;
+    if (!--refs->second) {
+      remaining_bytes -= shared.second;
+    }
+  }
+
+  return keys;
+}
+
+size_t PackageCacheCatalog::dead_bytes() const {
+  size_t live_bytes = sizeof(kMagic);
+  for (const auto& key_and_entry : entries_) {
+    live_bytes += PutRecordSize(key_and_entry.second);
+  }
+  return size_bytes_ > live_bytes ? size_bytes_ - live_bytes : 0;
+}
+
+bool PackageCacheCatalog::AppendRecord(const std::string& record) {
+  if (needs_rewrite_) {
+    return Compact();
+  }
+
+  if (!storage_->Append(record)) {
+    OnWriteFailed();
+    return false;
+  }
+  size_bytes_ += record.size();
+  return MaybeCompact();
+}
+
+void PackageCacheCatalog::OnWriteFailed() {
+  storage_->Replace(std::string());
+  size_bytes_ = 0;
+  needs_rewrite_ = true;
+}
+
+bool PackageCacheCatalog::MaybeCompact() {
+  const size_t dead = dead_bytes();
+  if (dead < kMinCompactionBytes || dead <= size_bytes_ - dead) {
+    return true;
+  }
+  return Compact();
+}
+
+void PackageCacheCatalog::Insert(const Entry& entry) {
+  Erase(entry.key);
+
+  entries_[entry.key] = entry;
+  lru_.insert(std::make_pair(entry.last_access_100ns, entry.key));
+
+  if (entry.digest.empty()) {
+    total_bytes_ += entry.size;
+    return;
+  }
+  std::pair<int, uint64_t>& shared = digests_[entry.digest];
+  if (!shared.first++) {
+    shared.second = entry.size;
+    total_bytes_ += entry.size;
+  }
+}
+
+void PackageCacheCatalog::Erase(const std::string& key) {
+  std::map<std::string, Entry>::iterator it = entries_.find(key);
+  if (it == entries_.end()) {
+    return;
+  }
+
+  const Entry& entry = it->second;
+  lru_.erase(std::make_pair(entry.last_access_100ns, entry.key));
+  if (entry.digest.empty()) {
+    total_bytes_ -= entry.size;
+  } else {
+    std::map<std::string, std::pair<int, uint64_t>>::iterator shared =
+        digests_.find(entry.digest);
+    if (!--shared->second.first) {
+      total_bytes_ -= shared->second.second;
+      digests_.erase(shared);
+    }
+  }
+  entries_.erase(it);
+}
+
+}  // namespace omaha
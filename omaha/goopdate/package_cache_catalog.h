@@ -0,0 +1,214 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// PackageCacheCatalog records the size, the last access time, and the pin
+// state of each package in the PackageCache, so that the cache knows its size
+// and which packages to evict without walking its directories.
+//
+// The catalog is persisted in a single append-only file, which starts with a
+// magic number followed by a sequence of records:
+//   type     1 byte      kRecordPut or kRecordRemove.
+//   length   4 bytes     Little-endian size of the payload.
+//   payload  |length|    See below.
+//   checksum 4 bytes     The first bytes of the SHA-256 of the fields above.
+// A put record contains the size and the last access time of the package in
+// 100ns units as 8 bytes each, the pin state as 1 byte, then the key and the
+// digest, each of them prefixed by its 2-byte length. A remove record contains
+// a 4-byte count followed by the removed keys, each of them prefixed by its
+// 2-byte length.
+//
+// Load() fails if the catalog is missing or if a record is truncated or fails
+// its checksum, in which case the cache rebuilds the catalog from its
+// directories with Reset(). A write which fails deletes the catalog, so that
+// the catalog is rebuilt if the process exits before the next write, which
+// rewrites the whole catalog. The catalog is also rewritten when the removed
+// and replaced records take more space than the live ones.
+//
+// The catalog does not lock the file. PackageCache serializes the access with
+// its named lock and reloads the catalog before each change.
+//
+// This file has no platform dependencies.
+
+#ifndef OMAHA_GOOPDATE_PACKAGE_CACHE_CATALOG_H_
+#define OMAHA_GOOPDATE_PACKAGE_CACHE_CATALOG_H_
+
+#include <stdint.h>
+
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/basictypes.h"
+
+namespace omaha {
+
+class PackageCacheCatalog {
+ public:
+  struct Entry {
+    // The path of the package relative to the cache root, as in
+    // "app_id/version/package_name".
+    std::string key;
+
+    // The digest of the contents the package shares with other packages, or
+    // an empty string if the package does not share its contents. Shared
+    // contents are counted once in the size of the cache.
+    std::string digest;
+
+    uint64_t size = 0;
+    uint64_t last_access_100ns = 0;
+
+    // Pinned packages are never evicted.
+    bool pinned = false;
+  };
+
+  // The backing store of the catalog.
+  class Storage {
+   public:
+    virtual ~Storage() {}
+
+    // Reads the whole catalog. A catalog which does not exist is empty.
+    virtual bool Read(std::string* contents) = 0;
+
+    // Appends |data| to the catalog.
+    virtual bool Append(const std::string& data) = 0;
+
+    // Replaces the contents of the catalog with |contents|, or deletes the
+    // catalog if |contents| is empty. The replacement is atomic if the
+    // underlying storage supports it.
+    virtual bool Replace(const std::string& contents) = 0;
+  };
+
+  // Stores the catalog in a file. Replace() writes a temporary file next to
+  // the catalog, then renames it over the catalog.
+  class FileStorage : public Storage {
+   public:
+    explicit FileStorage(const std::filesystem::path& path);
+    ~FileStorage() override;
+
+    bool Read(std::string* contents) override;
+    bool Append(const std::string& data) override;
+    bool Replace(const std::string& contents) override;
+
+   private:
+    const std::filesystem::path path_;
+
+    DISALLOW_COPY_AND_ASSIGN(FileStorage);
+  };
+
+  static const char kMagic[4];
+  static const uint8_t kRecordPut = 1;
+  static const uint8_t kRecordRemove = 2;
+
+  // The maximum length of a key or of a digest. Longer ones are rejected.
+  static const size_t kMaxKeyLength = 0xFFFF;
+
+  // The catalog is not compacted until it holds at least this many bytes of
+  // removed or replaced records.
+  static const size_t kMinCompactionBytes = 16 * 1024;
+
+  explicit PackageCacheCatalog(std::unique_ptr<Storage> storage);
+  ~PackageCacheCatalog();
+
+  // Reads the catalog. Returns false if the catalog is missing, cannot be
+  // read, or is damaged. The entries before a damaged record are loaded.
+  bool Load();
+
+  // Replaces all the entries with |entries| and rewrites the catalog.
+  bool Reset(const std::vector<Entry>& entries);
+
+  // Adds an entry, or replaces the entry with the same key.
+  bool Put(const Entry& entry);
+
+  // Sets the last access time of |key|. Returns false if |key| is not in the
+  // catalog or the catalog cannot be written.
+  bool Touch(const std::string& key, uint64_t time_100ns);
+
+  // Pins or unpins |key|. Returns false if |key| is not in the catalog or the
+  // catalog cannot be written.
+  bool SetPinned(const std::string& key, bool pinned);
+
+  // Removes |keys| with a single write. Unknown keys are ignored.
+  bool Remove(const std::vector<std::string>& keys);
+
+  // Removes the keys which start with |prefix|, such as all the keys of an
+  // app or of a version of an app.
+  bool RemovePrefix(const std::string& prefix);
+
+  // Rewrites the catalog with the live entries only.
+  bool Compact();
+
+  // Returns the entry of |key|, or NULL if |key| is not in the catalog.
+  const Entry* Find(const std::string& key) const;
+
+  // Returns the unpinned keys to evict, least recently used first: the keys
+  // last accessed before |expiration_100ns|, then as many keys as needed to
+  // bring the size of the cache to |max_bytes| or less.
+  std::vector<std::string> SelectEvictions(uint64_t max_bytes,
+                                           uint64_t expiration_100ns) const;
+
+  // Returns the size of the packages in the catalog, counting the contents
+  // shared by several packages once.
+  uint64_t total_bytes() const { return total_bytes_; }
+
+  size_t entry_count() const { return entries_.size(); }
+
+  // Returns the number of bytes of the catalog taken by removed or replaced
+  // records, and by a damaged tail, if any.
+  size_t dead_bytes() const;
+
+  size_t size_bytes() const { return size_bytes_; }
+
+ private:
+  // Appends |record|, or rewrites the catalog if it needs to be rewritten.
+  bool AppendRecord(const std::string& record);
+
+  // Deletes the catalog after a failed write.
+  void OnWriteFailed();
+
+  // Replays the records of |contents|. Returns false at the first damaged
+  // record.
+  bool Replay(const std::string& contents);
+
+  // Compacts the catalog if the dead records take too much space.
+  bool MaybeCompact();
+
+  void Insert(const Entry& entry);
+  void Erase(const std::string& key);
+
+  std::unique_ptr<Storage> storage_;
+
+  std::map<std::string, Entry> entries_;
+
+  // The keys ordered by last access time, least recently used first.
+  std::set<std::pair<uint64_t, std::string>> lru_;
+
+  // The number of keys which share each digest, and the size of the
+  // contents of the digest.
+  std::map<std::string, std::pair<int, uint64_t>> digests_;
+
+  uint64_t total_bytes_;
+  size_t size_bytes_;
+  bool needs_rewrite_;
+
+  DISALLOW_COPY_AND_ASSIGN(PackageCacheCatalog);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_GOOPDATE_PACKAGE_CACHE_CATALOG_H_
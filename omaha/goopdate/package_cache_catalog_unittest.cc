@@ -0,0 +1,317 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/package_cache_catalog.h"
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace omaha {
+
+namespace {
+
+// Keeps the catalog in memory, counts the writes, and fails them on demand.
+class MemoryStorage : public PackageCacheCatalog::Storage {
+ public:
+  explicit MemoryStorage(std::string* contents)
+      : contents_(contents),
+        num_appends_(0),
+        num_replaces_(0),
+        fail_appends_(false) {}
+
+  bool Read(std::string* contents) override {
+    *contents = *contents_;
+    return true;
+  }
+
+  bool Append(const std::string& data) override {
+    ++num_appends_;
+    if (fail_appends_) {
+      return false;
+    }
+    contents_->append(data);
+    return true;
+  }
+
+  bool Replace(const std::string& contents) override {
+    ++num_replaces_;
+    *contents_ = contents;
+    return true;
+  }
+
+  int num_appends() const { return num_appends_; }
+  int num_replaces() const { return num_replaces_; }
+  void set_fail_appends(bool fail_appends) { fail_appends_ = fail_appends; }
+
+ private:
+  std::string* contents_;
+  int num_appends_;
+  int num_replaces_;
+  bool fail_appends_;
+
+  DISALLOW_COPY_AND_ASSIGN(MemoryStorage);
+};
+
+PackageCacheCatalog::Entry MakeEntry(const std::string& key,
+                                     uint64_t size,
+                                     uint64_t last_access_100ns,
+                                     const std::string& digest) {
+  PackageCacheCatalog::Entry entry;
+  entry.key = key;
+  entry.digest = digest;
+  entry.size = size;
+  entry.last_access_100ns = last_access_100ns;
+  return entry;
+}
+
+}  // namespace
+
+class PackageCacheCatalogTest : public testing::Test {
+ protected:
+  PackageCacheCatalogTest() : storage_(NULL) {}
+
+  void SetUp() override {
+    Reopen();
+  }
+
+  // Opens the catalog again, as another process would.
+  bool Reopen() {
+    storage_ = new MemoryStorage(&contents_);
+    catalog_.reset(new PackageCacheCatalog(
+        std::unique_ptr<MemoryStorage>(storage_)));
+    return catalog_->Load();
+  }
+
+  std::string contents_;
+  MemoryStorage* storage_;
+  std::unique_ptr<PackageCacheCatalog> catalog_;
+};
+
+TEST_F(PackageCacheCatalogTest, MissingCatalogFailsLoad) {
+  EXPECT_FALSE(Reopen());
+  EXPECT_EQ(0, catalog_->entry_count());
+  EXPECT_EQ(0, catalog_->total_bytes());
+
+  EXPECT_TRUE(catalog_->Reset(std::vector<PackageCacheCatalog::Entry>()));
+  EXPECT_TRUE(Reopen());
+  EXPECT_EQ(0, catalog_->entry_count());
+}
+
+TEST_F(PackageCacheCatalogTest, PutAndReplay) {
+  EXPECT_TRUE(catalog_->Reset(std::vector<PackageCacheCatalog::Entry>()));
+  EXPECT_TRUE(catalog_->Put(MakeEntry("app1/1.0/a.exe", 100, 1, "")));
+  EXPECT_TRUE(catalog_->Put(MakeEntry("app2/2.0/b.msi", 200, 2, "")));
+  EXPECT_TRUE(catalog_->Touch("app1/1.0/a.exe", 3));
+  EXPECT_TRUE(catalog_->SetPinned("app2/2.0/b.msi", true));
+  EXPECT_FALSE(catalog_->Touch("app3/3.0/c.exe", 4));
+  EXPECT_EQ(4, storage_->num_appends());
+  EXPECT_EQ(300, catalog_->total_bytes());
+
+  ASSERT_TRUE(Reopen());
+  EXPECT_EQ(2, catalog_->entry_count());
+  EXPECT_EQ(300, catalog_->total_bytes());
+
+  const PackageCacheCatalog::Entry* entry = catalog_->Find("app1/1.0/a.exe");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(100, entry->size);
+  EXPECT_EQ(3, entry->last_access_100ns);
+  EXPECT_FALSE(entry->pinned);
+
+  entry = catalog_->Find("app2/2.0/b.msi");
+  ASSERT_TRUE(entry);
+  EXPECT_TRUE(entry->pinned);
+}
+
+TEST_F(PackageCacheCatalogTest, SharedContentsCountOnce) {
+  const std::string digest(64, 'a');
+  EXPECT_TRUE(catalog_->Put(MakeEntry("app1/1.0/a.exe", 100, 1, digest)));
+  EXPECT_TRUE(catalog_->Put(MakeEntry("app2/1.0/a.exe", 100, 2, digest)));
+  EXPECT_TRUE(catalog_->Put(MakeEntry("app3/1.0/c.exe", 50, 3, "")));
+  EXPECT_EQ(150, catalog_->total_bytes());
+
+  EXPECT_TRUE(catalog_->Remove(std::vector<std::string>(1, "app1/1.0/a.exe")));
+  EXPECT_EQ(150, catalog_->total_bytes());
+  EXPECT_TRUE(catalog_->RemovePrefix("app2/"));
+  EXPECT_EQ(50, catalog_->total_bytes());
+
+  // Replacing an entry replaces its size.
+  EXPECT_TRUE(catalog_->Put(MakeEntry("app3/1.0/c.exe", 70, 4, "")));
+  EXPECT_EQ(70, catalog_->total_bytes());
+}
+
+TEST_F(PackageCacheCatalogTest, RemoveIsOneWrite) {
+  EXPECT_TRUE(catalog_->Reset(std::vector<PackageCacheCatalog::Entry>()));
+  EXPECT_TRUE(catalog_->Put(MakeEntry("app1/1.0/a.exe", 1, 1, "")));
+  EXPECT_TRUE(catalog_->Put(MakeEntry("app1/2.0/a.exe", 1, 2, "")));
+  EXPECT_TRUE(catalog_->Put(MakeEntry("app2/1.0/a.exe", 1, 3, "")));
+
+  const int num_appends = storage_->num_appends();
+  EXPECT_TRUE(catalog_->RemovePrefix("app1/"));
+  EXPECT_EQ(num_appends + 1, storage_->num_appends());
+
+  // Unknown keys do not write.
+  EXPECT_TRUE(catalog_->RemovePrefix("app1/"));
+  EXPECT_EQ(num_appends + 1, storage_->num_appends());
+
+  ASSERT_TRUE(Reopen());
+  EXPECT_EQ(1, catalog_->entry_count());
+  EXPECT_TRUE(catalog_->Find("app2/1.0/a.exe"));
+}
+
+TEST_F(PackageCacheCatalogTest, SelectEvictionsLeastRecentlyUsedFirst) {
+  EXPECT_TRUE(catalog_->Put(MakeEntry("app1/1.0/a.exe", 100, 30, "")));
+  EXPECT_TRUE(catalog_->Put(MakeEntry("app2/1.0/b.exe", 100, 10, "")));
+  EXPECT_TRUE(catalog_->Put(MakeEntry("app3/1.0/c.exe", 100, 20, "")));
+
+  EXPECT_TRUE(catalog_->SelectEvictions(300, 0).empty());
+
+  std::vector<std::string> keys(catalog_->SelectEvictions(150, 0));
+  ASSERT_EQ(2, keys.size());
+  EXPECT_EQ("app2/1.0/b.exe", keys[0]);
+  EXPECT_EQ("app3/1.0/c.exe", keys[1]);
+
+  // Accessing a package makes it the most recently used.
+  EXPECT_TRUE(catalog_->Touch("app2/1.0/b.exe", 40));
+  keys = catalog_->SelectEvictions(250, 0);
+  ASSERT_EQ(1, keys.size());
+  EXPECT_EQ("app3/1.0/c.exe", keys[0]);
+
+  // Expired packages are evicted whatever the size.
+  keys = catalog_->SelectEvictions(1000, 31);
+  ASSERT_EQ(2, keys.size());
+  EXPECT_EQ("app3/1.0/c.exe", keys[0]);
+  EXPECT_EQ("app1/1.0/a.exe", keys[1]);
+}
+
+TEST_F(PackageCacheCatalogTest, SelectEvictionsSharedContents) {
+  const std::string digest(64, 'b');
+  EXPECT_TRUE(catalog_->Put(MakeEntry("app1/1.0/a.exe", 100, 10, digest)));
+  EXPECT_TRUE(catalog_->Put(MakeEntry("app2/1.0/a.exe", 100, 20, digest)));
+  EXPECT_TRUE(catalog_->Put(MakeEntry("app3/1.0/c.exe", 100, 30, "")));
+
+  // Evicting the first key frees nothing, so the second one goes too.
+  std::vector<std::string> keys(catalog_->SelectEvictions(150, 0));
+  ASSERT_EQ(2, keys.size());
+  EXPECT_EQ("app1/1.0/a.exe", keys[0]);
+  EXPECT_EQ("app2/1.0/a.exe", keys[1]);
+}
+
+TEST_F(PackageCacheCatalogTest, PinnedPackagesAreNotEvicted) {
+  EXPECT_TRUE(catalog_->Put(MakeEntry("app1/1.0/a.exe", 100, 10, "")));
+  EXPECT_TRUE(catalog_->Put(MakeEntry("app2/1.0/b.exe", 100, 20, "")));
+  EXPECT_TRUE(catalog_->SetPinned("app1/1.0/a.exe", true));
+  EXPECT_FALSE(catalog_->SetPinned("app3/1.0/c.exe", true));
+
+  std::vector<std::string> keys(catalog_->SelectEvictions(0, 100));
+  ASSERT_EQ(1, keys.size());
+  EXPECT_EQ("app2/1.0/b.exe", keys[0]);
+}
+
+TEST_F(PackageCacheCatalogTest, CompactsWhenMostlyDead) {
+  EXPECT_TRUE(catalog_->Reset(std::vector<PackageCacheCatalog::Entry>()));
+  EXPECT_TRUE(catalog_->Put(MakeEntry("app1/1.0/a.exe", 100, 0, "")));
+
+  const int num_replaces = storage_->num_replaces();
+  uint64_t time = 1;
+  while (storage_->num_replaces() == num_replaces) {
+    ASSERT_TRUE(catalog_->Touch("app1/1.0/a.exe", time++));
+    ASSERT_LT(time, 10000);
+  }
+  EXPECT_EQ(0, catalog_->dead_bytes());
+  EXPECT_EQ(contents_.size(), catalog_->size_bytes());
+
+  ASSERT_TRUE(Reopen());
+  EXPECT_EQ(time - 1, catalog_->Find("app1/1.0/a.exe")->last_access_100ns);
+}
+
+TEST_F(PackageCacheCatalogTest, TornTailFailsLoad) {
+  EXPECT_TRUE(catalog_->Reset(std::vector<PackageCacheCatalog::Entry>()));
+  EXPECT_TRUE(catalog_->Put(MakeEntry("app1/1.0/a.exe", 100, 1, "")));
+  EXPECT_TRUE(catalog_->Put(MakeEntry("app2/1.0/b.exe", 200, 2, "")));
+  contents_.resize(contents_.size() - 3);
+
+  EXPECT_FALSE(Reopen());
+  EXPECT_EQ(1, catalog_->entry_count());
+
+  // The next write rewrites the catalog without the damaged tail.
+  EXPECT_TRUE(catalog_->Put(MakeEntry("app3/1.0/c.exe", 300, 3, "")));
+  EXPECT_EQ(0, catalog_->dead_bytes());
+  EXPECT_TRUE(Reopen());
+  EXPECT_EQ(2, catalog_->entry_count());
+  EXPECT_EQ(400, catalog_->total_bytes());
+}
+
+TEST_F(PackageCacheCatalogTest, CorruptRecordFailsLoad) {
+  EXPECT_TRUE(catalog_->Reset(std::vector<PackageCacheCatalog::Entry>()));
+  EXPECT_TRUE(catalog_->Put(MakeEntry("app1/1.0/a.exe", 100, 1, "")));
+  contents_[sizeof(PackageCacheCatalog::kMagic) + 8] ^= 0x01;
+  EXPECT_FALSE(Reopen());
+  EXPECT_EQ(0, catalog_->entry_count());
+
+  contents_ = "not a catalog";
+  EXPECT_FALSE(Reopen());
+}
+
+TEST_F(PackageCacheCatalogTest, FailedWriteDeletesCatalog) {
+  EXPECT_TRUE(catalog_->Reset(std::vector<PackageCacheCatalog::Entry>()));
+  EXPECT_TRUE(catalog_->Put(MakeEntry("app1/1.0/a.exe", 100, 1, "")));
+
+  storage_->set_fail_appends(true);
+  EXPECT_FALSE(catalog_->Put(MakeEntry("app2/1.0/b.exe", 200, 2, "")));
+  EXPECT_TRUE(contents_.empty());
+  EXPECT_EQ(300, catalog_->total_bytes());
+
+  // The next write rewrites the whole catalog.
+  EXPECT_TRUE(catalog_->Touch("app1/1.0/a.exe", 3));
+  EXPECT_TRUE(Reopen());
+  EXPECT_EQ(2, catalog_->entry_count());
+}
+
+TEST(PackageCacheCatalogFileStorageTest, ReadAppendReplace) {
+  std::error_code error;
+  const std::filesystem::path dir(
+      std::filesystem::temp_directory_path() /
+      ("package_cache_catalog_test_" + std::to_string(::testing::UnitTest::
+          GetInstance()->random_seed())));
+  std::filesystem::remove_all(dir, error);
+  ASSERT_TRUE(std::filesystem::create_directories(dir, error));
+  const std::filesystem::path path(dir / "_catalog");
+
+  {
+    PackageCacheCatalog catalog(
+        std::make_unique<PackageCacheCatalog::FileStorage>(path));
+    EXPECT_FALSE(catalog.Load());
+    EXPECT_TRUE(catalog.Reset(
+        std::vector<PackageCacheCatalog::Entry>(
+            1, MakeEntry("app1/1.0/a.exe", 100, 1, ""))));
+    EXPECT_TRUE(catalog.Put(MakeEntry("app2/1.0/b.exe", 200, 2, "")));
+  }
+
+  {
+    PackageCacheCatalog catalog(
+        std::make_unique<PackageCacheCatalog::FileStorage>(path));
+    EXPECT_TRUE(catalog.Load());
+    EXPECT_EQ(300, catalog.total_bytes());
+    EXPECT_EQ(std::filesystem::file_size(path), catalog.size_bytes());
+  }
+
+  std::filesystem::remove_all(dir, error);
+}
+
+}  // namespace omaha
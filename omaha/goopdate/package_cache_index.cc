@@ -0,0 +1,128 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/package_cache_index.h"
+
+namespace omaha {
+
+PackageCacheIndex::PackageCacheIndex() {
+}
+
+PackageCacheIndex::~PackageCacheIndex() {
+}
+
+std::string PackageCacheIndex::NormalizeDigest(const std::string& hash) {
+  if (hash.size() != kDigestLength) {
+    return std::string();
+  }
+
+  std::string digest(hash);
+  for (size_t i = 0; i != digest.size(); ++i) {
+    char& c = digest[i];
+    if (c >= 'A' && c <= 'F') {
+      c = static_cast<char>(c - 'A' + 'a');
+    } else if (!(c >= '0' && c <= '9') && !(c >= 'a' && c <= 'f')) {
+      return std::string();
+    }
+  }
+  return digest;
+}
+
+void PackageCacheIndex::Add(const std::string& key,
+                            const std::string& digest,
+                            std::vector<std::string>* unreferenced) {
+  std::map<std::string, std::string>::iterator it = digests_.find(key);
+  if (it != digests_.end()) {
+    if (it->second == digest) {
+      return;
+    }
+    const std::string previous_digest(it->second);
+    it->second = digest;
+    ++ref_counts_[digest];
+    Release(previous_digest, unreferenced);
+    return;
+  }
+
+  digests_[key] = digest;
+  ++ref_counts_[digest];
+}
+
+bool PackageCacheIndex::Remove(const std::string& key,
+                               std::vector<std::string>* unreferenced) {
+  std::map<std::string, std::string>::iterator it = digests_.find(key);
+  if (it == digests_.end()) {
+    return false;
+  }
+
+  const std::string digest(it->second);
+  digests_.erase(it);
+  Release(digest, unreferenced);
+  return true;
+}
+
+size_t PackageCacheIndex::RemovePrefix(const std::string& prefix,
+                                       std::vector<std::string>* unreferenced) {
+  size_t count = 0;
+  std::map<std::string, std::string>::iterator it =
+      digests_.lower_bound(prefix);
+  while (it != digests_.end() &&
+         it->first.compare(0, prefix.size(), prefix) == 0) {
+    const std::string digest(it->second);
+    it = digests_.erase(it);
+    Release(digest, unreferenced);
+    ++count;
+  }
+  return count;
+}
+
+void PackageCacheIndex::Clear() {
+  digests_.clear();
+  ref_counts_.clear();
+}
+
+bool PackageCacheIndex::GetDigest(const std::string& key,
+                                  std::string* digest) const {
+  std::map<std::string, std::string>::const_iterator it = digests_.find(key);
+  if (it == digests_.end()) {
+    return false;
+  }
+  if (digest) {
+    *digest = it->second;
+  }
+  return true;
+}
+
+int PackageCacheIndex::GetRefCount(const std::string& digest) const {
+  std::map<std::string, int>::const_iterator it = ref_counts_.find(digest);
+  return it == ref_counts_.end() ? 0 : it->second;
+}
+
+void PackageCacheIndex::Release(const std::string& digest,
+                                std::vector<std::string>* unreferenced) {
+  std::map<std::string, int>::iterator it = ref_counts_.find(digest);
+  if (it == ref_counts_.end()) {
+    return;
+  }
+  if (--it->second > 0) {
+    return;
+  }
+
+  ref_counts_.erase(it);
+  if (unreferenced) {
+    unreferenced->push_back(digest);
+  }
+}
+
+}  // namespace omaha
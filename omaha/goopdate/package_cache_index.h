@@ -0,0 +1,90 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// PackageCacheIndex maps the keys of the packages in a content-addressed
+// PackageCache to the SHA-256 digests of their contents, and counts how many
+// keys refer to each digest.
+//
+// The contents of a package are stored once per digest, however many apps,
+// channels, or versions ship them. A key is the path of a package relative to
+// the cache root, as in "app_id/version/package_name". Removing keys returns
+// the digests which no key refers to any more, so that the cache deletes a
+// stored package only when its last key is purged.
+//
+// This file has no platform dependencies.
+
+#ifndef OMAHA_GOOPDATE_PACKAGE_CACHE_INDEX_H_
+#define OMAHA_GOOPDATE_PACKAGE_CACHE_INDEX_H_
+
+#include <stddef.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+
+namespace omaha {
+
+class PackageCacheIndex {
+ public:
+  // The length of a SHA-256 digest in hexadecimal.
+  static const size_t kDigestLength = 64;
+
+  PackageCacheIndex();
+  ~PackageCacheIndex();
+
+  // Returns |hash| in lower case if it is a SHA-256 digest in hexadecimal,
+  // or an empty string otherwise.
+  static std::string NormalizeDigest(const std::string& hash);
+
+  // Maps |key| to |digest|. If |key| was mapped to another digest which no
+  // other key refers to, appends that digest to |unreferenced|.
+  void Add(const std::string& key,
+           const std::string& digest,
+           std::vector<std::string>* unreferenced);
+
+  // Removes |key|. Returns false if |key| is not in the index.
+  bool Remove(const std::string& key, std::vector<std::string>* unreferenced);
+
+  // Removes the keys which start with |prefix|, such as all the keys of an
+  // app or of a version of an app. Returns the number of keys removed.
+  size_t RemovePrefix(const std::string& prefix,
+                      std::vector<std::string>* unreferenced);
+
+  void Clear();
+
+  bool GetDigest(const std::string& key, std::string* digest) const;
+
+  // Returns the number of keys which refer to |digest|.
+  int GetRefCount(const std::string& digest) const;
+
+  size_t key_count() const { return digests_.size(); }
+  size_t digest_count() const { return ref_counts_.size(); }
+
+ private:
+  void Release(const std::string& digest,
+               std::vector<std::string>* unreferenced);
+
+  // Sorted by key, so that the keys under a prefix are adjacent.
+  std::map<std::string, std::string> digests_;
+  std::map<std::string, int> ref_counts_;
+
+  DISALLOW_COPY_AND_ASSIGN(PackageCacheIndex);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_GOOPDATE_PACKAGE_CACHE_INDEX_H_
@@ -0,0 +1,129 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/package_cache_index.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace omaha {
+
+namespace {
+
+const char kDigest1[] =
+    "49b45f78865621b154fa65089f955182345a67f9746841e43e2d6daa288988d0";
+const char kDigest2[] =
+    "f0bbd84d7ec364f6c33161d781b49d840ed792b8b10668c4180b9e6e128d0bc9";
+
+const char kApp1Version1[] = "{app1}/1.0.0.0/setup.exe";
+const char kApp1Version2[] = "{app1}/2.0.0.0/setup.exe";
+const char kApp2Version1[] = "{app2}/1.0.0.0/setup.exe";
+
+}  // namespace
+
+TEST(PackageCacheIndexTest, NormalizeDigest) {
+  EXPECT_EQ(kDigest1, PackageCacheIndex::NormalizeDigest(kDigest1));
+  EXPECT_EQ(kDigest1, PackageCacheIndex::NormalizeDigest(
+      "49B45F78865621B154FA65089F955182345A67F9746841E43E2D6DAA288988D0"));
+
+  EXPECT_EQ("", PackageCacheIndex::NormalizeDigest(""));
+  EXPECT_EQ("", PackageCacheIndex::NormalizeDigest("49b45f78"));
+  EXPECT_EQ("", PackageCacheIndex::NormalizeDigest(
+      "49b45f78865621b154fa65089f955182345a67f9746841e43e2d6daa288988dg"));
+  EXPECT_EQ("", PackageCacheIndex::NormalizeDigest(
+      "../45f78865621b154fa65089f955182345a67f9746841e43e2d6daa288988d0"));
+  EXPECT_EQ("", PackageCacheIndex::NormalizeDigest(
+      "ZAuDFxGxdv5I2V73oqbMdgRYA3NSzPsbxuJzWmNCYAA="));
+}
+
+TEST(PackageCacheIndexTest, SharedDigest) {
+  PackageCacheIndex index;
+  std::vector<std::string> unreferenced;
+
+  index.Add(kApp1Version1, kDigest1, &unreferenced);
+  index.Add(kApp1Version2, kDigest1, &unreferenced);
+  index.Add(kApp2Version1, kDigest1, &unreferenced);
+  EXPECT_TRUE(unreferenced.empty());
+  EXPECT_EQ(3u, index.key_count());
+  EXPECT_EQ(1u, index.digest_count());
+  EXPECT_EQ(3, index.GetRefCount(kDigest1));
+
+  std::string digest;
+  EXPECT_TRUE(index.GetDigest(kApp1Version2, &digest));
+  EXPECT_EQ(kDigest1, digest);
+
+  // The digest is unreferenced when its last key is removed.
+  EXPECT_TRUE(index.Remove(kApp1Version1, &unreferenced));
+  EXPECT_FALSE(index.Remove(kApp1Version1, &unreferenced));
+  EXPECT_TRUE(index.Remove(kApp2Version1, &unreferenced));
+  EXPECT_TRUE(unreferenced.empty());
+  EXPECT_EQ(1, index.GetRefCount(kDigest1));
+
+  EXPECT_TRUE(index.Remove(kApp1Version2, &unreferenced));
+  ASSERT_EQ(1u, unreferenced.size());
+  EXPECT_EQ(kDigest1, unreferenced[0]);
+  EXPECT_EQ(0, index.GetRefCount(kDigest1));
+  EXPECT_EQ(0u, index.key_count());
+  EXPECT_EQ(0u, index.digest_count());
+}
+
+TEST(PackageCacheIndexTest, AddReplacesDigest) {
+  PackageCacheIndex index;
+  std::vector<std::string> unreferenced;
+
+  index.Add(kApp1Version1, kDigest1, &unreferenced);
+  index.Add(kApp1Version1, kDigest1, &unreferenced);
+  EXPECT_EQ(1, index.GetRefCount(kDigest1));
+
+  index.Add(kApp2Version1, kDigest2, &unreferenced);
+  index.Add(kApp1Version1, kDigest2, &unreferenced);
+  ASSERT_EQ(1u, unreferenced.size());
+  EXPECT_EQ(kDigest1, unreferenced[0]);
+  EXPECT_EQ(2, index.GetRefCount(kDigest2));
+  EXPECT_EQ(1u, index.digest_count());
+}
+
+TEST(PackageCacheIndexTest, RemovePrefix) {
+  PackageCacheIndex index;
+  std::vector<std::string> unreferenced;
+
+  index.Add(kApp1Version1, kDigest1, &unreferenced);
+  index.Add("{app1}/1.0.0.0/data.bin", kDigest2, &unreferenced);
+  index.Add("{app1}/1.0.0.01/setup.exe", kDigest2, &unreferenced);
+  index.Add(kApp1Version2, kDigest1, &unreferenced);
+  index.Add(kApp2Version1, kDigest2, &unreferenced);
+
+  // Purges a version of an app.
+  EXPECT_EQ(2u, index.RemovePrefix("{app1}/1.0.0.0/", &unreferenced));
+  EXPECT_TRUE(unreferenced.empty());
+  EXPECT_TRUE(index.GetDigest("{app1}/1.0.0.01/setup.exe", NULL));
+
+  // Purges an app.
+  EXPECT_EQ(2u, index.RemovePrefix("{app1}/", &unreferenced));
+  ASSERT_EQ(1u, unreferenced.size());
+  EXPECT_EQ(kDigest1, unreferenced[0]);
+  EXPECT_EQ(1, index.GetRefCount(kDigest2));
+
+  EXPECT_EQ(0u, index.RemovePrefix("{app3}/", &unreferenced));
+  EXPECT_EQ(1u, index.key_count());
+
+  index.Clear();
+  EXPECT_EQ(0u, index.key_count());
+  EXPECT_EQ(0u, index.digest_count());
+}
+
+}  // namespace omaha
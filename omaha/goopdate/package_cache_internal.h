@@ -21,6 +21,7 @@
 #include <vector>
 #include "base/basictypes.h"
 #include "base/synchronized.h"
+#include "omaha/base/binary_patch.h"
 
 namespace omaha {
 
@@ -79,6 +80,62 @@ void SortPackageInfoByTime(std::vector<PackageInfo>* packages_info);
 
 HRESULT FileCopy(File* source_file, const CString& destination);
 
+// Returns the identifier of a file on its volume, which the hard links to the
+// file share.
+HRESULT GetFileId(const CString& file_name, uint64* file_id);
+
+// Returns the number of hard links to a file.
+HRESULT GetFileLinkCount(const CString& file_name, uint32* link_count);
+
+// Creates |destination| as a copy-on-write clone of |source|, where the file
+// system supports block cloning, such as ReFS.
+HRESULT CloneFile(const CString& source, const CString& destination);
+
+// Adapters which let BinaryPatch read and write File objects.
+class FilePatchSource : public BinaryPatch::Source {
+ public:
+  FilePatchSource(File* file, uint32 size) : file_(file), size_(size) {}
+
+  virtual uint64_t size() const { return size_; }
+  virtual bool ReadAt(uint64_t offset, uint8_t* buffer, size_t size);
+
+ private:
+  File* file_;
+  const uint32 size_;
+
+  DISALLOW_COPY_AND_ASSIGN(FilePatchSource);
+};
+
+class FilePatchReader : public BinaryPatch::Reader {
+ public:
+  explicit FilePatchReader(File* file) : file_(file) {}
+
+  virtual int64_t Read(uint8_t* buffer, size_t size);
+
+ private:
+  File* file_;
+
+  DISALLOW_COPY_AND_ASSIGN(FilePatchReader);
+};
+
+class FilePatchWriter : public BinaryPatch::Writer {
+ public:
+  explicit FilePatchWriter(File* file) : file_(file) {}
+
+  virtual bool Write(const uint8_t* data, size_t size);
+
+ private:
+  File* file_;
+
+  DISALLOW_COPY_AND_ASSIGN(FilePatchWriter);
+};
+
+// Writes the file obtained by applying |patch_file| to |base_file| to
+// |destination|. The destination is not deleted if the patch fails.
+BinaryPatch::Result FilePatch(File* base_file,
+                              File* patch_file,
+                              const CString& destination);
+
 }  // namespace internal
 
 }  // namespace omaha
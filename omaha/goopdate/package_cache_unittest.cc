@@ -13,7 +13,11 @@
 // limitations under the License.
 // ========================================================================
 
+#include <string>
+#include <vector>
+
 #include "omaha/base/app_util.h"
+#include "omaha/base/binary_patch.h"
 #include "omaha/base/error.h"
 #include "omaha/base/file.h"
 #include "omaha/base/path.h"
@@ -71,11 +75,15 @@ class PackageCacheTest : public testing::TestWithParam<bool> {
                                                       false,
                                                       false,
                                                       FILE_SHARE_READ));
+
+    // The tests store a copy of the package per key, unless they are
+    // content-addressed tests.
+    SetContentAddressed(&package_cache_, false);
   }
 
   virtual void SetUp() {
     EXPECT_FALSE(String_EndsWith(cache_root_, _T("\\"), true));
-    EXPECT_HRESULT_SUCCEEDED(package_cache_.Initialize(cache_root_));
+    EXPECT_HRESULT_SUCCEEDED(package_cache_.Initialize(false, cache_root_));
     EXPECT_HRESULT_SUCCEEDED(package_cache_.PurgeAll());
   }
 
@@ -102,12 +110,26 @@ class PackageCacheTest : public testing::TestWithParam<bool> {
     expiration_time.dwLowDateTime = file_time.LowPart;
     expiration_time.dwHighDateTime = file_time.HighPart;
 
+    // The cache expires the packages by the last access times in its
+    // catalog, which are the file times when the catalog is rebuilt.
+    if (!package_cache_.catalog_->Touch(
+            package_cache_.BuildIndexKey(key.app_id(),
+                                         key.version(),
+                                         key.package_name()),
+            file_time.QuadPart)) {
+      return E_FAIL;
+    }
+
     return File::SetFileTime(cached_file_name,
                              &expiration_time,
                              &expiration_time,
                              &expiration_time);
   }
 
+  CString GetCatalogFileName() const {
+    return ConcatenatePath(cache_root_, _T("_catalog"));
+  }
+
   void SetCacheSizeLimitMB(int limit_mb) {
     package_cache_.cache_size_limit_bytes_ = 1024 * 1024 *
       static_cast<uint64>(limit_mb);
@@ -117,6 +139,26 @@ class PackageCacheTest : public testing::TestWithParam<bool> {
     package_cache_.cache_time_limit_days_ = limit_days;
   }
 
+  static void SetCacheSizeLimitBytes(PackageCache* package_cache,
+                                     uint64 limit_bytes) {
+    package_cache->cache_size_limit_bytes_ = limit_bytes;
+  }
+
+  static void SetContentAddressed(PackageCache* package_cache,
+                                  bool content_addressed) {
+    package_cache->content_addressed_ = content_addressed;
+  }
+
+  int GetContentRefCount(const CString& hash) const {
+    return package_cache_.GetContentRefCount(
+        PackageCacheIndex::NormalizeDigest(std::string(CT2A(hash))));
+  }
+
+  bool IsContentStored(const CString& hash) const {
+    return File::Exists(package_cache_.BuildContentFileName(
+        PackageCacheIndex::NormalizeDigest(std::string(CT2A(hash)))));
+  }
+
   const CString cache_root_;
   CString source_file1_;
   File source_file1_file_;
@@ -131,6 +173,13 @@ class PackageCacheTest : public testing::TestWithParam<bool> {
   PackageCache package_cache_;
 };
 
+class PackageCacheContentAddressedTest : public PackageCacheTest {
+ protected:
+  PackageCacheContentAddressedTest() {
+    SetContentAddressed(&package_cache_, true);
+  }
+};
+
 // Tests the members of key when the constructor arguments are empty strings.
 TEST_F(PackageCacheTest, DefaultVersion) {
   Key key(_T(""), _T(""), _T(""));
@@ -147,9 +196,9 @@ TEST_F(PackageCacheTest, Initialize) {
 
 TEST_F(PackageCacheTest, InitializeErrors) {
   PackageCache package_cache;
-  EXPECT_EQ(E_INVALIDARG, package_cache.Initialize(NULL));
-  EXPECT_EQ(E_INVALIDARG, package_cache.Initialize(_T("")));
-  EXPECT_EQ(E_INVALIDARG, package_cache.Initialize(_T("foo")));
+  EXPECT_EQ(E_INVALIDARG, package_cache.Initialize(false, NULL));
+  EXPECT_EQ(E_INVALIDARG, package_cache.Initialize(false, _T("")));
+  EXPECT_EQ(E_INVALIDARG, package_cache.Initialize(false, _T("foo")));
 }
 
 TEST_F(PackageCacheTest, BuildCacheFileName) {
@@ -257,6 +306,138 @@ TEST_F(PackageCacheTest, PutBadHashTest) {
   EXPECT_FALSE(package_cache_.IsCached(key1, hash_file1_));
 }
 
+// The verifier only runs on packages which match their hash, and the package
+// is not cached if the verifier rejects it.
+TEST_F(PackageCacheTest, PutVerifierTest) {
+  EXPECT_HRESULT_SUCCEEDED(package_cache_.PurgeAll());
+
+  Key key1(_T("app1"), _T("ver1"), _T("package1"));
+
+  int num_verified = 0;
+  PackageCache::Verifier verifier =
+      [&num_verified](File* package_file, const CString& package_path) {
+        EXPECT_TRUE(package_file);
+        EXPECT_TRUE(File::Exists(package_path));
+        ++num_verified;
+        return E_FAIL;
+      };
+
+  CString bad_hash =
+      _T("0000bad0000364f6c33161d781b49d840ed792b8b10668c4180b9e6e128d0bc9");
+  EXPECT_EQ(SIGS_E_INVALID_SIGNATURE, package_cache_.Put(key1,
+                                                         &source_file1_file_,
+                                                         bad_hash,
+                                                         verifier));
+  EXPECT_EQ(0, num_verified);
+
+  EXPECT_EQ(E_FAIL, package_cache_.Put(key1,
+                                       &source_file1_file_,
+                                       hash_file1_,
+                                       verifier));
+  EXPECT_EQ(1, num_verified);
+  EXPECT_FALSE(package_cache_.IsCached(key1, hash_file1_));
+
+  verifier = [&num_verified](File*, const CString&) {
+    ++num_verified;
+    return S_OK;
+  };
+  EXPECT_SUCCEEDED(package_cache_.Put(key1,
+                                      &source_file1_file_,
+                                      hash_file1_,
+                                      verifier));
+  EXPECT_EQ(2, num_verified);
+  EXPECT_TRUE(package_cache_.IsCached(key1, hash_file1_));
+}
+
+// Applies a patch from the package of ver1 to the package of ver2.
+TEST_F(PackageCacheTest, PutFromPatch) {
+  std::vector<byte> file1;
+  std::vector<byte> file2;
+  EXPECT_SUCCEEDED(ReadEntireFileShareMode(source_file1_, 0, FILE_SHARE_READ,
+                                           &file1));
+  EXPECT_SUCCEEDED(ReadEntireFileShareMode(source_file2_, 0, FILE_SHARE_READ,
+                                           &file2));
+  const std::string patch = BinaryPatch::Create(
+      std::string(file1.begin(), file1.end()),
+      std::string(file2.begin(), file2.end()));
+
+  const CString patch_file_name = GetTempFilename(_T("ut_"));
+  EXPECT_SUCCEEDED(WriteEntireFile(
+      patch_file_name, std::vector<byte>(patch.begin(), patch.end())));
+  File patch_file;
+  EXPECT_SUCCEEDED(patch_file.OpenShareMode(patch_file_name,
+                                            false,
+                                            false,
+                                            FILE_SHARE_READ));
+
+  Key key2(_T("app1"), _T("ver2"), _T("package1"));
+
+  // There is no cached package to apply the patch to.
+  EXPECT_EQ(GOOPDATEDOWNLOAD_E_PATCH_FAILED,
+            package_cache_.PutFromPatch(key2, _T("ver1"), &patch_file,
+                                        hash_file2_,
+                                        PackageCache::Verifier()));
+
+  // The cached package of ver1 is not the one the patch was built against.
+  Key key1(_T("app1"), _T("ver1"), _T("package1"));
+  EXPECT_SUCCEEDED(package_cache_.Put(key1, &source_file2_file_, hash_file2_));
+  EXPECT_EQ(GOOPDATEDOWNLOAD_E_PATCH_FAILED,
+            package_cache_.PutFromPatch(key2, _T("ver1"), &patch_file,
+                                        hash_file2_,
+                                        PackageCache::Verifier()));
+  EXPECT_FALSE(package_cache_.IsCached(key2, hash_file2_));
+
+  Key key1_other(_T("app1"), _T("ver1"), _T("package2"));
+  EXPECT_SUCCEEDED(package_cache_.Put(key1_other,
+                                      &source_file1_file_,
+                                      hash_file1_));
+
+  std::vector<CString> package_names;
+  EXPECT_SUCCEEDED(package_cache_.GetPackageNames(_T("app1"), _T("ver1"),
+                                                  &package_names));
+  EXPECT_EQ(2, package_names.size());
+
+  // The patch applies to the other package of ver1, but the patched package
+  // is rejected by the verifier.
+  int num_verifications = 0;
+  CString verified_path;
+  PackageCache::Verifier verifier =
+      [&](File* package_file, const CString& package_path) {
+        EXPECT_TRUE(package_file);
+        ++num_verifications;
+        verified_path = package_path;
+        return TRUST_E_NOSIGNATURE;
+      };
+  EXPECT_EQ(TRUST_E_NOSIGNATURE,
+            package_cache_.PutFromPatch(key2, _T("ver1"), &patch_file,
+                                        hash_file2_, verifier));
+  EXPECT_EQ(1, num_verifications);
+  EXPECT_FALSE(package_cache_.IsCached(key2, hash_file2_));
+  EXPECT_FALSE(File::Exists(verified_path));
+
+  verifier = [&](File* package_file, const CString& package_path) {
+    EXPECT_TRUE(package_file);
+    EXPECT_STREQ(verified_path, package_path);
+    ++num_verifications;
+    return S_OK;
+  };
+  EXPECT_SUCCEEDED(package_cache_.PutFromPatch(key2, _T("ver1"), &patch_file,
+                                               hash_file2_, verifier));
+  EXPECT_EQ(2, num_verifications);
+  EXPECT_TRUE(package_cache_.IsCached(key2, hash_file2_));
+
+  // The patched package must match the hash of the full package.
+  Key key3(_T("app1"), _T("ver3"), _T("package1"));
+  EXPECT_EQ(SIGS_E_INVALID_SIGNATURE,
+            package_cache_.PutFromPatch(key3, _T("ver1"), &patch_file,
+                                        hash_file1_,
+                                        PackageCache::Verifier()));
+  EXPECT_FALSE(package_cache_.IsCached(key3, hash_file1_));
+
+  EXPECT_SUCCEEDED(patch_file.Close());
+  EXPECT_TRUE(::DeleteFile(patch_file_name));
+}
+
 // The key must include the app id, version, and package name for Put and Get
 // operations. If the version is not provided, "0.0.0.0" is used internally.
 TEST_F(PackageCacheTest, BadKeyTest) {
@@ -528,6 +709,142 @@ TEST_F(PackageCacheTest, PurgeExpiredCacheFiles) {
   EXPECT_FALSE(package_cache_.IsCached(key2, hash_file2_));
 }
 
+// Getting a package makes it the most recently used one.
+TEST_F(PackageCacheTest, PurgeLeastRecentlyUsed) {
+  Key key1(_T("app1"), _T("version1"), _T("package1"));
+  Key key2(_T("app2"), _T("version2"), _T("package2"));
+  EXPECT_HRESULT_SUCCEEDED(package_cache_.Put(key1,
+                                              &source_file1_file_,
+                                              hash_file1_));
+  ::Sleep(20);
+  EXPECT_HRESULT_SUCCEEDED(package_cache_.Put(key2,
+                                              &source_file2_file_,
+                                              hash_file2_));
+  ::Sleep(20);
+
+  CString destination_file = GetTempFilename(_T("ut_"));
+  EXPECT_FALSE(destination_file.IsEmpty());
+  EXPECT_SUCCEEDED(package_cache_.Get(key1, destination_file, hash_file1_));
+  EXPECT_TRUE(::DeleteFile(destination_file));
+
+  SetCacheSizeLimitMB(1);
+  package_cache_.PurgeOldPackagesIfNecessary();
+  EXPECT_TRUE(package_cache_.IsCached(key1, hash_file1_));
+  EXPECT_FALSE(package_cache_.IsCached(key2, hash_file2_));
+  EXPECT_EQ(size_file1_, package_cache_.Size());
+}
+
+TEST_F(PackageCacheTest, PinnedPackagesAreNotPurged) {
+  const int kCacheLifeLimitDays = 100;
+  SetCacheTimeLimitDays(kCacheLifeLimitDays);
+
+  Key key1(_T("app1"), _T("version1"), _T("package1"));
+  Key key2(_T("app2"), _T("version2"), _T("package2"));
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND),
+            package_cache_.SetPinned(key1, true));
+  EXPECT_HRESULT_SUCCEEDED(package_cache_.Put(key1,
+                                              &source_file1_file_,
+                                              hash_file1_));
+  EXPECT_HRESULT_SUCCEEDED(package_cache_.Put(key2,
+                                              &source_file2_file_,
+                                              hash_file2_));
+  EXPECT_SUCCEEDED(package_cache_.SetPinned(key1, true));
+
+  EXPECT_HRESULT_SUCCEEDED(ExpireCache(key1));
+  EXPECT_HRESULT_SUCCEEDED(ExpireCache(key2));
+  package_cache_.PurgeOldPackagesIfNecessary();
+  EXPECT_TRUE(package_cache_.IsCached(key1, hash_file1_));
+  EXPECT_FALSE(package_cache_.IsCached(key2, hash_file2_));
+
+  // Purging a pinned package explicitly deletes it.
+  EXPECT_SUCCEEDED(package_cache_.Purge(key1));
+  EXPECT_FALSE(package_cache_.IsCached(key1, hash_file1_));
+  EXPECT_EQ(0, package_cache_.Size());
+}
+
+// A new cache on the same root loads the catalog, or rebuilds it from the
+// cache directories if it is missing or damaged.
+TEST_F(PackageCacheTest, LoadCatalog) {
+  Key key1(_T("app1"), _T("version1"), _T("package1"));
+  Key key2(_T("app2"), _T("version2"), _T("package2"));
+  EXPECT_HRESULT_SUCCEEDED(package_cache_.Put(key1,
+                                              &source_file1_file_,
+                                              hash_file1_));
+  EXPECT_HRESULT_SUCCEEDED(package_cache_.Put(key2,
+                                              &source_file2_file_,
+                                              hash_file2_));
+  EXPECT_SUCCEEDED(package_cache_.SetPinned(key1, true));
+
+  {
+    PackageCache package_cache;
+    SetContentAddressed(&package_cache, false);
+    EXPECT_SUCCEEDED(package_cache.Initialize(false, cache_root_));
+    EXPECT_EQ(size_file1_ + size_file2_, package_cache.Size());
+
+    // The pin state is loaded from the catalog.
+    SetCacheSizeLimitBytes(&package_cache, 0);
+    EXPECT_SUCCEEDED(package_cache.PurgeOldPackagesIfNecessary());
+    EXPECT_TRUE(package_cache.IsCached(key1, hash_file1_));
+    EXPECT_FALSE(package_cache.IsCached(key2, hash_file2_));
+    EXPECT_EQ(size_file1_, package_cache.Size());
+  }
+
+  EXPECT_TRUE(::DeleteFile(GetCatalogFileName()));
+  {
+    PackageCache package_cache;
+    SetContentAddressed(&package_cache, false);
+    EXPECT_SUCCEEDED(package_cache.Initialize(false, cache_root_));
+    EXPECT_EQ(size_file1_, package_cache.Size());
+    EXPECT_TRUE(File::Exists(GetCatalogFileName()));
+  }
+
+  // The catalog is rebuilt when it is damaged.
+  File catalog_file;
+  EXPECT_SUCCEEDED(catalog_file.Open(GetCatalogFileName(), true, false));
+  const char kGarbage[] = "garbage";
+  uint32 bytes_written = 0;
+  EXPECT_SUCCEEDED(catalog_file.Write(reinterpret_cast<const byte*>(kGarbage),
+                                      sizeof(kGarbage),
+                                      &bytes_written));
+  EXPECT_SUCCEEDED(catalog_file.Close());
+  {
+    PackageCache package_cache;
+    SetContentAddressed(&package_cache, false);
+    EXPECT_SUCCEEDED(package_cache.Initialize(false, cache_root_));
+    EXPECT_EQ(size_file1_, package_cache.Size());
+  }
+}
+
+// The changes one cache makes are seen by another cache on the same root,
+// as when two processes share the cache.
+TEST_F(PackageCacheTest, SharedCatalog) {
+  Key key1(_T("app1"), _T("ver1"), _T("package1"));
+  Key key2(_T("app2"), _T("ver2"), _T("package2"));
+
+  PackageCache package_cache;
+  SetContentAddressed(&package_cache, false);
+  EXPECT_SUCCEEDED(package_cache.Initialize(false, cache_root_));
+  EXPECT_EQ(0, package_cache.Size());
+
+  EXPECT_HRESULT_SUCCEEDED(package_cache_.Put(key1,
+                                              &source_file1_file_,
+                                              hash_file1_));
+  EXPECT_EQ(size_file1_, package_cache.Size());
+
+  EXPECT_HRESULT_SUCCEEDED(package_cache.Put(key2,
+                                             &source_file2_file_,
+                                             hash_file2_));
+  EXPECT_EQ(size_file1_ + size_file2_, package_cache_.Size());
+
+  // The eviction accounts for the package the other cache stored.
+  EXPECT_SUCCEEDED(package_cache_.SetPinned(key2, true));
+  SetCacheSizeLimitBytes(&package_cache, size_file2_);
+  EXPECT_SUCCEEDED(package_cache.PurgeOldPackagesIfNecessary());
+  EXPECT_FALSE(package_cache_.IsCached(key1, hash_file1_));
+  EXPECT_TRUE(package_cache_.IsCached(key2, hash_file2_));
+  EXPECT_EQ(size_file2_, package_cache_.Size());
+}
+
 TEST_F(PackageCacheTest, VerifyHash) {
   EXPECT_HRESULT_SUCCEEDED(PackageCache::VerifyHash(source_file1_,
                                                     hash_file1_));
@@ -535,5 +852,141 @@ TEST_F(PackageCacheTest, VerifyHash) {
             PackageCache::VerifyHash(source_file1_, hash_file2_));
 }
 
-}  // namespace omaha
+// The contents shared by several keys are stored and counted once.
+TEST_F(PackageCacheContentAddressedTest, Deduplicate) {
+  EXPECT_TRUE(package_cache_.is_content_addressed());
+
+  Key key1(_T("app1"), _T("ver1"), _T("package1"));
+  Key key2(_T("app2"), _T("ver2"), _T("package2"));
+  Key key3(_T("app1"), _T("ver2"), _T("package1"));
+
+  EXPECT_SUCCEEDED(package_cache_.Put(key1, &source_file1_file_, hash_file1_));
+  EXPECT_SUCCEEDED(package_cache_.Put(key2, &source_file1_file_, hash_file1_));
+  EXPECT_SUCCEEDED(package_cache_.Put(key3, &source_file2_file_, hash_file2_));
+
+  EXPECT_EQ(2, GetContentRefCount(hash_file1_));
+  EXPECT_EQ(1, GetContentRefCount(hash_file2_));
+  EXPECT_EQ(size_file1_ + size_file2_, package_cache_.Size());
+
+  EXPECT_TRUE(package_cache_.IsCached(key1, hash_file1_));
+  EXPECT_TRUE(package_cache_.IsCached(key2, hash_file1_));
+  EXPECT_TRUE(package_cache_.IsCached(key3, hash_file2_));
+
+  CString destination_file = GetTempFilename(_T("ut_"));
+  EXPECT_FALSE(destination_file.IsEmpty());
+  EXPECT_SUCCEEDED(package_cache_.Get(key2, destination_file, hash_file1_));
+  EXPECT_SUCCEEDED(PackageCache::VerifyHash(destination_file, hash_file1_));
+  EXPECT_TRUE(::DeleteFile(destination_file));
+}
+
+// The contents are deleted when the last key which refers to them is purged.
+TEST_F(PackageCacheContentAddressedTest, Purge) {
+  Key key1(_T("app1"), _T("ver1"), _T("package1"));
+  Key key2(_T("app2"), _T("ver2"), _T("package2"));
+
+  EXPECT_SUCCEEDED(package_cache_.Put(key1, &source_file1_file_, hash_file1_));
+  EXPECT_SUCCEEDED(package_cache_.Put(key2, &source_file1_file_, hash_file1_));
+
+  EXPECT_SUCCEEDED(package_cache_.Purge(key1));
+  EXPECT_FALSE(package_cache_.IsCached(key1, hash_file1_));
+  EXPECT_TRUE(package_cache_.IsCached(key2, hash_file1_));
+  EXPECT_EQ(1, GetContentRefCount(hash_file1_));
+  EXPECT_TRUE(IsContentStored(hash_file1_));
+  EXPECT_EQ(size_file1_, package_cache_.Size());
+
+  EXPECT_SUCCEEDED(package_cache_.PurgeApp(_T("app2")));
+  EXPECT_FALSE(package_cache_.IsCached(key2, hash_file1_));
+  EXPECT_EQ(0, GetContentRefCount(hash_file1_));
+  EXPECT_FALSE(IsContentStored(hash_file1_));
+  EXPECT_EQ(0, package_cache_.Size());
+}
 
+// Putting other contents for a key does not change the contents of the
+// other keys which shared its previous contents.
+TEST_F(PackageCacheContentAddressedTest, ReplaceSharedContents) {
+  Key key1(_T("app1"), _T("ver1"), _T("package1"));
+  Key key2(_T("app2"), _T("ver2"), _T("package2"));
+
+  EXPECT_SUCCEEDED(package_cache_.Put(key1, &source_file1_file_, hash_file1_));
+  EXPECT_SUCCEEDED(package_cache_.Put(key2, &source_file1_file_, hash_file1_));
+  EXPECT_SUCCEEDED(package_cache_.Put(key2, &source_file2_file_, hash_file2_));
+
+  EXPECT_TRUE(package_cache_.IsCached(key1, hash_file1_));
+  EXPECT_TRUE(package_cache_.IsCached(key2, hash_file2_));
+  EXPECT_EQ(1, GetContentRefCount(hash_file1_));
+  EXPECT_EQ(1, GetContentRefCount(hash_file2_));
+  EXPECT_EQ(size_file1_ + size_file2_, package_cache_.Size());
+}
+
+// A new cache on the same root finds the keys linked to stored contents.
+TEST_F(PackageCacheContentAddressedTest, LoadContentIndex) {
+  Key key1(_T("app1"), _T("ver1"), _T("package1"));
+  Key key2(_T("app2"), _T("ver2"), _T("package2"));
+
+  EXPECT_SUCCEEDED(package_cache_.Put(key1, &source_file1_file_, hash_file1_));
+  EXPECT_SUCCEEDED(package_cache_.Put(key2, &source_file1_file_, hash_file1_));
+
+  PackageCache package_cache;
+  SetContentAddressed(&package_cache, true);
+  EXPECT_SUCCEEDED(package_cache.Initialize(false, cache_root_));
+  EXPECT_EQ(size_file1_, package_cache.Size());
+
+  EXPECT_SUCCEEDED(package_cache.Purge(key1));
+  EXPECT_SUCCEEDED(package_cache.Purge(key2));
+  EXPECT_FALSE(IsContentStored(hash_file1_));
+  EXPECT_EQ(0, package_cache.Size());
+}
+
+// The contents linked by another cache on the same root, as by another
+// process, are kept until the last package file linked to them is purged.
+TEST_F(PackageCacheContentAddressedTest, SharedContentsAcrossCaches) {
+  Key key1(_T("app1"), _T("ver1"), _T("package1"));
+  Key key2(_T("app2"), _T("ver2"), _T("package2"));
+
+  PackageCache package_cache;
+  SetContentAddressed(&package_cache, true);
+  EXPECT_SUCCEEDED(package_cache.Initialize(false, cache_root_));
+
+  EXPECT_SUCCEEDED(package_cache_.Put(key1, &source_file1_file_, hash_file1_));
+  EXPECT_SUCCEEDED(package_cache.Put(key2, &source_file1_file_, hash_file1_));
+  EXPECT_EQ(2, GetContentRefCount(hash_file1_));
+
+  EXPECT_SUCCEEDED(package_cache_.Purge(key1));
+  EXPECT_TRUE(package_cache.IsCached(key2, hash_file1_));
+  EXPECT_TRUE(IsContentStored(hash_file1_));
+  EXPECT_EQ(1, GetContentRefCount(hash_file1_));
+
+  EXPECT_SUCCEEDED(package_cache.Purge(key2));
+  EXPECT_FALSE(IsContentStored(hash_file1_));
+  EXPECT_EQ(0, GetContentRefCount(hash_file1_));
+}
+
+// The keys which share contents expire on their own, and the contents are
+// deleted with the last of them.
+TEST_F(PackageCacheContentAddressedTest, PurgeExpiredSharedContents) {
+  const int kCacheLifeLimitDays = 100;
+  SetCacheTimeLimitDays(kCacheLifeLimitDays);
+
+  Key key1(_T("app1"), _T("version1"), _T("package1"));
+  Key key2(_T("app2"), _T("version2"), _T("package2"));
+  Key key3(_T("app3"), _T("version3"), _T("package3"));
+  EXPECT_SUCCEEDED(package_cache_.Put(key1, &source_file1_file_, hash_file1_));
+  EXPECT_SUCCEEDED(package_cache_.Put(key2, &source_file1_file_, hash_file1_));
+  EXPECT_SUCCEEDED(package_cache_.Put(key3, &source_file2_file_, hash_file2_));
+
+  EXPECT_HRESULT_SUCCEEDED(ExpireCache(key1));
+  package_cache_.PurgeOldPackagesIfNecessary();
+  EXPECT_FALSE(package_cache_.IsCached(key1, hash_file1_));
+  EXPECT_TRUE(package_cache_.IsCached(key2, hash_file1_));
+  EXPECT_TRUE(IsContentStored(hash_file1_));
+  EXPECT_EQ(size_file1_ + size_file2_, package_cache_.Size());
+
+  EXPECT_HRESULT_SUCCEEDED(ExpireCache(key2));
+  package_cache_.PurgeOldPackagesIfNecessary();
+  EXPECT_FALSE(package_cache_.IsCached(key2, hash_file1_));
+  EXPECT_FALSE(IsContentStored(hash_file1_));
+  EXPECT_TRUE(package_cache_.IsCached(key3, hash_file2_));
+  EXPECT_EQ(size_file2_, package_cache_.Size());
+}
+
+}  // namespace omaha
@@ -0,0 +1,269 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/peer_cache_protocol.h"
+
+#include <ctype.h>
+#include <string.h>
+
+#include "omaha/goopdate/package_cache_index.h"
+
+namespace omaha {
+
+namespace {
+
+const char kPathPrefix[] = "/sha256/";
+const char kEndOfLine[] = "\r\n";
+const char kEndOfHead[] = "\r\n\r\n";
+const char kBytesUnit[] = "bytes=";
+
+const char* GetReasonPhrase(int status) {
+  switch (status) {
+    case PeerCacheProtocol::kStatusOk:
+      return "OK";
+    case PeerCacheProtocol::kStatusPartialContent:
+      return "Partial Content";
+    case PeerCacheProtocol::kStatusBadRequest:
+      return "Bad Request";
+    case PeerCacheProtocol::kStatusNotFound:
+      return "Not Found";
+    case PeerCacheProtocol::kStatusMethodNotAllowed:
+      return "Method Not Allowed";
+    case PeerCacheProtocol::kStatusRangeNotSatisfiable:
+      return "Range Not Satisfiable";
+    default:
+      return "Error";
+  }
+}
+
+bool EqualsNoCase(const std::string& s1, const char* s2) {
+  const size_t length = strlen(s2);
+  if (s1.size() != length) {
+    return false;
+  }
+  for (size_t i = 0; i != length; ++i) {
+    if (tolower(static_cast<unsigned char>(s1[i])) !=
+        tolower(static_cast<unsigned char>(s2[i]))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::string Trim(const std::string& s) {
+  const size_t first = s.find_first_not_of(" \t");
+  if (first == std::string::npos) {
+    return std::string();
+  }
+  return s.substr(first, s.find_last_not_of(" \t") - first + 1);
+}
+
+// Parses a non-empty decimal number which fits in 63 bits.
+bool ParseNumber(const std::string& s, uint64_t* value) {
+  if (s.empty() || s.size() > 18) {
+    return false;
+  }
+  uint64_t result = 0;
+  for (size_t i = 0; i != s.size(); ++i) {
+    if (s[i] < '0' || s[i] > '9') {
+      return false;
+    }
+    result = result * 10 + (s[i] - '0');
+  }
+  *value = result;
+  return true;
+}
+
+}  // namespace
+
+std::string PeerCacheProtocol::BuildPath(const std::string& digest) {
+  const std::string normalized_digest(
+      PackageCacheIndex::NormalizeDigest(digest));
+  return normalized_digest.empty() ? std::string() :
+                                     kPathPrefix + normalized_digest;
+}
+
+size_t PeerCacheProtocol::FindEndOfHead(const std::string& data) {
+  const size_t pos = data.find(kEndOfHead);
+  return pos == std::string::npos ? 0 : pos + strlen(kEndOfHead);
+}
+
+int PeerCacheProtocol::ParseRequest(const std::string& head,
+                                    PeerCacheRequest* request) {
+  *request = PeerCacheRequest();
+
+  size_t line_end = head.find(kEndOfLine);
+  if (line_end == std::string::npos) {
+    return kStatusBadRequest;
+  }
+
+  // The request line is "<method> <path> HTTP/1.<minor>".
+  const std::string request_line(head.substr(0, line_end));
+  const size_t method_end = request_line.find(' ');
+  const size_t path_end = request_line.rfind(' ');
+  if (method_end == std::string::npos || method_end == path_end ||
+      request_line.compare(path_end + 1, 7, "HTTP/1.") ||
+      request_line.size() != path_end + 9) {
+    return kStatusBadRequest;
+  }
+
+  const std::string method(request_line.substr(0, method_end));
+  if (method == "HEAD") {
+    request->is_head = true;
+  } else if (method != "GET") {
+    return kStatusMethodNotAllowed;
+  }
+
+  const std::string path(
+      request_line.substr(method_end + 1, path_end - method_end - 1));
+  if (path.compare(0, strlen(kPathPrefix), kPathPrefix)) {
+    return kStatusNotFound;
+  }
+  request->digest = PackageCacheIndex::NormalizeDigest(
+      path.substr(strlen(kPathPrefix)));
+  if (request->digest.empty()) {
+    return kStatusNotFound;
+  }
+
+  // Only the "Range" header matters. The other headers are ignored.
+  for (size_t line_start = line_end + strlen(kEndOfLine);
+       line_start < head.size();
+       line_start = line_end + strlen(kEndOfLine)) {
+    line_end = head.find(kEndOfLine, line_start);
+    if (line_end == std::string::npos) {
+      line_end = head.size();
+    }
+    const std::string line(head.substr(line_start, line_end - line_start));
+    const size_t colon = line.find(':');
+    if (colon == std::string::npos) {
+      continue;
+    }
+    if (EqualsNoCase(Trim(line.substr(0, colon)), "Range")) {
+      if (request->has_range || !ParseRange(Trim(line.substr(colon + 1)),
+                                            request)) {
+        request->has_range = false;
+      }
+    }
+  }
+
+  return kStatusOk;
+}
+
+bool PeerCacheProtocol::ParseRange(const std::string& value,
+                                   PeerCacheRequest* request) {
+  if (value.compare(0, strlen(kBytesUnit), kBytesUnit)) {
+    return false;
+  }
+
+  const std::string range(value.substr(strlen(kBytesUnit)));
+  const size_t dash = range.find('-');
+  if (dash == std::string::npos || range.find(',') != std::string::npos) {
+    return false;
+  }
+
+  const std::string first(Trim(range.substr(0, dash)));
+  const std::string last(Trim(range.substr(dash + 1)));
+  if (first.empty()) {
+    // "-<suffix length>".
+    if (!ParseNumber(last, &request->range_last)) {
+      return false;
+    }
+    request->is_suffix_range = true;
+  } else {
+    if (!ParseNumber(first, &request->range_first)) {
+      return false;
+    }
+    if (last.empty()) {
+      request->is_open_range = true;
+    } else if (!ParseNumber(last, &request->range_last) ||
+               request->range_last < request->range_first) {
+      return false;
+    }
+  }
+
+  request->has_range = true;
+  return true;
+}
+
+int PeerCacheProtocol::ResolveRange(const PeerCacheRequest& request,
+                                    uint64_t content_size,
+                                    uint64_t* offset,
+                                    uint64_t* length) {
+  *offset = 0;
+  *length = content_size;
+  if (!request.has_range) {
+    return kStatusOk;
+  }
+
+  if (request.is_suffix_range) {
+    if (!request.range_last || !content_size) {
+      return kStatusRangeNotSatisfiable;
+    }
+    *length = request.range_last < content_size ? request.range_last :
+                                                  content_size;
+    *offset = content_size - *length;
+    return kStatusPartialContent;
+  }
+
+  if (request.range_first >= content_size) {
+    return kStatusRangeNotSatisfiable;
+  }
+
+  *offset = request.range_first;
+  const uint64_t last = request.is_open_range ||
+                        request.range_last >= content_size ?
+                        content_size - 1 : request.range_last;
+  *length = last - request.range_first + 1;
+  return kStatusPartialContent;
+}
+
+std::string PeerCacheProtocol::BuildResponseHead(int status,
+                                                 uint64_t offset,
+                                                 uint64_t length,
+                                                 uint64_t content_size) {
+  const bool has_content = status == kStatusOk ||
+                           status == kStatusPartialContent;
+
+  std::string head("HTTP/1.1 ");
+  head += std::to_string(status);
+  head += ' ';
+  head += GetReasonPhrase(status);
+  head += kEndOfLine;
+
+  head += "Content-Length: ";
+  head += std::to_string(has_content ? length : 0);
+  head += kEndOfLine;
+
+  if (has_content) {
+    head += "Content-Type: application/octet-stream\r\n";
+    head += "Accept-Ranges: bytes\r\n";
+  }
+  if (status == kStatusPartialContent) {
+    head += "Content-Range: bytes " + std::to_string(offset) + '-' +
+            std::to_string(offset + length - 1) + '/' +
+            std::to_string(content_size) + kEndOfLine;
+  } else if (status == kStatusRangeNotSatisfiable) {
+    head += "Content-Range: bytes */" + std::to_string(content_size) +
+            kEndOfLine;
+  } else if (status == kStatusMethodNotAllowed) {
+    head += "Allow: GET, HEAD\r\n";
+  }
+
+  head += "Connection: close\r\n";
+  head += kEndOfLine;
+  return head;
+}
+
+}  // namespace omaha
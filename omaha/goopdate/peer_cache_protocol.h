@@ -0,0 +1,108 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// PeerCacheProtocol parses and answers the HTTP requests which peers on the
+// local network send to a PeerCacheServer. A peer asks for the contents of
+// a package by the SHA-256 digest of the package, as in
+// "GET /sha256/<digest> HTTP/1.1", and may ask for a single byte range of
+// them. The peer verifies the package against its expected hash, therefore
+// the server does not need to be trusted.
+//
+// This file has no platform dependencies.
+
+#ifndef OMAHA_GOOPDATE_PEER_CACHE_PROTOCOL_H_
+#define OMAHA_GOOPDATE_PEER_CACHE_PROTOCOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "base/basictypes.h"
+
+namespace omaha {
+
+struct PeerCacheRequest {
+  // True for a HEAD request, which is answered without the contents.
+  bool is_head = false;
+
+  // The requested digest in lower case.
+  std::string digest;
+
+  // The byte range of the "Range: bytes=" header, if the request has one.
+  // A suffix range asks for the last |range_last| bytes. An open range has
+  // no last byte.
+  bool has_range = false;
+  bool is_suffix_range = false;
+  bool is_open_range = false;
+  uint64_t range_first = 0;
+  uint64_t range_last = 0;
+};
+
+class PeerCacheProtocol {
+ public:
+  // The HTTP status codes of the responses.
+  enum {
+    kStatusOk = 200,
+    kStatusPartialContent = 206,
+    kStatusBadRequest = 400,
+    kStatusNotFound = 404,
+    kStatusMethodNotAllowed = 405,
+    kStatusRangeNotSatisfiable = 416,
+  };
+
+  // The server does not read request heads longer than this.
+  static const size_t kMaxRequestHeadSize = 8 * 1024;
+
+  // Returns the path of the contents of |digest| on the server, or an empty
+  // string if |digest| is not a SHA-256 digest.
+  static std::string BuildPath(const std::string& digest);
+
+  // Returns the length of the request head at the start of |data|, including
+  // the empty line which ends it, or 0 if the head is not complete.
+  static size_t FindEndOfHead(const std::string& data);
+
+  // Parses a request head. Returns kStatusOk if the request asks for the
+  // contents of a digest, or the status to answer it with otherwise. A
+  // malformed or multiple byte range is ignored, as HTTP allows.
+  static int ParseRequest(const std::string& head, PeerCacheRequest* request);
+
+  // Resolves the range of |request| against the contents of |content_size|
+  // bytes. Returns kStatusOk or kStatusPartialContent and the bytes to send,
+  // or kStatusRangeNotSatisfiable.
+  static int ResolveRange(const PeerCacheRequest& request,
+                          uint64_t content_size,
+                          uint64_t* offset,
+                          uint64_t* length);
+
+  // Builds the status line and the headers of a response. |offset| and
+  // |length| are the bytes sent of the contents of |content_size| bytes.
+  // The server closes the connection after each response.
+  static std::string BuildResponseHead(int status,
+                                       uint64_t offset,
+                                       uint64_t length,
+                                       uint64_t content_size);
+
+ private:
+  // Parses the value of a "Range" header. Returns false if the value is not
+  // a single byte range.
+  static bool ParseRange(const std::string& value, PeerCacheRequest* request);
+
+  DISALLOW_IMPLICIT_CONSTRUCTORS(PeerCacheProtocol);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_GOOPDATE_PEER_CACHE_PROTOCOL_H_
@@ -0,0 +1,240 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/peer_cache_protocol.h"
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace omaha {
+
+namespace {
+
+const char kDigest[] =
+    "49b45f78865621b154fa65089f955182345a67f9746841e43e2d6daa288988d0";
+
+std::string BuildHead(const std::string& method,
+                      const std::string& range) {
+  std::string head(method + " /sha256/" + kDigest + " HTTP/1.1\r\n");
+  head += "Host: 192.168.0.10:8090\r\n";
+  if (!range.empty()) {
+    head += "Range: " + range + "\r\n";
+  }
+  head += "\r\n";
+  return head;
+}
+
+int Resolve(const std::string& range,
+            uint64_t content_size,
+            uint64_t* offset,
+            uint64_t* length) {
+  PeerCacheRequest request;
+  EXPECT_EQ(PeerCacheProtocol::kStatusOk,
+            PeerCacheProtocol::ParseRequest(BuildHead("GET", range),
+                                            &request));
+  return PeerCacheProtocol::ResolveRange(request, content_size, offset, length);
+}
+
+}  // namespace
+
+TEST(PeerCacheProtocolTest, BuildPath) {
+  EXPECT_EQ(std::string("/sha256/") + kDigest,
+            PeerCacheProtocol::BuildPath(kDigest));
+  EXPECT_EQ(std::string("/sha256/") + kDigest,
+            PeerCacheProtocol::BuildPath(
+                "49B45F78865621B154FA65089F955182345A67F9746841E43E2D6DAA288988D0"));
+  EXPECT_TRUE(PeerCacheProtocol::BuildPath("49b45f78").empty());
+  EXPECT_TRUE(PeerCacheProtocol::BuildPath("").empty());
+}
+
+TEST(PeerCacheProtocolTest, FindEndOfHead) {
+  const std::string head(BuildHead("GET", std::string()));
+  EXPECT_EQ(head.size(), PeerCacheProtocol::FindEndOfHead(head));
+  EXPECT_EQ(head.size(), PeerCacheProtocol::FindEndOfHead(head + "body"));
+  EXPECT_EQ(0, PeerCacheProtocol::FindEndOfHead(
+                   head.substr(0, head.size() - 1)));
+}
+
+TEST(PeerCacheProtocolTest, ParseRequest) {
+  PeerCacheRequest request;
+  EXPECT_EQ(PeerCacheProtocol::kStatusOk,
+            PeerCacheProtocol::ParseRequest(BuildHead("GET", std::string()),
+                                            &request));
+  EXPECT_EQ(kDigest, request.digest);
+  EXPECT_FALSE(request.is_head);
+  EXPECT_FALSE(request.has_range);
+
+  EXPECT_EQ(PeerCacheProtocol::kStatusOk,
+            PeerCacheProtocol::ParseRequest(BuildHead("HEAD", std::string()),
+                                            &request));
+  EXPECT_TRUE(request.is_head);
+
+  EXPECT_EQ(PeerCacheProtocol::kStatusMethodNotAllowed,
+            PeerCacheProtocol::ParseRequest(BuildHead("POST", std::string()),
+                                            &request));
+  EXPECT_EQ(PeerCacheProtocol::kStatusNotFound,
+            PeerCacheProtocol::ParseRequest(
+                "GET /sha256/49b45f78 HTTP/1.1\r\n\r\n", &request));
+  EXPECT_EQ(PeerCacheProtocol::kStatusNotFound,
+            PeerCacheProtocol::ParseRequest(
+                std::string("GET /md5/") + kDigest + " HTTP/1.1\r\n\r\n",
+                &request));
+  EXPECT_EQ(PeerCacheProtocol::kStatusNotFound,
+            PeerCacheProtocol::ParseRequest(
+                "GET /sha256/../../windows/win.ini HTTP/1.1\r\n\r\n",
+                &request));
+  EXPECT_EQ(PeerCacheProtocol::kStatusBadRequest,
+            PeerCacheProtocol::ParseRequest("GET\r\n\r\n", &request));
+  EXPECT_EQ(PeerCacheProtocol::kStatusBadRequest,
+            PeerCacheProtocol::ParseRequest(
+                std::string("GET /sha256/") + kDigest + " FTP/1.0\r\n\r\n",
+                &request));
+  EXPECT_EQ(PeerCacheProtocol::kStatusBadRequest,
+            PeerCacheProtocol::ParseRequest("", &request));
+}
+
+TEST(PeerCacheProtocolTest, ParseRequest_Range) {
+  PeerCacheRequest request;
+  EXPECT_EQ(PeerCacheProtocol::kStatusOk,
+            PeerCacheProtocol::ParseRequest(BuildHead("GET", "bytes=10-19"),
+                                            &request));
+  EXPECT_TRUE(request.has_range);
+  EXPECT_FALSE(request.is_suffix_range);
+  EXPECT_FALSE(request.is_open_range);
+  EXPECT_EQ(10, request.range_first);
+  EXPECT_EQ(19, request.range_last);
+
+  // The header name is not case sensitive.
+  std::string head(BuildHead("GET", std::string()));
+  head.insert(head.size() - 2, "rAnGe:bytes=5-\r\n");
+  EXPECT_EQ(PeerCacheProtocol::kStatusOk,
+            PeerCacheProtocol::ParseRequest(head, &request));
+  EXPECT_TRUE(request.has_range);
+  EXPECT_TRUE(request.is_open_range);
+  EXPECT_EQ(5, request.range_first);
+
+  EXPECT_EQ(PeerCacheProtocol::kStatusOk,
+            PeerCacheProtocol::ParseRequest(BuildHead("GET", "bytes=-100"),
+                                            &request));
+  EXPECT_TRUE(request.has_range);
+  EXPECT_TRUE(request.is_suffix_range);
+  EXPECT_EQ(100, request.range_last);
+
+  // Malformed and multiple ranges are ignored.
+  const char* const kIgnoredRanges[] = {
+    "bytes=19-10",
+    "bytes=a-b",
+    "bytes=-",
+    "bytes=0-1,5-6",
+    "items=0-1",
+    "bytes=99999999999999999999-",
+  };
+  for (size_t i = 0; i != arraysize(kIgnoredRanges); ++i) {
+    EXPECT_EQ(PeerCacheProtocol::kStatusOk,
+              PeerCacheProtocol::ParseRequest(
+                  BuildHead("GET", kIgnoredRanges[i]), &request));
+    EXPECT_FALSE(request.has_range) << kIgnoredRanges[i];
+  }
+}
+
+TEST(PeerCacheProtocolTest, ResolveRange) {
+  uint64_t offset = 0;
+  uint64_t length = 0;
+
+  EXPECT_EQ(PeerCacheProtocol::kStatusOk,
+            Resolve(std::string(), 1000, &offset, &length));
+  EXPECT_EQ(0, offset);
+  EXPECT_EQ(1000, length);
+
+  EXPECT_EQ(PeerCacheProtocol::kStatusPartialContent,
+            Resolve("bytes=10-19", 1000, &offset, &length));
+  EXPECT_EQ(10, offset);
+  EXPECT_EQ(10, length);
+
+  // The last byte is capped to the size of the contents.
+  EXPECT_EQ(PeerCacheProtocol::kStatusPartialContent,
+            Resolve("bytes=990-2000", 1000, &offset, &length));
+  EXPECT_EQ(990, offset);
+  EXPECT_EQ(10, length);
+
+  EXPECT_EQ(PeerCacheProtocol::kStatusPartialContent,
+            Resolve("bytes=400-", 1000, &offset, &length));
+  EXPECT_EQ(400, offset);
+  EXPECT_EQ(600, length);
+
+  EXPECT_EQ(PeerCacheProtocol::kStatusPartialContent,
+            Resolve("bytes=-100", 1000, &offset, &length));
+  EXPECT_EQ(900, offset);
+  EXPECT_EQ(100, length);
+
+  EXPECT_EQ(PeerCacheProtocol::kStatusPartialContent,
+            Resolve("bytes=-5000", 1000, &offset, &length));
+  EXPECT_EQ(0, offset);
+  EXPECT_EQ(1000, length);
+
+  EXPECT_EQ(PeerCacheProtocol::kStatusRangeNotSatisfiable,
+            Resolve("bytes=1000-", 1000, &offset, &length));
+  EXPECT_EQ(PeerCacheProtocol::kStatusRangeNotSatisfiable,
+            Resolve("bytes=-0", 1000, &offset, &length));
+  EXPECT_EQ(PeerCacheProtocol::kStatusRangeNotSatisfiable,
+            Resolve("bytes=0-", 0, &offset, &length));
+}
+
+TEST(PeerCacheProtocolTest, BuildResponseHead) {
+  EXPECT_EQ("HTTP/1.1 200 OK\r\n"
+            "Content-Length: 1000\r\n"
+            "Content-Type: application/octet-stream\r\n"
+            "Accept-Ranges: bytes\r\n"
+            "Connection: close\r\n"
+            "\r\n",
+            PeerCacheProtocol::BuildResponseHead(
+                PeerCacheProtocol::kStatusOk, 0, 1000, 1000));
+
+  EXPECT_EQ("HTTP/1.1 206 Partial Content\r\n"
+            "Content-Length: 10\r\n"
+            "Content-Type: application/octet-stream\r\n"
+            "Accept-Ranges: bytes\r\n"
+            "Content-Range: bytes 10-19/1000\r\n"
+            "Connection: close\r\n"
+            "\r\n",
+            PeerCacheProtocol::BuildResponseHead(
+                PeerCacheProtocol::kStatusPartialContent, 10, 10, 1000));
+
+  EXPECT_EQ("HTTP/1.1 416 Range Not Satisfiable\r\n"
+            "Content-Length: 0\r\n"
+            "Content-Range: bytes */1000\r\n"
+            "Connection: close\r\n"
+            "\r\n",
+            PeerCacheProtocol::BuildResponseHead(
+                PeerCacheProtocol::kStatusRangeNotSatisfiable, 0, 0, 1000));
+
+  EXPECT_EQ("HTTP/1.1 404 Not Found\r\n"
+            "Content-Length: 0\r\n"
+            "Connection: close\r\n"
+            "\r\n",
+            PeerCacheProtocol::BuildResponseHead(
+                PeerCacheProtocol::kStatusNotFound, 0, 0, 0));
+
+  EXPECT_EQ("HTTP/1.1 405 Method Not Allowed\r\n"
+            "Content-Length: 0\r\n"
+            "Allow: GET, HEAD\r\n"
+            "Connection: close\r\n"
+            "\r\n",
+            PeerCacheProtocol::BuildResponseHead(
+                PeerCacheProtocol::kStatusMethodNotAllowed, 0, 0, 0));
+}
+
+}  // namespace omaha
@@ -0,0 +1,360 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/peer_cache_server.h"
+
+#include <limits.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/logging.h"
+#include "omaha/base/path.h"
+#include "omaha/goopdate/peer_cache_protocol.h"
+
+namespace omaha {
+
+namespace {
+
+// A peer which does not send its request or read the response within this
+// time is disconnected.
+const DWORD kSocketTimeoutMs = 30 * 1000;
+
+const size_t kReceiveBufferSize = 1024;
+const size_t kSendBufferSize = 64 * 1024;
+
+HRESULT HRESULTFromLastSocketError() {
+  return HRESULT_FROM_WIN32(::WSAGetLastError());
+}
+
+}  // namespace
+
+struct PeerCacheServer::ConnectionContext {
+  PeerCacheServer* server;
+  SOCKET connection;
+};
+
+PeerCacheServer::PeerCacheServer(const CString& content_dir)
+    : content_dir_(content_dir),
+      is_winsock_initialized_(false),
+      listen_socket_(INVALID_SOCKET),
+      port_(0) {
+  reset(no_connections_event_, ::CreateEvent(NULL, true, true, NULL));
+}
+
+PeerCacheServer::~PeerCacheServer() {
+  Stop();
+}
+
+HRESULT PeerCacheServer::Start(int port, bool is_loopback_only) {
+  CORE_LOG(L2, (_T("[PeerCacheServer::Start][%d][%d][%s]"),
+                port, is_loopback_only, content_dir_));
+  ASSERT1(listen_socket_ == INVALID_SOCKET);
+
+  if (port < 0 || port > USHRT_MAX) {
+    return E_INVALIDARG;
+  }
+  if (!no_connections_event_) {
+    return HRESULTFromLastError();
+  }
+
+  WSADATA wsa_data = {0};
+  const int error = ::WSAStartup(MAKEWORD(2, 2), &wsa_data);
+  if (error) {
+    return HRESULT_FROM_WIN32(error);
+  }
+  is_winsock_initialized_ = true;
+
+  HRESULT hr = S_OK;
+  listen_socket_ = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (listen_socket_ == INVALID_SOCKET) {
+    hr = HRESULTFromLastSocketError();
+    Stop();
+    return hr;
+  }
+
+  // Other processes may not bind the same port to serve something else.
+  BOOL is_exclusive = TRUE;
+  ::setsockopt(listen_socket_,
+               SOL_SOCKET,
+               SO_EXCLUSIVEADDRUSE,
+               reinterpret_cast<const char*>(&is_exclusive),
+               sizeof(is_exclusive));
+
+  sockaddr_in address = {0};
+  address.sin_family = AF_INET;
+  address.sin_port = ::htons(static_cast<u_short>(port));
+  address.sin_addr.s_addr = ::htonl(is_loopback_only ? INADDR_LOOPBACK :
+                                                       INADDR_ANY);
+  int address_size = sizeof(address);
+  if (::bind(listen_socket_,
+             reinterpret_cast<const sockaddr*>(&address),
+             address_size) ||
+      ::listen(listen_socket_, SOMAXCONN) ||
+      ::getsockname(listen_socket_,
+                    reinterpret_cast<sockaddr*>(&address),
+                    &address_size)) {
+    hr = HRESULTFromLastSocketError();
+    CORE_LOG(LE, (_T("[failed to listen][%d][0x%08x]"), port, hr));
+    Stop();
+    return hr;
+  }
+  port_ = ::ntohs(address.sin_port);
+
+  if (!accept_thread_.Start(this)) {
+    hr = HRESULTFromLastError();
+    Stop();
+    return hr;
+  }
+
+  OPT_LOG(L1, (_T("[peer cache server listening][port %d]"), port_));
+  return S_OK;
+}
+
+void PeerCacheServer::Stop() {
+  if (listen_socket_ != INVALID_SOCKET) {
+    // Closing the socket fails the pending accept call.
+    ::closesocket(listen_socket_);
+    if (accept_thread_.Running()) {
+      VERIFY1(accept_thread_.WaitTillExit(INFINITE));
+    }
+    listen_socket_ = INVALID_SOCKET;
+  }
+
+  // The accept thread has exited, so that no connection is added any more.
+  __mutexBlock(lock_) {
+    for (std::set<SOCKET>::const_iterator it = connections_.begin();
+         it != connections_.end();
+         ++it) {
+      ::shutdown(*it, SD_BOTH);
+    }
+  }
+  if (no_connections_event_) {
+    VERIFY1(::WaitForSingleObject(get(no_connections_event_), INFINITE) ==
+            WAIT_OBJECT_0);
+  }
+
+  port_ = 0;
+  if (is_winsock_initialized_) {
+    VERIFY1(!::WSACleanup());
+    is_winsock_initialized_ = false;
+  }
+}
+
+int PeerCacheServer::port() const {
+  return port_;
+}
+
+void PeerCacheServer::Run() {
+  for (;;) {
+    SOCKET connection = ::accept(listen_socket_, NULL, NULL);
+    if (connection == INVALID_SOCKET) {
+      const int error = ::WSAGetLastError();
+      if (error == WSAECONNRESET) {
+        continue;
+      }
+      CORE_LOG(L2, (_T("[PeerCacheServer stopped accepting][%d]"), error));
+      return;
+    }
+
+    size_t connection_count = 0;
+    __mutexBlock(lock_) {
+      connection_count = connections_.size();
+    }
+    if (connection_count >= static_cast<size_t>(kMaxConnections)) {
+      CORE_LOG(LW, (_T("[too many peer cache connections]")));
+      ::closesocket(connection);
+      continue;
+    }
+
+    ::setsockopt(connection,
+                 SOL_SOCKET,
+                 SO_RCVTIMEO,
+                 reinterpret_cast<const char*>(&kSocketTimeoutMs),
+                 sizeof(kSocketTimeoutMs));
+    ::setsockopt(connection,
+                 SOL_SOCKET,
+                 SO_SNDTIMEO,
+                 reinterpret_cast<const char*>(&kSocketTimeoutMs),
+                 sizeof(kSocketTimeoutMs));
+
+    AddConnection(connection);
+
+    ConnectionContext* context = new ConnectionContext;
+    context->server = this;
+    context->connection = connection;
+    scoped_handle thread(
+        ::CreateThread(NULL, 0, ConnectionThreadProc, context, 0, NULL));
+    if (!thread) {
+      CORE_LOG(LE, (_T("[failed to start connection thread][0x%08x]"),
+                    HRESULTFromLastError()));
+      delete context;
+      RemoveConnection(connection);
+    }
+  }
+}
+
+DWORD WINAPI PeerCacheServer::ConnectionThreadProc(void* param) {
+  ASSERT1(param);
+  std::unique_ptr<ConnectionContext> context(
+      static_cast<ConnectionContext*>(param));
+
+  context->server->ServeConnection(context->connection);
+  context->server->RemoveConnection(context->connection);
+  return 0;
+}
+
+void PeerCacheServer::ServeConnection(SOCKET connection) {
+  std::string data;
+  size_t head_size = 0;
+  while (!(head_size = PeerCacheProtocol::FindEndOfHead(data))) {
+    if (data.size() >= PeerCacheProtocol::kMaxRequestHeadSize) {
+      SendResponseHead(connection, PeerCacheProtocol::kStatusBadRequest,
+                       0, 0, 0);
+      return;
+    }
+
+    char buffer[kReceiveBufferSize] = {0};
+    const int num_bytes = ::recv(connection, buffer, sizeof(buffer), 0);
+    if (num_bytes <= 0) {
+      return;
+    }
+    data.append(buffer, num_bytes);
+  }
+
+  PeerCacheRequest request;
+  int status = PeerCacheProtocol::ParseRequest(data.substr(0, head_size),
+                                               &request);
+  if (status == PeerCacheProtocol::kStatusOk) {
+    status = ServeRequest(connection, request);
+  } else {
+    SendResponseHead(connection, status, 0, 0, 0);
+  }
+  CORE_LOG(L3, (_T("[PeerCacheServer::ServeConnection][%S][%d]"),
+                request.digest.c_str(), status));
+
+  // The peer reads the end of the response before the connection closes.
+  ::shutdown(connection, SD_SEND);
+}
+
+int PeerCacheServer::ServeRequest(SOCKET connection,
+                                  const PeerCacheRequest& request) {
+  const CString filename(ConcatenatePath(content_dir_,
+                                         CString(request.digest.c_str())));
+
+  // The cache may delete the contents while they are served.
+  scoped_hfile file(::CreateFile(filename,
+                                 GENERIC_READ,
+                                 FILE_SHARE_READ | FILE_SHARE_DELETE,
+                                 NULL,
+                                 OPEN_EXISTING,
+                                 FILE_FLAG_SEQUENTIAL_SCAN,
+                                 NULL));
+  LARGE_INTEGER content_size = {0};
+  if (!file || !::GetFileSizeEx(get(file), &content_size)) {
+    SendResponseHead(connection, PeerCacheProtocol::kStatusNotFound, 0, 0, 0);
+    return PeerCacheProtocol::kStatusNotFound;
+  }
+
+  uint64 offset = 0;
+  uint64 length = 0;
+  const int status = PeerCacheProtocol::ResolveRange(request,
+                                                     content_size.QuadPart,
+                                                     &offset,
+                                                     &length);
+  HRESULT hr = SendResponseHead(connection, status, offset, length,
+                                content_size.QuadPart);
+  if (FAILED(hr) || request.is_head ||
+      status == PeerCacheProtocol::kStatusRangeNotSatisfiable) {
+    return status;
+  }
+
+  LARGE_INTEGER position = {0};
+  position.QuadPart = static_cast<LONGLONG>(offset);
+  if (!::SetFilePointerEx(get(file), position, NULL, FILE_BEGIN)) {
+    return status;
+  }
+
+  std::vector<char> buffer(kSendBufferSize);
+  while (length) {
+    const DWORD bytes_to_read = static_cast<DWORD>(
+        std::min(length, static_cast<uint64>(buffer.size())));
+    DWORD bytes_read = 0;
+    if (!::ReadFile(get(file), &buffer.front(), bytes_to_read, &bytes_read,
+                    NULL) || !bytes_read) {
+      CORE_LOG(LW, (_T("[failed to read contents][%s][0x%08x]"),
+                    filename, HRESULTFromLastError()));
+      break;
+    }
+    if (FAILED(Send(connection, &buffer.front(), bytes_read))) {
+      break;
+    }
+    length -= bytes_read;
+  }
+
+  return status;
+}
+
+HRESULT PeerCacheServer::SendResponseHead(SOCKET connection,
+                                          int status,
+                                          uint64 offset,
+                                          uint64 length,
+                                          uint64 content_size) {
+  const std::string head(PeerCacheProtocol::BuildResponseHead(status,
+                                                               offset,
+                                                               length,
+                                                               content_size));
+  return Send(connection, head.c_str(), head.size());
+}
+
+HRESULT PeerCacheServer::Send(SOCKET connection,
+                              const void* data,
+                              size_t length) {
+  const char* bytes = static_cast<const char*>(data);
+  while (length) {
+    const int num_bytes = ::send(connection,
+                                 bytes,
+                                 static_cast<int>(std::min<size_t>(length,
+                                                                   INT_MAX)),
+                                 0);
+    if (num_bytes == SOCKET_ERROR) {
+      return HRESULTFromLastSocketError();
+    }
+    bytes += num_bytes;
+    length -= num_bytes;
+  }
+  return S_OK;
+}
+
+void PeerCacheServer::AddConnection(SOCKET connection) {
+  __mutexScope(lock_);
+  connections_.insert(connection);
+  VERIFY1(::ResetEvent(get(no_connections_event_)));
+}
+
+void PeerCacheServer::RemoveConnection(SOCKET connection) {
+  __mutexScope(lock_);
+  connections_.erase(connection);
+  ::closesocket(connection);
+  if (connections_.empty()) {
+    VERIFY1(::SetEvent(get(no_connections_event_)));
+  }
+}
+
+}  // namespace omaha
@@ -0,0 +1,106 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// PeerCacheServer serves the packages stored by a content-addressed
+// PackageCache to the other machines of the local network over HTTP, so that
+// an office downloads a package from the internet once. The packages are
+// requested by the SHA-256 digest of their contents, as described in
+// peer_cache_protocol.h, and are read from the content directory of the
+// cache. Each connection is served on its own thread and closed after one
+// response.
+
+#ifndef OMAHA_GOOPDATE_PEER_CACHE_SERVER_H_
+#define OMAHA_GOOPDATE_PEER_CACHE_SERVER_H_
+
+#include <winsock2.h>
+#include <windows.h>
+#include <atlstr.h>
+
+#include <set>
+
+#include "base/basictypes.h"
+#include "omaha/base/synchronized.h"
+#include "omaha/base/thread.h"
+#include "omaha/third_party/smartany/scoped_any.h"
+
+namespace omaha {
+
+struct PeerCacheRequest;
+
+class PeerCacheServer : public Runnable {
+ public:
+  // At most this many connections are served at the same time. The other
+  // connections are closed when they are accepted.
+  static const int kMaxConnections = 16;
+
+  // Serves the files named by digest in |content_dir|.
+  explicit PeerCacheServer(const CString& content_dir);
+  virtual ~PeerCacheServer();
+
+  // Starts listening on |port|, or on a free port if |port| is 0. Listens on
+  // the loopback interface only if |is_loopback_only|.
+  HRESULT Start(int port, bool is_loopback_only);
+
+  // Stops listening, closes the connections, and waits for their threads to
+  // exit.
+  void Stop();
+
+  // Returns the port the server listens on, or 0 if it is not started.
+  int port() const;
+
+ private:
+  struct ConnectionContext;
+
+  // Runnable interface. Accepts the connections until the server stops.
+  virtual void Run();
+
+  static DWORD WINAPI ConnectionThreadProc(void* param);
+
+  // Reads a request from |connection| and answers it.
+  void ServeConnection(SOCKET connection);
+
+  // Answers |request|. Returns the status of the response.
+  int ServeRequest(SOCKET connection, const PeerCacheRequest& request);
+
+  // Sends the status line and the headers of a response.
+  static HRESULT SendResponseHead(SOCKET connection,
+                                  int status,
+                                  uint64 offset,
+                                  uint64 length,
+                                  uint64 content_size);
+
+  static HRESULT Send(SOCKET connection, const void* data, size_t length);
+
+  void AddConnection(SOCKET connection);
+  void RemoveConnection(SOCKET connection);
+
+  const CString content_dir_;
+  bool is_winsock_initialized_;
+  SOCKET listen_socket_;
+  int port_;
+  Thread accept_thread_;
+
+  LLock lock_;
+
+  // The connections being served. The event is set when there are none.
+  std::set<SOCKET> connections_;
+  scoped_event no_connections_event_;
+
+  DISALLOW_COPY_AND_ASSIGN(PeerCacheServer);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_GOOPDATE_PEER_CACHE_SERVER_H_
@@ -0,0 +1,159 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Serves a content directory on the loopback interface and downloads from it
+// with the WinHttp request which the download manager uses.
+
+#include "omaha/goopdate/peer_cache_server.h"
+
+#include <winhttp.h>
+
+#include <memory>
+#include <vector>
+
+#include "omaha/base/file.h"
+#include "omaha/base/path.h"
+#include "omaha/base/utils.h"
+#include "omaha/goopdate/peer_cache_protocol.h"
+#include "omaha/net/network_config.h"
+#include "omaha/net/simple_request.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+namespace {
+
+// Names the test contents. The server does not verify the contents, therefore
+// they do not need to match their name.
+const char kDigest[] =
+    "2e5f3f9e2d6f7ae1e3c6a1bb76e1ad0ed25a93b5b0f4f5d4a6e7f2f0b3e2a1c0";
+
+const char kUnknownDigest[] =
+    "0000000000000000000000000000000000000000000000000000000000000000";
+
+}  // namespace
+
+class PeerCacheServerTest : public testing::Test {
+ protected:
+  PeerCacheServerTest() {}
+
+  virtual void SetUp() {
+    content_dir_ = GetUniqueTempDirectoryName();
+    ASSERT_HRESULT_SUCCEEDED(CreateDir(content_dir_, NULL));
+
+    contents_.resize(200 * 1024);
+    for (size_t i = 0; i != contents_.size(); ++i) {
+      contents_[i] = static_cast<uint8>(i * 7);
+    }
+    File file;
+    ASSERT_HRESULT_SUCCEEDED(file.Open(
+        ConcatenatePath(content_dir_, CString(kDigest)), true, false));
+    uint32 bytes_written = 0;
+    ASSERT_HRESULT_SUCCEEDED(file.Write(&contents_.front(),
+                                        static_cast<uint32>(contents_.size()),
+                                        &bytes_written));
+    ASSERT_HRESULT_SUCCEEDED(file.Close());
+
+    server_.reset(new PeerCacheServer(content_dir_));
+    ASSERT_HRESULT_SUCCEEDED(server_->Start(0, true));
+    ASSERT_NE(0, server_->port());
+  }
+
+  virtual void TearDown() {
+    server_.reset();
+    EXPECT_HRESULT_SUCCEEDED(DeleteDirectory(content_dir_));
+  }
+
+  CString BuildUrl(const char* digest) const {
+    CString url;
+    url.Format(_T("http://127.0.0.1:%d%S"),
+               server_->port(),
+               PeerCacheProtocol::BuildPath(digest).c_str());
+    return url;
+  }
+
+  // Gets |url| with the additional |headers|. Returns the status code.
+  int Get(const CString& url,
+          const CString& headers,
+          std::vector<uint8>* response) {
+    NetworkConfig* network_config = NULL;
+    EXPECT_HRESULT_SUCCEEDED(
+        NetworkConfigManager::Instance().GetUserNetworkConfig(&network_config));
+
+    SimpleRequest simple_request;
+    simple_request.set_session_handle(
+        network_config->session().session_handle);
+    simple_request.set_url(url);
+    simple_request.set_proxy_configuration(ProxyConfig());
+    simple_request.set_additional_headers(headers);
+    EXPECT_HRESULT_SUCCEEDED(simple_request.Send());
+
+    *response = simple_request.GetResponse();
+    return simple_request.GetHttpStatusCode();
+  }
+
+  CString content_dir_;
+  std::vector<uint8> contents_;
+  std::unique_ptr<PeerCacheServer> server_;
+};
+
+TEST_F(PeerCacheServerTest, GetContents) {
+  std::vector<uint8> response;
+  EXPECT_EQ(HTTP_STATUS_OK, Get(BuildUrl(kDigest), CString(), &response));
+  EXPECT_TRUE(response == contents_);
+}
+
+TEST_F(PeerCacheServerTest, GetRange) {
+  std::vector<uint8> response;
+  EXPECT_EQ(HTTP_STATUS_PARTIAL_CONTENT,
+            Get(BuildUrl(kDigest),
+                _T("Range: bytes=1000-1999\r\n"),
+                &response));
+  EXPECT_TRUE(response == std::vector<uint8>(contents_.begin() + 1000,
+                                             contents_.begin() + 2000));
+
+  EXPECT_EQ(HTTP_STATUS_PARTIAL_CONTENT,
+            Get(BuildUrl(kDigest), _T("Range: bytes=-100\r\n"), &response));
+  EXPECT_TRUE(response == std::vector<uint8>(contents_.end() - 100,
+                                             contents_.end()));
+
+  EXPECT_EQ(PeerCacheProtocol::kStatusRangeNotSatisfiable,
+            Get(BuildUrl(kDigest),
+                _T("Range: bytes=1000000-\r\n"),
+                &response));
+  EXPECT_TRUE(response.empty());
+}
+
+TEST_F(PeerCacheServerTest, NotFound) {
+  std::vector<uint8> response;
+  EXPECT_EQ(HTTP_STATUS_NOT_FOUND,
+            Get(BuildUrl(kUnknownDigest), CString(), &response));
+
+  CString url;
+  url.Format(_T("http://127.0.0.1:%d/sha256/..%%5C_catalog"), server_->port());
+  EXPECT_EQ(HTTP_STATUS_NOT_FOUND, Get(url, CString(), &response));
+}
+
+TEST_F(PeerCacheServerTest, StopAndRestart) {
+  server_->Stop();
+  EXPECT_EQ(0, server_->port());
+
+  ASSERT_HRESULT_SUCCEEDED(server_->Start(0, true));
+  std::vector<uint8> response;
+  EXPECT_EQ(HTTP_STATUS_OK, Get(BuildUrl(kDigest), CString(), &response));
+  EXPECT_TRUE(response == contents_);
+}
+
+}  // namespace omaha
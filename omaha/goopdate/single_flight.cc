@@ -0,0 +1,139 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/single_flight.h"
+
+#include <utility>
+
+namespace omaha {
+
+// The work for a key in flight. The followers receive its progress under
+// |progress_lock|, which is distinct from the lock of the SingleFlight, so
+// that a slow follower does not block the callers for other keys.
+struct SingleFlight::Flight {
+  Flight() : is_done(false), result(0), bytes(-1), bytes_total(0),
+             next_follower_id(0) {}
+
+  // Guarded by the lock of the SingleFlight.
+  bool is_done;
+  int result;
+
+  std::mutex progress_lock;
+  int bytes;          // -1 until the work reports its progress.
+  int bytes_total;
+  std::map<int, Progress> followers;
+  int next_follower_id;
+};
+
+SingleFlight::SingleFlight() {
+}
+
+SingleFlight::~SingleFlight() {
+}
+
+int SingleFlight::Do(const std::string& key,
+                     const Work& work,
+                     const Progress& follower_progress,
+                     const IsCancelled& is_cancelled,
+                     Role* role) {
+  std::shared_ptr<Flight> flight;
+  bool is_leader = false;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    auto it = flights_.find(key);
+    if (it == flights_.end()) {
+      flight = std::make_shared<Flight>();
+      flights_[key] = flight;
+      is_leader = true;
+    } else {
+      flight = it->second;
+    }
+  }
+
+  if (is_leader) {
+    *role = ROLE_LEADER;
+    return Lead(key, flight, work);
+  }
+
+  return Follow(flight, follower_progress, is_cancelled, role);
+}
+
+int SingleFlight::Lead(const std::string& key,
+                       const std::shared_ptr<Flight>& flight,
+                       const Work& work) {
+  Flight* const f = flight.get();
+  const int result = work([f](int bytes, int bytes_total) {
+    std::lock_guard<std::mutex> lock(f->progress_lock);
+    f->bytes = bytes;
+    f->bytes_total = bytes_total;
+    for (auto it = f->followers.begin(); it != f->followers.end(); ++it) {
+      it->second(bytes, bytes_total);
+    }
+  });
+
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    flight->is_done = true;
+    flight->result = result;
+    flights_.erase(key);
+  }
+  flight_done_.notify_all();
+
+  return result;
+}
+
+int SingleFlight::Follow(const std::shared_ptr<Flight>& flight,
+                         const Progress& progress,
+                         const IsCancelled& is_cancelled,
+                         Role* role) {
+  int follower_id = -1;
+  if (progress) {
+    std::lock_guard<std::mutex> lock(flight->progress_lock);
+    follower_id = flight->next_follower_id++;
+    flight->followers[follower_id] = progress;
+    if (flight->bytes != -1) {
+      progress(flight->bytes, flight->bytes_total);
+    }
+  }
+
+  bool is_done = false;
+  int result = 0;
+  {
+    std::unique_lock<std::mutex> lock(lock_);
+    flight_done_.wait(lock, [&flight, &is_cancelled]() {
+      return flight->is_done || (is_cancelled && is_cancelled());
+    });
+    is_done = flight->is_done;
+    result = flight->result;
+  }
+
+  // Once it returns, the follower receives no more progress.
+  if (follower_id != -1) {
+    std::lock_guard<std::mutex> lock(flight->progress_lock);
+    flight->followers.erase(follower_id);
+  }
+
+  *role = is_done ? ROLE_FOLLOWER : ROLE_CANCELLED;
+  return is_done ? result : 0;
+}
+
+void SingleFlight::WakeUpWaiters() {
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+  }
+  flight_done_.notify_all();
+}
+
+}  // namespace omaha
@@ -0,0 +1,98 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// SingleFlight coalesces concurrent calls for the same key into one. The
+// first caller does the work, and the callers which arrive while it is in
+// flight wait for it, receive its progress, and share its result.
+//
+// This file has no platform dependencies.
+
+#ifndef OMAHA_GOOPDATE_SINGLE_FLIGHT_H_
+#define OMAHA_GOOPDATE_SINGLE_FLIGHT_H_
+
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "base/basictypes.h"
+
+namespace omaha {
+
+class SingleFlight {
+ public:
+  // Receives the progress of the work, as the number of bytes done out of
+  // |bytes_total|.
+  using Progress = std::function<void(int bytes, int bytes_total)>;
+
+  // Does the work and reports its progress to the followers with |progress|.
+  using Work = std::function<int(const Progress& progress)>;
+
+  // Returns true if the caller no longer waits for the work in flight.
+  using IsCancelled = std::function<bool()>;
+
+  enum Role {
+    // The caller did the work.
+    ROLE_LEADER,
+
+    // The caller shared the result of the work of another caller.
+    ROLE_FOLLOWER,
+
+    // The caller was cancelled while it waited for another caller.
+    ROLE_CANCELLED,
+  };
+
+  SingleFlight();
+  ~SingleFlight();
+
+  // Does |work| on the calling thread and returns its result, if no work for
+  // |key| is in flight. Otherwise, waits for the work in flight and returns
+  // its result, unless |is_cancelled| returns true first, in which case it
+  // returns 0. A follower receives the last progress of the work in
+  // |follower_progress| when it joins, then its progress as it happens, on
+  // the thread of the leader. |follower_progress| and |is_cancelled| may be
+  // null. Returns the role of the caller in |role|.
+  int Do(const std::string& key,
+         const Work& work,
+         const Progress& follower_progress,
+         const IsCancelled& is_cancelled,
+         Role* role);
+
+  // Wakes up the waiting callers, so that they check whether they are
+  // cancelled.
+  void WakeUpWaiters();
+
+ private:
+  struct Flight;
+
+  int Lead(const std::string& key, const std::shared_ptr<Flight>& flight,
+           const Work& work);
+  int Follow(const std::shared_ptr<Flight>& flight,
+             const Progress& progress,
+             const IsCancelled& is_cancelled,
+             Role* role);
+
+  std::mutex lock_;
+  std::condition_variable flight_done_;
+  std::map<std::string, std::shared_ptr<Flight>> flights_;
+
+  DISALLOW_COPY_AND_ASSIGN(SingleFlight);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_GOOPDATE_SINGLE_FLIGHT_H_
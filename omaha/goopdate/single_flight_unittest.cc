@@ -0,0 +1,253 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/single_flight.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace omaha {
+
+namespace {
+
+// A gate which the test opens to let the work of the leader complete.
+class Gate {
+ public:
+  Gate() : is_open_(false) {}
+
+  void Open() {
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      is_open_ = true;
+    }
+    opened_.notify_all();
+  }
+
+  void Wait() {
+    std::unique_lock<std::mutex> lock(lock_);
+    opened_.wait(lock, [this]() { return is_open_; });
+  }
+
+ private:
+  std::mutex lock_;
+  std::condition_variable opened_;
+  bool is_open_;
+
+  DISALLOW_COPY_AND_ASSIGN(Gate);
+};
+
+// Stands in for the network: counts the fetches, and blocks each one at
+// |gate| after it reports the progress of half the package.
+class Fetcher {
+ public:
+  Fetcher() : num_fetches_(0), is_fetching_(false) {}
+
+  int Fetch(Gate* gate, const SingleFlight::Progress& progress) {
+    ++num_fetches_;
+    progress(50, 100);
+    is_fetching_ = true;
+    gate->Wait();
+    progress(100, 100);
+    return 42;
+  }
+
+  void WaitUntilFetching() const {
+    while (!is_fetching_) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  int num_fetches() const { return num_fetches_; }
+
+ private:
+  std::atomic<int> num_fetches_;
+  std::atomic<bool> is_fetching_;
+
+  DISALLOW_COPY_AND_ASSIGN(Fetcher);
+};
+
+}  // namespace
+
+TEST(SingleFlightTest, SingleCaller) {
+  SingleFlight single_flight;
+  SingleFlight::Role role = SingleFlight::ROLE_CANCELLED;
+  std::vector<std::pair<int, int>> progress;
+
+  EXPECT_EQ(7, single_flight.Do(
+      "key",
+      [](const SingleFlight::Progress& report) {
+        report(1, 2);
+        return 7;
+      },
+      [&progress](int bytes, int bytes_total) {
+        progress.push_back(std::make_pair(bytes, bytes_total));
+      },
+      nullptr,
+      &role));
+  EXPECT_EQ(SingleFlight::ROLE_LEADER, role);
+
+  // The leader reports its own progress.
+  EXPECT_TRUE(progress.empty());
+
+  // The result is not kept once the work is done.
+  EXPECT_EQ(8, single_flight.Do(
+      "key",
+      [](const SingleFlight::Progress&) { return 8; },
+      nullptr,
+      nullptr,
+      &role));
+  EXPECT_EQ(SingleFlight::ROLE_LEADER, role);
+}
+
+// Concurrent callers for the same key fetch the package once, and all of
+// them receive its result. The followers receive its progress.
+TEST(SingleFlightTest, ConcurrentCallersFetchOnce) {
+  const int kNumCallers = 8;
+
+  SingleFlight single_flight;
+  Fetcher fetcher;
+  Gate gate;
+
+  std::vector<int> results(kNumCallers, 0);
+  std::vector<SingleFlight::Role> roles(kNumCallers,
+                                        SingleFlight::ROLE_CANCELLED);
+  std::atomic<int> last_bytes[kNumCallers] = {};
+
+  auto call = [&](int i) {
+    results[i] = single_flight.Do(
+        "{app}|1.0|installer.exe|hash",
+        [&fetcher, &gate](const SingleFlight::Progress& report) {
+          return fetcher.Fetch(&gate, report);
+        },
+        [&last_bytes, i](int bytes, int bytes_total) {
+          EXPECT_EQ(100, bytes_total);
+          last_bytes[i] = bytes;
+        },
+        nullptr,
+        &roles[i]);
+  };
+
+  std::vector<std::thread> threads;
+  threads.emplace_back(call, 0);
+  fetcher.WaitUntilFetching();
+  for (int i = 1; i != kNumCallers; ++i) {
+    threads.emplace_back(call, i);
+  }
+
+  // The followers join while the fetch is in flight, and receive its last
+  // progress.
+  for (int i = 1; i != kNumCallers; ++i) {
+    while (last_bytes[i] != 50) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  gate.Open();
+  for (size_t i = 0; i != threads.size(); ++i) {
+    threads[i].join();
+  }
+
+  EXPECT_EQ(1, fetcher.num_fetches());
+  EXPECT_EQ(SingleFlight::ROLE_LEADER, roles[0]);
+  EXPECT_EQ(42, results[0]);
+  for (int i = 1; i != kNumCallers; ++i) {
+    EXPECT_EQ(SingleFlight::ROLE_FOLLOWER, roles[i]);
+    EXPECT_EQ(42, results[i]);
+    EXPECT_EQ(100, last_bytes[i]);
+  }
+}
+
+TEST(SingleFlightTest, DifferentKeysFetchSeparately) {
+  SingleFlight single_flight;
+  Fetcher fetcher;
+  Gate gate;
+  SingleFlight::Role roles[2] = {SingleFlight::ROLE_CANCELLED,
+                                 SingleFlight::ROLE_CANCELLED};
+
+  auto call = [&](int i, const std::string& key) {
+    single_flight.Do(
+        key,
+        [&fetcher, &gate](const SingleFlight::Progress& report) {
+          return fetcher.Fetch(&gate, report);
+        },
+        nullptr,
+        nullptr,
+        &roles[i]);
+  };
+
+  // The same package with a different hash is a different key.
+  std::thread first(call, 0, "{app}|1.0|installer.exe|hash1");
+  std::thread second(call, 1, "{app}|1.0|installer.exe|hash2");
+  while (fetcher.num_fetches() != 2) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  gate.Open();
+  first.join();
+  second.join();
+
+  EXPECT_EQ(2, fetcher.num_fetches());
+  EXPECT_EQ(SingleFlight::ROLE_LEADER, roles[0]);
+  EXPECT_EQ(SingleFlight::ROLE_LEADER, roles[1]);
+}
+
+TEST(SingleFlightTest, CancelFollower) {
+  SingleFlight single_flight;
+  Fetcher fetcher;
+  Gate gate;
+  SingleFlight::Role leader_role = SingleFlight::ROLE_CANCELLED;
+  SingleFlight::Role follower_role = SingleFlight::ROLE_LEADER;
+  std::atomic<bool> is_follower_cancelled(false);
+  int follower_result = -1;
+
+  auto work = [&fetcher, &gate](const SingleFlight::Progress& report) {
+    return fetcher.Fetch(&gate, report);
+  };
+
+  std::thread leader([&]() {
+    single_flight.Do("key", work, nullptr, nullptr, &leader_role);
+  });
+  fetcher.WaitUntilFetching();
+
+  std::thread follower([&]() {
+    follower_result = single_flight.Do(
+        "key",
+        work,
+        nullptr,
+        [&is_follower_cancelled]() { return is_follower_cancelled.load(); },
+        &follower_role);
+  });
+
+  // The follower returns while the leader is still fetching.
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  is_follower_cancelled = true;
+  single_flight.WakeUpWaiters();
+  follower.join();
+
+  EXPECT_EQ(SingleFlight::ROLE_CANCELLED, follower_role);
+  EXPECT_EQ(0, follower_result);
+
+  gate.Open();
+  leader.join();
+  EXPECT_EQ(SingleFlight::ROLE_LEADER, leader_role);
+  EXPECT_EQ(1, fetcher.num_fetches());
+}
+
+}  // namespace omaha
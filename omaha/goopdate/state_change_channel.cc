@@ -0,0 +1,198 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/state_change_channel.h"
+
+#include <utility>
+
+namespace omaha {
+
+StateChangeChannel::StateChangeChannel()
+    : next_subscriber_id_(1),
+      is_closed_(false),
+      num_published_(0),
+      num_delivered_(0) {
+}
+
+StateChangeChannel::~StateChangeChannel() {
+}
+
+StateChangeTransport* StateChangeChannel::QueueDelta(
+    const AppStateDelta& delta,
+    Subscriber* subscriber) {
+  const auto it = subscriber->pending_index.find(delta.app_id);
+  if (it != subscriber->pending_index.end()) {
+    subscriber->pending[it->second] = delta;
+  } else {
+    subscriber->pending_index[delta.app_id] = subscriber->pending.size();
+    subscriber->pending.push_back(delta);
+  }
+
+  if (subscriber->is_signaled) {
+    return nullptr;
+  }
+  subscriber->is_signaled = true;
+  return subscriber->transport;
+}
+
+void StateChangeChannel::Publish(const std::string& app_id,
+                                 const AppStateInfo& info) {
+  std::vector<StateChangeTransport*> to_signal;
+
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    if (is_closed_) {
+      return;
+    }
+
+    AppStateDelta& app = apps_[app_id];
+    if (app.sequence && app.info == info) {
+      return;
+    }
+    app.app_id = app_id;
+    app.info = info;
+    ++app.sequence;
+    ++num_published_;
+
+    for (auto& subscriber : subscribers_) {
+      StateChangeTransport* transport = QueueDelta(app, &subscriber.second);
+      if (transport) {
+        to_signal.push_back(transport);
+      }
+    }
+  }
+
+  for (StateChangeTransport* transport : to_signal) {
+    transport->Signal();
+  }
+}
+
+int StateChangeChannel::Subscribe(StateChangeTransport* transport) {
+  int subscriber_id = 0;
+  StateChangeTransport* to_signal = nullptr;
+
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    subscriber_id = next_subscriber_id_++;
+    Subscriber& subscriber = subscribers_[subscriber_id];
+    subscriber.transport = transport;
+
+    for (const auto& app : apps_) {
+      if (QueueDelta(app.second, &subscriber)) {
+        to_signal = transport;
+      }
+    }
+    if (is_closed_ && !subscriber.is_signaled) {
+      subscriber.is_signaled = true;
+      to_signal = transport;
+    }
+  }
+
+  if (to_signal) {
+    to_signal->Signal();
+  }
+  return subscriber_id;
+}
+
+void StateChangeChannel::Unsubscribe(int subscriber_id) {
+  std::lock_guard<std::mutex> lock(lock_);
+  subscribers_.erase(subscriber_id);
+}
+
+std::vector<AppStateDelta> StateChangeChannel::TakePendingDeltas(
+    int subscriber_id) {
+  std::vector<AppStateDelta> deltas;
+
+  std::lock_guard<std::mutex> lock(lock_);
+  const auto it = subscribers_.find(subscriber_id);
+  if (it == subscribers_.end()) {
+    return deltas;
+  }
+
+  Subscriber& subscriber = it->second;
+  deltas.swap(subscriber.pending);
+  subscriber.pending_index.clear();
+  subscriber.is_signaled = false;
+  num_delivered_ += deltas.size();
+  return deltas;
+}
+
+void StateChangeChannel::Close() {
+  std::vector<StateChangeTransport*> to_signal;
+
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    if (is_closed_) {
+      return;
+    }
+    is_closed_ = true;
+
+    for (auto& subscriber : subscribers_) {
+      if (!subscriber.second.is_signaled) {
+        subscriber.second.is_signaled = true;
+        to_signal.push_back(subscriber.second.transport);
+      }
+    }
+  }
+
+  for (StateChangeTransport* transport : to_signal) {
+    transport->Signal();
+  }
+}
+
+bool StateChangeChannel::is_closed() const {
+  std::lock_guard<std::mutex> lock(lock_);
+  return is_closed_;
+}
+
+uint64_t StateChangeChannel::num_published() const {
+  std::lock_guard<std::mutex> lock(lock_);
+  return num_published_;
+}
+
+uint64_t StateChangeChannel::num_delivered() const {
+  std::lock_guard<std::mutex> lock(lock_);
+  return num_delivered_;
+}
+
+LocalStateChangeTransport::LocalStateChangeTransport()
+    : is_signaled_(false),
+      num_signals_(0) {
+}
+
+void LocalStateChangeTransport::Signal() {
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    is_signaled_ = true;
+    ++num_signals_;
+  }
+  cv_.notify_all();
+}
+
+bool LocalStateChangeTransport::Wait(std::chrono::milliseconds timeout) {
+  std::unique_lock<std::mutex> lock(lock_);
+  if (!cv_.wait_for(lock, timeout, [this] { return is_signaled_; })) {
+    return false;
+  }
+  is_signaled_ = false;
+  return true;
+}
+
+int LocalStateChangeTransport::num_signals() const {
+  std::lock_guard<std::mutex> lock(lock_);
+  return num_signals_;
+}
+
+}  // namespace omaha
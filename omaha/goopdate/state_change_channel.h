@@ -0,0 +1,163 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// StateChangeChannel pushes the state transitions of the apps in a bundle to
+// subscribers, instead of subscribers polling the state of every app.
+//
+// Publishers call Publish() each time the observable state of an app changes.
+// The channel keeps, for each subscriber, at most one pending delta per app:
+// successive changes of the same app are coalesced into the latest state until
+// the subscriber takes them. The subscriber's transport is signaled once when
+// the first delta becomes pending, and is not signaled again until the
+// subscriber calls TakePendingDeltas(). As a result, the amount of work done
+// by the publisher and the subscriber depends on how fast the subscriber
+// consumes the deltas, not on how often the apps change.
+//
+// This file has no platform dependencies. LocalStateChangeTransport is a
+// stand-in transport for subscribers in the same process, such as tests.
+
+#ifndef OMAHA_GOOPDATE_STATE_CHANGE_CHANNEL_H_
+#define OMAHA_GOOPDATE_STATE_CHANGE_CHANNEL_H_
+
+#include <stdint.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+
+namespace omaha {
+
+// The observable state of an app. The values mirror the corresponding
+// ICurrentState properties.
+struct AppStateInfo {
+  int32_t state = 0;
+  uint64_t bytes_downloaded = 0;
+  uint64_t total_bytes_to_download = 0;
+  int32_t install_progress_percentage = -1;
+  int32_t error_code = 0;
+  bool is_canceled = false;
+
+  bool operator==(const AppStateInfo& other) const {
+    return state == other.state &&
+           bytes_downloaded == other.bytes_downloaded &&
+           total_bytes_to_download == other.total_bytes_to_download &&
+           install_progress_percentage == other.install_progress_percentage &&
+           error_code == other.error_code &&
+           is_canceled == other.is_canceled;
+  }
+  bool operator!=(const AppStateInfo& other) const { return !(*this == other); }
+};
+
+struct AppStateDelta {
+  std::string app_id;
+
+  // Increases each time the state of this app is published. Subscribers can
+  // use it to tell how many changes were coalesced into this delta.
+  uint64_t sequence = 0;
+
+  AppStateInfo info;
+};
+
+// Wakes up a subscriber when deltas are pending. Signal() is called without
+// any channel lock held, and it may be called from any thread.
+class StateChangeTransport {
+ public:
+  virtual ~StateChangeTransport() {}
+  virtual void Signal() = 0;
+};
+
+class StateChangeChannel {
+ public:
+  StateChangeChannel();
+  ~StateChangeChannel();
+
+  // Records the state of the app and queues a delta for each subscriber.
+  // Publishing a state equal to the last published state is a no-op.
+  void Publish(const std::string& app_id, const AppStateInfo& info);
+
+  // Adds a subscriber and returns its id. The current state of every app is
+  // pending for a new subscriber so it starts with a consistent view. The
+  // transport must outlive the subscription.
+  int Subscribe(StateChangeTransport* transport);
+  void Unsubscribe(int subscriber_id);
+
+  // Returns the coalesced deltas queued for the subscriber since the previous
+  // call, in the order in which the apps first changed, and re-arms the signal.
+  std::vector<AppStateDelta> TakePendingDeltas(int subscriber_id);
+
+  // Closes the channel. Subscribers are signaled one last time so they can
+  // take the final deltas. Publish() is a no-op after the channel is closed.
+  void Close();
+  bool is_closed() const;
+
+  // Returns the number of Publish() calls that changed an app state, and the
+  // number of deltas delivered to subscribers.
+  uint64_t num_published() const;
+  uint64_t num_delivered() const;
+
+ private:
+  struct Subscriber {
+    StateChangeTransport* transport = nullptr;
+    bool is_signaled = false;
+    std::vector<AppStateDelta> pending;
+    std::map<std::string, size_t> pending_index;
+  };
+
+  // Queues |delta| for |subscriber|. Returns the transport to signal if the
+  // subscriber was not signaled yet, or nullptr otherwise.
+  static StateChangeTransport* QueueDelta(const AppStateDelta& delta,
+                                          Subscriber* subscriber);
+
+  mutable std::mutex lock_;
+  std::map<std::string, AppStateDelta> apps_;
+  std::map<int, Subscriber> subscribers_;
+  int next_subscriber_id_;
+  bool is_closed_;
+  uint64_t num_published_;
+  uint64_t num_delivered_;
+
+  DISALLOW_COPY_AND_ASSIGN(StateChangeChannel);
+};
+
+// Counts the signals and lets a thread wait for them.
+class LocalStateChangeTransport : public StateChangeTransport {
+ public:
+  LocalStateChangeTransport();
+
+  void Signal() override;
+
+  // Waits until the transport is signaled or |timeout| elapses. Returns true
+  // and consumes the signal if the transport was signaled.
+  bool Wait(std::chrono::milliseconds timeout);
+
+  int num_signals() const;
+
+ private:
+  mutable std::mutex lock_;
+  std::condition_variable cv_;
+  bool is_signaled_;
+  int num_signals_;
+
+  DISALLOW_COPY_AND_ASSIGN(LocalStateChangeTransport);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_GOOPDATE_STATE_CHANGE_CHANNEL_H_
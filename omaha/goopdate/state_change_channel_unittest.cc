@@ -0,0 +1,233 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/state_change_channel.h"
+
+#include <thread>
+
+#include "gtest/gtest.h"
+
+namespace omaha {
+
+namespace {
+
+const char kApp1[] = "{6762F466-8863-424f-817C-5757931F346E}";
+const char kApp2[] = "{8A0FDD16-D4B7-4167-893F-1386F2A2F0FB}";
+
+// The values of the CurrentState enum used by the tests.
+const int32_t kStateCheckingForUpdate = 2;
+const int32_t kStateDownloading = 8;
+const int32_t kStateInstallComplete = 13;
+
+AppStateInfo MakeInfo(int32_t state, uint64_t bytes_downloaded) {
+  AppStateInfo info;
+  info.state = state;
+  info.bytes_downloaded = bytes_downloaded;
+  info.total_bytes_to_download = 1000;
+  return info;
+}
+
+// Takes the deltas when it is signaled, as the transports to other processes
+// do, which re-arms the channel right away.
+class TakingTransport : public StateChangeTransport {
+ public:
+  explicit TakingTransport(StateChangeChannel* channel)
+      : channel_(channel), id_(0), num_signals_(0), num_deltas_(0) {}
+
+  void set_id(int id) { id_ = id; }
+
+  void Signal() override {
+    ++num_signals_;
+    num_deltas_ += static_cast<int>(channel_->TakePendingDeltas(id_).size());
+  }
+
+  int num_signals() const { return num_signals_; }
+  int num_deltas() const { return num_deltas_; }
+
+ private:
+  StateChangeChannel* channel_;
+  int id_;
+  int num_signals_;
+  int num_deltas_;
+
+  DISALLOW_COPY_AND_ASSIGN(TakingTransport);
+};
+
+}  // namespace
+
+TEST(StateChangeChannelTest, NewSubscriberGetsCurrentState) {
+  StateChangeChannel channel;
+  channel.Publish(kApp1, MakeInfo(kStateCheckingForUpdate, 0));
+  channel.Publish(kApp2, MakeInfo(kStateDownloading, 10));
+
+  LocalStateChangeTransport transport;
+  const int id = channel.Subscribe(&transport);
+  EXPECT_EQ(1, transport.num_signals());
+
+  std::vector<AppStateDelta> deltas = channel.TakePendingDeltas(id);
+  ASSERT_EQ(2, deltas.size());
+  EXPECT_EQ(kApp1, deltas[0].app_id);
+  EXPECT_EQ(kStateCheckingForUpdate, deltas[0].info.state);
+  EXPECT_EQ(kApp2, deltas[1].app_id);
+  EXPECT_EQ(10, deltas[1].info.bytes_downloaded);
+
+  EXPECT_TRUE(channel.TakePendingDeltas(id).empty());
+}
+
+TEST(StateChangeChannelTest, CoalescesUntilTaken) {
+  StateChangeChannel channel;
+  LocalStateChangeTransport transport;
+  const int id = channel.Subscribe(&transport);
+  EXPECT_EQ(0, transport.num_signals());
+
+  for (uint64_t bytes = 0; bytes <= 1000; bytes += 10) {
+    channel.Publish(kApp1, MakeInfo(kStateDownloading, bytes));
+  }
+  channel.Publish(kApp2, MakeInfo(kStateCheckingForUpdate, 0));
+
+  // One signal for the first delta, none for the coalesced ones.
+  EXPECT_EQ(1, transport.num_signals());
+  EXPECT_EQ(102, channel.num_published());
+
+  std::vector<AppStateDelta> deltas = channel.TakePendingDeltas(id);
+  ASSERT_EQ(2, deltas.size());
+  EXPECT_EQ(kApp1, deltas[0].app_id);
+  EXPECT_EQ(1000, deltas[0].info.bytes_downloaded);
+  EXPECT_EQ(101, deltas[0].sequence);
+  EXPECT_EQ(kApp2, deltas[1].app_id);
+  EXPECT_EQ(2, channel.num_delivered());
+
+  // Taking the deltas re-arms the signal.
+  channel.Publish(kApp1, MakeInfo(kStateInstallComplete, 1000));
+  EXPECT_EQ(2, transport.num_signals());
+  deltas = channel.TakePendingDeltas(id);
+  ASSERT_EQ(1, deltas.size());
+  EXPECT_EQ(kStateInstallComplete, deltas[0].info.state);
+}
+
+TEST(StateChangeChannelTest, IdenticalStateIsNotPublished) {
+  StateChangeChannel channel;
+  LocalStateChangeTransport transport;
+  const int id = channel.Subscribe(&transport);
+
+  channel.Publish(kApp1, MakeInfo(kStateDownloading, 10));
+  EXPECT_EQ(1, channel.TakePendingDeltas(id).size());
+
+  channel.Publish(kApp1, MakeInfo(kStateDownloading, 10));
+  EXPECT_EQ(1, channel.num_published());
+  EXPECT_EQ(1, transport.num_signals());
+  EXPECT_TRUE(channel.TakePendingDeltas(id).empty());
+}
+
+TEST(StateChangeChannelTest, SubscribersAreIndependent) {
+  StateChangeChannel channel;
+  LocalStateChangeTransport transport1;
+  LocalStateChangeTransport transport2;
+  const int id1 = channel.Subscribe(&transport1);
+  const int id2 = channel.Subscribe(&transport2);
+
+  channel.Publish(kApp1, MakeInfo(kStateDownloading, 10));
+  EXPECT_EQ(1, channel.TakePendingDeltas(id1).size());
+
+  channel.Publish(kApp1, MakeInfo(kStateDownloading, 20));
+  EXPECT_EQ(2, transport1.num_signals());
+  EXPECT_EQ(1, transport2.num_signals());
+
+  std::vector<AppStateDelta> deltas = channel.TakePendingDeltas(id2);
+  ASSERT_EQ(1, deltas.size());
+  EXPECT_EQ(20, deltas[0].info.bytes_downloaded);
+
+  channel.Unsubscribe(id1);
+  channel.Publish(kApp1, MakeInfo(kStateDownloading, 30));
+  EXPECT_EQ(2, transport1.num_signals());
+  EXPECT_TRUE(channel.TakePendingDeltas(id1).empty());
+  EXPECT_EQ(1, channel.TakePendingDeltas(id2).size());
+}
+
+TEST(StateChangeChannelTest, CloseSignalsSubscribers) {
+  StateChangeChannel channel;
+  LocalStateChangeTransport transport;
+  const int id = channel.Subscribe(&transport);
+
+  channel.Close();
+  EXPECT_TRUE(channel.is_closed());
+  EXPECT_EQ(1, transport.num_signals());
+
+  channel.Publish(kApp1, MakeInfo(kStateDownloading, 10));
+  EXPECT_TRUE(channel.TakePendingDeltas(id).empty());
+  EXPECT_EQ(0, channel.num_published());
+}
+
+// The subscriber thread wakes up only when there are deltas, and sees the
+// final state of each app regardless of how many changes were coalesced.
+TEST(StateChangeChannelTest, ConcurrentPublisher) {
+  const int kNumUpdates = 10000;
+
+  StateChangeChannel channel;
+  LocalStateChangeTransport transport;
+  const int id = channel.Subscribe(&transport);
+
+  std::thread publisher([&channel]() {
+    for (int i = 1; i <= kNumUpdates; ++i) {
+      channel.Publish(kApp1, MakeInfo(kStateDownloading, i));
+      channel.Publish(kApp2, MakeInfo(kStateDownloading, i / 2));
+    }
+    channel.Publish(kApp1, MakeInfo(kStateInstallComplete, kNumUpdates));
+    channel.Close();
+  });
+
+  AppStateInfo last_app1;
+  int num_wakeups = 0;
+  while (!channel.is_closed() || last_app1.state != kStateInstallComplete) {
+    if (!transport.Wait(std::chrono::seconds(10))) {
+      break;
+    }
+    ++num_wakeups;
+    for (const auto& delta : channel.TakePendingDeltas(id)) {
+      if (delta.app_id == kApp1) {
+        EXPECT_GE(delta.info.bytes_downloaded, last_app1.bytes_downloaded);
+        last_app1 = delta.info;
+      }
+    }
+  }
+  publisher.join();
+
+  EXPECT_EQ(kStateInstallComplete, last_app1.state);
+  EXPECT_EQ(kNumUpdates, last_app1.bytes_downloaded);
+  EXPECT_LE(num_wakeups, transport.num_signals());
+  EXPECT_LE(channel.num_delivered(), channel.num_published());
+}
+
+TEST(StateChangeChannelTest, TransportTakesDeltasWhenSignaled) {
+  StateChangeChannel channel;
+  channel.Publish(kApp1, MakeInfo(kStateCheckingForUpdate, 0));
+
+  // The subscriber id is not known yet when Subscribe() signals, so the
+  // subscriber signals itself again once subscribed.
+  TakingTransport transport(&channel);
+  transport.set_id(channel.Subscribe(&transport));
+  EXPECT_EQ(1, transport.num_signals());
+  EXPECT_EQ(0, transport.num_deltas());
+  transport.Signal();
+  EXPECT_EQ(1, transport.num_deltas());
+
+  channel.Publish(kApp1, MakeInfo(kStateDownloading, 10));
+  channel.Publish(kApp1, MakeInfo(kStateDownloading, 20));
+  channel.Publish(kApp2, MakeInfo(kStateDownloading, 10));
+  EXPECT_EQ(5, transport.num_signals());
+  EXPECT_EQ(4, transport.num_deltas());
+}
+
+}  // namespace omaha
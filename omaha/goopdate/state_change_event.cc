@@ -0,0 +1,80 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/state_change_event.h"
+
+#include <vector>
+
+#include "omaha/base/const_object_names.h"
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/logging.h"
+#include "omaha/base/utils.h"
+
+namespace omaha {
+
+StateChangeEvent::StateChangeEvent()
+    : channel_(NULL),
+      subscriber_id_(0) {
+}
+
+StateChangeEvent::~StateChangeEvent() {
+  if (channel_) {
+    channel_->Unsubscribe(subscriber_id_);
+  }
+}
+
+HRESULT StateChangeEvent::Initialize(bool is_machine,
+                                     const CString& session_id,
+                                     StateChangeChannel* channel) {
+  ASSERT1(!session_id.IsEmpty());
+  ASSERT1(channel);
+  ASSERT1(!channel_);
+
+  CString event_name(kBundleStateChangeEventPrefix);
+  event_name += session_id;
+
+  NamedObjectAttributes attr;
+  GetNamedObjectAttributes(event_name, is_machine, &attr);
+  // Manual reset=false and signaled=false, so that the signals coalesce until
+  // the client wakes up.
+  reset(event_, ::CreateEvent(&attr.sa, false, false, attr.name));
+  if (!event_) {
+    const HRESULT hr = HRESULTFromLastError();
+    CORE_LOG(LE, (_T("[failed to create state change event][0x%x][%s]"),
+                  hr, attr.name));
+    return hr;
+  }
+
+  channel_ = channel;
+  subscriber_id_ = channel_->Subscribe(this);
+
+  // Subscribe() may signal the current states before the subscriber id is
+  // known, so the channel is re-armed here.
+  Signal();
+  return S_OK;
+}
+
+void StateChangeEvent::Signal() {
+  ASSERT1(channel_);
+
+  const std::vector<AppStateDelta> deltas(
+      channel_->TakePendingDeltas(subscriber_id_));
+  CORE_LOG(L6, (_T("[StateChangeEvent::Signal][%Iu deltas]"), deltas.size()));
+
+  VERIFY1(::SetEvent(get(event_)));
+}
+
+}  // namespace omaha
@@ -0,0 +1,61 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// StateChangeEvent is the transport of a StateChangeChannel to a client in
+// another process. It subscribes to the channel and signals a named event,
+// which the client waits on, each time deltas are pending. The client then
+// reads the states of the apps through the COM interfaces.
+//
+// The event is auto-reset, so the deltas published while the client has not
+// woken up yet are coalesced into a single wake up.
+
+#ifndef OMAHA_GOOPDATE_STATE_CHANGE_EVENT_H_
+#define OMAHA_GOOPDATE_STATE_CHANGE_EVENT_H_
+
+#include <windows.h>
+#include <atlstr.h>
+
+#include "base/basictypes.h"
+#include "omaha/goopdate/state_change_channel.h"
+#include "omaha/third_party/smartany/scoped_any.h"
+
+namespace omaha {
+
+class StateChangeEvent : public StateChangeTransport {
+ public:
+  StateChangeEvent();
+  virtual ~StateChangeEvent();
+
+  // Creates the event named by |session_id| and subscribes to |channel|,
+  // which must outlive this object.
+  HRESULT Initialize(bool is_machine,
+                     const CString& session_id,
+                     StateChangeChannel* channel);
+
+  // Takes the pending deltas, which re-arms the channel, and signals the
+  // event.
+  virtual void Signal();
+
+ private:
+  StateChangeChannel* channel_;
+  int subscriber_id_;
+  scoped_event event_;
+
+  DISALLOW_COPY_AND_ASSIGN(StateChangeEvent);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_GOOPDATE_STATE_CHANGE_EVENT_H_
@@ -220,6 +220,15 @@ HRESULT BuildApp(const xml::UpdateResponse* update_response,
     if (FAILED(hr)) {
       return hr;
     }
+
+    if (!package.name_diff.IsEmpty() &&
+        package.size_diff > 0 &&
+        !package.hash_sha256_diff.IsEmpty()) {
+      next_version->GetPackage(next_version->GetNumberOfPackages() - 1)->
+          SetDiffFileInfo(package.name_diff,
+                          package.size_diff,
+                          package.hash_sha256_diff);
+    }
   }
 
   if (!app->untrusted_data().IsEmpty()) {
@@ -0,0 +1,252 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/verification_cache.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <system_error>
+
+#include "omaha/base/record_io.h"
+#include "omaha/base/security/hmac.h"
+#include "omaha/base/security/util.h"
+
+namespace omaha {
+
+namespace {
+
+std::string ToLower(const std::string& value) {
+  std::string lower(value);
+  std::transform(lower.begin(), lower.end(), lower.begin(),
+                 [](char c) { return static_cast<char>(::tolower(c)); });
+  return lower;
+}
+
+}  // namespace
+
+const char VerificationCache::kMagic[4] = {'O', 'V', 'C', '1'};
+
+VerificationCache::VerificationCache(const std::string& key,
+                                     const Options& options,
+                                     const Clock& clock)
+    : key_(key), options_(options), clock_(clock) {
+}
+
+VerificationCache::~VerificationCache() {
+}
+
+std::string VerificationCache::GenerateKey() {
+  std::random_device random;
+  std::string key;
+  while (key.size() < kKeySize) {
+    const uint32_t value = random();
+    AppendUint(value, std::min<size_t>(4, kKeySize - key.size()), &key);
+  }
+  return key;
+}
+
+bool VerificationCache::Verify(const std::string& digest,
+                               uint64_t size,
+                               const Verifier& verifier,
+                               std::string* signer) {
+  const Key key(ToLower(digest), size);
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    auto it = entries_.find(key);
+    if (it != entries_.end()) {
+      if (IsValid(it->second, clock_())) {
+        ++counters_.hits;
+        if (signer) {
+          *signer = it->second.signer;
+        }
+        return true;
+      }
+      entries_.erase(it);
+    }
+    ++counters_.misses;
+  }
+
+  Entry entry;
+  if (!verifier(&entry.signer, &entry.not_after_100ns)) {
+    std::lock_guard<std::mutex> lock(lock_);
+    ++counters_.failures;
+    return false;
+  }
+  if (signer) {
+    *signer = entry.signer;
+  }
+
+  entry.verified_100ns = clock_();
+  entry.policy_version = options_.policy_version;
+  if (entry.signer.size() > kMaxRecordStringLength ||
+      key.first.size() > kMaxRecordStringLength ||
+      !IsValid(entry, entry.verified_100ns)) {
+    return true;
+  }
+
+  std::lock_guard<std::mutex> lock(lock_);
+  entries_[key] = entry;
+  Trim();
+  return true;
+}
+
+std::string VerificationCache::Serialize() const {
+  std::lock_guard<std::mutex> lock(lock_);
+
+  std::string contents(kMagic, sizeof(kMagic));
+  AppendUint(entries_.size(), 4, &contents);
+  for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+    AppendString(it->first.first, &contents);
+    AppendString(it->second.signer, &contents);
+    AppendUint(it->first.second, 8, &contents);
+    AppendUint(it->second.verified_100ns, 8, &contents);
+    AppendUint(it->second.not_after_100ns, 8, &contents);
+    AppendUint(it->second.policy_version, 4, &contents);
+  }
+  contents.append(Mac(contents.data(), contents.size()));
+  return contents;
+}
+
+bool VerificationCache::Parse(const std::string& contents) {
+  if (contents.size() < sizeof(kMagic) + kMacSize ||
+      memcmp(contents.data(), kMagic, sizeof(kMagic)) != 0) {
+    return false;
+  }
+
+  const size_t checked_size = contents.size() - kMacSize;
+  const std::string mac(Mac(contents.data(), checked_size));
+  if (ct_memeq(mac.data(), contents.data() + checked_size, kMacSize)) {
+    return false;
+  }
+
+  RecordReader reader(contents.data() + sizeof(kMagic),
+                      checked_size - sizeof(kMagic));
+  uint64_t count = 0;
+  if (!reader.ReadUint(4, &count)) {
+    return false;
+  }
+
+  std::map<Key, Entry> entries;
+  for (uint64_t i = 0; i != count; ++i) {
+    Key key;
+    Entry entry;
+    uint64_t verified = 0;
+    uint64_t not_after = 0;
+    uint64_t policy_version = 0;
+    if (!reader.ReadString(&key.first) ||
+        !reader.ReadString(&entry.signer) ||
+        !reader.ReadUint(8, &key.second) ||
+        !reader.ReadUint(8, &verified) ||
+        !reader.ReadUint(8, &not_after) ||
+        !reader.ReadUint(4, &policy_version)) {
+      return false;
+    }
+    entry.verified_100ns = static_cast<int64_t>(verified);
+    entry.not_after_100ns = static_cast<int64_t>(not_after);
+    entry.policy_version = static_cast<uint32_t>(policy_version);
+    entries[key] = entry;
+  }
+  if (reader.remaining()) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(lock_);
+  entries_.swap(entries);
+  Trim();
+  return true;
+}
+
+bool VerificationCache::Load(const std::filesystem::path& path) {
+  std::ifstream file(path, std::ios::in | std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  const std::string contents((std::istreambuf_iterator<char>(file)),
+                             std::istreambuf_iterator<char>());
+  return !file.bad() && Parse(contents);
+}
+
+bool VerificationCache::Save(const std::filesystem::path& path) const {
+  const std::string contents(Serialize());
+
+  std::error_code error;
+  std::filesystem::path temp_path(path);
+  temp_path += ".tmp";
+  {
+    std::ofstream file(temp_path,
+                       std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file) {
+      return false;
+    }
+    file.write(contents.data(), contents.size());
+    file.flush();
+    if (!file.good()) {
+      file.close();
+      std::filesystem::remove(temp_path, error);
+      return false;
+    }
+  }
+
+  std::filesystem::rename(temp_path, path, error);
+  if (error) {
+    std::filesystem::remove(temp_path, error);
+    return false;
+  }
+  return true;
+}
+
+VerificationCache::Counters VerificationCache::GetCounters() const {
+  std::lock_guard<std::mutex> lock(lock_);
+  return counters_;
+}
+
+size_t VerificationCache::size() const {
+  std::lock_guard<std::mutex> lock(lock_);
+  return entries_.size();
+}
+
+bool VerificationCache::IsValid(const Entry& entry, int64_t now_100ns) const {
+  return entry.policy_version == options_.policy_version &&
+         now_100ns < entry.not_after_100ns &&
+         now_100ns >= entry.verified_100ns &&
+         now_100ns - entry.verified_100ns < options_.max_age_100ns;
+}
+
+void VerificationCache::Trim() {
+  while (entries_.size() > options_.max_entries) {
+    auto oldest = entries_.begin();
+    for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+      if (it->second.verified_100ns < oldest->second.verified_100ns) {
+        oldest = it;
+      }
+    }
+    entries_.erase(oldest);
+  }
+}
+
+std::string VerificationCache::Mac(const char* data, size_t size) const {
+  LITE_HMAC_CTX hmac;
+  HMAC_SHA256_init(&hmac, key_.data(), static_cast<unsigned int>(key_.size()));
+  HMAC_update(&hmac, data, size);
+  return std::string(reinterpret_cast<const char*>(HMAC_final(&hmac)),
+                     kMacSize);
+}
+
+}  // namespace omaha
@@ -0,0 +1,154 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// VerificationCache remembers the contents whose signature was verified, by
+// the SHA-256 digest and the size of the contents, so that the signature of
+// the same contents is not verified again each time they are cached or
+// installed. Each entry records the signer, the time of the verification, the
+// end of the validity of the signing certificate, and the version of the
+// verification policy. An entry is no longer used once the certificate
+// expires, once it is older than the maximum age, or once the policy version
+// changes, for instance when the pinned certificates change. Failed
+// verifications are not recorded.
+//
+// The cache file contains:
+//   magic      4 bytes     kMagic.
+//   count      4 bytes     Little-endian number of entries.
+//   entries    For each entry: the digest and the signer, each of them
+//              prefixed by its 2-byte little-endian length, then the size,
+//              the time of the verification and the end of the validity of
+//              the certificate in 100ns units as 8 bytes each, and the policy
+//              version as 4 bytes.
+//   mac        32 bytes    The HMAC-SHA256 of the fields above.
+// The HMAC key is a secret of the caller, so that the entries cannot be
+// forged or changed by someone who can write the file but does not hold the
+// key. A file which fails its HMAC is discarded, and the signatures are
+// verified again.
+//
+// This file has no platform dependencies.
+
+#ifndef OMAHA_GOOPDATE_VERIFICATION_CACHE_H_
+#define OMAHA_GOOPDATE_VERIFICATION_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "base/basictypes.h"
+
+namespace omaha {
+
+class VerificationCache {
+ public:
+  struct Entry {
+    std::string signer;
+    int64_t verified_100ns = 0;
+    int64_t not_after_100ns = 0;
+    uint32_t policy_version = 0;
+  };
+
+  struct Options {
+    // The version of the rules the signatures are verified with.
+    uint32_t policy_version = 1;
+
+    // Bounds how long a revocation of the certificate goes unnoticed.
+    int64_t max_age_100ns = 7LL * 24 * 60 * 60 * 10000000;
+
+    // The oldest entries are evicted beyond this many entries.
+    size_t max_entries = 256;
+  };
+
+  struct Counters {
+    int hits = 0;
+    int misses = 0;
+    int failures = 0;
+  };
+
+  // Verifies the signature of the contents. Returns false if the signature is
+  // not valid. Otherwise returns the signer and the end of the validity of
+  // the signing certificate.
+  typedef std::function<bool(std::string* signer,
+                             int64_t* not_after_100ns)> Verifier;
+
+  // Returns the current time in 100ns units.
+  typedef std::function<int64_t()> Clock;
+
+  static const char kMagic[4];
+  static const size_t kKeySize = 32;
+  static const size_t kMacSize = 32;
+
+  VerificationCache(const std::string& key,
+                    const Options& options,
+                    const Clock& clock);
+  ~VerificationCache();
+
+  // Returns a random key for a new cache.
+  static std::string GenerateKey();
+
+  // Returns true if the contents of |size| bytes with |digest| have a valid
+  // signature, from the entry of the contents if it is still valid, or else
+  // from |verifier|, in which case the entry is recorded. |verifier| is
+  // called without holding the lock of the cache.
+  bool Verify(const std::string& digest,
+              uint64_t size,
+              const Verifier& verifier,
+              std::string* signer);
+
+  std::string Serialize() const;
+
+  // Returns false and leaves the cache unchanged if |contents| is not a valid
+  // cache or fails its HMAC.
+  bool Parse(const std::string& contents);
+
+  // Reads the cache at |path|. Returns false if the file does not exist or
+  // is not a valid cache.
+  bool Load(const std::filesystem::path& path);
+
+  // Atomically replaces the cache at |path|.
+  bool Save(const std::filesystem::path& path) const;
+
+  Counters GetCounters() const;
+  size_t size() const;
+
+ private:
+  typedef std::pair<std::string, uint64_t> Key;
+
+  bool IsValid(const Entry& entry, int64_t now_100ns) const;
+
+  // Evicts the entries verified first, beyond the maximum number of entries.
+  void Trim();
+
+  std::string Mac(const char* data, size_t size) const;
+
+  const std::string key_;
+  const Options options_;
+  const Clock clock_;
+
+  mutable std::mutex lock_;
+  std::map<Key, Entry> entries_;
+  Counters counters_;
+
+  DISALLOW_COPY_AND_ASSIGN(VerificationCache);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_GOOPDATE_VERIFICATION_CACHE_H_
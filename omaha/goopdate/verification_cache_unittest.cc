@@ -0,0 +1,254 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/verification_cache.h"
+
+#include <ctype.h>
+
+#include <filesystem>
+#include <memory>
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace omaha {
+
+namespace {
+
+const int64_t kDay = 24LL * 60 * 60 * 10000000;
+const char kDigest[] =
+    "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855";
+const char kSigner[] = "Google LLC";
+
+// Counts the verifications and returns a configurable result.
+class FakeVerifier {
+ public:
+  FakeVerifier() : num_calls_(0), is_valid_(true), not_after_100ns_(0) {}
+
+  VerificationCache::Verifier verifier() {
+    return [this](std::string* signer, int64_t* not_after_100ns) {
+      ++num_calls_;
+      *signer = kSigner;
+      *not_after_100ns = not_after_100ns_;
+      return is_valid_;
+    };
+  }
+
+  int num_calls() const { return num_calls_; }
+  void set_is_valid(bool is_valid) { is_valid_ = is_valid; }
+  void set_not_after(int64_t not_after_100ns) {
+    not_after_100ns_ = not_after_100ns;
+  }
+
+ private:
+  int num_calls_;
+  bool is_valid_;
+  int64_t not_after_100ns_;
+};
+
+class VerificationCacheTest : public testing::Test {
+ protected:
+  VerificationCacheTest()
+      : key_(VerificationCache::GenerateKey()),
+        now_(1000 * kDay) {
+    verifier_.set_not_after(now_ + 365 * kDay);
+  }
+
+  std::unique_ptr<VerificationCache> CreateCache(
+      const VerificationCache::Options& options) {
+    return std::unique_ptr<VerificationCache>(
+        new VerificationCache(key_, options, [this]() { return now_; }));
+  }
+
+  bool Verify(VerificationCache* cache, const std::string& digest) {
+    std::string signer;
+    const bool is_valid =
+        cache->Verify(digest, 100, verifier_.verifier(), &signer);
+    EXPECT_EQ(is_valid ? kSigner : "", signer);
+    return is_valid;
+  }
+
+  const std::string key_;
+  int64_t now_;
+  FakeVerifier verifier_;
+};
+
+}  // namespace
+
+TEST_F(VerificationCacheTest, RepeatVerificationIsCached) {
+  std::unique_ptr<VerificationCache> cache(
+      CreateCache(VerificationCache::Options()));
+
+  EXPECT_TRUE(Verify(cache.get(), kDigest));
+  EXPECT_TRUE(Verify(cache.get(), kDigest));
+  EXPECT_EQ(1, verifier_.num_calls());
+
+  // The digest is not case sensitive, but the size is part of the key.
+  std::string upper_digest(kDigest);
+  for (size_t i = 0; i != upper_digest.size(); ++i) {
+    upper_digest[i] = static_cast<char>(::toupper(upper_digest[i]));
+  }
+  EXPECT_TRUE(Verify(cache.get(), upper_digest));
+  EXPECT_EQ(1, verifier_.num_calls());
+
+  std::string signer;
+  EXPECT_TRUE(cache->Verify(kDigest, 101, verifier_.verifier(), &signer));
+  EXPECT_EQ(2, verifier_.num_calls());
+
+  const VerificationCache::Counters counters = cache->GetCounters();
+  EXPECT_EQ(2, counters.hits);
+  EXPECT_EQ(2, counters.misses);
+  EXPECT_EQ(0, counters.failures);
+  EXPECT_EQ(2u, cache->size());
+}
+
+TEST_F(VerificationCacheTest, FailureIsNotCached) {
+  std::unique_ptr<VerificationCache> cache(
+      CreateCache(VerificationCache::Options()));
+
+  verifier_.set_is_valid(false);
+  EXPECT_FALSE(Verify(cache.get(), kDigest));
+  EXPECT_FALSE(Verify(cache.get(), kDigest));
+  EXPECT_EQ(2, verifier_.num_calls());
+  EXPECT_EQ(2, cache->GetCounters().failures);
+  EXPECT_EQ(0u, cache->size());
+
+  verifier_.set_is_valid(true);
+  EXPECT_TRUE(Verify(cache.get(), kDigest));
+  EXPECT_EQ(3, verifier_.num_calls());
+}
+
+TEST_F(VerificationCacheTest, CertificateExpires) {
+  std::unique_ptr<VerificationCache> cache(
+      CreateCache(VerificationCache::Options()));
+
+  verifier_.set_not_after(now_ + kDay);
+  EXPECT_TRUE(Verify(cache.get(), kDigest));
+  EXPECT_TRUE(Verify(cache.get(), kDigest));
+  EXPECT_EQ(1, verifier_.num_calls());
+
+  now_ += kDay;
+  EXPECT_TRUE(Verify(cache.get(), kDigest));
+  EXPECT_EQ(2, verifier_.num_calls());
+
+  // A certificate which is already expired is not cached.
+  EXPECT_EQ(0u, cache->size());
+}
+
+TEST_F(VerificationCacheTest, EntryExpires) {
+  VerificationCache::Options options;
+  options.max_age_100ns = 2 * kDay;
+  std::unique_ptr<VerificationCache> cache(CreateCache(options));
+
+  EXPECT_TRUE(Verify(cache.get(), kDigest));
+  now_ += 2 * kDay - 1;
+  EXPECT_TRUE(Verify(cache.get(), kDigest));
+  EXPECT_EQ(1, verifier_.num_calls());
+
+  now_ += 1;
+  EXPECT_TRUE(Verify(cache.get(), kDigest));
+  EXPECT_EQ(2, verifier_.num_calls());
+
+  // The entry is not used if the clock goes back before the verification.
+  now_ -= 1;
+  EXPECT_TRUE(Verify(cache.get(), kDigest));
+  EXPECT_EQ(3, verifier_.num_calls());
+}
+
+TEST_F(VerificationCacheTest, PolicyVersionChanges) {
+  VerificationCache::Options options;
+  std::unique_ptr<VerificationCache> cache(CreateCache(options));
+  EXPECT_TRUE(Verify(cache.get(), kDigest));
+
+  options.policy_version = 2;
+  std::unique_ptr<VerificationCache> new_cache(CreateCache(options));
+  ASSERT_TRUE(new_cache->Parse(cache->Serialize()));
+  EXPECT_EQ(1u, new_cache->size());
+
+  EXPECT_TRUE(Verify(new_cache.get(), kDigest));
+  EXPECT_TRUE(Verify(new_cache.get(), kDigest));
+  EXPECT_EQ(2, verifier_.num_calls());
+}
+
+TEST_F(VerificationCacheTest, SaveAndLoad) {
+  const std::filesystem::path path =
+      std::filesystem::temp_directory_path() / "verification_cache_test";
+  std::filesystem::remove(path);
+
+  std::unique_ptr<VerificationCache> cache(
+      CreateCache(VerificationCache::Options()));
+  EXPECT_FALSE(cache->Load(path));
+  EXPECT_TRUE(Verify(cache.get(), kDigest));
+  ASSERT_TRUE(cache->Save(path));
+
+  std::unique_ptr<VerificationCache> loaded_cache(
+      CreateCache(VerificationCache::Options()));
+  ASSERT_TRUE(loaded_cache->Load(path));
+  EXPECT_TRUE(Verify(loaded_cache.get(), kDigest));
+  EXPECT_EQ(1, verifier_.num_calls());
+  EXPECT_EQ(cache->Serialize(), loaded_cache->Serialize());
+
+  std::filesystem::remove(path);
+}
+
+TEST_F(VerificationCacheTest, TamperedCacheIsRejected) {
+  std::unique_ptr<VerificationCache> cache(
+      CreateCache(VerificationCache::Options()));
+  EXPECT_TRUE(Verify(cache.get(), kDigest));
+  const std::string contents(cache->Serialize());
+
+  std::unique_ptr<VerificationCache> other_cache(
+      CreateCache(VerificationCache::Options()));
+  EXPECT_TRUE(other_cache->Parse(contents));
+
+  // Each byte of the file is covered by the HMAC.
+  for (size_t i = 0; i != contents.size(); ++i) {
+    std::string tampered(contents);
+    tampered[i] ^= 0x01;
+    EXPECT_FALSE(other_cache->Parse(tampered)) << i;
+  }
+  EXPECT_FALSE(other_cache->Parse(contents.substr(0, contents.size() - 1)));
+  EXPECT_FALSE(other_cache->Parse(contents + '\0'));
+  EXPECT_FALSE(other_cache->Parse(std::string()));
+
+  // The entries cannot be forged without the key.
+  VerificationCache keyless_cache(VerificationCache::GenerateKey(),
+                                  VerificationCache::Options(),
+                                  [this]() { return now_; });
+  EXPECT_FALSE(keyless_cache.Parse(contents));
+  EXPECT_EQ(0u, keyless_cache.size());
+}
+
+TEST_F(VerificationCacheTest, OldestEntriesAreEvicted) {
+  VerificationCache::Options options;
+  options.max_entries = 2;
+  std::unique_ptr<VerificationCache> cache(CreateCache(options));
+
+  EXPECT_TRUE(Verify(cache.get(), "01"));
+  now_ += 1;
+  EXPECT_TRUE(Verify(cache.get(), "02"));
+  now_ += 1;
+  EXPECT_TRUE(Verify(cache.get(), "03"));
+  EXPECT_EQ(2u, cache->size());
+  EXPECT_EQ(3, verifier_.num_calls());
+
+  EXPECT_TRUE(Verify(cache.get(), "02"));
+  EXPECT_TRUE(Verify(cache.get(), "03"));
+  EXPECT_EQ(3, verifier_.num_calls());
+  EXPECT_TRUE(Verify(cache.get(), "01"));
+  EXPECT_EQ(4, verifier_.num_calls());
+}
+
+}  // namespace omaha
@@ -19,6 +19,8 @@
 #include <atlbase.h>
 #include <atlstr.h>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "omaha/base/app_util.h"
 #include "omaha/base/const_object_names.h"
@@ -49,6 +51,7 @@
 #include "omaha/goopdate/download_manager.h"
 #include "omaha/goopdate/goopdate.h"
 #include "omaha/goopdate/install_manager.h"
+#include "omaha/goopdate/install_pipeline.h"
 #include "omaha/goopdate/model.h"
 #include "omaha/goopdate/offline_utils.h"
 #include "omaha/goopdate/server_resource.h"
@@ -57,9 +60,24 @@
 #include "omaha/goopdate/update_response_utils.h"
 #include "omaha/goopdate/worker_metrics.h"
 #include "omaha/goopdate/worker_utils.h"
+#include "omaha/net/host_health.h"
+#include "omaha/third_party/smartany/scoped_any.h"
 
 namespace omaha {
 
+namespace {
+
+// Work items of the bundles the client did not lower the priority of, which
+// are typically interactive installs, run ahead of the other work items.
+WorkStealingExecutor::Priority GetWorkItemPriority(
+    const AppBundle& app_bundle) {
+  return app_bundle.priority() == INSTALL_PRIORITY_HIGH ?
+      WorkStealingExecutor::kPriorityForeground :
+      WorkStealingExecutor::kPriorityBackground;
+}
+
+}  // namespace
+
 namespace internal {
 
 void RecordUpdateAvailableUsageStats() {
@@ -418,8 +436,12 @@ HRESULT Worker::CheckForUpdateAsync(AppBundle* app_bundle) {
   ASSERT1(model_->IsLockedByCaller());
 
   std::shared_ptr<AppBundle> shared_bundle(app_bundle->controlling_ptr());
+  const WorkStealingExecutor::Priority priority =
+      app_bundle->is_auto_update() ? WorkStealingExecutor::kPriorityBackground :
+                                     GetWorkItemPriority(*app_bundle);
   HRESULT hr = QueueDeferredFunctionCall0(shared_bundle,
-                                          &Worker::CheckForUpdate);
+                                          &Worker::CheckForUpdate,
+                                          priority);
   if (FAILED(hr)) {
     return hr;
   }
@@ -437,7 +459,7 @@ void Worker::CheckForUpdate(std::shared_ptr<AppBundle> app_bundle) {
   ASSERT1(app_bundle.get());
 
   bool is_check_successful = false;
-  CheckForUpdateHelper(app_bundle.get(), &is_check_successful);
+  CheckForUpdateHelper(app_bundle.get(), false, &is_check_successful);
 
   app_bundle->CompleteAsyncCall();
 }
@@ -445,8 +467,14 @@ void Worker::CheckForUpdate(std::shared_ptr<AppBundle> app_bundle) {
 // *is_check_successful is true if the network request was successful and the
 // response was successfully parsed. The elements' status need not be success,
 // but an invalid response, such as HTML from a proxy, should result in false.
+// It is false too when the request was sharded and some shards failed, so
+// that the apps of these shards are checked again on the next run.
+// |is_download_next| is true if the updates are downloaded right after the
+// update check, in which case the download hosts are connected to ahead of
+// the downloads.
 // TODO(omaha): Unit test this by mocking update_check_client.
 void Worker::CheckForUpdateHelper(AppBundle* app_bundle,
+                                  bool is_download_next,
                                   bool* is_check_successful) {
   ASSERT1(app_bundle);
   ASSERT1(is_check_successful);
@@ -485,7 +513,13 @@ void Worker::CheckForUpdateHelper(AppBundle* app_bundle,
   if (FAILED(hr)) {
     CORE_LOG(LW, (_T("[DoUpdateCheck failed][0x%08x]"), hr));
   }
-  *is_check_successful = SUCCEEDED(hr);
+  *is_check_successful = hr == S_OK;
+
+  if (SUCCEEDED(hr) &&
+      is_download_next &&
+      !app_bundle->is_offline_install()) {
+    QueuePreconnect(app_bundle, update_response.get());
+  }
 
   CallAsSelfAndImpersonate3(this,
                             &Worker::DoPostUpdateCheck,
@@ -528,7 +562,9 @@ HRESULT Worker::DownloadAsync(AppBundle* app_bundle) {
   ASSERT1(model_->IsLockedByCaller());
 
   std::shared_ptr<AppBundle> shared_bundle(app_bundle->controlling_ptr());
-  HRESULT hr = QueueDeferredFunctionCall0(shared_bundle, &Worker::Download);
+  HRESULT hr = QueueDeferredFunctionCall0(shared_bundle,
+                                          &Worker::Download,
+                                          GetWorkItemPriority(*app_bundle));
   if (FAILED(hr)) {
     return hr;
   }
@@ -569,6 +605,8 @@ void Worker::Download(std::shared_ptr<AppBundle> app_bundle) {
             app->state() == STATE_ERROR);
   }
 
+  PersistHostHealth();
+
   WriteEventLog(EVENTLOG_INFORMATION_TYPE,
                 kDownloadEventId,
                 _T("Bundle download"),
@@ -584,7 +622,8 @@ HRESULT Worker::DownloadAndInstallAsync(AppBundle* app_bundle) {
 
   std::shared_ptr<AppBundle> shared_bundle(app_bundle->controlling_ptr());
   HRESULT hr = QueueDeferredFunctionCall0(shared_bundle,
-                                          &Worker::DownloadAndInstall);
+                                          &Worker::DownloadAndInstall,
+                                          GetWorkItemPriority(*app_bundle));
   if (FAILED(hr)) {
     return hr;
   }
@@ -628,42 +667,65 @@ void Worker::DownloadAndInstallHelper(AppBundle* app_bundle) {
     return;
   }
 
-  const size_t num_apps = app_bundle->GetNumberOfApps();
-
-  for (size_t i = 0; i != num_apps; ++i) {
-    App* app = app_bundle->GetApp(i);
-
-    ASSERT1(app->state() == STATE_WAITING_TO_DOWNLOAD ||
-            app->state() == STATE_WAITING_TO_INSTALL ||
-            app->state() == STATE_NO_UPDATE ||
-            app->state() == STATE_ERROR);
-
-    // Download the app if it has not already been downloaded.
-    // This is a blocking call on the network.
-    app->Download(download_manager_.get());
-
-    ASSERT1(app->state() == STATE_READY_TO_INSTALL ||    // Downloaded above.
-            app->state() == STATE_WAITING_TO_INSTALL ||  // Downloaded earlier.
-            app->state() == STATE_NO_UPDATE ||
-            app->state() == STATE_ERROR);
-
-    app->QueueInstall();
-
-    // This is a blocking call on the app installer.
-    CallAsSelfAndImpersonate1(
-        app,
-        &App::Install,
-        install_manager_.get());
-
-    ASSERT1(app->state() == STATE_INSTALL_COMPLETE ||
-            app->state() == STATE_NO_UPDATE ||
-            app->state() == STATE_ERROR);
-  }
+  // The apps are downloaded on this thread, impersonating the user, and
+  // installed in the same order on the install stage thread of the pipeline,
+  // while the next apps download. The installers run as self, which is the
+  // token of the install stage thread.
+  InstallPipeline pipeline(
+      [this, app_bundle](size_t i) {
+        App* app = app_bundle->GetApp(i);
+
+        ASSERT1(app->state() == STATE_WAITING_TO_DOWNLOAD ||
+                app->state() == STATE_WAITING_TO_INSTALL ||
+                app->state() == STATE_NO_UPDATE ||
+                app->state() == STATE_ERROR);
+
+        // Download the app if it has not already been downloaded.
+        // This is a blocking call on the network.
+        app->Download(download_manager_.get());
+
+        ASSERT1(app->state() == STATE_READY_TO_INSTALL ||    // Downloaded.
+                app->state() == STATE_WAITING_TO_INSTALL ||  // Earlier.
+                app->state() == STATE_NO_UPDATE ||
+                app->state() == STATE_ERROR);
+
+        app->QueueInstall();
+      },
+      [this, app_bundle](size_t i) {
+        scoped_co_init init_com_apt(COINIT_MULTITHREADED);
+        VERIFY_SUCCEEDED(init_com_apt.hresult());
+
+        App* app = app_bundle->GetApp(i);
+
+        // This is a blocking call on the app installer.
+        app->Install(install_manager_.get());
+
+        ASSERT1(app->state() == STATE_INSTALL_COMPLETE ||
+                app->state() == STATE_NO_UPDATE ||
+                app->state() == STATE_ERROR);
+      });
+  pipeline.Run(app_bundle->GetNumberOfApps());
+
+  CORE_LOG(L2, (_T("[DownloadAndInstallHelper]")
+                _T("[download %lld ms][install %lld ms][total %lld ms]"),
+                pipeline.download_ms(), pipeline.install_ms(),
+                pipeline.total_ms()));
+  metric_worker_bundle_download_ms.AddSample(pipeline.download_ms());
+  metric_worker_bundle_install_ms.AddSample(pipeline.install_ms());
+  metric_worker_bundle_download_and_install_ms.AddSample(pipeline.total_ms());
+  PersistHostHealth();
 
+  CString event_text;
+  SafeCStringFormat(&event_text,
+                    _T("Download=%lldms, Install=%lldms, Total=%lldms\n%s"),
+                    pipeline.download_ms(),
+                    pipeline.install_ms(),
+                    pipeline.total_ms(),
+                    app_bundle->FetchAndResetLogText());
   WriteEventLog(EVENTLOG_INFORMATION_TYPE,
                 kUpdateEventId,
                 _T("Application update/install"),
-                app_bundle->FetchAndResetLogText());
+                event_text);
 }
 
 
@@ -674,8 +736,10 @@ HRESULT Worker::UpdateAllAppsAsync(AppBundle* app_bundle) {
   ASSERT1(model_->IsLockedByCaller());
 
   std::shared_ptr<AppBundle> shared_bundle(app_bundle->controlling_ptr());
-  HRESULT hr = QueueDeferredFunctionCall0(shared_bundle,
-                                          &Worker::UpdateAllApps);
+  HRESULT hr = QueueDeferredFunctionCall0(
+      shared_bundle,
+      &Worker::UpdateAllApps,
+      WorkStealingExecutor::kPriorityBackground);
   if (FAILED(hr)) {
     return hr;
   }
@@ -694,7 +758,7 @@ void Worker::UpdateAllApps(std::shared_ptr<AppBundle> app_bundle) {
   ASSERT1(app_bundle.get());
 
   bool is_check_successful = false;
-  CheckForUpdateHelper(app_bundle.get(), &is_check_successful);
+  CheckForUpdateHelper(app_bundle.get(), true, &is_check_successful);
 
   if (is_check_successful) {
     HRESULT hr = goopdate_utils::UpdateLastChecked(is_machine_);
@@ -728,9 +792,11 @@ HRESULT Worker::DownloadPackageAsync(Package* package) {
   CORE_LOG(L3, (_T("[Worker::DownloadPackageAsync][0x%p][0x%p]"),
       shared_bundle.get(), package));
 
-  HRESULT hr = QueueDeferredFunctionCall1<Package*>(shared_bundle,
-                                                    package,
-                                                    &Worker::DownloadPackage);
+  HRESULT hr = QueueDeferredFunctionCall1<Package*>(
+      shared_bundle,
+      package,
+      &Worker::DownloadPackage,
+      GetWorkItemPriority(*shared_bundle));
   if (FAILED(hr)) {
     return hr;
   }
@@ -741,6 +807,23 @@ HRESULT Worker::DownloadPackageAsync(Package* package) {
   return S_OK;
 }
 
+// Does not call CompleteAsyncCall(), since the bundle has no asynchronous call
+// for the preconnect.
+void Worker::Preconnect(std::shared_ptr<AppBundle> app_bundle,
+                        std::vector<CString> urls) {
+  CORE_LOG(L3, (_T("[Worker::Preconnect][0x%p]"), app_bundle.get()));
+  ASSERT1(app_bundle.get());
+
+  scoped_impersonation impersonate_user(app_bundle->impersonation_token());
+  HRESULT hr = impersonate_user.result();
+  if (FAILED(hr)) {
+    CORE_LOG(LE, (_T("[Impersonation failed][0x%08x]"), hr));
+    return;
+  }
+
+  download_manager_->Preconnect(urls);
+}
+
 void Worker::DownloadPackage(std::shared_ptr<AppBundle> app_bundle,
                              Package* package) {
   CORE_LOG(L3, (_T("[Worker::DownloadPackage][0x%p][0x%p]"),
@@ -905,6 +988,17 @@ void Worker::DoPreUpdateCheck(AppBundle* app_bundle,
   for (size_t i = 0; i != app_bundle->GetNumberOfApps(); ++i) {
     App* app = app_bundle->GetApp(i);
     app->PreUpdateCheck(update_request);
+
+    // Lets the server offer differential packages against the cached packages
+    // of the installed version.
+    const CString current_version(app->current_version()->version());
+    std::vector<CString> cached_packages;
+    if (!current_version.IsEmpty() &&
+        SUCCEEDED(download_manager_->GetCachedPackageNames(
+            app->app_guid_string(), current_version, &cached_packages))) {
+      update_request->SetCachedPackages(app->app_guid_string(),
+                                        cached_packages);
+    }
   }
 
   size_t num_disabled_apps = 0;
@@ -1000,7 +1094,8 @@ HRESULT Worker::DoUpdateCheck(AppBundle* app_bundle,
     ++metric_worker_update_check_succeeded;
   }
 
-  return S_OK;
+  // S_FALSE if the update check of some of the apps failed.
+  return hr;
 }
 
 void Worker::DoPostUpdateCheck(AppBundle* app_bundle,
@@ -1014,6 +1109,7 @@ void Worker::DoPostUpdateCheck(AppBundle* app_bundle,
       update_response));
 
   PersistRetryAfter(app_bundle->update_check_client()->retry_after_sec());
+  PersistHostHealth();
 
   for (size_t i = 0; i != app_bundle->GetNumberOfApps(); ++i) {
     App* app = app_bundle->GetApp(i);
@@ -1048,11 +1144,64 @@ void Worker::PersistRetryAfter(int retry_after_sec) const {
                                                retry_after_time_sec);
 }
 
+void Worker::PersistHostHealth() const {
+  // The snapshot starts with the time it is taken, since the backoff and
+  // retry after delays of the hosts are relative to that time.
+  const uint32 now_sec = Time64ToInt32(GetCurrent100NSTime());
+  const std::string health(HostHealth::Instance().ToString());
+  CString host_health;
+  SafeCStringFormat(&host_health, _T("time=%u\n%hs"), now_sec, health.c_str());
+  HRESULT hr = ConfigManager::Instance()->SetHostHealth(is_machine_,
+                                                        host_health);
+  if (FAILED(hr)) {
+    CORE_LOG(LW, (_T("[SetHostHealth failed][0x%08x]"), hr));
+  }
+}
+
+void Worker::QueuePreconnect(AppBundle* app_bundle,
+                             const xml::UpdateResponse* update_response) {
+  ASSERT1(app_bundle);
+  ASSERT1(update_response);
+
+  // The first url of a package is the one its download tries first.
+  std::vector<CString> urls;
+  const std::vector<xml::response::App>& apps(
+      update_response->response().apps);
+  for (size_t i = 0; i != apps.size(); ++i) {
+    const xml::response::UpdateCheck& update_check(apps[i].update_check);
+    if (update_check.status.CompareNoCase(xml::response::kStatusOkValue) == 0 &&
+        !update_check.urls.empty()) {
+      urls.push_back(update_check.urls[0]);
+    }
+  }
+  if (urls.empty()) {
+    return;
+  }
+
+  // The work item is not recorded as the user work item of the bundle, since
+  // it does not complete an asynchronous call of the bundle.
+  using Callback = ThreadPoolCallBack2<Worker,
+                                       std::shared_ptr<AppBundle>,
+                                       std::vector<CString>>;
+  std::shared_ptr<AppBundle> shared_bundle(app_bundle->controlling_ptr());
+  auto callback = std::make_unique<Callback>(this,
+                                             &Worker::Preconnect,
+                                             shared_bundle,
+                                             urls);
+  callback->set_priority(WorkStealingExecutor::kPriorityBackground);
+  HRESULT hr = Goopdate::Instance().QueueUserWorkItem(std::move(callback),
+                                                      COINIT_MULTITHREADED);
+  if (FAILED(hr)) {
+    CORE_LOG(LW, (_T("[QueueUserWorkItem failed][0x%08x]"), hr));
+  }
+}
+
 // Creates a thread pool work item for deferred execution of deferred_function.
 // The thread pool owns this callback object.
 HRESULT Worker::QueueDeferredFunctionCall0(
     std::shared_ptr<AppBundle> app_bundle,
-    void (Worker::*deferred_function)(std::shared_ptr<AppBundle>)) {
+    void (Worker::*deferred_function)(std::shared_ptr<AppBundle>),
+    WorkStealingExecutor::Priority priority) {
   ASSERT1(app_bundle.get());
   ASSERT1(deferred_function);
 
@@ -1060,10 +1209,11 @@ HRESULT Worker::QueueDeferredFunctionCall0(
   auto callback = std::make_unique<Callback>(this,
                                              deferred_function,
                                              app_bundle);
+  callback->set_priority(priority);
+  callback->set_affinity_key(reinterpret_cast<uintptr_t>(app_bundle.get()));
   UserWorkItem* user_work_item = callback.get();
   HRESULT hr = Goopdate::Instance().QueueUserWorkItem(std::move(callback),
-                                                      COINIT_MULTITHREADED,
-                                                      WT_EXECUTELONGFUNCTION);
+                                                      COINIT_MULTITHREADED);
   if (FAILED(hr)) {
     return hr;
   }
@@ -1080,7 +1230,8 @@ template <typename P1>
 HRESULT Worker::QueueDeferredFunctionCall1(
     std::shared_ptr<AppBundle> app_bundle,
     P1 p1,
-    void (Worker::*deferred_function)(std::shared_ptr<AppBundle>, P1)) {
+    void (Worker::*deferred_function)(std::shared_ptr<AppBundle>, P1),
+    WorkStealingExecutor::Priority priority) {
   ASSERT1(app_bundle.get());
   ASSERT1(deferred_function);
 
@@ -1089,10 +1240,11 @@ HRESULT Worker::QueueDeferredFunctionCall1(
                                              deferred_function,
                                              app_bundle,
                                              p1);
+  callback->set_priority(priority);
+  callback->set_affinity_key(reinterpret_cast<uintptr_t>(app_bundle.get()));
   UserWorkItem* user_work_item = callback.get();
   HRESULT hr = Goopdate::Instance().QueueUserWorkItem(std::move(callback),
-                                                      COINIT_MULTITHREADED,
-                                                      WT_EXECUTELONGFUNCTION);
+                                                      COINIT_MULTITHREADED);
   if (FAILED(hr)) {
     return hr;
   }
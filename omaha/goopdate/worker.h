@@ -24,6 +24,7 @@
 #include "omaha/base/program_instance.h"
 #include "omaha/base/shutdown_callback.h"
 #include "omaha/base/shutdown_handler.h"
+#include "omaha/base/work_stealing_executor.h"
 #include "omaha/base/wtl_atlapp_wrapper.h"
 
 namespace omaha {
@@ -137,10 +138,14 @@ class Worker : public WorkerModelInterface, public ShutdownCallback {
   void DownloadAndInstall(std::shared_ptr<AppBundle> app_bundle);
   void DownloadPackage(std::shared_ptr<AppBundle> app_bundle, Package* package);
   void UpdateAllApps(std::shared_ptr<AppBundle> app_bundle);
+  void Preconnect(std::shared_ptr<AppBundle> app_bundle,
+                  std::vector<CString> urls);
 
   // These functions do the work for the corresponding functions but do not call
   // CompleteAsyncCall().
-  void CheckForUpdateHelper(AppBundle* app_bundle, bool* is_check_successful);
+  void CheckForUpdateHelper(AppBundle* app_bundle,
+                            bool is_download_next,
+                            bool* is_check_successful);
   void DownloadAndInstallHelper(AppBundle* app_bundle);
 
   // Stops and destroys the Worker and its members.
@@ -163,15 +168,27 @@ class Worker : public WorkerModelInterface, public ShutdownCallback {
 
   void PersistRetryAfter(int retry_after_sec) const;
 
+  // Writes the health of the network hosts, so that goopdump can read it
+  // while the worker runs and after it exits.
+  void PersistHostHealth() const;
+
+  // Queues a work item which connects to the download hosts of the apps
+  // which have updates in |update_response|, while the response is
+  // processed and the downloads are queued.
+  void QueuePreconnect(AppBundle* app_bundle,
+                       const xml::UpdateResponse* update_response);
+
   HRESULT QueueDeferredFunctionCall0(
       std::shared_ptr<AppBundle> app_bundle,
-      void (Worker::*deferred_function)(std::shared_ptr<AppBundle>));
+      void (Worker::*deferred_function)(std::shared_ptr<AppBundle>),
+      WorkStealingExecutor::Priority priority);
 
   template <typename P1>
   HRESULT QueueDeferredFunctionCall1(
       std::shared_ptr<AppBundle> app_bundle,
       P1 p1,
-      void (Worker::*deferred_function)(std::shared_ptr<AppBundle>, P1));
+      void (Worker::*deferred_function)(std::shared_ptr<AppBundle>, P1),
+      WorkStealingExecutor::Priority priority);
 
   void WriteEventLog(int event_type,
                      int event_id,
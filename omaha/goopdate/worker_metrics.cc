@@ -22,9 +22,19 @@ DEFINE_METRIC_count(worker_download_total);
 DEFINE_METRIC_count(worker_download_succeeded);
 
 DEFINE_METRIC_count(worker_download_skipped_bits_machine);
+DEFINE_METRIC_count(worker_download_peer_cache_succeeded);
+DEFINE_METRIC_count(worker_download_peer_cache_failed);
+DEFINE_METRIC_count(worker_download_coalesced);
+DEFINE_METRIC_count(worker_download_resumed);
+DEFINE_METRIC_count(worker_download_resume_discarded);
+DEFINE_METRIC_count(worker_download_preconnect_succeeded);
+DEFINE_METRIC_count(worker_download_preconnect_failed);
+DEFINE_METRIC_count(worker_verification_cache_hits);
+DEFINE_METRIC_count(worker_verification_cache_misses);
 
 DEFINE_METRIC_count(worker_package_cache_put_total);
 DEFINE_METRIC_count(worker_package_cache_put_succeeded);
+DEFINE_METRIC_count(worker_package_cache_put_deduplicated);
 
 DEFINE_METRIC_count(worker_install_execute_total);
 DEFINE_METRIC_count(worker_install_execute_msi_total);
@@ -77,4 +87,11 @@ DEFINE_METRIC_timing(ping_succeeded_ms);
 DEFINE_METRIC_timing(updatecheck_failed_ms);
 DEFINE_METRIC_timing(updatecheck_succeeded_ms);
 
+DEFINE_METRIC_timing(worker_bundle_download_ms);
+DEFINE_METRIC_timing(worker_bundle_install_ms);
+DEFINE_METRIC_timing(worker_bundle_download_and_install_ms);
+
+DEFINE_METRIC_timing(worker_download_preconnect_ms);
+DEFINE_METRIC_timing(worker_download_preconnect_saved_ms);
+
 }  // namespace omaha
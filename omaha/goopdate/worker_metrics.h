@@ -29,6 +29,24 @@ DECLARE_METRIC_count(worker_download_succeeded);
 
 // How many times the download manager skipped BITS due to machine install.
 DECLARE_METRIC_count(worker_download_skipped_bits_machine);
+// How many times a package was downloaded from the cache of a peer.
+DECLARE_METRIC_count(worker_download_peer_cache_succeeded);
+// How many times downloading a package from the cache of a peer failed.
+DECLARE_METRIC_count(worker_download_peer_cache_failed);
+// How many times an app shared the download of a package by another app.
+DECLARE_METRIC_count(worker_download_coalesced);
+// How many times a download resumed the partial file of an earlier download,
+// and how many times a partial file was discarded instead.
+DECLARE_METRIC_count(worker_download_resumed);
+DECLARE_METRIC_count(worker_download_resume_discarded);
+// How many times the download manager connected to a download host ahead of
+// the downloads, and how many times it failed to.
+DECLARE_METRIC_count(worker_download_preconnect_succeeded);
+DECLARE_METRIC_count(worker_download_preconnect_failed);
+// How many times the signature of a package was found in the verification
+// cache, and how many times it was verified.
+DECLARE_METRIC_count(worker_verification_cache_hits);
+DECLARE_METRIC_count(worker_verification_cache_misses);
 
 // How many times the package cache attempted to put the temporary file
 // to the cache directory.
@@ -36,6 +54,9 @@ DECLARE_METRIC_count(worker_package_cache_put_total);
 // How many times the package cache successfully copied the temporary file
 // to the cache directory.
 DECLARE_METRIC_count(worker_package_cache_put_succeeded);
+// How many times the package cache linked a package to contents it already
+// stored instead of copying the temporary file.
+DECLARE_METRIC_count(worker_package_cache_put_deduplicated);
 
 // How many times ExecuteAndWaitForInstaller was called.
 DECLARE_METRIC_count(worker_install_execute_total);
@@ -141,6 +162,17 @@ DECLARE_METRIC_timing(updatecheck_failed_ms);
 // Time (ms) spent in DoUpdateCheck() when an update check succeeds.
 DECLARE_METRIC_timing(updatecheck_succeeded_ms);
 
+// Time (ms) spent downloading the apps of a bundle, installing them, and in
+// DownloadAndInstallHelper(), where the installs overlap the downloads.
+DECLARE_METRIC_timing(worker_bundle_download_ms);
+DECLARE_METRIC_timing(worker_bundle_install_ms);
+DECLARE_METRIC_timing(worker_bundle_download_and_install_ms);
+
+// Time (ms) spent connecting to a download host ahead of the downloads, and
+// saved by the download which reused that connection.
+DECLARE_METRIC_timing(worker_download_preconnect_ms);
+DECLARE_METRIC_timing(worker_download_preconnect_saved_ms);
+
 }  // namespace omaha
 
 #endif  // OMAHA_GOOPDATE_WORKER_METRICS_H__
@@ -173,6 +173,10 @@ class MockDownloadManager : public DownloadManagerInterface {
       bool());
   MOCK_CONST_METHOD1(IsPackageAvailable,
       bool(const Package* package));      // NOLINT
+  MOCK_CONST_METHOD3(GetCachedPackageNames,
+      HRESULT(const CString&, const CString&, std::vector<CString>*));
+  MOCK_METHOD1(Preconnect,
+      void(const std::vector<CString>&));
 };
 
 class MockInstallManager : public InstallManagerInterface {
@@ -0,0 +1,214 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/net/bandwidth_limiter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace omaha {
+
+namespace {
+
+const double kMicrosecondsPerSecond = 1000.0 * 1000.0;
+
+int64_t SteadyClockMicroseconds() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double BurstBytes(uint64_t rate) {
+  return std::max(static_cast<double>(BandwidthLimiter::kMinBurstBytes),
+                  rate * (BandwidthLimiter::kBurstUs / kMicrosecondsPerSecond));
+}
+
+}  // namespace
+
+BandwidthLimiter::BandwidthLimiter() : clock_(SteadyClockMicroseconds) {
+}
+
+BandwidthLimiter::BandwidthLimiter(const Clock& clock) : clock_(clock) {
+}
+
+BandwidthLimiter::~BandwidthLimiter() {
+}
+
+BandwidthLimiter* BandwidthLimiter::Instance() {
+  static BandwidthLimiter* const limiter = new BandwidthLimiter;
+  return limiter;
+}
+
+void BandwidthLimiter::SetLimit(Priority priority, uint64_t bytes_per_second) {
+  std::lock_guard<std::mutex> lock(lock_);
+
+  Bucket& bucket = buckets_[priority];
+  if (bucket.limit == bytes_per_second) {
+    return;
+  }
+
+  bucket.limit = bytes_per_second;
+  bucket.rate = bytes_per_second;
+  bucket.tokens = BurstBytes(bucket.rate);
+  bucket.refill_time_us = clock_();
+  bucket.base_rtt_us = 0;
+  bucket.next_base_rtt_us = 0;
+  bucket.base_rtt_time_us = 0;
+  bucket.back_off_time_us = 0;
+}
+
+uint64_t BandwidthLimiter::GetLimit(Priority priority) const {
+  std::lock_guard<std::mutex> lock(lock_);
+  return buckets_[priority].limit;
+}
+
+uint64_t BandwidthLimiter::GetRate(Priority priority) const {
+  std::lock_guard<std::mutex> lock(lock_);
+  return buckets_[priority].rate;
+}
+
+uint64_t BandwidthLimiter::GetThroughput(Priority priority) const {
+  std::lock_guard<std::mutex> lock(lock_);
+  return buckets_[priority].throughput;
+}
+
+int64_t BandwidthLimiter::Consume(Priority priority, size_t bytes) {
+  std::lock_guard<std::mutex> lock(lock_);
+
+  const int64_t now_us = clock_();
+  Bucket& bucket = buckets_[priority];
+  UpdateThroughput(&bucket, bytes, now_us);
+  if (!bucket.rate) {
+    return 0;
+  }
+
+  Refill(&bucket, now_us);
+  bucket.tokens -= static_cast<double>(bytes);
+  if (bucket.tokens >= 0) {
+    return 0;
+  }
+
+  // The tokens may go negative: the next readers of the class wait until the
+  // debt is paid, which shares the rate among them.
+  return static_cast<int64_t>(
+      std::ceil(-bucket.tokens * kMicrosecondsPerSecond / bucket.rate));
+}
+
+void BandwidthLimiter::OnRoundTrip(Priority priority, int64_t rtt_us) {
+  if (priority != kBackground || rtt_us <= 0) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(lock_);
+
+  const int64_t now_us = clock_();
+  Bucket& bucket = buckets_[priority];
+
+  // The base is the smallest round trip time of the current period, or of
+  // the previous period if it was smaller.
+  if (!bucket.next_base_rtt_us || rtt_us < bucket.next_base_rtt_us) {
+    bucket.next_base_rtt_us = rtt_us;
+  }
+  if (!bucket.base_rtt_us || rtt_us < bucket.base_rtt_us) {
+    bucket.base_rtt_us = rtt_us;
+  }
+  if (!bucket.base_rtt_time_us) {
+    bucket.base_rtt_time_us = now_us;
+  } else if (now_us - bucket.base_rtt_time_us > kBaseRttLifetimeUs) {
+    bucket.base_rtt_us = bucket.next_base_rtt_us;
+    bucket.next_base_rtt_us = rtt_us;
+    bucket.base_rtt_time_us = now_us;
+  }
+
+  Refill(&bucket, now_us);
+
+  const int64_t queuing_delay_us = rtt_us - bucket.base_rtt_us;
+  if (queuing_delay_us > kTargetQueuingDelayUs) {
+    if (bucket.back_off_time_us &&
+        now_us - bucket.back_off_time_us < kBackOffIntervalUs) {
+      return;
+    }
+
+    uint64_t current_rate = bucket.rate;
+    if (bucket.throughput &&
+        (!current_rate || bucket.throughput < current_rate)) {
+      current_rate = bucket.throughput;
+    }
+    if (!current_rate) {
+      return;
+    }
+
+    const bool was_unlimited = !bucket.rate;
+    bucket.rate = std::max(kMinBytesPerSecond, current_rate / 2);
+    bucket.back_off_time_us = now_us;
+    if (was_unlimited) {
+      bucket.tokens = 0;
+      bucket.refill_time_us = now_us;
+    }
+    return;
+  }
+
+  if (!bucket.rate) {
+    return;
+  }
+
+  bucket.rate += std::max(kMinBytesPerSecond, bucket.rate / 8);
+  if (bucket.limit) {
+    bucket.rate = std::min(bucket.rate, bucket.limit);
+  } else if (bucket.throughput && bucket.rate > 4 * bucket.throughput) {
+    bucket.rate = 0;
+  }
+}
+
+void BandwidthLimiter::Refill(Bucket* bucket, int64_t now_us) {
+  if (!bucket->rate) {
+    bucket->tokens = 0;
+    bucket->refill_time_us = now_us;
+    return;
+  }
+
+  if (now_us > bucket->refill_time_us) {
+    bucket->tokens += bucket->rate *
+        ((now_us - bucket->refill_time_us) / kMicrosecondsPerSecond);
+    bucket->tokens = std::min(bucket->tokens, BurstBytes(bucket->rate));
+  }
+  bucket->refill_time_us = now_us;
+}
+
+void BandwidthLimiter::UpdateThroughput(Bucket* bucket,
+                                        size_t bytes,
+                                        int64_t now_us) {
+  // A window which spans an idle period is not measured.
+  if (!bucket->window_start_us ||
+      now_us - bucket->window_start_us > 2 * kThroughputWindowUs) {
+    bucket->window_start_us = now_us;
+    bucket->window_bytes = 0;
+  }
+
+  bucket->window_bytes += bytes;
+  const int64_t elapsed_us = now_us - bucket->window_start_us;
+  if (elapsed_us < kThroughputWindowUs) {
+    return;
+  }
+
+  const uint64_t throughput = static_cast<uint64_t>(
+      bucket->window_bytes * kMicrosecondsPerSecond / elapsed_us);
+  bucket->throughput = bucket->throughput ?
+      (bucket->throughput + throughput) / 2 : throughput;
+  bucket->window_start_us = now_us;
+  bucket->window_bytes = 0;
+}
+
+}  // namespace omaha
@@ -0,0 +1,143 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// BandwidthLimiter shapes the download throughput of the process with one
+// token bucket per priority class. All the requests of a class share its
+// bucket: a request accounts for the bytes it receives, and waits for the
+// delay the limiter returns before it reads again.
+//
+// The rate of the foreground class is its configured limit. The rate of the
+// background class also adapts to the link, so that background downloads
+// yield to other traffic: the round trip times reported for the background
+// connections are compared with the smallest recent round trip time, and
+// when the difference, which is the time spent in the queues of the link,
+// exceeds kTargetQueuingDelayUs, the rate drops to half of the observed
+// throughput. Otherwise it grows back towards the configured limit. When the
+// background class has no configured limit, it is unlimited until the link
+// is congested, and becomes unlimited again once its rate exceeds the
+// observed throughput several times over.
+//
+// This file has no platform dependencies.
+
+#ifndef OMAHA_NET_BANDWIDTH_LIMITER_H_
+#define OMAHA_NET_BANDWIDTH_LIMITER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <mutex>
+
+#include "base/basictypes.h"
+
+namespace omaha {
+
+class BandwidthLimiter {
+ public:
+  enum Priority {
+    kForeground = 0,
+    kBackground,
+    kNumPriorities,
+  };
+
+  // Returns a monotonic time in microseconds.
+  typedef std::function<int64_t()> Clock;
+
+  // The adapted rate never drops below this.
+  static constexpr uint64_t kMinBytesPerSecond = 4 * 1024;
+
+  // The queuing delay above which the background class backs off.
+  static constexpr int64_t kTargetQueuingDelayUs = 100 * 1000;
+
+  // The rate is lowered at most once per interval, so that the samples of a
+  // single congestion episode lower it once.
+  static constexpr int64_t kBackOffIntervalUs = 1000 * 1000;
+
+  // The smallest round trip time is forgotten after this long, in case the
+  // route changed.
+  static constexpr int64_t kBaseRttLifetimeUs = 5 * 60 * 1000 * 1000LL;
+
+  // The throughput is measured over windows of this length.
+  static constexpr int64_t kThroughputWindowUs = 1000 * 1000;
+
+  // A bucket holds at most this much time worth of tokens, and at least
+  // kMinBurstBytes.
+  static constexpr int64_t kBurstUs = 250 * 1000;
+  static constexpr uint64_t kMinBurstBytes = 16 * 1024;
+
+  // Uses a steady clock.
+  BandwidthLimiter();
+  explicit BandwidthLimiter(const Clock& clock);
+  ~BandwidthLimiter();
+
+  // Returns the limiter shared by the requests of the process.
+  static BandwidthLimiter* Instance();
+
+  // Sets the configured limit of |priority| in bytes per second, or 0 for no
+  // limit. Setting a different limit resets the adaptation of the class.
+  void SetLimit(Priority priority, uint64_t bytes_per_second);
+  uint64_t GetLimit(Priority priority) const;
+
+  // Returns the current rate of |priority| in bytes per second, or 0 if the
+  // class is not limited.
+  uint64_t GetRate(Priority priority) const;
+
+  // Returns the throughput of |priority| in bytes per second measured over
+  // the last windows, or 0 if it has not been measured yet.
+  uint64_t GetThroughput(Priority priority) const;
+
+  // Accounts for |bytes| received by a request of |priority|. Returns the
+  // time in microseconds the request must wait before it reads again.
+  int64_t Consume(Priority priority, size_t bytes);
+
+  // Reports the round trip time of a connection of |priority|.
+  void OnRoundTrip(Priority priority, int64_t rtt_us);
+
+ private:
+  struct Bucket {
+    uint64_t limit = 0;
+    uint64_t rate = 0;
+    double tokens = 0;
+    int64_t refill_time_us = 0;
+
+    int64_t window_start_us = 0;
+    uint64_t window_bytes = 0;
+    uint64_t throughput = 0;
+
+    // The smallest round trip time, and the smallest one since the period
+    // started at |base_rtt_time_us|.
+    int64_t base_rtt_us = 0;
+    int64_t next_base_rtt_us = 0;
+    int64_t base_rtt_time_us = 0;
+    int64_t back_off_time_us = 0;
+  };
+
+  // Adds the tokens accumulated since the last refill.
+  static void Refill(Bucket* bucket, int64_t now_us);
+
+  // Accounts |bytes| in the throughput windows of |bucket|.
+  static void UpdateThroughput(Bucket* bucket, size_t bytes, int64_t now_us);
+
+  const Clock clock_;
+
+  mutable std::mutex lock_;
+  Bucket buckets_[kNumPriorities];
+
+  DISALLOW_COPY_AND_ASSIGN(BandwidthLimiter);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_NET_BANDWIDTH_LIMITER_H_
@@ -0,0 +1,297 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/net/bandwidth_limiter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace omaha {
+
+namespace {
+
+const int64_t kSecondUs = 1000 * 1000;
+
+// Stands in for an HTTP server streaming a response body as fast as the
+// receive buffer of the connection lets it.
+class HttpStandIn {
+ public:
+  static const size_t kReceiveBufferSize = 64 * 1024;
+
+  explicit HttpStandIn(size_t body_size)
+      : remaining_(body_size),
+        sender_([this]() { Send(); }) {
+  }
+
+  ~HttpStandIn() {
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      remaining_ = 0;
+      closed_ = true;
+    }
+    changed_.notify_all();
+    sender_.join();
+  }
+
+  // Blocks until data is available like WinHttpQueryDataAvailable, then
+  // reads it like WinHttpReadData. Returns 0 at the end of the body.
+  size_t Read(uint8_t* buffer, size_t size) {
+    std::unique_lock<std::mutex> lock(lock_);
+    changed_.wait(lock, [this]() { return !buffered_.empty() || closed_; });
+    const size_t num_bytes = std::min(size, buffered_.size());
+    std::copy(buffered_.begin(), buffered_.begin() + num_bytes, buffer);
+    buffered_.erase(buffered_.begin(), buffered_.begin() + num_bytes);
+    lock.unlock();
+    changed_.notify_all();
+    return num_bytes;
+  }
+
+ private:
+  void Send() {
+    std::unique_lock<std::mutex> lock(lock_);
+    while (remaining_) {
+      changed_.wait(lock, [this]() {
+        return buffered_.size() < kReceiveBufferSize || !remaining_;
+      });
+      const size_t num_bytes =
+          std::min(remaining_, kReceiveBufferSize - buffered_.size());
+      buffered_.insert(buffered_.end(), num_bytes, 'x');
+      remaining_ -= num_bytes;
+      changed_.notify_all();
+    }
+    closed_ = true;
+    changed_.notify_all();
+  }
+
+  std::mutex lock_;
+  std::condition_variable changed_;
+  std::deque<uint8_t> buffered_;
+  size_t remaining_;
+  bool closed_ = false;
+  std::thread sender_;
+};
+
+// Receives the body like SimpleRequest::ReceiveData. Returns the number of
+// bytes received.
+size_t ReceiveBody(HttpStandIn* server,
+                   BandwidthLimiter* limiter,
+                   BandwidthLimiter::Priority priority) {
+  std::vector<uint8_t> buffer(8 * 1024);
+  size_t total_bytes = 0;
+  for (;;) {
+    const size_t num_bytes = server->Read(buffer.data(), buffer.size());
+    if (!num_bytes) {
+      return total_bytes;
+    }
+    total_bytes += num_bytes;
+    const int64_t delay_us = limiter->Consume(priority, num_bytes);
+    if (delay_us) {
+      std::this_thread::sleep_for(std::chrono::microseconds(delay_us));
+    }
+  }
+}
+
+double Seconds(std::chrono::steady_clock::duration duration) {
+  return std::chrono::duration<double>(duration).count();
+}
+
+}  // namespace
+
+class BandwidthLimiterTest : public testing::Test {
+ protected:
+  BandwidthLimiterTest()
+      : now_us_(kSecondUs),
+        limiter_([this]() { return now_us_; }) {}
+
+  // Consumes |bytes_per_second| for |seconds| in 100 ms steps, as a link
+  // delivering that throughput would.
+  void Receive(BandwidthLimiter::Priority priority,
+               uint64_t bytes_per_second,
+               int seconds) {
+    for (int i = 0; i != 10 * seconds; ++i) {
+      now_us_ += kSecondUs / 10;
+      limiter_.Consume(priority, static_cast<size_t>(bytes_per_second / 10));
+    }
+  }
+
+  int64_t now_us_;
+  BandwidthLimiter limiter_;
+};
+
+TEST_F(BandwidthLimiterTest, UnlimitedByDefault) {
+  EXPECT_EQ(0, limiter_.Consume(BandwidthLimiter::kForeground, 1 << 30));
+  EXPECT_EQ(0, limiter_.Consume(BandwidthLimiter::kBackground, 1 << 30));
+  EXPECT_EQ(0, limiter_.GetRate(BandwidthLimiter::kBackground));
+}
+
+TEST_F(BandwidthLimiterTest, TokenBucket) {
+  limiter_.SetLimit(BandwidthLimiter::kForeground, 100 * 1024);
+  EXPECT_EQ(100 * 1024, limiter_.GetLimit(BandwidthLimiter::kForeground));
+
+  // The bucket starts with a burst of 250 ms worth of tokens.
+  EXPECT_EQ(0, limiter_.Consume(BandwidthLimiter::kForeground, 25 * 1024));
+
+  // Going 10 KB over takes 100 ms to pay back.
+  EXPECT_EQ(100 * 1000,
+            limiter_.Consume(BandwidthLimiter::kForeground, 10 * 1024));
+
+  // The debt is shared by the next readers of the class.
+  now_us_ += 50 * 1000;
+  EXPECT_EQ(50 * 1000 + 100 * 1000,
+            limiter_.Consume(BandwidthLimiter::kForeground, 10 * 1024));
+
+  // The classes do not share their buckets.
+  EXPECT_EQ(0, limiter_.Consume(BandwidthLimiter::kBackground, 1 << 20));
+
+  // An idle bucket does not accumulate more than the burst.
+  now_us_ += 60 * kSecondUs;
+  EXPECT_EQ(0, limiter_.Consume(BandwidthLimiter::kForeground, 25 * 1024));
+  EXPECT_LT(0, limiter_.Consume(BandwidthLimiter::kForeground, 1024));
+}
+
+TEST_F(BandwidthLimiterTest, Throughput) {
+  Receive(BandwidthLimiter::kForeground, 200 * 1024, 3);
+  EXPECT_NEAR(200 * 1024,
+              static_cast<double>(
+                  limiter_.GetThroughput(BandwidthLimiter::kForeground)),
+              10 * 1024);
+}
+
+TEST_F(BandwidthLimiterTest, BackgroundBacksOffWhenTheLinkQueues) {
+  limiter_.SetLimit(BandwidthLimiter::kBackground, 400 * 1024);
+  Receive(BandwidthLimiter::kBackground, 400 * 1024, 3);
+
+  limiter_.OnRoundTrip(BandwidthLimiter::kBackground, 50 * 1000);
+  EXPECT_EQ(400 * 1024, limiter_.GetRate(BandwidthLimiter::kBackground));
+
+  // 300 ms of queuing halves the rate, once per back off interval.
+  limiter_.OnRoundTrip(BandwidthLimiter::kBackground, 350 * 1000);
+  EXPECT_EQ(200 * 1024, limiter_.GetRate(BandwidthLimiter::kBackground));
+  limiter_.OnRoundTrip(BandwidthLimiter::kBackground, 350 * 1000);
+  EXPECT_EQ(200 * 1024, limiter_.GetRate(BandwidthLimiter::kBackground));
+
+  now_us_ += BandwidthLimiter::kBackOffIntervalUs;
+  limiter_.OnRoundTrip(BandwidthLimiter::kBackground, 350 * 1000);
+  EXPECT_EQ(100 * 1024, limiter_.GetRate(BandwidthLimiter::kBackground));
+
+  // The rate grows back to the limit when the queues drain.
+  for (int i = 0; i != 20; ++i) {
+    now_us_ += kSecondUs;
+    limiter_.OnRoundTrip(BandwidthLimiter::kBackground, 60 * 1000);
+  }
+  EXPECT_EQ(400 * 1024, limiter_.GetRate(BandwidthLimiter::kBackground));
+
+  // The foreground class is not adapted.
+  limiter_.SetLimit(BandwidthLimiter::kForeground, 400 * 1024);
+  limiter_.OnRoundTrip(BandwidthLimiter::kForeground, 50 * 1000);
+  limiter_.OnRoundTrip(BandwidthLimiter::kForeground, 950 * 1000);
+  EXPECT_EQ(400 * 1024, limiter_.GetRate(BandwidthLimiter::kForeground));
+}
+
+// Without a configured limit, the background class is limited to half of its
+// throughput when the link queues, and unlimited again once it recovered.
+TEST_F(BandwidthLimiterTest, UnlimitedBackgroundBacksOff) {
+  Receive(BandwidthLimiter::kBackground, 800 * 1024, 3);
+  limiter_.OnRoundTrip(BandwidthLimiter::kBackground, 20 * 1000);
+  limiter_.OnRoundTrip(BandwidthLimiter::kBackground, 500 * 1000);
+  EXPECT_NEAR(400 * 1024,
+              static_cast<double>(
+                  limiter_.GetRate(BandwidthLimiter::kBackground)),
+              20 * 1024);
+
+  int num_samples = 0;
+  while (limiter_.GetRate(BandwidthLimiter::kBackground)) {
+    now_us_ += kSecondUs;
+    limiter_.OnRoundTrip(BandwidthLimiter::kBackground, 20 * 1000);
+    ASSERT_LT(++num_samples, 100);
+  }
+}
+
+// The smallest round trip time expires, so that a longer route does not look
+// like queuing forever.
+TEST_F(BandwidthLimiterTest, BaseRoundTripTimeExpires) {
+  limiter_.SetLimit(BandwidthLimiter::kBackground, 400 * 1024);
+  limiter_.OnRoundTrip(BandwidthLimiter::kBackground, 20 * 1000);
+
+  now_us_ += BandwidthLimiter::kBaseRttLifetimeUs / 2;
+  limiter_.OnRoundTrip(BandwidthLimiter::kBackground, 20 * 1000);
+
+  // The route changed: every sample is now 200 ms longer.
+  now_us_ += BandwidthLimiter::kBaseRttLifetimeUs;
+  limiter_.OnRoundTrip(BandwidthLimiter::kBackground, 220 * 1000);
+  now_us_ += BandwidthLimiter::kBaseRttLifetimeUs + 1;
+  limiter_.OnRoundTrip(BandwidthLimiter::kBackground, 220 * 1000);
+
+  now_us_ += BandwidthLimiter::kBackOffIntervalUs;
+  const uint64_t rate = limiter_.GetRate(BandwidthLimiter::kBackground);
+  limiter_.OnRoundTrip(BandwidthLimiter::kBackground, 230 * 1000);
+  EXPECT_LE(rate, limiter_.GetRate(BandwidthLimiter::kBackground));
+}
+
+// Downloads from a local stand-in for an HTTP server and checks the achieved
+// rates with the real clock.
+TEST(BandwidthLimiterStandInTest, AchievedRates) {
+  const uint64_t kLimit = 1024 * 1024;
+
+  BandwidthLimiter limiter;
+  limiter.SetLimit(BandwidthLimiter::kForeground, kLimit);
+
+  // The burst is received at once, the rest at the limit.
+  const size_t kBodySize = 1536 * 1024;
+  auto start = std::chrono::steady_clock::now();
+  {
+    HttpStandIn server(kBodySize);
+    EXPECT_EQ(kBodySize,
+              ReceiveBody(&server, &limiter, BandwidthLimiter::kForeground));
+  }
+  double rate = (kBodySize - BandwidthLimiter::kBurstUs * kLimit / kSecondUs) /
+                Seconds(std::chrono::steady_clock::now() - start);
+  std::cout << "one request: " << rate / 1024 << " KB/s" << std::endl;
+  EXPECT_GT(rate, 0.8 * kLimit);
+  EXPECT_LT(rate, 1.1 * kLimit);
+
+  // Two requests of the same class share its rate.
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  start = std::chrono::steady_clock::now();
+  size_t total_bytes = 0;
+  {
+    HttpStandIn server1(kBodySize / 2);
+    HttpStandIn server2(kBodySize / 2);
+    size_t bytes1 = 0;
+    std::thread request1([&]() {
+      bytes1 = ReceiveBody(&server1, &limiter, BandwidthLimiter::kForeground);
+    });
+    total_bytes =
+        ReceiveBody(&server2, &limiter, BandwidthLimiter::kForeground);
+    request1.join();
+    total_bytes += bytes1;
+  }
+  EXPECT_EQ(kBodySize, total_bytes);
+  rate = (kBodySize - BandwidthLimiter::kBurstUs * kLimit / kSecondUs) /
+         Seconds(std::chrono::steady_clock::now() - start);
+  std::cout << "two requests: " << rate / 1024 << " KB/s" << std::endl;
+  EXPECT_GT(rate, 0.8 * kLimit);
+  EXPECT_LT(rate, 1.1 * kLimit);
+}
+
+}  // namespace omaha
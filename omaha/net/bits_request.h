@@ -104,6 +104,20 @@ class BitsRequest : public HttpRequestInterface {
     callback_ = callback;
   }
 
+  // BITS receives the response into the file, out of the process.
+  virtual void set_response_observer(ResponseObserver* observer) {
+    UNREFERENCED_PARAMETER(observer);
+  }
+
+  // BITS keeps its own jobs, and does not resume the downloads of others.
+  virtual void set_resumable(bool is_resumable,
+                             int content_length,
+                             int offset) {
+    UNREFERENCED_PARAMETER(is_resumable);
+    UNREFERENCED_PARAMETER(content_length);
+    UNREFERENCED_PARAMETER(offset);
+  }
+
   virtual void set_additional_headers(const CString& additional_headers) {
     additional_headers_ = additional_headers;
   }
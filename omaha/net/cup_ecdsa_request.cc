@@ -51,7 +51,8 @@ const uint8 CupEcdsaRequestImpl::kCupTestPublicKey[] =
 
 CupEcdsaRequestImpl::CupEcdsaRequestImpl(HttpRequestInterface* http_request)
     : request_buffer_(NULL),
-      request_buffer_length_(0) {
+      request_buffer_length_(0),
+      response_observer_(NULL) {
   ASSERT1(http_request);
 
   // Load the appropriate ECC public key.
@@ -68,6 +69,9 @@ CupEcdsaRequestImpl::CupEcdsaRequestImpl(HttpRequestInterface* http_request)
   CString user_agent(http_request_->user_agent());
   user_agent += _T(";cup-ecdsa");
   http_request_->set_user_agent(user_agent);
+
+  // Hash the response body as the inner request receives it.
+  http_request_->set_response_observer(this);
 }
 
 CupEcdsaRequestImpl::~CupEcdsaRequestImpl() {
@@ -163,6 +167,16 @@ void CupEcdsaRequestImpl::set_callback(NetworkRequestCallback* callback) {
   http_request_->set_callback(callback);
 }
 
+void CupEcdsaRequestImpl::set_response_observer(ResponseObserver* observer) {
+  response_observer_ = observer;
+}
+
+void CupEcdsaRequestImpl::set_resumable(bool is_resumable,
+                                        int content_length,
+                                        int offset) {
+  http_request_->set_resumable(is_resumable, content_length, offset);
+}
+
 void CupEcdsaRequestImpl::set_additional_headers(
     const CString& additional_headers) {
   http_request_->set_additional_headers(additional_headers);
@@ -180,6 +194,24 @@ void CupEcdsaRequestImpl::set_proxy_auth_config(const ProxyAuthConfig& config) {
   http_request_->set_proxy_auth_config(config);
 }
 
+void CupEcdsaRequestImpl::OnResponseStart(uint64 offset) {
+  if (cup_.get()) {
+    cup_->response_hasher.Start(offset);
+  }
+  if (response_observer_) {
+    response_observer_->OnResponseStart(offset);
+  }
+}
+
+void CupEcdsaRequestImpl::OnResponseData(const uint8* data, size_t size) {
+  if (cup_.get()) {
+    cup_->response_hasher.Update(data, size);
+  }
+  if (response_observer_) {
+    response_observer_->OnResponseData(data, size);
+  }
+}
+
 HRESULT CupEcdsaRequestImpl::BuildRequest() {
   // Generate a random nonce.
   if (!RandUint32(&cup_->nonce)) {
@@ -226,8 +258,8 @@ HRESULT CupEcdsaRequestImpl::DoSend() {
     return hr;
   }
 
-  // Save the response body, and make sure we got an HTTP 200 or 206.
-  http_request_->GetResponse().swap(cup_->response);
+  // Make sure we got an HTTP 200 or 206. The response body has been hashed
+  // while it was received, and is not copied.
   int status_code(http_request_->GetHttpStatusCode());
   if (status_code != HTTP_STATUS_OK &&
       status_code != HTTP_STATUS_PARTIAL_CONTENT) {
@@ -235,7 +267,7 @@ HRESULT CupEcdsaRequestImpl::DoSend() {
     return HRESULTFromHttpStatusCode(status_code);
   }
   NET_LOG(L5, (_T("[CUP-ECDSA response][%s]"),
-               VectorToPrintableString(cup_->response)));
+               VectorToPrintableString(http_request_->GetResponse())));
 
   // Get the server signature out of the ETag string; it will contain the
   // ECDSA signature and the SHA-256 hash of the observed client request.
@@ -260,7 +292,8 @@ HRESULT CupEcdsaRequestImpl::AuthenticateResponse() {
   NET_LOG(L4, (_T("[CUP-ECDSA][etag:        %s]"), cup_->etag));
 
   if (cup_->etag.IsEmpty()) {
-    CString response_as_string = Utf8BufferToWideChar(cup_->response);
+    CString response_as_string =
+        Utf8BufferToWideChar(http_request_->GetResponse());
     if (NULL == stristrW(response_as_string, L"<response") &&
         NULL != stristrW(response_as_string, L"<html")) {
       NET_LOG(L4, (_T("[CUP-ECDSA][Captive portal detected, aborting]")));
@@ -273,9 +306,20 @@ HRESULT CupEcdsaRequestImpl::AuthenticateResponse() {
     }
   }
 
-  // Compute the hash of the response body.  (Should be in UTF-8.)
+  // Finish the hash of the response body.  (Should be in UTF-8.)  The body is
+  // hashed in a second pass only if the inner request did not pass all of it
+  // to the observer.
   std::vector<uint8> response_hash;
-  VERIFY1(SafeSHA256Hash(cup_->response, &response_hash));
+  if (!cup_->response_hasher.Finish(&response_hash)) {
+    NET_LOG(L4, (_T("[CUP-ECDSA][hashing the stored response]")));
+    const std::vector<uint8> response(http_request_->GetResponse());
+    ResponseHasher response_hasher;
+    response_hasher.Start(0);
+    if (!response.empty()) {
+      response_hasher.Update(&response.front(), response.size());
+    }
+    VERIFY1(response_hasher.Finish(&response_hash));
+  }
   NET_LOG(L4, (_T("[CUP-ECDSA][resp hash][%s]"), BytesToHex(response_hash)));
 
   // Parse the ETag into its respective components.
@@ -485,6 +529,16 @@ void CupEcdsaRequest::set_callback(NetworkRequestCallback* callback) {
   impl_->set_callback(callback);
 }
 
+void CupEcdsaRequest::set_response_observer(ResponseObserver* observer) {
+  impl_->set_response_observer(observer);
+}
+
+void CupEcdsaRequest::set_resumable(bool is_resumable,
+                                    int content_length,
+                                    int offset) {
+  impl_->set_resumable(is_resumable, content_length, offset);
+}
+
 void CupEcdsaRequest::set_additional_headers(
     const CString& additional_headers) {
   impl_->set_additional_headers(additional_headers);
@@ -80,6 +80,10 @@ class CupEcdsaRequest : public HttpRequestInterface {
 
   virtual void set_callback(NetworkRequestCallback* callback);
 
+  virtual void set_response_observer(ResponseObserver* observer);
+
+  virtual void set_resumable(bool is_resumable, int content_length, int offset);
+
   virtual void set_additional_headers(const CString& additional_headers);
 
   virtual CString user_agent() const;
@@ -22,15 +22,18 @@
 
 #include "base/basictypes.h"
 #include "omaha/net/cup_ecdsa_utils.h"
+#include "omaha/net/http_request.h"
 
 namespace omaha {
 
 namespace internal {
 
-class CupEcdsaRequestImpl {
+// The implementation observes the body of the inner response to hash it as it
+// is received.
+class CupEcdsaRequestImpl : public ResponseObserver {
  public:
   explicit CupEcdsaRequestImpl(HttpRequestInterface* http_request);
-  ~CupEcdsaRequestImpl();
+  virtual ~CupEcdsaRequestImpl();
 
   // Methods from HttpRequestInterface; will be forwarded from the outer
   // CupEcdsaRequest that is pimpl-ing to this object.
@@ -55,11 +58,18 @@ class CupEcdsaRequestImpl {
   void set_filename(const CString& filename);
   void set_low_priority(bool low_priority);
   void set_callback(NetworkRequestCallback* callback);
+  void set_response_observer(ResponseObserver* observer);
+  void set_resumable(bool is_resumable, int content_length, int offset);
   void set_additional_headers(const CString& additional_headers);
   CString user_agent() const;
   void set_user_agent(const CString& user_agent);
   void set_proxy_auth_config(const ProxyAuthConfig& proxy_auth_config);
 
+  // ResponseObserver interface. Hashes the response body, and forwards it to
+  // the observer of this request.
+  virtual void OnResponseStart(uint64 offset);
+  virtual void OnResponseData(const uint8* data, size_t size);
+
  private:
   friend class CupEcdsaRequestTest;
 
@@ -83,7 +93,7 @@ class CupEcdsaRequestImpl {
     CString cup2hreq;                  // Query parameter: request hash
     CString request_url;               // Complete URL of the request.
 
-    std::vector<uint8> response;       // The received response body.
+    ResponseHasher response_hasher;    // Hashes the received response body.
     CString etag;                      // The ETag header from the response.
 
     EcdsaSignature signature;          // The decoded ECDSA signature.
@@ -94,6 +104,7 @@ class CupEcdsaRequestImpl {
   CString     url_;                     // The original url.
   const void* request_buffer_;          // Contains the request body for POST.
   size_t      request_buffer_length_;   // Length of the request body.
+  ResponseObserver* response_observer_;  // The observer of this request.
 
   typedef const uint8 PublicKeyInstance[];
   typedef const uint8* PublicKey;
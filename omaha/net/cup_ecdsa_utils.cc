@@ -51,6 +51,42 @@ bool SafeSHA256Hash(const std::vector<uint8>& data,
   return SafeSHA256Hash(&data.front(), data.size(), hash_out);
 }
 
+ResponseHasher::ResponseHasher() : num_bytes_(0), is_valid_(false) {
+  SHA256_init(&ctx_);
+}
+
+void ResponseHasher::Start(uint64 offset) {
+  if (!offset) {
+    SHA256_init(&ctx_);
+    num_bytes_ = 0;
+    is_valid_ = true;
+  } else if (offset != num_bytes_) {
+    is_valid_ = false;
+  }
+}
+
+void ResponseHasher::Update(const void* data, size_t len) {
+  if (!is_valid_) {
+    return;
+  }
+  SHA256_update(&ctx_, data, len);
+  num_bytes_ += len;
+}
+
+bool ResponseHasher::Finish(std::vector<uint8>* hash_out) {
+  ASSERT1(hash_out);
+
+  if (!is_valid_) {
+    return false;
+  }
+  const uint8* hash = SHA256_final(&ctx_);
+  hash_out->assign(hash, hash + SHA256_DIGEST_SIZE);
+
+  // The context is finalized, therefore the body must start over.
+  is_valid_ = false;
+  return true;
+}
+
 EcdsaSignature::EcdsaSignature() {
   p256_init(&r_);
   p256_init(&s_);
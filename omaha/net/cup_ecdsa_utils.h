@@ -20,6 +20,7 @@
 #include <vector>
 #include "base/basictypes.h"
 #include "omaha/base/security/p256.h"
+#include "omaha/base/security/sha256.h"
 
 namespace omaha {
 
@@ -36,6 +37,30 @@ bool SafeSHA256Hash(const void* data, size_t len,
 bool SafeSHA256Hash(const std::vector<uint8>& data,
                     std::vector<uint8>* hash_out);
 
+// ResponseHasher computes the SHA-256 hash of a response body while the body
+// is received, so that the body is not hashed again after it is stored.
+class ResponseHasher {
+ public:
+  ResponseHasher();
+
+  // Starts a response body which continues at |offset|. The hash starts over
+  // if |offset| is 0, and continues if |offset| is the number of bytes hashed
+  // so far. Otherwise, bytes are missing and the hash is invalid.
+  void Start(uint64 offset);
+
+  void Update(const void* data, size_t len);
+
+  // Returns true and the hash of the body if the hash is valid.
+  bool Finish(std::vector<uint8>* hash_out);
+
+ private:
+  LITE_SHA256_CTX ctx_;
+  uint64 num_bytes_;
+  bool is_valid_;
+
+  DISALLOW_COPY_AND_ASSIGN(ResponseHasher);
+};
+
 // EcdsaSignature parses a DER-encoded ASN.1 EcdsaSignature and converts it
 // to an (R,S) integer pair in our native 256-bit int implementation.
 class EcdsaSignature {
@@ -623,6 +623,64 @@ TEST(EcdsaPublicKey, DecodeSubjectPublicKeyInfo_UnsupportedEncoding) {
   EXPECT_FALSE(key.DecodeSubjectPublicKeyInfo(spki));
 }
 
+TEST(ResponseHasher, HashesInChunks) {
+  const CString kAbcHash(
+      _T("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"));
+
+  ResponseHasher hasher;
+  std::vector<uint8> hash;
+  EXPECT_FALSE(hasher.Finish(&hash));
+
+  hasher.Start(0);
+  hasher.Update("a", 1);
+  hasher.Update("bc", 2);
+  ASSERT_TRUE(hasher.Finish(&hash));
+  EXPECT_STREQ(kAbcHash, BytesToHex(hash));
+
+  // The hash is finished until the next body starts.
+  EXPECT_FALSE(hasher.Finish(&hash));
+
+  // A body which is received again starts over.
+  hasher.Start(0);
+  hasher.Update("xyz", 3);
+  hasher.Start(0);
+  hasher.Update("abc", 3);
+  ASSERT_TRUE(hasher.Finish(&hash));
+  EXPECT_STREQ(kAbcHash, BytesToHex(hash));
+}
+
+TEST(ResponseHasher, EmptyBody) {
+  ResponseHasher hasher;
+  std::vector<uint8> hash;
+  hasher.Start(0);
+  ASSERT_TRUE(hasher.Finish(&hash));
+  EXPECT_STREQ(
+      _T("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"),
+      BytesToHex(hash));
+}
+
+TEST(ResponseHasher, ResumedBody) {
+  ResponseHasher hasher;
+  std::vector<uint8> hash;
+
+  // A body which resumes after the bytes hashed so far continues the hash.
+  hasher.Start(0);
+  hasher.Update("a", 1);
+  hasher.Start(1);
+  hasher.Update("bc", 2);
+  ASSERT_TRUE(hasher.Finish(&hash));
+  EXPECT_STREQ(
+      _T("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"),
+      BytesToHex(hash));
+
+  // Otherwise bytes are missing from the hash.
+  hasher.Start(0);
+  hasher.Update("a", 1);
+  hasher.Start(2);
+  hasher.Update("c", 1);
+  EXPECT_FALSE(hasher.Finish(&hash));
+}
+
 }  // namespace internal
 
 }  // namespace omaha
@@ -0,0 +1,183 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/net/host_health.h"
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+
+namespace omaha {
+
+namespace {
+
+int64_t SteadyClockMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}  // namespace
+
+HostHealth::HostHealth(const Options& options,
+                       const Clock& clock,
+                       const Random& random)
+    : options_(options),
+      clock_(clock),
+      random_(random),
+      generator_(std::random_device()()) {
+}
+
+HostHealth::~HostHealth() {
+}
+
+HostHealth& HostHealth::Instance() {
+  // The instance is not destroyed, since requests may still run on other
+  // threads when the process exits.
+  static HostHealth* const instance =
+      new HostHealth(Options(), SteadyClockMs, Random());
+  return *instance;
+}
+
+HostHealth::Admission HostHealth::Admit(const std::string& host,
+                                        int64_t* wait_ms) {
+  *wait_ms = 0;
+
+  std::lock_guard<std::mutex> lock(lock_);
+  auto it = hosts_.find(host);
+  if (it == hosts_.end()) {
+    return ADMISSION_SEND;
+  }
+
+  Host& state = it->second;
+  const int64_t now_ms = clock_();
+
+  if (state.retry_after_until_ms > now_ms) {
+    *wait_ms = state.retry_after_until_ms - now_ms;
+    ++counters_.rejected;
+    return ADMISSION_REJECT;
+  }
+
+  if (state.open_until_ms > now_ms) {
+    *wait_ms = state.open_until_ms - now_ms;
+    ++counters_.rejected;
+    return ADMISSION_REJECT;
+  }
+
+  if (state.open_until_ms) {
+    // The circuit is half-open. A single request probes the host. Another
+    // probe may start if the first one never completed.
+    if (state.probe_started_ms >= 0 &&
+        now_ms - state.probe_started_ms < options_.max_delay_ms) {
+      *wait_ms = options_.max_delay_ms - (now_ms - state.probe_started_ms);
+      ++counters_.rejected;
+      return ADMISSION_REJECT;
+    }
+    state.probe_started_ms = now_ms;
+    return ADMISSION_SEND;
+  }
+
+  if (state.next_send_ms > now_ms) {
+    *wait_ms = state.next_send_ms - now_ms;
+    return ADMISSION_WAIT;
+  }
+
+  return ADMISSION_SEND;
+}
+
+void HostHealth::RecordSuccess(const std::string& host) {
+  std::lock_guard<std::mutex> lock(lock_);
+  ++counters_.successes;
+
+  // A retry after still holds the host after the request which received it.
+  auto it = hosts_.find(host);
+  if (it != hosts_.end() && it->second.retry_after_until_ms <= clock_()) {
+    hosts_.erase(it);
+  }
+}
+
+void HostHealth::RecordFailure(const std::string& host) {
+  std::lock_guard<std::mutex> lock(lock_);
+  ++counters_.failures;
+
+  const int64_t now_ms = clock_();
+  Host& state = hosts_[host];
+  ++state.consecutive_failures;
+  state.delay_ms = NextDelay(state.delay_ms);
+  state.next_send_ms = now_ms + state.delay_ms;
+
+  // A failed probe opens the circuit again.
+  const bool is_half_open =
+      state.open_until_ms && state.open_until_ms <= now_ms;
+  if (is_half_open ||
+      (!state.open_until_ms &&
+       state.consecutive_failures >= options_.failures_to_open)) {
+    state.open_until_ms = now_ms + options_.open_ms;
+    state.probe_started_ms = -1;
+    ++counters_.circuit_opens;
+  }
+}
+
+void HostHealth::RecordRetryAfter(const std::string& host,
+                                  int64_t retry_after_ms) {
+  std::lock_guard<std::mutex> lock(lock_);
+  ++counters_.retry_afters;
+
+  Host& state = hosts_[host];
+  state.retry_after_until_ms = std::max(state.retry_after_until_ms,
+                                        clock_() + retry_after_ms);
+}
+
+HostHealth::Counters HostHealth::GetCounters() const {
+  std::lock_guard<std::mutex> lock(lock_);
+  return counters_;
+}
+
+std::string HostHealth::ToString() const {
+  std::lock_guard<std::mutex> lock(lock_);
+  const int64_t now_ms = clock_();
+
+  std::ostringstream stream;
+  stream << "successes=" << counters_.successes
+         << " failures=" << counters_.failures
+         << " retry_afters=" << counters_.retry_afters
+         << " circuit_opens=" << counters_.circuit_opens
+         << " rejected=" << counters_.rejected << "\n";
+
+  for (auto it = hosts_.begin(); it != hosts_.end(); ++it) {
+    const Host& state = it->second;
+    const char* circuit = !state.open_until_ms ? "closed" :
+                          state.open_until_ms > now_ms ? "open" : "half-open";
+    stream << it->first
+           << " circuit=" << circuit
+           << " consecutive_failures=" << state.consecutive_failures
+           << " backoff_ms="
+           << std::max<int64_t>(state.next_send_ms - now_ms, 0)
+           << " retry_after_ms="
+           << std::max<int64_t>(state.retry_after_until_ms - now_ms, 0)
+           << "\n";
+  }
+  return stream.str();
+}
+
+int64_t HostHealth::NextDelay(int64_t previous_delay_ms) {
+  const int64_t low = options_.base_delay_ms;
+  const int64_t high = std::max(low, previous_delay_ms) * 3;
+  const uint32_t random = random_ ? random_() : generator_();
+  const int64_t delay_ms =
+      low + static_cast<int64_t>(random % (high - low + 1));
+  return std::min(delay_ms, options_.max_delay_ms);
+}
+
+}  // namespace omaha
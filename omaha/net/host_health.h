@@ -0,0 +1,159 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// HostHealth keeps the health of the hosts the process sends requests to, so
+// that the concurrent requests to a host share its backoff instead of each
+// one retrying on its own schedule:
+//  * after a failure, the requests to the host wait for a delay which grows
+//    with decorrelated jitter, a random value between the base delay and
+//    three times the previous delay, capped;
+//  * after repeated failures, the circuit of the host opens, and the requests
+//    fail without being sent until it closes. Then, one request probes the
+//    host, and its result closes or opens the circuit again;
+//  * a retry after received from the host holds all the requests to it.
+//
+// This file has no platform dependencies.
+
+#ifndef OMAHA_NET_HOST_HEALTH_H_
+#define OMAHA_NET_HOST_HEALTH_H_
+
+#include <stdint.h>
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+
+#include "base/basictypes.h"
+
+namespace omaha {
+
+class HostHealth {
+ public:
+  // Returns the current time in milliseconds.
+  using Clock = std::function<int64_t()>;
+
+  // Returns a random value.
+  using Random = std::function<uint32_t()>;
+
+  struct Options {
+    Options()
+        : base_delay_ms(5000),
+          max_delay_ms(100000),
+          failures_to_open(5),
+          open_ms(2 * 60 * 1000) {}
+
+    int64_t base_delay_ms;
+    int64_t max_delay_ms;
+
+    // The number of consecutive failures which open the circuit, and how
+    // long it stays open.
+    int failures_to_open;
+    int64_t open_ms;
+  };
+
+  // The counters of the process, for all the hosts.
+  struct Counters {
+    Counters()
+        : successes(0), failures(0), retry_afters(0), circuit_opens(0),
+          rejected(0) {}
+
+    uint64_t successes;
+    uint64_t failures;
+    uint64_t retry_afters;
+    uint64_t circuit_opens;
+
+    // The requests which failed without being sent.
+    uint64_t rejected;
+  };
+
+  enum Admission {
+    // The request may be sent now.
+    ADMISSION_SEND,
+
+    // The request waits for the backoff of the host, then asks again.
+    ADMISSION_WAIT,
+
+    // The request fails: the circuit of the host is open, or the host asked
+    // to retry later.
+    ADMISSION_REJECT,
+  };
+
+  // A null |random| uses a pseudo-random generator.
+  HostHealth(const Options& options, const Clock& clock, const Random& random);
+  ~HostHealth();
+
+  // Returns the instance shared by the requests of the process.
+  static HostHealth& Instance();
+
+  // Returns whether a request to |host| may be sent now. Returns in
+  // |wait_ms| how long the request waits, or how long the host is
+  // unavailable if the request is rejected.
+  Admission Admit(const std::string& host, int64_t* wait_ms);
+
+  // Records the result of a request to |host|. A request which reached the
+  // host, even if the host returned a client error, is a success. A network
+  // error or a server error is a failure.
+  void RecordSuccess(const std::string& host);
+  void RecordFailure(const std::string& host);
+
+  // Records that |host| asked to hold the requests for |retry_after_ms|.
+  void RecordRetryAfter(const std::string& host, int64_t retry_after_ms);
+
+  Counters GetCounters() const;
+
+  // Returns the counters, and the state of the hosts which are not healthy,
+  // for debugging purposes.
+  std::string ToString() const;
+
+ private:
+  struct Host {
+    Host()
+        : consecutive_failures(0), delay_ms(0), next_send_ms(0),
+          open_until_ms(0), probe_started_ms(-1), retry_after_until_ms(0) {}
+
+    int consecutive_failures;
+    int64_t delay_ms;
+    int64_t next_send_ms;
+
+    // The circuit is open until |open_until_ms|, then half-open while a
+    // request started at |probe_started_ms| probes the host.
+    int64_t open_until_ms;
+    int64_t probe_started_ms;
+
+    int64_t retry_after_until_ms;
+  };
+
+  // Returns a random delay between the base delay and three times
+  // |previous_delay_ms|, or the base delay for the first failure, capped.
+  // Called with |lock_| held.
+  int64_t NextDelay(int64_t previous_delay_ms);
+
+  const Options options_;
+  const Clock clock_;
+  const Random random_;
+
+  mutable std::mutex lock_;
+  std::map<std::string, Host> hosts_;
+  Counters counters_;
+  std::mt19937 generator_;
+
+  DISALLOW_COPY_AND_ASSIGN(HostHealth);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_NET_HOST_HEALTH_H_
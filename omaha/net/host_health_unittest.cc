@@ -0,0 +1,176 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/net/host_health.h"
+
+#include <memory>
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace omaha {
+
+class HostHealthTest : public testing::Test {
+ protected:
+  HostHealthTest() : now_ms_(0), random_(0) {
+    options_.base_delay_ms = 100;
+    options_.max_delay_ms = 1000;
+    options_.failures_to_open = 3;
+    options_.open_ms = 5000;
+  }
+
+  virtual void SetUp() {
+    health_.reset(new HostHealth(options_,
+                                 [this]() { return now_ms_; },
+                                 [this]() { return random_; }));
+  }
+
+  HostHealth::Admission Admit(const std::string& host) {
+    wait_ms_ = -1;
+    return health_->Admit(host, &wait_ms_);
+  }
+
+  HostHealth::Options options_;
+  int64_t now_ms_;
+  uint32_t random_;
+  int64_t wait_ms_;
+  std::unique_ptr<HostHealth> health_;
+};
+
+TEST_F(HostHealthTest, DecorrelatedJitter) {
+  EXPECT_EQ(HostHealth::ADMISSION_SEND, Admit("a"));
+  EXPECT_EQ(0, wait_ms_);
+
+  // The first delay is drawn between the base delay and three times the base
+  // delay.
+  random_ = 150;
+  health_->RecordFailure("a");
+  EXPECT_EQ(HostHealth::ADMISSION_WAIT, Admit("a"));
+  EXPECT_EQ(250, wait_ms_);
+
+  // The other hosts are not held.
+  EXPECT_EQ(HostHealth::ADMISSION_SEND, Admit("b"));
+
+  // The next delay is drawn between the base delay and three times the
+  // previous delay, 750 ms.
+  now_ms_ = 250;
+  EXPECT_EQ(HostHealth::ADMISSION_SEND, Admit("a"));
+  random_ = 650;
+  health_->RecordFailure("a");
+  EXPECT_EQ(HostHealth::ADMISSION_WAIT, Admit("a"));
+  EXPECT_EQ(750, wait_ms_);
+
+  // A success resets the backoff.
+  health_->RecordSuccess("a");
+  EXPECT_EQ(HostHealth::ADMISSION_SEND, Admit("a"));
+  random_ = 0;
+  health_->RecordFailure("a");
+  EXPECT_EQ(HostHealth::ADMISSION_WAIT, Admit("a"));
+  EXPECT_EQ(100, wait_ms_);
+}
+
+TEST_F(HostHealthTest, DelayIsCapped) {
+  random_ = 0xffffffff;
+  health_->RecordFailure("a");
+  health_->RecordFailure("a");
+  EXPECT_EQ(HostHealth::ADMISSION_WAIT, Admit("a"));
+  EXPECT_GE(options_.max_delay_ms, wait_ms_);
+  EXPECT_LE(options_.base_delay_ms, wait_ms_);
+}
+
+TEST_F(HostHealthTest, CircuitOpensAndProbes) {
+  health_->RecordFailure("a");
+  health_->RecordFailure("a");
+  EXPECT_EQ(HostHealth::ADMISSION_WAIT, Admit("a"));
+  health_->RecordFailure("a");
+
+  EXPECT_EQ(HostHealth::ADMISSION_REJECT, Admit("a"));
+  EXPECT_EQ(5000, wait_ms_);
+  now_ms_ = 4999;
+  EXPECT_EQ(HostHealth::ADMISSION_REJECT, Admit("a"));
+  EXPECT_EQ(1, wait_ms_);
+
+  // Once the circuit is half-open, a single request probes the host.
+  now_ms_ = 5000;
+  EXPECT_EQ(HostHealth::ADMISSION_SEND, Admit("a"));
+  EXPECT_EQ(HostHealth::ADMISSION_REJECT, Admit("a"));
+
+  // A failed probe opens the circuit again.
+  health_->RecordFailure("a");
+  EXPECT_EQ(HostHealth::ADMISSION_REJECT, Admit("a"));
+  EXPECT_EQ(5000, wait_ms_);
+
+  // A successful probe closes it.
+  now_ms_ = 10000;
+  EXPECT_EQ(HostHealth::ADMISSION_SEND, Admit("a"));
+  health_->RecordSuccess("a");
+  EXPECT_EQ(HostHealth::ADMISSION_SEND, Admit("a"));
+  EXPECT_EQ(HostHealth::ADMISSION_SEND, Admit("a"));
+
+  const HostHealth::Counters counters(health_->GetCounters());
+  EXPECT_EQ(1, counters.successes);
+  EXPECT_EQ(4, counters.failures);
+  EXPECT_EQ(2, counters.circuit_opens);
+  EXPECT_EQ(4, counters.rejected);
+}
+
+// A probe which never completes does not hold the host forever.
+TEST_F(HostHealthTest, ProbeTimesOut) {
+  health_->RecordFailure("a");
+  health_->RecordFailure("a");
+  health_->RecordFailure("a");
+
+  now_ms_ = 5000;
+  EXPECT_EQ(HostHealth::ADMISSION_SEND, Admit("a"));
+  now_ms_ = 5999;
+  EXPECT_EQ(HostHealth::ADMISSION_REJECT, Admit("a"));
+  EXPECT_EQ(1, wait_ms_);
+  now_ms_ = 6000;
+  EXPECT_EQ(HostHealth::ADMISSION_SEND, Admit("a"));
+}
+
+TEST_F(HostHealthTest, RetryAfter) {
+  health_->RecordRetryAfter("a", 3000);
+  EXPECT_EQ(HostHealth::ADMISSION_REJECT, Admit("a"));
+  EXPECT_EQ(3000, wait_ms_);
+  EXPECT_EQ(HostHealth::ADMISSION_SEND, Admit("b"));
+
+  // A shorter retry after does not shorten the hold, and a success does not
+  // end it.
+  now_ms_ = 1000;
+  health_->RecordRetryAfter("a", 1000);
+  health_->RecordSuccess("a");
+  EXPECT_EQ(HostHealth::ADMISSION_REJECT, Admit("a"));
+  EXPECT_EQ(2000, wait_ms_);
+
+  now_ms_ = 3000;
+  EXPECT_EQ(HostHealth::ADMISSION_SEND, Admit("a"));
+  EXPECT_EQ(2, health_->GetCounters().retry_afters);
+}
+
+TEST_F(HostHealthTest, ToString) {
+  health_->RecordFailure("a");
+  health_->RecordRetryAfter("b", 2000);
+
+  const std::string dump(health_->ToString());
+  EXPECT_NE(std::string::npos, dump.find("failures=1"));
+  EXPECT_NE(std::string::npos, dump.find("retry_afters=1"));
+  EXPECT_NE(std::string::npos, dump.find(
+      "a circuit=closed consecutive_failures=1 backoff_ms=100"));
+  EXPECT_NE(std::string::npos, dump.find("b circuit=closed"));
+  EXPECT_NE(std::string::npos, dump.find("retry_after_ms=2000"));
+}
+
+}  // namespace omaha
@@ -36,6 +36,20 @@ namespace omaha {
 class NetworkRequestCallback;
 struct DownloadMetrics;
 
+// Observes the body of a response as it is received, before it is stored.
+class ResponseObserver {
+ public:
+  virtual ~ResponseObserver() {}
+
+  // Called before the body of each response is received. |offset| is the
+  // offset in the body of the first byte which follows. It is 0 unless a
+  // paused or resumable download resumes from the bytes it has already
+  // stored.
+  virtual void OnResponseStart(uint64 offset) = 0;
+
+  virtual void OnResponseData(const uint8* data, size_t size) = 0;
+};
+
 class HttpRequestInterface {
  public:
   virtual ~HttpRequestInterface() {}
@@ -80,6 +94,20 @@ class HttpRequestInterface {
 
   virtual void set_callback(NetworkRequestCallback* callback) = 0;
 
+  // Sets an observer of the response body. Requests which do not receive the
+  // body themselves never call the observer.
+  virtual void set_response_observer(ResponseObserver* observer) = 0;
+
+  // Makes a download to a file resumable: the file is kept when the download
+  // fails, and the next send resumes after the bytes the file holds. If
+  // |offset| is not 0, the file holds the first |offset| bytes of a body of
+  // |content_length| bytes from an earlier download, and the first send
+  // resumes after them. Requests which do not receive the body themselves
+  // download the whole body again.
+  virtual void set_resumable(bool is_resumable,
+                             int content_length,
+                             int offset) = 0;
+
   virtual void set_additional_headers(const CString& additional_headers) = 0;
 
   // Gets the user agent for this http request. The default user agent has
@@ -15,12 +15,14 @@
 
 #include "omaha/net/net_utils.h"
 
+#include <winsock2.h>
 #include <iphlpapi.h>
 #include <intsafe.h>
 #include <memory>
 
 #include "omaha/base/const_addresses.h"
 #include "omaha/base/logging.h"
+#include "omaha/base/safe_format.h"
 #include "omaha/base/utils.h"
 
 namespace omaha {
@@ -57,6 +59,61 @@ bool IsMachineConnectedToNetwork() {
   return active_LAN || active_WAN;
 }
 
+CString GetNetworkFingerprint() {
+  const ULONG flags = GAA_FLAG_INCLUDE_GATEWAYS |
+                      GAA_FLAG_SKIP_UNICAST |
+                      GAA_FLAG_SKIP_ANYCAST |
+                      GAA_FLAG_SKIP_MULTICAST |
+                      GAA_FLAG_SKIP_DNS_SERVER;
+
+  // The table may grow between the calls, if an adapter is added.
+  ULONG buffer_size = 16 * 1024;
+  std::unique_ptr<char[]> buffer;
+  ULONG result = ERROR_BUFFER_OVERFLOW;
+  for (int i = 0; i != 3 && result == ERROR_BUFFER_OVERFLOW; ++i) {
+    buffer.reset(new char[buffer_size]);
+    result = ::GetAdaptersAddresses(
+        AF_UNSPEC,
+        flags,
+        NULL,
+        reinterpret_cast<IP_ADAPTER_ADDRESSES*>(buffer.get()),
+        &buffer_size);
+  }
+  if (result != NO_ERROR) {
+    NET_LOG(LW, (_T("[GetAdaptersAddresses failed][%d]"), result));
+    return CString();
+  }
+
+  CString fingerprint;
+  for (const IP_ADAPTER_ADDRESSES* adapter =
+           reinterpret_cast<const IP_ADAPTER_ADDRESSES*>(buffer.get());
+       adapter;
+       adapter = adapter->Next) {
+    if (adapter->OperStatus != IfOperStatusUp ||
+        adapter->IfType == IF_TYPE_SOFTWARE_LOOPBACK) {
+      continue;
+    }
+
+    SafeCStringAppendFormat(&fingerprint, _T("%S;%s"),
+                            adapter->AdapterName,
+                            adapter->DnsSuffix);
+    for (const IP_ADAPTER_GATEWAY_ADDRESS* gateway =
+             adapter->FirstGatewayAddress;
+         gateway;
+         gateway = gateway->Next) {
+      const uint8* address =
+          reinterpret_cast<const uint8*>(gateway->Address.lpSockaddr);
+      fingerprint.AppendChar(_T(';'));
+      for (int j = 0; j != gateway->Address.iSockaddrLength; ++j) {
+        SafeCStringAppendFormat(&fingerprint, _T("%02x"), address[j]);
+      }
+    }
+    fingerprint.AppendChar(_T('|'));
+  }
+
+  return fingerprint;
+}
+
 CString BufferToPrintableString(const void* buffer, size_t length) {
   CString result;
   if (!buffer || length > INT_MAX) {
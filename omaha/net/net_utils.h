@@ -31,6 +31,12 @@ namespace omaha {
 // and it returns true as well.
 bool IsMachineConnectedToNetwork();
 
+// Returns a fingerprint of the networks the machine is connected to, made of
+// the DNS suffixes and the gateways of the adapters which are up. The
+// fingerprint changes when the machine moves to another network. Returns an
+// empty string if the adapters can't be enumerated.
+CString GetNetworkFingerprint();
+
 // Converts a buffer or a vector to a string for logging purposes.
 // Non-printable characters are converted to '.'.
 CString BufferToPrintableString(const void* buffer, size_t length);
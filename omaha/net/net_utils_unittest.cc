@@ -24,6 +24,13 @@ TEST(NetUtilsTest, IsMachineConnectedToNetwork) {
   EXPECT_TRUE(IsMachineConnectedToNetwork());
 }
 
+// The fingerprint is stable while the machine stays on the same network.
+TEST(NetUtilsTest, GetNetworkFingerprint) {
+  const CString fingerprint(GetNetworkFingerprint());
+  EXPECT_FALSE(fingerprint.IsEmpty());
+  EXPECT_STREQ(fingerprint, GetNetworkFingerprint());
+}
+
 TEST(NetUtilsTest, BufferToPrintableString) {
   EXPECT_STREQ(_T(""), BufferToPrintableString(NULL, 0));
 
@@ -27,6 +27,7 @@
 #include "base/error.h"
 #include "base/scope_guard.h"
 #include "omaha/base/browser_utils.h"
+#include "omaha/base/const_addresses.h"
 #include "omaha/base/const_object_names.h"
 #include "omaha/base/constants.h"
 #include "omaha/base/debug.h"
@@ -37,14 +38,18 @@
 #include "omaha/base/path.h"
 #include "omaha/base/reg_key.h"
 #include "omaha/base/safe_format.h"
+#include "omaha/base/scoped_impersonation.h"
 #include "omaha/base/string.h"
 #include "omaha/base/system.h"
 #include "omaha/base/system_info.h"
+#include "omaha/base/time.h"
 #include "omaha/base/user_info.h"
 #include "omaha/base/utils.h"
 #include "omaha/common/config_manager.h"
 #include "omaha/common/const_goopdate.h"
+#include "omaha/common/shard_runner.h"
 #include "omaha/net/http_client.h"
+#include "omaha/net/net_utils.h"
 #include "omaha/net/winhttp.h"
 
 using omaha::encrypt::EncryptData;
@@ -68,6 +73,32 @@ size_t hash_value(const ProxyConfig& config) {
   return hash;
 }
 
+namespace {
+
+// How long the detected configurations, and the proxy information for a
+// host, are cached. Proxy auto-detection and PAC scripts may take seconds.
+const int64 kDetectionCacheTtlMs = 5 * kMsPerSec * kSecPerMin;
+const int64 kProxyForUrlCacheTtlMs = 5 * kMsPerSec * kSecPerMin;
+
+const char kDetectionCacheKey[] = "detectors";
+
+// Returns a copy of |str| which the caller frees with GlobalFree, as WinHttp
+// returns the strings of a WINHTTP_PROXY_INFO, or NULL if |str| is empty.
+const TCHAR* GlobalAllocString(const CString& str) {
+  if (str.IsEmpty()) {
+    return NULL;
+  }
+
+  const size_t size = (str.GetLength() + 1) * sizeof(TCHAR);
+  TCHAR* buffer = reinterpret_cast<TCHAR*>(::GlobalAlloc(GPTR, size));
+  if (buffer) {
+    memcpy(buffer, str.GetString(), size);
+  }
+  return buffer;
+}
+
+}  // namespace
+
 const TCHAR* const NetworkConfig::kUserAgent = _T("Google Update/%s");
 
 const TCHAR* const NetworkConfig::kRegKeyProxy = GOOPDATE_MAIN_KEY _T("proxy");
@@ -78,6 +109,8 @@ const TCHAR* const NetworkConfig::kDirectConnectionIdentifier = _T("direct");
 
 NetworkConfig::NetworkConfig(bool is_machine)
     : is_machine_(is_machine),
+      detection_cache_(kDetectionCacheTtlMs, 1),
+      proxy_for_url_cache_(kProxyForUrlCacheTtlMs, kMaxCachedProxyForUrl),
       is_initialized_(false) {}
 
 NetworkConfig::~NetworkConfig() {
@@ -169,24 +202,94 @@ void NetworkConfig::Clear() {
     detectors_.clear();
     configurations_.clear();
   }
+  detection_cache_.Clear();
+  proxy_for_url_cache_.Clear();
 }
 
 HRESULT NetworkConfig::Detect() {
+  const std::string fingerprint(WideToUtf8(GetDetectionFingerprint()));
+  std::vector<ProxyConfig> configurations;
+  if (!fingerprint.empty() &&
+      detection_cache_.Get(kDetectionCacheKey,
+                           fingerprint,
+                           GetCurrentMsTime(),
+                           &configurations)) {
+    NET_LOG(L3, (_T("[NetworkConfig::Detect][cached]")));
+    __mutexBlock(lock_) {
+      configurations_.swap(configurations);
+    }
+    return S_OK;
+  }
+
   __mutexBlock(lock_) {
-    std::vector<ProxyConfig> configurations;
+    configurations = RunDetectors(detectors_);
+    configurations_ = configurations;
+  }
 
-    for (size_t i = 0; i != detectors_.size(); ++i) {
-      ProxyConfig config;
-      if (SUCCEEDED(detectors_[i]->Detect(&config))) {
-        configurations.push_back(config);
-      }
-    }
-    configurations_.swap(configurations);
+  if (!fingerprint.empty()) {
+    detection_cache_.Put(kDetectionCacheKey,
+                         fingerprint,
+                         GetCurrentMsTime(),
+                         configurations);
   }
 
   return S_OK;
 }
 
+std::vector<ProxyConfig> NetworkConfig::RunDetectors(
+    const std::vector<ProxyDetectorInterface*>& detectors) {
+  // The IE detectors read the settings of the user this thread impersonates.
+  CAccessToken impersonation_token;
+  if (!impersonation_token.GetThreadToken(
+          TOKEN_QUERY | TOKEN_IMPERSONATE | TOKEN_DUPLICATE)) {
+    const HRESULT hr = HRESULTFromLastError();
+    if (hr != HRESULT_FROM_WIN32(ERROR_NO_TOKEN)) {
+      NET_LOG(LE, (_T("[GetThreadToken failed][0x%08x]"), hr));
+      return std::vector<ProxyConfig>();
+    }
+  }
+
+  // Each detector runs once: a detector which fails is not retried.
+  std::vector<ProxyConfig> detected(detectors.size());
+  const HANDLE token = impersonation_token.GetHandle();
+  ShardRunner runner(kMaxConcurrentDetectors, 0);
+  const std::vector<bool> succeeded = runner.Run(
+      detectors.size(),
+      [&detectors, &detected, token](size_t i, int) {
+        scoped_impersonation impersonate_user(token);
+        if (FAILED(impersonate_user.result())) {
+          return false;
+        }
+        return SUCCEEDED(detectors[i]->Detect(&detected[i]));
+      });
+
+  std::vector<ProxyConfig> configurations;
+  for (size_t i = 0; i != detectors.size(); ++i) {
+    if (succeeded[i]) {
+      configurations.push_back(detected[i]);
+    }
+  }
+  return configurations;
+}
+
+CString NetworkConfig::GetDetectionFingerprint() {
+  CString fingerprint(GetNetworkFingerprint());
+  if (fingerprint.IsEmpty()) {
+    return fingerprint;
+  }
+
+  // The proxy policies may change while the process runs, for instance when
+  // the device management policies are fetched.
+  CString proxy_mode, proxy_pac_url, proxy_server;
+  ConfigManager* config_manager = ConfigManager::Instance();
+  config_manager->GetProxyMode(&proxy_mode, NULL);
+  config_manager->GetProxyPacUrl(&proxy_pac_url, NULL);
+  config_manager->GetProxyServer(&proxy_server, NULL);
+  SafeCStringAppendFormat(&fingerprint, _T("%s;%s;%s"),
+                          proxy_mode, proxy_pac_url, proxy_server);
+  return fingerprint;
+}
+
 void NetworkConfig::SortProxies(std::vector<ProxyConfig>* configurations) {
   ASSERT1(configurations);
 
@@ -377,6 +480,48 @@ HRESULT NetworkConfig::GetProxyForUrl(const CString& url,
 
   NET_LOG(L3, (_T("[NetworkConfig::GetProxyForUrl][%s]"), url));
 
+  CString key;
+  SafeCStringFormat(&key, _T("%s://%s|%d|%s"),
+                    IsHttpsUrl(url) ? kHttpsProtoScheme : kHttpProtoScheme,
+                    GetUriHostNameHostOnly(url, false),
+                    use_wpad,
+                    auto_config_url);
+  const std::string cache_key(WideToUtf8(key));
+  const std::string fingerprint(WideToUtf8(GetNetworkFingerprint()));
+
+  CachedProxyInfo cached;
+  if (!fingerprint.empty() &&
+      proxy_for_url_cache_.Get(cache_key,
+                               fingerprint,
+                               GetCurrentMsTime(),
+                               &cached)) {
+    NET_LOG(L3, (_T("[GetProxyForUrl][cached][%s]"), cached.proxy));
+    proxy_info->access_type = cached.access_type;
+    proxy_info->proxy = GlobalAllocString(cached.proxy);
+    proxy_info->proxy_bypass = GlobalAllocString(cached.proxy_bypass);
+    return S_OK;
+  }
+
+  HRESULT hr = DoGetProxyForUrl(url, use_wpad, auto_config_url, proxy_info);
+  if (SUCCEEDED(hr) && !fingerprint.empty()) {
+    cached.access_type = proxy_info->access_type;
+    cached.proxy = proxy_info->proxy;
+    cached.proxy_bypass = proxy_info->proxy_bypass;
+    proxy_for_url_cache_.Put(cache_key,
+                             fingerprint,
+                             GetCurrentMsTime(),
+                             cached);
+  }
+
+  return hr;
+}
+
+HRESULT NetworkConfig::DoGetProxyForUrl(const CString& url,
+                                        bool use_wpad,
+                                        const CString& auto_config_url,
+                                        HttpClient::ProxyInfo* proxy_info) {
+  ASSERT1(proxy_info);
+
   HRESULT hr = E_FAIL;
 
   if (use_wpad) {
@@ -30,6 +30,7 @@
 #include "omaha/net/detector.h"
 #include "omaha/net/http_client.h"
 #include "omaha/net/proxy_auth.h"
+#include "omaha/net/timed_cache.h"
 #include "omaha/third_party/smartany/scoped_any.h"
 
 namespace ATL {
@@ -107,6 +108,10 @@ class NetworkConfig {
   void Clear();
 
   // Detects the network configuration for each of the registered detectors.
+  // The detectors run concurrently, and the configurations are kept in the
+  // order of the detectors. The configurations are cached for a few minutes,
+  // as long as the machine stays on the same network and the proxy policies
+  // do not change.
   HRESULT Detect();
 
   // Detects the network configuration for the given source.
@@ -154,7 +159,9 @@ class NetworkConfig {
   // Runs a PAC script to compute the proxy information to be used
   // for the given url. The PAC script can be explicitly set, or discovered
   // via WPAD. (If both are specified, we try the URL first, then WPAD.)
-  // The ProxyInfo pointer members must be freed using GlobalFree.
+  // The ProxyInfo pointer members must be freed using GlobalFree. The result
+  // is cached for the scheme and host of the url, as long as the machine
+  // stays on the same network.
   HRESULT GetProxyForUrl(const CString& url,
                          bool use_wpad,
                          const CString& auto_config_url,
@@ -210,9 +217,41 @@ class NetworkConfig {
   static const TCHAR* const kDirectConnectionIdentifier;
 
  private:
+  // The proxy information returned by a PAC script, as it is cached.
+  struct CachedProxyInfo {
+    CachedProxyInfo() : access_type(0) {}
+
+    uint32 access_type;
+    CString proxy;
+    CString proxy_bypass;
+  };
+
+  enum {
+    // The number of detectors which run at a time.
+    kMaxConcurrentDetectors = 4,
+
+    // The number of hosts for which the proxy information is cached.
+    kMaxCachedProxyForUrl = 64,
+  };
+
   explicit NetworkConfig(bool is_machine);
   ~NetworkConfig();
 
+  // Runs |detectors| concurrently, and returns the configurations they
+  // detect in the order of |detectors|. The threads which run the detectors
+  // impersonate the user the calling thread impersonates, if any.
+  static std::vector<ProxyConfig> RunDetectors(
+      const std::vector<ProxyDetectorInterface*>& detectors);
+
+  // Returns the fingerprint which the cached configurations are valid for,
+  // or an empty string if they can't be cached.
+  static CString GetDetectionFingerprint();
+
+  HRESULT DoGetProxyForUrl(const CString& url,
+                           bool use_wpad,
+                           const CString& auto_config_url,
+                           HttpClient::ProxyInfo* proxy_info);
+
   HRESULT Initialize();
 
   // Configures the proxy auth credentials options. Called by Initialize().
@@ -246,6 +285,11 @@ class NetworkConfig {
   std::vector<ProxyConfig> configurations_;
   std::vector<ProxyDetectorInterface*> detectors_;
 
+  // Caches the configurations of the detectors, and the proxy information
+  // for each host. Cleared by Clear().
+  TimedCache<std::vector<ProxyConfig>> detection_cache_;
+  TimedCache<CachedProxyInfo> proxy_for_url_cache_;
+
   // Synchronizes access to per-process instance data, which includes
   // the detectors and configurations.
   LLock lock_;
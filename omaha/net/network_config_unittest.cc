@@ -27,11 +27,62 @@
 #include "omaha/common/const_group_policy.h"
 #include "omaha/goopdate/dm_messages.h"
 #include "omaha/net/http_client.h"
+#include "omaha/net/net_utils.h"
 #include "omaha/net/network_config.h"
 #include "omaha/testing/unit_test.h"
 
 namespace omaha {
 
+namespace {
+
+// Detects a configuration after a delay, and counts how many detectors run at
+// the same time.
+class FakeProxyDetector : public ProxyDetectorInterface {
+ public:
+  struct Counters {
+    Counters() : num_calls(0), num_running(0), max_running(0) {}
+
+    volatile LONG num_calls;
+    volatile LONG num_running;
+    volatile LONG max_running;
+  };
+
+  FakeProxyDetector(const TCHAR* source, bool succeeds, Counters* counters)
+      : source_(source), succeeds_(succeeds), counters_(counters) {}
+
+  HRESULT Detect(ProxyConfig* config) override {
+    ::InterlockedIncrement(&counters_->num_calls);
+    const LONG num_running = ::InterlockedIncrement(&counters_->num_running);
+    for (LONG max_running = counters_->max_running;
+         num_running > max_running;
+         max_running = counters_->max_running) {
+      ::InterlockedCompareExchange(&counters_->max_running,
+                                   num_running,
+                                   max_running);
+    }
+    ::Sleep(100);
+    ::InterlockedDecrement(&counters_->num_running);
+
+    if (!succeeds_) {
+      return E_FAIL;
+    }
+    *config = ProxyConfig();
+    config->source = source_;
+    return S_OK;
+  }
+
+  const TCHAR* source() override { return source_; }
+
+ private:
+  const TCHAR* source_;
+  bool succeeds_;
+  Counters* counters_;
+
+  DISALLOW_COPY_AND_ASSIGN(FakeProxyDetector);
+};
+
+}  // namespace
+
 class NetworkConfigTest : public testing::Test {
  protected:
   NetworkConfigTest() {}
@@ -184,6 +235,40 @@ TEST_F(NetworkConfigTest, ConfigurationOverride) {
   EXPECT_EQ(E_FAIL, network_config->GetConfigurationOverride(&actual));
 }
 
+TEST_F(NetworkConfigTest, DetectRunsDetectorsConcurrently) {
+  NetworkConfig* network_config = NULL;
+  ASSERT_HRESULT_SUCCEEDED(
+      NetworkConfigManager::Instance().GetUserNetworkConfig(&network_config));
+
+  FakeProxyDetector::Counters counters;
+  network_config->Clear();
+  network_config->Add(new FakeProxyDetector(_T("a"), true, &counters));
+  network_config->Add(new FakeProxyDetector(_T("b"), false, &counters));
+  network_config->Add(new FakeProxyDetector(_T("c"), true, &counters));
+  network_config->Add(new FakeProxyDetector(_T("d"), true, &counters));
+
+  // The configurations are in the order of the detectors.
+  EXPECT_HRESULT_SUCCEEDED(network_config->Detect());
+  std::vector<ProxyConfig> configurations(
+      network_config->GetConfigurations());
+  ASSERT_EQ(3, configurations.size());
+  EXPECT_STREQ(_T("a"), configurations[0].source);
+  EXPECT_STREQ(_T("c"), configurations[1].source);
+  EXPECT_STREQ(_T("d"), configurations[2].source);
+  EXPECT_EQ(4, counters.num_calls);
+  EXPECT_LT(1, counters.max_running);
+
+  // The detectors do not run again while the machine stays on the same
+  // network.
+  if (!GetNetworkFingerprint().IsEmpty()) {
+    EXPECT_HRESULT_SUCCEEDED(network_config->Detect());
+    EXPECT_EQ(3, network_config->GetConfigurations().size());
+    EXPECT_EQ(4, counters.num_calls);
+  }
+
+  NetworkConfigManager::DeleteInstance();
+}
+
 TEST_F(NetworkConfigTest, GetProxyForUrlLocal) {
   CString pac_file_path = app_util::GetModuleDirectory(NULL);
   ASSERT_FALSE(pac_file_path.IsEmpty());
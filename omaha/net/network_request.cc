@@ -89,6 +89,16 @@ void NetworkRequest::set_callback(NetworkRequestCallback* callback) {
   return impl_->set_callback(callback);
 }
 
+void NetworkRequest::set_response_observer(ResponseObserver* observer) {
+  return impl_->set_response_observer(observer);
+}
+
+void NetworkRequest::set_resumable(bool is_resumable,
+                                   int content_length,
+                                   int offset) {
+  return impl_->set_resumable(is_resumable, content_length, offset);
+}
+
 CString NetworkRequest::response_headers() const {
   return impl_->response_headers();
 }
@@ -111,6 +121,10 @@ void NetworkRequest::set_low_priority(bool low_priority) {
   return impl_->set_low_priority(low_priority);
 }
 
+void NetworkRequest::set_host_health(HostHealth* host_health) {
+  return impl_->set_host_health(host_health);
+}
+
 void NetworkRequest::set_proxy_configuration(
     const ProxyConfig* proxy_configuration) {
   return impl_->set_proxy_configuration(proxy_configuration);
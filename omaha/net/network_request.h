@@ -59,7 +59,9 @@ class NetworkRequestCallback {
   virtual void OnRequestRetryScheduled(time64 next_retry_time) = 0;
 };
 
+class  HostHealth;
 class  HttpRequestInterface;
+class  ResponseObserver;
 
 // NetworkRequest is the main interface to the net module. The semantics of
 // the interface is defined as transferring bytes from a url, with an optional
@@ -180,6 +182,20 @@ class NetworkRequest {
   // prioritization of requests.
   void set_low_priority(bool low_priority);
 
+  // Sets an observer of the body of the responses. The ownership of the
+  // observer remains with the caller.
+  void set_response_observer(ResponseObserver* observer);
+
+  // Makes DownloadFile keep the file when the download fails, and resume
+  // after the first |offset| bytes of a body of |content_length| bytes which
+  // the file holds. See HttpRequestInterface::set_resumable.
+  void set_resumable(bool is_resumable, int content_length, int offset);
+
+  // Sets the health of the hosts the request shares with other requests. The
+  // ownership of the object remains with the caller. By default, the requests
+  // of the process share HostHealth::Instance().
+  void set_host_health(HostHealth* host_health);
+
   // Overrides detecting the network configuration and uses the configuration
   // specified. If parameter is NULL, it defaults to detecting the configuration
   // automatically.
@@ -21,6 +21,7 @@
 #include <algorithm>
 #include <cctype>
 #include <functional>
+#include <string>
 #include <vector>
 #include "base/basictypes.h"
 #include "base/rand_util.h"
@@ -83,6 +84,13 @@ void LogFileBytes(const CString& filename, size_t num_bytes) {
   NET_LOG(L3, (_T("[file bytes: %hs]"), &bytes.front()));
 }
 
+// Returns the key of the host of the url in the health of the hosts.
+std::string GetHostHealthKey(const CString& url) {
+  CString host(GetUriHostNameHostOnly(url, false));
+  host.MakeLower();
+  return std::string(WideToUtf8(host));
+}
+
 NetworkRequestImpl::NetworkRequestImpl(
     const NetworkConfig::Session& network_session)
       : request_buffer_(NULL),
@@ -92,6 +100,10 @@ NetworkRequestImpl::NetworkRequestImpl(
         low_priority_(false),
         initial_retry_delay_ms_(kDefaultTimeBetweenRetriesMs),
         retry_delay_jitter_ms_(kDefaultRetryTimeJitterMs),
+        response_observer_(NULL),
+        is_resumable_(false),
+        resume_content_length_(0),
+        resume_offset_(0),
         http_status_code_(0),
         response_(NULL),
         network_session_(network_session),
@@ -104,7 +116,8 @@ NetworkRequestImpl::NetworkRequestImpl(
         cur_retry_count_(0),
         cur_retry_delay_ms_(kDefaultTimeBetweenRetriesMs),
         http_attempts_(0),
-        is_canceled_(false) {
+        is_canceled_(false),
+        host_health_(&HostHealth::Instance()) {
   // NetworkConfig::Initialize must be called before using NetworkRequest.
   // If Winhttp cannot be loaded, this handle will be NULL.
   if (!network_session.session_handle) {
@@ -281,6 +294,13 @@ HRESULT NetworkRequestImpl::DoSendWithRetries() {
       return hr;
     }
 
+    // Other requests to the same host may have failed in the meantime, in
+    // which case this request backs off with them.
+    hr = DoWaitForHost();
+    if (FAILED(hr)) {
+      return hr;
+    }
+
     // Do proxy detection, and attempt to do an HTTP request with every
     // configuration we've found.
     DetectProxyConfiguration(&proxy_configurations_);
@@ -289,6 +309,7 @@ HRESULT NetworkRequestImpl::DoSendWithRetries() {
                  NetworkConfig::ToString(proxy_configurations_)));
 
     hr = DoSend(&http_status_code, &response_headers, &response);
+    RecordHostHealth(hr, http_status_code);
 
     // Exit from the loop if we got a successful request, or a HTTP 4xx error
     // (4xx implies that something has changed on the server and that this URL
@@ -516,6 +537,10 @@ HRESULT NetworkRequestImpl::DoSendHttpRequest(
   cur_http_request_->set_filename(filename_);
   cur_http_request_->set_low_priority(low_priority_);
   cur_http_request_->set_callback(callback_);
+  cur_http_request_->set_response_observer(response_observer_);
+  cur_http_request_->set_resumable(is_resumable_,
+                                   resume_content_length_,
+                                   resume_offset_);
   cur_http_request_->set_additional_headers(BuildPerRequestHeaders());
   cur_http_request_->set_proxy_configuration(*cur_proxy_config_);
   cur_http_request_->set_proxy_auth_config(proxy_auth_config_);
@@ -727,6 +752,88 @@ HRESULT NetworkRequestImpl::DoWaitBetweenRetries() {
   }
 }
 
+HRESULT NetworkRequestImpl::DoWaitForHost() {
+  const std::string host(GetHostHealthKey(url_));
+  if (host.empty()) {
+    return S_OK;
+  }
+
+  for (;;) {
+    int64 wait_ms = 0;
+    switch (host_health_->Admit(host, &wait_ms)) {
+      case HostHealth::ADMISSION_SEND:
+        return S_OK;
+
+      case HostHealth::ADMISSION_REJECT:
+        NET_LOG(LW, (_T("[host unavailable][%s][%I64d ms]"), url_, wait_ms));
+        SafeCStringAppendFormat(&trace_,
+                                _T("Host unavailable for %I64d ms.\r\n"),
+                                wait_ms);
+        return OMAHA_NET_E_HOST_UNAVAILABLE;
+
+      case HostHealth::ADMISSION_WAIT:
+        break;
+
+      default:
+        ASSERT1(false);
+        return E_UNEXPECTED;
+    }
+
+    NET_LOG(L3, (_T("[wait %I64d ms for the host]"), wait_ms));
+    switch (::WaitForSingleObject(get(event_cancel_),
+                                  static_cast<DWORD>(wait_ms))) {
+      case WAIT_TIMEOUT:
+        break;
+
+      case WAIT_OBJECT_0:
+        return GOOPDATE_E_CANCELLED;
+
+      case WAIT_FAILED:
+        return HRESULTFromLastError();
+
+      default:
+        return E_UNEXPECTED;
+    }
+  }
+}
+
+void NetworkRequestImpl::RecordHostHealth(HRESULT hr, int http_status_code) {
+  // These results say nothing about the host.
+  if (hr == GOOPDATE_E_CANCELLED ||
+      hr == CI_E_BITS_DISABLED ||
+      hr == GOOPDATE_E_NO_NETWORK) {
+    return;
+  }
+
+  const std::string host(GetHostHealthKey(url_));
+  if (host.empty()) {
+    return;
+  }
+
+  // Only a failed request shares the retry after of the server. The retry
+  // after of a successful update check is handled by the worker, which must
+  // not hold the other requests to the host, such as the pings.
+  if (FAILED(hr) && retry_after_seconds_ > 0) {
+    const int retry_after_seconds = std::min(retry_after_seconds_,
+                                             kSecondsPerDay);
+    host_health_->RecordRetryAfter(
+        host, static_cast<int64>(retry_after_seconds) * kMsPerSec);
+    return;
+  }
+
+  // A host which returns a response other than a server error is healthy,
+  // even if the request failed.
+  if (SUCCEEDED(hr) ||
+      (http_status_code &&
+       HttpClient::GetStatusCodeClass(http_status_code) !=
+           HttpClient::STATUS_CODE_SERVER_ERROR)) {
+    host_health_->RecordSuccess(host);
+  } else {
+    host_health_->RecordFailure(host);
+    NET_LOG(L3, (_T("[host health][%hs]"), host_health_->ToString().c_str()));
+  }
+}
+
 void NetworkRequestImpl::ComputeNextRetryDelay(
     HttpClient::StatusCodeClass previous_result) {
   // If the result of the previous attempt was an HTTP 5xx error, we need to
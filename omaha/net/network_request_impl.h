@@ -22,6 +22,7 @@
 
 #include "base/basictypes.h"
 #include "omaha/base/synchronized.h"
+#include "omaha/net/host_health.h"
 #include "omaha/net/network_config.h"
 #include "omaha/net/network_request.h"
 #include "omaha/net/http_request.h"
@@ -90,6 +91,21 @@ class NetworkRequestImpl {
 
   void set_low_priority(bool low_priority) { low_priority_ = low_priority; }
 
+  void set_response_observer(ResponseObserver* observer) {
+    response_observer_ = observer;
+  }
+
+  void set_resumable(bool is_resumable, int content_length, int offset) {
+    is_resumable_ = is_resumable;
+    resume_content_length_ = content_length;
+    resume_offset_ = offset;
+  }
+
+  void set_host_health(HostHealth* host_health) {
+    ASSERT1(host_health);
+    host_health_ = host_health;
+  }
+
   void set_proxy_configuration(const ProxyConfig* proxy_configuration) {
     if (proxy_configuration) {
       proxy_configuration_.reset(new ProxyConfig);
@@ -147,6 +163,14 @@ class NetworkRequestImpl {
   // beginning and end of the wait.
   HRESULT DoWaitBetweenRetries();
 
+  // Waits for the backoff shared by the requests to the host of the url.
+  // Returns OMAHA_NET_E_HOST_UNAVAILABLE without waiting if the host is not
+  // available.
+  HRESULT DoWaitForHost();
+
+  // Records the result of an attempt in the health of the host of the url.
+  void RecordHostHealth(HRESULT hr, int http_status_code);
+
   // Adjusts the delay until the next retry, given the current retry status
   // and the result of the previous network attempt.
   void ComputeNextRetryDelay(HttpClient::StatusCodeClass previous_result);
@@ -177,6 +201,10 @@ class NetworkRequestImpl {
   bool     low_priority_;
   int      initial_retry_delay_ms_;
   int      retry_delay_jitter_ms_;
+  ResponseObserver* response_observer_;
+  bool     is_resumable_;
+  int      resume_content_length_;
+  int      resume_offset_;
 
   // Output data members.
   int      http_status_code_;
@@ -221,6 +249,10 @@ class NetworkRequestImpl {
 
   std::vector<DownloadMetrics> download_metrics_;
 
+  // The health of the hosts, shared by the requests of the process unless a
+  // test sets its own. Not owned.
+  HostHealth* host_health_;
+
   static const int kDefaultTimeBetweenRetriesMs      = 5000;    // 5 seconds.
   static const int kServerErrMinTimeBetweenRetriesMs = 20000;   // 20 seconds.
   static const int kMaxTimeBetweenRetriesMs          = 100000;  // 100 seconds.
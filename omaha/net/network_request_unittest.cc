@@ -15,6 +15,7 @@
 
 #include <windows.h>
 #include <winhttp.h>
+#include <limits.h>
 #include <memory>
 #include <vector>
 
@@ -30,6 +31,7 @@
 #include "omaha/base/vista_utils.h"
 #include "omaha/net/bits_request.h"
 #include "omaha/net/cup_ecdsa_request.h"
+#include "omaha/net/host_health.h"
 #include "omaha/net/network_config.h"
 #include "omaha/net/network_request.h"
 #include "omaha/net/simple_request.h"
@@ -80,6 +82,18 @@ class NetworkRequestTest
 
     network_request_.reset(new NetworkRequest(network_config->session()));
     network_request_->set_retry_delay_jitter(0);
+
+    // The negative tests fail repeatedly on the same host, so each test has
+    // its own host health, with short delays, which never opens circuits.
+    HostHealth::Options options;
+    options.base_delay_ms = 10;
+    options.max_delay_ms = 100;
+    options.failures_to_open = INT_MAX;
+    host_health_.reset(new HostHealth(
+        options,
+        []() { return static_cast<int64_t>(GetCurrentMsTime()); },
+        HostHealth::Random()));
+    network_request_->set_host_health(host_health_.get());
   }
 
   virtual void TearDown() {}
@@ -274,6 +288,7 @@ class NetworkRequestTest
               network_request_->Get(url, &response));
   }
 
+  std::unique_ptr<HostHealth> host_health_;
   std::unique_ptr<NetworkRequest> network_request_;
   static HANDLE token_;
 };
@@ -381,4 +396,38 @@ TEST_F(NetworkRequestTest, CancelTest_Get) {
   CancelTest_GetHelper();
 }
 
+// Once the circuit of a host opens, the requests to the host fail without
+// being sent, until the circuit closes.
+TEST_F(NetworkRequestTest, HostUnavailable) {
+  int64_t now_ms = 0;
+  HostHealth::Options options;
+  options.failures_to_open = 1;
+  HostHealth host_health(options,
+                         [&now_ms]() { return now_ms; },
+                         HostHealth::Random());
+  network_request_->set_host_health(&host_health);
+  network_request_->AddHttpRequest(new SimpleRequest);
+
+  ProxyConfig config;
+  network_request_->set_proxy_configuration(&config);
+  network_request_->set_num_retries(0);
+  std::vector<uint8> response;
+
+  const CString url = _T("http://nohost/nofile");
+  EXPECT_HRESULT_FAILED(network_request_->Get(url, &response));
+  EXPECT_EQ(1, host_health.GetCounters().circuit_opens);
+
+  EXPECT_EQ(OMAHA_NET_E_HOST_UNAVAILABLE,
+            network_request_->Get(url, &response));
+  EXPECT_EQ(OMAHA_NET_E_HOST_UNAVAILABLE,
+            network_request_->Get(_T("http://NOHOST/otherfile"), &response));
+  EXPECT_EQ(2, host_health.GetCounters().rejected);
+
+  // The half-open circuit lets the request probe the host.
+  now_ms = options.open_ms;
+  const HRESULT hr = network_request_->Get(url, &response);
+  EXPECT_HRESULT_FAILED(hr);
+  EXPECT_NE(OMAHA_NET_E_HOST_UNAVAILABLE, hr);
+}
+
 }  // namespace omaha
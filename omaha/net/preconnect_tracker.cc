@@ -0,0 +1,135 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/net/preconnect_tracker.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace omaha {
+
+PreconnectTracker::PreconnectTracker(int64_t idle_timeout_ms)
+    : idle_timeout_ms_(idle_timeout_ms) {
+}
+
+PreconnectTracker::~PreconnectTracker() {
+}
+
+std::string PreconnectTracker::GetOrigin(const std::string& url) {
+  std::string lower_url(url);
+  std::transform(lower_url.begin(), lower_url.end(), lower_url.begin(),
+                 [](char c) { return static_cast<char>(::tolower(c)); });
+
+  std::string scheme;
+  std::string default_port;
+  if (lower_url.compare(0, 8, "https://") == 0) {
+    scheme = "https";
+    default_port = "443";
+  } else if (lower_url.compare(0, 7, "http://") == 0) {
+    scheme = "http";
+    default_port = "80";
+  } else {
+    return std::string();
+  }
+
+  const size_t authority_begin = scheme.size() + 3;
+  const size_t authority_end = lower_url.find_first_of("/?#", authority_begin);
+  std::string authority(lower_url.substr(
+      authority_begin,
+      authority_end == std::string::npos ? std::string::npos :
+                                           authority_end - authority_begin));
+
+  // The user info is not part of the origin.
+  const size_t at = authority.rfind('@');
+  if (at != std::string::npos) {
+    authority.erase(0, at + 1);
+  }
+  if (authority.empty()) {
+    return std::string();
+  }
+
+  // The port follows the last colon, unless it is within an IPv6 literal.
+  const size_t colon = authority.rfind(':');
+  const size_t bracket = authority.rfind(']');
+  if (colon == std::string::npos ||
+      (bracket != std::string::npos && colon < bracket)) {
+    authority += ":" + default_port;
+  } else if (colon + 1 == authority.size()) {
+    authority += default_port;
+  }
+
+  return scheme + "://" + authority;
+}
+
+std::vector<std::string> PreconnectTracker::BeginPreconnect(
+    const std::vector<std::string>& urls,
+    int64_t now_ms) {
+  std::lock_guard<std::mutex> lock(lock_);
+
+  std::vector<std::string> origins;
+  for (size_t i = 0; i != urls.size() && origins.size() < kMaxHosts; ++i) {
+    const std::string origin(GetOrigin(urls[i]));
+    if (origin.empty() ||
+        std::find(origins.begin(), origins.end(), origin) != origins.end()) {
+      continue;
+    }
+
+    Host& host = hosts_[origin];
+    if (host.is_connecting || IsUsable(host, now_ms)) {
+      continue;
+    }
+
+    host = Host();
+    host.is_connecting = true;
+    origins.push_back(origin);
+  }
+  return origins;
+}
+
+void PreconnectTracker::EndPreconnect(const std::string& origin,
+                                      bool succeeded,
+                                      int64_t connect_ms,
+                                      int64_t now_ms) {
+  std::lock_guard<std::mutex> lock(lock_);
+
+  Host& host = hosts_[origin];
+  host = Host();
+  if (succeeded) {
+    host.connect_ms = std::max<int64_t>(connect_ms, 1);
+    host.connected_at_ms = now_ms;
+  }
+}
+
+int64_t PreconnectTracker::TakeTimeSaved(const std::string& url,
+                                         int64_t now_ms) {
+  std::lock_guard<std::mutex> lock(lock_);
+
+  auto it = hosts_.find(GetOrigin(url));
+  if (it == hosts_.end() || !IsUsable(it->second, now_ms)) {
+    return 0;
+  }
+
+  const int64_t time_saved_ms = it->second.connect_ms;
+  hosts_.erase(it);
+  return time_saved_ms;
+}
+
+bool PreconnectTracker::IsUsable(const Host& host, int64_t now_ms) const {
+  return !host.is_connecting &&
+         host.connect_ms > 0 &&
+         now_ms - host.connected_at_ms <= idle_timeout_ms_;
+}
+
+}  // namespace omaha
@@ -0,0 +1,97 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// PreconnectTracker chooses the download hosts to connect to ahead of the
+// downloads, and accounts for the time the preconnected downloads save. A
+// host is identified by its origin, the scheme, host, and port of its urls.
+// A preconnected connection is taken by the first download from its host
+// which starts within the idle timeout, after which the server may have
+// closed it.
+//
+// This file has no platform dependencies.
+
+#ifndef OMAHA_NET_PRECONNECT_TRACKER_H_
+#define OMAHA_NET_PRECONNECT_TRACKER_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+
+namespace omaha {
+
+class PreconnectTracker {
+ public:
+  enum {
+    // The number of hosts to preconnect to at a time.
+    kMaxHosts = 4,
+  };
+
+  explicit PreconnectTracker(int64_t idle_timeout_ms);
+  ~PreconnectTracker();
+
+  // Returns the origin of |url| in lower case, for instance
+  // "https://dl.google.com:443", or an empty string if |url| is not an http
+  // or https url. The default port of the scheme is made explicit.
+  static std::string GetOrigin(const std::string& url);
+
+  // Returns the origins to preconnect to for |urls|, in order, at most
+  // kMaxHosts of them. An origin which is being preconnected, or which has a
+  // connection which has not been taken yet, is skipped. The returned
+  // origins are marked as being preconnected.
+  std::vector<std::string> BeginPreconnect(const std::vector<std::string>& urls,
+                                           int64_t now_ms);
+
+  // Records the result of the preconnect to |origin|, which took
+  // |connect_ms|.
+  void EndPreconnect(const std::string& origin,
+                     bool succeeded,
+                     int64_t connect_ms,
+                     int64_t now_ms);
+
+  // Returns the time saved by a request to |url| which starts at |now_ms|,
+  // and takes the preconnected connection to its origin: the time the
+  // connection took, if it was established within the idle timeout and no
+  // other request took it. Returns 0 otherwise.
+  int64_t TakeTimeSaved(const std::string& url, int64_t now_ms);
+
+ private:
+  struct Host {
+    Host() : is_connecting(false), connect_ms(0), connected_at_ms(0) {}
+
+    bool is_connecting;
+    int64_t connect_ms;
+    int64_t connected_at_ms;
+  };
+
+  // Returns true if |host| has a connection which has not been taken, and
+  // which is still usable at |now_ms|.
+  bool IsUsable(const Host& host, int64_t now_ms) const;
+
+  const int64_t idle_timeout_ms_;
+
+  std::mutex lock_;
+  std::map<std::string, Host> hosts_;
+
+  DISALLOW_COPY_AND_ASSIGN(PreconnectTracker);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_NET_PRECONNECT_TRACKER_H_
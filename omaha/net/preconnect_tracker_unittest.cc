@@ -0,0 +1,107 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/net/preconnect_tracker.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace omaha {
+
+TEST(PreconnectTrackerTest, GetOrigin) {
+  EXPECT_EQ("https://dl.google.com:443",
+            PreconnectTracker::GetOrigin("https://dl.google.com/edgedl/a.exe"));
+  EXPECT_EQ("http://dl.google.com:80",
+            PreconnectTracker::GetOrigin("HTTP://DL.Google.com/a.exe"));
+  EXPECT_EQ("http://dl.google.com:8080",
+            PreconnectTracker::GetOrigin("http://dl.google.com:8080?x=1"));
+  EXPECT_EQ("https://dl.google.com:443",
+            PreconnectTracker::GetOrigin("https://user@dl.google.com"));
+  EXPECT_EQ("https://[::1]:443",
+            PreconnectTracker::GetOrigin("https://[::1]/a.exe"));
+  EXPECT_EQ("https://[::1]:8443",
+            PreconnectTracker::GetOrigin("https://[::1]:8443/a.exe"));
+
+  EXPECT_EQ("", PreconnectTracker::GetOrigin("ftp://dl.google.com/a.exe"));
+  EXPECT_EQ("", PreconnectTracker::GetOrigin("https:///a.exe"));
+  EXPECT_EQ("", PreconnectTracker::GetOrigin(""));
+}
+
+TEST(PreconnectTrackerTest, BeginPreconnect) {
+  PreconnectTracker tracker(60000);
+
+  std::vector<std::string> urls;
+  urls.push_back("https://a.example.com/1.exe");
+  urls.push_back("https://a.example.com/2.exe");
+  urls.push_back("not a url");
+  urls.push_back("https://b.example.com/1.exe");
+  urls.push_back("https://c.example.com/1.exe");
+  urls.push_back("https://d.example.com/1.exe");
+  urls.push_back("https://e.example.com/1.exe");
+
+  // Each origin is preconnected once, and no more than kMaxHosts at a time.
+  std::vector<std::string> origins(tracker.BeginPreconnect(urls, 0));
+  ASSERT_EQ(static_cast<size_t>(PreconnectTracker::kMaxHosts), origins.size());
+  EXPECT_EQ("https://a.example.com:443", origins[0]);
+  EXPECT_EQ("https://b.example.com:443", origins[1]);
+  EXPECT_EQ("https://c.example.com:443", origins[2]);
+  EXPECT_EQ("https://d.example.com:443", origins[3]);
+
+  // The origins being preconnected are skipped.
+  origins = tracker.BeginPreconnect(urls, 0);
+  ASSERT_EQ(1, origins.size());
+  EXPECT_EQ("https://e.example.com:443", origins[0]);
+}
+
+TEST(PreconnectTrackerTest, TakeTimeSaved) {
+  PreconnectTracker tracker(60000);
+
+  std::vector<std::string> urls;
+  urls.push_back("https://a.example.com/1.exe");
+  urls.push_back("https://b.example.com/1.exe");
+  ASSERT_EQ(2, tracker.BeginPreconnect(urls, 1000).size());
+
+  // Nothing is saved while the preconnect is in flight.
+  EXPECT_EQ(0, tracker.TakeTimeSaved("https://a.example.com/1.exe", 1100));
+
+  tracker.EndPreconnect("https://a.example.com:443", true, 250, 1250);
+  tracker.EndPreconnect("https://b.example.com:443", false, 300, 1300);
+
+  // A connected origin is not preconnected again until it is taken.
+  EXPECT_EQ(1, tracker.BeginPreconnect(urls, 1400).size());
+  tracker.EndPreconnect("https://b.example.com:443", false, 300, 1500);
+
+  // The connection is taken once, by a url of the same origin.
+  EXPECT_EQ(0, tracker.TakeTimeSaved("https://b.example.com/1.exe", 2000));
+  EXPECT_EQ(250, tracker.TakeTimeSaved("https://A.example.com/2.exe", 2000));
+  EXPECT_EQ(0, tracker.TakeTimeSaved("https://a.example.com/1.exe", 2000));
+}
+
+TEST(PreconnectTrackerTest, IdleTimeout) {
+  PreconnectTracker tracker(60000);
+
+  std::vector<std::string> urls(1, "https://a.example.com/1.exe");
+  ASSERT_EQ(1, tracker.BeginPreconnect(urls, 0).size());
+  tracker.EndPreconnect("https://a.example.com:443", true, 100, 100);
+
+  // The server may have closed the connection once it has been idle for too
+  // long, so the origin can be preconnected again.
+  EXPECT_EQ(0, tracker.TakeTimeSaved("https://a.example.com/1.exe", 60101));
+  EXPECT_EQ(1, tracker.BeginPreconnect(urls, 60101).size());
+}
+
+}  // namespace omaha
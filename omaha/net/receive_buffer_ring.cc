@@ -0,0 +1,104 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/net/receive_buffer_ring.h"
+
+namespace omaha {
+
+ReceiveBufferRing::ReceiveBufferRing(const Writer& writer)
+    : writer_(writer),
+      buffers_(kNumBuffers, std::vector<uint8_t>(kBufferSize)),
+      sizes_(kNumBuffers),
+      writer_thread_([this]() { WriteBuffers(); }) {
+}
+
+ReceiveBufferRing::~ReceiveBufferRing() {
+  Finish();
+}
+
+uint8_t* ReceiveBufferRing::GetBuffer(size_t* size) {
+  std::unique_lock<std::mutex> lock(lock_);
+  changed_.wait(lock, [this]() {
+    return num_queued_ < kNumBuffers || has_failed_;
+  });
+  if (has_failed_ || is_finishing_) {
+    *size = 0;
+    return NULL;
+  }
+
+  const size_t index = (write_index_ + num_queued_) % kNumBuffers;
+  *size = kBufferSize - sizes_[index];
+  return buffers_[index].data() + sizes_[index];
+}
+
+void ReceiveBufferRing::Commit(size_t num_bytes) {
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    const size_t index = (write_index_ + num_queued_) % kNumBuffers;
+    sizes_[index] += num_bytes;
+    if (sizes_[index] < kBufferSize) {
+      return;
+    }
+    ++num_queued_;
+  }
+  changed_.notify_all();
+}
+
+bool ReceiveBufferRing::Finish() {
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    if (!is_finishing_) {
+      is_finishing_ = true;
+      const size_t index = (write_index_ + num_queued_) % kNumBuffers;
+      if (num_queued_ < kNumBuffers && sizes_[index]) {
+        ++num_queued_;
+      }
+    }
+  }
+  changed_.notify_all();
+
+  if (writer_thread_.joinable()) {
+    writer_thread_.join();
+  }
+  return !has_failed_;
+}
+
+void ReceiveBufferRing::WriteBuffers() {
+  std::unique_lock<std::mutex> lock(lock_);
+  for (;;) {
+    changed_.wait(lock, [this]() { return num_queued_ || is_finishing_; });
+    if (!num_queued_) {
+      return;
+    }
+
+    // The buffer is not changed by the receiving thread while it is queued.
+    const size_t index = write_index_;
+    const bool is_skipped = has_failed_;
+    lock.unlock();
+    const bool is_written =
+        is_skipped || writer_(buffers_[index].data(), sizes_[index]);
+    lock.lock();
+
+    if (!is_written) {
+      has_failed_ = true;
+    }
+    sizes_[index] = 0;
+    write_index_ = (write_index_ + 1) % kNumBuffers;
+    --num_queued_;
+    changed_.notify_all();
+  }
+}
+
+}  // namespace omaha
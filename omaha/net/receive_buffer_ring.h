@@ -0,0 +1,100 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// ReceiveBufferRing overlaps receiving a response with writing it to disk.
+// The response is received into a ring of fixed-size buffers, and a writer
+// thread writes the full buffers in order while the next buffer is being
+// received. The buffers are allocated once, when the ring is created, so
+// that receiving a response does not allocate memory.
+//
+// This file has no platform dependencies.
+
+#ifndef OMAHA_NET_RECEIVE_BUFFER_RING_H_
+#define OMAHA_NET_RECEIVE_BUFFER_RING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "base/basictypes.h"
+
+namespace omaha {
+
+class ReceiveBufferRing {
+ public:
+  // Writes |size| bytes of the response. Returns false if the write fails,
+  // after which nothing more is written.
+  typedef std::function<bool(const uint8_t* data, size_t size)> Writer;
+
+  enum {
+    kBufferSize = 64 * 1024,
+    kNumBuffers = 4,
+  };
+
+  // Starts the writer thread, which calls |writer|.
+  explicit ReceiveBufferRing(const Writer& writer);
+
+  // Finishes the writes.
+  ~ReceiveBufferRing();
+
+  // Returns the free space of the buffer being received into, and its size in
+  // |size|. Waits for a buffer to be written if all of them are full. Returns
+  // NULL if a write failed or the ring is finished.
+  uint8_t* GetBuffer(size_t* size);
+
+  // Marks |num_bytes| of the space returned by GetBuffer as received. The
+  // buffer is queued for writing when it is full.
+  void Commit(size_t num_bytes);
+
+  // Queues the buffer being received into, waits until all the queued buffers
+  // are written, and stops the writer thread. Returns false if a write
+  // failed. Later calls return the same result.
+  bool Finish();
+
+ private:
+  // Writes the queued buffers until the ring is finished.
+  void WriteBuffers();
+
+  const Writer writer_;
+
+  std::mutex lock_;
+  std::condition_variable changed_;
+
+  std::vector<std::vector<uint8_t>> buffers_;
+
+  // The number of bytes received into each buffer.
+  std::vector<size_t> sizes_;
+
+  // The queued buffers start at |write_index_|. The buffer being received
+  // into follows them.
+  size_t write_index_ = 0;
+  size_t num_queued_ = 0;
+
+  bool is_finishing_ = false;
+  bool has_failed_ = false;
+
+  std::thread writer_thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(ReceiveBufferRing);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_NET_RECEIVE_BUFFER_RING_H_
@@ -0,0 +1,237 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/net/receive_buffer_ring.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace omaha {
+
+namespace {
+
+// Stands in for an HTTP server which sends a response body in chunks, one
+// chunk per |chunk_delay|.
+class HttpStandIn {
+ public:
+  HttpStandIn(size_t body_size,
+              size_t chunk_size,
+              std::chrono::microseconds chunk_delay)
+      : body_size_(body_size),
+        chunk_size_(chunk_size),
+        chunk_delay_(chunk_delay) {
+  }
+
+  // Reads like WinHttpReadData. Returns 0 at the end of the body.
+  size_t Read(uint8_t* buffer, size_t size) {
+    const size_t num_bytes =
+        std::min(size, std::min(chunk_size_, body_size_ - offset_));
+    if (num_bytes) {
+      std::this_thread::sleep_for(chunk_delay_);
+    }
+    for (size_t i = 0; i != num_bytes; ++i) {
+      buffer[i] = static_cast<uint8_t>((offset_ + i) % 251);
+    }
+    offset_ += num_bytes;
+    return num_bytes;
+  }
+
+  size_t bytes_sent() const { return offset_; }
+
+ private:
+  const size_t body_size_;
+  const size_t chunk_size_;
+  const std::chrono::microseconds chunk_delay_;
+  size_t offset_ = 0;
+};
+
+// Stands in for a disk which takes |write_delay| to write a buffer.
+class DiskStandIn {
+ public:
+  explicit DiskStandIn(std::chrono::microseconds write_delay)
+      : write_delay_(write_delay) {
+  }
+
+  bool Write(const uint8_t* data, size_t size) {
+    std::this_thread::sleep_for(write_delay_);
+    contents_.insert(contents_.end(), data, data + size);
+    ++num_writes_;
+    return true;
+  }
+
+  const std::vector<uint8_t>& contents() const { return contents_; }
+  int num_writes() const { return num_writes_; }
+
+ private:
+  const std::chrono::microseconds write_delay_;
+  std::vector<uint8_t> contents_;
+  int num_writes_ = 0;
+};
+
+// Receives the body like SimpleRequest::ReceiveData. Returns false if a
+// write fails.
+bool ReceiveBody(HttpStandIn* server, ReceiveBufferRing* ring) {
+  for (;;) {
+    size_t size = 0;
+    uint8_t* buffer = ring->GetBuffer(&size);
+    if (!buffer) {
+      break;
+    }
+    const size_t num_bytes = server->Read(buffer, size);
+    if (!num_bytes) {
+      break;
+    }
+    ring->Commit(num_bytes);
+  }
+  return ring->Finish();
+}
+
+// Receives the body and writes each chunk before reading the next one, as
+// SimpleRequest::ReceiveData did.
+void ReceiveBodySynchronously(HttpStandIn* server, DiskStandIn* disk) {
+  std::vector<uint8_t> buffer(ReceiveBufferRing::kBufferSize);
+  for (;;) {
+    const size_t num_bytes = server->Read(buffer.data(), buffer.size());
+    if (!num_bytes) {
+      return;
+    }
+    disk->Write(buffer.data(), num_bytes);
+  }
+}
+
+std::vector<uint8_t> ExpectedBody(size_t body_size) {
+  std::vector<uint8_t> body(body_size);
+  for (size_t i = 0; i != body_size; ++i) {
+    body[i] = static_cast<uint8_t>(i % 251);
+  }
+  return body;
+}
+
+double Seconds(std::chrono::steady_clock::duration duration) {
+  return std::chrono::duration<double>(duration).count();
+}
+
+}  // namespace
+
+TEST(ReceiveBufferRingTest, WritesFullBuffersInOrder) {
+  // The body does not end on a buffer boundary, and arrives in chunks which
+  // do not divide the buffers.
+  const size_t kBodySize = 10 * ReceiveBufferRing::kBufferSize + 123;
+  HttpStandIn server(kBodySize, 3000, std::chrono::microseconds(0));
+  DiskStandIn disk((std::chrono::microseconds(0)));
+  ReceiveBufferRing ring([&disk](const uint8_t* data, size_t size) {
+    return disk.Write(data, size);
+  });
+
+  EXPECT_TRUE(ReceiveBody(&server, &ring));
+  EXPECT_TRUE(disk.contents() == ExpectedBody(kBodySize));
+  EXPECT_EQ(11, disk.num_writes());
+}
+
+TEST(ReceiveBufferRingTest, EmptyBody) {
+  int num_writes = 0;
+  ReceiveBufferRing ring([&num_writes](const uint8_t*, size_t) {
+    ++num_writes;
+    return true;
+  });
+  EXPECT_TRUE(ring.Finish());
+  EXPECT_EQ(0, num_writes);
+
+  size_t size = 1;
+  EXPECT_EQ(NULL, ring.GetBuffer(&size));
+  EXPECT_EQ(0, size);
+}
+
+TEST(ReceiveBufferRingTest, WriteFails) {
+  const size_t kBodySize = 20 * ReceiveBufferRing::kBufferSize;
+  HttpStandIn server(kBodySize,
+                     ReceiveBufferRing::kBufferSize,
+                     std::chrono::microseconds(0));
+  int num_writes = 0;
+  ReceiveBufferRing ring([&num_writes](const uint8_t*, size_t) {
+    return ++num_writes < 3;
+  });
+
+  EXPECT_FALSE(ReceiveBody(&server, &ring));
+  EXPECT_FALSE(ring.Finish());
+
+  // Nothing is written after the failure, and the receiving stops before the
+  // end of the body.
+  EXPECT_EQ(3, num_writes);
+  size_t size = 0;
+  EXPECT_EQ(NULL, ring.GetBuffer(&size));
+  EXPECT_LT(server.bytes_sent(), kBodySize);
+}
+
+TEST(ReceiveBufferRingTest, DestructorFinishes) {
+  DiskStandIn disk((std::chrono::microseconds(1000)));
+  {
+    ReceiveBufferRing ring([&disk](const uint8_t* data, size_t size) {
+      return disk.Write(data, size);
+    });
+    size_t size = 0;
+    uint8_t* buffer = ring.GetBuffer(&size);
+    ASSERT_TRUE(buffer);
+    buffer[0] = 7;
+    ring.Commit(1);
+  }
+  ASSERT_EQ(1, disk.contents().size());
+  EXPECT_EQ(7, disk.contents()[0]);
+}
+
+// Downloads from a local stand-in for an HTTP server to a stand-in for a
+// disk as fast as each of them goes, with and without the ring. The ring
+// receives while it writes, so that the download takes about as long as the
+// slower of the two instead of as long as both.
+TEST(ReceiveBufferRingTest, Throughput) {
+  const size_t kBodySize = 64 * ReceiveBufferRing::kBufferSize;
+  const std::chrono::microseconds kDelay(4000);
+
+  auto start = std::chrono::steady_clock::now();
+  {
+    HttpStandIn server(kBodySize, ReceiveBufferRing::kBufferSize, kDelay);
+    DiskStandIn disk(kDelay);
+    ReceiveBodySynchronously(&server, &disk);
+    EXPECT_EQ(kBodySize, disk.contents().size());
+  }
+  const double synchronous_seconds =
+      Seconds(std::chrono::steady_clock::now() - start);
+
+  start = std::chrono::steady_clock::now();
+  {
+    HttpStandIn server(kBodySize, ReceiveBufferRing::kBufferSize, kDelay);
+    DiskStandIn disk(kDelay);
+    ReceiveBufferRing ring([&disk](const uint8_t* data, size_t size) {
+      return disk.Write(data, size);
+    });
+    EXPECT_TRUE(ReceiveBody(&server, &ring));
+    EXPECT_TRUE(disk.contents() == ExpectedBody(kBodySize));
+  }
+  const double ring_seconds = Seconds(std::chrono::steady_clock::now() - start);
+
+  std::cout << "synchronous writes: "
+            << kBodySize / synchronous_seconds / (1024 * 1024) << " MB/s, "
+            << "buffer ring: "
+            << kBodySize / ring_seconds / (1024 * 1024) << " MB/s"
+            << std::endl;
+  EXPECT_LT(ring_seconds, 0.75 * synchronous_seconds);
+}
+
+}  // namespace omaha
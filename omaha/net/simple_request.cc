@@ -29,6 +29,9 @@
 #include "omaha/net/simple_request.h"
 #include <atlconv.h>
 #include <intsafe.h>
+#include <winsock2.h>
+#include <mstcpip.h>
+#include <algorithm>
 #include <climits>
 #include <memory>
 #include <vector>
@@ -40,10 +43,14 @@
 #include "omaha/base/safe_format.h"
 #include "omaha/base/scope_guard.h"
 #include "omaha/base/string.h"
+#include "omaha/base/time.h"
+#include "omaha/common/config_manager.h"
 #include "omaha/common/ping_event_download_metrics.h"
+#include "omaha/net/bandwidth_limiter.h"
 #include "omaha/net/network_config.h"
 #include "omaha/net/network_request.h"
 #include "omaha/net/proxy_auth.h"
+#include "omaha/net/receive_buffer_ring.h"
 #include "omaha/net/winhttp_adapter.h"
 #include "omaha/third_party/smartany/scoped_any.h"
 
@@ -54,6 +61,37 @@ namespace {
 // How many times should we retry when we get ERROR_WINHTTP_RESEND_REQUEST.
 constexpr const int kMaxResendAttempts = 3;
 
+// How often the round trip time of a throttled connection is sampled.
+constexpr const uint64 kRoundTripSampleIntervalMs = 1000;
+
+// A throttled request checks for cancellation at least this often.
+constexpr const int64_t kMaxThrottleSliceMs = 50;
+
+// Returns a TCP_INFO_v0 on Windows 10 1709 and later.
+#ifndef WINHTTP_OPTION_CONNECTION_STATS_V0
+#define WINHTTP_OPTION_CONNECTION_STATS_V0 141
+#endif
+
+// Reserves the disk space of a response of |content_length| bytes, so that
+// the file does not fragment as it grows. The size of the file is not
+// changed, since it tells how much of the response a paused download has
+// received. The reservation is a hint: the response is written whether or
+// not it succeeds.
+void PreallocateFile(HANDLE file_handle, int content_length) {
+  if (content_length <= 0) {
+    return;
+  }
+  FILE_ALLOCATION_INFO allocation_info = {};
+  allocation_info.AllocationSize.QuadPart = content_length;
+  if (!::SetFileInformationByHandle(file_handle,
+                                    FileAllocationInfo,
+                                    &allocation_info,
+                                    sizeof(allocation_info))) {
+    NET_LOG(LW, (_T("[failed to preallocate][%d][0x%08x]"),
+                 content_length, HRESULTFromLastError()));
+  }
+}
+
 }  // namespace
 
 SimpleRequest::TransientRequestState::TransientRequestState()
@@ -79,7 +117,12 @@ SimpleRequest::SimpleRequest()
       request_buffer_length_(0),
       proxy_auth_config_(NULL, CString()),
       low_priority_(false),
+      is_head_request_(false),
       callback_(NULL),
+      response_observer_(NULL),
+      is_resumable_(false),
+      resume_content_length_(0),
+      resume_offset_(0),
       download_completed_(false),
       resend_count_(0) {
   SafeCStringFormat(&user_agent_, _T("%s;winhttp"),
@@ -101,8 +144,9 @@ SimpleRequest::~SimpleRequest() {
   Close();
   callback_ = NULL;
 
-  // If download failed, try to clean up the target file.
-  if (!download_completed_ && !filename_.IsEmpty()) {
+  // If download failed, try to clean up the target file. The file of a
+  // resumable download is kept for the next download.
+  if (!download_completed_ && !is_resumable_ && !filename_.IsEmpty()) {
     if (!::DeleteFile(filename_) && ::GetLastError() != ERROR_FILE_NOT_FOUND) {
       NET_LOG(LW, (_T("[SimpleRequest][Failed to delete file: %s][0x%08x]."),
                    filename_.GetString(), HRESULTFromLastError()));
@@ -128,6 +172,22 @@ void SimpleRequest::set_filename(const CString& filename) {
   }
 }
 
+void SimpleRequest::set_resumable(bool is_resumable,
+                                  int content_length,
+                                  int offset) {
+  ASSERT1(offset >= 0 && offset <= content_length);
+  __mutexScope(lock_);
+  if (is_resumable_ != is_resumable ||
+      resume_content_length_ != content_length ||
+      resume_offset_ != offset) {
+    is_resumable_ = is_resumable;
+    resume_content_length_ = content_length;
+    resume_offset_ = offset;
+    CloseHandles();
+    request_state_.reset();
+  }
+}
+
 HRESULT SimpleRequest::Close() {
   NET_LOG(L3, (_T("[SimpleRequest::Close]")));
 
@@ -233,8 +293,15 @@ HRESULT SimpleRequest::Send() {
         return hr;
       }
 
-      if (!IsPauseSupported() || request_state_ == NULL) {
+      if (!(IsPauseSupported() || is_resumable_) || request_state_ == NULL) {
         request_state_.reset(new TransientRequestState);
+
+        // The first send of a resumable download resumes after the bytes
+        // stored by an earlier download.
+        if (is_resumable_ && resume_offset_) {
+          request_state_->content_length = resume_content_length_;
+          request_state_->current_bytes = resume_offset_;
+        }
       } else {
         // Discard all previous download states except content_length and
         // current_bytes for resume purpose. These two states will be validated
@@ -336,7 +403,8 @@ HRESULT SimpleRequest::Connect() {
     request_state_->is_https = true;
     flags |= WINHTTP_FLAG_SECURE;
   }
-  const TCHAR* verb = IsPostRequest() ? _T("POST") : _T("GET");
+  const TCHAR* verb = IsPostRequest() ? _T("POST") :
+                      is_head_request_ ? _T("HEAD") : _T("GET");
   hr = winhttp_adapter_->OpenRequest(verb, request_state_->url_path,
                                      NULL, WINHTTP_NO_REFERER,
                                      WINHTTP_DEFAULT_ACCEPT_TYPES, flags);
@@ -605,6 +673,36 @@ HRESULT SimpleRequest::ReceiveData(HANDLE file_handle) {
 
   HRESULT hr = S_OK;
 
+  const bool is_http_success =
+      request_state_->http_status_code == HTTP_STATUS_OK ||
+      request_state_->http_status_code == HTTP_STATUS_PARTIAL_CONTENT;
+
+  if (is_resumable_) {
+    // The body of a failed response is not a part of the download.
+    if (!is_http_success) {
+      return S_OK;
+    }
+
+    // A server which ignores the range of a resumed download sends the whole
+    // body again, which replaces the bytes already stored.
+    if (request_state_->current_bytes &&
+        request_state_->http_status_code == HTTP_STATUS_OK) {
+      NET_LOG(L3, (_T("[SimpleRequest::ReceiveData][range ignored]")));
+      request_state_->current_bytes = 0;
+      if (file_handle != INVALID_HANDLE_VALUE) {
+        LARGE_INTEGER start_pos = {0};
+        if (!::SetFilePointerEx(file_handle, start_pos, NULL, FILE_BEGIN) ||
+            !::SetEndOfFile(file_handle)) {
+          return HRESULTFromLastError();
+        }
+      }
+    }
+  }
+
+  if (response_observer_) {
+    response_observer_->OnResponseStart(request_state_->current_bytes);
+  }
+
   // In the case of a "204 No Content" response, WinHttp blocks when
   // querying or reading the available data. According to the RFC,
   // the 204 response must not include a message-body, and thus is always
@@ -616,6 +714,12 @@ HRESULT SimpleRequest::ReceiveData(HANDLE file_handle) {
     return S_OK;
   }
 
+  // The response to a HEAD request has no body, regardless of its
+  // Content-Length header.
+  if (is_head_request_) {
+    return S_OK;
+  }
+
   int content_length = 0;
   winhttp_adapter_->QueryRequestHeadersInt(WINHTTP_QUERY_CONTENT_LENGTH,
                                            WINHTTP_HEADER_NAME_BY_INDEX,
@@ -626,45 +730,87 @@ HRESULT SimpleRequest::ReceiveData(HANDLE file_handle) {
     request_state_->current_bytes = 0;
   }
 
-  const bool is_http_success =
-      request_state_->http_status_code == HTTP_STATUS_OK ||
-      request_state_->http_status_code == HTTP_STATUS_PARTIAL_CONTENT;
+  // The requests of the process share the download rate of their class.
+  const BandwidthLimiter::Priority priority = low_priority_ ?
+      BandwidthLimiter::kBackground : BandwidthLimiter::kForeground;
+  BandwidthLimiter::Instance()->SetLimit(
+      priority,
+      1024ULL * ConfigManager::Instance()->GetDownloadRateLimitKBytesPerSec(
+          low_priority_, NULL));
+  uint64 last_round_trip_sample_ms = 0;
+
+  // A file is written on the thread of a buffer ring while the next bytes are
+  // received. A response in memory is received in place, in a buffer which
+  // is reserved for the whole response when its length is known.
+  std::unique_ptr<ReceiveBufferRing> ring;
+  HRESULT write_hr = S_OK;
+  if (!filename_.IsEmpty()) {
+    PreallocateFile(file_handle, request_state_->content_length);
+    ring.reset(new ReceiveBufferRing(
+        [file_handle, &write_hr](const uint8_t* data, size_t size) {
+          DWORD num_bytes(0);
+          if (!::WriteFile(file_handle,
+                           data,
+                           static_cast<DWORD>(size),
+                           &num_bytes,
+                           NULL)) {
+            write_hr = HRESULTFromLastError();
+            return false;
+          }
+          ASSERT1(num_bytes == size);
+          return true;
+        }));
+  } else if (content_length > 0) {
+    // The last read of a response is one byte past its end.
+    request_state_->response.reserve(content_length + 1);
+  }
 
-  std::vector<uint8> buffer;
+  DWORD bytes_read(0);
   do  {
     DWORD bytes_available(0);
     winhttp_adapter_->QueryDataAvailable(&bytes_available);
-    buffer.resize(1 + bytes_available);
-    hr = winhttp_adapter_->ReadData(&buffer.front(),
-                                    static_cast<DWORD>(buffer.size()),
-                                    &bytes_available);
-    if (FAILED(hr)) {
-      return hr;
-    }
 
-    buffer.resize(bytes_available);
-    if (!buffer.empty()) {
-      if (!filename_.IsEmpty()) {
-        DWORD num_bytes(0);
-        if (!::WriteFile(file_handle,
-                         reinterpret_cast<const char*>(&buffer.front()),
-                         static_cast<DWORD>(buffer.size()),
-                         &num_bytes,
-                         NULL)) {
-          return HRESULTFromLastError();
-        }
-        ASSERT1(num_bytes == buffer.size());
-      } else {
-        request_state_->response.insert(request_state_->response.end(),
-                                        buffer.begin(),
-                                        buffer.end());
+    // Reading one byte when no data is available waits for the data or for
+    // the end of the response.
+    size_t buffer_size = std::max<size_t>(bytes_available, 1);
+    uint8* buffer = NULL;
+    std::vector<uint8>& response = request_state_->response;
+    const size_t response_size = response.size();
+    if (ring.get()) {
+      size_t free_size = 0;
+      buffer = ring->GetBuffer(&free_size);
+      if (!buffer) {
+        break;
       }
+      buffer_size = std::min(buffer_size, free_size);
+    } else {
+      response.resize(response_size + buffer_size);
+      buffer = &response[response_size];
     }
 
-    // Update current_bytes after those bytes are serialized in case we
-    // pause before current_bytes is updated, we can throw away the last
-    // batch of bytes received and resume.
-    request_state_->current_bytes += bytes_available;
+    bytes_read = 0;
+    hr = winhttp_adapter_->ReadData(buffer,
+                                    static_cast<DWORD>(buffer_size),
+                                    &bytes_read);
+    if (FAILED(hr)) {
+      bytes_read = 0;
+    }
+    if (response_observer_ && bytes_read) {
+      response_observer_->OnResponseData(buffer, bytes_read);
+    }
+    if (ring.get()) {
+      ring->Commit(bytes_read);
+    } else {
+      response.resize(response_size + bytes_read);
+    }
+    if (FAILED(hr)) {
+      break;
+    }
+
+    // The bytes are counted once they are queued for writing. The ring is
+    // finished before this function returns, so that they are written by the
+    // time the request pauses, and the download resumes after them.
+    request_state_->current_bytes += bytes_read;
     if (request_state_->content_length) {
       ASSERT1(request_state_->current_bytes <= request_state_->content_length);
     }
@@ -676,7 +822,24 @@ HRESULT SimpleRequest::ReceiveData(HANDLE file_handle) {
                             WINHTTP_CALLBACK_STATUS_READ_COMPLETE,
                             NULL);
     }
-  } while (!buffer.empty());
+
+    if (bytes_read) {
+      hr = ThrottleReceive(priority,
+                           bytes_read,
+                           &last_round_trip_sample_ms);
+      if (FAILED(hr)) {
+        break;
+      }
+    }
+  } while (bytes_read);
+
+  if (ring.get() && !ring->Finish()) {
+    ASSERT1(FAILED(write_hr));
+    hr = write_hr;
+  }
+  if (FAILED(hr)) {
+    return hr;
+  }
 
   NET_LOG(L3, (_T("[bytes downloaded %d]"), request_state_->current_bytes));
   if (file_handle != INVALID_HANDLE_VALUE) {
@@ -694,6 +857,48 @@ HRESULT SimpleRequest::ReceiveData(HANDLE file_handle) {
   return hr;
 }
 
+HRESULT SimpleRequest::ThrottleReceive(BandwidthLimiter::Priority priority,
+                                       size_t num_bytes,
+                                       uint64* last_round_trip_sample_ms) {
+  ASSERT1(last_round_trip_sample_ms);
+
+  BandwidthLimiter* limiter = BandwidthLimiter::Instance();
+
+  // Only the background class adapts to the round trip time.
+  const uint64 now_ms = GetCurrentMsTime();
+  if (priority == BandwidthLimiter::kBackground &&
+      now_ms - *last_round_trip_sample_ms >= kRoundTripSampleIntervalMs) {
+    *last_round_trip_sample_ms = now_ms;
+
+    TCP_INFO_v0 tcp_info = {};
+    DWORD tcp_info_size = sizeof(tcp_info);
+    if (SUCCEEDED(winhttp_adapter_->QueryRequestOption(
+            WINHTTP_OPTION_CONNECTION_STATS_V0,
+            &tcp_info,
+            &tcp_info_size))) {
+      limiter->OnRoundTrip(priority, tcp_info.RttUs);
+    }
+  }
+
+  // A paused or closed request stops waiting: its handles are closed, so its
+  // next read fails and the request pauses or completes without the delay.
+  int64_t delay_ms = (limiter->Consume(priority, num_bytes) + 999) / 1000;
+  while (delay_ms > 0) {
+    if (is_canceled_) {
+      return GOOPDATE_E_CANCELLED;
+    }
+    if (pause_happened_ || is_closed_) {
+      return S_OK;
+    }
+
+    const int64_t slice_ms = std::min(delay_ms, kMaxThrottleSliceMs);
+    ::Sleep(static_cast<DWORD>(slice_ms));
+    delay_ms -= slice_ms;
+  }
+
+  return S_OK;
+}
+
 HRESULT SimpleRequest::PrepareRequest(HANDLE* file_handle) {
   // Read the remaining bytes of the body. If we have a file to save the
   // response into, create the file.
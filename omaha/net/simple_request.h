@@ -30,6 +30,7 @@
 #include "base/basictypes.h"
 #include "omaha/base/debug.h"
 #include "omaha/base/synchronized.h"
+#include "omaha/net/bandwidth_limiter.h"
 #include "omaha/net/http_request.h"
 #include "omaha/net/network_config.h"
 #include "omaha/third_party/smartany/scoped_any.h"
@@ -90,10 +91,21 @@ class SimpleRequest : public HttpRequestInterface {
     low_priority_ = low_priority;
   }
 
+  // Sends a HEAD request instead of a GET request. The response has no body.
+  void set_is_head_request(bool is_head_request) {
+    is_head_request_ = is_head_request;
+  }
+
   virtual void set_callback(NetworkRequestCallback* callback) {
     callback_ = callback;
   }
 
+  virtual void set_response_observer(ResponseObserver* observer) {
+    response_observer_ = observer;
+  }
+
+  virtual void set_resumable(bool is_resumable, int content_length, int offset);
+
   virtual void set_additional_headers(const CString& additional_headers) {
     additional_headers_ = additional_headers;
   }
@@ -139,6 +151,14 @@ class SimpleRequest : public HttpRequestInterface {
   // Returns immediately otherwise.
   void WaitForResumeEvent();
 
+  // Accounts for |num_bytes| received in the bandwidth of |priority|, and
+  // waits until the request may read again, or until it is canceled, paused,
+  // or closed. Samples the round trip time of the connection about once a
+  // second.
+  HRESULT ThrottleReceive(BandwidthLimiter::Priority priority,
+                          size_t num_bytes,
+                          uint64* last_round_trip_sample_ms);
+
   DownloadMetrics MakeDownloadMetrics(HRESULT hr) const;
 
   // Holds the transient state corresponding to a single http request. We
@@ -180,7 +200,12 @@ class SimpleRequest : public HttpRequestInterface {
   ProxyAuthConfig proxy_auth_config_;
   ProxyConfig proxy_config_;
   bool low_priority_;
+  bool is_head_request_;
   NetworkRequestCallback* callback_;
+  ResponseObserver* response_observer_;
+  bool is_resumable_;
+  int resume_content_length_;
+  int resume_offset_;
   std::unique_ptr<WinHttpAdapter> winhttp_adapter_;
   std::unique_ptr<TransientRequestState> request_state_;
   scoped_event event_resume_;
@@ -0,0 +1,133 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// TimedCache keeps values for a time to live, as long as the environment
+// they were computed in does not change. The environment is identified by a
+// fingerprint, for instance of the network the machine is connected to: a
+// value put with one fingerprint is not returned for another one.
+//
+// This file has no platform dependencies.
+
+#ifndef OMAHA_NET_TIMED_CACHE_H_
+#define OMAHA_NET_TIMED_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "base/basictypes.h"
+
+namespace omaha {
+
+template <typename Value>
+class TimedCache {
+ public:
+  TimedCache(int64_t ttl_ms, size_t max_entries)
+      : ttl_ms_(ttl_ms), max_entries_(max_entries) {}
+
+  // Returns true and the value of |key| in |value| if it was put with
+  // |fingerprint| less than the time to live before |now_ms|.
+  bool Get(const std::string& key,
+           const std::string& fingerprint,
+           int64_t now_ms,
+           Value* value) const {
+    std::lock_guard<std::mutex> lock(lock_);
+    auto it = entries_.find(key);
+    if (it == entries_.end() || !IsFresh(it->second, fingerprint, now_ms)) {
+      return false;
+    }
+    *value = it->second.value;
+    return true;
+  }
+
+  // Puts |value| for |key|. When the cache is full, the stale entries are
+  // evicted first, then the oldest one.
+  void Put(const std::string& key,
+           const std::string& fingerprint,
+           int64_t now_ms,
+           const Value& value) {
+    std::lock_guard<std::mutex> lock(lock_);
+    if (entries_.find(key) == entries_.end() &&
+        entries_.size() >= max_entries_) {
+      Evict(fingerprint, now_ms);
+    }
+
+    Entry& entry = entries_[key];
+    entry.fingerprint = fingerprint;
+    entry.put_at_ms = now_ms;
+    entry.value = value;
+  }
+
+  void Clear() {
+    std::lock_guard<std::mutex> lock(lock_);
+    entries_.clear();
+  }
+
+  size_t size() const {
+    std::lock_guard<std::mutex> lock(lock_);
+    return entries_.size();
+  }
+
+ private:
+  struct Entry {
+    Entry() : put_at_ms(0) {}
+
+    std::string fingerprint;
+    int64_t put_at_ms;
+    Value value;
+  };
+
+  bool IsFresh(const Entry& entry,
+               const std::string& fingerprint,
+               int64_t now_ms) const {
+    return entry.fingerprint == fingerprint &&
+           now_ms - entry.put_at_ms < ttl_ms_;
+  }
+
+  // Makes room for one entry. Called with |lock_| held.
+  void Evict(const std::string& fingerprint, int64_t now_ms) {
+    auto oldest = entries_.end();
+    for (auto it = entries_.begin(); it != entries_.end();) {
+      if (!IsFresh(it->second, fingerprint, now_ms)) {
+        it = entries_.erase(it);
+        continue;
+      }
+      if (oldest == entries_.end() ||
+          it->second.put_at_ms < oldest->second.put_at_ms) {
+        oldest = it;
+      }
+      ++it;
+    }
+
+    if (entries_.size() >= max_entries_ && oldest != entries_.end()) {
+      entries_.erase(oldest);
+    }
+  }
+
+  const int64_t ttl_ms_;
+  const size_t max_entries_;
+
+  mutable std::mutex lock_;
+  std::map<std::string, Entry> entries_;
+
+  DISALLOW_COPY_AND_ASSIGN(TimedCache);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_NET_TIMED_CACHE_H_
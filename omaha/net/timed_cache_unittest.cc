@@ -0,0 +1,103 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/net/timed_cache.h"
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace omaha {
+
+TEST(TimedCacheTest, GetAndPut) {
+  TimedCache<std::string> cache(1000, 10);
+  std::string value;
+
+  EXPECT_FALSE(cache.Get("http://a", "net1", 0, &value));
+
+  cache.Put("http://a", "net1", 0, "PROXY p1");
+  cache.Put("https://a", "net1", 0, "DIRECT");
+  EXPECT_TRUE(cache.Get("http://a", "net1", 999, &value));
+  EXPECT_EQ("PROXY p1", value);
+  EXPECT_TRUE(cache.Get("https://a", "net1", 999, &value));
+  EXPECT_EQ("DIRECT", value);
+
+  // A value is replaced, and its time to live starts again.
+  cache.Put("http://a", "net1", 500, "PROXY p2");
+  EXPECT_TRUE(cache.Get("http://a", "net1", 1499, &value));
+  EXPECT_EQ("PROXY p2", value);
+  EXPECT_EQ(2, cache.size());
+
+  cache.Clear();
+  EXPECT_FALSE(cache.Get("http://a", "net1", 500, &value));
+  EXPECT_EQ(0, cache.size());
+}
+
+TEST(TimedCacheTest, Expires) {
+  TimedCache<int> cache(1000, 10);
+  int value = 0;
+
+  cache.Put("key", "net1", 100, 7);
+  EXPECT_TRUE(cache.Get("key", "net1", 1099, &value));
+  EXPECT_EQ(7, value);
+  EXPECT_FALSE(cache.Get("key", "net1", 1100, &value));
+}
+
+// A value computed on one network is not used on another one, for instance
+// once the machine moves from the office network to a home network.
+TEST(TimedCacheTest, FingerprintChanges) {
+  TimedCache<int> cache(1000, 10);
+  int value = 0;
+
+  cache.Put("key", "office", 0, 7);
+  EXPECT_FALSE(cache.Get("key", "home", 1, &value));
+  EXPECT_TRUE(cache.Get("key", "office", 1, &value));
+
+  cache.Put("key", "home", 2, 8);
+  EXPECT_FALSE(cache.Get("key", "office", 3, &value));
+  EXPECT_TRUE(cache.Get("key", "home", 3, &value));
+  EXPECT_EQ(8, value);
+}
+
+TEST(TimedCacheTest, EvictsStaleThenOldest) {
+  TimedCache<int> cache(1000, 3);
+  int value = 0;
+
+  cache.Put("a", "net1", 0, 1);
+  cache.Put("b", "net1", 600, 2);
+  cache.Put("c", "net1", 700, 3);
+
+  // "a" is stale, so it makes room for "d".
+  cache.Put("d", "net1", 1100, 4);
+  EXPECT_EQ(3, cache.size());
+  EXPECT_TRUE(cache.Get("b", "net1", 1100, &value));
+  EXPECT_TRUE(cache.Get("c", "net1", 1100, &value));
+  EXPECT_TRUE(cache.Get("d", "net1", 1100, &value));
+
+  // No entry is stale, so the oldest one, "b", makes room for "e".
+  cache.Put("e", "net1", 1200, 5);
+  EXPECT_EQ(3, cache.size());
+  EXPECT_FALSE(cache.Get("b", "net1", 1200, &value));
+  EXPECT_TRUE(cache.Get("c", "net1", 1200, &value));
+  EXPECT_TRUE(cache.Get("e", "net1", 1200, &value));
+  EXPECT_EQ(5, value);
+
+  // Replacing a value does not evict another one.
+  cache.Put("e", "net1", 1300, 6);
+  EXPECT_EQ(3, cache.size());
+  EXPECT_TRUE(cache.Get("c", "net1", 1300, &value));
+}
+
+}  // namespace omaha
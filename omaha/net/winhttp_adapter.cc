@@ -315,6 +315,19 @@ HRESULT WinHttpAdapter::SetRequestOption(uint32 option,
                                  buffer_length);
 }
 
+HRESULT WinHttpAdapter::QueryRequestOption(uint32 option,
+                                           void* buffer,
+                                           DWORD* buffer_length) {
+  __mutexScope(lock_);
+
+  ASSERT1(buffer && buffer_length && *buffer_length);
+
+  return http_client_->QueryOption(request_handle_,
+                                   option,
+                                   buffer,
+                                   buffer_length);
+}
+
 HRESULT WinHttpAdapter::AsyncCallBegin(DWORD async_call_type) {
   async_call_type_  = async_call_type;
   async_call_is_error_ = false;
@@ -101,6 +101,10 @@ class WinHttpAdapter {
                            const void* buffer,
                            DWORD buffer_length);
 
+  HRESULT QueryRequestOption(uint32 option,
+                             void* buffer,
+                             DWORD* buffer_length);
+
   void CloseHandles();
 
   HRESULT CrackUrl(const TCHAR* url,
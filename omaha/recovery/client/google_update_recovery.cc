@@ -575,18 +575,20 @@ HRESULT ValidateAndUnpackCRX(const CPath& from_crx_path,
   ASSERT1(unpacked_exe);
 
   std::string public_key;
-  if (crx_file::Verify(std::string(CT2A(from_crx_path)),
-                       crx_format,
-                       {crx_hash},
-                       {},
-                       &public_key,
-                       NULL) != crx_file::VerifierResult::OK_FULL) {
-    return CRYPT_E_NO_MATCH;
-  }
-
-  if (!crx_file::Crx3Unzip(from_crx_path, unpack_under_path)) {
+  const crx_file::VerifierResult result =
+      crx_file::VerifyAndUnzip(from_crx_path,
+                               crx_format,
+                               {crx_hash},
+                               {},
+                               unpack_under_path,
+                               &public_key,
+                               NULL);
+  if (result == crx_file::VerifierResult::ERROR_UNZIP_FAILED) {
     return E_UNEXPECTED;
   }
+  if (result != crx_file::VerifierResult::OK_FULL) {
+    return CRYPT_E_NO_MATCH;
+  }
 
   CPath exe = unpack_under_path;
   exe += _T("GoogleUpdateSetup.exe");
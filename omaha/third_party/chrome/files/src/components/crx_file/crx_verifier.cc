@@ -19,6 +19,7 @@
 
 #include "components/crx_file/crx_verifier.h"
 
+#include <algorithm>
 #include <cstring>
 #include <iterator>
 #include <memory>
@@ -30,6 +31,7 @@
 #include "crypto/signature_verifier.h"
 #include "omaha/base/debug.h"
 #include "omaha/base/file.h"
+#include "omaha/base/parallel_extractor.h"
 #include "omaha/base/scope_guard.h"
 #include "omaha/base/security/sha256.h"
 #include "omaha/base/signatures.h"
@@ -58,19 +60,84 @@ const uint8_t kPublisherKeyHash[] = {
 typedef std::vector<std::shared_ptr<crypto::SignatureVerifier>> Verifiers;
 typedef google::protobuf::RepeatedPtrField<AsymmetricKeyProof> RepeatedProof;
 
+// The size of the chunks in which the archive is hashed and verified.
+const int kArchiveChunkSize = 1 << 16;
+
+// The offset of the header in a Crx3 file, after [magic][version][size].
+const uint32_t kCrx3HeaderOffset = 12;
+
+// The bytes of a CRX file, read in order.
+class CrxInput {
+ public:
+  virtual ~CrxInput() {}
+
+  // Returns the next bytes of the file, at most |length| of them, in |*data|,
+  // which points either into |buffer| or into the file itself. Returns the
+  // number of bytes, which is less than |length| only at the end of the file,
+  // or -1 in the case of a read error.
+  virtual int Next(uint8_t* buffer, int length, const uint8_t** data) = 0;
+};
+
+class FileCrxInput : public CrxInput {
+ public:
+  explicit FileCrxInput(omaha::File* file) : file_(file) {}
+
+  int Next(uint8_t* buffer, int length, const uint8_t** data) override {
+    ASSERT1(sizeof(byte) == sizeof(uint8_t));
+    uint32 bytes_read = 0;
+    HRESULT hr =
+        file_->Read(length, reinterpret_cast<byte*>(buffer), &bytes_read);
+    if (FAILED(hr)) {
+      return -1;
+    }
+    *data = buffer;
+    return bytes_read;
+  }
+
+ private:
+  omaha::File* file_;
+
+  DISALLOW_COPY_AND_ASSIGN(FileCrxInput);
+};
+
+// Reads a CRX file in memory without copying it.
+class MemoryCrxInput : public CrxInput {
+ public:
+  MemoryCrxInput(const uint8_t* file_data, size_t size)
+      : file_data_(file_data), size_(size), offset_(0) {}
+
+  int Next(uint8_t* buffer, int length, const uint8_t** data) override {
+    UNREFERENCED_PARAMETER(buffer);
+    const size_t count =
+        std::min(static_cast<size_t>(length), size_ - offset_);
+    *data = file_data_ + offset_;
+    offset_ += count;
+    return static_cast<int>(count);
+  }
+
+ private:
+  const uint8_t* file_data_;
+  const size_t size_;
+  size_t offset_;
+
+  DISALLOW_COPY_AND_ASSIGN(MemoryCrxInput);
+};
+
 // Returns the number of bytes read, or -1 in the case of an unexpected EOF or
 // read error.
 int ReadAndHashBuffer(uint8_t* buffer,
                       int length,
-                      omaha::File* file,
+                      CrxInput* input,
                       omaha::CryptDetails::HashInterface* hash) {
-  ASSERT1(sizeof(byte) == sizeof(uint8_t));
-  uint32 bytes_read = 0;
-  HRESULT hr = file->Read(length, reinterpret_cast<byte*>(buffer), &bytes_read);
-  if (FAILED(hr)) {
+  const uint8_t* data = NULL;
+  const int bytes_read = input->Next(buffer, length, &data);
+  if (bytes_read < 0) {
     return -1;
   }
 
+  if (data != buffer) {
+    memcpy(buffer, data, bytes_read);
+  }
   hash->update(buffer, bytes_read);
   return bytes_read;
 }
@@ -78,28 +145,37 @@ int ReadAndHashBuffer(uint8_t* buffer,
 // Returns UINT32_MAX in the case of an unexpected EOF or read error, else
 // returns the read uint32.
 uint32_t ReadAndHashLittleEndianUInt32(
-    omaha::File* file,
+    CrxInput* input,
     omaha::CryptDetails::HashInterface* hash) {
   uint8_t buffer[4] = {};
-  if (ReadAndHashBuffer(buffer, 4, file, hash) != 4) {
+  if (ReadAndHashBuffer(buffer, 4, input, hash) != 4) {
     return UINT32_MAX;
   }
   return buffer[3] << 24 | buffer[2] << 16 | buffer[1] << 8 | buffer[0];
 }
 
+uint32_t LoadLittleEndianUInt32(const uint8_t* buffer) {
+  return buffer[3] << 24 | buffer[2] << 16 | buffer[1] << 8 | buffer[0];
+}
+
 // Read to the end of the file, updating the hash and all verifiers.
-bool ReadHashAndVerifyArchive(omaha::File* file,
+bool ReadHashAndVerifyArchive(CrxInput* input,
                               omaha::CryptDetails::HashInterface* hash,
                               const Verifiers& verifiers) {
-  uint8_t buffer[1 << 12] = {};
-  size_t len = 0;
-  while ((len = ReadAndHashBuffer(buffer, arraysize(buffer), file, hash)) > 0) {
+  std::vector<uint8_t> buffer(kArchiveChunkSize);
+  const uint8_t* data = NULL;
+  int len = 0;
+  while ((len = input->Next(&buffer.front(), kArchiveChunkSize, &data)) > 0) {
+    hash->update(data, len);
     for (Verifiers::const_iterator verifier = verifiers.begin();
          verifier != verifiers.end();
          ++verifier) {
-      (*verifier)->VerifyUpdate(buffer, len);
+      (*verifier)->VerifyUpdate(data, len);
     }
   }
+  if (len < 0) {
+    return false;
+  }
 
   for (Verifiers::const_iterator verifier = verifiers.begin();
        verifier != verifiers.end();
@@ -117,20 +193,20 @@ bool ReadHashAndVerifyArchive(omaha::File* file,
 // and the signed section is the encoding of another protocol buffer. All
 // signatures cover [prefix][signed-header-size][signed-header][archive].
 VerifierResult VerifyCrx3(
-    omaha::File* file,
+    CrxInput* input,
     omaha::CryptDetails::HashInterface* hash,
     const std::vector<std::vector<uint8_t>>& required_key_hashes,
     std::string* public_key,
     std::string* crx_id,
     bool require_publisher_key) {
   // Parse [header-size] and [header].
-  const uint32_t header_size = ReadAndHashLittleEndianUInt32(file, hash);
+  const uint32_t header_size = ReadAndHashLittleEndianUInt32(input, hash);
   if (header_size > kMaxHeaderSize) {
     return VerifierResult::ERROR_HEADER_INVALID;
   }
   std::vector<uint8_t> header_bytes(header_size);
   // Assuming kMaxHeaderSize can fit in an int, the following cast is safe.
-  if (ReadAndHashBuffer(header_bytes.data(), header_size, file, hash) !=
+  if (ReadAndHashBuffer(header_bytes.data(), header_size, input, hash) !=
       static_cast<int>(header_size)) {
     return VerifierResult::ERROR_HEADER_INVALID;
   }
@@ -234,7 +310,7 @@ VerifierResult VerifyCrx3(
   }
 
   // Update and finalize the verifiers with [archive].
-  if (!ReadHashAndVerifyArchive(file, hash, verifiers)) {
+  if (!ReadHashAndVerifyArchive(input, hash, verifiers)) {
     return VerifierResult::ERROR_SIGNATURE_VERIFICATION_FAILED;
   }
 
@@ -248,164 +324,249 @@ VerifierResult VerifyCrx3(
   return VerifierResult::OK_FULL;
 }
 
-int ReadBuffer(uint8_t* buffer, int length, omaha::File* file) {
-  ASSERT1(sizeof(byte) == sizeof(uint8_t));
-  uint32 bytes_read = 0;
-  HRESULT hr = file->Read(length, reinterpret_cast<byte*>(buffer), &bytes_read);
-  if (FAILED(hr)) {
-    return -1;
-  }
+// Verifies the CRX read from |input|. See Verify().
+VerifierResult VerifyCrx(
+    CrxInput* input,
+    const VerifierFormat& format,
+    const std::vector<std::vector<uint8_t>>& required_key_hashes,
+    const std::vector<uint8_t>& required_file_hash,
+    std::string* public_key,
+    std::string* crx_id) {
+  std::string public_key_local;
+  std::string crx_id_local;
 
-  return bytes_read;
-}
+  std::shared_ptr<omaha::CryptDetails::HashInterface> file_hash(
+      omaha::CryptDetails::CreateHasher());
 
-uint32_t ReadLittleEndianUInt32(omaha::File* file) {
-  uint8_t buffer[4] = {};
-  if (ReadBuffer(buffer, 4, file) != 4) {
-    return UINT32_MAX;
+  // Magic number.
+  bool diff = false;
+  uint8_t buffer[kCrx2FileHeaderMagicSize] = {};
+  if (ReadAndHashBuffer(buffer, kCrx2FileHeaderMagicSize, input,
+                        file_hash.get()) != kCrx2FileHeaderMagicSize) {
+    return VerifierResult::ERROR_HEADER_INVALID;
   }
-  return buffer[3] << 24 | buffer[2] << 16 | buffer[1] << 8 | buffer[0];
-}
 
-HRESULT ReadArchiveAndWrite(omaha::File* file, const CPath& write_to) {
-  omaha::File write_to_file;
-  HRESULT hr = write_to_file.Open(write_to, true, false);
-  if (FAILED(hr)) {
-    return hr;
+  const char* magic = reinterpret_cast<const char*>(buffer);
+  if (!strncmp(magic, kCrxDiffFileHeaderMagic, kCrx2FileHeaderMagicSize)) {
+    diff = true;
+  } else if (strncmp(magic, kCrx2FileHeaderMagic, kCrx2FileHeaderMagicSize)) {
+    return VerifierResult::ERROR_HEADER_INVALID;
+  }
+
+  // Version number.
+  const uint32_t version =
+      ReadAndHashLittleEndianUInt32(input, file_hash.get());
+  VerifierResult result =
+    version == 3 ?
+    VerifyCrx3(input,
+               file_hash.get(),
+               required_key_hashes,
+               &public_key_local,
+               &crx_id_local,
+               format == VerifierFormat::CRX3_WITH_PUBLISHER_PROOF) :
+    VerifierResult::ERROR_HEADER_INVALID;
+  if (result != VerifierResult::OK_FULL) {
+    return result;
   }
 
-  uint8_t buffer[1 << 12] = {};
-  size_t len = 0;
-  while ((len = ReadBuffer(buffer, arraysize(buffer), file)) > 0) {
-    uint32 bytes_written(0);
-    hr = write_to_file.Write(buffer, len, &bytes_written);
-    if (FAILED(hr) || bytes_written != len) {
-      return hr;
+  if (!required_file_hash.empty()) {
+    if (required_file_hash.size() != SHA256_DIGEST_SIZE) {
+      return VerifierResult::ERROR_EXPECTED_HASH_INVALID;
+    }
+    if (!crypto::SecureMemEqual(file_hash->final(),
+                                required_file_hash.data(),
+                                SHA256_DIGEST_SIZE)) {
+      return VerifierResult::ERROR_FILE_HASH_FAILED;
     }
   }
 
-  return S_OK;
+  // All is well. Set the out-params and return.
+  if (public_key) {
+    *public_key = public_key_local;
+  }
+  if (crx_id) {
+    *crx_id = crx_id_local;
+  }
+  return diff ? VerifierResult::OK_DELTA : VerifierResult::OK_FULL;
 }
 
-// Reduces a Crx3 file into a corresponding Zip file sans the Crx3 headers.
-bool Crx3ToZip(const CPath& crx_path, const CPath& zip_path) {
-  if (!omaha::File::Exists(crx_path)) {
-    return false;
-  }
+// A read-only view of a whole file.
+class MappedFile {
+ public:
+  MappedFile() : size_(0) {}
+
+  bool Open(const CPath& path) {
+    reset(file_, ::CreateFile(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL));
+    LARGE_INTEGER size = {};
+    if (!file_ || !::GetFileSizeEx(get(file_), &size) ||
+        static_cast<ULONGLONG>(size.QuadPart) > SIZE_MAX) {
+      return false;
+    }
+    size_ = static_cast<size_t>(size.QuadPart);
 
-  omaha::File file;
-  HRESULT hr = file.Open(crx_path, false, false);
-  if (FAILED(hr)) {
-    return false;
+    // An empty file cannot be mapped.
+    if (!size_) {
+      return true;
+    }
+    reset(mapping_, ::CreateFileMapping(get(file_), NULL, PAGE_READONLY,
+                                        0, 0, NULL));
+    if (!mapping_) {
+      return false;
+    }
+    reset(view_, ::MapViewOfFile(get(mapping_), FILE_MAP_READ, 0, 0, 0));
+    return !!view_;
   }
 
-  char buffer[kCrx2FileHeaderMagicSize] = {};
-  uint32 bytes_read = 0;
-  if (FAILED(file.Read(kCrx2FileHeaderMagicSize,
-                       reinterpret_cast<byte *>(buffer),
-                       &bytes_read)) ||
-      bytes_read != kCrx2FileHeaderMagicSize) {
-    return false;
+  const uint8_t* data() const {
+    return static_cast<const uint8_t*>(get(view_));
   }
+  size_t size() const { return size_; }
 
-  if (strncmp(buffer, kCrxDiffFileHeaderMagic, kCrx2FileHeaderMagicSize) &&
-      strncmp(buffer, kCrx2FileHeaderMagic, kCrx2FileHeaderMagicSize)) {
-    return false;
-  }
+ private:
+  scoped_hfile file_;
+  scoped_file_mapping mapping_;
+  scoped_file_view view_;
+  size_t size_;
 
-  const uint32_t version = ReadLittleEndianUInt32(&file);
-  if (version != 3) {
-    return false;
-  }
+  DISALLOW_COPY_AND_ASSIGN(MappedFile);
+};
 
-  const uint32_t header_size = ReadLittleEndianUInt32(&file);
-  if (header_size > kMaxHeaderSize) {
+// Returns the offset of the archive of the Crx3 file in |data|.
+bool GetCrx3ArchiveOffset(const uint8_t* data, size_t size, size_t* offset) {
+  if (size < kCrx3HeaderOffset) {
     return false;
   }
 
-  // Skip the crx header which contains the following:
-  //   [crx-magic] + [version] + [header-size] + [header].
-  hr = file.SeekFromBegin(12 + header_size);
-  if (FAILED(hr)) {
+  const char* magic = reinterpret_cast<const char*>(data);
+  if (strncmp(magic, kCrxDiffFileHeaderMagic, kCrx2FileHeaderMagicSize) &&
+      strncmp(magic, kCrx2FileHeaderMagic, kCrx2FileHeaderMagicSize)) {
     return false;
   }
 
-  if (FAILED(ReadArchiveAndWrite(&file, zip_path))) {
+  const uint32_t version = LoadLittleEndianUInt32(data + 4);
+  const uint32_t header_size = LoadLittleEndianUInt32(data + 8);
+  if (version != 3 || header_size > kMaxHeaderSize ||
+      header_size > size - kCrx3HeaderOffset) {
     return false;
   }
 
+  // Skip the crx header which contains the following:
+  //   [crx-magic] + [version] + [header-size] + [header].
+  *offset = kCrx3HeaderOffset + header_size;
   return true;
 }
 
-// Unzips the given zip file |zip_file_path| into the directory |to_dir|.
-bool Unzip(const CPath& zip_file_path, const CPath& to_dir) {
-  HRESULT hr = omaha::CreateDir(to_dir, NULL);
-  if (FAILED(hr)) {
-    return false;
-  }
-
-  struct zip* zip_archive = zip_open(CT2A(zip_file_path), 0, NULL);
-  if (!zip_archive) {
-    return false;
-  }
-  omaha::ScopeGuard zip_close_guard = omaha::MakeGuard(zip_close, zip_archive);
-
-  const zip_int64_t num_entries = zip_get_num_entries(zip_archive, 0);
-  for (zip_int64_t i = 0; i < num_entries; ++i) {
-    struct zip_stat zip_entry_information = {};
-    if (zip_stat_index(zip_archive, i, 0, &zip_entry_information)) {
-      continue;
-    }
+// The zip archive of a Crx3 file in memory. Since a libzip archive is not
+// thread-safe, each reader opens the archive again over the same memory.
+class ZipArchive : public omaha::ParallelExtractor::Archive {
+ public:
+  ZipArchive(const uint8_t* data, size_t size) : data_(data), size_(size) {}
 
-    size_t len = strlen(zip_entry_information.name);
-    if (!len) {
+  bool Load() {
+    struct zip* zip_archive = Open();
+    if (!zip_archive) {
       return false;
     }
+    omaha::ScopeGuard zip_close_guard = omaha::MakeGuard(zip_close,
+                                                         zip_archive);
 
-    if (zip_entry_information.name[len - 1] == '/' ||
-        zip_entry_information.name[len - 1] == '\\') {
-      CPathA sub_directory = static_cast<const char*>(CT2A(to_dir));
-      sub_directory += zip_entry_information.name;
-      omaha::CreateDir(CA2T(sub_directory), NULL);
+    const zip_int64_t num_entries = zip_get_num_entries(zip_archive, 0);
+    for (zip_int64_t i = 0; i < num_entries; ++i) {
+      struct zip_stat zip_entry_information = {};
+      if (zip_stat_index(zip_archive, i, 0, &zip_entry_information)) {
+        continue;
+      }
 
-      continue;
+      const size_t len = strlen(zip_entry_information.name);
+      if (!len) {
+        return false;
+      }
+
+      omaha::ParallelExtractor::Entry entry;
+      entry.name = zip_entry_information.name;
+      entry.is_directory = zip_entry_information.name[len - 1] == '/' ||
+                           zip_entry_information.name[len - 1] == '\\';
+      entry.size = entry.is_directory ? 0 : zip_entry_information.size;
+      entries_.push_back(entry);
+      zip_indexes_.push_back(i);
     }
+    return true;
+  }
 
-    struct zip_file* zip_entry_file = zip_fopen_index(zip_archive, i, 0);
-    if (!zip_entry_file) {
-      return false;
+  const std::vector<omaha::ParallelExtractor::Entry>& entries() const override {
+    return entries_;
+  }
+
+  std::unique_ptr<omaha::ParallelExtractor::Reader> CreateReader() override {
+    struct zip* zip_archive = Open();
+    if (!zip_archive) {
+      return nullptr;
+    }
+    return std::unique_ptr<omaha::ParallelExtractor::Reader>(
+        new ZipReader(zip_archive, &zip_indexes_));
+  }
+
+ private:
+  class ZipReader : public omaha::ParallelExtractor::Reader {
+   public:
+    ZipReader(struct zip* zip_archive,
+              const std::vector<zip_uint64_t>* zip_indexes)
+        : zip_archive_(zip_archive),
+          zip_indexes_(zip_indexes),
+          zip_entry_file_(NULL) {}
+
+    ~ZipReader() override {
+      CloseEntry();
+      zip_close(zip_archive_);
     }
-    omaha::ScopeGuard zip_fclose_guard =
-        omaha::MakeGuard(zip_fclose, zip_entry_file);
 
-    CPathA output_file = static_cast<const char*>(CT2A(to_dir));
-    output_file += zip_entry_information.name;
+    bool Open(size_t index) override {
+      CloseEntry();
+      zip_entry_file_ = zip_fopen_index(zip_archive_, (*zip_indexes_)[index],
+                                        0);
+      return zip_entry_file_ != NULL;
+    }
 
-    omaha::File file;
-    hr = file.Open(CString(output_file), true, false);
-    if (FAILED(hr)) {
-      return false;
+    int64_t Read(uint8_t* buffer, size_t size) override {
+      return zip_fread(zip_entry_file_, buffer, size);
     }
 
-    for (zip_uint64_t sum = 0; sum != zip_entry_information.size;) {
-      byte buf[100] = {};
-      zip_int64_t read_len = zip_fread(zip_entry_file, buf, arraysize(buf));
-      if (read_len < 0) {
-        return false;
+   private:
+    void CloseEntry() {
+      if (zip_entry_file_) {
+        zip_fclose(zip_entry_file_);
+        zip_entry_file_ = NULL;
       }
+    }
 
-      uint32 bytes_written = 0;
-      if (FAILED(file.Write(buf, read_len, &bytes_written)) ||
-          bytes_written != read_len) {
-        return false;
-      }
+    struct zip* zip_archive_;
+    const std::vector<zip_uint64_t>* zip_indexes_;
+    struct zip_file* zip_entry_file_;
 
-      sum += read_len;
+    DISALLOW_COPY_AND_ASSIGN(ZipReader);
+  };
+
+  struct zip* Open() const {
+    zip_error_t error = {};
+    zip_source_t* source = zip_source_buffer_create(data_, size_, 0, &error);
+    if (!source) {
+      return NULL;
+    }
+    struct zip* zip_archive = zip_open_from_source(source, ZIP_RDONLY, &error);
+    if (!zip_archive) {
+      zip_source_free(source);
     }
+    return zip_archive;
   }
 
-  return true;
-}
+  const uint8_t* data_;
+  const size_t size_;
+  std::vector<omaha::ParallelExtractor::Entry> entries_;
+  std::vector<zip_uint64_t> zip_indexes_;
+
+  DISALLOW_COPY_AND_ASSIGN(ZipArchive);
+};
 
 }  // namespace
 
@@ -416,8 +577,6 @@ VerifierResult Verify(
     const std::vector<uint8_t>& required_file_hash,
     std::string* public_key,
     std::string* crx_id) {
-  std::string public_key_local;
-  std::string crx_id_local;
   if (!omaha::File::Exists(CString(crx_path.c_str()))) {
     return VerifierResult::ERROR_FILE_NOT_READABLE;
   }
@@ -428,78 +587,111 @@ VerifierResult Verify(
     return VerifierResult::ERROR_FILE_NOT_READABLE;
   }
 
-  std::shared_ptr<omaha::CryptDetails::HashInterface> file_hash(
-      omaha::CryptDetails::CreateHasher());
+  FileCrxInput input(&file);
+  return VerifyCrx(&input,
+                   format,
+                   required_key_hashes,
+                   required_file_hash,
+                   public_key,
+                   crx_id);
+}
 
-  // Magic number.
-  bool diff = false;
-  char buffer[kCrx2FileHeaderMagicSize] = {};
-  uint32 bytes_read = 0;
-  if (FAILED(file.Read(kCrx2FileHeaderMagicSize,
-                       reinterpret_cast<byte *>(buffer),
-                       &bytes_read)) ||
-      bytes_read != kCrx2FileHeaderMagicSize) {
-    return VerifierResult::ERROR_HEADER_INVALID;
+VerifierResult VerifyAndUnzip(
+    const CPath& crx_path,
+    const VerifierFormat& format,
+    const std::vector<std::vector<uint8_t>>& required_key_hashes,
+    const std::vector<uint8_t>& required_file_hash,
+    const CPath& to_dir,
+    std::string* public_key,
+    std::string* crx_id) {
+  MappedFile crx;
+  if (!crx.Open(crx_path)) {
+    return VerifierResult::ERROR_FILE_NOT_READABLE;
   }
 
-  if (!strncmp(buffer, kCrxDiffFileHeaderMagic, kCrx2FileHeaderMagicSize)) {
-    diff = true;
-  } else if (strncmp(buffer, kCrx2FileHeaderMagic, kCrx2FileHeaderMagicSize)) {
-    return VerifierResult::ERROR_HEADER_INVALID;
+  VerifierResult result = VerifierResult::ERROR_HEADER_INVALID;
+  std::string public_key_local;
+  std::string crx_id_local;
+  auto verify = [&]() {
+    MemoryCrxInput input(crx.data(), crx.size());
+    result = VerifyCrx(&input,
+                       format,
+                       required_key_hashes,
+                       required_file_hash,
+                       &public_key_local,
+                       &crx_id_local);
+    return result == VerifierResult::OK_FULL;
+  };
+
+  // A differential CRX is not a zip archive, and is only verified.
+  size_t archive_offset = 0;
+  if (!GetCrx3ArchiveOffset(crx.data(), crx.size(), &archive_offset) ||
+      !strncmp(reinterpret_cast<const char*>(crx.data()),
+               kCrxDiffFileHeaderMagic,
+               kCrx2FileHeaderMagicSize)) {
+    verify();
+    if (result == VerifierResult::OK_DELTA) {
+      if (public_key) {
+        *public_key = public_key_local;
+      }
+      if (crx_id) {
+        *crx_id = crx_id_local;
+      }
+    }
+    return result;
   }
-  file_hash->update(buffer, sizeof(buffer));
 
-  // Version number.
-  const uint32_t version =
-      ReadAndHashLittleEndianUInt32(&file, file_hash.get());
-  VerifierResult result =
-    version == 3 ?
-    VerifyCrx3(&file,
-               file_hash.get(),
-               required_key_hashes,
-               &public_key_local,
-               &crx_id_local,
-               format == VerifierFormat::CRX3_WITH_PUBLISHER_PROOF) :
-    VerifierResult::ERROR_HEADER_INVALID;
+  ZipArchive archive(crx.data() + archive_offset,
+                     crx.size() - archive_offset);
+  if (!archive.Load()) {
+    verify();
+    return result == VerifierResult::OK_FULL ?
+           VerifierResult::ERROR_UNZIP_FAILED : result;
+  }
+
+  // The entries are extracted while the file is verified, and committed to
+  // |to_dir| only if the file verifies.
+  const omaha::ParallelExtractor::Result extract_result =
+      omaha::ParallelExtractor::Extract(
+          &archive,
+          verify,
+          std::string(omaha::WideToUtf8(CString(to_dir))),
+          0);
   if (result != VerifierResult::OK_FULL) {
     return result;
   }
-
-  if (!required_file_hash.empty()) {
-    if (required_file_hash.size() != SHA256_DIGEST_SIZE) {
-      return VerifierResult::ERROR_EXPECTED_HASH_INVALID;
-    }
-    if (!crypto::SecureMemEqual(file_hash->final(),
-                                required_file_hash.data(),
-                                SHA256_DIGEST_SIZE)) {
-      return VerifierResult::ERROR_FILE_HASH_FAILED;
-    }
+  if (extract_result != omaha::ParallelExtractor::kSuccess) {
+    return VerifierResult::ERROR_UNZIP_FAILED;
   }
 
-  // All is well. Set the out-params and return.
   if (public_key) {
     *public_key = public_key_local;
   }
   if (crx_id) {
     *crx_id = crx_id_local;
   }
-  return diff ? VerifierResult::OK_DELTA : VerifierResult::OK_FULL;
+  return VerifierResult::OK_FULL;
 }
 
 bool Crx3Unzip(const CPath& crx_path, const CPath& to_dir) {
-  HRESULT hr = omaha::CreateDir(to_dir, NULL);
-  if (FAILED(hr)) {
+  MappedFile crx;
+  size_t archive_offset = 0;
+  if (!crx.Open(crx_path) ||
+      !GetCrx3ArchiveOffset(crx.data(), crx.size(), &archive_offset)) {
     return false;
   }
 
-  const CString zip = omaha::GetTempFilenameAt(to_dir, _T("C3U"));
-  if (zip.IsEmpty()) {
+  ZipArchive archive(crx.data() + archive_offset,
+                     crx.size() - archive_offset);
+  if (!archive.Load()) {
     return false;
   }
 
-  const CPath zip_path(zip);
-  return Crx3ToZip(crx_path, zip_path) ? Unzip(zip_path, to_dir) : false;
+  return omaha::ParallelExtractor::Extract(
+             &archive,
+             []() { return true; },
+             std::string(omaha::WideToUtf8(CString(to_dir))),
+             0) == omaha::ParallelExtractor::kSuccess;
 }
 
 }  // namespace crx_file
-
@@ -52,6 +52,7 @@ enum class VerifierResult {
   ERROR_SIGNATURE_INITIALIZATION_FAILED,  // A signature or key is malformed.
   ERROR_SIGNATURE_VERIFICATION_FAILED,    // A signature doesn't match.
   ERROR_REQUIRED_PROOF_MISSING,           // RequireKeyProof was unsatisfied.
+  ERROR_UNZIP_FAILED,  // The file verifies but cannot be unzipped.
 };
 
 // Verify the file at |crx_path| as a valid Crx of |format|. The Crx must be
@@ -69,7 +70,23 @@ VerifierResult Verify(
     std::string* public_key,
     std::string* crx_id);
 
-// Unzips the given crx file |crx_path| into the directory |to_dir|.
+// Verifies the file at |crx_path| as Verify() does, and unzips it into the
+// directory |to_dir|. The file is mapped once, and its entries are unzipped
+// on several threads while it is verified. The unzipped files are moved into
+// |to_dir| only if the file verifies as a full CRX. A differential CRX is only
+// verified. Returns ERROR_UNZIP_FAILED if the file verifies but cannot be
+// unzipped.
+VerifierResult VerifyAndUnzip(
+    const CPath& crx_path,
+    const VerifierFormat& format,
+    const std::vector<std::vector<uint8_t>>& required_key_hashes,
+    const std::vector<uint8_t>& required_file_hash,
+    const CPath& to_dir,
+    std::string* public_key,
+    std::string* crx_id);
+
+// Unzips the given crx file |crx_path| into the directory |to_dir|, without
+// verifying it.
 bool Crx3Unzip(const CPath& crx_path, const CPath& to_dir);
 
 }  // namespace crx_file
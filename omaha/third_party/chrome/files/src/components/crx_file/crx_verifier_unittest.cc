@@ -221,4 +221,45 @@ TEST(CrxVerifierTest, Crx3Unzip) {
   EXPECT_SUCCEEDED(omaha::DeleteDirectory(to_dir));
 }
 
+TEST(CrxVerifierTest, VerifyAndUnzip) {
+  const std::vector<std::vector<uint8_t>> keys;
+  const std::vector<uint8_t> hash;
+  std::string public_key = "UNSET";
+  std::string crx_id = "UNSET";
+  const CPath to_dir(omaha::GetUniqueTempDirectoryName());
+  EXPECT_EQ(VerifierResult::OK_FULL,
+            VerifyAndUnzip(TestFileCPath(_T("valid_publisher.crx3")),
+                           VerifierFormat::CRX3_WITH_PUBLISHER_PROOF, keys,
+                           hash, to_dir, &public_key, &crx_id));
+  EXPECT_NE("UNSET", crx_id);
+  EXPECT_NE("UNSET", public_key);
+
+  EXPECT_TRUE(omaha::File::Exists(
+      ConcatenatePath(to_dir, _T("manifest.json"))));
+  EXPECT_TRUE(omaha::File::Exists(
+      ConcatenatePath(to_dir, _T("_metadata\\verified_contents.json"))));
+
+  EXPECT_SUCCEEDED(omaha::DeleteDirectory(to_dir));
+}
+
+TEST(CrxVerifierTest, VerifyAndUnzip_VerificationFailed) {
+  const std::vector<std::vector<uint8_t>> keys;
+  const std::vector<uint8_t> hash;
+  std::string public_key = "UNSET";
+  std::string crx_id = "UNSET";
+  const CPath to_dir(omaha::GetUniqueTempDirectoryName());
+  EXPECT_EQ(VerifierResult::ERROR_REQUIRED_PROOF_MISSING,
+            VerifyAndUnzip(TestFileCPath(_T("unsigned.crx3")),
+                           VerifierFormat::CRX2_OR_CRX3, keys, hash, to_dir,
+                           &public_key, &crx_id));
+  EXPECT_EQ("UNSET", crx_id);
+  EXPECT_EQ("UNSET", public_key);
+
+  // Nothing is unzipped.
+  EXPECT_FALSE(omaha::File::Exists(
+      ConcatenatePath(to_dir, _T("manifest.json"))));
+
+  omaha::DeleteDirectory(to_dir);
+}
+
 }  // namespace crx_file
@@ -14,6 +14,7 @@
 // ========================================================================
 
 #include "omaha/tools/goopdump/data_dumper_network.h"
+#include "omaha/common/config_manager.h"
 #include "omaha/common/vistautil.h"
 #include "omaha/goopdate/goopdate_utils.h"
 #include "omaha/net/network_config.h"
@@ -42,6 +43,16 @@ void DataDumperNetwork::DumpNetworkConfig(const DumpLog& dump_log) {
   dump_log.WriteLine(NetworkConfig::ToString(configs));
 }
 
+// The health of the hosts is written by the worker processes, for the machine
+// and for the user, since goopdump does not send requests of its own.
+void DataDumperNetwork::DumpHostHealth(const DumpLog& dump_log) {
+  const CString machine_health(ConfigManager::Instance()->GetHostHealth(true));
+  const CString user_health(ConfigManager::Instance()->GetHostHealth(false));
+  dump_log.WriteLine(_T("Host health:\r\n"));
+  dump_log.WriteLine(_T("Machine: %s"), machine_health);
+  dump_log.WriteLine(_T("User: %s"), user_health);
+}
+
 HRESULT DataDumperNetwork::Process(const DumpLog& dump_log,
                                    const GoopdumpCmdLineArgs& args) {
   UNREFERENCED_PARAMETER(args);
@@ -54,6 +65,7 @@ HRESULT DataDumperNetwork::Process(const DumpLog& dump_log,
   }
 
   DumpNetworkConfig(dump_log);
+  DumpHostHealth(dump_log);
   return S_OK;
 }
 
@@ -34,6 +34,7 @@ class DataDumperNetwork : public DataDumper {
 
  private:
   void DumpNetworkConfig(const DumpLog& dump_log);
+  void DumpHostHealth(const DumpLog& dump_log);
 
   DISALLOW_COPY_AND_ASSIGN(DataDumperNetwork);
 };